@@ -0,0 +1,96 @@
+/*
+ * include/api/channel.h
+ * Shared-memory bulk IPC channels — SYS_CHANNEL operations and the ring
+ * layout shared by the kernel (kernel/sched/channel.c) and the userland
+ * library (user/sys/lib/channel.c, chan_* below).
+ *
+ * A channel is a single-producer / single-consumer byte ring in pages
+ * mapped into two processes: the client that created it and the server of
+ * the endpoint it was offered to.  Bytes move with a plain memcpy into and
+ * out of the mapping; the kernel is entered only to sleep when the reader
+ * finds the ring empty or the writer finds it full, and the other side
+ * issues a wake only when the sleeper announced itself (cons_wait /
+ * prod_wait) — i.e. on the empty -> non-empty and full -> non-full
+ * transitions.  A streaming pair that keeps up with each other makes no
+ * syscalls at all.
+ *
+ *   channel(CHAN_CONNECT, ep, size, &info)  -> slot
+ *       Allocate a ring of 'size' data bytes (a power of two in
+ *       [CHAN_SIZE_MIN, CHAN_SIZE_MAX]), map it into the caller and offer
+ *       it to the server of endpoint handle 'ep' as an IPC_TYPE_CHANNEL
+ *       message (data1 = channel id, data2 = size).  Never blocks: -EAGAIN
+ *       if the endpoint is unbound or the server's buffer is full.
+ *   channel(CHAN_ACCEPT, id, 0, &info)      -> slot
+ *       Map an offered channel into the caller.  Only the process the
+ *       offer was delivered to may accept it, and only once.
+ *   channel(CHAN_CLOSE, slot, 0, 0)         -> 0
+ *       Unmap.  The peer sees CHAN_F_PEER_GONE and any sleeper is woken;
+ *       exit closes every slot.
+ *
+ * Layout: one header page (struct chan_shared) followed by 'size' bytes of
+ * data pages, at a fixed address per slot.  head and tail are free-running
+ * byte counters (used = head - tail), each on its own cache line with the
+ * other side's wait word so producer and consumer do not false-share.  A
+ * side about to sleep sets its wait word to 1 and FUTEX_WAITs on it; the
+ * other side (or the kernel, when a peer goes away) clears it and wakes.
+ */
+#ifndef _API_CHANNEL_H
+#define _API_CHANNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "posix_types.h"
+
+#define CHAN_CONNECT 0
+#define CHAN_ACCEPT  1
+#define CHAN_CLOSE   2
+
+#define CHAN_SIZE_MIN 4096
+#define CHAN_SIZE_MAX (256 * 1024)
+#define CHAN_HDR_SIZE 4096 /* data starts one page into the mapping */
+
+/* chan_shared.flags (written by the kernel only) */
+#define CHAN_F_PEER_GONE 1
+
+struct chan_shared {
+  uint32_t head;      /* bytes ever written (producer) */
+  uint32_t cons_wait; /* 1 while the consumer sleeps on an empty ring */
+  uint32_t _pad0[14];
+  uint32_t tail;      /* bytes ever read (consumer) */
+  uint32_t prod_wait; /* 1 while the producer sleeps on a full ring */
+  uint32_t _pad1[14];
+  uint32_t size;      /* data bytes, power of two */
+  uint32_t flags;     /* CHAN_F_* */
+};
+
+/* Filled in by CHAN_CONNECT / CHAN_ACCEPT. */
+struct chan_info {
+  uint64_t base; /* user address of the struct chan_shared page */
+  uint32_t size;
+  uint32_t id;
+};
+
+/* Userland library.  The client chan_connect()s through an endpoint
+ * handle; the server receives the IPC_TYPE_CHANNEL offer like any other
+ * message and chan_accept()s it.  Either side may write or read, but each
+ * direction of a ring has one writer and one reader: open two channels
+ * for full duplex. */
+typedef struct {
+  struct chan_shared *shm;
+  uint8_t *data;
+  uint32_t mask; /* size - 1 */
+  int slot;
+} chan_t;
+
+int  chan_connect(chan_t *c, int ep, uint32_t size);
+int  chan_accept(chan_t *c, const struct ipc_message *offer);
+void chan_close(chan_t *c);
+/* chan_write: block until all len bytes are in the ring.  Returns len, or
+ * the count written before the peer closed (-EPIPE if nothing was). */
+long chan_write(chan_t *c, const void *buf, size_t len);
+/* chan_read: block until at least one byte is available and take up to
+ * len.  Returns the count, or 0 at end of stream (peer closed, ring
+ * drained). */
+long chan_read(chan_t *c, void *buf, size_t len);
+
+#endif
@@ -0,0 +1,46 @@
+/*
+ * include/api/endpoint.h
+ * SYS_ENDPOINT operations — shared by the kernel (kernel/sched/endpoint.c)
+ * and userland (os1.h ep_* wrappers).  #define-only, like futex.h.
+ *
+ *   endpoint(EP_CREATE, name, 0, 0)      -> handle
+ *       Bind the calling thread as the server of endpoint 'name', creating
+ *       it if needed.  A name already bound fails -EEXIST; an unbound one
+ *       (its server died) can be re-bound only by the same program, which
+ *       is how a service respawned by init keeps its clients.  Names under
+ *       "srv." are reserved to machine-level processes.
+ *   endpoint(EP_OPEN, name, 0, 0)        -> handle
+ *       Reference endpoint 'name' (created unbound if no server has bound
+ *       it yet, so clients may start before the service).  A process may
+ *       have created at most 4 endpoints that are still unbound (-ENOSPC
+ *       beyond that); when it exits they are withdrawn, and sends through
+ *       other handles to them fail -EPIPE.
+ *   endpoint(EP_CLOSE, h, 0, 0)          -> 0
+ *   endpoint(EP_SEND, h, msg, flags)     -> 0
+ *       Send to the endpoint's server; flags IPC_NONBLOCK as for send().
+ *       Blocks while the endpoint is unbound (-EAGAIN with IPC_NONBLOCK).
+ *   endpoint(EP_CALL, h, msg, 0)         -> 0
+ *       ipc_call() to the endpoint's server; the reply overwrites *msg.
+ *   endpoint(EP_SIGNAL, h, bits, 0)      -> 0
+ *       OR bits into the notification bound to the endpoint (<ntfn.h>):
+ *       a payload-free signal that never blocks or queues.  -ENOENT if
+ *       none is bound.
+ *
+ * Handles are small per-process integers (not PIDs): the handle is the
+ * capability, so an endpoint send needs neither a PID lookup nor the
+ * CAP_IPC_ANY relatives check.  The server sees msg.from = the sender's
+ * PID and answers with ipc_reply_recv() as usual.
+ */
+#ifndef _API_ENDPOINT_H
+#define _API_ENDPOINT_H
+
+#define EP_CREATE 0
+#define EP_OPEN   1
+#define EP_CLOSE  2
+#define EP_SEND   3
+#define EP_CALL   4
+#define EP_SIGNAL 5
+
+#define EP_NAME_MAX 32 /* including the NUL */
+
+#endif
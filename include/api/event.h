@@ -0,0 +1,74 @@
+/*
+ * include/api/event.h
+ * SYS_EVENT operations — shared by the kernel (kernel/sched/event.c) and
+ * userland (os1.h ev_* wrappers).
+ *
+ *   event(EV_CREATE, 0, 0, 0, 0)            -> handle
+ *       A new, empty event set (epoll-style: the interest list lives in
+ *       the kernel, so a wait does not re-submit it).
+ *   event(EV_ADD, h, &source, 0, 0)         -> registration id
+ *       Watch one source (struct ev_source); udata is handed back with
+ *       every event it reports.
+ *   event(EV_DEL, h, id, 0, 0)              -> 0
+ *   event(EV_WAIT, h, events, max, timeout_ms) -> n
+ *       Sleep until at least one source is ready, then report up to max
+ *       (<= EV_MAX_BATCH) of them in events[].  timeout_ms < 0 waits
+ *       forever, 0 polls; n == 0 means the timeout expired.
+ *   event(EV_CLOSE, h, 0, 0, 0)             -> 0
+ *
+ * Sources:
+ *   EV_SRC_FD        arg = fd.  FD_FILE is always ready for its open mode;
+ *                    a window fd is always writable; the keyboard fd is
+ *                    readable while an input event is queued.  A pipe's
+ *                    read end is readable while data is buffered or at
+ *                    EOF, its write end writable while PIPE_BUF bytes fit
+ *                    or no reader is left.
+ *   EV_SRC_IPC       arg = sender pid, -1 = any.  Readable while a message
+ *                    from that sender is buffered for the WAITING THREAD
+ *                    (receive buffers are per thread).
+ *   EV_SRC_INPUT     a keyboard / mouse event is buffered (input_poll_event
+ *                    would return one).
+ *   EV_SRC_REGISTRY  arg = key name (const char *).  Fires once per write
+ *                    to the key since it was last reported.
+ *   EV_SRC_TIMER     arg = period in ms.  Fires once per elapsed period.
+ * FD, IPC and INPUT are level-triggered (reported on every wait until
+ * drained); REGISTRY and TIMER are consumed when reported.
+ */
+#ifndef _API_EVENT_H
+#define _API_EVENT_H
+
+#include <stdint.h>
+
+#define EV_CREATE 0
+#define EV_ADD    1
+#define EV_DEL    2
+#define EV_WAIT   3
+#define EV_CLOSE  4
+
+#define EV_SRC_FD       0
+#define EV_SRC_IPC      1
+#define EV_SRC_INPUT    2
+#define EV_SRC_REGISTRY 3
+#define EV_SRC_TIMER    4
+
+/* Readiness bits (poll() values). */
+#define EV_IN  0x1
+#define EV_OUT 0x4
+
+#define EV_MAX_SOURCES 16 /* per set */
+#define EV_MAX_BATCH   16 /* per EV_WAIT */
+
+struct ev_source {
+  int32_t src;     /* EV_SRC_* */
+  uint32_t events; /* EV_SRC_FD: EV_IN and/or EV_OUT; others: ignored */
+  int64_t arg;
+  uint64_t udata;
+};
+
+struct ev_event {
+  uint32_t events; /* EV_IN / EV_OUT */
+  int32_t src;     /* EV_SRC_* */
+  uint64_t udata;
+};
+
+#endif
@@ -6,6 +6,7 @@
 #define O_RDWR   2
 #define O_CREAT  0x0200
 #define O_APPEND 0x0400
+#define O_NONBLOCK 0x0800
 
 int open(const char *pathname, int flags, ...);
 
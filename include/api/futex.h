@@ -0,0 +1,37 @@
+/*
+ * include/api/futex.h
+ * SYS_FUTEX operations — shared by the kernel (kernel/sched/futex.c) and
+ * the userland sync library (sync.h).  #define-only, like syscall_nums.h.
+ *
+ *   futex(uaddr, FUTEX_WAIT, val, timeout_ms, 0, 0)
+ *       Sleep while *uaddr == val.  timeout_ms 0 waits forever.
+ *       0 when woken, -EAGAIN if *uaddr != val on entry, -ETIMEDOUT.
+ *   futex(uaddr, FUTEX_WAKE, n, 0, 0, 0)
+ *       Wake up to n waiters on uaddr; returns the number woken.
+ *   futex(uaddr, FUTEX_WAIT_PI, val, timeout_ms, 0, owner)
+ *       As FUTEX_WAIT, and while asleep lend the caller's scheduling
+ *       priority to thread owner (the lock holder's gettid(); ignored
+ *       unless it is another thread of this process, 0 for none), so a
+ *       low-priority holder is not starved while a high-priority thread
+ *       waits for it.  The holder gives the boost back on its FUTEX_WAKE.
+ *   futex(uaddr, FUTEX_REQUEUE, n, n2, uaddr2, 0)
+ *       Wake up to n waiters on uaddr and move up to n2 of the rest onto
+ *       uaddr2 without waking them; returns woken + moved.
+ *   futex(uaddr, FUTEX_CMP_REQUEUE, n, n2, uaddr2, val3)
+ *       As FUTEX_REQUEUE, but -EAGAIN unless *uaddr == val3.
+ *
+ * A futex is identified by the PHYSICAL address of the 32-bit word, so two
+ * processes that map the same page at different addresses meet on it.  The
+ * word must be 4-byte aligned.  The numbering matches Linux, except
+ * FUTEX_WAIT_PI (os1 only, outside Linux's range).
+ */
+#ifndef _API_FUTEX_H
+#define _API_FUTEX_H
+
+#define FUTEX_WAIT        0
+#define FUTEX_WAKE        1
+#define FUTEX_REQUEUE     3
+#define FUTEX_CMP_REQUEUE 4
+#define FUTEX_WAIT_PI     16
+
+#endif
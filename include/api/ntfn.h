@@ -0,0 +1,51 @@
+/*
+ * include/api/ntfn.h
+ * SYS_NTFN operations — notification objects, shared by the kernel
+ * (kernel/sched/ntfn.c) and userland (os1.h ntfn_* wrappers).
+ *
+ * A notification is one 64-bit word of pending bits, for signals that
+ * carry no payload ("font changed", "child exited").  Signalling ORs bits
+ * in and never allocates or queues, so a signal repeated before the
+ * receiver gets to it costs nothing extra; waiting reads and clears the
+ * whole word at once.
+ *
+ *   ntfn(NTFN_CREATE, 0, 0)          -> handle
+ *   ntfn(NTFN_SIGNAL, h, bits)       -> 0
+ *   ntfn(NTFN_WAIT, h, &bits)        -> 0
+ *       Sleep until some bit is pending, then store and clear them all.
+ *   ntfn(NTFN_POLL, h, &bits)        -> 0
+ *       As NTFN_WAIT, but stores 0 instead of sleeping.
+ *   ntfn(NTFN_BIND, h, ep)           -> 0
+ *       Bind to endpoint handle ep, which the calling thread must serve.
+ *       From then on the server's receive-from-any (recv(-1), try_recv(-1),
+ *       ipc_reply_recv) also returns pending bits as a message of type
+ *       IPC_TYPE_NOTIFICATION with from = 0 and data1 = the bits, so one
+ *       blocking receive covers both.  The binding lives as long as the
+ *       endpoint and follows it to a respawned server.  Clients signal it
+ *       through their endpoint handle (EP_SIGNAL in <endpoint.h>).
+ *   ntfn(NTFN_SUBSCRIBE, h, mask)    -> 0
+ *       Have the kernel signal NTFN_SYS_* events to this object (mask 0
+ *       unsubscribes).
+ *   ntfn(NTFN_CLOSE, h, 0)           -> 0
+ */
+#ifndef _API_NTFN_H
+#define _API_NTFN_H
+
+#define NTFN_CREATE    0
+#define NTFN_SIGNAL    1
+#define NTFN_WAIT      2
+#define NTFN_POLL      3
+#define NTFN_BIND      4
+#define NTFN_SUBSCRIBE 5
+#define NTFN_CLOSE     6
+
+/* Kernel-raised bits (NTFN_SUBSCRIBE), kept clear of the low bits a
+ * program uses for its own signals. */
+#define NTFN_SYS_CHILD    (1ULL << 60) /* a child process exited */
+#define NTFN_SYS_FOCUS    (1ULL << 61) /* keyboard focus moved to / from us */
+#define NTFN_SYS_REGISTRY (1ULL << 62) /* some registry key was written */
+#define NTFN_SYS_FONT     (1ULL << 63) /* the system font was replaced */
+#define NTFN_SYS_ALL \
+  (NTFN_SYS_CHILD | NTFN_SYS_FOCUS | NTFN_SYS_REGISTRY | NTFN_SYS_FONT)
+
+#endif
@@ -16,6 +16,14 @@
 #include "syscall_nums.h"
 /* Privilege levels (PLVL_*) and capabilities (CAP_*) for spawn_caps (#79). */
 #include "caps.h"
+/* Scheduling classes (SCHED_NORMAL / SCHED_RT) for sched_setattr. */
+#include "sched.h"
+/* Scheduler event tracing (TRACE_* ops, struct trace_event) for trace_ctl(). */
+#include "trace.h"
+/* Sampling profiler (PROF_* ops, struct prof_sample) for prof_ctl(). */
+#include "prof.h"
+/* Per-thread hardware counters (PMU_* ops and events) for pmu_ctl(). */
+#include "pmu.h"
 
 /* --- System Constants --- */
 #define PROCESS_NAME_MAX 32
@@ -38,15 +46,24 @@ struct ps_info {
 
 /* Syscall Wrappers (Low-level) */
 extern long _sys_read(int fd, char *buf, unsigned long count);
-extern void _sys_write(int fd, const char *buf, size_t count);
+extern long _sys_write(int fd, const char *buf, size_t count);
 extern long _sys_get_time(void);
 extern int  _sys_get_pid(void);
+extern int  _sys_gettid(void);
 extern void _sys_exit(int status);
 extern int  _sys_spawn(const char *path, int argc, char *const argv[]);
 extern long _sys_spawn_caps(const char *path, int level, unsigned long caps);
+extern int  _sys_spawn_fds(const char *path, int argc, char *const argv[],
+                           const int *map, int nmap);
+extern int  _sys_pipe2(int fds[2], int flags);
 extern int  _sys_kill(int pid);
 extern int  _sys_wait(int pid);
 extern void _sys_yield(void);
+extern long _sys_sched_setattr(int pid, const struct sched_attr *attr);
+extern long _sys_sched_getattr(int pid, struct sched_attr *attr);
+extern long _sys_trace(int op, unsigned long a1, unsigned long a2);
+extern long _sys_prof(int op, unsigned long a1, unsigned long a2);
+extern long _sys_pmu(int op, unsigned long a1, unsigned long a2);
 extern void _sys_draw(int x, int y, int w, int h, int color);
 extern void _sys_flush(void);
 extern int  _sys_create_window(int x, int y, int w, int h, const char *title);
@@ -63,14 +80,42 @@ extern long _sys_registry(int op, const char *key, char *value, size_t size);
 extern long _sys_get_procs(void *procs, size_t max_count);
 extern int  _sys_file_write(const char *path, const void *buf, int size, int offset);
 extern int  _sys_file_read(const char *path, void *buf, int size, int offset);
-extern int  _sys_send(int pid, struct ipc_message *msg);
+extern int  _sys_send(int pid, struct ipc_message *msg, int flags);
 extern int  _sys_recv(int pid, struct ipc_message *msg);
+extern int  _sys_call(int pid, struct ipc_message *msg);
+extern int  _sys_reply_recv(int reply_pid, struct ipc_message *msg);
+extern int  _sys_ipc_set_depth(unsigned int depth);
 extern int  _sys_list_dir(const char *path, char *buf, size_t size);
 extern int  _sys_chdir(const char *path);
 extern int  _sys_getcwd(char *buf, size_t size);
 extern int  _sys_open(const char *path, int flags);
 extern int  _sys_close(int fd);
 extern long _sys_lseek(int fd, long offset, int whence);
+struct iovec;
+extern long _sys_readv(int fd, const struct iovec *iov, int iovcnt);
+extern long _sys_writev(int fd, const struct iovec *iov, int iovcnt);
+extern long _sys_pread(int fd, void *buf, size_t count, long offset);
+extern long _sys_pwrite(int fd, const void *buf, size_t count, long offset);
+extern long _sys_preadv(int fd, const struct iovec *iov, int iovcnt,
+                        long offset);
+extern long _sys_pwritev(int fd, const struct iovec *iov, int iovcnt,
+                         long offset);
+extern long _sys_thread_create(void (*entry)(void (*)(void *), void *),
+                               void *stack_top, void (*fn)(void *), void *arg,
+                               void *tls);
+extern void _sys_thread_exit(int code);
+extern int  _sys_thread_join(int tid, int *code);
+extern int  _sys_set_tls(void *base);
+extern long _sys_futex(uint32_t *uaddr, int op, uint32_t val,
+                       unsigned long arg3, uint32_t *uaddr2, uint32_t val3);
+extern long _sys_endpoint(int op, long a1, long a2, long a3);
+extern long _sys_channel(int op, long a1, long a2, void *info);
+extern long _sys_event(int op, long a1, long a2, long a3, long a4);
+extern long _sys_ntfn(int op, long a1, long a2);
+extern long _sys_uring(int op, long a1, long a2, void *info);
+extern long _sys_dmesg(char *buf, size_t size);
+extern long _sys_lockstat(char *buf, size_t size, int flags);
+extern long _sys_cpustat(char *buf, size_t size);
 
 /* Standard C-like Library Functions */
 long read(int fd, char *buf, unsigned long count);
@@ -85,6 +130,12 @@ int  spawn(const char *path);
  * copy at argc).  The kernel marshals the strings onto the child's stack and
  * sets argc/argv as main()'s first two arguments per the C ABI. */
 int  spawn_args(const char *path, int argc, char *const argv[]);
+/* spawn_fds: like spawn_args(), but the child's fd i starts as a copy of
+ * our fd map[i] for i < nmap (map[i] = -1 keeps the default: 0 keyboard,
+ * 1/2 its window or terminal, others closed).  Pipe ends are shared with
+ * the child, so close ours afterwards or the far end never sees EOF. */
+int  spawn_fds(const char *path, int argc, char *const argv[], const int *map,
+               int nmap);
 /* Sandboxed spawn (USR-SEC-03 #79).  level = PLVL_*; caps = OR of CAP_*.
  * The kernel clamps both: a child is never more privileged than its parent,
  * never above the level's ceiling, never more than the parent holds.
@@ -94,6 +145,38 @@ long spawn_level(const char *path, int level);
 int  kill_process(int pid);
 int  wait(int pid);
 void yield(void);
+/* Scheduling class of thread pid (0 = the caller): SCHED_NORMAL, or
+ * SCHED_RT with a runtime/period reservation — see <sched.h> for the
+ * admission and throttling rules.  0 or a negative errno. */
+int  sched_setattr(int pid, const struct sched_attr *attr);
+int  sched_getattr(int pid, struct sched_attr *attr);
+/* Scheduler event tracing: TRACE_START/STOP/READ/INFO, see <trace.h>.
+ * Root/machine level only.  Result of the op or a negative errno. */
+long trace_ctl(int op, unsigned long a1, unsigned long a2);
+/* Sampling profiler: PROF_START/STOP/READ/INFO, see <prof.h>.  Root/machine
+ * level only.  Result of the op or a negative errno. */
+long prof_ctl(int op, unsigned long a1, unsigned long a2);
+/* Per-thread hardware counters: PMU_READ/RESET/INFO, see <pmu.h>.  Result
+ * of the op or a negative errno. */
+long pmu_ctl(int op, unsigned long a1, unsigned long a2);
+
+/* Threads: share the caller's memory, heap, cwd and fds.  thread_create()
+ * runs fn(arg) on [stack, stack + size) — the caller owns that memory and
+ * may reuse it after thread_join() — and returns the thread id (> 0) or a
+ * negative errno.  Returning from fn is thread_exit(0).  Every thread must
+ * be joined to free its slot (16 threads per process, main included).
+ * get_pid() is the same in every thread, gettid() is the calling thread's
+ * id (== get_pid() in the main thread); exit() ends them all. */
+int  thread_create(void (*fn)(void *), void *arg, void *stack, size_t size);
+void thread_exit(int code);
+int  thread_join(int tid, int *code);
+int  gettid(void);
+/* set_tls: this thread's TLS pointer (TPIDR_EL0 / FS base). */
+int  set_tls(void *base);
+/* futex: raw SYS_FUTEX (ops and return values in <futex.h>).  Most code
+ * wants the mutex/condvar/semaphore wrappers in <sync.h> instead. */
+long futex(uint32_t *uaddr, int op, uint32_t val, unsigned long arg3,
+           uint32_t *uaddr2, uint32_t val3);
 int utf8_decode(const char *s, uint32_t *code);
 void sleep(int ticks);
 
@@ -103,11 +186,72 @@ void  free(void *ptr);
 void *realloc(void *ptr, size_t size);
 void *calloc(size_t nmemb, size_t size);
 
-/* IPC API */
+/* IPC API.  Each thread buffers at most IPC_RING_DEFAULT undelivered
+ * messages (ipc_set_depth() changes that, up to IPC_RING_MAX).  send() to a
+ * full buffer blocks until the receiver makes room; send_nonblock() returns
+ * -EAGAIN instead. */
 int send(int pid, struct ipc_message *msg);
+int send_nonblock(int pid, struct ipc_message *msg);
 int recv(int pid, struct ipc_message *msg);
 int try_recv(int pid, struct ipc_message *msg);
+/* Synchronous call/reply.  ipc_call() sends *msg to pid and blocks until
+ * that process answers; the reply overwrites *msg.  A server loops on
+ * ipc_reply_recv(): it answers reply_pid (the previous request's msg.from;
+ * <= 0 for none) with *msg, then receives the next request into *msg.
+ * When the server is already waiting the kernel switches straight to it,
+ * so a round trip costs two syscalls and two context switches.  A plain
+ * send() from the called process also completes an ipc_call().
+ * ipc_reply_recv() receives nothing if its reply cannot be delivered:
+ * -ESRCH when reply_pid is gone, -EINVAL when it is not in ipc_call() on
+ * us. */
+int ipc_call(int pid, struct ipc_message *msg);
+int ipc_reply_recv(int reply_pid, struct ipc_message *msg);
+/* ipc_set_depth: resize the caller's receive buffer to 'slots' messages.
+ * -EBUSY if more are buffered right now than would fit. */
+int ipc_set_depth(unsigned int slots);
+/* Named endpoints (<endpoint.h>).  A server ep_create()s its service name
+ * once and then receives as usual (recv / ipc_reply_recv); clients
+ * ep_open() the name and send or call through the returned handle, which
+ * stays valid across a respawn of the server.  Negative errno on failure. */
+int ep_create(const char *name);
+int ep_open(const char *name);
+int ep_close(int h);
+int ep_send(int h, struct ipc_message *msg);
+int ep_send_nonblock(int h, struct ipc_message *msg);
+int ep_call(int h, struct ipc_message *msg);
+int ep_signal(int h, uint64_t bits);
+/* Notification objects (<ntfn.h>): a word of bits that ntfn_signal() ORs
+ * in and ntfn_wait() / ntfn_poll() read and clear.  Bound to an endpoint
+ * the caller serves (ntfn_bind), pending bits arrive through recv(-1) as
+ * an IPC_TYPE_NOTIFICATION message.  Negative errno on failure. */
+int ntfn_create(void);
+int ntfn_signal(int h, uint64_t bits);
+int ntfn_wait(int h, uint64_t *bits);
+int ntfn_poll(int h, uint64_t *bits);
+int ntfn_bind(int h, int ep);
+int ntfn_subscribe(int h, uint64_t mask);
+int ntfn_close(int h);
+/* Event sets (<event.h>): one blocking wait over fds, IPC, input, registry
+ * keys and periodic timers.  ev_add() returns a registration id for
+ * ev_del(); ev_wait() returns how many events it stored (0 on timeout,
+ * timeout_ms < 0 waits forever).  Negative errno on failure. */
+struct ev_event;
+int ev_create(void);
+int ev_add(int h, int src, long arg, unsigned int events, uint64_t udata);
+int ev_del(int h, int id);
+int ev_wait(int h, struct ev_event *out, int max, long timeout_ms);
+int ev_close(int h);
 int notify(const char *title, const char *msg);
+/* dmesg: copy the newest kernel log text (whole lines, at most size bytes,
+ * not NUL-terminated) into buf; returns the byte count. */
+long dmesg(char *buf, size_t size);
+/* lockstat: per-lock spinlock statistics as text (kernel built with
+ * LOCKSTAT=1, else -ENOSYS); flags LOCKSTAT_RESET zeroes them afterwards
+ * (root/machine only).  Bytes copied or a negative errno. */
+long lockstat(char *buf, size_t size, int flags);
+/* cpustat: per-CPU event counters (context switches, IRQs, page allocs and
+ * frees) and their totals as text.  Bytes copied or a negative errno. */
+long cpustat(char *buf, size_t size);
 
 /* Window Management & Graphics */
 int  create_window(int x, int y, int w, int h, const char *title);
@@ -137,6 +281,18 @@ int getcwd(char *buf, size_t size);
  * fd: 0=stdin, 1/2=own window, open()ed files >= 3. */
 int  close(int fd);
 long lseek(int fd, long offset, int whence);
+/* pread / pwrite: at an explicit offset, leaving the fd's own alone (files
+ * only).  The vectored forms are in sys/uio.h. */
+long pread(int fd, void *buf, size_t count, long offset);
+long pwrite(int fd, const void *buf, size_t count, long offset);
+/* pipe / pipe2: fds[0] reads what fds[1] writes, through a one-page kernel
+ * ring.  read() returns what is buffered and 0 once every write end is
+ * closed; write() blocks while the ring is full and loops over short
+ * counts, so it returns once all is queued (writes of at most PIPE_BUF
+ * bytes are never interleaved with another writer's).  Writing with no
+ * reader left fails -EPIPE.  flags: O_NONBLOCK (-EAGAIN, never sleep). */
+int  pipe(int fds[2]);
+int  pipe2(int fds[2], int flags);
 
 /* Formatting & Printing */
 void print(const char *s);
@@ -0,0 +1,69 @@
+/*
+ * include/api/pmu.h
+ * Per-thread hardware performance counters (SYS_PMU) — shared by the
+ * kernel (kernel/core/pmu.c) and userland (os1.h pmu_ctl(), top).
+ *
+ *   pmu_ctl(PMU_READ, tid, &counts)
+ *       Fill struct pmu_counts with thread tid's counts since it was created
+ *       or last reset.  tid 0 (or the caller's own tid) is exact to the
+ *       call; another thread's counts are as of its CPU's last context
+ *       switch or tick.  0, -ESRCH, or -EPERM for a thread of another
+ *       process that is not a descendant (root/machine may read any).
+ *   pmu_ctl(PMU_RESET, 0, 0)
+ *       Zero the caller's counts.  0.
+ *   pmu_ctl(PMU_INFO, &info, 0)
+ *       Fill struct pmu_info.  0.
+ *
+ * A thread is charged for everything its CPU does while it is current,
+ * kernel work included (its syscalls, interrupts that land on it).
+ * Events the CPU cannot count read 0 and are missing from the events mask:
+ *
+ *   event              amd64 (architectural PMCs)   aarch64 (PMUv3)
+ *   PMU_CYCLES         core cycles, 0x3C *          PMCCNTR_EL0
+ *   PMU_INSTRUCTIONS   instructions retired, 0xC0   INST_RETIRED
+ *   PMU_CACHE_MISSES   last-level misses, 0x2E/41   L1D_CACHE_REFILL
+ *   PMU_BRANCH_MISSES  branch mispredicts, 0xC5     BR_MIS_PRED
+ *
+ * * Without an architectural PMU (AMD parts, QEMU TCG; info.version 0)
+ *   amd64 counts PMU_CYCLES from the TSC: reference cycles at a fixed rate,
+ *   not core cycles.  QEMU TCG on aarch64 has the cycle counter, and
+ *   INST_RETIRED only when run with -icount.
+ *
+ * Reading another process's counts follows the SYS_KILL rule
+ * (process_kill_allowed): the counts are a side channel.
+ */
+#ifndef _API_PMU_H
+#define _API_PMU_H
+
+/* ops */
+#define PMU_READ  0
+#define PMU_RESET 1
+#define PMU_INFO  2
+
+/* events: indices into pmu_counts.count[], bits in the events masks */
+#define PMU_CYCLES        0
+#define PMU_INSTRUCTIONS  1
+#define PMU_CACHE_MISSES  2
+#define PMU_BRANCH_MISSES 3
+#define PMU_NR_EVENTS     4
+
+#define PMU_EV(e) (1u << (e))
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+
+struct pmu_counts {
+  uint64_t count[PMU_NR_EVENTS];
+  uint32_t events; /* PMU_EV() bits that are counted */
+  uint32_t pad;
+};
+
+struct pmu_info {
+  uint32_t events;    /* PMU_EV() bits that are counted */
+  uint32_t version;   /* arch PMU version, 0 if none */
+  uint32_t ncounters; /* programmable counters the PMU has */
+  uint32_t pad;
+};
+#endif
+
+#endif
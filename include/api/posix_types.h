@@ -104,6 +104,7 @@ typedef struct {
 #define ERANGE 34
 #define ENOSYS 38
 #define ENOTEMPTY 39
+#define ETIMEDOUT 110
 
 /* Success */
 #define EOK 0
@@ -120,6 +121,14 @@ typedef struct {
 #ifndef O_ACCMODE
 #define O_ACCMODE 3
 #endif
+/* pipe2(2) flag (open() still rejects it: files never block). */
+#ifndef O_NONBLOCK
+#define O_NONBLOCK 0x0800
+#endif
+
+/* Pipe writes of at most PIPE_BUF bytes are atomic: never split, never
+ * interleaved with another writer's (kernel/pipe.h). */
+#define PIPE_BUF 512
 
 /* lseek(2) whence */
 #ifndef SEEK_SET
@@ -162,6 +171,8 @@ typedef struct {
 #define IPC_TYPE_RAW 0
 #define IPC_TYPE_INPUT 1
 #define IPC_TYPE_NOTIFY 0x100
+#define IPC_TYPE_CHANNEL 0x101 /* channel offer (<channel.h>) */
+#define IPC_TYPE_NOTIFICATION 0x102 /* bound notification bits in data1 (<ntfn.h>) */
 #define IPC_TYPE_MOUSE 4
 
 /* IPC message structure */
@@ -173,4 +184,15 @@ struct ipc_message {
   char payload[64];
 };
 
+/* Per-thread receive buffer depth in messages (ipc_set_depth()).  A full
+ * buffer blocks send() until the receiver drains one, or fails it with
+ * -EAGAIN when IPC_NONBLOCK is passed (send_nonblock()).  Messages the
+ * kernel itself sends (input events) are dropped when the buffer is full. */
+#define IPC_RING_DEFAULT 32
+#define IPC_RING_MAX     256
+#define IPC_NONBLOCK     1
+
+/* lockstat(buf, size, flags): zero the lock statistics after reading them. */
+#define LOCKSTAT_RESET   1
+
 #endif /* _POSIX_TYPES_H */
@@ -0,0 +1,88 @@
+/*
+ * include/api/prof.h
+ * Statistical sampling profiler (SYS_PROF) — shared by the kernel
+ * (kernel/lib/prof.c), userland (os1.h prof_ctl(), /bin/prof) and the host
+ * folder (tools/prof2folded.py), which reads this layout.
+ *
+ *   prof_ctl(PROF_START, hz, 0)
+ *       Discard whatever is buffered and sample every CPU hz times a second
+ *       (PROF_MIN_HZ..PROF_MAX_HZ; 0 picks PROF_DEFAULT_HZ).  0, -EINVAL for
+ *       a rate out of range, -ENOMEM if the buffers cannot be allocated
+ *       (first start only).
+ *   prof_ctl(PROF_STOP, 0, 0)
+ *       Stop sampling; buffered samples stay readable.  Returns the rate
+ *       that was active.
+ *   prof_ctl(PROF_READ, buf, size)
+ *       Move up to size bytes of whole struct prof_sample records out of
+ *       the buffers, one CPU after another; returns the bytes written, 0
+ *       once drained.  Samples are consumed.
+ *   prof_ctl(PROF_INFO, &info, 0)
+ *       Fill struct prof_info.
+ *
+ * The sampling interrupt is the per-CPU timer run faster than the
+ * scheduler tick while profiling (amd64: LAPIC timer at a multiple of HZ;
+ * aarch64: extra CNTV compare deadlines between ticks).  Each sample is the
+ * interrupted PC plus up to PROF_MAX_FRAMES - 1 return addresses from the
+ * frame-pointer chain of the mode it interrupted: kernel addresses resolve
+ * against the kernel's .ksyms, user ones against the ELF named by comm
+ * (every user ELF is linked at the same base).  A sample taken in the
+ * kernel does not include the user stack below the syscall.  Each CPU
+ * samples into its own ring with no shared lock; a full ring drops new
+ * samples and counts them in info.lost.  Root and machine level only.
+ */
+#ifndef _API_PROF_H
+#define _API_PROF_H
+
+/* ops */
+#define PROF_START 0
+#define PROF_STOP  1
+#define PROF_READ  2
+#define PROF_INFO  3
+
+#define PROF_MIN_HZ     100
+#define PROF_MAX_HZ     10000
+#define PROF_DEFAULT_HZ 1000
+
+#define PROF_MAX_FRAMES 8
+
+/* struct prof_sample.flags */
+#define PROF_S_USER 1 /* pc[] are user addresses */
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+
+struct prof_sample {
+  uint64_t ts;    /* CPU counter, info.clock_hz */
+  uint32_t pid;   /* thread id, 0 before the first task */
+  uint8_t cpu;
+  uint8_t flags;  /* PROF_S_* */
+  uint8_t depth;  /* valid pc[] entries, >= 1 */
+  uint8_t pad;
+  char comm[16];  /* process name, NUL-terminated */
+  uint64_t pc[PROF_MAX_FRAMES]; /* pc[0] sampled, then callers */
+};
+
+struct prof_info {
+  uint64_t clock_hz;       /* ts ticks per second */
+  uint64_t lost;           /* samples dropped on full rings since PROF_START */
+  uint32_t hz;             /* sampling now, 0 when stopped */
+  uint32_t ncpu;           /* CPUs with a ring */
+  uint32_t ring_samples;   /* capacity of each ring */
+  uint32_t pad;
+};
+
+/* Saved profile (/bin/prof save, tools/prof2folded.py): this header, then
+ * nsamples struct prof_sample.  The file may be longer; the rest is
+ * padding. */
+#define PROF_FILE_MAGIC   "OS1PROF\0"
+#define PROF_FILE_VERSION 1
+
+struct prof_file_header {
+  char magic[8];         /* PROF_FILE_MAGIC */
+  uint32_t version;      /* PROF_FILE_VERSION */
+  uint32_t nsamples;
+  struct prof_info info; /* PROF_INFO at save time */
+};
+#endif
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * include/api/sched.h
+ * Scheduling classes (SYS_SCHED_SETATTR / SYS_SCHED_GETATTR) — shared by
+ * the kernel (kernel/sched/process.c) and userland (os1.h sched_setattr()).
+ *
+ *   SCHED_NORMAL  the default: priority queues (0 high .. 31 low), sliced
+ *                 by the timer tick, work stolen between CPUs.
+ *   SCHED_RT      fixed-priority real-time class for latency-critical
+ *                 services.  An RT thread runs ahead of every SCHED_NORMAL
+ *                 thread of its CPU — a running CPU hog is preempted at the
+ *                 next tick — and ahead of lower RT priorities (rt_prio 0
+ *                 is the highest of RT_PRIO_LEVELS).  Equal priorities take
+ *                 turns tick by tick.
+ *
+ * Every SCHED_RT thread holds a reservation of runtime_ms of CPU in every
+ * period_ms.  Admission control refuses (-EBUSY) a reservation that would
+ * take the RT total above RT_BW_ADMIT per mille of the online CPUs, so half
+ * the machine always stays with everyone else.  A thread that has used its
+ * runtime is throttled: it runs as SCHED_NORMAL at its normal priority
+ * until its period ends and the budget is replenished.  Independently,
+ * each CPU gives RT threads at most 95 of every 100 ticks while anything
+ * else is runnable there, so even a set of well-behaved reservations
+ * cannot freeze a core.
+ *
+ * Time is accounted in timer ticks (10 ms at HZ=100): runtime rounds up to
+ * a whole tick, period down, and a thread is charged for each tick it is
+ * found running on.
+ *
+ * Only root and machine level may enter SCHED_RT (-EPERM); any thread may
+ * drop back to SCHED_NORMAL.  pid 0 is the caller; any other pid is one
+ * thread (a process's main thread has pid == its get_pid()).  Spawned
+ * children and new threads start in SCHED_NORMAL.  init sets the class of
+ * the services listed with rt= in /etc/init.cfg.
+ */
+#ifndef _API_SCHED_H
+#define _API_SCHED_H
+
+#include <stdint.h>
+
+#define SCHED_NORMAL 0
+#define SCHED_RT     1
+
+#define RT_PRIO_LEVELS 8
+#define RT_BW_ADMIT    500 /* per mille of each online CPU */
+
+struct sched_attr {
+  uint32_t policy;     /* SCHED_NORMAL or SCHED_RT */
+  uint32_t rt_prio;    /* SCHED_RT: 0 (highest) .. RT_PRIO_LEVELS - 1 */
+  uint32_t runtime_ms; /* SCHED_RT: CPU time reserved per period */
+  uint32_t period_ms;  /* SCHED_RT: 10 .. 10000 */
+};
+
+#endif
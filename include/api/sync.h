@@ -0,0 +1,81 @@
+/*
+ * include/api/sync.h
+ * Userland mutexes, condition variables and semaphores on top of SYS_FUTEX
+ * (user/sys/lib/sync.c).
+ *
+ * All three keep their state in ordinary memory and only enter the kernel
+ * to sleep or to wake a sleeper: an uncontended mutex_lock/mutex_unlock,
+ * cond_signal with nobody waiting, and sem_post/sem_wait on a positive count
+ * are atomics only — zero syscalls.  Objects work between threads of one
+ * process and, when placed in memory shared between processes, across
+ * processes too (futexes are keyed by physical address).
+ *
+ * Static initialisers: MUTEX_INIT, MUTEX_INIT_PI, COND_INIT, SEM_INIT(n);
+ * or call the *_init functions.  No destroy is needed — nothing is allocated.
+ *
+ * Return values follow the syscall error model: 0 on success, a negative
+ * errno on failure.  The *_timed variants take a relative timeout in
+ * milliseconds (jiffies granularity, 10 ms) and return -ETIMEDOUT.
+ */
+#ifndef _API_SYNC_H
+#define _API_SYNC_H
+
+#include <stdint.h>
+
+/* state: 0 unlocked, 1 locked, 2 locked with (possible) waiters.
+ * pi: priority-inheriting (MUTEX_INIT_PI / mutex_init_pi); owner is then
+ * the holder's gettid(), which a waiter lends its priority to. */
+typedef struct {
+  uint32_t state;
+  uint32_t owner;
+  uint32_t pi;
+} mutex_t;
+
+/* seq is bumped by every signal/broadcast; waiters counts threads between
+ * cond_wait's registration and its re-lock, so signalling an idle condvar
+ * costs no syscall.  mutex is the one its waiters use (broadcast requeues
+ * onto it); every waiter must pass the same mutex. */
+typedef struct {
+  uint32_t seq;
+  uint32_t waiters;
+  mutex_t *mutex;
+} cond_t;
+
+typedef struct {
+  uint32_t value;
+  uint32_t waiters;
+} sem_t;
+
+#define MUTEX_INIT {0, 0, 0}
+#define MUTEX_INIT_PI {0, 0, 1}
+#define COND_INIT {0, 0, 0}
+#define SEM_INIT(n) {(n), 0}
+
+void mutex_init(mutex_t *m);
+/* mutex_init_pi: a mutex whose waiters lend their scheduling priority to
+ * the holder (FUTEX_WAIT_PI), so a low-priority holder cannot be starved by
+ * unrelated work while a high-priority thread waits.  Costs one gettid()
+ * syscall per acquisition; use it for locks shared with RT threads. */
+void mutex_init_pi(mutex_t *m);
+void mutex_lock(mutex_t *m);
+/* mutex_trylock: 0 if acquired, -EBUSY if held. */
+int  mutex_trylock(mutex_t *m);
+int  mutex_lock_timed(mutex_t *m, long timeout_ms);
+void mutex_unlock(mutex_t *m);
+
+void cond_init(cond_t *c);
+/* cond_wait: atomically release m and sleep until signalled, then re-acquire
+ * m.  Wake-ups may be spurious: re-check the predicate in a loop. */
+int  cond_wait(cond_t *c, mutex_t *m);
+int  cond_wait_timed(cond_t *c, mutex_t *m, long timeout_ms);
+void cond_signal(cond_t *c);
+void cond_broadcast(cond_t *c);
+
+void sem_init(sem_t *s, uint32_t value);
+int  sem_wait(sem_t *s);
+/* sem_trywait: 0 if decremented, -EAGAIN if the count is zero. */
+int  sem_trywait(sem_t *s);
+int  sem_wait_timed(sem_t *s, long timeout_ms);
+void sem_post(sem_t *s);
+
+#endif
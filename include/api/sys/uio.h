@@ -0,0 +1,32 @@
+/*
+ * include/api/sys/uio.h
+ * Vectored and positional fd I/O (SYS_READV .. SYS_PWRITEV), shared by the
+ * kernel (kernel/core/syscall_dispatch.c) and userland (user/sys/lib/lib.c).
+ *
+ * All the segments of one call move in a single VFS read or write through
+ * one kernel bounce buffer, so a header + payload write or a scattered
+ * record read is one syscall and one disk pass.  The p* forms take an
+ * explicit offset and leave the fd's own offset alone; on stdin and window
+ * fds they fail with -ESPIPE.  readv on stdin returns one key into the
+ * first non-empty segment, as read() does; writev on a window fd writes
+ * the gathered text at once.  At most IOV_MAX segments and
+ * 16 MiB in total per call (-EINVAL).
+ */
+#ifndef _SYS_UIO_H
+#define _SYS_UIO_H
+
+#include "../posix_types.h"
+
+struct iovec {
+  void *iov_base;
+  size_t iov_len;
+};
+
+#define IOV_MAX 64
+
+long readv(int fd, const struct iovec *iov, int iovcnt);
+long writev(int fd, const struct iovec *iov, int iovcnt);
+long preadv(int fd, const struct iovec *iov, int iovcnt, long offset);
+long pwritev(int fd, const struct iovec *iov, int iovcnt, long offset);
+
+#endif
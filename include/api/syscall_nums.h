@@ -3,7 +3,7 @@
  * NEXS syscall numbers — THE single source of truth (ABI-01/ABI-SYS-01).
  *
  * Included by BOTH sides of the ABI:
- *   - kernel/core/syscall_dispatch.c (the dispatch switch)
+ *   - kernel/core/syscall_dispatch.c (the syscall table, indexed by these)
  *   - include/api/os1.h (userland API)
  *   - user/arch/{aarch64,amd64}/syscall.S and user/sys/lib/syscall.S
  *     (the .S stubs are preprocessed, so they use these macros directly)
@@ -13,7 +13,7 @@
  * #define-only on purpose: this header must stay assembler-safe.
  *
  * Numbering: the POSIX-shaped calls keep their Linux-aarch64 numbers
- * (63/64/93/169/172) for familiarity; NEXS-specific calls live in the
+ * (56-70/93/169/172) for familiarity; NEXS-specific calls live in the
  * 200..299 block.  The legacy duplicate IPC numbers (30/31/32) are GONE:
  * SEND/RECV/TRY_RECV are 230/231/233 only.
  *
@@ -28,12 +28,20 @@
 /* --- POSIX-shaped --- */
 #define SYS_OPEN               56  /* open(path, flags) -> fd (ABI-03) */
 #define SYS_CLOSE              57
+#define SYS_PIPE2              59  /* pipe2(fds, flags) — FD_PIPE ends, os1.h pipe() */
 #define SYS_LSEEK              62
 #define SYS_READ               63
 #define SYS_WRITE              64
+#define SYS_READV              65  /* readv(fd, iov, iovcnt) — <sys/uio.h> */
+#define SYS_WRITEV             66  /* writev(fd, iov, iovcnt) */
+#define SYS_PREAD64            67  /* pread(fd, buf, count, offset) */
+#define SYS_PWRITE64           68  /* pwrite(fd, buf, count, offset) */
+#define SYS_PREADV             69  /* preadv(fd, iov, iovcnt, offset) */
+#define SYS_PWRITEV            70  /* pwritev(fd, iov, iovcnt, offset) */
 #define SYS_EXIT               93
 #define SYS_GET_TIME           169
 #define SYS_GETPID             172
+#define SYS_GETTID             178  /* gettid() — this thread's id */
 
 /* --- Graphics / compositor --- */
 #define SYS_DRAW               200
@@ -53,17 +61,39 @@
 
 /* --- Processes --- */
 #define SYS_SPAWN              220
+#define SYS_SPAWN_FDS          224  /* spawn_fds(path, argc, argv, map, nmap) — child fds from ours */
 #define SYS_KILL               221
 #define SYS_GETPROCS           222
 #define SYS_YIELD              223
+#define SYS_SCHED_SETATTR      225  /* sched_setattr(pid, attr) — <sched.h> classes */
+#define SYS_SCHED_GETATTR      226  /* sched_getattr(pid, attr) */
+#define SYS_TRACE              227  /* trace(op, a1, a2) — <trace.h> event tracing */
+#define SYS_LOCKSTAT           228  /* lockstat(buf, size, flags) — spinlock statistics */
+#define SYS_CPUSTAT            229  /* cpustat(buf, size) — per-CPU counters */
+#define SYS_PROF               249  /* prof(op, a1, a2) — <prof.h> sampling profiler */
 #define SYS_SPAWN_CAPS         234  /* spawn_caps(path, level, caps) — USR-SEC-03 #79 */
 #define SYS_WAIT               247
 
+/* --- Threads --- */
+#define SYS_THREAD_CREATE      235  /* thread_create(entry, stack_top, arg0, arg1, tls) */
+#define SYS_THREAD_EXIT        236  /* thread_exit(code) — calling thread only */
+#define SYS_THREAD_JOIN        237  /* thread_join(tid, &code) */
+#define SYS_SET_TLS            238  /* set_tls(base) — TPIDR_EL0 / FS base */
+#define SYS_FUTEX              239  /* futex(uaddr, op, val, timeout|nr2, uaddr2, val3) — <futex.h> */
+
 /* --- IPC --- */
 #define SYS_SEND               230
 #define SYS_RECV               231
 #define SYS_SET_FOCUS          232
 #define SYS_TRY_RECV           233
+#define SYS_CALL               240  /* ipc_call(pid, msg) — send, block for the reply */
+#define SYS_REPLY_RECV         241  /* ipc_reply_recv(reply_pid, msg) — reply, then receive */
+#define SYS_IPC_SET_DEPTH      242  /* ipc_set_depth(slots) — resize own receive ring */
+#define SYS_ENDPOINT           243  /* endpoint(op, a1, a2, a3) — include/api/endpoint.h */
+#define SYS_CHANNEL            244  /* channel(op, a1, a2, a3) — include/api/channel.h */
+#define SYS_EVENT              245  /* event(op, a1, a2, a3, a4) — include/api/event.h */
+#define SYS_NTFN               246  /* ntfn(op, a1, a2) — include/api/ntfn.h */
+#define SYS_URING              248  /* uring(op, a1, a2, a3) — include/api/uring.h */
 
 /* --- Registry / files / misc --- */
 #define SYS_REGISTRY           250
@@ -73,5 +103,10 @@
 #define SYS_LIST_DIR           254
 #define SYS_CHDIR              255
 #define SYS_GETCWD             256
+#define SYS_DMESG              257  /* dmesg(buf, size) — kernel log tail (kernel/klog.h) */
+#define SYS_PMU                258  /* pmu(op, a1, a2) — <pmu.h> per-thread counters */
+
+/* One past the highest number: the size of the kernel's syscall table. */
+#define SYS_NR                 259
 
 #endif /* _SYSCALL_NUMS_H */
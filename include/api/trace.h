@@ -0,0 +1,99 @@
+/*
+ * include/api/trace.h
+ * Scheduler event tracing (SYS_TRACE) — shared by the kernel
+ * (kernel/lib/trace.c), userland (os1.h trace_ctl(), /bin/trace) and the host
+ * decoder (tools/trace2json.py), which reads this layout.
+ *
+ *   trace_ctl(TRACE_START, mask, 0)
+ *       Discard whatever is buffered and record the event types whose bit
+ *       is set in mask (1 << TRACE_EV_*; TRACE_MASK_ALL for everything).
+ *       0, -EINVAL for an unknown bit, -ENOMEM if the buffers cannot be
+ *       allocated (first start only).
+ *   trace_ctl(TRACE_STOP, 0, 0)
+ *       Stop recording; buffered events stay readable.  Returns the mask
+ *       that was active.
+ *   trace_ctl(TRACE_READ, buf, size)
+ *       Move up to size bytes of whole struct trace_event records out of
+ *       the buffers, one CPU after another; returns the bytes written, 0
+ *       once drained.  Works while recording: events are consumed, so the
+ *       reader should keep up.  Records are in order within a CPU only;
+ *       sort on ts to merge CPUs.
+ *   trace_ctl(TRACE_INFO, &info, 0)
+ *       Fill struct trace_info.
+ *
+ * Each CPU records into its own ring with no shared lock; a full ring
+ * drops new events and counts them in info.lost.  ts is the raw CPU
+ * counter (TSC / CNTVCT), info.clock_hz ticks per second.  Root and
+ * machine level only (-EPERM): the trace shows every process.
+ */
+#ifndef _API_TRACE_H
+#define _API_TRACE_H
+
+/* ops */
+#define TRACE_START 0
+#define TRACE_STOP  1
+#define TRACE_READ  2
+#define TRACE_INFO  3
+
+/* Event types: struct trace_event.type, and bit n of the START mask.
+ *   SWITCH     pid -> arg0 on this CPU; arg1 = outgoing state (PROC_*
+ *              numbering, kernel/sched.h) | TRACE_SW_* reason << 8
+ *   WAKEUP     pid made runnable on CPU arg0 by thread arg1 (0: kernel)
+ *   MIGRATE    pid moved from CPU arg0 to CPU arg1
+ *   IRQ_ENTRY  interrupt arg0 taken while pid ran; IRQ_EXIT its end
+ *   SYS_ENTRY  pid entered syscall arg0 (SYS_*)
+ *   SYS_EXIT   pid left syscall arg0 with result arg1 (truncated; 0 for
+ *              calls that blocked or switched, which own their result) */
+#define TRACE_EV_SWITCH    0
+#define TRACE_EV_WAKEUP    1
+#define TRACE_EV_MIGRATE   2
+#define TRACE_EV_IRQ_ENTRY 3
+#define TRACE_EV_IRQ_EXIT  4
+#define TRACE_EV_SYS_ENTRY 5
+#define TRACE_EV_SYS_EXIT  6
+#define TRACE_EV_NR        7
+#define TRACE_MASK_ALL     ((1 << TRACE_EV_NR) - 1)
+
+/* TRACE_EV_SWITCH reasons */
+#define TRACE_SW_PREEMPT 0 /* still runnable: tick, yield or a better task */
+#define TRACE_SW_BLOCK   1 /* went to sleep */
+#define TRACE_SW_EXIT    2 /* exited or was killed */
+#define TRACE_SW_HANDOFF 3 /* IPC call/reply switched straight to arg0 */
+
+#ifndef __ASSEMBLER__
+#include <stdint.h>
+
+struct trace_event {
+  uint64_t ts;   /* CPU counter, info.clock_hz */
+  uint16_t type; /* TRACE_EV_* */
+  uint8_t cpu;
+  uint8_t pad;
+  uint32_t pid;  /* thread id */
+  uint32_t arg0;
+  uint32_t arg1;
+};
+
+struct trace_info {
+  uint64_t clock_hz;    /* ts ticks per second */
+  uint64_t lost;        /* events dropped on full rings since TRACE_START */
+  uint32_t mask;        /* recording now */
+  uint32_t ncpu;        /* CPUs with a ring */
+  uint32_t ring_events; /* capacity of each ring */
+  uint32_t pad;
+};
+
+/* Saved trace file (/bin/trace save, tools/trace2json.py): this header,
+ * then nevents struct trace_event in the order TRACE_READ returned them.
+ * The file may be longer than that; the rest is padding. */
+#define TRACE_FILE_MAGIC   "OS1TRACE"
+#define TRACE_FILE_VERSION 1
+
+struct trace_file_header {
+  char magic[8];          /* TRACE_FILE_MAGIC, no NUL */
+  uint32_t version;       /* TRACE_FILE_VERSION */
+  uint32_t nevents;
+  struct trace_info info; /* TRACE_INFO at save time */
+};
+#endif
+
+#endif
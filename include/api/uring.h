@@ -0,0 +1,135 @@
+/*
+ * include/api/uring.h
+ * Submission / completion rings for batched syscalls — SYS_URING
+ * operations and the ring layout shared by the kernel
+ * (kernel/sched/uring.c) and the userland library (user/sys/lib/uring.c,
+ * uring_* below).
+ *
+ * A process queues syscalls as submission entries (SQEs) in pages it
+ * shares with the kernel and collects their results as completion entries
+ * (CQEs) tagged with its own user_data, so a burst of small calls — one
+ * rectangle, one line of text, one file chunk each — costs one trap, or
+ * none at all with a polling kernel thread.
+ *
+ *   uring(URING_SETUP, entries, flags, &info)  -> 0
+ *       Create the caller's ring: 'entries' SQ slots (a power of two in
+ *       [1, URING_ENTRIES_MAX]) and twice as many CQ slots, mapped at
+ *       info.base.  One ring per process (-EBUSY); its threads share it.
+ *       URING_SETUP_SQPOLL also starts a kernel thread in the process that
+ *       consumes the SQ as it fills and sleeps after URING_SQPOLL_IDLE_MS
+ *       without work, setting URING_SQ_NEED_WAKEUP.
+ *   uring(URING_ENTER, to_submit, flags, 0)    -> SQEs consumed
+ *       Run up to to_submit queued SQEs in order and post their CQEs.
+ *       Stops early when the CQ is full; -EBUSY while another thread of
+ *       the process is inside URING_ENTER.  With SQPOLL nothing runs here:
+ *       URING_ENTER_SQ_WAKEUP wakes the poller, and the call returns 0.
+ *   uring(URING_DESTROY, 0, 0, 0)              -> 0
+ *       Unmap the ring (a running poller finishes its current SQE and
+ *       leaves).  Exit destroys it too.
+ *
+ * An SQE names a syscall by its SYS_* number and carries its arguments;
+ * the CQE's res is that syscall's return value.  Only calls that never
+ * block are accepted: the window, draw and text calls, lseek, open /
+ * close / pipe2, the whole-file calls, the positional fd calls
+ * (sys/uio.h), the registry and try_recv, plus read / readv / write /
+ * writev and SYS_SEND in their non-blocking forms (-EAGAIN instead of
+ * sleeping on an empty stdin, an empty or full pipe, or a full receiver).  Anything else completes
+ * with -EINVAL, an unknown number with -ENOSYS, and non-zero SQE flags
+ * with -EINVAL.
+ *
+ * Layout: one header page (struct uring_shared), then the SQE array at
+ * sq_off and the CQE array at cq_off.  The four ring counters are free
+ * running (index = counter & (entries - 1)), each on its own cache line;
+ * the user owns sq_tail and cq_head, the kernel sq_head and cq_tail.
+ * SQEs are copied out before they run, so a slot is free for reuse as
+ * soon as sq_head has passed it.  A SQPOLL client that wants to sleep for
+ * completions sets cq_wait to 1 and FUTEX_WAITs on it; the kernel clears
+ * it and wakes after posting (the chan_shared wait-word protocol).
+ */
+#ifndef _API_URING_H
+#define _API_URING_H
+
+#include <stdint.h>
+
+#define URING_SETUP   0
+#define URING_ENTER   1
+#define URING_DESTROY 2
+
+#define URING_ENTRIES_MAX 128
+
+/* URING_SETUP flags */
+#define URING_SETUP_SQPOLL 1
+#define URING_SQPOLL_IDLE_MS 10
+
+/* URING_ENTER flags */
+#define URING_ENTER_SQ_WAKEUP 1
+
+/* uring_shared.sq_flags (written by the kernel only) */
+#define URING_SQ_NEED_WAKEUP 1
+
+struct uring_sqe {
+  uint32_t op;        /* SYS_* number */
+  uint32_t flags;     /* must be 0 */
+  uint64_t user_data; /* copied into the CQE */
+  uint64_t args[6];
+};
+
+struct uring_cqe {
+  uint64_t user_data;
+  int64_t res; /* the syscall's return value */
+};
+
+struct uring_shared {
+  uint32_t sq_tail;   /* SQEs ever queued (user) */
+  uint32_t _pad0[15];
+  uint32_t sq_head;   /* SQEs ever consumed (kernel) */
+  uint32_t sq_flags;  /* URING_SQ_* */
+  uint32_t _pad1[14];
+  uint32_t cq_tail;   /* CQEs ever posted (kernel) */
+  uint32_t cq_wait;   /* 1 while the user sleeps for a completion */
+  uint32_t _pad2[14];
+  uint32_t cq_head;   /* CQEs ever consumed (user) */
+  uint32_t _pad3[15];
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+  uint32_t sq_off;    /* byte offset of the SQE array from the base */
+  uint32_t cq_off;    /* byte offset of the CQE array from the base */
+  uint32_t setup_flags;
+};
+
+/* Filled in by URING_SETUP. */
+struct uring_info {
+  uint64_t base; /* user address of the struct uring_shared page */
+  uint32_t sq_entries;
+  uint32_t cq_entries;
+};
+
+/* Userland library.  Fill SQEs from uring_get_sqe() (NULL when the SQ is
+ * full), hand them over with uring_submit(), then drain results with
+ * uring_peek_cqe() / uring_wait_cqe() and uring_cqe_seen(). */
+typedef struct {
+  struct uring_shared *shm;
+  struct uring_sqe *sqes;
+  struct uring_cqe *cqes;
+  uint32_t sq_mask, cq_mask;
+  uint32_t sq_tail; /* local: SQEs handed out, published by uring_submit */
+  uint32_t flags;   /* URING_SETUP_* */
+} uring_t;
+
+int  uring_init(uring_t *u, uint32_t entries, uint32_t flags);
+void uring_exit(uring_t *u);
+/* uring_get_sqe: next free SQE, zeroed except op / user_data, or NULL. */
+struct uring_sqe *uring_get_sqe(uring_t *u, uint32_t op, uint64_t user_data);
+/* uring_submit: publish every SQE handed out and run all that are queued,
+ * including any a full CQ held back (one trap), or wake the poller if it
+ * sleeps.  Returns the count the kernel consumed
+ * (SQPOLL: the count published), or a negative errno. */
+long uring_submit(uring_t *u);
+/* uring_peek_cqe: 0 and *cqe = the oldest unseen CQE, or -EAGAIN. */
+int  uring_peek_cqe(uring_t *u, struct uring_cqe **cqe);
+/* uring_wait_cqe: as uring_peek_cqe, but submits / sleeps until a CQE is
+ * there.  -EAGAIN without SQPOLL when nothing is queued to produce one. */
+int  uring_wait_cqe(uring_t *u, struct uring_cqe **cqe);
+void uring_cqe_seen(uring_t *u);
+
+#endif
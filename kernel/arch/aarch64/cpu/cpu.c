@@ -4,7 +4,7 @@
  *
  * Role:
  *   This file owns three distinct concerns for the AArch64 port:
- *   1. Per-CPU hardware initialisation (CPACR, NEON, VBAR installation).
+ *   1. Per-CPU hardware initialisation (CPACR/lazy FP trap, VBAR installation).
  *   2. The C-level synchronous exception handler (sync_handler), which is the
  *      top of the dispatch chain entered from exception.S's vector_stub macro.
  *      It decodes ESR_EL1.EC and routes to the syscall handler, the memory-probe
@@ -18,8 +18,8 @@
  *     paths (see is_kernel_user_access_fault branch).
  *   - arch_vmm_init_hw must be called exactly once on the primary CPU before any
  *     secondary CPU is woken; secondaries read secondary_ttbr0 after this point.
- *   - CPACR_EL1.FPEN is set to 0b11 on every CPU so that the full NEON register
- *     set can be saved/restored by exception.S (q0–q31, FPSR, FPCR).
+ *   - CPACR_EL1.FPEN starts trapping on every CPU; NEON state is never part of
+ *     the exception frame and is switched lazily per task (fpu.c).
  *
  * Known issues:
  *   ARCH-04 (W2 BAD-IMPL·BUG)  FDT memory parse often fails; the manual probe
@@ -42,6 +42,7 @@
  *            documented or enforced. A future refactor of uaccess critical
  *            sections could silently violate this coupling.
  */
+#include <arch/fpsimd.h>
 #include <kernel/printk.h>
 #include <kernel/string.h>
 #include <kernel/types.h>
@@ -49,6 +50,8 @@
 /* Exception frame structure */
 #include <kernel/cpu.h>
 #include <kernel/fault.h>
+#include <kernel/fpu.h>
+#include <kernel/pmu.h>
 #include <kernel/sched.h>
 
 #include <kernel/arch.h>
@@ -64,7 +67,7 @@ extern uint32_t nr_cpus;
  * aarch64 has no IST: an EL1-from-EL1 sync abort or SError re-uses SP_EL1,
  * so a kernel-stack overflow or a fault with a wild SP recursed until silent
  * death.  handle_el1_spx_sync/serror (exception.S) switch onto
- * arch_fault_stack_top[cpu] before building the 816-byte frame; the original
+ * arch_fault_stack_top[cpu] before building the exception frame; the original
  * SP is parked in the 16-byte slot directly above the frame so the C handler
  * can both report it and copy the frame back for resuming paths (probe fixup).
  *
@@ -77,7 +80,8 @@ uint64_t arch_fault_stack_top[MAX_CPUS]; /* read by exception.S vectors */
 
 /*
  * arch_frame_on_fault_stack - is this exception frame on a per-CPU fault stack?
- * Used by sync_handler to know whether the parked-SP slot at frame+816 exists
+ * Used by sync_handler to know whether the parked-SP slot just above the frame
+ * exists
  * and whether a resuming path must copy the frame back to the original stack.
  */
 int arch_frame_on_fault_stack(const void *frame) {
@@ -109,10 +113,9 @@ extern void exception_vectors_install(void);
  * Actions performed on each CPU:
  *   1. Records cpu_id and marks the CPU online in cpu_data[].
  *   2. Increments nr_cpus atomically for secondaries (primary sets nr_cpus=1).
- *   3. Enables the FPU/SIMD (NEON) unit by setting CPACR_EL1.FPEN[21:20]=0b11,
- *      which allows EL0 and EL1 to execute floating-point and NEON instructions
- *      without trapping to a higher EL.  An ISB is issued to ensure the CPACR
- *      write takes effect before any subsequent NEON instruction.
+ *   3. Traps the FPU/SIMD (NEON) unit (CPACR_EL1.FPEN = 0b00) via
+ *      arch_fpu_init_cpu: the first FP/SIMD instruction of a user task is
+ *      taken as EC 0x07 and its state loaded lazily (kernel/fpu.h).
  *   4. Installs the exception vector table (VBAR_EL1) via exception_vectors_install.
  *
  * Side effects: modifies CPACR_EL1, VBAR_EL1; prints boot diagnostics.
@@ -122,8 +125,11 @@ extern void exception_vectors_install(void);
 void arch_cpu_init(void) {
   uint32_t id = arch_get_cpu_id();
 
+  cpu_data[id].self = &cpu_data[id];
   cpu_data[id].cpu_id = id;
   cpu_data[id].online = 1;
+  /* get_cpu_info() reads this from here on instead of MPIDR. */
+  __asm__ __volatile__("msr tpidr_el1, %0" ::"r"(&cpu_data[id]) : "memory");
 
   /* Publish this CPU's EL1 fault-stack top BEFORE installing the vectors:
    * from the first VBAR exception onward, handle_el1_spx_sync/serror switch
@@ -139,15 +145,13 @@ void arch_cpu_init(void) {
     __sync_fetch_and_add(&nr_cpus, 1);
   }
 
-  /* Enable FPU/SIMD (NEON) - set CPACR_EL1.FPEN = 0b11.
-   * FPEN[21:20] == 0b00 traps FP/NEON from EL0+EL1 to EL1.
-   * FPEN[21:20] == 0b11 disables the trap entirely; needed so that
-   * exception.S can save/restore q0-q31 without faulting. */
-  uint64_t cpacr = arch_impl_get_cpacr();
-  cpacr |= (3 << 20); /* FPEN bits [21:20] = 0b11 */
-  arch_impl_set_cpacr(cpacr);
-  arch_impl_mb();
-  arch_impl_isb(); /* ensure CPACR change is visible before NEON use */
+  /* Lazy FP/SIMD: FPEN = 0b00 traps FP/NEON from EL0+EL1 to EL1.  The
+   * kernel is built -mgeneral-regs-only, so only user tasks (and explicit
+   * kernel_neon_begin/end sections) ever reach the unit. */
+  arch_fpu_init_cpu();
+
+  /* PMUv3 counters for per-thread counts (pmu.c). */
+  pmu_init_cpu();
 
   /* Install exception vector table */
   exception_vectors_install();
@@ -179,7 +183,7 @@ volatile bool probe_failed = false;
  * sync_handler - C-level synchronous exception handler called from exception.S.
  *
  * Parameters:
- *   frame  Pointer to the 816-byte exception frame pushed on the kernel stack by
+ *   frame  Pointer to the exception frame (struct pt_regs) pushed on the kernel stack by
  *          the vector_stub macro in exception.S.  The handler may modify frame->elr
  *          to change the return address (e.g., probe recovery), or swap in a
  *          different frame pointer entirely (e.g., schedule() returning a new task).
@@ -191,6 +195,8 @@ volatile bool probe_failed = false;
  *
  * EC decoding (ESR_EL1[31:26]):
  *   0x00  Unknown / uncategorized — print and fall through to fault handler.
+ *   0x07  FP/SIMD access trapped by CPACR_EL1.FPEN — lazy FP load for EL0
+ *         (arch_fpu_trap); from EL1 it is a kernel FP use and panics.
  *   0x15  SVC instruction from AArch64 EL0 — dispatch to syscall_handler().
  *   0x20  Instruction Abort from lower EL (EL0 code page fault).
  *   0x21  Instruction Abort from same EL (EL1 code fault — kernel bug).
@@ -244,6 +250,15 @@ struct pt_regs *sync_handler(struct pt_regs *frame) {
   if (ec == 0x15)
     return syscall_handler(frame);
 
+  /* First FP/SIMD use of the slice from EL0: load the task's NEON state and
+   * re-execute.  Not a fault either; a setup failure (no memory for the save
+   * area) falls through and terminates the task like any user fault. */
+  if (ec == ESR_EC_FP_ACCESS && (frame->spsr & 0xF) == 0) {
+    struct pt_regs *resume = arch_fpu_trap(frame);
+    if (resume)
+      return resume;
+  }
+
   /* Fault recursion guard (Phase A step 7): an abort inside this handler used
    * to recurse on the kernel stack until silent death.  Detect nesting FIRST
    * — before anything that could itself abort — and stop with one raw line.
@@ -267,13 +282,13 @@ struct pt_regs *sync_handler(struct pt_regs *frame) {
     frame->elr += 4;
     fault_exit();
     /* If the vector switched us onto the per-CPU fault stack, the eret
-     * epilogue computes the final SP as frame+816 — which would resume the
+     * epilogue computes the final SP as frame+sizeof — which would resume the
      * probe loop ON the fault stack.  Rebuild the frame just below the
      * original SP (free space: stacks grow down) and return that instead,
      * so execution resumes with SP exactly as it was at the abort. */
     if (arch_frame_on_fault_stack(frame)) {
-      uint64_t old_sp = *(uint64_t *)((char *)frame + 816) + 16; /* +16: scratch push */
-      struct pt_regs *orig = (struct pt_regs *)(old_sp - 816);
+      uint64_t old_sp = *(uint64_t *)((char *)frame + sizeof(*frame)) + 16; /* +16: scratch push */
+      struct pt_regs *orig = (struct pt_regs *)(old_sp - sizeof(*frame));
       memcpy(orig, frame, sizeof(*frame));
       return orig;
     }
@@ -336,7 +351,7 @@ struct pt_regs *sync_handler(struct pt_regs *frame) {
       /* The vector switched us onto the per-CPU fault stack; the SP at the
        * moment of the abort was parked just above the frame. */
       fault_printf("Frame: %p (per-CPU fault stack), faulting SP: 0x%016lx\n",
-                   (void *)frame, *(uint64_t *)((char *)frame + 816) + 16);
+                   (void *)frame, *(uint64_t *)((char *)frame + sizeof(*frame)) + 16);
     } else {
       fault_printf("Frame: %p (faulting kernel stack)\n", (void *)frame);
     }
@@ -580,6 +595,23 @@ void arch_vmm_map_mmio(uint64_t *pgd) {
                      0x02800000UL, PAGE_DEVICE);
 }
 
+/*
+ * arch_tls_save / arch_tls_load - per-thread TPIDR_EL0 (SYS_SET_TLS).
+ *
+ * TPIDR_EL0 is writable from EL0, so a thread may have moved it without a
+ * syscall: schedule() reads it back into prev->tls_base on every switch-out.
+ * The kernel itself never uses TPIDR_EL0.
+ */
+void arch_tls_save(struct process *prev) {
+    uint64_t v;
+    __asm__ __volatile__("mrs %0, tpidr_el0" : "=r"(v));
+    prev->tls_base = v;
+}
+
+void arch_tls_load(struct process *p) {
+    __asm__ __volatile__("msr tpidr_el0, %0" :: "r"(p->tls_base));
+}
+
 /*
  * arch_cpu_switch_context - perform the architecture-specific address-space switch.
  *
@@ -617,8 +649,19 @@ void arch_cpu_switch_context(struct process *next) {
      * PGD (which would alias all RAM into the user VA range). */
     uint64_t pgd = next->page_table ? virt_to_phys(next->page_table)
                                     : idle_user_pgd_phys();
-    if (pgd) {
+    /* Sibling threads share one PGD: keep TTBR0 and the TLB as they are.
+     * Safe because TTBR0 only ever holds the PGD of this CPU's current task
+     * (or the idle PGD), and a space's PGD is freed only after its last
+     * thread has been switched away from everywhere; unmaps in a shared
+     * space are already broadcast (TLBI ...IS). */
+    if (pgd && pgd != arch_vmm_get_pgd()) {
         arch_vmm_set_pgd(pgd);
         arch_tlb_flush_all();
     }
+
+    arch_tls_load(next);
+
+    /* Lazy NEON: save the outgoing task's registers only if it used them
+     * this slice; re-open the unit for next only if they are still here. */
+    arch_fpu_switch(next);
 }
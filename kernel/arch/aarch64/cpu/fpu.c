@@ -0,0 +1,124 @@
+/*
+ * kernel/arch/aarch64/cpu/fpu.c
+ * Lazy FP/SIMD (NEON) context switching for AArch64.
+ *
+ * Implements the kernel/fpu.h contract with CPACR_EL1.FPEN:
+ *   TRAP_ALL  default — any FP/SIMD instruction, EL0 or EL1, raises EC 0x07.
+ *             An EL1 trap means the kernel used FP outside a NEON section
+ *             and falls through to sync_handler's panic path.
+ *   NONE      the current task owns the registers (cpu->fpu_live).
+ *   TRAP_EL0  inside kernel_neon_begin/end only.
+ *
+ * Exception entry never touches q0-q31/FPSR/FPCR (exception.S), so the
+ * 528-byte register file is moved only when a task that actually used it
+ * is switched out, and reloaded only when a task uses it again on a CPU
+ * that no longer holds its copy.
+ */
+#include <arch/fpsimd.h>
+#include <kernel/cpu.h>
+#include <kernel/fpu.h>
+#include <kernel/kmalloc.h>
+#include <kernel/sched.h>
+#include <kernel/string.h>
+
+/* IRQ state saved by kernel_neon_begin() for the matching end(). */
+static uint64_t neon_irq_flags[MAX_CPUS];
+
+static void fpen_set(uint64_t fpen) {
+  uint64_t cpacr = arch_impl_get_cpacr();
+  cpacr = (cpacr & ~CPACR_FPEN_MASK) | fpen;
+  arch_impl_set_cpacr(cpacr);
+  arch_impl_isb();
+}
+
+/* fpu_save_live - write the registers back to their owner if the owner had
+ * the unit enabled (and so may have modified them).  The owner keeps the
+ * CPU's copy: a later switch back here re-enables without a reload. */
+static void fpu_save_live(struct cpu_info *cpu) {
+  if (!cpu->fpu_live)
+    return;
+  struct process *owner = cpu->fpu_owner;
+  if (owner && owner->fpu_state)
+    fpsimd_save_state((struct fpsimd_state *)owner->fpu_state);
+  cpu->fpu_live = 0;
+}
+
+void arch_fpu_init_cpu(void) {
+  struct cpu_info *cpu = get_cpu_info();
+  cpu->fpu_owner = NULL;
+  cpu->fpu_live = 0;
+  fpen_set(CPACR_FPEN_TRAP_ALL);
+}
+
+void arch_fpu_switch(struct process *next) {
+  struct cpu_info *cpu = get_cpu_info();
+
+  fpu_save_live(cpu);
+
+  if (next->fpu_state && cpu->fpu_owner == next &&
+      next->fpu_cpu == (int)cpu->cpu_id) {
+    /* Registers still hold next's state from its last slice here. */
+    fpen_set(CPACR_FPEN_NONE);
+    cpu->fpu_live = 1;
+  } else {
+    fpen_set(CPACR_FPEN_TRAP_ALL);
+  }
+}
+
+struct pt_regs *arch_fpu_trap(struct pt_regs *frame) {
+  struct cpu_info *cpu = get_cpu_info();
+  struct process *p = cpu->current_task;
+  if (!p)
+    return NULL;
+
+  if (!p->fpu_state) {
+    /* First FP/SIMD instruction of this task: zeroed registers, FPCR 0
+     * (round-to-nearest, no FP exception traps). */
+    struct fpsimd_state *st = kmalloc(sizeof(*st));
+    if (!st)
+      return NULL;
+    memset(st, 0, sizeof(*st));
+    p->fpu_state = st;
+  }
+
+  fpen_set(CPACR_FPEN_NONE);
+  fpu_save_live(cpu);
+  fpsimd_load_state((const struct fpsimd_state *)p->fpu_state);
+  cpu->fpu_owner = p;
+  cpu->fpu_live = 1;
+  p->fpu_cpu = (int)cpu->cpu_id;
+
+  /* ELR still points at the trapping instruction: it simply re-executes. */
+  return frame;
+}
+
+void arch_fpu_release(struct process *proc) {
+  /* A dead task is never live anywhere, but it may still be recorded as
+   * the owner of the copy it left behind; drop that before the descriptor
+   * can be reused. */
+  if (proc->fpu_cpu >= 0 && proc->fpu_cpu < MAX_CPUS &&
+      cpu_data[proc->fpu_cpu].fpu_owner == proc)
+    cpu_data[proc->fpu_cpu].fpu_owner = NULL;
+  if (proc->fpu_state) {
+    kfree(proc->fpu_state);
+    proc->fpu_state = NULL;
+  }
+  proc->fpu_cpu = -1;
+}
+
+void kernel_neon_begin(void) {
+  uint64_t flags = local_irq_save();
+  struct cpu_info *cpu = get_cpu_info();
+
+  fpu_save_live(cpu);
+  /* The registers are about to be clobbered: nobody owns them any more. */
+  cpu->fpu_owner = NULL;
+  neon_irq_flags[cpu->cpu_id] = flags;
+  fpen_set(CPACR_FPEN_TRAP_EL0);
+}
+
+void kernel_neon_end(void) {
+  struct cpu_info *cpu = get_cpu_info();
+  fpen_set(CPACR_FPEN_TRAP_ALL);
+  local_irq_restore(neon_irq_flags[cpu->cpu_id]);
+}
@@ -0,0 +1,115 @@
+/*
+ * kernel/arch/aarch64/cpu/pmu.c
+ * ARM PMUv3 for kernel/pmu.h.
+ *
+ * ID_AA64DFR0_EL1.PMUVer says whether PMUv3 is implemented.  PMU_CYCLES is
+ * the cycle counter (PMCCNTR_EL0, 64 bits with PMCR_EL0.LC); every other
+ * PMU_* event the CPU implements (PMCEID0_EL0) takes the next of the
+ * PMCR_EL0.N event counters, which are 32 bits wide.  All count at EL0 and
+ * EL1 (filter bits 0).  EL0 access stays off (PMUSERENR_EL0 = 0) and no
+ * overflow interrupt is enabled: the folds in kernel/core/pmu.c run every
+ * tick, far more often than a 32-bit counter can wrap.
+ *
+ * When the kernel is entered at EL2, start.S hands every counter to EL1
+ * (MDCR_EL2.HPMN = N, no traps).  QEMU TCG implements the cycle counter,
+ * and INST_RETIRED only when run with -icount.
+ */
+#include <arch/arch.h>
+#include <kernel/pmu.h>
+
+#define PMCR_E  (1u << 0) /* enable */
+#define PMCR_P  (1u << 1) /* reset the event counters */
+#define PMCR_C  (1u << 2) /* reset the cycle counter */
+#define PMCR_LC (1u << 6) /* 64-bit cycle counter overflow */
+#define PMCR_N(v) (((v) >> 11) & 0x1F)
+
+#define PMCNT_CYCLES (1u << 31)
+
+/* Common event numbers (all below 32, so PMCEID0_EL0 bit n). */
+static const uint8_t arm_events[PMU_NR_EVENTS] = {
+    [PMU_CYCLES] = 0x11,        /* CPU_CYCLES, counted by PMCCNTR_EL0 */
+    [PMU_INSTRUCTIONS] = 0x08,  /* INST_RETIRED */
+    [PMU_CACHE_MISSES] = 0x03,  /* L1D_CACHE_REFILL */
+    [PMU_BRANCH_MISSES] = 0x10, /* BR_MIS_PRED */
+};
+
+/* pmu_counter[e]: the event counter counting e, -1 if none (PMU_CYCLES
+ * uses the cycle counter).  Set once by arch_pmu_probe() on the BSP; every
+ * CPU programs the same assignment. */
+static int pmu_counter[PMU_NR_EVENTS];
+static int pmu_cycles;
+
+#define read_sysreg(r)                                                         \
+  ({                                                                           \
+    uint64_t __v;                                                              \
+    __asm__ __volatile__("mrs %0, " #r : "=r"(__v));                           \
+    __v;                                                                       \
+  })
+#define write_sysreg(r, v)                                                     \
+  __asm__ __volatile__("msr " #r ", %0" ::"r"((uint64_t)(v)) : "memory")
+
+void arch_pmu_probe(struct pmu_hw *hw) {
+  uint32_t pmuver = (uint32_t)(read_sysreg(id_aa64dfr0_el1) >> 8) & 0xF;
+  for (int e = 0; e < PMU_NR_EVENTS; e++)
+    pmu_counter[e] = -1;
+  pmu_cycles = 0;
+  if (pmuver == 0 || pmuver == 0xF) /* none, or IMPLEMENTATION DEFINED */
+    return;
+
+  uint32_t n = PMCR_N(read_sysreg(pmcr_el0));
+  uint64_t ceid = read_sysreg(pmceid0_el0);
+  hw->version = pmuver;
+  hw->ncounters = n;
+
+  pmu_cycles = 1;
+  hw->events = PMU_EV(PMU_CYCLES);
+  hw->mask[PMU_CYCLES] = ~0ULL;
+  uint32_t next = 0;
+  for (int e = 0; e < PMU_NR_EVENTS && next < n; e++) {
+    if (e == PMU_CYCLES || !(ceid & (1ULL << arm_events[e])))
+      continue;
+    pmu_counter[e] = (int)next++;
+    hw->events |= PMU_EV(e);
+    hw->mask[e] = 0xFFFFFFFFULL;
+  }
+}
+
+void arch_pmu_start_cpu(const struct pmu_hw *hw) {
+  (void)hw;
+  if (!pmu_cycles)
+    return;
+  write_sysreg(pmcntenclr_el0, ~0u);
+  write_sysreg(pmintenclr_el1, ~0u);
+  write_sysreg(pmovsclr_el0, ~0u);
+  write_sysreg(pmuserenr_el0, 0);
+  write_sysreg(pmccfiltr_el0, 0);
+
+  uint64_t enable = PMCNT_CYCLES;
+  for (int e = 0; e < PMU_NR_EVENTS; e++) {
+    if (pmu_counter[e] < 0)
+      continue;
+    write_sysreg(pmselr_el0, (uint32_t)pmu_counter[e]);
+    arch_impl_isb();
+    write_sysreg(pmxevtyper_el0, arm_events[e]);
+    enable |= 1ULL << pmu_counter[e];
+  }
+
+  uint64_t pmcr = read_sysreg(pmcr_el0);
+  write_sysreg(pmcr_el0, (pmcr & ~0xFFULL) | PMCR_E | PMCR_P | PMCR_C |
+                             PMCR_LC);
+  write_sysreg(pmcntenset_el0, enable);
+  arch_impl_isb();
+}
+
+void arch_pmu_read(uint64_t raw[PMU_NR_EVENTS]) {
+  for (int e = 0; e < PMU_NR_EVENTS; e++) {
+    if (pmu_counter[e] >= 0) {
+      write_sysreg(pmselr_el0, (uint32_t)pmu_counter[e]);
+      arch_impl_isb();
+      raw[e] = read_sysreg(pmxevcntr_el0) & 0xFFFFFFFFULL;
+    } else {
+      raw[e] = 0;
+    }
+  }
+  raw[PMU_CYCLES] = pmu_cycles ? read_sysreg(pmccntr_el0) : 0;
+}
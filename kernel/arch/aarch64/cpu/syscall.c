@@ -52,7 +52,7 @@ int arch_copy_from_user(void *dest, const void *src, size_t n) {
   uint64_t flagsptr = local_irq_save();
 
   /* Lock the address space for this process */
-  spin_lock(&current_process->mm_lock);
+  spin_lock(&current_process->space->mm_lock);
 
   /* Save kernel TTBR0 (usually 0 or points to identity map initially) */
   uint64_t old_pgd = arch_vmm_get_pgd();
@@ -75,7 +75,7 @@ int arch_copy_from_user(void *dest, const void *src, size_t n) {
   arch_tlb_flush_all();
   arch_isb();
 
-  spin_unlock(&current_process->mm_lock);
+  spin_unlock(&current_process->space->mm_lock);
   local_irq_restore(flagsptr);
 
   return 0;
@@ -99,7 +99,7 @@ int arch_copy_to_user(void *dest, const void *src, size_t n) {
     return -1;
 
   uint64_t flagsptr = local_irq_save();
-  spin_lock(&current_process->mm_lock);
+  spin_lock(&current_process->space->mm_lock);
 
   uint64_t old_pgd = arch_vmm_get_pgd();
   arch_vmm_set_pgd(virt_to_phys(current_process->page_table));
@@ -115,7 +115,7 @@ int arch_copy_to_user(void *dest, const void *src, size_t n) {
   arch_tlb_flush_all();
   arch_isb();
 
-  spin_unlock(&current_process->mm_lock);
+  spin_unlock(&current_process->space->mm_lock);
   local_irq_restore(flagsptr);
 
   return 0;
@@ -129,15 +129,15 @@ int arch_copy_to_user(void *dest, const void *src, size_t n) {
  * TTBR0 = the user PGD, and uaccess_active = 1.  The faulting context is
  * being discarded (process terminated), so: clear the flag, drop mm_lock,
  * re-enable IRQs (SYS-AARCH64-02 made explicit in ONE place).  TTBR0 is NOT
- * restored here — the scheduler loads the next task's PGD unconditionally on
- * the switch (SCHED-UAF-01 fix).
+ * restored here — the scheduler loads the next task's PGD on the switch
+ * (SCHED-UAF-01 fix) unless next shares it.
  */
 void arch_uaccess_fault_fixup(void) {
   struct cpu_info *ci = arch_cpu_info_fault_safe();
   if (ci) {
     ci->uaccess_active = 0;
     if (ci->current_task)
-      spin_unlock(&ci->current_task->mm_lock);
+      spin_unlock(&ci->current_task->space->mm_lock);
   }
   local_irq_enable();
 }
@@ -152,7 +152,7 @@ int arch_copy_string_from_user(char *dest, const char *src, size_t max_len) {
     return -1;
 
   uint64_t flagsptr = local_irq_save();
-  spin_lock(&current_process->mm_lock);
+  spin_lock(&current_process->space->mm_lock);
 
   uint64_t old_pgd = arch_vmm_get_pgd();
   arch_vmm_set_pgd(virt_to_phys(current_process->page_table));
@@ -182,7 +182,7 @@ out:
   arch_vmm_set_pgd(old_pgd);
   arch_tlb_flush_all();
   arch_isb();
-  spin_unlock(&current_process->mm_lock);
+  spin_unlock(&current_process->space->mm_lock);
   local_irq_restore(flagsptr);
   return ret;
 }
@@ -71,6 +71,14 @@ static inline uint32_t arch_impl_get_cpu_id(void) {
   return (uint32_t)(mpidr & 0xFF);
 }
 
+/* The running CPU's struct cpu_info, kept in TPIDR_EL1 (EL0 cannot read it).
+ * start.S zeroes it, so this is NULL until arch_cpu_init(). */
+static inline void *arch_impl_percpu_self(void) {
+  void *p;
+  __asm__ __volatile__("mrs %0, tpidr_el1" : "=r"(p));
+  return p;
+}
+
 /* --- VMM / TLB --- */
 /* TTBR0 = USER half (per-process tables, VA bit 47 clear); TTBR1 = KERNEL
  * half (higher-half image + direct map, VA top bits set — see memlayout.h).
@@ -215,19 +223,22 @@ static inline void arch_impl_timer_control(uint32_t val) {
 }
 
 /* --- Spinlocks --- */
-static inline void arch_impl_spin_lock(volatile uint32_t *lock) {
-  while (__sync_lock_test_and_set(lock, 1)) {
-    while (*lock)
-      __asm__ __volatile__("wfe");
-  }
-}
-
-static inline void arch_impl_spin_unlock(volatile uint32_t *lock) {
-  __sync_lock_release(lock);
-}
-
-static inline int arch_impl_spin_trylock(volatile uint32_t *lock) {
-  return __sync_lock_test_and_set(lock, 1) == 0;
+/* Wait until *p may no longer equal seen (kernel/spinlock.h).  SEVL+WFE
+ * drops a stale event; LDXR arms the exclusive monitor on the lock line, so
+ * the next store to it by any CPU clears the monitor and wakes the second
+ * WFE.  Returns early on an IRQ or any other event; callers re-check. */
+static inline void arch_impl_spin_wait(volatile uint32_t *p, uint32_t seen) {
+  uint32_t tmp;
+  __asm__ __volatile__("sevl\n"
+                       "wfe\n"
+                       "ldxr %w0, [%1]\n"
+                       "eor %w0, %w0, %w2\n"
+                       "cbnz %w0, 1f\n"
+                       "wfe\n"
+                       "1:"
+                       : "=&r"(tmp)
+                       : "r"(p), "r"(seen)
+                       : "memory");
 }
 
 /* --- Constants --- */
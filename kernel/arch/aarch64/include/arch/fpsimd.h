@@ -0,0 +1,46 @@
+/*
+ * kernel/arch/aarch64/include/arch/fpsimd.h
+ * AArch64 FP/SIMD (NEON) register file and CPACR_EL1.FPEN control.
+ *
+ * The save area is allocated per task on first use (kernel/fpu.h); its
+ * layout must match fpsimd_save_state/fpsimd_load_state in cpu/fpsimd.S.
+ */
+#ifndef _ARCH_AARCH64_FPSIMD_H
+#define _ARCH_AARCH64_FPSIMD_H
+
+#include <stdint.h>
+
+/* NEON register file: q0-q31 (512 bytes) + FPSR/FPCR. */
+struct fpsimd_state {
+  __uint128_t vregs[32]; /* 0 - 512 */
+  uint32_t fpsr;         /* 512 */
+  uint32_t fpcr;         /* 516 */
+  uint64_t padding;      /* 520 - 528 */
+};
+
+/* CPACR_EL1.FPEN[21:20] */
+#define CPACR_FPEN_MASK (3UL << 20)
+#define CPACR_FPEN_TRAP_ALL (0UL << 20) /* EL0 and EL1 accesses trap */
+#define CPACR_FPEN_TRAP_EL0 (1UL << 20) /* EL1 may use the unit, EL0 traps */
+#define CPACR_FPEN_NONE (3UL << 20)     /* no trapping */
+
+/* ESR_EL1.EC for an FP/SIMD access trapped by CPACR_EL1.FPEN */
+#define ESR_EC_FP_ACCESS 0x07
+
+void fpsimd_save_state(struct fpsimd_state *st);
+void fpsimd_load_state(const struct fpsimd_state *st);
+
+/*
+ * kernel_neon_begin/kernel_neon_end - bracket kernel NEON use.
+ *
+ * The kernel image is built -mgeneral-regs-only; a translation unit that
+ * wants NEON must be compiled without that flag and must confine every FP/
+ * SIMD instruction between these calls.  begin() masks IRQs (no preemption,
+ * no nesting), saves the current user state if it is live and opens the
+ * unit to EL1 only; end() re-traps it, so the user task reloads its saved
+ * state on its next FP/SIMD instruction.
+ */
+void kernel_neon_begin(void);
+void kernel_neon_end(void);
+
+#endif /* _ARCH_AARCH64_FPSIMD_H */
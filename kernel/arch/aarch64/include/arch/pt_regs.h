@@ -1,8 +1,10 @@
 /*
  * kernel/arch/aarch64/include/arch/pt_regs.h
- * AArch64 register frame layout (816 bytes)
+ * AArch64 register frame layout (288 bytes)
  *
- * Must match the stack layout in exception.S exactly.
+ * Must match the stack layout in exception.S exactly.  The frame holds the
+ * integer state only: FP/SIMD registers are switched lazily per task
+ * (kernel/fpu.h, arch/fpsimd.h) and never touched on exception entry.
  */
 #ifndef _ARCH_AARCH64_PT_REGS_H
 #define _ARCH_AARCH64_PT_REGS_H
@@ -17,12 +19,6 @@ struct pt_regs {
   uint64_t spsr;     /* 264 */
   uint64_t sp_el0;   /* 272 */
   uint64_t padding;  /* 280 */
-
-  /* FPU/SIMD State (NEON q0-q31 = 32 * 16 bytes = 512 bytes) */
-  __uint128_t qregs[32]; /* 288 - 800 */
-  uint32_t fpsr;         /* 800 */
-  uint32_t fpcr;         /* 804 */
-  uint64_t fpu_padding;  /* 808-816 */
 };
 
 /* ─── Architecture-Agnostic Accessors ─── */
@@ -45,6 +41,14 @@ static inline void pt_regs_set_return(struct pt_regs *r, uint64_t v) {
 /* Get program counter (ELR_EL1) */
 static inline uint64_t pt_regs_pc(struct pt_regs *r) { return r->elr; }
 
+/* Frame pointer (x29) at the exception: seed of a frame-pointer walk */
+static inline uint64_t pt_regs_fp(struct pt_regs *r) { return r->regs[29]; }
+
+/* Taken from EL0 (SPSR_EL1.M == EL0t) */
+static inline int pt_regs_user_mode(struct pt_regs *r) {
+  return (r->spsr & 0xF) == 0;
+}
+
 /* Set program counter */
 static inline void pt_regs_set_pc(struct pt_regs *r, uint64_t v) {
   r->elr = v;
@@ -32,14 +32,20 @@
  *     purpose: it is the only delivery path for legacy PIC lines (PCI INTx).
  */
 #include <arch/amd64/apic.h>
+#include <drivers/timer.h>
 #include <kernel/printk.h>
 #include <kernel/arch.h>
+#include <kernel/cpu.h>
+#include <kernel/prof.h>
 #include <arch/amd64_internal.h>
 
 /* ticks_per_ms: LAPIC timer decrements per millisecond at LAPIC_TIMER_DIV16.
  * Set by lapic_timer_calibrate(); used by lapic_timer_setup() and udelay(). */
 uint32_t ticks_per_ms = 0;
 
+/* tsc_hz: TSC rate, measured over the same PIT window (arch.h). */
+uint64_t tsc_hz = 0;
+
 /*
  * lapic_init - enable and configure the LAPIC for the calling CPU.
  *
@@ -147,6 +153,8 @@ void lapic_send_ipi(uint32_t lapic_id, uint32_t flags) {
  *      (11932 / 1193.18 kHz ≈ 10 ms).
  *   4. The LAPIC ticks elapsed = 0xFFFFFFFF - LAPIC_TCC.
  *   5. ticks_per_ms = elapsed / 10.
+ *   6. tsc_hz = TSC ticks over the same window * 100 (the trace clock,
+ *      kernel/trace.h).
  *
  * The calibration is idempotent: if ticks_per_ms is already non-zero the
  * function returns immediately.  BSP calls this once in arch_timer_init();
@@ -174,6 +182,7 @@ void lapic_timer_calibrate(void) {
 
     /* Start LAPIC Timer with maximum initial count */
     lapic_write(LAPIC_TIC, 0xFFFFFFFF);
+    uint64_t tsc_start = arch_impl_timer_get_count();
 
     /* Busy-poll PIT until it has ticked down by 11932 counts (~10 ms).
      * PIT latch command (0x00 to PIT_CMD) freezes the counter for reading;
@@ -188,6 +197,7 @@ void lapic_timer_calibrate(void) {
     /* Read LAPIC Timer current count; elapsed = initial - current */
     uint32_t ticks = 0xFFFFFFFF - lapic_read(LAPIC_TCC);
     ticks_per_ms = ticks / 10; /* elapsed in 10 ms → convert to per-ms */
+    tsc_hz = (arch_impl_timer_get_count() - tsc_start) * 100;
 
     /* FIX(EXC-AMD64-03): silence the PIT now that calibration is done.
      * Mode 2 left the counter free-running, pulsing the IRQ0 line forever;
@@ -199,7 +209,8 @@ void lapic_timer_calibrate(void) {
      * must NOT be masked. */
     outb(PIT_CMD, 0x30); /* channel 0, lobyte/hibyte, mode 0, no count loaded */
 
-    pr_info("LAPIC: Timer calibrated: %u ticks per ms\n", ticks_per_ms);
+    pr_info("LAPIC: Timer calibrated: %u ticks per ms, TSC %lu kHz\n",
+            ticks_per_ms, tsc_hz / 1000);
 }
 
 /*
@@ -237,6 +248,48 @@ void lapic_timer_setup(uint32_t hz) {
             lapic_get_id(), hz, ticks_per_ms * interval_ms);
 }
 
+/*
+ * lapic_timer_set_hz - change the running periodic timer's rate; no log
+ * line, so it is usable from the timer interrupt.
+ */
+static void lapic_timer_set_hz(uint32_t hz) {
+    lapic_write(LAPIC_TIC, ticks_per_ms * 1000 / hz);
+}
+
+/*
+ * lapic_timer_prof - vector 32 bookkeeping for the sampling profiler
+ * (kernel/prof.h).
+ *
+ * While prof_hz is set this CPU's timer runs at HZ * mult (prof_hz rounded
+ * to a multiple of HZ), every interrupt takes a sample, and only every
+ * mult-th is a scheduler tick.  The first interrupt after prof_hz changes
+ * retunes the timer and counts as a tick.
+ *
+ * Returns 1 for a sample-only interrupt (no kernel_timer_tick), else 0.
+ * IRQ context: YES — vector 32, IRQs masked.
+ */
+int lapic_timer_prof(struct pt_regs *regs) {
+    struct cpu_info *cpu = get_cpu_info();
+    uint32_t prof = prof_rate();
+    if (__builtin_expect(!prof && cpu->timer_mult <= 1, 1))
+        return 0;
+
+    uint32_t mult = prof ? (prof + HZ / 2) / HZ : 1;
+    uint32_t cur = cpu->timer_mult ? cpu->timer_mult : 1;
+    if (prof)
+        __prof_sample(regs);
+    if (mult != cur) {
+        lapic_timer_set_hz(HZ * mult);
+        cpu->timer_mult = mult;
+        cpu->timer_sub = 0;
+        return 0;
+    }
+    if (++cpu->timer_sub < mult)
+        return 1;
+    cpu->timer_sub = 0;
+    return 0;
+}
+
 /*
  * lapic_timer_stop - mask and zero the LAPIC timer.
  *
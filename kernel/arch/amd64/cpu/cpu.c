@@ -3,14 +3,15 @@
  * AMD64 Per-CPU Initialization and Context-Switch Support
  *
  * Responsibilities:
- *   - Enable SSE/FXSAVE in CR0/CR4 (required early; GCC may auto-vectorise
- *     even kernel code with XMM registers).
+ *   - Enable x87/SSE/AVX for user mode and trap its first use per task
+ *     (arch_fpu_init_cpu, fpu.c).  The kernel itself never touches FP/SIMD
+ *     registers (-mgeneral-regs-only).
  *   - Populate cpu_data[id] (struct cpu_info) and write both IA32_GS_BASE
  *     and IA32_KERNEL_GS_BASE so that swapgs gives the kernel per-CPU pointer.
  *   - Sequence per-CPU GDT, IDT, SYSCALL MSR, and LAPIC init calls.
  *   - Implement arch_cpu_switch_context: update per-CPU bookkeeping, switch
- *     CR3 to the next process's PML4, and update TSS RSP0 so interrupt delivery
- *     uses the new task's kernel stack.
+ *     CR3 to the next process's PML4, update TSS RSP0 so interrupt delivery
+ *     uses the new task's kernel stack, and hand the FP unit over lazily.
  *
  * Invariants:
  *   - Identity-map: PA == VA throughout the kernel.  All pointer casts from
@@ -22,18 +23,19 @@
  *     stack_top=16, user_stack_tmp=24 — matching syscall.S lines 41-43.)
  *
  * Known issues:
- *   CPU-AMD64-01 (W3 MISSING) isr_stubs.S common_isr_entry saves only the 15
- *     GP registers.  No FXSAVE/XSAVE of XMM/AVX state is performed.  This
- *     file enables SSE (CR4.OSFXSR, :36-39), so the compiler may use XMM regs
- *     in kernel code.  A preemptive context switch on a timer IRQ between two
- *     kernel tasks can silently corrupt their XMM state.  Cross-ref:
- *     isr_stubs.S:95-109, context.S:12-36.
- *   UACC-AMD64-01 (W2 DOC/MISSING) CR4.SMAP is NOT set here (:36-39); only
- *     OSFXSR and OSXMMEXCPT are enabled.  uaccess.c's header claims SMAP is
+ *   CPU-AMD64-01 RESOLVED: the kernel is built with -mgeneral-regs-only, so
+ *     common_isr_entry still saves only the 15 GP registers and the XMM/YMM
+ *     file always holds user state.  That state is switched lazily per task
+ *     through CR0.TS/#NM with XSAVE(OPT) areas sized from CPUID leaf 0xD
+ *     (fpu.c, kernel/fpu.h).
+ *   UACC-AMD64-01 (W2 DOC/MISSING) CR4.SMAP is NOT set here; only the FP
+ *     control bits are enabled (fpu.c).  uaccess.c's header claims SMAP is
  *     active — that is wrong.  See uaccess.c Known issues.
  */
 #include <kernel/cpu.h>
 #include <kernel/fault.h>
+#include <kernel/fpu.h>
+#include <kernel/pmu.h>
 #include <kernel/printk.h>
 #include <kernel/sched.h>
 #include <kernel/string.h>
@@ -56,13 +58,11 @@ extern void amd64_syscall_init(void);
  *
  * Called by the BSP on the boot path (via kernel_main) and by each APs
  * secondary_cpu_entry in start.S.  Sequence must match:
- *   SSE → GDT → GS base → IDT → SYSCALL MSRs → LAPIC
+ *   FPU → GDT → GS base → IDT → SYSCALL MSRs → LAPIC
  *
- * SSE is enabled FIRST because C code called after this point (including
- * the GDT/IDT helpers) may be compiled with -msse or auto-vectorised.
- * NOTE(CPU-AMD64-01): FXSAVE/XSAVE is not used in ctx_switch or
- * common_isr_entry; enabling SSE here creates the hazard without the
- * save/restore infrastructure.
+ * arch_fpu_init_cpu programs CR0/CR4/XCR0 and leaves CR0.TS set: no kernel
+ * code may execute an x87/SSE/AVX instruction after this point (the #NM
+ * would panic), which -mgeneral-regs-only guarantees for C code.
  *
  * GS base is written AFTER gdt_init() because lgdt wipes all segment
  * selectors including GS; writing IA32_GS_BASE before lgdt would be lost.
@@ -83,21 +83,10 @@ void arch_cpu_init(void) {
 
   cpu_data[id].cpu_id = id;
 
-  /* Enable SSE EARLY (Functions like memset might use XMM registers) */
-  uint64_t cr0, cr4;
-  __asm__ __volatile__("mov %%cr0, %0" : "=r"(cr0));
-  cr0 &= ~(1 << 2); /* Clear EM (Emulation) */
-  cr0 |= (1 << 1);  /* Set MP (Monitor co-processor) */
-  __asm__ __volatile__("mov %0, %%cr0" :: "r"(cr0));
-
-  /* NOTE(CPU-AMD64-01): OSFXSR+OSXMMEXCPT enable fxsave/fxrstor and unmasked
-   * SIMD FP exceptions, but no FXSAVE is inserted in ctx_switch or the ISR
-   * entry path.  CR4.SMAP is intentionally NOT set here — uaccess.c's claim
-   * of SMAP protection is therefore inaccurate (UACC-AMD64-01). */
-  __asm__ __volatile__("mov %%cr4, %0" : "=r"(cr4));
-  cr4 |= (1 << 9);  /* OSFXSR (OS support for fxsave/fxrstor) */
-  cr4 |= (1 << 10); /* OSXMMEXCPT (OS support for unmasked simd fp exceptions) */
-  __asm__ __volatile__("mov %0, %%cr4" :: "r"(cr4));
+  /* x87/SSE/AVX for user mode: CR0.MP/EM/TS, CR4.OSFXSR/OSXMMEXCPT/OSXSAVE
+   * and XCR0 (fpu.c).  CR4.SMAP is intentionally NOT set here — uaccess.c's
+   * claim of SMAP protection is therefore inaccurate (UACC-AMD64-01). */
+  arch_fpu_init_cpu();
 
   struct cpu_info *cpu = &cpu_data[id];
   cpu->self = cpu;
@@ -121,6 +110,10 @@ void arch_cpu_init(void) {
   pr_info("CPU: Initializing LAPIC...\n");
   lapic_init();
 
+  /* Architectural PMCs, or TSC cycles without them (pmu.c).  Needs the GS
+   * base for the per-CPU fold baseline. */
+  pmu_init_cpu();
+
   if (id == 0) {
       nr_cpus = 1;
   } else {
@@ -146,7 +139,8 @@ void arch_cpu_init(void) {
 }
 
 /*
- * get_cpu_info - return the per-CPU struct for the calling CPU.
+ * get_cpu_info_slow - the per-CPU struct for the calling CPU before
+ * arch_cpu_init() has set IA32_GS_BASE (get_cpu_info() uses %gs:0 after).
  *
  * Reads the LAPIC ID (arch_get_cpu_id) and indexes cpu_data[].  Falls back to
  * cpu_data[0] if the ID is out of range (paranoia guard for early boot).
@@ -155,7 +149,7 @@ void arch_cpu_init(void) {
  * NOTE: arch_get_cpu_id reads LAPIC MMIO — NOT safe from a fault handler on a
  * compromised address space; fault paths use arch_cpu_info_fault_safe below.
  */
-struct cpu_info *get_cpu_info(void) {
+struct cpu_info *get_cpu_info_slow(void) {
   uint32_t id = arch_get_cpu_id();
   if (id >= MAX_CPUS) return &cpu_data[0];
   return &cpu_data[id];
@@ -185,6 +179,20 @@ struct cpu_info *arch_cpu_info_fault_safe(void) {
   return (struct cpu_info *)p;
 }
 
+/*
+ * arch_tls_save / arch_tls_load - per-thread FS base (SYS_SET_TLS).
+ *
+ * CR4.FSGSBASE is left clear, so user mode cannot move FS base itself
+ * (WRFSBASE #UDs) and the only writer is SYS_SET_TLS: p->tls_base is always
+ * current and there is nothing to read back on switch-out.  The kernel never
+ * uses FS (per-CPU data lives behind GS).
+ */
+void arch_tls_save(struct process *prev) { (void)prev; }
+
+void arch_tls_load(struct process *p) {
+  wrmsr(0xC0000100, p->tls_base); /* IA32_FS_BASE */
+}
+
 /*
  * arch_cpu_switch_context - switch the hardware context to run 'next'.
  *
@@ -200,16 +208,17 @@ struct cpu_info *arch_cpu_info_fault_safe(void) {
  *                      with the shared kernel_pgd when page_table is NULL
  *                      (kernel thread — SCHED-UAF-01: never leave the previous
  *                      process's possibly-freed PGD active).
+ *                      Skipped when next shares the loaded PML4 (threads).
  *   TSS RSP0:          updated via gdt_set_rsp0 so that hardware interrupt
  *                      delivery from Ring 3 uses the correct kernel stack.
+ *   FS base:           next's TLS pointer (arch_tls_load).
  *
  * Params:
  *   next - the process to switch to; must not be NULL.
  *
- * NOTE(CPU-AMD64-01): No FPU/XMM state save/restore is done here.  This is the
- * cooperative switch path; the Intel ABI treats XMM regs as caller-saved, so
- * a cooperative switch is safe.  The hazard is preemptive switches via the
- * timer ISR in common_isr_entry, which does not save/restore XMM state.
+ *   FP unit:           arch_fpu_switch saves the outgoing task's XMM/YMM
+ *                      state only if it used the unit this slice, and sets
+ *                      CR0.TS unless this CPU still holds next's registers.
  */
 void arch_cpu_switch_context(struct process *next) {
   struct cpu_info *cpu = get_cpu_info();
@@ -236,10 +245,18 @@ void arch_cpu_switch_context(struct process *next) {
      * PHYSICAL PML4 base — translate with virt_to_phys. */
     uint64_t pgd = next->page_table ? virt_to_phys(next->page_table)
                                     : (kernel_pgd ? virt_to_phys(kernel_pgd) : 0);
-    if (pgd)
+    /* Sibling threads share one PML4: skip the CR3 write and the TLB flush it
+     * implies.  Safe because CR3 only ever holds the PGD of this CPU's
+     * current task (or kernel_pgd), and a space's PGD is freed only after
+     * its last thread has been switched away from everywhere. */
+    if (pgd && pgd != (arch_vmm_get_pgd() & ~0xFFFULL))
       arch_vmm_set_pgd(pgd);
   }
 
   /* Update TSS RSP0 for interrupt stack switching */
   gdt_set_rsp0(next->kernel_stack);
+
+  arch_tls_load(next);
+
+  arch_fpu_switch(next);
 }
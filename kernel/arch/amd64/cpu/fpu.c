@@ -0,0 +1,236 @@
+/*
+ * kernel/arch/amd64/cpu/fpu.c
+ * Lazy x87/SSE/AVX context switching for AMD64 (CPU-AMD64-01 resolution).
+ *
+ * Implements the kernel/fpu.h contract with CR0.TS:
+ *   TS=1  default — the first x87/SSE/AVX instruction raises #NM (vector 7).
+ *         A kernel-mode #NM means the kernel used FP (it is built with
+ *         -mgeneral-regs-only) and falls through to the fault panic path.
+ *   TS=0  the current task owns the registers (cpu->fpu_live).
+ *
+ * Save format, chosen once from CPUID:
+ *   XSAVE present  CR4.OSXSAVE, XCR0 = x87|SSE (+AVX when supported; AVX2 needs
+ *                  no extra state component).  The area size comes from
+ *                  CPUID.(EAX=0Dh,ECX=0):EBX for the enabled XCR0; saves use
+ *                  XSAVEOPT when available, so components still in their init
+ *                  state or unmodified since the last XRSTOR are skipped.
+ *   otherwise      FXSAVE/FXRSTOR, 512 bytes (x87 + XMM only).
+ * XSAVES is not used: no supervisor state components are enabled, so the
+ * compacted format would buy nothing over XSAVEOPT.
+ *
+ * Each area is one PMM page: XSAVE requires 64-byte alignment (kmalloc only
+ * guarantees 16) and every XCR0 this file enables fits in 4 KB.
+ */
+#include <kernel/cpu.h>
+#include <kernel/fpu.h>
+#include <kernel/pmm.h>
+#include <kernel/printk.h>
+#include <kernel/sched.h>
+#include <kernel/string.h>
+#include <arch/pt_regs.h>
+
+#include <cpuid.h>
+
+extern struct cpu_info cpu_data[MAX_CPUS];
+
+#define CR0_MP (1UL << 1)
+#define CR0_EM (1UL << 2)
+#define CR0_TS (1UL << 3)
+
+#define CR4_OSFXSR     (1UL << 9)
+#define CR4_OSXMMEXCPT (1UL << 10)
+#define CR4_OSXSAVE    (1UL << 18)
+
+#define CPUID1_ECX_XSAVE (1U << 26)
+#define CPUID1_ECX_AVX   (1U << 28)
+
+#define XFEATURE_X87 (1ULL << 0)
+#define XFEATURE_SSE (1ULL << 1)
+#define XFEATURE_AVX (1ULL << 2)
+
+#define FXSAVE_SIZE 512
+#define MXCSR_DEFAULT 0x1F80 /* all SIMD exceptions masked, round-to-nearest */
+#define FCW_DEFAULT   0x037F /* x87 FNINIT control word */
+
+/* Detected on the BSP's first arch_fpu_init_cpu(); APs are identical parts. */
+static uint32_t fpu_use_xsave;
+static uint32_t fpu_use_xsaveopt;
+static uint64_t fpu_xcr0;
+static uint32_t fpu_area_size = FXSAVE_SIZE;
+
+static inline uint64_t read_cr0(void) {
+  uint64_t v;
+  __asm__ __volatile__("mov %%cr0, %0" : "=r"(v));
+  return v;
+}
+
+static inline void write_cr0(uint64_t v) {
+  __asm__ __volatile__("mov %0, %%cr0" :: "r"(v) : "memory");
+}
+
+static inline void fpu_clts(void) { __asm__ __volatile__("clts" ::: "memory"); }
+
+static inline void fpu_stts(void) {
+  uint64_t cr0 = read_cr0();
+  if (!(cr0 & CR0_TS))
+    write_cr0(cr0 | CR0_TS);
+}
+
+static inline void xsetbv(uint32_t idx, uint64_t val) {
+  __asm__ __volatile__("xsetbv" :: "c"(idx), "a"((uint32_t)val),
+                       "d"((uint32_t)(val >> 32)));
+}
+
+static void fpu_save_area(void *area) {
+  uint32_t lo = (uint32_t)fpu_xcr0, hi = (uint32_t)(fpu_xcr0 >> 32);
+  if (fpu_use_xsaveopt)
+    __asm__ __volatile__("xsaveopt64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+  else if (fpu_use_xsave)
+    __asm__ __volatile__("xsave64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+  else
+    __asm__ __volatile__("fxsave64 (%0)" :: "r"(area) : "memory");
+}
+
+static void fpu_load_area(const void *area) {
+  uint32_t lo = (uint32_t)fpu_xcr0, hi = (uint32_t)(fpu_xcr0 >> 32);
+  if (fpu_use_xsave)
+    __asm__ __volatile__("xrstor64 (%0)" :: "r"(area), "a"(lo), "d"(hi) : "memory");
+  else
+    __asm__ __volatile__("fxrstor64 (%0)" :: "r"(area) : "memory");
+}
+
+/* fpu_save_live - write the registers back to their owner if the owner had
+ * the unit enabled (and so may have modified them).  The owner keeps the
+ * CPU's copy: a later switch back here re-enables without a reload. */
+static void fpu_save_live(struct cpu_info *cpu) {
+  if (!cpu->fpu_live)
+    return;
+  struct process *owner = cpu->fpu_owner;
+  if (owner && owner->fpu_state)
+    fpu_save_area(owner->fpu_state);
+  cpu->fpu_live = 0;
+}
+
+/*
+ * fpu_detect - pick the save format and program XCR0.  Runs on every CPU
+ * (XCR0 and CR4 are per-core); the globals it sets are identical each time.
+ */
+static void fpu_detect(void) {
+  uint32_t eax, ebx, ecx, edx;
+  __cpuid(1, eax, ebx, ecx, edx);
+  uint32_t features = ecx;
+
+  uint64_t cr4;
+  __asm__ __volatile__("mov %%cr4, %0" : "=r"(cr4));
+  cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+  if (features & CPUID1_ECX_XSAVE)
+    cr4 |= CR4_OSXSAVE;
+  __asm__ __volatile__("mov %0, %%cr4" :: "r"(cr4));
+
+  if (!(features & CPUID1_ECX_XSAVE))
+    return;
+
+  uint32_t sup_lo, sup_hi;
+  __cpuid_count(0xD, 0, sup_lo, ebx, ecx, sup_hi);
+  uint64_t supported = ((uint64_t)sup_hi << 32) | sup_lo;
+
+  uint64_t xcr0 = XFEATURE_X87 | XFEATURE_SSE;
+  if ((features & CPUID1_ECX_AVX) && (supported & XFEATURE_AVX))
+    xcr0 |= XFEATURE_AVX;
+  xsetbv(0, xcr0);
+
+  /* EBX now reports the area size for exactly the components just enabled. */
+  __cpuid_count(0xD, 0, eax, ebx, ecx, edx);
+  if (ebx > PAGE_SIZE) {
+    /* Cannot happen with x87|SSE|AVX; keep the legacy format if it does. */
+    xsetbv(0, XFEATURE_X87 | XFEATURE_SSE);
+    return;
+  }
+
+  fpu_use_xsave = 1;
+  fpu_xcr0 = xcr0;
+  fpu_area_size = ebx;
+
+  __cpuid_count(0xD, 1, eax, ebx, ecx, edx);
+  fpu_use_xsaveopt = eax & 1;
+}
+
+void arch_fpu_init_cpu(void) {
+  struct cpu_info *cpu = get_cpu_info();
+
+  fpu_detect();
+
+  /* EM=0 (no emulation), MP=1 (WAIT honours TS), TS=1 (trap first use). */
+  uint64_t cr0 = read_cr0();
+  cr0 &= ~CR0_EM;
+  cr0 |= CR0_MP | CR0_TS;
+  write_cr0(cr0);
+
+  cpu->fpu_owner = NULL;
+  cpu->fpu_live = 0;
+
+  if (cpu->cpu_id == 0)
+    pr_info("FPU: %s, %u-byte save area, XCR0=0x%lx\n",
+            fpu_use_xsaveopt ? "XSAVEOPT" : fpu_use_xsave ? "XSAVE" : "FXSAVE",
+            fpu_area_size, fpu_xcr0);
+}
+
+void arch_fpu_switch(struct process *next) {
+  struct cpu_info *cpu = get_cpu_info();
+
+  fpu_save_live(cpu);
+
+  if (next->fpu_state && cpu->fpu_owner == next &&
+      next->fpu_cpu == (int)cpu->cpu_id) {
+    /* Registers still hold next's state from its last slice here. */
+    fpu_clts();
+    cpu->fpu_live = 1;
+  } else {
+    fpu_stts();
+  }
+}
+
+struct pt_regs *arch_fpu_trap(struct pt_regs *frame) {
+  struct cpu_info *cpu = get_cpu_info();
+  struct process *p = cpu->current_task;
+  if (!p)
+    return NULL;
+
+  if (!p->fpu_state) {
+    /* First x87/SSE/AVX instruction of this task.  An all-zero XSAVE header
+     * (XSTATE_BV = 0) makes XRSTOR load every component in its init state;
+     * MXCSR is always taken from the legacy region, so seed it, and FCW for
+     * the FXRSTOR path (abridged FTW 0 = all x87 registers empty). */
+    uint8_t *area = pmm_alloc_page();
+    if (!area)
+      return NULL;
+    memset(area, 0, PAGE_SIZE);
+    *(uint16_t *)(area + 0) = FCW_DEFAULT;
+    *(uint32_t *)(area + 24) = MXCSR_DEFAULT;
+    p->fpu_state = area;
+  }
+
+  fpu_clts();
+  fpu_save_live(cpu);
+  fpu_load_area(p->fpu_state);
+  cpu->fpu_owner = p;
+  cpu->fpu_live = 1;
+  p->fpu_cpu = (int)cpu->cpu_id;
+
+  /* #NM is a fault: RIP still points at the trapping instruction. */
+  return frame;
+}
+
+void arch_fpu_release(struct process *proc) {
+  /* A dead task is never live anywhere, but it may still be recorded as
+   * the owner of the copy it left behind; drop that before the descriptor
+   * can be reused. */
+  if (proc->fpu_cpu >= 0 && proc->fpu_cpu < MAX_CPUS &&
+      cpu_data[proc->fpu_cpu].fpu_owner == proc)
+    cpu_data[proc->fpu_cpu].fpu_owner = NULL;
+  if (proc->fpu_state) {
+    pmm_free_page(proc->fpu_state);
+    proc->fpu_state = NULL;
+  }
+  proc->fpu_cpu = -1;
+}
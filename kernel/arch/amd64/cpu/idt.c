@@ -36,18 +36,23 @@
  *   SYS-AMD64-03 (W2 REFINE) int 0x80 gate (DPL=3) installs a second syscall
  *     surface alongside the LSTAR fast path.  If the ABI goal is SYSCALL-only,
  *     this gate should be removed or explicitly documented.
- *   CPU-AMD64-01 (W3 MISSING) common_isr_entry in isr_stubs.S saves only 15
- *     GP registers; no FXSAVE of XMM state.  See isr_stubs.S:95-109 and the
- *     cross-ref in cpu.c Known issues.
+ *   CPU-AMD64-01 RESOLVED: common_isr_entry still saves only the 15 GP
+ *     registers — the kernel never touches XMM/YMM (-mgeneral-regs-only) —
+ *     and a user-mode #NM (vector 7) is the lazy FP first-use trap
+ *     (arch_fpu_trap, fpu.c).  See cpu.c Known issues.
  */
 #include <kernel/types.h>
 #include <kernel/string.h>
 #include <kernel/printk.h>
 #include <kernel/cpu.h>
 #include <kernel/fault.h>
+#include <kernel/fpu.h>
 #include <kernel/irq.h>
+#include <kernel/sched.h>
+#include <kernel/trace.h>
 #include <arch/pt_regs.h>
 #include <arch/arch.h>
+#include <arch/amd64/apic.h>
 #include <arch/amd64_internal.h>
 #include <kernel/arch.h>
 
@@ -303,9 +308,11 @@ extern struct pt_regs *kernel_timer_tick(struct pt_regs *regs);
  * switch by returning a different task's frame.
  *
  * Dispatch logic:
- *   vec < 32  : CPU exceptions.  Recursion guard (fault_enter), then switch
- *               on vec 8/13/14; every vector routes through
- *               fault_handle_user_or_panic (user → terminate, kernel → panic).
+ *   vec < 32  : CPU exceptions.  A user-mode #NM (7) is the lazy FP trap and
+ *               resumes the task.  Otherwise recursion guard
+ *               (fault_enter), then switch on vec 8/13/14; every vector
+ *               routes through fault_handle_user_or_panic (user → terminate,
+ *               kernel → panic).
  *   vec == 0x80: Legacy int 0x80 syscall → kernel_syscall_dispatcher.
  *   vec 32-255: Hardware IRQs.  Spurious 39/47/0xFF filtered first; vec==32
  *               (timer) → kernel_timer_tick; others → irq_dispatch.  All end
@@ -315,14 +322,21 @@ extern struct pt_regs *kernel_timer_tick(struct pt_regs *regs);
  *
  * Calling convention: called from assembly with a C ABI call; RDI = &pt_regs.
  * Returns RAX = new RSP (next task's pt_regs or the same regs on no-switch).
- *
- * NOTE(CPU-AMD64-01): No FXSAVE in common_isr_entry; XMM state is not
- * preserved across a preemptive switch triggered by the timer IRQ (vec==32).
  */
 struct pt_regs *amd64_isr_dispatch(struct pt_regs *regs) {
   uint64_t vec = regs->vec;
 
   if (vec < 32) {
+    /* #NM from user mode with CR0.TS set: the task's first x87/SSE/AVX use
+     * on this CPU since its registers were last switched out (kernel/fpu.h).
+     * Not a fault, so it never enters the recursion guard.  A kernel #NM, or
+     * a failed save-area allocation, takes the normal fault path below. */
+    if (vec == 7 && (regs->cs & 3) == 3) {
+      struct pt_regs *resume = arch_fpu_trap(regs);
+      if (resume)
+        return resume;
+    }
+
     /* Fault recursion guard (Phase A step 7): a fault inside a fault handler
      * used to recurse on the same stack until #DF -> triple fault.  Detect
      * the nesting FIRST — before any code that could itself fault — and stop
@@ -380,12 +394,16 @@ struct pt_regs *amd64_isr_dispatch(struct pt_regs *regs) {
         return ret_regs;
     }
 
+    trace_event(TRACE_EV_IRQ_ENTRY, trace_tid(), vec, 0);
+
     if (vec == 32) {
         /* Timer Interrupt (LAPIC periodic, vector 32; the PIT is halted
-         * after calibration — EXC-AMD64-03 resolved).
-         * NOTE(CPU-AMD64-01): No FPU save; ctx_switch on this path risks XMM
-         * corruption between concurrently running kernel tasks. */
-        ret_regs = kernel_timer_tick(regs);
+         * after calibration — EXC-AMD64-03 resolved).  A preemptive switch
+         * here hands the FP unit over in arch_fpu_switch (CPU-AMD64-01).
+         * While profiling, the timer runs faster and only every HZ-rate
+         * interrupt ticks (lapic_timer_prof). */
+        if (!lapic_timer_prof(regs))
+            ret_regs = kernel_timer_tick(regs);
     } else {
         /* All other Hardware interrupts - route via generic system */
         pr_debug("AMD64: Hardware Interrupt Vector %lu triggered!\n", vec);
@@ -396,6 +414,7 @@ struct pt_regs *amd64_isr_dispatch(struct pt_regs *regs) {
     /* End-of-interrupt through the chip (IRQ-01 fix): pic_chip_end() owns
      * the complete LAPIC + 8259 sequence; nothing here EOIs by hand. */
     irq_chip_end((uint32_t)vec);
+    trace_event(TRACE_EV_IRQ_EXIT, trace_tid(), vec, 0);
 
     return ret_regs;
   }
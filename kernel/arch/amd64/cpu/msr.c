@@ -22,13 +22,9 @@
  *   flag) on SYSCALL entry, preventing user RFLAGS from enabling interrupts or
  *   setting DF in kernel context before the kernel stack is set up.
  *
- * Known issues:
- *   SYS-AMD64-01 (W2 PERF/REFINE) The fast path is correctly configured via
- *     LSTAR (syscall_entry in syscall.S), but the return path uses 'iretq'
- *     instead of 'sysretq' (syscall.S:105-107).  This is intentional ("more
- *     robust") but 20-50 cycles slower.  Prerequisites for sysretq are met
- *     (RCX holds return RIP, R11 holds return RFLAGS), so the switch is
- *     straightforward when the performance regression is deemed unacceptable.
+ * SYS-AMD64-01 RESOLVED: syscall_entry (syscall.S) now leaves through
+ *   sysretq whenever that reproduces the frame being resumed, and keeps
+ *   iretq for the rest; STAR[63:48] below is what sysretq's CS/SS come from.
  */
 #include <kernel/types.h>
 #include <arch/arch.h>
@@ -69,9 +65,8 @@ extern void syscall_entry(void);
  *   - IA32_LSTAR = &syscall_entry : CPU will jump here on SYSCALL.
  *   - IA32_FMASK = 0x600 : IF and DF cleared on SYSCALL entry.
  *
- * NOTE(SYS-AMD64-01): syscall_entry (syscall.S) currently returns via iretq,
- * not sysretq.  The LSTAR/FMASK setup is correct for both; only the exit path
- * in syscall.S needs to change to use sysretq.
+ * syscall_entry returns through sysretq when it can (SYS-AMD64-01), iretq
+ * otherwise; both rely on FMASK having cleared IF on entry.
  */
 void amd64_syscall_init(void) {
   uint64_t star;
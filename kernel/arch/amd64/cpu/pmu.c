@@ -0,0 +1,102 @@
+/*
+ * kernel/arch/amd64/cpu/pmu.c
+ * Intel architectural performance monitoring for kernel/pmu.h.
+ *
+ * CPUID leaf 0xA describes the PMU: its version, the number and width of
+ * the general-purpose counters, and which architectural events are absent.
+ * Each PMU_* event that is present takes the next general-purpose counter
+ * (IA32_PERFEVTSELn / IA32_PMCn), counting in ring 0 and ring 3; from
+ * version 2 on the counters must also be enabled in IA32_PERF_GLOBAL_CTRL.
+ *
+ * AMD parts and guests without a virtual PMU (QEMU TCG) report version 0.
+ * PMU_CYCLES then comes from the TSC, which ticks at a fixed reference
+ * rate rather than per core cycle but still compares how long threads ran.
+ */
+#include <cpuid.h>
+#include <arch/arch.h>
+#include <kernel/pmu.h>
+
+#define IA32_PMC0             0x0C1
+#define IA32_PERFEVTSEL0      0x186
+#define IA32_PERF_GLOBAL_CTRL 0x38F
+
+#define EVTSEL_USR (1u << 16)
+#define EVTSEL_OS  (1u << 17)
+#define EVTSEL_EN  (1u << 22)
+
+/* Architectural event encodings and the CPUID.0AH:EBX bit that is set when
+ * the event is not available. */
+static const struct {
+  uint8_t event, umask, absent_bit;
+} arch_events[PMU_NR_EVENTS] = {
+    [PMU_CYCLES] = {0x3C, 0x00, 0},
+    [PMU_INSTRUCTIONS] = {0xC0, 0x00, 1},
+    [PMU_CACHE_MISSES] = {0x2E, 0x41, 4},
+    [PMU_BRANCH_MISSES] = {0xC5, 0x00, 6},
+};
+
+/* pmu_counter[e]: the IA32_PMCn counting event e, -1 if none.  Set once
+ * by arch_pmu_probe() on the BSP; every CPU programs the same assignment. */
+static int pmu_counter[PMU_NR_EVENTS];
+static int pmu_tsc_cycles;
+
+void arch_pmu_probe(struct pmu_hw *hw) {
+  uint32_t eax = 0, ebx = 0, ecx, edx;
+  if (__get_cpuid_max(0, NULL) >= 0xA)
+    __cpuid(0xA, eax, ebx, ecx, edx);
+  uint32_t version = eax & 0xFF, ngp = (eax >> 8) & 0xFF;
+  uint32_t width = (eax >> 16) & 0xFF, nbits = (eax >> 24) & 0xFF;
+
+  for (int e = 0; e < PMU_NR_EVENTS; e++)
+    pmu_counter[e] = -1;
+  hw->version = version;
+  hw->ncounters = version ? ngp : 0;
+
+  if (version == 0 || ngp == 0 || width == 0) {
+    pmu_tsc_cycles = 1;
+    hw->events = PMU_EV(PMU_CYCLES);
+    hw->mask[PMU_CYCLES] = ~0ULL;
+    return;
+  }
+
+  uint64_t mask = width >= 64 ? ~0ULL : (1ULL << width) - 1;
+  uint32_t next = 0;
+  for (int e = 0; e < PMU_NR_EVENTS && next < ngp; e++) {
+    uint32_t bit = arch_events[e].absent_bit;
+    if (bit >= nbits || (ebx & (1u << bit)))
+      continue;
+    pmu_counter[e] = (int)next++;
+    hw->events |= PMU_EV(e);
+    hw->mask[e] = mask;
+  }
+  pmu_tsc_cycles = !(hw->events & PMU_EV(PMU_CYCLES));
+  if (pmu_tsc_cycles) {
+    hw->events |= PMU_EV(PMU_CYCLES);
+    hw->mask[PMU_CYCLES] = ~0ULL;
+  }
+}
+
+void arch_pmu_start_cpu(const struct pmu_hw *hw) {
+  uint64_t global = 0;
+  for (int e = 0; e < PMU_NR_EVENTS; e++) {
+    if (pmu_counter[e] < 0)
+      continue;
+    uint32_t n = (uint32_t)pmu_counter[e];
+    wrmsr(IA32_PERFEVTSEL0 + n, 0);
+    wrmsr(IA32_PMC0 + n, 0);
+    wrmsr(IA32_PERFEVTSEL0 + n, arch_events[e].event |
+                                    ((uint32_t)arch_events[e].umask << 8) |
+                                    EVTSEL_USR | EVTSEL_OS | EVTSEL_EN);
+    global |= 1ULL << n;
+  }
+  if (global && hw->version >= 2)
+    wrmsr(IA32_PERF_GLOBAL_CTRL, rdmsr(IA32_PERF_GLOBAL_CTRL) | global);
+}
+
+void arch_pmu_read(uint64_t raw[PMU_NR_EVENTS]) {
+  for (int e = 0; e < PMU_NR_EVENTS; e++)
+    raw[e] = pmu_counter[e] >= 0 ? rdmsr(IA32_PMC0 + (uint32_t)pmu_counter[e])
+                                 : 0;
+  if (pmu_tsc_cycles)
+    raw[PMU_CYCLES] = arch_impl_timer_get_count();
+}
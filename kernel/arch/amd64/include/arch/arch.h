@@ -68,6 +68,15 @@ static inline uint32_t arch_impl_get_cpu_id(void) {
   return (*(volatile uint32_t *)(uintptr_t)(0xFEE00020UL + KERNEL_VIRT_BASE)) >> 24;
 }
 
+/* The running CPU's struct cpu_info: IA32_GS_BASE points at it and its first
+ * word is cpu_info.self, so one %gs-relative load.  start.S points GS at a
+ * zero word before C runs, so this is NULL until arch_cpu_init(). */
+static inline void *arch_impl_percpu_self(void) {
+  void *p;
+  __asm__ __volatile__("movq %%gs:0, %0" : "=r"(p));
+  return p;
+}
+
 /* --- VMM / TLB --- */
 static inline void arch_impl_set_pgd(uint64_t pgd) {
   __asm__ __volatile__("mov %0, %%cr3" ::"r"(pgd) : "memory");
@@ -137,8 +146,12 @@ static inline void arch_impl_cache_sync_icache(void *start, size_t size) {
 }
 
 /* --- Timer --- */
+/* tsc_hz: TSC ticks per second, measured by lapic_timer_calibrate() against
+ * the PIT (apic.c); 0 until then. */
+extern uint64_t tsc_hz;
+
 static inline uint64_t arch_impl_timer_get_freq(void) {
-  return 1000000000ULL; /* Calibrated at boot usually */
+  return tsc_hz ? tsc_hz : 1000000000ULL;
 }
 
 static inline uint64_t arch_impl_timer_get_count(void) {
@@ -151,18 +164,11 @@ static inline void arch_impl_timer_set_compare(uint64_t val) { (void)val; }
 static inline void arch_impl_timer_control(uint32_t val) { (void)val; }
 
 /* --- Spinlocks --- */
-static inline void arch_impl_spin_lock(volatile uint32_t *lock) {
-    while (__sync_lock_test_and_set(lock, 1)) {
-        while (*lock) __asm__ __volatile__("pause");
-    }
-}
-
-static inline void arch_impl_spin_unlock(volatile uint32_t *lock) {
-    __sync_lock_release(lock);
-}
-
-static inline int arch_impl_spin_trylock(volatile uint32_t *lock) {
-    return __sync_lock_test_and_set(lock, 1) == 0;
+/* One back-off step while *p == seen (kernel/spinlock.h). */
+static inline void arch_impl_spin_wait(volatile uint32_t *p, uint32_t seen) {
+    (void)p;
+    (void)seen;
+    __asm__ __volatile__("pause" ::: "memory");
 }
 
 /* --- System Registers --- */
@@ -79,6 +79,14 @@ static inline void pt_regs_set_return(struct pt_regs *r, uint64_t v) {
 /* Get program counter (RIP) */
 static inline uint64_t pt_regs_pc(struct pt_regs *r) { return r->rip; }
 
+/* Frame pointer (RBP) at the exception: seed of a frame-pointer walk */
+static inline uint64_t pt_regs_fp(struct pt_regs *r) { return r->rbp; }
+
+/* Taken from ring 3 (CPL in the saved CS) */
+static inline int pt_regs_user_mode(struct pt_regs *r) {
+  return (r->cs & 3) == 3;
+}
+
 /* Set program counter */
 static inline void pt_regs_set_pc(struct pt_regs *r, uint64_t v) {
   r->rip = v;
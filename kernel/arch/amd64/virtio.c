@@ -86,6 +86,10 @@ static uint32_t modern_read32(struct virtio_device *dev, uint32_t offset) {
   uint32_t mod_off = translate_modern(offset);
   if (mod_off == 0xFFFFFFFF)
     return 0;
+  if (mod_off == 0x16 || mod_off == 0x18)
+    return hal_read16(dev->base + mod_off); /* 16-bit queue_select/size */
+  if (mod_off == 0x14)
+    return hal_read8(dev->base + mod_off);
   return hal_read32(dev->base + mod_off);
 }
 
@@ -102,14 +106,25 @@ static void modern_write32(struct virtio_device *dev, uint32_t offset,
   }
 
   uint32_t mod_off = translate_modern(offset);
-  if (mod_off != 0xFFFFFFFF) {
+  if (mod_off == 0x16 || mod_off == 0x18) {
+    /* A 32-bit write at queue_select would also zero queue_size (and one
+     * at queue_size the MSI-X vector): these are 16-bit fields. */
+    hal_write16(dev->base + mod_off, (uint16_t)val);
+  } else if (mod_off == 0x14) {
+    hal_write8(dev->base + mod_off, (uint8_t)val);
+  } else if (mod_off != 0xFFFFFFFF) {
     hal_write32(dev->base + mod_off, val);
   }
 }
 
 static void modern_notify(struct virtio_device *dev, uint32_t queue_idx) {
   if (dev->notify_base) {
-    hal_write16(dev->notify_base, (uint16_t)queue_idx);
+    /* The device decodes the queue from the address, not the value written:
+     * every queue but 0 needs its own notify offset. */
+    uintptr_t off = 0;
+    if (queue_idx < VIRTIO_MAX_QUEUES)
+      off = (uintptr_t)dev->queue_notify_off[queue_idx] * dev->notify_mult;
+    hal_write16(dev->notify_base + off, (uint16_t)queue_idx);
   } else {
     /* Fallback if no notify capability found */
     hal_write16(dev->base + 0x3000, (uint16_t)queue_idx);
@@ -214,6 +229,8 @@ static void virtio_pci_init_device(struct hal_device *hdev) {
           vdev->hal_dev.base = vdev->base;
         } else if (type == 2) { /* Notifications */
           vdev->notify_base = bar_addr + offset;
+          vdev->notify_mult =
+              pci_config_read(bus, dev_idx, func, cap_ptr + 16);
         } else if (type == 3) { /* ISR Status */
           vdev->isr_base = bar_addr + offset;
         } else if (type == 4) { /* Device Specific */
@@ -304,6 +321,8 @@ void virtio_setup_queue(virtio_handle_t dev, uint32_t queue_idx,
                         uint64_t used_addr) {
   if (dev->ops == &modern_ops) {
     modern_write32(dev, VIRTIO_MMIO_QUEUE_SEL, queue_idx);
+    if (queue_idx < VIRTIO_MAX_QUEUES)
+      dev->queue_notify_off[queue_idx] = hal_read16(dev->base + 0x1E);
     /* Modern registers: desc(0x20), avail(0x28), used(0x30) */
     hal_write32(dev->base + 0x20, (uint32_t)desc_addr);
     hal_write32(dev->base + 0x24, (uint32_t)(desc_addr >> 32));
@@ -0,0 +1,108 @@
+/*
+ * kernel/core/pmu.c
+ * Per-thread performance counters (see kernel/pmu.h): the context-switch
+ * and tick folds and SYS_PMU.
+ */
+#include <kernel/arch.h>
+#include <kernel/cpu.h>
+#include <kernel/pmu.h>
+#include <kernel/printk.h>
+#include <kernel/rcu.h>
+#include <kernel/sched.h>
+#include <kernel/string.h>
+
+struct pmu_hw pmu_hw;
+
+void pmu_init_cpu(void) {
+  struct cpu_info *cpu = get_cpu_info();
+  if (cpu->cpu_id == 0) {
+    memset(&pmu_hw, 0, sizeof(pmu_hw));
+    arch_pmu_probe(&pmu_hw);
+    if (pmu_hw.events)
+      pr_info("PMU: version %u, %u counters, events 0x%x\n", pmu_hw.version,
+              pmu_hw.ncounters, pmu_hw.events);
+    else
+      pr_info("PMU: no counters\n");
+  }
+  arch_pmu_start_cpu(&pmu_hw);
+  arch_pmu_read(cpu->pmu_last);
+}
+
+void __pmu_fold(struct process *p) {
+  struct cpu_info *cpu = get_cpu_info();
+  uint64_t now[PMU_NR_EVENTS];
+  arch_pmu_read(now);
+  for (int i = 0; i < PMU_NR_EVENTS; i++) {
+    uint64_t d = (now[i] - cpu->pmu_last[i]) & pmu_hw.mask[i];
+    cpu->pmu_last[i] = now[i];
+    if (p)
+      __atomic_store_n(&p->pmu_count[i], p->pmu_count[i] + d,
+                       __ATOMIC_RELAXED);
+  }
+}
+
+void pmu_tick(void) {
+  if (pmu_on())
+    __pmu_fold(get_cpu_info()->current_task);
+}
+
+static long pmu_read(int tid, struct pmu_counts *out) {
+  uint64_t flags;
+  long rc = 0;
+  rcu_read_lock(&flags);
+  struct process *self = current_process;
+  struct process *p = tid ? __process_find_by_pid(tid) : self;
+  if (!p) {
+    rc = -ESRCH;
+  } else if (p != self && !process_kill_allowed(self, tid)) {
+    /* Cache and branch miss counts of an unrelated process are a side
+     * channel: same rule as SYS_KILL. */
+    rc = -EPERM;
+  } else {
+    if (p == self && pmu_on())
+      __pmu_fold(p);
+    for (int i = 0; i < PMU_NR_EVENTS; i++)
+      out->count[i] = __atomic_load_n(&p->pmu_count[i], __ATOMIC_RELAXED);
+  }
+  rcu_read_unlock(flags);
+  out->events = pmu_hw.events;
+  out->pad = 0;
+  return rc;
+}
+
+static void pmu_reset(void) {
+  uint64_t flags;
+  hal_irq_save(&flags);
+  struct process *self = current_process;
+  if (pmu_on())
+    __pmu_fold(NULL); /* restart the baseline; the counts are dropped */
+  for (int i = 0; i < PMU_NR_EVENTS; i++)
+    __atomic_store_n(&self->pmu_count[i], 0, __ATOMIC_RELAXED);
+  hal_irq_restore(flags);
+}
+
+long sys_pmu(int op, uint64_t a1, uint64_t a2) {
+  switch (op) {
+  case PMU_READ: {
+    struct pmu_counts c;
+    long rc = pmu_read((int)a1, &c);
+    if (rc == 0 && arch_copy_to_user((void *)a2, &c, sizeof(c)) != 0)
+      return -EFAULT;
+    return rc;
+  }
+  case PMU_RESET:
+    pmu_reset();
+    return 0;
+  case PMU_INFO: {
+    struct pmu_info info;
+    info.events = pmu_hw.events;
+    info.version = pmu_hw.version;
+    info.ncounters = pmu_hw.ncounters;
+    info.pad = 0;
+    return arch_copy_to_user((void *)a1, &info, sizeof(info)) != 0 ? -EFAULT
+                                                                   : 0;
+  }
+  default:
+    return -EINVAL;
+  }
+}
@@ -2,12 +2,14 @@
  * kernel/core/syscall_dispatch.c
  * Architecture-Agnostic Syscall Dispatcher
  *
- * This file is the central syscall switch for OS1/NEXS.  The arch-specific
- * syscall entry stub (aarch64: svc_handler / amd64: syscall entry in cpu.c)
- * calls kernel_syscall_dispatcher() with the saved register frame.  This
- * function reads the syscall number and arguments from the frame via the
- * pt_regs_* accessor macros (arch-agnostic) and dispatches to the appropriate
- * implementation.
+ * This file holds the syscall table for OS1/NEXS (kernel/syscall.h).  The
+ * arch-specific syscall entry stub (aarch64: svc_handler / amd64:
+ * syscall_entry in syscall.S) calls kernel_syscall_dispatcher() with the
+ * saved register frame, which looks the number up in syscall_table, reads
+ * the entry's arguments via the pt_regs_* accessor macros (arch-agnostic)
+ * and calls its implementation.  SYSCALL_LEAN entries are called straight
+ * from the entry stub without a frame (amd64 syscall.S, aarch64
+ * exception.S).
  *
  * Role / layering:
  *   userland svc/syscall -> arch entry (context.S / cpu.c)
@@ -19,14 +21,14 @@
  * Key invariants:
  *   - All user pointers (arg0..arg5) must be validated via arch_copy_*_from_user
  *     or arch_copy_string_from_user before being dereferenced in the kernel.
- *   - Syscall implementations must not return directly; they write the return
- *     value via pt_regs_set_return() and fall through to "return frame", OR
- *     they call schedule() and return its result (a different task's frame).
+ *   - Value calls (SYSCALL_DEFINE) return the result and never see the
+ *     frame; frame calls write it via pt_regs_set_return() and return frame,
+ *     OR call schedule() and return its result (a different task's frame).
  *   - cpu->syscall_buf (a per-CPU scratch buffer) is used for path/title copies;
  *     only one such copy is in flight per CPU at any time.
  *
  * ABI (Phase B3):
- *   Numbering (ABI-01/ABI-SYS-01 RESOLVED): the switch uses the SYS_*
+ *   Numbering (ABI-01/ABI-SYS-01 RESOLVED): the table is indexed by the SYS_*
  *   macros from include/api/syscall_nums.h — the same header the userland
  *   stubs assemble against, so the two sides cannot drift.  The legacy
  *   duplicate IPC numbers (30/31/32) are gone (SEND/RECV/TRY_RECV =
@@ -44,6 +46,15 @@
  *   SYS_SPAWN / SYS_SPAWN_CAPS  need CAP_SPAWN — else -EPERM.
  *   SYS_KILL         caller must be privileged, the target itself, or an
  *                    ancestor of it (process_kill_allowed) — else -EPERM.
+ *   SYS_SCHED_SETATTR  SCHED_RT needs root/machine level; another
+ *                    thread's class needs process_kill_allowed — else -EPERM.
+ *   SYS_TRACE        root/machine level — else -EPERM.
+ *   SYS_LOCKSTAT     anyone may read; LOCKSTAT_RESET needs root/machine.
+ *   SYS_CPUSTAT      anyone may read.
+ *   SYS_PROF         root/machine level — else -EPERM.
+ *   SYS_PMU          PMU_READ of another process needs process_kill_allowed
+ *                    (own threads, descendants, root/machine) — else -EPERM;
+ *                    PMU_RESET is the caller's.
  *   SYS_CREATE_WINDOW / SYS_SET_FOCUS  need CAP_WINDOW — else -EPERM;
  *                    cross-PID focus still needs machine level.
  *   SYS_DESTROY_WINDOW  owner or machine only — else -EPERM.
@@ -60,7 +71,9 @@
  * Fd model (ABI-03 RESOLVED, B3 batch 3): every process has a real fd table
  *   (kernel/fd.h) — 0=keyboard stdin, 1/2=own window, open() hands out
  *   FD_FILE descriptors >= 3 with a private offset (open/close/lseek =
- *   56/57/62).  The historical "fd >= 100 is a window id" write path
+ *   56/57/62).  pipe2 (59) hands out FD_PIPE ends (kernel/pipe.h), and
+ *   SYS_SPAWN_FDS gives a child copies of chosen fds, so the shell can
+ *   wire `a | b`.  The historical "fd >= 100 is a window id" write path
  *   remains as a compatibility alias until the window ABI moves onto the
  *   table.
  *
@@ -82,7 +95,22 @@
 #include <kernel/string.h>
 #include <kernel/kmalloc.h>
 #include <kernel/vfs.h>
+#include <kernel/futex.h>
+#include <kernel/endpoint.h>
+#include <kernel/channel.h>
+#include <kernel/event.h>
+#include <kernel/ntfn.h>
+#include <kernel/uring.h>
+#include <kernel/percpu.h>
+#include <kernel/pipe.h>
+#include <kernel/klog.h>
+#include <kernel/syscall.h>
+#include <kernel/trace.h>
+#include <kernel/prof.h>
+#include <kernel/pmu.h>
 #include <syscall_nums.h>
+#include <futex.h>
+#include <sys/uio.h>
 
 /*
  * FIX(EXT4-07): upper bound for kmalloc'd bounce buffers whose size comes
@@ -107,6 +135,16 @@
  */
 extern long sys_write(int fd, const char *buf, size_t count);
 extern struct pt_regs *sys_read(struct pt_regs *regs);
+static long sys_read_nowait(int fd, char *buf, size_t count);
+static long fd_readv_nowait(int fd, const struct iovec *uiov, int iovcnt,
+                            long pos);
+static long fd_writev(int fd, const struct iovec *uiov, int iovcnt, long pos);
+static long fd_pread(int fd, char *buf, size_t count, long pos);
+static long fd_pwrite(int fd, const char *buf, size_t count, long pos);
+static struct pt_regs *fd_block(struct pt_regs *frame, int fd, int write,
+                                size_t n);
+static int fd_close(int fd);
+static struct fd_entry *fd_lookup(int fd);
 extern long sys_get_pid(void);
 extern void sys_exit(int status);
 extern long sys_get_time(void);
@@ -121,7 +159,7 @@ extern void compositor_destroy_window(int window_id);
 extern void compositor_window_write(int win_id, const char *buf, size_t count);
 extern int compositor_get_window_by_pid(int pid);
 
-extern int sys_ipc_send(int target_pid, void *msg_ptr);
+extern int sys_ipc_send(int target_pid, void *msg_ptr, int flags);
 extern int sys_ipc_recv(int src_pid, void *msg_ptr);
 extern int sys_ipc_try_recv(int src_pid, void *msg_ptr);
 
@@ -138,46 +176,29 @@ extern int arch_copy_string_from_user(char *dest, const char *src, size_t max_le
 
 extern int keyboard_focus_pid;
 
-/*
- * kernel_syscall_dispatcher - dispatch a syscall from the saved register frame.
- *
- * Entry point called by the arch-specific svc/syscall handler immediately
- * after saving all user registers into 'frame'.  Reads syscall_num and up
- * to six arguments from frame via pt_regs_* accessors.
- *
- * Returns: a pt_regs* to restore.  In the common (non-blocking) case this is
- *          'frame' itself with the return value written via pt_regs_set_return().
- *          For blocking operations (EXIT/YIELD/IPC RECV and sometimes IPC SEND)
- *          this is the frame of the next scheduled process.
- *
- * Locking: no locks held on entry; individual cases may acquire
- *          sched_lock / msg_lock / per-CPU sched_lock internally.
- * IRQ context: no — syscalls run in kernel mode with IRQs enabled (normal
- *          exception-level transition on aarch64; ring 3->0 on amd64).
- *
- * NOTE(ABI-07): case 220 (SPAWN) calls arch_local_irq_disable() before
- *          process_create + process_load_elf, which may block on virtio I/O.
- */
-struct pt_regs *kernel_syscall_dispatcher(struct pt_regs *frame);
-
 /* argv marshalling limits for SYS_SPAWN.  ELF_MAX_ARGS in elf.c must be >=
  * SPAWN_MAX_ARGS; SPAWN_ARG_LEN bounds each NUL-terminated argument. */
 #define SPAWN_MAX_ARGS 16
 #define SPAWN_ARG_LEN  128
 
-/* dispatch_spawn - shared body for SYS_SPAWN and SYS_SPAWN_CAPS.
+/* dispatch_spawn - shared body for SYS_SPAWN, SYS_SPAWN_CAPS and
+ * SYS_SPAWN_FDS.  fdmap / nmap (may be NULL / 0) seed the child's fd table
+ * from the caller's (process_fd_inherit) before it first runs.
  *
  * NOTE(ABI-07): runs process_create + process_load_elf with IRQs disabled
  * across blocking virtio/ext4 disk I/O.  Pre-existing; kept verbatim so the
  * new capability path does not widen the critical section. */
 static long dispatch_spawn(const char *path, uint8_t level, uint32_t caps,
-                           int use_caps, int argc, char *const kargv[]) {
+                           int use_caps, int argc, char *const kargv[],
+                           const int *fdmap, int nmap) {
   arch_local_irq_disable();
   struct process *p =
       use_caps ? process_create_caps(path, PROC_PRIO_USER, level, caps)
                : process_create(path, PROC_PRIO_USER, level);
   long ret;
   if (p) {
+    if (nmap > 0)
+      process_fd_inherit(p->space, current_process->space, fdmap, nmap);
     if (process_load_elf_args(p, path, argc, kargv) == 0) {
       enqueue_task(p);
       ret = (long)p->pid;
@@ -193,11 +214,18 @@ static long dispatch_spawn(const char *path, uint8_t level, uint32_t caps,
 }
 
 /* window_text_write - copy a user text buffer into a kmalloc bounce (no
- * truncation; capped at SYSCALL_MAX_IO_BYTES), mirror it to the UART serial
- * log, and append it to compositor window win_id.  Shared by the FD_WIN
- * stdout sink and SYS_WINDOW_WRITE (#123).  Replaces the old 1023-byte
- * syscall_buf truncation (retires ABI-06 on the window path). */
-extern void uart_puts(const char *str);
+ * truncation; capped at SYSCALL_MAX_IO_BYTES), mirror it to the serial log
+ * (as raw kernel log records, so a chatty program never waits for the UART),
+ * and append it to compositor window win_id.  Shared by the FD_WIN stdout
+ * sink and SYS_WINDOW_WRITE (#123).  Replaces the old 1023-byte syscall_buf
+ * truncation (retires ABI-06 on the window path). */
+static void window_text_put(int win_id, const char *k, size_t count) {
+  klog_write(k, count, KLOG_RAW);
+  klog_kick();
+  if (win_id > 0)
+    compositor_window_write(win_id, k, count);
+}
+
 static long window_text_write(int win_id, const char *ubuf, size_t count) {
   if (count == 0)
     return 0;
@@ -211,550 +239,932 @@ static long window_text_write(int win_id, const char *ubuf, size_t count) {
     return -EFAULT;
   }
   k[count] = '\0';
-  uart_puts(k);
-  if (win_id > 0)
-    compositor_window_write(win_id, k, count);
+  window_text_put(win_id, k, count);
   kfree(k);
   return (long)count;
 }
 
-struct pt_regs *kernel_syscall_dispatcher(struct pt_regs *frame) {
-  uint64_t syscall_num = pt_regs_syscall_num(frame);
-  uint64_t arg0 = pt_regs_arg(frame, 0);
-  uint64_t arg1 = pt_regs_arg(frame, 1);
-  uint64_t arg2 = pt_regs_arg(frame, 2);
-  uint64_t arg3 = pt_regs_arg(frame, 3);
-  uint64_t arg4 = pt_regs_arg(frame, 4);
-  uint64_t arg5 = pt_regs_arg(frame, 5);
-
-  switch (syscall_num) {
-  case SYS_OPEN:
-  {
-    /* open(path, flags) -> fd (ABI-03).  Only the O_ACCMODE bits are
-     * supported: the VFS cannot create or truncate files yet, so any other
-     * flag (O_CREAT, O_APPEND, ...) is an explicit -EINVAL, never silently
-     * ignored. */
-    if (!current_process) {
-      pt_regs_set_return(frame, -EPERM);
-      break;
-    }
-    int flags = (int)arg1;
-    if (flags & ~O_ACCMODE) {
-      pt_regs_set_return(frame, -EINVAL);
-      break;
-    }
-    char k_path[FD_PATH_MAX];
-    if (arch_copy_string_from_user(k_path, (const char *)arg0, FD_PATH_MAX) != 0) {
-      pt_regs_set_return(frame, -EFAULT);
-      break;
-    }
-    char resolved[FD_PATH_MAX];
-    vfs_resolve_path(k_path, resolved, FD_PATH_MAX);
-    if ((flags & O_ACCMODE) != O_RDONLY) {
-      /* USR-SEC-03 #79: any write needs CAP_FS_WRITE. */
-      if (!proc_has_cap(current_process, CAP_FS_WRITE)) {
-        pt_regs_set_return(frame, -EPERM);
-        break;
-      }
-      /* Same write ACL as SYS_FILE_WRITE (EXT4-02): the /bin and /sys trees
-       * are read-only for non-machine processes even with CAP_FS_WRITE. */
-      if (!proc_is_machine(current_process) &&
-          (strncmp(resolved, "/sys/", 5) == 0 ||
-           strncmp(resolved, "/bin/", 5) == 0)) {
-        pt_regs_set_return(frame, -EACCES);
-        break;
-      }
-    }
-    struct vfs_node node;
-    if (vfs_open(resolved, &node) != 0) {
-      pt_regs_set_return(frame, -ENOENT);
-      break;
-    }
-    if (node.type != VFS_TYPE_FILE) {
-      pt_regs_set_return(frame, -EISDIR);
-      break;
-    }
-    int newfd = -1;
-    for (int i = 0; i < NPROC_FDS; i++) {
-      if (current_process->fds[i].type == FD_NONE) {
-        newfd = i;
-        break;
-      }
-    }
-    if (newfd < 0) {
-      pt_regs_set_return(frame, -EMFILE);
-      break;
-    }
-    struct fd_entry *e = &current_process->fds[newfd];
-    memset(e, 0, sizeof(*e));
-    e->type = FD_FILE;
-    e->mode = ((flags & O_ACCMODE) == O_RDONLY)   ? FD_MODE_READ
-              : ((flags & O_ACCMODE) == O_WRONLY) ? FD_MODE_WRITE
-                                                  : (FD_MODE_READ | FD_MODE_WRITE);
-    e->node = node;
-    e->offset = 0;
-    strncpy(e->path, resolved, FD_PATH_MAX - 1);
-    pt_regs_set_return(frame, newfd);
-  } break;
-  case SYS_CLOSE:
-  {
-    int fd = (int)arg0;
-    if (!current_process || fd < 0 || fd >= NPROC_FDS ||
-        current_process->fds[fd].type == FD_NONE) {
-      pt_regs_set_return(frame, -EBADF);
-      break;
-    }
-    /* Entries hold no kernel-owned resources (vfs_node is a value type) —
-     * clearing the slot IS the close. */
-    memset(&current_process->fds[fd], 0, sizeof(struct fd_entry));
-    pt_regs_set_return(frame, 0);
-  } break;
-  case SYS_LSEEK:
-  {
-    int fd = (int)arg0;
-    long off = (long)arg1;
-    int whence = (int)arg2;
-    if (!current_process || fd < 0 || fd >= NPROC_FDS ||
-        current_process->fds[fd].type == FD_NONE) {
-      pt_regs_set_return(frame, -EBADF);
-      break;
-    }
-    struct fd_entry *e = &current_process->fds[fd];
-    if (e->type != FD_FILE) {
-      pt_regs_set_return(frame, -ESPIPE); /* KBD/WIN streams cannot seek */
-      break;
-    }
-    long base;
-    if (whence == SEEK_SET) {
-      base = 0;
-    } else if (whence == SEEK_CUR) {
-      base = (long)e->offset;
-    } else if (whence == SEEK_END) {
-      /* stat the path: e->node.size is the open-time size and another fd
-       * may have grown the file since */
-      struct vfs_stat st;
-      base = (vfs_stat(e->path, &st) == 0) ? (long)st.size
-                                           : (long)e->node.size;
-    } else {
-      pt_regs_set_return(frame, -EINVAL);
-      break;
-    }
-    long npos = base + off;
-    if (npos < 0) {
-      pt_regs_set_return(frame, -EINVAL);
-      break;
-    }
-    e->offset = (uint64_t)npos;
-    pt_regs_set_return(frame, npos);
-  } break;
-  case SYS_READ:
-    return sys_read(frame);
-  case SYS_WRITE:
-    pt_regs_set_return(frame, sys_write((int)arg0, (const char *)arg1, (size_t)arg2));
-    break;
-  case SYS_EXIT:
-    sys_exit((int)arg0);
-    return schedule(frame);
-  case SYS_GET_TIME:
-    pt_regs_set_return(frame, sys_get_time());
-    break;
-  case SYS_GETPID:
-    pt_regs_set_return(frame, sys_get_pid());
-    break;
-  case SYS_DRAW:
-    graphics_draw_rect((int)arg0, (int)arg1, (int)arg2, (int)arg3, (uint32_t)arg4);
-    pt_regs_set_return(frame, 0);
-    break;
-  case SYS_FLUSH:
-    compositor_render();
-    pt_regs_set_return(frame, 0);
-    break;
-  case SYS_CREATE_WINDOW:
-  {
-    /* USR-SEC-03 #79: drawing a window needs CAP_WINDOW. */
-    if (!proc_has_cap(current_process, CAP_WINDOW)) {
-      pt_regs_set_return(frame, -EPERM);
-      break;
-    }
-    struct cpu_info *cpu = get_cpu_info();
-    char *k_title = cpu->syscall_buf;
-    if (arch_copy_string_from_user(k_title, (const char *)arg4, 64) != 0) {
-      pt_regs_set_return(frame, -EFAULT);
-      break;
-    }
-    pt_regs_set_return(frame, compositor_create_window((int)arg0, (int)arg1, (int)arg2, (int)arg3, k_title, current_process->pid));
-  } break;
-  case SYS_WINDOW_DRAW:
-    compositor_draw_rect((int)arg0, (int)arg1, (int)arg2, (int)arg3, (int)arg4, (uint32_t)arg5, current_process->pid);
-    pt_regs_set_return(frame, 0);
-    break;
-  case SYS_WINDOW_WRITE:
-    /* write text to a window by id (#123) — needs CAP_WINDOW.  Replaces the
-     * old fd>=100 overload on write(). */
-    if (!proc_has_cap(current_process, CAP_WINDOW)) {
-      pt_regs_set_return(frame, -EPERM);
-      break;
-    }
-    pt_regs_set_return(
-        frame, window_text_write((int)arg0, (const char *)arg1, (size_t)arg2));
-    break;
-  case SYS_WINDOW_OF_PID: {
-    /* Read-only: the compositor window id of a pid, or 0 if it has none.
-     * The shell uses it to tell a windowless (run-in-shell) program from one
-     * that opened its own window (#123).  No capability needed. */
-    extern int compositor_get_window_by_pid(int pid);
-    int w = compositor_get_window_by_pid((int)arg0);
-    pt_regs_set_return(frame, w > 0 ? w : 0);
-    break;
-  }
-  case SYS_WINDOW_GRID: {
-    /* Read-only: terminal character grid of a window, packed (cols<<16)|rows.
-     * A windowed TTY app (kilo) queries this to size itself to the compositor
-     * font cell instead of assuming a fixed 80x25.  -EINVAL if no such window. */
-    extern int compositor_window_grid(int win_id, int *cols, int *rows);
-    int cols = 0, rows = 0;
-    if (compositor_window_grid((int)arg0, &cols, &rows) != 0)
-      pt_regs_set_return(frame, -EINVAL);
-    else
-      pt_regs_set_return(frame, ((long)(cols & 0xFFFF) << 16) | (rows & 0xFFFF));
-    break;
-  }
-  case SYS_COMPOSITOR_RENDER:
-    compositor_render();
-    pt_regs_set_return(frame, 0);
-    break;
-  case SYS_WINDOW_BLIT:
-    compositor_blit((int)arg0, (int)arg1, (int)arg2, (int)arg3, (int)arg4, (const uint32_t *)arg5, current_process->pid);
-    pt_regs_set_return(frame, 0);
-    break;
-  case SYS_WINDOW_SET_FLAGS:
-    compositor_set_window_flags((int)arg0, (int)arg1);
-    pt_regs_set_return(frame, 0);
-    break;
-  case SYS_DESTROY_WINDOW:
-  {
-    /* ABI-04: only the window's owner (or a system process) may destroy it.
-     * Kernel-internal teardown (close button, process exit) calls
-     * compositor_destroy_window() directly and is unaffected. */
-    extern int compositor_window_owner(int window_id);
-    int owner = compositor_window_owner((int)arg0);
-    if (owner >= 0 && owner != (int)current_process->pid &&
-        !proc_is_machine(current_process)) {
-      pt_regs_set_return(frame, -EPERM);
-      break;
-    }
-    compositor_destroy_window((int)arg0);
-    pt_regs_set_return(frame, 0);
-  } break;
-  case SYS_SBRK:
-    pt_regs_set_return(frame, sys_sbrk((intptr_t)arg0));
-    break;
-  case SYS_SPAWN:
-  {
-    /* USR-SEC-03 #79: spawning needs CAP_SPAWN.  A plain spawn yields a full
-     * PLVL_USER child (clamped to the creator), preserving today's behaviour. */
-    if (!proc_has_cap(current_process, CAP_SPAWN)) {
-      pt_regs_set_return(frame, -EPERM);
-      break;
-    }
-    struct cpu_info *cpu = get_cpu_info();
-    char *k_path = cpu->syscall_buf;
-    if (arch_copy_string_from_user(k_path, (const char *)arg0, 128) != 0) {
-      pt_regs_set_return(frame, -EFAULT);
+/*
+ * Syscall implementations, one per table entry (kernel/syscall.h).
+ *
+ * SYSCALL_DEFINE(name) declares a value call: the six argument registers
+ * a0..a5 in, the result register out.  Frame calls take (frame, a[]) and
+ * return the frame to restore; they are the only ones that may schedule()
+ * or leave the return register alone for a retried syscall.
+ */
+#define SC_ARG(n) uint64_t a##n __attribute__((unused))
+#define SYSCALL_DEFINE(name)                                                   \
+  static long name(SC_ARG(0), SC_ARG(1), SC_ARG(2), SC_ARG(3), SC_ARG(4),     \
+                   SC_ARG(5))
+
+/* --- POSIX-shaped --- */
+
+SYSCALL_DEFINE(sc_open) {
+  /* open(path, flags) -> fd (ABI-03).  Only the O_ACCMODE bits are
+   * supported: the VFS cannot create or truncate files yet, so any other
+   * flag (O_CREAT, O_APPEND, ...) is an explicit -EINVAL, never silently
+   * ignored. */
+  if (!current_process)
+    return -EPERM;
+  int flags = (int)a1;
+  if (flags & ~O_ACCMODE)
+    return -EINVAL;
+  char k_path[FD_PATH_MAX];
+  if (arch_copy_string_from_user(k_path, (const char *)a0, FD_PATH_MAX) != 0)
+    return -EFAULT;
+  char resolved[FD_PATH_MAX];
+  vfs_resolve_path(k_path, resolved, FD_PATH_MAX);
+  if ((flags & O_ACCMODE) != O_RDONLY) {
+    /* USR-SEC-03 #79: any write needs CAP_FS_WRITE. */
+    if (!proc_has_cap(current_process, CAP_FS_WRITE))
+      return -EPERM;
+    /* Same write ACL as SYS_FILE_WRITE (EXT4-02): the /bin and /sys trees
+     * are read-only for non-machine processes even with CAP_FS_WRITE. */
+    if (!proc_is_machine(current_process) &&
+        (strncmp(resolved, "/sys/", 5) == 0 ||
+         strncmp(resolved, "/bin/", 5) == 0))
+      return -EACCES;
+  }
+  struct vfs_node node;
+  if (vfs_open(resolved, &node) != 0)
+    return -ENOENT;
+  if (node.type != VFS_TYPE_FILE)
+    return -EISDIR;
+  /* The table is shared by every thread of the process: claim and fill
+   * the slot under fd_lock so two concurrent opens cannot pick it twice. */
+  struct proc_space *space = current_process->space;
+  uint64_t fd_flags;
+  spin_lock_irqsave(&space->fd_lock, &fd_flags);
+  int newfd = -1;
+  for (int i = 0; i < NPROC_FDS; i++) {
+    if (space->fds[i].type == FD_NONE) {
+      newfd = i;
       break;
     }
-    /* Optional argv vector: arg1 = argc, arg2 = user array of char* (#kilo).
-     * Copy the pointer array and each string into kernel memory before the
-     * spawn so process_load_elf_args() can place them on the child's stack. */
-    int argc = (int)arg1;
-    if (argc < 0)
-      argc = 0;
-    if (argc > SPAWN_MAX_ARGS)
-      argc = SPAWN_MAX_ARGS;
-    char *kargv[SPAWN_MAX_ARGS];
-    char *argv_store = NULL;
-    if (argc > 0) {
-      void *uptrs[SPAWN_MAX_ARGS];
-      if (arch_copy_from_user(uptrs, (const void *)arg2,
-                              (size_t)argc * sizeof(void *)) != 0) {
-        pt_regs_set_return(frame, -EFAULT);
-        break;
-      }
-      argv_store = kmalloc((size_t)argc * SPAWN_ARG_LEN);
-      if (!argv_store) {
-        pt_regs_set_return(frame, -ENOMEM);
-        break;
-      }
-      int bad = 0;
-      for (int i = 0; i < argc; i++) {
-        kargv[i] = argv_store + (size_t)i * SPAWN_ARG_LEN;
-        if (arch_copy_string_from_user(kargv[i], (const char *)uptrs[i],
-                                       SPAWN_ARG_LEN) != 0) {
-          bad = 1;
-          break;
-        }
-      }
-      if (bad) {
-        kfree(argv_store);
-        pt_regs_set_return(frame, -EFAULT);
-        break;
-      }
+  }
+  if (newfd < 0) {
+    spin_unlock_irqrestore(&space->fd_lock, fd_flags);
+    return -EMFILE;
+  }
+  struct fd_entry *e = &space->fds[newfd];
+  memset(e, 0, sizeof(*e));
+  e->type = FD_FILE;
+  e->mode = ((flags & O_ACCMODE) == O_RDONLY)   ? FD_MODE_READ
+            : ((flags & O_ACCMODE) == O_WRONLY) ? FD_MODE_WRITE
+                                                : (FD_MODE_READ | FD_MODE_WRITE);
+  e->node = node;
+  e->offset = 0;
+  strncpy(e->path, resolved, FD_PATH_MAX - 1);
+  spin_unlock_irqrestore(&space->fd_lock, fd_flags);
+  return newfd;
+}
+
+SYSCALL_DEFINE(sc_close) {
+  if (!current_process)
+    return -EBADF;
+  return fd_close((int)a0);
+}
+
+SYSCALL_DEFINE(sc_pipe2) {
+  /* pipe2(fds, flags) -> 0; fds[0] is the read end, fds[1] the write end.
+   * O_NONBLOCK makes both ends fail -EAGAIN instead of sleeping. */
+  if (!current_process)
+    return -EPERM;
+  int flags = (int)a1;
+  if (flags & ~O_NONBLOCK)
+    return -EINVAL;
+  struct pipe *p = pipe_create();
+  if (!p)
+    return -ENFILE;
+  uint8_t nb = (flags & O_NONBLOCK) ? FD_MODE_NONBLOCK : 0;
+  struct proc_space *space = current_process->space;
+  int kfds[2] = {-1, -1};
+  uint64_t fd_flags;
+  spin_lock_irqsave(&space->fd_lock, &fd_flags);
+  for (int i = 0, n = 0; i < NPROC_FDS && n < 2; i++)
+    if (space->fds[i].type == FD_NONE)
+      kfds[n++] = i;
+  if (kfds[1] >= 0) {
+    for (int n = 0; n < 2; n++) {
+      struct fd_entry *e = &space->fds[kfds[n]];
+      memset(e, 0, sizeof(*e));
+      e->type = FD_PIPE;
+      e->mode = (n ? FD_MODE_WRITE : FD_MODE_READ) | nb;
+      e->pipe = p;
     }
-    long sret = dispatch_spawn(k_path, PLVL_USER, 0, 0, argc, kargv);
-    if (argv_store)
+  }
+  spin_unlock_irqrestore(&space->fd_lock, fd_flags);
+  if (kfds[1] < 0) {
+    pipe_close_end(p, 0);
+    pipe_close_end(p, 1);
+    return -EMFILE;
+  }
+  if (arch_copy_to_user((void *)a0, kfds, sizeof(kfds)) != 0) {
+    fd_close(kfds[0]);
+    fd_close(kfds[1]);
+    return -EFAULT;
+  }
+  return 0;
+}
+
+SYSCALL_DEFINE(sc_lseek) {
+  int fd = (int)a0;
+  long off = (long)a1;
+  int whence = (int)a2;
+  if (!current_process || fd < 0 || fd >= NPROC_FDS ||
+      current_process->space->fds[fd].type == FD_NONE)
+    return -EBADF;
+  struct fd_entry *e = &current_process->space->fds[fd];
+  if (e->type != FD_FILE)
+    return -ESPIPE; /* KBD/WIN/pipe streams cannot seek */
+  long base;
+  if (whence == SEEK_SET) {
+    base = 0;
+  } else if (whence == SEEK_CUR) {
+    base = (long)e->offset;
+  } else if (whence == SEEK_END) {
+    /* stat the path: e->node.size is the open-time size and another fd
+     * may have grown the file since */
+    struct vfs_stat st;
+    base = (vfs_stat(e->path, &st) == 0) ? (long)st.size : (long)e->node.size;
+  } else {
+    return -EINVAL;
+  }
+  long npos = base + off;
+  if (npos < 0)
+    return -EINVAL;
+  e->offset = (uint64_t)npos;
+  return npos;
+}
+
+static struct pt_regs *sc_read(struct pt_regs *frame, const uint64_t *a) {
+  (void)a;
+  return sys_read(frame);
+}
+
+static struct pt_regs *sc_write(struct pt_regs *frame, const uint64_t *a) {
+  /* Only a full pipe reports -EAGAIN: sleep until the write may fit. */
+  long rc = sys_write((int)a[0], (const char *)a[1], (size_t)a[2]);
+  if (rc != -EAGAIN) {
+    pt_regs_set_return(frame, rc);
+    return frame;
+  }
+  return fd_block(frame, (int)a[0], 1, (size_t)a[2]);
+}
+
+static struct pt_regs *sc_readv(struct pt_regs *frame, const uint64_t *a) {
+  /* readv on stdin or a pipe blocks like read(); the retried call
+   * re-fetches the iovecs and looks again. */
+  long rc = fd_readv_nowait((int)a[0], (const struct iovec *)a[1], (int)a[2],
+                            -1);
+  if (rc != -EAGAIN) {
+    pt_regs_set_return(frame, rc);
+    return frame;
+  }
+  return fd_block(frame, (int)a[0], 0, 0);
+}
+
+static struct pt_regs *sc_writev(struct pt_regs *frame, const uint64_t *a) {
+  long rc = fd_writev((int)a[0], (const struct iovec *)a[1], (int)a[2], -1);
+  if (rc != -EAGAIN) {
+    pt_regs_set_return(frame, rc);
+    return frame;
+  }
+  /* The total is not at hand: wait for PIPE_BUF of room, which admits
+   * any atomic writev and makes progress on a longer one. */
+  return fd_block(frame, (int)a[0], 1, PIPE_BUF);
+}
+
+SYSCALL_DEFINE(sc_pread64) {
+  return fd_pread((int)a0, (char *)a1, (size_t)a2, (long)a3);
+}
+
+SYSCALL_DEFINE(sc_pwrite64) {
+  return fd_pwrite((int)a0, (const char *)a1, (size_t)a2, (long)a3);
+}
+
+SYSCALL_DEFINE(sc_preadv) {
+  if ((long)a3 < 0)
+    return -EINVAL;
+  return fd_readv_nowait((int)a0, (const struct iovec *)a1, (int)a2,
+                         (long)a3);
+}
+
+SYSCALL_DEFINE(sc_pwritev) {
+  if ((long)a3 < 0)
+    return -EINVAL;
+  return fd_writev((int)a0, (const struct iovec *)a1, (int)a2, (long)a3);
+}
+
+static struct pt_regs *sc_exit(struct pt_regs *frame, const uint64_t *a) {
+  sys_exit((int)a[0]);
+  return schedule(frame);
+}
+
+SYSCALL_DEFINE(sc_get_time) { return sys_get_time(); }
+
+SYSCALL_DEFINE(sc_getpid) { return sys_get_pid(); }
+
+SYSCALL_DEFINE(sc_gettid) { return current_process->pid; }
+
+/* --- Graphics / compositor --- */
+
+SYSCALL_DEFINE(sc_draw) {
+  graphics_draw_rect((int)a0, (int)a1, (int)a2, (int)a3, (uint32_t)a4);
+  return 0;
+}
+
+SYSCALL_DEFINE(sc_flush) {
+  compositor_render();
+  return 0;
+}
+
+SYSCALL_DEFINE(sc_create_window) {
+  /* USR-SEC-03 #79: drawing a window needs CAP_WINDOW. */
+  if (!proc_has_cap(current_process, CAP_WINDOW))
+    return -EPERM;
+  struct cpu_info *cpu = get_cpu_info();
+  char *k_title = cpu->syscall_buf;
+  if (arch_copy_string_from_user(k_title, (const char *)a4, 64) != 0)
+    return -EFAULT;
+  return compositor_create_window((int)a0, (int)a1, (int)a2, (int)a3, k_title,
+                                  current_process->tgid);
+}
+
+SYSCALL_DEFINE(sc_window_draw) {
+  compositor_draw_rect((int)a0, (int)a1, (int)a2, (int)a3, (int)a4,
+                       (uint32_t)a5, current_process->tgid);
+  return 0;
+}
+
+SYSCALL_DEFINE(sc_window_write) {
+  /* write text to a window by id (#123) — needs CAP_WINDOW.  Replaces the
+   * old fd>=100 overload on write(). */
+  if (!proc_has_cap(current_process, CAP_WINDOW))
+    return -EPERM;
+  return window_text_write((int)a0, (const char *)a1, (size_t)a2);
+}
+
+SYSCALL_DEFINE(sc_window_of_pid) {
+  /* Read-only: the compositor window id of a pid, or 0 if it has none.
+   * The shell uses it to tell a windowless (run-in-shell) program from one
+   * that opened its own window (#123).  No capability needed. */
+  int w = compositor_get_window_by_pid((int)a0);
+  return w > 0 ? w : 0;
+}
+
+SYSCALL_DEFINE(sc_window_grid) {
+  /* Read-only: terminal character grid of a window, packed (cols<<16)|rows.
+   * A windowed TTY app (kilo) queries this to size itself to the compositor
+   * font cell instead of assuming a fixed 80x25.  -EINVAL if no such window. */
+  extern int compositor_window_grid(int win_id, int *cols, int *rows);
+  int cols = 0, rows = 0;
+  if (compositor_window_grid((int)a0, &cols, &rows) != 0)
+    return -EINVAL;
+  return ((long)(cols & 0xFFFF) << 16) | (rows & 0xFFFF);
+}
+
+SYSCALL_DEFINE(sc_window_blit) {
+  compositor_blit((int)a0, (int)a1, (int)a2, (int)a3, (int)a4,
+                  (const uint32_t *)a5, current_process->tgid);
+  return 0;
+}
+
+SYSCALL_DEFINE(sc_window_set_flags) {
+  compositor_set_window_flags((int)a0, (int)a1);
+  return 0;
+}
+
+SYSCALL_DEFINE(sc_destroy_window) {
+  /* ABI-04: only the window's owner (or a system process) may destroy it.
+   * Kernel-internal teardown (close button, process exit) calls
+   * compositor_destroy_window() directly and is unaffected. */
+  extern int compositor_window_owner(int window_id);
+  int owner = compositor_window_owner((int)a0);
+  if (owner >= 0 && owner != current_process->tgid &&
+      !proc_is_machine(current_process))
+    return -EPERM;
+  compositor_destroy_window((int)a0);
+  return 0;
+}
+
+SYSCALL_DEFINE(sc_set_focus) {
+  /* ABI-04 / USR-SEC-03 #79: claiming focus needs CAP_WINDOW; a process may
+   * only claim focus for ITSELF (every userland caller does
+   * set_focus(get_pid())); redirecting input to/from another PID — i.e.
+   * keystroke stealing — needs machine level. */
+  if (!proc_has_cap(current_process, CAP_WINDOW))
+    return -EPERM;
+  if ((int)a0 != current_process->tgid && !proc_is_machine(current_process))
+    return -EPERM;
+  int old_focus = keyboard_focus_pid;
+  keyboard_focus_pid = (int)a0;
+  /* Caret follows the input window: clear it off whoever just lost
+   * focus. */
+  extern void compositor_focus_changed(int new_pid);
+  compositor_focus_changed((int)a0);
+  if (old_focus != (int)a0)
+    ntfn_signal_focus(old_focus, (int)a0);
+  return 0;
+}
+
+/* --- Memory / processes / threads --- */
+
+SYSCALL_DEFINE(sc_sbrk) { return (long)sys_sbrk((intptr_t)a0); }
+
+/* spawn_copy_args - copy a spawn argv (uargc strings at uargv, clamped to
+ * SPAWN_MAX_ARGS) into one kmalloc'd store, kargv[i] pointing into it.
+ * Returns argc (*store NULL when 0; the caller kfree()s it otherwise) or
+ * -EFAULT / -ENOMEM. */
+static long spawn_copy_args(uint64_t uargc, uint64_t uargv, char *kargv[],
+                            char **store) {
+  int argc = (int)uargc;
+  if (argc < 0)
+    argc = 0;
+  if (argc > SPAWN_MAX_ARGS)
+    argc = SPAWN_MAX_ARGS;
+  *store = NULL;
+  if (argc == 0)
+    return 0;
+  void *uptrs[SPAWN_MAX_ARGS];
+  if (arch_copy_from_user(uptrs, (const void *)uargv,
+                          (size_t)argc * sizeof(void *)) != 0)
+    return -EFAULT;
+  char *argv_store = kmalloc((size_t)argc * SPAWN_ARG_LEN);
+  if (!argv_store)
+    return -ENOMEM;
+  for (int i = 0; i < argc; i++) {
+    kargv[i] = argv_store + (size_t)i * SPAWN_ARG_LEN;
+    if (arch_copy_string_from_user(kargv[i], (const char *)uptrs[i],
+                                   SPAWN_ARG_LEN) != 0) {
       kfree(argv_store);
-    pt_regs_set_return(frame, sret);
-  } break;
-  case SYS_SPAWN_CAPS:
-  {
-    /* spawn_caps(path, level, caps) — restricted spawn.  The requested level
-     * and caps are clamped monotonically in process_create_caps (never more
-     * privileged than the creator, never above the level ceiling, never more
-     * than the creator holds). */
-    if (!proc_has_cap(current_process, CAP_SPAWN)) {
-      pt_regs_set_return(frame, -EPERM);
-      break;
-    }
-    struct cpu_info *cpu = get_cpu_info();
-    char *k_path = cpu->syscall_buf;
-    if (arch_copy_string_from_user(k_path, (const char *)arg0, 128) != 0) {
-      pt_regs_set_return(frame, -EFAULT);
-      break;
-    }
-    pt_regs_set_return(
-        frame, dispatch_spawn(k_path, (uint8_t)arg1, (uint32_t)arg2, 1, 0,
-                              NULL));
-  } break;
-  case SYS_KILL:
-    /* ABI-04: a process may kill itself or its descendants (orphans are
-     * re-homed to a live ancestor at reap time, SCHED-DOS-02); SYSTEM/ROOT
-     * may kill anything (process_terminate still protects SYSTEM targets). */
-    if (!process_kill_allowed(current_process, (int)arg0)) {
-      pt_regs_set_return(frame, -EPERM);
-      break;
+      return -EFAULT;
     }
-    pt_regs_set_return(frame, process_terminate((int)arg0));
-    break;
-  case SYS_GETPROCS:
-    pt_regs_set_return(frame, sys_getprocs((void *)arg0, (size_t)arg1));
-    break;
-  case SYS_YIELD:
+  }
+  *store = argv_store;
+  return argc;
+}
+
+SYSCALL_DEFINE(sc_spawn) {
+  /* USR-SEC-03 #79: spawning needs CAP_SPAWN.  A plain spawn yields a full
+   * PLVL_USER child (clamped to the creator), preserving today's behaviour. */
+  if (!proc_has_cap(current_process, CAP_SPAWN))
+    return -EPERM;
+  struct cpu_info *cpu = get_cpu_info();
+  char *k_path = cpu->syscall_buf;
+  if (arch_copy_string_from_user(k_path, (const char *)a0, 128) != 0)
+    return -EFAULT;
+  /* Optional argv vector: a1 = argc, a2 = user array of char* (#kilo).
+   * Copy the pointer array and each string into kernel memory before the
+   * spawn so process_load_elf_args() can place them on the child's stack. */
+  char *kargv[SPAWN_MAX_ARGS];
+  char *argv_store;
+  long argc = spawn_copy_args(a1, a2, kargv, &argv_store);
+  if (argc < 0)
+    return argc;
+  long sret =
+      dispatch_spawn(k_path, PLVL_USER, 0, 0, (int)argc, kargv, NULL, 0);
+  if (argv_store)
+    kfree(argv_store);
+  return sret;
+}
+
+SYSCALL_DEFINE(sc_spawn_fds) {
+  /* spawn_fds(path, argc, argv, map, nmap) — spawn, with child fd i a copy
+   * of our fd map[i] (i < nmap; -1 keeps the default).  How the shell
+   * hands a pipeline stage its pipe ends. */
+  if (!proc_has_cap(current_process, CAP_SPAWN))
+    return -EPERM;
+  int nmap = (int)a4;
+  if (nmap < 0 || nmap > NPROC_FDS)
+    return -EINVAL;
+  int map[NPROC_FDS];
+  if (nmap > 0 &&
+      arch_copy_from_user(map, (const void *)a3, (size_t)nmap * sizeof(int)))
+    return -EFAULT;
+  for (int i = 0; i < nmap; i++)
+    if (map[i] >= 0 && !fd_lookup(map[i]))
+      return -EBADF;
+  struct cpu_info *cpu = get_cpu_info();
+  char *k_path = cpu->syscall_buf;
+  if (arch_copy_string_from_user(k_path, (const char *)a0, 128) != 0)
+    return -EFAULT;
+  char *kargv[SPAWN_MAX_ARGS];
+  char *argv_store;
+  long argc = spawn_copy_args(a1, a2, kargv, &argv_store);
+  if (argc < 0)
+    return argc;
+  long sret =
+      dispatch_spawn(k_path, PLVL_USER, 0, 0, (int)argc, kargv, map, nmap);
+  if (argv_store)
+    kfree(argv_store);
+  return sret;
+}
+
+SYSCALL_DEFINE(sc_spawn_caps) {
+  /* spawn_caps(path, level, caps) — restricted spawn.  The requested level
+   * and caps are clamped monotonically in process_create_caps (never more
+   * privileged than the creator, never above the level ceiling, never more
+   * than the creator holds). */
+  if (!proc_has_cap(current_process, CAP_SPAWN))
+    return -EPERM;
+  struct cpu_info *cpu = get_cpu_info();
+  char *k_path = cpu->syscall_buf;
+  if (arch_copy_string_from_user(k_path, (const char *)a0, 128) != 0)
+    return -EFAULT;
+  return dispatch_spawn(k_path, (uint8_t)a1, (uint32_t)a2, 1, 0, NULL, NULL,
+                        0);
+}
+
+SYSCALL_DEFINE(sc_kill) {
+  /* ABI-04: a process may kill itself or its descendants (orphans are
+   * re-homed to a live ancestor at reap time, SCHED-DOS-02); SYSTEM/ROOT
+   * may kill anything (process_terminate still protects SYSTEM targets). */
+  if (!process_kill_allowed(current_process, (int)a0))
+    return -EPERM;
+  return process_terminate((int)a0);
+}
+
+SYSCALL_DEFINE(sc_getprocs) { return sys_getprocs((void *)a0, (size_t)a1); }
+
+static struct pt_regs *sc_yield(struct pt_regs *frame, const uint64_t *a) {
+  (void)a;
+  return schedule(frame);
+}
+
+SYSCALL_DEFINE(sc_wait) { return process_wait((int)a0); }
+
+SYSCALL_DEFINE(sc_sched_setattr) {
+  struct sched_attr attr;
+  if (arch_copy_from_user(&attr, (const void *)a1, sizeof(attr)) != 0)
+    return -EFAULT;
+  return sched_setattr((int)a0, &attr);
+}
+
+SYSCALL_DEFINE(sc_sched_getattr) {
+  struct sched_attr attr;
+  long rc = sched_getattr((int)a0, &attr);
+  if (rc == 0 && arch_copy_to_user((void *)a1, &attr, sizeof(attr)) != 0)
+    return -EFAULT;
+  return rc;
+}
+
+SYSCALL_DEFINE(sc_trace) { return sys_trace((int)a0, a1, a2); }
+
+SYSCALL_DEFINE(sc_lockstat) {
+  return sys_lockstat((char *)a0, (size_t)a1, (int)a2);
+}
+
+SYSCALL_DEFINE(sc_cpustat) { return sys_cpustat((char *)a0, (size_t)a1); }
+
+SYSCALL_DEFINE(sc_prof) { return sys_prof((int)a0, a1, a2); }
+
+SYSCALL_DEFINE(sc_pmu) { return sys_pmu((int)a0, a1, a2); }
+
+SYSCALL_DEFINE(sc_thread_create) {
+  return sys_thread_create(a0, a1, a2, a3, a4);
+}
+
+static struct pt_regs *sc_thread_exit(struct pt_regs *frame,
+                                      const uint64_t *a) {
+  sys_thread_exit((int)a[0]);
+  return schedule(frame);
+}
+
+static struct pt_regs *sc_thread_join(struct pt_regs *frame,
+                                      const uint64_t *a) {
+  /* Same rule as SYS_RECV: a blocked join armed a syscall retry, so the
+   * return register (x0 == tid on aarch64) must survive untouched. */
+  long rc = sys_thread_join((int)a[0], (int *)a[1]);
+  if (rc == THREAD_JOIN_RETRY)
+    return schedule(frame);
+  pt_regs_set_return(frame, rc);
+  return frame;
+}
+
+SYSCALL_DEFINE(sc_set_tls) { return sys_set_tls(a0); }
+
+static struct pt_regs *sc_futex(struct pt_regs *frame, const uint64_t *a) {
+  /* A blocked FUTEX_WAIT armed a syscall retry (same rule as SYS_RECV);
+   * the retried call reports woken / timed out from current->futex. */
+  long rc = sys_futex((uint32_t *)a[0], (int)a[1], (uint32_t)a[2], a[3],
+                      (uint32_t *)a[4], (uint32_t)a[5]);
+  if ((int)a[1] == FUTEX_WAIT && rc == FUTEX_WAIT_RETRY)
+    return schedule(frame);
+  pt_regs_set_return(frame, rc);
+  return frame;
+}
+
+/* --- IPC --- */
+
+static struct pt_regs *sc_send(struct pt_regs *frame, const uint64_t *a) {
+  /* ABI-05 RESOLVED: capture the result in a local instead of trying to
+   * re-read it through the (read-only) argument accessors, so the
+   * yield-after-successful-send actually happens and the receiver gets
+   * a chance to run immediately.  A send blocked on the target's full
+   * ring armed a retry: leave the return register alone (see SYS_RECV). */
+  long rc = sys_ipc_send((int)a[0], (void *)a[1], (int)a[2]);
+  if (rc == IPC_SEND_RETRY)
     return schedule(frame);
-  case SYS_SEND:
-  {
-    /* ABI-05 RESOLVED: capture the result in a local instead of trying to
-     * re-read it through the (read-only) argument accessors, so the
-     * yield-after-successful-send actually happens and the receiver gets
-     * a chance to run immediately. */
-    long rc = sys_ipc_send((int)arg0, (void *)arg1);
+  pt_regs_set_return(frame, rc);
+  if (rc == 0)
+    return schedule(frame);
+  return frame;
+}
+
+static struct pt_regs *sc_recv(struct pt_regs *frame, const uint64_t *a) {
+  /* IPC-01: when sys_ipc_recv() blocks it arms a syscall retry (PC rewound
+   * to the SVC/SYSCALL).  The return value must NOT be written then — on
+   * aarch64 x0 is both the return register and arg0, so writing it would
+   * clobber src_pid for the re-executed syscall (the receiver re-armed
+   * with src_pid=0 and slept forever on a non-empty queue).
+   * NOTE(IPC-02): still unconditionally schedules — a delivered message
+   * costs an extra yield. */
+  long rc = sys_ipc_recv((int)a[0], (void *)a[1]);
+  if (rc != IPC_RECV_RETRY)
     pt_regs_set_return(frame, rc);
-    if (rc == 0)
-      return schedule(frame);
-    break;
-  }
-  case SYS_RECV: {
-    /* IPC-01: when sys_ipc_recv() blocks it arms a syscall retry (PC rewound
-     * to the SVC/SYSCALL).  The return value must NOT be written then — on
-     * aarch64 x0 is both the return register and arg0, so writing it would
-     * clobber src_pid for the re-executed syscall (the receiver re-armed
-     * with src_pid=0 and slept forever on a non-empty queue).
-     * NOTE(IPC-02): still unconditionally schedules — a delivered message
-     * costs an extra yield. */
-    long rc = sys_ipc_recv((int)arg0, (void *)arg1);
-    if (rc != IPC_RECV_RETRY)
-      pt_regs_set_return(frame, rc);
+  return schedule(frame);
+}
+
+SYSCALL_DEFINE(sc_try_recv) { return sys_ipc_try_recv((int)a0, (void *)a1); }
+
+static struct pt_regs *sc_call(struct pt_regs *frame, const uint64_t *a) {
+  /* A blocked call returns IPC_CALL_PENDING: the replier writes our
+   * return register, and schedule() usually switches straight to the
+   * server (cpu->ipc_handoff). */
+  long rc = sys_ipc_call(frame, (int)a[0], (void *)a[1]);
+  if (rc == IPC_CALL_PENDING)
+    return schedule(frame);
+  pt_regs_set_return(frame, rc);
+  return frame;
+}
+
+static struct pt_regs *sc_reply_recv(struct pt_regs *frame,
+                                     const uint64_t *a) {
+  long rc = sys_ipc_reply_recv(frame, (int)a[0], (void *)a[1]);
+  if (rc == IPC_CALL_PENDING)
+    return schedule(frame);
+  pt_regs_set_return(frame, rc);
+  /* Replied with a direct switch, then found a request already queued:
+   * still honour the handoff rather than strand the caller until the
+   * next tick. */
+  if (get_cpu_info()->ipc_handoff)
     return schedule(frame);
+  return frame;
+}
+
+SYSCALL_DEFINE(sc_ipc_set_depth) { return sys_ipc_set_depth((unsigned int)a0); }
+
+static struct pt_regs *sc_endpoint(struct pt_regs *frame, const uint64_t *a) {
+  /* EP_SEND / EP_CALL block like SYS_SEND / SYS_CALL (full ring, server
+   * not bound yet, call pending): leave the return register alone. */
+  int op = (int)a[0];
+  long rc = sys_endpoint(frame, op, a[1], a[2], a[3]);
+  int xfer = (op == EP_SEND || op == EP_CALL);
+  if (xfer && rc == IPC_SEND_RETRY)
+    return schedule(frame);
+  pt_regs_set_return(frame, rc);
+  if (op == EP_SEND && rc == 0)
+    return schedule(frame); /* let the server run, as SYS_SEND does */
+  return frame;
+}
+
+SYSCALL_DEFINE(sc_channel) { return sys_channel((int)a0, a1, a2, a3); }
+
+SYSCALL_DEFINE(sc_uring) { return sys_uring((int)a0, a1, a2, a3); }
+
+static struct pt_regs *sc_event(struct pt_regs *frame, const uint64_t *a) {
+  /* EV_WAIT with nothing ready blocks with a syscall retry armed; the
+   * retried call re-scans the set. */
+  int op = (int)a[0];
+  long rc = sys_event(op, a[1], a[2], a[3], a[4]);
+  if (op == EV_WAIT && rc == EV_WAIT_RETRY)
+    return schedule(frame);
+  pt_regs_set_return(frame, rc);
+  return frame;
+}
+
+static struct pt_regs *sc_ntfn(struct pt_regs *frame, const uint64_t *a) {
+  /* NTFN_WAIT with no bits pending blocks with a syscall retry armed. */
+  int op = (int)a[0];
+  long rc = sys_ntfn(op, a[1], a[2]);
+  if (op == NTFN_WAIT && rc == NTFN_WAIT_RETRY)
+    return schedule(frame);
+  pt_regs_set_return(frame, rc);
+  return frame;
+}
+
+/* --- Registry / files / misc --- */
+
+SYSCALL_DEFINE(sc_registry) {
+  return sys_registry((int)a0, (const char *)a1, (char *)a2, (size_t)a3);
+}
+
+SYSCALL_DEFINE(sc_file_write) {
+  struct cpu_info *cpu = get_cpu_info();
+  char *k_path = cpu->syscall_buf;
+  if (arch_copy_string_from_user(k_path, (const char *)a0, 128) != 0)
+    return -EFAULT;
+  /* USR-SEC-03 #79: any write needs CAP_FS_WRITE. */
+  if (!proc_has_cap(current_process, CAP_FS_WRITE))
+    return -EPERM;
+  char resolved_path[128];
+  vfs_resolve_path(k_path, resolved_path, 128);
+  /* EXT4-02 (ABI-04 family): the binary trees are write-protected for
+   * non-machine processes — a user process must not be able to overwrite
+   * anything under /bin or /sys (services, init chain).  Config/data
+   * files (/etc, user files) stay writable. */
+  if (!proc_is_machine(current_process) &&
+      (strncmp(resolved_path, "/sys/", 5) == 0 ||
+       strncmp(resolved_path, "/bin/", 5) == 0)) {
+    pr_warn("FILE_WRITE: PID %d denied write to protected path '%s'\n",
+            current_process->pid, resolved_path);
+    return -EACCES;
   }
-  case SYS_TRY_RECV:
-    pt_regs_set_return(frame, sys_ipc_try_recv((int)arg0, (void *)arg1));
-    break;
-  case SYS_SET_FOCUS:
-    /* ABI-04 / USR-SEC-03 #79: claiming focus needs CAP_WINDOW; a process may
-     * only claim focus for ITSELF (every userland caller does
-     * set_focus(get_pid())); redirecting input to/from another PID — i.e.
-     * keystroke stealing — needs machine level. */
-    if (!proc_has_cap(current_process, CAP_WINDOW)) {
-      pt_regs_set_return(frame, -EPERM);
-      break;
-    }
-    if ((int)arg0 != (int)current_process->pid &&
-        !proc_is_machine(current_process)) {
-      pt_regs_set_return(frame, -EPERM);
-      break;
-    }
-    keyboard_focus_pid = (int)arg0;
-    /* Caret follows the input window: clear it off whoever just lost focus. */
-    {
-      extern void compositor_focus_changed(int new_pid);
-      compositor_focus_changed((int)arg0);
-    }
-    pt_regs_set_return(frame, 0);
-    break;
-  case SYS_WAIT:
-    pt_regs_set_return(frame, process_wait((int)arg0));
-    break;
-  case SYS_REGISTRY:
-    pt_regs_set_return(frame, sys_registry((int)arg0, (const char *)arg1, (char *)arg2, (size_t)arg3));
-    break;
-  case SYS_FILE_WRITE:
-  {
-    struct cpu_info *cpu = get_cpu_info();
-    char *k_path = cpu->syscall_buf;
-    if (arch_copy_string_from_user(k_path, (const char *)arg0, 128) != 0) {
-      pt_regs_set_return(frame, -EFAULT);
-      break;
-    }
-    /* USR-SEC-03 #79: any write needs CAP_FS_WRITE. */
-    if (!proc_has_cap(current_process, CAP_FS_WRITE)) {
-      pt_regs_set_return(frame, -EPERM);
-      break;
-    }
-    char resolved_path[128];
-    vfs_resolve_path(k_path, resolved_path, 128);
-    /* EXT4-02 (ABI-04 family): the binary trees are write-protected for
-     * non-machine processes — a user process must not be able to overwrite
-     * anything under /bin or /sys (services, init chain).  Config/data
-     * files (/etc, user files) stay writable. */
-    if (!proc_is_machine(current_process) &&
-        (strncmp(resolved_path, "/sys/", 5) == 0 ||
-         strncmp(resolved_path, "/bin/", 5) == 0)) {
-      pr_warn("FILE_WRITE: PID %d denied write to protected path '%s'\n",
-              current_process->pid, resolved_path);
-      pt_regs_set_return(frame, -EACCES);
-      break;
-    }
-    size_t size = (size_t)arg2;
-    if (size > SYSCALL_MAX_IO_BYTES) {  /* FIX(EXT4-07): reject absurd user size */
-      pt_regs_set_return(frame, -EINVAL);
-      break;
-    }
-    uint8_t *k_buf = kmalloc(size);
-    if (!k_buf) {
-      pt_regs_set_return(frame, -ENOMEM);
-      break;
-    }
-    if (arch_copy_from_user(k_buf, (const void *)arg1, size) != 0) {
-      kfree(k_buf);
-      pt_regs_set_return(frame, -EFAULT);
-      break;
-    }
-    uint32_t offset = (uint32_t)arg3;
-    int wr = vfs_write_file(resolved_path, k_buf, (uint32_t)size, offset);
-    pt_regs_set_return(frame, wr < 0 ? -EIO : wr);
+  size_t size = (size_t)a2;
+  if (size > SYSCALL_MAX_IO_BYTES) /* FIX(EXT4-07): reject absurd user size */
+    return -EINVAL;
+  uint8_t *k_buf = kmalloc(size);
+  if (!k_buf)
+    return -ENOMEM;
+  if (arch_copy_from_user(k_buf, (const void *)a1, size) != 0) {
     kfree(k_buf);
-  } break;
-  case SYS_FILE_READ:
-  {
-    char k_path[128];
-    if (arch_copy_string_from_user(k_path, (const char *)arg0, 128) != 0) {
-      pt_regs_set_return(frame, -EFAULT);
-      break;
-    }
-    char resolved_path[128];
-    vfs_resolve_path(k_path, resolved_path, 128);
-    size_t size = (size_t)arg2;
-    if (size > SYSCALL_MAX_IO_BYTES) {  /* FIX(EXT4-07): reject absurd user size */
-      pt_regs_set_return(frame, -EINVAL);
-      break;
-    }
-    uint32_t offset = (uint32_t)arg3;
-    long ret;
+    return -EFAULT;
+  }
+  uint32_t offset = (uint32_t)a3;
+  int wr = vfs_write_file(resolved_path, k_buf, (uint32_t)size, offset);
+  kfree(k_buf);
+  return wr < 0 ? -EIO : wr;
+}
 
-    if (size == 0) {
-      int probed = vfs_read_file(resolved_path, NULL, 0, offset);
-      ret = probed < 0 ? -ENOENT : probed;
-    } else {
-      uint8_t *k_buf = kmalloc(size);
-      if (!k_buf) {
-        pt_regs_set_return(frame, -ENOMEM);
-        break;
-      }
+SYSCALL_DEFINE(sc_file_read) {
+  char k_path[128];
+  if (arch_copy_string_from_user(k_path, (const char *)a0, 128) != 0)
+    return -EFAULT;
+  char resolved_path[128];
+  vfs_resolve_path(k_path, resolved_path, 128);
+  size_t size = (size_t)a2;
+  if (size > SYSCALL_MAX_IO_BYTES) /* FIX(EXT4-07): reject absurd user size */
+    return -EINVAL;
+  uint32_t offset = (uint32_t)a3;
 
-      int bytes_read = vfs_read_file(resolved_path, k_buf, (uint32_t)size, offset);
-      if (bytes_read < 0) {
-        ret = -ENOENT; /* missing path is by far the dominant failure */
-      } else if (arch_copy_to_user((void *)arg1, k_buf, bytes_read) != 0) {
-        ret = -EFAULT;
-      } else {
-        ret = bytes_read;
-      }
-      kfree(k_buf);
-    }
-    pt_regs_set_return(frame, ret);
-  } break;
-  case SYS_SET_FONT:
-    pt_regs_set_return(frame, sys_set_font((void *)arg0, (size_t)arg1));
-    break;
-  case SYS_LIST_DIR:
-  {
-    char k_path[128];
-    if (arch_copy_string_from_user(k_path, (const char *)arg0, 128) != 0) {
-      pt_regs_set_return(frame, -EFAULT);
-      break;
-    }
-    char resolved_path[128];
-    vfs_resolve_path(k_path, resolved_path, 128);
-    size_t size = (size_t)arg2;
-    if (size > SYSCALL_MAX_IO_BYTES) {  /* FIX(EXT4-07): reject absurd user size */
-      pt_regs_set_return(frame, -EINVAL);
-      break;
-    }
-    char *k_buf = kmalloc(size);
-    if (!k_buf) {
-      pt_regs_set_return(frame, -ENOMEM);
-      break;
-    }
-    long ret;
-    int res = vfs_list_dir(resolved_path, k_buf, (uint32_t)size);
-    if (res < 0) {
-      ret = -ENOENT;
-    } else if (arch_copy_to_user((void *)arg1, k_buf, res + 1) != 0) {
-      ret = -EFAULT;
-    } else {
-      ret = res;
-    }
-    kfree(k_buf);
-    pt_regs_set_return(frame, ret);
-  } break;
-  case SYS_CHDIR:
-  {
-    char k_path[128];
-    if (arch_copy_string_from_user(k_path, (const char *)arg0, 128) != 0) {
-      pt_regs_set_return(frame, -EFAULT);
-      break;
-    }
-    char resolved_path[128];
-    vfs_resolve_path(k_path, resolved_path, 128);
+  if (size == 0) {
+    int probed = vfs_read_file(resolved_path, NULL, 0, offset);
+    return probed < 0 ? -ENOENT : probed;
+  }
+  uint8_t *k_buf = kmalloc(size);
+  if (!k_buf)
+    return -ENOMEM;
+  long ret;
+  int bytes_read = vfs_read_file(resolved_path, k_buf, (uint32_t)size, offset);
+  if (bytes_read < 0)
+    ret = -ENOENT; /* missing path is by far the dominant failure */
+  else if (arch_copy_to_user((void *)a1, k_buf, bytes_read) != 0)
+    ret = -EFAULT;
+  else
+    ret = bytes_read;
+  kfree(k_buf);
+  return ret;
+}
 
-    /* Verify it exists and is a directory. */
-    struct vfs_stat st;
-    if (vfs_stat(resolved_path, &st) != 0) {
-       pt_regs_set_return(frame, -ENOENT);
-    } else if (st.type != VFS_TYPE_DIR) {
-       pt_regs_set_return(frame, -ENOTDIR);
-    } else {
-       strncpy(current_process->cwd, resolved_path, 128);
-       pt_regs_set_return(frame, 0);
-    }
-  } break;
-  case SYS_GETCWD:
-  {
-    size_t size = (size_t)arg1;
-    if (arch_copy_to_user((void *)arg0, current_process->cwd, size) != 0) {
-      pt_regs_set_return(frame, -EFAULT);
-    } else {
-      pt_regs_set_return(frame, 0);
-    }
-  } break;
-  default:
+SYSCALL_DEFINE(sc_set_font) { return sys_set_font((void *)a0, (size_t)a1); }
+
+SYSCALL_DEFINE(sc_list_dir) {
+  char k_path[128];
+  if (arch_copy_string_from_user(k_path, (const char *)a0, 128) != 0)
+    return -EFAULT;
+  char resolved_path[128];
+  vfs_resolve_path(k_path, resolved_path, 128);
+  size_t size = (size_t)a2;
+  if (size > SYSCALL_MAX_IO_BYTES) /* FIX(EXT4-07): reject absurd user size */
+    return -EINVAL;
+  char *k_buf = kmalloc(size);
+  if (!k_buf)
+    return -ENOMEM;
+  long ret;
+  int res = vfs_list_dir(resolved_path, k_buf, (uint32_t)size);
+  if (res < 0)
+    ret = -ENOENT;
+  else if (arch_copy_to_user((void *)a1, k_buf, res + 1) != 0)
+    ret = -EFAULT;
+  else
+    ret = res;
+  kfree(k_buf);
+  return ret;
+}
+
+SYSCALL_DEFINE(sc_chdir) {
+  char k_path[128];
+  if (arch_copy_string_from_user(k_path, (const char *)a0, 128) != 0)
+    return -EFAULT;
+  char resolved_path[128];
+  vfs_resolve_path(k_path, resolved_path, 128);
+
+  /* Verify it exists and is a directory. */
+  struct vfs_stat st;
+  if (vfs_stat(resolved_path, &st) != 0)
+    return -ENOENT;
+  if (st.type != VFS_TYPE_DIR)
+    return -ENOTDIR;
+  strncpy(current_process->space->cwd, resolved_path, 128);
+  return 0;
+}
+
+SYSCALL_DEFINE(sc_getcwd) {
+  size_t size = (size_t)a1;
+  if (arch_copy_to_user((void *)a0, current_process->space->cwd, size) != 0)
+    return -EFAULT;
+  return 0;
+}
+
+SYSCALL_DEFINE(sc_dmesg) { return sys_dmesg((char *)a0, (size_t)a1); }
+
+/*
+ * syscall_table - see kernel/syscall.h.  SC(nr, fn, nargs, flags) is a value
+ * call, SC_FRAME(nr, fn, nargs) a frame call.
+ */
+#define SC(nr, f, n, fl) [nr] = {.fn = f, .name = #nr, .nargs = n, .flags = fl}
+#define SC_FRAME(nr, f, n) [nr] = {.frame_fn = f, .name = #nr, .nargs = n}
+
+const struct syscall_entry syscall_table[SYS_NR] = {
+    SC(SYS_OPEN, sc_open, 2, SYSCALL_URING),
+    SC(SYS_CLOSE, sc_close, 1, SYSCALL_URING),
+    SC(SYS_PIPE2, sc_pipe2, 2, SYSCALL_URING),
+    SC(SYS_LSEEK, sc_lseek, 3, SYSCALL_URING),
+    SC_FRAME(SYS_READ, sc_read, 3),
+    SC_FRAME(SYS_WRITE, sc_write, 3),
+    SC_FRAME(SYS_READV, sc_readv, 3),
+    SC_FRAME(SYS_WRITEV, sc_writev, 3),
+    SC(SYS_PREAD64, sc_pread64, 4, SYSCALL_URING),
+    SC(SYS_PWRITE64, sc_pwrite64, 4, SYSCALL_URING),
+    SC(SYS_PREADV, sc_preadv, 4, SYSCALL_URING),
+    SC(SYS_PWRITEV, sc_pwritev, 4, SYSCALL_URING),
+    SC_FRAME(SYS_EXIT, sc_exit, 1),
+    SC(SYS_GET_TIME, sc_get_time, 0, SYSCALL_LEAN | SYSCALL_URING),
+    SC(SYS_GETPID, sc_getpid, 0, SYSCALL_LEAN | SYSCALL_URING),
+    SC(SYS_GETTID, sc_gettid, 0, SYSCALL_LEAN | SYSCALL_URING),
+
+    SC(SYS_DRAW, sc_draw, 5, SYSCALL_URING),
+    SC(SYS_FLUSH, sc_flush, 0, SYSCALL_URING),
+    SC(SYS_CREATE_WINDOW, sc_create_window, 5, 0),
+    SC(SYS_WINDOW_DRAW, sc_window_draw, 6, SYSCALL_URING),
+    SC(SYS_COMPOSITOR_RENDER, sc_flush, 0, SYSCALL_URING),
+    SC(SYS_WINDOW_BLIT, sc_window_blit, 6, SYSCALL_URING),
+    SC(SYS_WINDOW_SET_FLAGS, sc_window_set_flags, 2, SYSCALL_URING),
+    SC(SYS_DESTROY_WINDOW, sc_destroy_window, 1, 0),
+    SC(SYS_WINDOW_WRITE, sc_window_write, 3, SYSCALL_URING),
+    SC(SYS_WINDOW_OF_PID, sc_window_of_pid, 1, SYSCALL_LEAN | SYSCALL_URING),
+    SC(SYS_WINDOW_GRID, sc_window_grid, 1, SYSCALL_LEAN | SYSCALL_URING),
+
+    SC(SYS_SBRK, sc_sbrk, 1, 0),
+
+    SC(SYS_SPAWN, sc_spawn, 3, 0),
+    SC(SYS_SPAWN_FDS, sc_spawn_fds, 5, 0),
+    SC(SYS_KILL, sc_kill, 1, 0),
+    SC(SYS_GETPROCS, sc_getprocs, 2, 0),
+    SC_FRAME(SYS_YIELD, sc_yield, 0),
+    SC(SYS_SCHED_SETATTR, sc_sched_setattr, 2, 0),
+    SC(SYS_SCHED_GETATTR, sc_sched_getattr, 2, 0),
+    SC(SYS_TRACE, sc_trace, 3, 0),
+    SC(SYS_LOCKSTAT, sc_lockstat, 3, 0),
+    SC(SYS_CPUSTAT, sc_cpustat, 2, 0),
+    SC(SYS_PROF, sc_prof, 3, 0),
+    SC(SYS_PMU, sc_pmu, 3, 0),
+    SC(SYS_SPAWN_CAPS, sc_spawn_caps, 3, 0),
+    SC(SYS_WAIT, sc_wait, 1, 0),
+
+    SC(SYS_THREAD_CREATE, sc_thread_create, 5, 0),
+    SC_FRAME(SYS_THREAD_EXIT, sc_thread_exit, 1),
+    SC_FRAME(SYS_THREAD_JOIN, sc_thread_join, 2),
+    SC(SYS_SET_TLS, sc_set_tls, 1, SYSCALL_LEAN),
+    SC_FRAME(SYS_FUTEX, sc_futex, 6),
+
+    SC_FRAME(SYS_SEND, sc_send, 3),
+    SC_FRAME(SYS_RECV, sc_recv, 2),
+    SC(SYS_SET_FOCUS, sc_set_focus, 1, 0),
+    SC(SYS_TRY_RECV, sc_try_recv, 2, SYSCALL_URING),
+    SC_FRAME(SYS_CALL, sc_call, 2),
+    SC_FRAME(SYS_REPLY_RECV, sc_reply_recv, 2),
+    SC(SYS_IPC_SET_DEPTH, sc_ipc_set_depth, 1, 0),
+    SC_FRAME(SYS_ENDPOINT, sc_endpoint, 4),
+    SC(SYS_CHANNEL, sc_channel, 4, 0),
+    SC(SYS_URING, sc_uring, 4, 0),
+    SC_FRAME(SYS_EVENT, sc_event, 5),
+    SC_FRAME(SYS_NTFN, sc_ntfn, 3),
+
+    SC(SYS_REGISTRY, sc_registry, 4, SYSCALL_URING),
+    SC(SYS_FILE_WRITE, sc_file_write, 4, SYSCALL_URING),
+    SC(SYS_FILE_READ, sc_file_read, 4, SYSCALL_URING),
+    SC(SYS_SET_FONT, sc_set_font, 2, 0),
+    SC(SYS_LIST_DIR, sc_list_dir, 3, 0),
+    SC(SYS_CHDIR, sc_chdir, 1, 0),
+    SC(SYS_GETCWD, sc_getcwd, 2, 0),
+    SC(SYS_DMESG, sc_dmesg, 2, 0),
+};
+
+/* syscall.S indexes the table with these (kernel/syscall.h). */
+_Static_assert(sizeof(struct syscall_entry) == (1 << SYSCALL_ENTRY_SHIFT),
+               "syscall_entry size");
+_Static_assert(__builtin_offsetof(struct syscall_entry, fn) ==
+                   SYSCALL_ENTRY_FN,
+               "syscall_entry.fn offset");
+_Static_assert(__builtin_offsetof(struct syscall_entry, flags) ==
+                   SYSCALL_ENTRY_FLAGS,
+               "syscall_entry.flags offset");
+
+/* syscall_traced - the dispatch tail with SYS_ENTRY / SYS_EXIT recorded
+ * (kernel/trace.h).  The exit is the caller's even when a frame call
+ * switched to another task. */
+static struct pt_regs *syscall_traced(struct pt_regs *frame,
+                                      const struct syscall_entry *e,
+                                      uint32_t nr, const uint64_t *a) {
+  uint32_t tid = trace_tid();
+  trace_event(TRACE_EV_SYS_ENTRY, tid, nr, 0);
+  if (e->frame_fn) {
+    struct pt_regs *next = e->frame_fn(frame, a);
+    trace_event(TRACE_EV_SYS_EXIT, tid, nr, 0);
+    return next;
+  }
+  long rc = e->fn(a[0], a[1], a[2], a[3], a[4], a[5]);
+  trace_event(TRACE_EV_SYS_EXIT, tid, nr, rc);
+  pt_regs_set_return(frame, rc);
+  return frame;
+}
+
+/*
+ * kernel_syscall_dispatcher - dispatch a syscall from the saved register frame.
+ *
+ * Entry point called by the arch-specific svc/syscall handler immediately
+ * after saving all user registers into 'frame'.  Looks the number up in
+ * syscall_table and loads the entry's nargs argument registers via the
+ * pt_regs_* accessors.
+ *
+ * Returns: a pt_regs* to restore.  For value calls this is 'frame' itself
+ *          with the result written via pt_regs_set_return().  Frame calls
+ *          return their own choice — for blocking operations (EXIT/YIELD/
+ *          IPC RECV and sometimes IPC SEND) the frame of the next scheduled
+ *          process.
+ *
+ * Locking: no locks held on entry; individual calls may acquire
+ *          sched_lock / msg_lock / per-CPU sched_lock internally.
+ * IRQ context: no — syscalls run in kernel mode with IRQs enabled (normal
+ *          exception-level transition on aarch64; ring 3->0 on amd64).
+ *
+ * NOTE(ABI-07): SYS_SPAWN calls arch_local_irq_disable() before
+ *          process_create + process_load_elf, which may block on virtio I/O.
+ */
+struct pt_regs *kernel_syscall_dispatcher(struct pt_regs *frame) {
+  uint64_t syscall_num = pt_regs_syscall_num(frame);
+  const struct syscall_entry *e =
+      syscall_num < SYS_NR ? &syscall_table[syscall_num] : NULL;
+  if (!e || (!e->fn && !e->frame_fn)) {
     pr_warn("Unknown syscall: %ld\n", syscall_num);
     pt_regs_set_return(frame, -ENOSYS);
-    break;
+    return frame;
   }
 
+  uint64_t a[6] = {0, 0, 0, 0, 0, 0};
+  for (int i = 0; i < e->nargs; i++)
+    a[i] = pt_regs_arg(frame, i);
+  if (trace_on_any(TRACE_SYS_MASK))
+    return syscall_traced(frame, e, (uint32_t)syscall_num, a);
+  if (e->frame_fn)
+    return e->frame_fn(frame, a);
+  pt_regs_set_return(frame, e->fn(a[0], a[1], a[2], a[3], a[4], a[5]));
   return frame;
 }
 
+/*
+ * syscall_call_nowait - see kernel/syscall.h.  The blocking calls an SQE
+ * may name run their non-blocking halves; every other call must be a
+ * SYSCALL_URING value call, with the argument registers it does not read
+ * zeroed as the dispatcher would.
+ */
+long syscall_call_nowait(uint32_t nr, const uint64_t *a) {
+  if (nr == SYS_READ)
+    return sys_read_nowait((int)a[0], (char *)a[1], (size_t)a[2]);
+  if (nr == SYS_READV)
+    return fd_readv_nowait((int)a[0], (const struct iovec *)a[1], (int)a[2],
+                           -1);
+  if (nr == SYS_WRITE)
+    return sys_write((int)a[0], (const char *)a[1], (size_t)a[2]);
+  if (nr == SYS_WRITEV)
+    return fd_writev((int)a[0], (const struct iovec *)a[1], (int)a[2], -1);
+  if (nr == SYS_SEND) {
+    long rc = sys_ipc_send((int)a[0], (void *)a[1], (int)a[2] | IPC_NONBLOCK);
+    return rc == IPC_SEND_RETRY ? -EAGAIN : rc;
+  }
+  if (nr >= SYS_NR || (!syscall_table[nr].fn && !syscall_table[nr].frame_fn))
+    return -ENOSYS;
+  const struct syscall_entry *e = &syscall_table[nr];
+  if (!(e->flags & SYSCALL_URING))
+    return -EINVAL;
+  uint64_t v[6] = {0, 0, 0, 0, 0, 0};
+  for (int i = 0; i < e->nargs; i++)
+    v[i] = a[i];
+  return e->fn(v[0], v[1], v[2], v[3], v[4], v[5]);
+}
+
 /*
  * sys_get_time - return current time in milliseconds.
  *
@@ -768,14 +1178,337 @@ extern uint64_t timer_get_us(void);
 long sys_get_time(void) { return (long)(timer_get_us() / 1000); }
 
 /*
- * sys_get_pid - return the PID of the calling process.
+ * sys_get_pid - return the PID of the calling process (its thread-group
+ * id: every thread of a process reports the leader's PID).
  *
  * Returns 0 if current_process is NULL (should not happen in normal operation).
  * Locking: none (current_process is CPU-local during a syscall).
  * IRQ context: no.
  */
 long sys_get_pid(void) {
-  return current_process ? (long)current_process->pid : 0;
+  return current_process ? (long)current_process->tgid : 0;
+}
+
+/*
+ * fd_lookup - the caller's open fd entry for fd, or NULL (-EBADF).
+ */
+static struct fd_entry *fd_lookup(int fd) {
+  if (current_process && fd >= 0 && fd < NPROC_FDS &&
+      current_process->space->fds[fd].type != FD_NONE)
+    return &current_process->space->fds[fd];
+  return NULL;
+}
+
+/*
+ * fd_close - clear a slot of the caller's table, closing the pipe end it
+ * held (the only kind of entry that holds a kernel object).
+ */
+static int fd_close(int fd) {
+  if (fd < 0 || fd >= NPROC_FDS)
+    return -EBADF;
+  struct proc_space *space = current_process->space;
+  uint64_t fd_flags;
+  spin_lock_irqsave(&space->fd_lock, &fd_flags);
+  struct fd_entry old = space->fds[fd];
+  if (old.type != FD_NONE)
+    memset(&space->fds[fd], 0, sizeof(struct fd_entry));
+  spin_unlock_irqrestore(&space->fd_lock, fd_flags);
+  if (old.type == FD_PIPE)
+    pipe_close_end(old.pipe, (old.mode & FD_MODE_WRITE) != 0);
+  return old.type != FD_NONE ? 0 : -EBADF;
+}
+
+/*
+ * fd_pipe_hold - the pipe behind fd if it is the read (write = 0) or write
+ * end, with a reference taken under fd_lock so a sibling's close cannot
+ * recycle it mid-call; *mode receives the entry's FD_MODE_* bits.  NULL if
+ * fd is anything else.
+ */
+static struct pipe *fd_pipe_hold(int fd, int write, uint8_t *mode) {
+  if (fd < 0 || fd >= NPROC_FDS)
+    return NULL;
+  struct proc_space *space = current_process->space;
+  struct pipe *p = NULL;
+  uint64_t fd_flags;
+  spin_lock_irqsave(&space->fd_lock, &fd_flags);
+  struct fd_entry *e = &space->fds[fd];
+  if (e->type == FD_PIPE &&
+      (e->mode & (write ? FD_MODE_WRITE : FD_MODE_READ))) {
+    p = e->pipe;
+    *mode = e->mode;
+    pipe_get(p);
+  }
+  spin_unlock_irqrestore(&space->fd_lock, fd_flags);
+  return p;
+}
+
+/*
+ * fd_win_target - the window a write to an FD_WIN fd lands in.
+ *
+ * stdout sink (USR-TTY-01 #123): resolve the caller's OWN window first; a
+ * process with its own window (doom, top, forkbomb) renders there.  A
+ * windowless CLI tool falls back to its controlling terminal (the
+ * launching shell), so it runs "in the shell" POSIX-style.
+ */
+static int fd_win_target(const struct fd_entry *e) {
+  int win_id = e->win_id;
+  if (win_id < 0)
+    win_id = compositor_get_window_by_pid(current_process->tgid);
+  if (win_id <= 0)
+    win_id = current_process->ctty_win;
+  return win_id;
+}
+
+/*
+ * fd_iov_fetch - copy iovcnt user iovecs into kiov (IOV_MAX slots) and
+ * return their total length: -EINVAL for a count outside [0, IOV_MAX] or a
+ * total above SYSCALL_MAX_IO_BYTES, -EFAULT for an unreadable array.
+ */
+static long fd_iov_fetch(struct iovec *kiov, const struct iovec *uiov,
+                         int iovcnt) {
+  if (iovcnt < 0 || iovcnt > IOV_MAX)
+    return -EINVAL;
+  if (iovcnt == 0)
+    return 0;
+  if (arch_copy_from_user(kiov, uiov, (size_t)iovcnt * sizeof(*kiov)) != 0)
+    return -EFAULT;
+  size_t total = 0;
+  for (int i = 0; i < iovcnt; i++) {
+    if (kiov[i].iov_len > SYSCALL_MAX_IO_BYTES - total)
+      return -EINVAL;
+    total += kiov[i].iov_len;
+  }
+  return (long)total;
+}
+
+/* fd_iov_gather / fd_iov_scatter - move the first n bytes between the user
+ * segments and one contiguous kernel buffer.  0 or -EFAULT. */
+static int fd_iov_gather(uint8_t *k, const struct iovec *kiov, int iovcnt,
+                         size_t n) {
+  for (int i = 0; i < iovcnt && n > 0; i++) {
+    size_t len = kiov[i].iov_len < n ? kiov[i].iov_len : n;
+    if (len && arch_copy_from_user(k, kiov[i].iov_base, len) != 0)
+      return -EFAULT;
+    k += len;
+    n -= len;
+  }
+  return 0;
+}
+
+static int fd_iov_scatter(const struct iovec *kiov, int iovcnt,
+                          const uint8_t *k, size_t n) {
+  for (int i = 0; i < iovcnt && n > 0; i++) {
+    size_t len = kiov[i].iov_len < n ? kiov[i].iov_len : n;
+    if (len && arch_copy_to_user(kiov[i].iov_base, k, len) != 0)
+      return -EFAULT;
+    k += len;
+    n -= len;
+  }
+  return 0;
+}
+
+/*
+ * fd_file_rw - read or write an FD_FILE's data at pos, or at the fd's
+ * private offset (advanced by the transfer) when pos < 0.
+ *
+ * However many segments there are, the data moves through one kmalloc
+ * bounce buffer and one vfs_read / vfs_write_file, so a scattered record
+ * costs a single VFS pass.  A write refreshes the cached node, since it may
+ * have grown the file.  total is the caller's fd_iov_fetch() result.
+ *
+ * Returns: bytes moved (0 at EOF), or -EBADF (mode), -ENOMEM, -EFAULT,
+ *          -EIO.
+ */
+static long fd_file_rw(struct fd_entry *e, const struct iovec *kiov,
+                       int iovcnt, size_t total, long pos, int write) {
+  if (!(e->mode & (write ? FD_MODE_WRITE : FD_MODE_READ)))
+    return -EBADF;
+  if (total == 0)
+    return 0;
+  uint64_t off = pos < 0 ? e->offset : (uint64_t)pos;
+  uint8_t *k_buf = kmalloc(total);
+  if (!k_buf)
+    return -ENOMEM;
+  long ret;
+  if (write) {
+    if (fd_iov_gather(k_buf, kiov, iovcnt, total) != 0) {
+      ret = -EFAULT;
+    } else {
+      int wr = vfs_write_file(e->path, k_buf, (uint32_t)total, off);
+      ret = wr < 0 ? -EIO : wr;
+      if (wr >= 0)
+        (void)vfs_open(e->path, &e->node);
+    }
+  } else {
+    int n = vfs_read(&e->node, off, k_buf, (uint32_t)total);
+    if (n < 0)
+      ret = -EIO;
+    else if (fd_iov_scatter(kiov, iovcnt, k_buf, (size_t)n) != 0)
+      ret = -EFAULT;
+    else
+      ret = n;
+  }
+  kfree(k_buf);
+  if (ret > 0 && pos < 0)
+    e->offset += (uint64_t)ret;
+  return ret;
+}
+
+/*
+ * fd_pipe_rw - read or write an FD_PIPE end without sleeping: at most
+ * PIPE_SIZE bytes (all a pipe can move at once) go through a stack bounce,
+ * so the user copies happen outside the pipe's lock.  A read that faults
+ * on the way out has consumed its bytes.
+ *
+ * Returns: bytes moved, 0 at EOF, -EAGAIN (would block: fd_block),
+ *          -EPIPE, -EBADF (not this end of a pipe), -EFAULT.
+ */
+static long fd_pipe_rw(int fd, const struct iovec *kiov, int iovcnt,
+                       size_t total, int write) {
+  uint8_t mode;
+  struct pipe *p = fd_pipe_hold(fd, write, &mode);
+  if (!p)
+    return -EBADF;
+  uint8_t k[PIPE_SIZE];
+  size_t n = total < PIPE_SIZE ? total : PIPE_SIZE;
+  long ret;
+  if (write) {
+    ret = fd_iov_gather(k, kiov, iovcnt, n) != 0 ? -EFAULT
+                                                 : pipe_write(p, k, n);
+  } else {
+    ret = pipe_read(p, k, n);
+    if (ret > 0 && fd_iov_scatter(kiov, iovcnt, k, (size_t)ret) != 0)
+      ret = -EFAULT;
+  }
+  pipe_put(p);
+  return ret;
+}
+
+/*
+ * fd_block - the read (write = 0) or n-byte write on fd returned -EAGAIN:
+ * sleep until it may succeed and re-execute the syscall.  stdin waits for
+ * an IPC message; a pipe end parks on the pipe (pipe_wait), unless it was
+ * opened O_NONBLOCK, in which case -EAGAIN is the answer.
+ */
+static struct pt_regs *fd_block(struct pt_regs *frame, int fd, int write,
+                                size_t n) {
+  uint8_t mode;
+  struct pipe *p = fd_pipe_hold(fd, write, &mode);
+  if (p) {
+    int queued = 0;
+    if (!(mode & FD_MODE_NONBLOCK))
+      queued = pipe_wait(p, write, n);
+    pipe_put(p);
+    if (mode & FD_MODE_NONBLOCK) {
+      pt_regs_set_return(frame, -EAGAIN);
+      return frame;
+    }
+    if (!queued)
+      pt_regs_retry_syscall(frame); /* ready meanwhile: just run it again */
+    return schedule(frame);
+  }
+  ipc_wait_message(-1); /* stdin: wait for ANY */
+  pt_regs_retry_syscall(frame);
+  return schedule(frame);
+}
+
+/*
+ * fd_readv_nowait / fd_writev - readv / writev (pos < 0) and preadv /
+ * pwritev (pos >= 0) on any fd (include/api/sys/uio.h).
+ *
+ *   FD_FILE  fd_file_rw().
+ *   FD_KBD   readv hands one key to the first non-empty segment through
+ *            sys_read_nowait() (-EAGAIN when none is pending; sc_readv
+ *            sleeps on it).  Not writable: -EINVAL.
+ *   FD_WIN   writev gathers the segments into one bounce buffer and
+ *            appends them to fd_win_target() in one go.  Not readable:
+ *            -EINVAL.
+ *   FD_PIPE  fd_pipe_rw() (-EAGAIN when it would block).
+ *
+ * Non-files have no offset, so the positional forms give -ESPIPE there.
+ * Locking / IRQ context: as sys_read / sys_write.
+ */
+static long fd_readv_nowait(int fd, const struct iovec *uiov, int iovcnt,
+                            long pos) {
+  struct fd_entry *e = fd_lookup(fd);
+  if (!e)
+    return -EBADF;
+  struct iovec kiov[IOV_MAX];
+  long total = fd_iov_fetch(kiov, uiov, iovcnt);
+  if (total < 0)
+    return total;
+  if (e->type == FD_FILE)
+    return fd_file_rw(e, kiov, iovcnt, (size_t)total, pos, 0);
+  if (pos >= 0)
+    return -ESPIPE;
+  if (e->type == FD_PIPE)
+    return fd_pipe_rw(fd, kiov, iovcnt, (size_t)total, 0);
+  if (e->type != FD_KBD)
+    return -EINVAL;
+  for (int i = 0; i < iovcnt; i++)
+    if (kiov[i].iov_len)
+      return sys_read_nowait(fd, kiov[i].iov_base, kiov[i].iov_len);
+  return 0;
+}
+
+static long fd_writev(int fd, const struct iovec *uiov, int iovcnt, long pos) {
+  struct fd_entry *e = fd_lookup(fd);
+  if (!e)
+    return -EBADF;
+  struct iovec kiov[IOV_MAX];
+  long total = fd_iov_fetch(kiov, uiov, iovcnt);
+  if (total < 0)
+    return total;
+  if (e->type == FD_FILE)
+    return fd_file_rw(e, kiov, iovcnt, (size_t)total, pos, 1);
+  if (pos >= 0)
+    return -ESPIPE;
+  if (e->type == FD_PIPE)
+    return fd_pipe_rw(fd, kiov, iovcnt, (size_t)total, 1);
+  if (e->type != FD_WIN)
+    return -EINVAL;
+  if (total == 0)
+    return 0;
+  char *k = kmalloc((size_t)total + 1);
+  if (!k)
+    return -ENOMEM;
+  if (fd_iov_gather((uint8_t *)k, kiov, iovcnt, (size_t)total) != 0) {
+    kfree(k);
+    return -EFAULT;
+  }
+  k[total] = 0;
+  window_text_put(fd_win_target(e), k, (size_t)total);
+  kfree(k);
+  return total;
+}
+
+/*
+ * fd_pread / fd_pwrite - pread64 / pwrite64: one segment at an explicit
+ * offset; the fd's own offset is untouched.  Files only (-ESPIPE), and
+ * pos must not be negative (-EINVAL).
+ */
+static long fd_pread(int fd, char *buf, size_t count, long pos) {
+  struct fd_entry *e = fd_lookup(fd);
+  if (!e)
+    return -EBADF;
+  if (e->type != FD_FILE)
+    return -ESPIPE;
+  if (pos < 0 || count > SYSCALL_MAX_IO_BYTES)
+    return -EINVAL;
+  struct iovec v = { buf, count };
+  return fd_file_rw(e, &v, 1, count, pos, 0);
+}
+
+static long fd_pwrite(int fd, const char *buf, size_t count, long pos) {
+  struct fd_entry *e = fd_lookup(fd);
+  if (!e)
+    return -EBADF;
+  if (e->type != FD_FILE)
+    return -ESPIPE;
+  if (pos < 0 || count > SYSCALL_MAX_IO_BYTES)
+    return -EINVAL;
+  struct iovec v = { (void *)buf, count };
+  return fd_file_rw(e, &v, 1, count, pos, 1);
 }
 
 /*
@@ -786,106 +1519,73 @@ long sys_get_pid(void) {
  *   FD_KBD   drains the IPC queue for IPC_TYPE_INPUT messages (keyboard
  *            events); returns the key character of the first pressed or
  *            repeated event (data2 != 0), ignores releases.  If nothing is
- *            pending the process sleeps (PROC_SLEEPING, ipc_target_pid=-1)
- *            with a retry annotation (pt_regs_retry_syscall) so the syscall
+ *            pending the process sleeps (ipc_wait_message(-1), which
+ *            re-checks the ring under msg_lock) with a retry annotation (pt_regs_retry_syscall) so the syscall
  *            re-executes on wakeup.
  *   FD_FILE  VFS read at the fd's private offset (bounce buffer, capped at
  *            SYSCALL_MAX_IO_BYTES); advances the offset; 0 at EOF.
+ *   FD_PIPE  what is buffered, up to count (fd_pipe_rw); 0 once no writer
+ *            is left; sleeps on the pipe while it is empty (fd_block).
  *   FD_WIN   not readable: -EINVAL.
  *   invalid  -EBADF.
  *
- * Locking: FD_KBD sleeps after a short IRQ-disable window to set state;
- *          no spinlock held across the sleep.
+ * sys_read_nowait() is one attempt: everything above except the sleep,
+ * which it reports as -EAGAIN.  SYS_URING runs it directly.  The file path
+ * is fd_file_rw(), shared with the vectored and positional calls.
+ *
+ * Locking: FD_KBD takes msg_lock only to pop / commit to sleep; no
+ *          spinlock held across the sleep.
  * IRQ context: no — called from the syscall dispatcher.
  * Returns: regs (with return value set), or schedule(regs) when blocking.
  */
-struct pt_regs *sys_read(struct pt_regs *regs) {
-  int fd = (int)pt_regs_arg(regs, 0);
-  char *buf = (char *)pt_regs_arg(regs, 1);
-  size_t count = (size_t)pt_regs_arg(regs, 2);
-
-  struct fd_entry *e = NULL;
-  if (current_process && fd >= 0 && fd < NPROC_FDS &&
-      current_process->fds[fd].type != FD_NONE)
-    e = &current_process->fds[fd];
-  if (!e) {
-    pt_regs_set_return(regs, -EBADF);
-    return regs;
-  }
+static long sys_read_nowait(int fd, char *buf, size_t count) {
+  struct fd_entry *e = fd_lookup(fd);
+  if (!e)
+    return -EBADF;
 
   if (e->type == FD_FILE) {
-    if (!(e->mode & FD_MODE_READ)) {
-      pt_regs_set_return(regs, -EBADF);
-      return regs;
-    }
-    if (count > SYSCALL_MAX_IO_BYTES) { /* FIX(EXT4-07) */
-      pt_regs_set_return(regs, -EINVAL);
-      return regs;
-    }
-    if (count == 0) {
-      pt_regs_set_return(regs, 0);
-      return regs;
-    }
-    uint8_t *k_buf = kmalloc(count);
-    if (!k_buf) {
-      pt_regs_set_return(regs, -ENOMEM);
-      return regs;
-    }
-    long ret;
-    int n = vfs_read(&e->node, e->offset, k_buf, (uint32_t)count);
-    if (n < 0) {
-      ret = -EIO;
-    } else if (n > 0 && arch_copy_to_user(buf, k_buf, (size_t)n) != 0) {
-      ret = -EFAULT;
-    } else {
-      e->offset += (uint64_t)n;
-      ret = n;
-    }
-    kfree(k_buf);
-    pt_regs_set_return(regs, ret);
-    return regs;
+    if (count > SYSCALL_MAX_IO_BYTES) /* FIX(EXT4-07) */
+      return -EINVAL;
+    struct iovec v = { buf, count };
+    return fd_file_rw(e, &v, 1, count, -1, 0);
   }
 
-  if (e->type != FD_KBD) { /* FD_WIN: a window text sink is not readable */
-    pt_regs_set_return(regs, -EINVAL);
-    return regs;
+  if (e->type == FD_PIPE) {
+    struct iovec v = { buf, count };
+    return fd_pipe_rw(fd, &v, 1, count, 0);
   }
 
-  /* FD_KBD (stdin) */
-  (void)count;
-  while (1) {
-    extern struct ipc_node *pop_message(struct process * proc, int src_pid);
-    struct ipc_node *node = pop_message(current_process, -1); /* From ANY */
-
-    if (!node)
-      break;
+  if (e->type != FD_KBD) /* FD_WIN: a window text sink is not readable */
+    return -EINVAL;
 
-    if (node->msg.type == IPC_TYPE_INPUT) {
+  /* FD_KBD (stdin) */
+  struct ipc_message m;
+  while (pop_message(current_process, -1, &m) == 0) { /* From ANY */
+    if (m.type == IPC_TYPE_INPUT) {
       /* Only return pressed (1) or repeat (2) events to standard read()
        * Release (0) events are ignored for compatibility with shell/etc.
        */
-      if (node->msg.data2 != 0) {
-        char c = (char)node->msg.data1;
+      if (m.data2 != 0) {
+        char c = (char)m.data1;
         if (arch_copy_to_user(buf, &c, 1) != 0) { }
-        pt_regs_set_return(regs, 1);
-        kfree(node);
-        return regs;
+        return 1;
       }
     }
-    kfree(node);
   }
-
-  arch_local_irq_disable();
-  /* Wait for input via scheduler */
-  current_process->ipc_target_pid = -1; /* Waiting for ANY */
-  current_process->state = PROC_SLEEPING;
-  arch_local_irq_enable();
-
-  pt_regs_retry_syscall(regs);
-  return schedule(regs);
+  return -EAGAIN;
 }
 
-extern void uart_puts(const char *str);
+struct pt_regs *sys_read(struct pt_regs *regs) {
+  int fd = (int)pt_regs_arg(regs, 0);
+  long rc = sys_read_nowait(fd, (char *)pt_regs_arg(regs, 1),
+                            (size_t)pt_regs_arg(regs, 2));
+  /* Only stdin and an empty pipe report -EAGAIN */
+  if (rc != -EAGAIN) {
+    pt_regs_set_return(regs, rc);
+    return regs;
+  }
+  return fd_block(regs, fd, 0, 0);
+}
 
 /*
  * sys_write - write to a file descriptor.
@@ -897,8 +1597,11 @@ extern void uart_puts(const char *str);
  *              UART (serial mirror), and appends to the caller's OWN window
  *              (resolved by PID; a child does not inherit the spawner's).
  *   FD_FILE    VFS write at the fd's private offset (bounce buffer, capped
- *              at SYSCALL_MAX_IO_BYTES); advances the offset and refreshes
- *              the cached node size.
+ *              at SYSCALL_MAX_IO_BYTES, fd_file_rw); advances the offset
+ *              and refreshes the cached node size.
+ *   FD_PIPE    as much as fits (fd_pipe_rw), possibly a short count;
+ *              -EPIPE once no reader is left; -EAGAIN when full, on which
+ *              sc_write sleeps (fd_block) and SYS_URING reports it.
  *   FD_KBD     not writable: -EINVAL.
  *   invalid    -EBADF.
  *
@@ -913,47 +1616,23 @@ extern void uart_puts(const char *str);
 long sys_write(int fd, const char *buf, size_t count) {
   if (count == 0) return 0;
 
-  struct fd_entry *e = NULL;
-  if (current_process && fd >= 0 && fd < NPROC_FDS &&
-      current_process->fds[fd].type != FD_NONE)
-    e = &current_process->fds[fd];
+  struct fd_entry *e = fd_lookup(fd);
   if (!e)
     return -EBADF;
 
-  if (e->type == FD_WIN) {
-    /* stdout sink (USR-TTY-01 #123): resolve the caller's OWN window first;
-     * a process with its own window (doom, top, forkbomb) renders there.  A
-     * windowless CLI tool falls back to its controlling terminal (the
-     * launching shell), so it runs "in the shell" POSIX-style. */
-    int win_id = e->win_id;
-    if (win_id < 0)
-      win_id = compositor_get_window_by_pid(current_process->pid);
-    if (win_id <= 0)
-      win_id = current_process->ctty_win;
-    return window_text_write(win_id, buf, count);
-  }
+  if (e->type == FD_WIN)
+    return window_text_write(fd_win_target(e), buf, count);
 
   if (e->type == FD_FILE) {
-    if (!(e->mode & FD_MODE_WRITE))
-      return -EBADF;
     if (count > SYSCALL_MAX_IO_BYTES) /* FIX(EXT4-07) */
       return -EINVAL;
-    uint8_t *k_buf = kmalloc(count);
-    if (!k_buf)
-      return -ENOMEM;
-    if (arch_copy_from_user(k_buf, buf, count) != 0) {
-      kfree(k_buf);
-      return -EFAULT;
-    }
-    int wr = vfs_write_file(e->path, k_buf, (uint32_t)count, e->offset);
-    kfree(k_buf);
-    if (wr < 0)
-      return -EIO;
-    e->offset += (uint64_t)wr;
-    /* The write may have grown the file: refresh the cached node so reads
-     * through this fd see the new size. */
-    (void)vfs_open(e->path, &e->node);
-    return wr;
+    struct iovec v = { (void *)buf, count };
+    return fd_file_rw(e, &v, 1, count, -1, 1);
+  }
+
+  if (e->type == FD_PIPE) {
+    struct iovec v = { (void *)buf, count };
+    return fd_pipe_rw(fd, &v, 1, count, 1);
   }
 
   return -EINVAL; /* FD_KBD is not writable */
@@ -962,8 +1641,10 @@ long sys_write(int fd, const char *buf, size_t count) {
 /*
  * sys_exit - terminate the calling process.
  *
- * Calls process_terminate(current_process->pid), which marks the process
- * PROC_ZOMBIE and returns immediately (it cannot free its own kernel stack).
+ * Calls process_terminate(current_process->tgid): exit() ends the whole
+ * process, so every sibling thread dies with it.  The calling thread is
+ * marked PROC_ZOMBIE and returns immediately (it cannot free its own kernel
+ * stack).
  * The caller (case 93 in kernel_syscall_dispatcher) MUST call schedule()
  * after sys_exit() to switch away from this process; that schedule() call
  * auto-reaps the zombie via the per-CPU deferred-free stack.
@@ -976,6 +1657,6 @@ long sys_write(int fd, const char *buf, size_t count) {
 void sys_exit(int status) {
   if (current_process) {
     pr_info("PID %d exiting with status %d\n", current_process->pid, status);
-    process_terminate(current_process->pid);
+    process_terminate(current_process->tgid);
   }
 }
@@ -8,13 +8,18 @@
  *     amd64: arch/amd64/platform/platform.c via PIT/APIC).
  *   - A software timer list (struct timer), run on CPU 0 every tick.
  *   - Compositor pacing: fires compositor_tick() at ~30 FPS on CPU 0.
+ *   - Kernel log drain: klog_tick() on CPU 0 pushes queued printk output to
+ *     the UART (kernel/klog.h).
  *   - Arch-specific per-CPU timer init via __attribute__((weak)) stubs
  *     that each arch overrides.
  *
  * Layering:
- *   arch IRQ -> kernel_timer_tick() -> schedule()
+ *   arch IRQ -> kernel_timer_tick() -> pmu_tick()   (per-thread counters)
+ *                                   -> rcu_tick()   (quiescent state, callbacks)
+ *                                   -> schedule()
  *                                   -> software timer callbacks (CPU 0)
  *                                   -> compositor_tick()          (CPU 0)
+ *                                   -> klog_tick()                (CPU 0)
  *
  * Key invariants:
  *   - jiffies is incremented only by CPU 0 to avoid SMP races; all other
@@ -36,8 +41,11 @@
 #include <drivers/timer.h>
 #include <kernel/arch.h>
 #include <kernel/cpu.h>
+#include <kernel/klog.h>
 #include <kernel/list.h>
+#include <kernel/pmu.h>
 #include <kernel/printk.h>
+#include <kernel/rcu.h>
 #include <kernel/sched.h>
 #include <kernel/spinlock.h>
 
@@ -96,7 +104,8 @@ __attribute__((weak)) struct pt_regs *timer_handler(struct pt_regs *regs) {
  *   3. CPU 0 only: increment the global jiffies counter.
  *   4. CPU 0 only: fire expired software timers under timer_lock.
  *   5. CPU 0 only: call compositor_tick() every compositor_interval ticks.
- *   6. All CPUs: invoke schedule(regs) for preemptive multitasking.
+ *   6. All CPUs: charge the tick to SCHED_RT bandwidth (sched_tick) and
+ *      invoke schedule(regs) for preemptive multitasking.
  *
  * Locking: acquires timer_lock (irqsave) around the software timer walk on
  *          CPU 0; no other locks held on entry.
@@ -113,6 +122,7 @@ struct pt_regs *kernel_timer_tick(struct pt_regs *regs) {
 
   struct cpu_info *cpu = get_cpu_info();
   cpu->tick_count++;
+  pmu_tick();
 
   /* Global jiffies incremented only by the primary core */
   if (cpu->cpu_id == 0) {
@@ -157,9 +167,18 @@ struct pt_regs *kernel_timer_tick(struct pt_regs *regs) {
     if ((jiffies % compositor_interval) == 0) {
       compositor_tick();
     }
+
+    /* Keep the log flowing when nothing is printing: each drain sends only
+     * what the UART takes without waiting. */
+    klog_tick();
   }
 
+  /* The tick arrived with IRQs on, so this CPU is outside any RCU read
+   * section: report it and run the callbacks whose grace period is over. */
+  rcu_tick(cpu);
+
   /* Call Scheduler for Preemption */
+  sched_tick();
   return schedule(regs);
 }
 
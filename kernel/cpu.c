@@ -5,7 +5,11 @@
 #include <kernel/cpu.h>
 #include <kernel/arch.h>
 #include <kernel/fault.h>
+#include <kernel/kmalloc.h>
+#include <kernel/percpu.h>
+#include <kernel/pmm.h>
 #include <kernel/printk.h>
+#include <kernel/vmm.h>
 
 /* CPU info array */
 struct cpu_info cpu_data[MAX_CPUS];
@@ -13,7 +17,7 @@ uint32_t nr_cpus = 0;
 
 /* Generic implementation (weak - can be overridden by arch-specific) */
 __attribute__((weak))
-struct cpu_info *get_cpu_info(void) {
+struct cpu_info *get_cpu_info_slow(void) {
   uint32_t id = arch_get_cpu_id();
   if (id >= MAX_CPUS) {
     /* Critical failure if CPU ID is out of bounds */
@@ -22,6 +26,59 @@ struct cpu_info *get_cpu_info(void) {
   return &cpu_data[id];
 }
 
+uint64_t percpu_sum(enum pcpu_stat stat) {
+  uint64_t sum = 0;
+  for (int i = 0; i < MAX_CPUS; i++)
+    sum += __atomic_load_n(&cpu_data[i].stats[stat], __ATOMIC_RELAXED);
+  return sum;
+}
+
+#define CPUSTAT_TEXT_MAX 8192
+
+long sys_cpustat(char *ubuf, size_t size) {
+  if (size > CPUSTAT_TEXT_MAX)
+    size = CPUSTAT_TEXT_MAX;
+  char *k = kmalloc(size ? size : 1);
+  if (!k)
+    return -ENOMEM;
+
+  size_t n = 0;
+  n += (size_t)snprintf(k, size,
+                        "cpu        ticks      ctxsw       irqs   pg-alloc"
+                        "   pg-freed\n");
+  for (uint32_t i = 0; i < MAX_CPUS && n < size; i++) {
+    struct cpu_info *c = &cpu_data[i];
+    if (!c->online)
+      continue;
+    uint64_t v[PCPU_NR_STATS];
+    for (int s = 0; s < PCPU_NR_STATS; s++)
+      v[s] = __atomic_load_n(&c->stats[s], __ATOMIC_RELAXED);
+    n += (size_t)snprintf(k + n, size - n,
+                          "%3u %12lu %10lu %10lu %10lu %10lu\n", i,
+                          (unsigned long)c->tick_count,
+                          (unsigned long)v[PCPU_CTX_SWITCHES],
+                          (unsigned long)v[PCPU_IRQS],
+                          (unsigned long)v[PCPU_PAGES_ALLOC],
+                          (unsigned long)v[PCPU_PAGES_FREED]);
+  }
+  if (n < size)
+    n += (size_t)snprintf(k + n, size - n,
+                          /* 17 columns: the kernel vsnprintf does not pad %s */
+                          "all               %10lu %10lu %10lu %10lu\n"
+                          "free pages: %lu\n",
+                          (unsigned long)percpu_sum(PCPU_CTX_SWITCHES),
+                          (unsigned long)percpu_sum(PCPU_IRQS),
+                          (unsigned long)percpu_sum(PCPU_PAGES_ALLOC),
+                          (unsigned long)percpu_sum(PCPU_PAGES_FREED),
+                          (unsigned long)pmm_get_free_pages());
+  if (n > size)
+    n = size;
+
+  long rc = vmm_copy_to_user(ubuf, k, n) != 0 ? -EFAULT : (long)n;
+  kfree(k);
+  return rc;
+}
+
 /*
  * Generic Exception Wrappers
  */
@@ -18,6 +18,7 @@
  *                   PLATFORM_GICD_BASE and PLATFORM_UART_BASE to amd64 builds
  *                   where they have no meaning.
  */
+#include <drivers/uart.h>
 #include <kernel/drivers.h>
 #include <kernel/hal.h>
 #include <kernel/printk.h>
@@ -25,9 +26,8 @@
 /*
  * driver_console_init - initialise the primary serial console.
  *
- * Calls the arch UART driver's uart_init() to configure baud rate, FIFOs,
- * and (on aarch64) register the RX IRQ handler.  After this call printk()
- * is fully operational.
+ * Calls the arch UART driver's uart_init() to configure baud rate and
+ * FIFOs.  After this call printk() is fully operational, with polled TX.
  *
  * Locking: none; must be called once from boot CPU before SMP.
  * MMIO/IO side effects: delegated entirely to uart_init().
@@ -41,3 +41,18 @@ void driver_console_init(void) {
     uart_init();
     pr_info("%s", "Console driver initialized\n");
 }
+
+/*
+ * driver_console_irq_init - make the console UART interrupt driven.
+ *
+ * Called once the interrupt controller is initialised (uart_init runs
+ * before it, and a line registered earlier would never be unmasked).  From
+ * here on serial output only costs the CPU a ring store per byte; the TX
+ * interrupt feeds the FIFO.
+ *
+ * Locking: none; called once from the boot CPU before SMP.
+ */
+void driver_console_irq_init(void) {
+    uart_irq_init();
+    pr_info("%s", "Console: interrupt-driven TX/RX enabled\n");
+}
@@ -39,6 +39,7 @@
 #include <kernel/cpu.h>
 #include <kernel/list.h>
 #include <kernel/printk.h>
+#include <kernel/prof.h>
 #include <kernel/sched.h>
 #include <kernel/spinlock.h>
 #include <kernel/types.h>
@@ -144,6 +145,12 @@ extern struct pt_regs *kernel_timer_tick(struct pt_regs *regs);
  *   5. Write the new compare value to CNTV_CVAL_EL0.
  *   6. Call kernel_timer_tick(regs) for scheduler tick + preemption.
  *
+ * Profiling (kernel/prof.h): while prof_hz is set every interrupt takes a
+ * sample, and the compare is the earlier of the next tick and the next
+ * sample deadline (cpu->prof_next).  Any interrupt before next_tick_target
+ * is a sample only: it re-arms and returns without ticking, so HZ is
+ * unchanged.
+ *
  * Returns the (potentially switched) register state from kernel_timer_tick().
  *
  * Locking: per-CPU data (cpu_info); no cross-CPU locking needed.
@@ -151,6 +158,21 @@ extern struct pt_regs *kernel_timer_tick(struct pt_regs *regs);
  */
 struct pt_regs *timer_handler(struct pt_regs *regs) {
   struct cpu_info *cpu = get_cpu_info();
+  uint32_t prof = prof_rate();
+  uint64_t t = read_cntvct();
+
+  if (__builtin_expect(prof != 0, 0) && t >= cpu->prof_next) {
+    __prof_sample(regs);
+    cpu->prof_next = t + timer_freq / prof;
+  }
+  if (t < cpu->next_tick_target) {
+    /* A sample deadline (or one left over from a stopped profile). */
+    uint64_t cval = cpu->next_tick_target;
+    if (prof && cpu->prof_next < cval)
+      cval = cpu->prof_next;
+    write_cntv_cval(cval);
+    return regs;
+  }
 
   /* Precision Tick Logic for ARM Generic Timer */
   extern uint64_t timer_tick_interval;
@@ -171,7 +193,10 @@ struct pt_regs *timer_handler(struct pt_regs *regs) {
     cpu->next_tick_target = now + interval;
   }
 
-  write_cntv_cval(cpu->next_tick_target);
+  uint64_t cval = cpu->next_tick_target;
+  if (prof && cpu->prof_next < cval)
+    cval = cpu->prof_next;
+  write_cntv_cval(cval);
 
   /* Call generic tick logic */
   return kernel_timer_tick(regs);
@@ -3,19 +3,26 @@
  * COM1 Serial Driver (16550 compatible) — amd64
  *
  * Drives the standard PC COM1 port (I/O base 0x3F8) using the 16550A UART
- * register set.  Provides polled TX and polled RX; no interrupt-driven RX
- * ring buffer (unlike the PL011 driver).  RX interrupts are enabled in the
- * UART (IER bit 0) but the amd64 IRQ dispatch path handles them via the IDT
- * common handler and irq_dispatch(), not through this driver's own handler.
+ * register set, with 16-byte hardware FIFOs in both directions and software
+ * rings behind them (drivers/uart_ring.h).
  *
  * Architecture:
- *   TX: uart_putc busy-waits on LSR.THRE (bit 5) before writing to THR.
- *       uart_puts adds an explicit '\r' before each '\n' (CR+LF expansion).
- *       No spinlock is used on the TX path — safe on single-core QEMU, but
- *       a data race on SMP.
+ *   TX: writers queue bytes in tx_ring under uart_lock and return; tx_fill
+ *       moves up to a FIFO's worth into THR whenever LSR.THRE says the FIFO
+ *       has emptied.  Once uart_irq_init has wired IRQ 4, the THRE interrupt
+ *       (IER.ETBEI, armed only while tx_ring is non-empty) refills the FIFO,
+ *       so output costs the CPU one ring store per byte, not its wire time.
+ *       Before that (early boot) uart_putc waits for the ring to drain, as
+ *       the old polled driver did.  uart_puts adds '\r' before each '\n'.
  *
- *   RX: uart_getc busy-waits on LSR.DR (bit 0); uart_getc_nonblock polls it
- *       once.  Neither function holds a lock; safe only on single-core.
+ *   RX: the RX-data / RX-timeout interrupts (14-byte trigger, so a lone
+ *       keystroke still arrives via the FIFO timeout) empty the FIFO into
+ *       rx_ring; uart_getc / uart_getc_nonblock read the ring, or poll
+ *       LSR.DR directly until the IRQ is wired.
+ *
+ *   When tx_ring falls below a quarter full the interrupt handler kicks
+ *   the kernel log drain (kernel/klog.h) so queued printk output follows
+ *   without waiting for the next timer tick.
  *
  * DLAB sequence (required to set baud divisor):
  *   1. Write 0x80 to LCR to set DLAB=1 (enables DLL/DLH at offsets 0/1).
@@ -25,19 +32,21 @@
  *
  * Invariants:
  *   - uart_init() must be called once before any TX/RX operation.
+ *   - tx_ring, IER and THR writes are under uart_lock; rx_ring's producer
+ *     is the IRQ handler (also under uart_lock), consumers take uart_lock.
  *   - I/O-port access via outb/inb requires no memory barrier on x86 because
  *     the processor serialises I/O instructions.
- *
- * Known issues:
- *   None from the 04-drivers-irq finding list apply specifically to this file;
- *   the absence of a lock on TX/RX is a latent SMP issue not tracked
- *   separately.
  */
 #include <kernel/types.h>
 #include <kernel/arch.h>
 #include <arch/amd64_internal.h>
 #include <drivers/uart.h>
+#include <drivers/uart_ring.h>
 #include <kernel/io_poll.h>
+#include <kernel/irq.h>
+#include <kernel/klog.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
 
 /* COM1_PORT: I/O base address of the first serial port (COM1) on x86 PC. */
 #define COM1_PORT 0x3F8
@@ -50,7 +59,8 @@
 #define UART_THR 0 /* Transmit Holding Register */
 #define UART_RBR 0 /* Receive Buffer Register */
 #define UART_IER 1 /* Interrupt Enable Register */
-#define UART_FCR 2 /* FIFO Control Register */
+#define UART_IIR 2 /* Interrupt Identification Register (read) */
+#define UART_FCR 2 /* FIFO Control Register (write) */
 #define UART_LCR 3 /* Line Control Register */
 #define UART_MCR 4 /* Modem Control Register */
 #define UART_LSR 5 /* Line Status Register */
@@ -65,6 +75,33 @@
 #define LSR_DATA_READY  0x01
 #define LSR_THRE        0x20 /* Transmit Holding Register Empty */
 
+/* IER bits; IIR: bit 0 clear = interrupt pending, bits 3:1 = cause. */
+#define IER_ERBFI      0x01 /* RX data available / RX timeout */
+#define IER_ETBEI      0x02 /* THR (TX FIFO) empty */
+#define IIR_NONE       0x01
+#define IIR_ID_MASK    0x0E
+#define IIR_ID_MSR     0x00
+#define IIR_ID_THRE    0x02
+#define IIR_ID_RDA     0x04
+#define IIR_ID_RLS     0x06
+#define IIR_ID_TIMEOUT 0x0C
+#define UART_MSR       6
+
+/* FIFO depth of the 16550A: THRE means this many bytes may be written. */
+#define UART_FIFO_DEPTH 16
+
+/* COM1 is 8259 line 4; irq_register() keys on the IDT vector (32 + line),
+ * as for the PS/2 lines in ps2.c. */
+#define COM1_VECTOR (32 + 4)
+
+static char tx_storage[UART_TX_RING_SIZE];
+static char rx_storage[UART_RX_RING_SIZE];
+static struct uart_ring tx_ring = UART_RING_INIT(tx_storage);
+static struct uart_ring rx_ring = UART_RING_INIT(rx_storage);
+static DEFINE_SPINLOCK(uart_lock);
+/* Set by uart_irq_init once the THRE / RX interrupts are deliverable. */
+static int uart_irq_mode;
+
 /*
  * uart_init - initialise the 16550A UART at COM1 (0x3F8).
  *
@@ -75,7 +112,8 @@
  *   4. LCR = 0x03  — 8N1; clears DLAB so THR/RBR are accessible again.
  *   5. FCR = 0xC7  — enable FIFO, clear TX+RX FIFOs, 14-byte RX threshold.
  *   6. MCR = 0x0B  — DTR, RTS, OUT2 (required to enable IRQ delivery).
- *   7. IER = 0x01  — enable RX-data-available interrupt.
+ *   7. IER stays 0: interrupts are enabled by uart_irq_init() once the PIC
+ *      is up; until then TX and RX are polled.
  *
  * Locking: none; called once from boot CPU before SMP.
  * IRQ context: NO.
@@ -99,40 +137,131 @@ void uart_init(void) {
 
   /* IRQs enabled, RTS/DSR set */
   outb(COM1_PORT + UART_MCR, 0x0B);
+}
+
+/*
+ * tx_fill - move queued bytes into the TX FIFO, as many as it takes now.
+ *
+ * THRE is set only once the FIFO has fully drained, so a set THRE is room
+ * for UART_FIFO_DEPTH bytes and a clear one means "not now".
+ *
+ * Locking: uart_lock held.
+ */
+static void tx_fill(void) {
+  if (!(inb(COM1_PORT + UART_LSR) & LSR_THRE))
+    return;
+  char c;
+  for (int i = 0; i < UART_FIFO_DEPTH && uart_ring_get(&tx_ring, &c); i++)
+    outb(COM1_PORT + UART_THR, (uint8_t)c);
+}
+
+/* tx_set_irq - arm the THRE interrupt while bytes are queued, disarm it
+ * when the ring is empty (an armed THRE on an empty FIFO fires forever).
+ * Locking: uart_lock held. */
+static void tx_set_irq(void) {
+  uint8_t ier = IER_ERBFI;
+  if (uart_ring_count(&tx_ring))
+    ier |= IER_ETBEI;
+  outb(COM1_PORT + UART_IER, ier);
+}
+
+/* tx_make_room - poll the FIFO until tx_ring has space for n bytes; the
+ * polled path before the IRQ is wired, and the fallback when a writer
+ * outruns the wire.  A wedged UART loses the bytes instead of hanging
+ * printk (io_poll.h).  Locking: uart_lock held. */
+static void tx_make_room(uint32_t n) {
+  while (uart_ring_space(&tx_ring) < n) {
+    int ok;
+    poll_until(ok, inb(COM1_PORT + UART_LSR) & LSR_THRE, POLL_SPINS_DEFAULT);
+    char c;
+    if (ok)
+      tx_fill();
+    else
+      (void)uart_ring_get(&tx_ring, &c);
+  }
+}
 
-  /* Enable receive data available interrupt */
-  outb(COM1_PORT + UART_IER, 0x01);
+/* tx_push - queue c and start it moving.  Before uart_irq_init nothing
+ * would drain the ring later, so wait for it here.  Locking: uart_lock. */
+static void tx_push(char c) {
+  tx_make_room(1);
+  (void)uart_ring_put(&tx_ring, c);
+  tx_fill();
+  if (uart_irq_mode)
+    tx_set_irq();
+  else
+    tx_make_room(tx_ring.size);
 }
 
 /*
- * uart_putc - transmit one character (polled, no lock).
+ * uart_putc - transmit one character.
  *
  * @c: character to transmit.
  *
- * Busy-waits on LSR.THRE before writing to THR.  No CR+LF expansion here;
+ * Queues c in tx_ring and returns; waits only when the ring is full (or,
+ * before uart_irq_init, until it has drained).  No CR+LF expansion here;
  * uart_puts() performs expansion instead.
  *
- * Locking: none (unsafe on SMP).
- * IRQ context: technically safe on single-core QEMU; SMP-unsafe.
+ * Locking: uart_lock (irqsave).
+ * IRQ context: safe.
  */
 void uart_putc(char c) {
-  /* Bounded: an absent/wedged UART must not hang printk — after the budget, drop
-   * the byte instead of spinning forever (io_poll.h). */
-  spin_until(inb(COM1_PORT + UART_LSR) & LSR_THRE, POLL_SPINS_DEFAULT);
-  outb(COM1_PORT + UART_THR, (uint8_t)c);
+  uint64_t flags;
+  spin_lock_irqsave(&uart_lock, &flags);
+  tx_push(c);
+  spin_unlock_irqrestore(&uart_lock, flags);
+}
+
+/*
+ * uart_tx_write - queue up to n bytes without waiting (kernel log drain).
+ *
+ * Returns how many were taken: no more than tx_ring has room for.  Bytes
+ * go out verbatim, as with uart_putc.
+ */
+size_t uart_tx_write(const char *s, size_t n) {
+  uint64_t flags;
+  spin_lock_irqsave(&uart_lock, &flags);
+  size_t i = 0;
+  while (i < n && uart_ring_put(&tx_ring, s[i]))
+    i++;
+  tx_fill();
+  if (uart_irq_mode)
+    tx_set_irq();
+  spin_unlock_irqrestore(&uart_lock, flags);
+  return i;
+}
+
+/* uart_tx_kick - refill the FIFO from tx_ring if it has emptied; keeps
+ * output moving from the timer tick when the THRE interrupt is not wired. */
+void uart_tx_kick(void) {
+  uint64_t flags;
+  if (!spin_trylock_irqsave(&uart_lock, &flags))
+    return;
+  tx_fill();
+  spin_unlock_irqrestore(&uart_lock, flags);
 }
 
 /*
  * uart_putc_emergency - fault-context TX (kernel/fault.h).
  *
- * On the 16550 the normal path is already lock-free port I/O (no page-table
- * walk, no spinlock), so the emergency path is the same; CR is inserted for
- * newlines because fault_printf bypasses uart_puts' expansion.
+ * Never takes uart_lock: first pushes out whatever is still queued (so the
+ * panic text follows the output before it), then writes c by polling.  CR
+ * is inserted for newlines because fault_printf bypasses uart_puts'
+ * expansion.  Races with a live IRQ handler on another CPU are accepted.
  */
+static void emergency_tx(char c) {
+  spin_until(inb(COM1_PORT + UART_LSR) & LSR_THRE, POLL_SPINS_DEFAULT);
+  outb(COM1_PORT + UART_THR, (uint8_t)c);
+}
+
 void uart_putc_emergency(char c) {
+  char q;
+  outb(COM1_PORT + UART_IER, 0);
+  while (uart_ring_get(&tx_ring, &q))
+    emergency_tx(q);
   if (c == '\n')
-    uart_putc('\r');
-  uart_putc(c);
+    emergency_tx('\r');
+  emergency_tx(c);
 }
 
 /*
@@ -141,55 +270,129 @@ void uart_putc_emergency(char c) {
  * @s: NUL-terminated string to transmit.
  *
  * Inserts '\r' before every '\n' so terminal emulators display correct line
- * breaks.  Each character is sent via uart_putc (polled).
+ * breaks.  One uart_lock hold for the whole string.
  *
- * Locking: none (inherits no-lock from uart_putc).
+ * Locking: uart_lock (irqsave).
  * IRQ context: same as uart_putc.
  */
 void uart_puts(const char *s) {
+  uint64_t flags;
+  spin_lock_irqsave(&uart_lock, &flags);
   while (*s) {
     if (*s == '\n')
-      uart_putc('\r');
-    uart_putc(*s++);
+      tx_push('\r');
+    tx_push(*s++);
+  }
+  spin_unlock_irqrestore(&uart_lock, flags);
+}
+
+/*
+ * uart_irq_handler - COM1 interrupt (vector 36): RX data / timeout, THRE.
+ *
+ * Loops on IIR until no cause is pending (bounded, in case a cause refuses
+ * to clear).  Reading IIR acknowledges THRE; reading RBR / LSR / MSR
+ * acknowledges the others.  Wakes keyboard_wait_queue on input and kicks
+ * the kernel log drain when tx_ring is running low — after dropping
+ * uart_lock, since the drain comes back through uart_tx_write.
+ *
+ * IRQ context: YES.
+ */
+static void uart_irq_handler(uint32_t irq, void *data) {
+  (void)irq;
+  (void)data;
+  int got_rx = 0, low = 0;
+
+  spin_lock(&uart_lock);
+  for (int n = 0; n < 16; n++) {
+    uint8_t iir = inb(COM1_PORT + UART_IIR);
+    if (iir & IIR_NONE)
+      break;
+    switch (iir & IIR_ID_MASK) {
+    case IIR_ID_RDA:
+    case IIR_ID_TIMEOUT:
+      while (inb(COM1_PORT + UART_LSR) & LSR_DATA_READY) {
+        char c = (char)inb(COM1_PORT + UART_RBR);
+        (void)uart_ring_put(&rx_ring, c); /* full: drop newest */
+        got_rx = 1;
+      }
+      break;
+    case IIR_ID_THRE:
+      tx_fill();
+      tx_set_irq();
+      low = uart_ring_count(&tx_ring) < tx_ring.size / 4;
+      break;
+    case IIR_ID_RLS:
+      (void)inb(COM1_PORT + UART_LSR);
+      break;
+    default:
+      (void)inb(COM1_PORT + UART_MSR);
+      break;
+    }
   }
+  spin_unlock(&uart_lock);
+
+  if (got_rx) {
+    extern struct wait_queue_head keyboard_wait_queue;
+    wake_up(&keyboard_wait_queue);
+  }
+  if (low)
+    klog_kick();
+}
+
+/*
+ * uart_irq_init - switch COM1 to interrupt-driven RX and TX.
+ *
+ * Called once the PIC is up (driver_console_irq_init): registers vector 36
+ * and enables the RX interrupt; THRE is armed on demand by tx_set_irq.
+ */
+void uart_irq_init(void) {
+  if (irq_register(COM1_VECTOR, uart_irq_handler, NULL) != 0)
+    return;
+  uint64_t flags;
+  spin_lock_irqsave(&uart_lock, &flags);
+  uart_irq_mode = 1;
+  tx_set_irq();
+  spin_unlock_irqrestore(&uart_lock, flags);
 }
 
 /*
- * uart_getc - receive one character (blocking, polled).
+ * uart_getc - receive one character (blocking).
  *
- * Busy-waits on LSR.DR (bit 0) calling arch_idle() (HLT on x86) between
- * polls; reads and returns one byte from RBR once available.
+ * Takes the next byte from rx_ring, sleeping in arch_idle() (HLT) until
+ * the RX interrupt delivers one; before uart_irq_init, polls LSR.DR.
  *
  * Returns: received character.
  *
- * Locking: none.
  * IRQ context: NO — calls arch_idle() (HLT); must not be called from an
  *              IRQ handler.
  */
 char uart_getc(void) {
-  /* Wait for data to be ready */
-  while ((inb(COM1_PORT + UART_LSR) & LSR_DATA_READY) == 0) {
+  int c;
+  while ((c = uart_getc_nonblock()) < 0)
     arch_idle();
-  }
-  return (char)inb(COM1_PORT + UART_RBR);
+  return (char)c;
 }
 
 /*
  * uart_getc_nonblock - receive one character without blocking.
  *
- * Checks LSR.DR once; if set reads and returns the byte from RBR, else
- * returns -1.
- *
  * Returns: received character cast to int, or -1 if no data available.
  *
- * Locking: none.
+ * Locking: uart_lock (irqsave) around the ring.
  * IRQ context: safe (no sleeping).
  */
 int uart_getc_nonblock(void) {
-  if (inb(COM1_PORT + UART_LSR) & LSR_DATA_READY) {
-    return (int)inb(COM1_PORT + UART_RBR);
+  if (!uart_irq_mode) {
+    if (inb(COM1_PORT + UART_LSR) & LSR_DATA_READY)
+      return (int)inb(COM1_PORT + UART_RBR);
+    return -1;
   }
-  return -1;
+  uint64_t flags;
+  char c;
+  spin_lock_irqsave(&uart_lock, &flags);
+  int ok = uart_ring_get(&rx_ring, &c);
+  spin_unlock_irqrestore(&uart_lock, flags);
+  return ok ? (int)(unsigned char)c : -1;
 }
 
 /*
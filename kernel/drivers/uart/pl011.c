@@ -3,45 +3,54 @@
  * PL011 UART Driver — ARM QEMU virt machine (aarch64)
  *
  * Drives the ARM PrimeCell UART (PL011) at PLATFORM_UART_BASE (typically
- * 0x09000000 on the QEMU virt board).  Provides both polled TX output and
- * interrupt-driven RX into a 128-byte software ring buffer.
+ * 0x09000000 on the QEMU virt board), with its hardware FIFOs enabled and
+ * software rings behind them (drivers/uart_ring.h) in both directions.
  *
  * Architecture:
- *   TX: uart_putc / uart_puts acquire uart_lock (spinlock + IRQ save) and
- *       busy-wait on UART_FR.TXFF before writing to UART_DR.  Newlines are
- *       expanded to CR+LF by _uart_putc_unlocked.
+ *   TX: writers queue bytes in tx_ring under uart_lock and return; tx_fill
+ *       moves them into UART_DR until UART_FR.TXFF.  Once uart_irq_init has
+ *       unmasked the interrupt, the TX interrupt (raised when the FIFO
+ *       drains to the IFLS watermark, 1/4 full; unmasked only while tx_ring
+ *       is non-empty) refills it, so output costs the CPU one ring store per
+ *       byte rather than its wire time.  Before that (early boot) uart_putc
+ *       waits for the ring to drain, as the polled driver did.  Newlines are
+ *       queued as '\n' + '\r'.
  *
  *   RX: uart_irq_handler (IRQ context) is registered for PLATFORM_IRQ_UART0
- *       (typically GIC IRQ 33 on QEMU virt).  On each RX interrupt the FIFO
- *       is drained into rx_buf[] via a head pointer and the process wait queue
- *       is woken.  Consumers read via uart_getc (blocking) or
+ *       (typically GIC IRQ 33 on QEMU virt).  The RX interrupt (FIFO half
+ *       full) and the RX timeout interrupt (a few idle bit times with data
+ *       below the watermark) drain the FIFO into rx_ring and wake the
+ *       keyboard wait queue.  Consumers read via uart_getc (blocking) or
  *       uart_getc_nonblock (polling).
  *
+ *   When tx_ring falls below a quarter full the interrupt handler kicks
+ *   the kernel log drain (kernel/klog.h) so queued printk output follows
+ *   without waiting for the next timer tick.
+ *
  * Baud rate: 115200 at assumed 24 MHz UART reference clock.
  *   IBRD = 13, FBRD = 1  (13.020... -> close to 13.020833 for 115200).
  *
  * Invariants:
  *   - uart_init() must be called before any TX or RX operation.
  *   - UART_CR must be cleared (UART disabled) before changing IBRD/FBRD/LCR_H.
- *   - All TX paths hold uart_lock; _uart_putc_unlocked is called only while
- *     uart_lock is held.
+ *   - tx_ring, rx_ring, IMSC and UART_DR writes are under uart_lock, except
+ *     uart_putc_emergency (fault context, lock-free by design).
  *
  * Known issues:
- *   DRV-UART-01  (W3 BUG/SECURITY) uart_getc and uart_getc_nonblock read
- *                rx_tail without a lock; uart_irq_handler writes rx_buf[] and
- *                rx_head without a lock.  On SMP the aarch64 weak memory model
- *                requires at minimum a dmb/stlr to order the rx_buf store
- *                before the rx_head store and to order the rx_head load before
- *                the rx_buf load on the consumer side.  Two concurrent readers
- *                also corrupt rx_tail.
+ *   DRV-UART-01  RESOLVED: the RX ring indices are no longer touched
+ *                without a lock; producer (IRQ) and consumers both hold
+ *                uart_lock.
  */
 #include <drivers/uart.h>
+#include <drivers/uart_ring.h>
 #include <kernel/arch.h>
 #include <kernel/io_poll.h>
 #include <kernel/irq.h>
+#include <kernel/klog.h>
 #include <kernel/memlayout.h>
 #include <kernel/platform.h>
 #include <kernel/sched.h>
+#include <kernel/spinlock.h>
 #include <kernel/types.h>
 #include <stdint.h>
 
@@ -52,77 +61,31 @@
 /* MMIO access macros */
 #define UART_REG(offset) (*(volatile uint32_t *)phys_to_virt(PLATFORM_UART_BASE + (offset)))
 
-/* rx_buf[]: circular ring buffer for characters received via IRQ.
- * rx_head: write index, advanced by uart_irq_handler (IRQ context).
- * rx_tail: read index, advanced by uart_getc / uart_getc_nonblock (any ctx).
- * Buffer is full when (rx_head + 1) % RX_BUF_SIZE == rx_tail.
- * NOTE(DRV-UART-01): both indices are volatile but not protected by a lock;
- * this is unsafe on SMP (see file header). */
-/* Ring Buffer */
-#define RX_BUF_SIZE 128
-static char rx_buf[RX_BUF_SIZE];
-static volatile int rx_head = 0;
-static volatile int rx_tail = 0;
-
-/* UART_IMSC_RXIM: Receive Interrupt Mask bit in UART_IMSC (offset 0x038).
- *   Bit 4 = RXIM: assert interrupt when RX FIFO reaches trigger level.
- * UART_ICR_RXIC: Receive interrupt clear bit in UART_ICR (offset 0x044).
- *   Writing bit 4 clears the masked RX interrupt in UART_MIS. */
-/* Interrupt bits */
+/* Interrupt bits, shared by UART_IMSC (mask), UART_MIS (masked status) and
+ * UART_ICR (clear):
+ *   RXIM (4): RX FIFO at or above its watermark.
+ *   TXIM (5): TX FIFO at or below its watermark.
+ *   RTIM (6): RX timeout — data below the watermark sat idle. */
 #define UART_IMSC_RXIM BIT(4)
-#define UART_ICR_RXIC BIT(4)
-
-/*
- * uart_irq_handler - PL011 RX interrupt service routine.
- *
- * @irq:  IRQ number (ignored; registered for PLATFORM_IRQ_UART0 only).
- * @data: opaque data (unused; registered as NULL).
- *
- * Called from irq_handler() when the GIC delivers PLATFORM_IRQ_UART0.
- * Checks UART_MIS (masked interrupt status, offset 0x040) for the RX bit;
- * drains the RX FIFO into rx_buf[] until UART_FR.RXFE (FIFO empty, bit 4)
- * is set or the ring buffer is full; clears the interrupt via UART_ICR;
- * wakes up keyboard_wait_queue.
- *
- * MMIO registers touched:
- *   UART_MIS  (0x040) read  — masked interrupt status.
- *   UART_FR   (0x018) read  — flags: RXFE = bit 4.
- *   UART_DR   (0x000) read  — data register; reading drains one byte from FIFO.
- *   UART_ICR  (0x044) write — interrupt clear register; write 1 to clear.
- *
- * Locking: none (see NOTE DRV-UART-01).  Called from IRQ context; must not
- *          sleep or acquire a sleeping lock.
- * IRQ context: YES — this is an IRQ handler registered with irq_register().
- *
- * NOTE(DRV-UART-01): rx_head and rx_buf[] are written here without a lock.
- * On SMP, concurrent readers of rx_tail (uart_getc / uart_getc_nonblock) and
- * a concurrent second IRQ handler invocation (if IRQ nesting were enabled)
- * would produce a data race.
- */
-static void uart_irq_handler(uint32_t irq, void *data) {
-  (void)irq;
-  (void)data;
+#define UART_IMSC_TXIM BIT(5)
+#define UART_IMSC_RTIM BIT(6)
 
-  /* Check masked status */
-  if (UART_REG(UART_MIS) & UART_IMSC_RXIM) {
-    /* Read until FIFO empty or buffer full */
-    while (!(UART_REG(UART_FR) & UART_FR_RXFE)) {
-      char c = (char)(UART_REG(UART_DR) & 0xFF);
+/* UART_IFLS watermarks: TXIFLSEL bits 2:0, RXIFLSEL bits 5:3
+ * (0 = 1/8, 1 = 1/4, 2 = 1/2, 3 = 3/4, 4 = 7/8 of the FIFO). */
+#define UART_IFLS_TX_1_4 (1 << 0)
+#define UART_IFLS_RX_1_2 (2 << 3)
 
-      int next = (rx_head + 1) % RX_BUF_SIZE;
-      if (next != rx_tail) {
-        rx_buf[rx_head] = c;
-        rx_head = next;
-      }
-    }
-    /* Clear interrupt */
-    UART_REG(UART_ICR) = UART_ICR_RXIC;
+static char tx_storage[UART_TX_RING_SIZE];
+static char rx_storage[UART_RX_RING_SIZE];
+static struct uart_ring tx_ring = UART_RING_INIT(tx_storage);
+static struct uart_ring rx_ring = UART_RING_INIT(rx_storage);
 
-    /* Wake up waiting processes */
-    extern struct wait_queue_head keyboard_wait_queue;
-    wake_up(&keyboard_wait_queue);
-  }
-}
+/* uart_lock: spinlock protecting both rings, IMSC and the TX path (UART_DR
+ * writes).  Held with IRQ save/restore so that a printk from an IRQ handler
+ * does not deadlock against output already in progress on the same CPU. */
+DEFINE_SPINLOCK(uart_lock);
+/* Set by uart_irq_init once the PL011 interrupt is deliverable. */
+static int uart_irq_mode;
 
 /*
  * uart_init - configure and enable the PL011 UART.
@@ -134,9 +97,9 @@ static void uart_irq_handler(uint32_t irq, void *data) {
  *   3. Program baud rate: IBRD=13, FBRD=1 for ~115200 at 24 MHz clock.
  *        Baud = clock / (16 * (IBRD + FBRD/64)) = 24e6 / (16*13.015625) ≈ 115273.
  *   4. Set LCR_H: 8 data bits (WLEN=11b), FIFO enable (FEN=1).
- *   5. Set IMSC: enable RX interrupt (RXIM=1); TX interrupt stays masked.
- *   6. Register uart_irq_handler for PLATFORM_IRQ_UART0 via irq_register().
- *   7. Enable UART, TX, RX via UART_CR (UARTEN=1, TXE=1, RXE=1).
+ *   5. Set IFLS watermarks: TX interrupt at <= 1/4 full, RX at >= 1/2.
+ *      IMSC stays 0: uart_irq_init() unmasks once the GIC is up.
+ *   6. Enable UART, TX, RX via UART_CR (UARTEN=1, TXE=1, RXE=1).
  *
  * MMIO registers written:
  *   UART_CR    (0x030): control register.
@@ -144,6 +107,7 @@ static void uart_irq_handler(uint32_t irq, void *data) {
  *   UART_IBRD  (0x024): integer baud-rate divisor.
  *   UART_FBRD  (0x028): fractional baud-rate divisor.
  *   UART_LCR_H (0x02C): line control register.
+ *   UART_IFLS  (0x034): interrupt FIFO level select register.
  *   UART_IMSC  (0x038): interrupt mask set/clear register.
  *
  * Locking: none; called once from boot CPU before SMP.
@@ -167,68 +131,123 @@ void uart_init(void) {
   /* 8N1, enable FIFOs */
   UART_REG(UART_LCR_H) = UART_LCR_H_WLEN_8 | UART_LCR_H_FEN;
 
-  /* Enable Interrupts (RX) */
-  UART_REG(UART_IMSC) = UART_IMSC_RXIM;
-
-  /* Register IRQ */
-  irq_register(PLATFORM_IRQ_UART0, uart_irq_handler, NULL);
+  /* FIFO watermarks; interrupts stay masked until uart_irq_init */
+  UART_REG(UART_IFLS) = UART_IFLS_TX_1_4 | UART_IFLS_RX_1_2;
+  UART_REG(UART_IMSC) = 0;
 
   /* Enable UART, TX and RX */
   UART_REG(UART_CR) = UART_CR_UARTEN | UART_CR_TXE | UART_CR_RXE;
 }
 
-/* uart_lock: spinlock protecting the TX path (UART_DR writes).
- * Held with IRQ save/restore so that a printk from an IRQ handler does not
- * deadlock against a printk already in progress on the same CPU. */
-DEFINE_SPINLOCK(uart_lock);
-
 /*
- * _uart_putc_unlocked - transmit one character; caller must hold uart_lock.
- *
- * @c: character to send.
- *
- * Busy-waits on UART_FR.TXFF (TX FIFO full, bit 5) before writing to
- * UART_DR (offset 0x000).  Expands '\n' to '\n'+'\r' for terminal emulators.
+ * tx_fill - move queued bytes into the TX FIFO until it is full.
  *
  * MMIO registers touched:
  *   UART_FR (0x018) read  — flags; TXFF = bit 5.
  *   UART_DR (0x000) write — data register; writes one byte to TX FIFO.
  *
- * Locking: caller MUST hold uart_lock.
- * IRQ context: safe (called under uart_lock with IRQs saved).
+ * Locking: uart_lock held.
  */
-static void _uart_putc_unlocked(char c) {
-  /* Bounded: an absent/wedged UART must not hang printk — after the budget, drop
-   * the byte instead of spinning forever (io_poll.h). */
-  spin_until(!(UART_REG(UART_FR) & UART_FR_TXFF), POLL_SPINS_DEFAULT);
+static void tx_fill(void) {
+  char c;
+  while (!(UART_REG(UART_FR) & UART_FR_TXFF) && uart_ring_get(&tx_ring, &c))
+    UART_REG(UART_DR) = (uint32_t)(uint8_t)c;
+}
 
-  UART_REG(UART_DR) = c;
+/* tx_set_irq - unmask the TX interrupt while bytes are queued, mask it when
+ * the ring is empty.  RX and RX-timeout stay unmasked.  uart_lock held. */
+static void tx_set_irq(void) {
+  uint32_t imsc = UART_IMSC_RXIM | UART_IMSC_RTIM;
+  if (uart_ring_count(&tx_ring))
+    imsc |= UART_IMSC_TXIM;
+  UART_REG(UART_IMSC) = imsc;
+}
 
-  /* Add carriage return for newline */
-  if (c == '\n') {
-    spin_until(!(UART_REG(UART_FR) & UART_FR_TXFF), POLL_SPINS_DEFAULT);
-    UART_REG(UART_DR) = '\r';
+/* tx_make_room - poll the FIFO until tx_ring has space for n bytes; the
+ * polled path before the IRQ is wired, and the fallback when a writer
+ * outruns the wire.  A wedged UART loses the bytes instead of hanging
+ * printk (io_poll.h).  uart_lock held. */
+static void tx_make_room(uint32_t n) {
+  while (uart_ring_space(&tx_ring) < n) {
+    int ok;
+    poll_until(ok, !(UART_REG(UART_FR) & UART_FR_TXFF), POLL_SPINS_DEFAULT);
+    char c;
+    if (ok)
+      tx_fill();
+    else
+      (void)uart_ring_get(&tx_ring, &c);
   }
 }
 
+/* tx_start - after queueing: fill the FIFO, then either leave the rest to
+ * the TX interrupt or, before uart_irq_init, wait for it.  uart_lock held. */
+static void tx_start(void) {
+  tx_fill();
+  if (uart_irq_mode)
+    tx_set_irq();
+  else
+    tx_make_room(tx_ring.size);
+}
+
+/* tx_queue - queue c, plus the '\r' a terminal needs after '\n'. */
+static void tx_queue(char c) {
+  tx_make_room(2);
+  (void)uart_ring_put(&tx_ring, c);
+  if (c == '\n')
+    (void)uart_ring_put(&tx_ring, '\r');
+}
+
 /*
- * uart_putc - transmit one character (lock-protected).
+ * uart_putc - transmit one character.
  *
  * @c: character to transmit.
  *
- * Acquires uart_lock with IRQ save, delegates to _uart_putc_unlocked, then
- * releases the lock.  Safe to call from any context including IRQ handlers.
+ * Queues c in tx_ring and returns; waits only when the ring is full (or,
+ * before uart_irq_init, until it has drained).  Safe to call from any
+ * context including IRQ handlers.
  *
  * Locking: acquires uart_lock (spinlock + IRQ save/restore).
  * IRQ context: safe.
  */
+void uart_putc(char c) {
+  uint64_t flags;
+  spin_lock_irqsave(&uart_lock, &flags);
+  tx_queue(c);
+  tx_start();
+  spin_unlock_irqrestore(&uart_lock, flags);
+}
+
 /*
- * Send a character
+ * uart_tx_write - queue up to n bytes without waiting (kernel log drain).
+ *
+ * Returns how many were taken: no more than tx_ring has room for, counting
+ * the '\r' each '\n' brings along.
  */
-void uart_putc(char c) {
+size_t uart_tx_write(const char *s, size_t n) {
   uint64_t flags;
   spin_lock_irqsave(&uart_lock, &flags);
-  _uart_putc_unlocked(c);
+  size_t i = 0;
+  for (; i < n; i++) {
+    if (uart_ring_space(&tx_ring) < (s[i] == '\n' ? 2u : 1u))
+      break;
+    (void)uart_ring_put(&tx_ring, s[i]);
+    if (s[i] == '\n')
+      (void)uart_ring_put(&tx_ring, '\r');
+  }
+  tx_fill();
+  if (uart_irq_mode)
+    tx_set_irq();
+  spin_unlock_irqrestore(&uart_lock, flags);
+  return i;
+}
+
+/* uart_tx_kick - top up the FIFO from tx_ring; keeps output moving from the
+ * timer tick when the TX interrupt is not wired. */
+void uart_tx_kick(void) {
+  uint64_t flags;
+  if (!spin_trylock_irqsave(&uart_lock, &flags))
+    return;
+  tx_fill();
   spin_unlock_irqrestore(&uart_lock, flags);
 }
 
@@ -236,61 +255,132 @@ void uart_putc(char c) {
  * uart_putc_emergency - lock-free TX for fault context (kernel/fault.h).
  *
  * Bypasses uart_lock by design: a fault handler must never block on a lock
- * that another (possibly wedged) CPU holds.  Interleaving with concurrent
+ * that another (possibly wedged) CPU holds.  Masks the UART interrupts,
+ * pushes out whatever tx_ring still holds so the panic text follows the
+ * output before it, then sends c by polling.  Interleaving with concurrent
  * normal output is the accepted trade for guaranteed progress.
  */
-void uart_putc_emergency(char c) { _uart_putc_unlocked(c); }
+static void emergency_tx(char c) {
+  spin_until(!(UART_REG(UART_FR) & UART_FR_TXFF), POLL_SPINS_DEFAULT);
+  UART_REG(UART_DR) = (uint32_t)(uint8_t)c;
+}
+
+void uart_putc_emergency(char c) {
+  char q;
+  UART_REG(UART_IMSC) = 0;
+  while (uart_ring_get(&tx_ring, &q))
+    emergency_tx(q);
+  emergency_tx(c);
+  if (c == '\n')
+    emergency_tx('\r');
+}
 
 /*
- * uart_getc - receive one character (blocking).
+ * uart_irq_handler - PL011 interrupt service routine.
  *
- * Spins calling arch_idle() (WFI) until rx_head != rx_tail, then reads one
- * byte from rx_buf[] and advances rx_tail.
+ * @irq:  IRQ number (ignored; registered for PLATFORM_IRQ_UART0 only).
+ * @data: opaque data (unused; registered as NULL).
  *
- * Returns: the received character.
+ * RX / RX timeout: drain the RX FIFO into rx_ring until UART_FR.RXFE
+ * (bytes arriving with the ring full are dropped) and wake
+ * keyboard_wait_queue.  TX: refill the FIFO from tx_ring, and mask the TX
+ * interrupt once the ring is empty.  Kicks the kernel log drain when
+ * tx_ring runs low — after dropping uart_lock, since the drain comes back
+ * through uart_tx_write.
  *
- * Locking: none (see NOTE DRV-UART-01); rx_tail modified without a lock.
- * IRQ context: NO — may sleep (WFI); must not be called from IRQ context.
+ * MMIO registers touched:
+ *   UART_MIS  (0x040) read  — masked interrupt status.
+ *   UART_FR   (0x018) read  — flags: RXFE = bit 4, TXFF = bit 5.
+ *   UART_DR   (0x000) r/w   — RX / TX FIFO.
+ *   UART_ICR  (0x044) write — interrupt clear register; write 1 to clear.
+ *   UART_IMSC (0x038) write — TX interrupt mask.
  *
- * NOTE(DRV-UART-01): rx_tail is read and written without a lock; a concurrent
- * uart_getc() on another CPU would corrupt rx_tail.
+ * IRQ context: YES — this is an IRQ handler registered with irq_register().
  */
+static void uart_irq_handler(uint32_t irq, void *data) {
+  (void)irq;
+  (void)data;
+  int got_rx = 0, low = 0;
+
+  spin_lock(&uart_lock);
+  uint32_t mis = UART_REG(UART_MIS);
+  if (mis & (UART_IMSC_RXIM | UART_IMSC_RTIM)) {
+    while (!(UART_REG(UART_FR) & UART_FR_RXFE)) {
+      (void)uart_ring_put(&rx_ring, (char)(UART_REG(UART_DR) & 0xFF));
+      got_rx = 1;
+    }
+    UART_REG(UART_ICR) = UART_IMSC_RXIM | UART_IMSC_RTIM;
+  }
+  if (mis & UART_IMSC_TXIM) {
+    tx_fill();
+    UART_REG(UART_ICR) = UART_IMSC_TXIM;
+    tx_set_irq();
+    low = uart_ring_count(&tx_ring) < tx_ring.size / 4;
+  }
+  spin_unlock(&uart_lock);
+
+  if (got_rx) {
+    extern struct wait_queue_head keyboard_wait_queue;
+    wake_up(&keyboard_wait_queue);
+  }
+  if (low)
+    klog_kick();
+}
+
 /*
- * Receive a character (blocking)
+ * uart_irq_init - switch the PL011 to interrupt-driven RX and TX.
+ *
+ * Called once the GIC is up (driver_console_irq_init): registers
+ * uart_irq_handler for PLATFORM_IRQ_UART0 and unmasks RX / RX timeout; the
+ * TX interrupt is unmasked on demand by tx_set_irq.
+ */
+void uart_irq_init(void) {
+  if (irq_register(PLATFORM_IRQ_UART0, uart_irq_handler, NULL) != 0)
+    return;
+  uint64_t flags;
+  spin_lock_irqsave(&uart_lock, &flags);
+  uart_irq_mode = 1;
+  tx_set_irq();
+  spin_unlock_irqrestore(&uart_lock, flags);
+}
+
+/*
+ * uart_getc - receive one character (blocking).
+ *
+ * Spins calling arch_idle() (WFI) until a byte is available.
+ *
+ * Returns: the received character.
+ *
+ * IRQ context: NO — may sleep (WFI); must not be called from IRQ context.
  */
 char uart_getc(void) {
-  /* Wait for data in buffer */
-  while (rx_head == rx_tail) {
-    /* Wait for interrupt (wfi/idle) to save power */
+  int c;
+  while ((c = uart_getc_nonblock()) < 0)
     arch_idle();
-  }
-
-  char c = rx_buf[rx_tail];
-  rx_tail = (rx_tail + 1) % RX_BUF_SIZE;
-  return c;
+  return (char)c;
 }
 
 /*
  * uart_getc_nonblock - receive one character without blocking.
  *
- * Returns the next character from the RX ring buffer, or -1 if the buffer
- * is empty (rx_head == rx_tail).
+ * Returns the next character from rx_ring — or, before uart_irq_init,
+ * straight from the RX FIFO — or -1 if there is none.
  *
- * Locking: none (see NOTE DRV-UART-01).
- * IRQ context: technically callable from IRQ context but unsafe on SMP due
- *              to unprotected rx_tail access (DRV-UART-01).
- */
-/*
- * Receive a character (non-blocking)
- * Returns -1 if no character available
+ * Locking: uart_lock (irqsave) around the ring.
+ * IRQ context: safe.
  */
 int uart_getc_nonblock(void) {
-  if (rx_head == rx_tail)
-    return -1;
-
-  char c = rx_buf[rx_tail];
-  rx_tail = (rx_tail + 1) % RX_BUF_SIZE;
-  return (int)c;
+  if (!uart_irq_mode) {
+    if (UART_REG(UART_FR) & UART_FR_RXFE)
+      return -1;
+    return (int)(UART_REG(UART_DR) & 0xFF);
+  }
+  uint64_t flags;
+  char c;
+  spin_lock_irqsave(&uart_lock, &flags);
+  int ok = uart_ring_get(&rx_ring, &c);
+  spin_unlock_irqrestore(&uart_lock, flags);
+  return ok ? (int)(unsigned char)c : -1;
 }
 
 /*
@@ -298,21 +388,18 @@ int uart_getc_nonblock(void) {
  *
  * @s: NUL-terminated string to transmit.
  *
- * Acquires uart_lock once for the entire string, calling
- * _uart_putc_unlocked() per character.  More efficient than repeated
- * uart_putc() calls for multi-character output.
+ * Acquires uart_lock once for the entire string and queues it all (with
+ * the '\n' -> "\n\r" expansion) before starting transmission.
  *
  * Locking: acquires uart_lock (spinlock + IRQ save/restore).
  * IRQ context: safe.
  */
-/*
- * Send a string
- */
 void uart_puts(const char *s) {
   uint64_t flags;
   spin_lock_irqsave(&uart_lock, &flags);
   while (*s)
-    _uart_putc_unlocked(*s++);
+    tx_queue(*s++);
+  tx_start();
   spin_unlock_irqrestore(&uart_lock, flags);
 }
 
@@ -30,7 +30,7 @@ static struct vring_used *used;
  * failed status=1" / "W_ReadLump: only read 0 of N" in the boot traces).
  * irqsave also keeps a timer-tick preemption from interleaving a second
  * request from the SAME CPU into a half-built ring. */
-static DEFINE_SPINLOCK(virtio_blk_lock);
+static DEFINE_QSPINLOCK(virtio_blk_lock);
 
 /* DMA targets for the request header and status byte (DRV-VIRTIO-03): these
  * used to live on the caller's STACK while the device DMA-wrote into them.
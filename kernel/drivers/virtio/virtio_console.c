@@ -0,0 +1,343 @@
+/*
+ * kernel/drivers/virtio/virtio_console.c
+ * VirtIO Console Driver (virtio-serial): console port + kernel log port
+ *
+ * Queues (see drivers/virtio_console.h): vcon_q[] holds port 0's receive /
+ * transmit pair, then with multiport the control pair and port 1's pair.
+ * Every queue owns a fixed buffer per descriptor (one descriptor per
+ * buffer, descriptor i <-> slot i), so a completion only has to give its
+ * id back:
+ *   - RX queues (console input, control messages) keep all slots posted
+ *     and re-post each one as the IRQ handler consumes it.  Nothing in the
+ *     kernel reads console input, so the handler drops it: the queue only
+ *     has to stay posted for the host's writes to complete.
+ *   - TX queues track free slots in a bitmap.  Writers reclaim the used
+ *     ring, fill free slots and kick once; TX interrupts are suppressed
+ *     (VRING_AVAIL_F_NO_INTERRUPT) because nobody waits for them — the next
+ *     write or klog tick reclaims.  The kick itself is skipped while the
+ *     device says it is already processing (VRING_USED_F_NO_NOTIFY).
+ *
+ * Ports come up through the control queue: DEVICE_READY, then the host
+ * announces each port (PORT_ADD) and we answer PORT_READY and PORT_OPEN for
+ * ports 0 and 1 (refusing others).  Kernel IRQs are still off during init,
+ * so that first exchange is polled; later control traffic (hot-unplug of
+ * the log port) is handled in the IRQ handler.
+ *
+ * Locking: vcon_lock (irqsave) covers all queues and the RX ring.  klog
+ * calls virtio_console_write under klog_drain_lock, which therefore nests
+ * outside vcon_lock.
+ */
+#include <drivers/virtio.h>
+#include <drivers/virtio_console.h>
+#include <kernel/arch.h>
+#include <kernel/io_poll.h>
+#include <kernel/irq.h>
+#include <kernel/pmm.h>
+#include <kernel/printk.h>
+#include <kernel/spinlock.h>
+#include <kernel/string.h>
+#include <kernel/vmm.h>
+
+#define VCON_QSIZE 32     /* descriptors per queue (free bitmap is 32 bits) */
+#define VCON_TX_SLOT 512  /* bytes per TX buffer: 32 x 512 = 4 pages */
+#define VCON_RX_SLOT 64   /* console input / control message buffer */
+#define VCON_BUF_PAGES 4
+#define VCON_PORT_CONSOLE 0 /* port 0, also the log's fallback */
+
+/* vcon_q[] indices, equal to the virtqueue numbers of the multiport layout
+ * (port 1 = queues 2 * 1 + 2 and + 3). */
+enum { Q_CON_RX, Q_CON_TX, Q_CTRL_RX, Q_CTRL_TX, Q_LOG_RX, Q_LOG_TX, Q_NR };
+
+struct vcon_queue {
+  uint16_t idx; /* virtqueue number */
+  uint16_t qsize;
+  struct vring_desc *desc;
+  struct vring_avail *avail;
+  struct vring_used *used;
+  uint16_t last_used;
+  uint32_t free; /* TX: bitmap of slots not owned by the device */
+  char *bufs;    /* qsize slots of `slot` bytes */
+  uint32_t slot;
+};
+
+static virtio_handle_t vcon_dev;
+static uint32_t vcon_irq;
+static int vcon_up;
+static int vcon_multiport;
+static int vcon_log_up; /* port 1 added and opened */
+static struct vcon_queue vcon_q[Q_NR];
+static DEFINE_SPINLOCK(vcon_lock);
+
+static void virtio_console_handler(uint32_t irq, void *data);
+
+static uint16_t vcon_used_idx(const struct vcon_queue *q) {
+  return *(volatile uint16_t *)&q->used->idx;
+}
+
+/* vcon_queue_setup - size, allocate and register queue i; RX queues get
+ * every slot posted, TX queues start with every slot free. */
+static int vcon_queue_setup(int i, uint32_t slot, int rx) {
+  struct vcon_queue *q = &vcon_q[i];
+  q->idx = (uint16_t)i;
+  virtio_write_reg(vcon_dev, VIRTIO_MMIO_QUEUE_SEL, q->idx);
+  uint32_t qmax = virtio_read_reg(vcon_dev, VIRTIO_MMIO_QUEUE_NUM_MAX) & 0xFFFF;
+  if (qmax == 0)
+    return -ENODEV;
+  q->qsize = (uint16_t)(qmax > VCON_QSIZE ? VCON_QSIZE : qmax);
+  virtio_write_reg(vcon_dev, VIRTIO_MMIO_QUEUE_NUM, q->qsize);
+
+  void *qmem = pmm_alloc_pages(2);
+  if (!qmem)
+    return -ENOMEM;
+  q->bufs = pmm_alloc_pages(VCON_BUF_PAGES);
+  if (!q->bufs) {
+    pmm_free_pages(qmem, 2);
+    return -ENOMEM;
+  }
+  memset(qmem, 0, 8192);
+  q->desc = (struct vring_desc *)qmem;
+  q->avail = (struct vring_avail *)((uint8_t *)qmem + q->qsize * 16);
+  q->used = (struct vring_used *)((uint8_t *)qmem + 4096);
+  q->slot = slot;
+  q->last_used = 0;
+
+  for (int d = 0; d < q->qsize; d++) {
+    q->desc[d].addr = virt_to_phys(q->bufs + d * slot);
+    q->desc[d].len = slot;
+    q->desc[d].flags = rx ? VRING_DESC_F_WRITE : 0;
+    if (rx)
+      q->avail->ring[d] = (uint16_t)d;
+  }
+  if (rx) {
+    q->avail->idx = q->qsize;
+    q->free = 0;
+  } else {
+    q->avail->flags = VRING_AVAIL_F_NO_INTERRUPT;
+    q->free = q->qsize == 32 ? ~0u : (1u << q->qsize) - 1;
+  }
+
+  virtio_setup_queue(vcon_dev, q->idx, virt_to_phys(q->desc),
+                     virt_to_phys(q->avail), virt_to_phys(q->used));
+  return 0;
+}
+
+static void vcon_kick(struct vcon_queue *q) {
+  arch_mb();
+  if (!(*(volatile uint16_t *)&q->used->flags & VRING_USED_F_NO_NOTIFY))
+    virtio_notify(vcon_dev, q->idx);
+}
+
+/* vcon_reclaim - give completed TX slots back to the free bitmap. */
+static void vcon_reclaim(struct vcon_queue *q) {
+  uint16_t end = vcon_used_idx(q);
+  arch_mb();
+  while (q->last_used != end) {
+    uint32_t id = q->used->ring[q->last_used % q->qsize].id;
+    if (id < q->qsize)
+      q->free |= 1u << id;
+    q->last_used++;
+  }
+}
+
+/* vcon_post - copy as much of s as there are free slots for and publish
+ * it; the caller kicks.  vcon_lock held. */
+static size_t vcon_post(struct vcon_queue *q, const void *s, size_t n) {
+  const char *p = s;
+  size_t done = 0;
+  while (done < n && q->free) {
+    uint32_t id = (uint32_t)__builtin_ctz(q->free);
+    q->free &= ~(1u << id);
+    size_t c = n - done > q->slot ? q->slot : n - done;
+    memcpy(q->bufs + id * q->slot, p + done, c);
+    q->desc[id].len = (uint32_t)c;
+    q->avail->ring[q->avail->idx % q->qsize] = (uint16_t)id;
+    arch_mb();
+    q->avail->idx++;
+    done += c;
+  }
+  return done;
+}
+
+/* vcon_repost - hand RX slot id back to the device. */
+static void vcon_repost(struct vcon_queue *q, uint32_t id) {
+  q->avail->ring[q->avail->idx % q->qsize] = (uint16_t)id;
+  arch_mb();
+  q->avail->idx++;
+}
+
+static void vcon_ctrl_send(uint32_t id, uint16_t event, uint16_t value) {
+  struct vcon_queue *q = &vcon_q[Q_CTRL_TX];
+  struct virtio_console_control m = {id, event, value};
+  vcon_reclaim(q);
+  if (vcon_post(q, &m, sizeof(m)))
+    vcon_kick(q);
+}
+
+static void vcon_ctrl_event(const struct virtio_console_control *m) {
+  switch (m->event) {
+  case VIRTIO_CONSOLE_PORT_ADD:
+    if (m->id != VCON_PORT_CONSOLE && m->id != VCON_PORT_LOG) {
+      vcon_ctrl_send(m->id, VIRTIO_CONSOLE_PORT_READY, 0);
+      break;
+    }
+    vcon_ctrl_send(m->id, VIRTIO_CONSOLE_PORT_READY, 1);
+    vcon_ctrl_send(m->id, VIRTIO_CONSOLE_PORT_OPEN, 1);
+    if (m->id == VCON_PORT_LOG)
+      vcon_log_up = 1;
+    break;
+  case VIRTIO_CONSOLE_PORT_REMOVE:
+    if (m->id == VCON_PORT_LOG)
+      vcon_log_up = 0;
+    break;
+  default:
+    break; /* CONSOLE_PORT, RESIZE, PORT_NAME, host-side PORT_OPEN */
+  }
+}
+
+/* vcon_ctrl_poll - handle every control message the device has returned.
+ * vcon_lock held; returns the number handled. */
+static int vcon_ctrl_poll(void) {
+  struct vcon_queue *q = &vcon_q[Q_CTRL_RX];
+  int n = 0;
+  uint16_t end = vcon_used_idx(q);
+  arch_mb();
+  while (q->last_used != end) {
+    struct vring_used_elem *e = &q->used->ring[q->last_used % q->qsize];
+    if (e->id < q->qsize) {
+      if (e->len >= sizeof(struct virtio_console_control))
+        vcon_ctrl_event(
+            (const struct virtio_console_control *)(q->bufs +
+                                                    e->id * q->slot));
+      vcon_repost(q, e->id);
+    }
+    q->last_used++;
+    n++;
+  }
+  if (n)
+    vcon_kick(q);
+  return n;
+}
+
+/* vcon_rx_drop - re-post every console input buffer the host filled;
+ * vcon_lock held. */
+static void vcon_rx_drop(void) {
+  struct vcon_queue *q = &vcon_q[Q_CON_RX];
+  int n = 0;
+  uint16_t end = vcon_used_idx(q);
+  arch_mb();
+  while (q->last_used != end) {
+    struct vring_used_elem *e = &q->used->ring[q->last_used % q->qsize];
+    if (e->id < q->qsize)
+      vcon_repost(q, e->id);
+    q->last_used++;
+    n++;
+  }
+  if (n)
+    vcon_kick(q);
+}
+
+static void virtio_console_handler(uint32_t irq, void *data) {
+  (void)irq;
+  (void)data;
+  uint32_t status = virtio_read_reg(vcon_dev, VIRTIO_MMIO_INTERRUPT_STATUS);
+
+  uint64_t flags;
+  spin_lock_irqsave(&vcon_lock, &flags);
+  if (vcon_multiport)
+    (void)vcon_ctrl_poll();
+  vcon_rx_drop();
+  spin_unlock_irqrestore(&vcon_lock, flags);
+
+  virtio_write_reg(vcon_dev, VIRTIO_MMIO_INTERRUPT_ACK, status);
+}
+
+void virtio_console_init(void) {
+  if (arch_virtio_get_device(VIRTIO_DEV_CONSOLE, 0, &vcon_dev, &vcon_irq) !=
+      0) {
+    pr_info("%s", "VirtIO-Console: No console device found\n");
+    return;
+  }
+
+  uint32_t version = virtio_read_reg(vcon_dev, VIRTIO_MMIO_VERSION);
+  virtio_write_reg(vcon_dev, VIRTIO_MMIO_STATUS, 0);
+  uint32_t status = VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER;
+  virtio_write_reg(vcon_dev, VIRTIO_MMIO_STATUS, status);
+
+  uint32_t features = virtio_read_reg(vcon_dev, VIRTIO_MMIO_DEVICE_FEATURES);
+  vcon_multiport = !!(features & (1u << VIRTIO_CONSOLE_F_MULTIPORT));
+  virtio_write_reg(vcon_dev, VIRTIO_MMIO_DRIVER_FEATURES,
+                   features & (1u << VIRTIO_CONSOLE_F_MULTIPORT));
+  if (version >= 2) {
+    status |= VIRTIO_STATUS_FEATURES_OK;
+    virtio_write_reg(vcon_dev, VIRTIO_MMIO_STATUS, status);
+  }
+
+  int nq = vcon_multiport ? Q_NR : Q_CTRL_RX;
+  for (int i = 0; i < nq; i++) {
+    int rx = i == Q_CON_RX || i == Q_CTRL_RX || i == Q_LOG_RX;
+    int rc = vcon_queue_setup(i, rx ? VCON_RX_SLOT : VCON_TX_SLOT, rx);
+    if (rc < 0) {
+      pr_err("VirtIO-Console: queue %d setup failed (%d)\n", i, rc);
+      virtio_write_reg(vcon_dev, VIRTIO_MMIO_STATUS, VIRTIO_STATUS_FAILED);
+      return;
+    }
+  }
+
+  status |= VIRTIO_STATUS_DRIVER_OK;
+  virtio_write_reg(vcon_dev, VIRTIO_MMIO_STATUS, status);
+  irq_register(vcon_irq, virtio_console_handler, NULL);
+  virtio_notify(vcon_dev, vcon_q[Q_CON_RX].idx);
+
+  if (vcon_multiport) {
+    uint64_t flags;
+    spin_lock_irqsave(&vcon_lock, &flags);
+    virtio_notify(vcon_dev, vcon_q[Q_CTRL_RX].idx);
+    vcon_ctrl_send(0, VIRTIO_CONSOLE_DEVICE_READY, 1);
+    /* The host answers with one PORT_ADD per port; wait until it goes
+     * quiet (bounded, like any bring-up poll). */
+    for (int round = 0; round < 64; round++) {
+      int ok;
+      poll_until(ok, vcon_used_idx(&vcon_q[Q_CTRL_RX]) !=
+                         vcon_q[Q_CTRL_RX].last_used,
+                 POLL_SPINS_DEFAULT);
+      if (!ok)
+        break;
+      (void)vcon_ctrl_poll();
+    }
+    spin_unlock_irqrestore(&vcon_lock, flags);
+  }
+
+  vcon_up = 1;
+  pr_info("VirtIO-Console: %s, log on port %d (IRQ %u)\n",
+          vcon_multiport ? "multiport" : "single port",
+          vcon_log_up ? VCON_PORT_LOG : VCON_PORT_CONSOLE, vcon_irq);
+}
+
+int virtio_console_present(void) { return vcon_up; }
+
+size_t virtio_console_write(int port, const char *s, size_t n, int wait) {
+  if (!vcon_up)
+    return 0;
+  struct vcon_queue *q = port == VCON_PORT_LOG && vcon_log_up
+                             ? &vcon_q[Q_LOG_TX]
+                             : &vcon_q[Q_CON_TX];
+  uint64_t flags;
+  spin_lock_irqsave(&vcon_lock, &flags);
+  vcon_reclaim(q);
+  size_t done = vcon_post(q, s, n);
+  if (done)
+    vcon_kick(q);
+  while (wait && done < n) {
+    int ok;
+    poll_until(ok, vcon_used_idx(q) != q->last_used, POLL_SPINS_DEFAULT);
+    if (!ok)
+      break; /* host stopped reading: give up rather than hang */
+    vcon_reclaim(q);
+    size_t more = vcon_post(q, s + done, n - done);
+    if (more)
+      vcon_kick(q);
+    done += more;
+  }
+  spin_unlock_irqrestore(&vcon_lock, flags);
+  return done;
+}
@@ -43,6 +43,7 @@
 #include <kernel/gpt.h>
 #include <kernel/kmalloc.h>
 #include <kernel/printk.h>
+#include <kernel/rcu.h>
 
 /* Registered filesystem drivers (providers).  Registration happens at boot,
  * single-threaded, before vfs_init(); no locking needed. */
@@ -51,10 +52,14 @@ static const struct fs_ops *fs_drivers[VFS_MAX_FS];
 static int fs_driver_count;
 
 /* Mount table.  mounts[0] is the root mount; further slots are reserved for
- * future mountpoints.  Mounts are created once at vfs_init() and never torn
- * down, so readers need no locking. */
+ * future mountpoints.  A mount is filled in, then published through
+ * root_mount with rcu_assign_pointer, so a reader that sees the pointer sees
+ * a complete mount.  Mounts are never torn down, so readers need no lock and
+ * no read section; unmounting would have to unpublish and synchronize_rcu()
+ * before reusing the slot. */
 #define VFS_MAX_MOUNTS 4
 static struct vfs_mount mounts[VFS_MAX_MOUNTS];
+static struct vfs_mount *root_mount;
 
 /*
  * vfs_register_fs - register a filesystem provider.
@@ -97,6 +102,7 @@ void vfs_init(void) {
       mnt->fs_private = NULL;
       if (fs_drivers[d]->mount(mnt, p) == 0) {
         mnt->in_use = 1;
+        rcu_assign_pointer(root_mount, mnt);
         pr_info("VFS: mounted %s on partition %d as /\n",
                 fs_drivers[d]->name, i);
         return;
@@ -109,7 +115,7 @@ void vfs_init(void) {
 
 /* Root mount accessor; NULL if vfs_init found nothing. */
 static struct vfs_mount *vfs_root(void) {
-  return mounts[0].in_use ? &mounts[0] : NULL;
+  return rcu_dereference(root_mount);
 }
 
 /*
@@ -217,7 +223,7 @@ int vfs_stat(const char *path, struct vfs_stat *st) {
  *
  * Path Resolution:
  * - If path starts with '/', it's absolute.
- * - Otherwise, it's relative to current_process->cwd.
+ * - Otherwise, it's relative to current_process->space->cwd.
  * - Normalizes . and ..
  */
 void vfs_resolve_path(const char *in, char *out, size_t size) {
@@ -233,7 +239,7 @@ void vfs_resolve_path(const char *in, char *out, size_t size) {
          * FIX(VFS-02): kernel-context callers (boot, no current process) have
          * no cwd — resolve relative to "/" instead of dereferencing NULL. */
         if (current_process) {
-            strncpy(temp, current_process->cwd, sizeof(temp));
+            strncpy(temp, current_process->space->cwd, sizeof(temp));
         } else {
             strncpy(temp, "/", sizeof(temp));
         }
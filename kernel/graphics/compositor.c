@@ -11,6 +11,7 @@
 #include <kernel/cpu.h>
 #include <kernel/graphics.h>
 #include <kernel/kmalloc.h>
+#include <kernel/ntfn.h>
 
 /* Disable optimizations to ensure stack safety/debugging */
 
@@ -61,7 +62,7 @@ static struct window windows[MAX_WINDOWS];
 static int window_count = 0;
 static int next_window_id = 100;
 static volatile int compositor_dirty = 1;
-static DEFINE_SPINLOCK(compositor_lock);
+static DEFINE_QSPINLOCK(compositor_lock);
 
 /* Damage rect: tracks the bounding box of pixels that need GPU upload */
 static int damage_x1 = 0, damage_y1 = 0;
@@ -901,7 +902,11 @@ void compositor_handle_click(int button, int state) {
   hit->z_order = top_z + 1;
 
   /* Update keyboard focus to this process */
+  /* Signalled after unlock, like the IPC below. */
+  int focus_from = 0, focus_to = 0;
   if (keyboard_focus_pid != hit->pid) {
+    focus_from = keyboard_focus_pid;
+    focus_to = hit->pid;
     pr_info("Compositor: Focus changed to PID %d (Window '%s')\n", hit->pid,
             hit->title);
     keyboard_focus_pid = hit->pid;
@@ -969,6 +974,8 @@ void compositor_handle_click(int button, int state) {
    */
   if (send_pid > 0)
     kernel_ipc_send(send_pid, &msg);
+  if (focus_to > 0)
+    ntfn_signal_focus(focus_from, focus_to);
   if (do_close) {
     pr_info("Compositor: Close button -> terminate PID %d\n", close_pid);
     extern int process_terminate(int pid);
@@ -24,18 +24,21 @@
  *   opaque pixels (alpha=255) are written directly.
  *
  * Locking & IRQ context:
- *   No lock protects current_font.  gl_draw_char is called from
- *   compositor_window_write (under compositor_lock) and from
+ *   current_font is RCU-published (kernel/rcu.h).  gl_draw_char is called
+ *   from compositor_window_write (under compositor_lock) and from
  *   compositor_render_internal (also under compositor_lock from
- *   compositor_tick, which fires from a timer IRQ).  sys_set_font is called
- *   from syscall context.  There is no synchronisation between them.
+ *   compositor_tick, which fires from a timer IRQ), once per glyph; it and
+ *   the metric queries read the descriptor in an RCU read section and take
+ *   no lock.  sys_set_font (syscall context) swaps the pointer under
+ *   font_lock, which only serialises writers, and frees the old descriptor
+ *   after a grace period.
  *
  * Known issues:
  *   GFX-FONT-01 (W4 SECURITY BUG, FIXED) sys_set_font no longer stores the raw
  *               userland pointer: it copies the whole blob into a kmalloc'd
  *               kernel buffer, validates it against the kernel copy (magic,
  *               metrics, per-glyph bitmap bounds), and publishes an immutable
- *               descriptor behind font_lock, retiring the previous one.  This
+ *               descriptor (RCU), retiring the previous one.  This
  *               removes the dangling-pointer use-after-free (process exit after
  *               set-font), the kernel-memory info-leak (a kernel VA passed as
  *               'data'), and the size-overflow path (num_chars is uint16 and
@@ -50,7 +53,9 @@
 #include <kernel/types.h>
 #include <kernel/arch.h>      /* arch_copy_from_user (GFX-FONT-01) */
 #include <kernel/kmalloc.h>   /* kmalloc/kfree (GFX-FONT-01) */
+#include <kernel/rcu.h>       /* current_font readers */
 #include <kernel/spinlock.h>  /* font_lock (GFX-FONT-01) */
+#include <kernel/ntfn.h>      /* NTFN_SYS_FONT */
 #include <font.h>
 #include <drivers/gpu/gpu.h>
 
@@ -64,17 +69,18 @@
 int utf8_decode(const char *s, uint32_t *code);
 
 /* Internal font state */
-/* GFX-FONT-01: the active font is an immutable descriptor published behind
- * font_lock as current_font.  sys_set_font builds a new descriptor in a single
- * kmalloc block, swaps the pointer under the lock, and retires the previous
- * block; readers hold font_lock while they touch the descriptor, so a retired
- * buffer is never freed under a live reader.  heap_base is the kmalloc block to
- * free on retire (NULL for the static built-in default, which is never freed). */
+/* GFX-FONT-01: the active font is an immutable descriptor published as
+ * current_font.  sys_set_font builds a new descriptor in a single kmalloc
+ * block, swaps the pointer, and retires the previous block with call_rcu;
+ * readers touch the descriptor only inside rcu_read_lock, so a retired buffer
+ * is never freed under a live reader.  heap_base is the kmalloc block to free
+ * on retire (NULL for the static built-in default, which is never freed). */
 struct font_state {
     struct font_header header;
     const struct font_glyph_info *glyphs;
     const uint8_t *bitmap;
     void *heap_base;
+    struct rcu_head rcu;
 };
 
 static struct font_state default_font = {
@@ -92,8 +98,15 @@ static struct font_state default_font = {
 };
 
 static struct font_state *current_font = &default_font;
+/* font_lock: serialises sys_set_font callers; readers never take it. */
 static DEFINE_SPINLOCK(font_lock);
 
+/* font_free_rcu - free a retired descriptor once no reader can hold it. */
+static void font_free_rcu(struct rcu_head *head) {
+    struct font_state *f = container_of(head, struct font_state, rcu);
+    kfree(f->heap_base);                  /* heap_base == f (single block) */
+}
+
 #define FONT_MAX_BLOB (8u * 1024 * 1024)  /* upper bound on a user font blob */
 
 /*
@@ -119,10 +132,10 @@ static DEFINE_SPINLOCK(font_lock);
  * GFX-FONT-01 (fixed): current_font.glyphs/bitmap now reference a kmalloc'd
  *   kernel descriptor (never userland memory).
  *
- * Locking: takes font_lock across the blit so a concurrent sys_set_font cannot
- *          retire/free the descriptor mid-read; also called under compositor_lock
- *          from compositor_window_write and compositor_render_internal
- *          (lock order: compositor_lock -> font_lock).
+ * Locking: none; an RCU read section across the blit keeps a concurrent
+ *          sys_set_font from freeing the descriptor mid-read.  Called under
+ *          compositor_lock from compositor_window_write and
+ *          compositor_render_internal.
  * Side effects: writes pixels to surf->buffer.
  */
 /*
@@ -133,20 +146,20 @@ void gl_draw_char(struct gl_surface *surf, int x, int y, uint32_t codepoint,
   if (!surf)
     return;
 
-  /* GFX-FONT-01: hold font_lock across the whole blit so a concurrent
-   * sys_set_font cannot free the descriptor's bitmap while we read it. */
+  /* GFX-FONT-01: stay in the read section across the whole blit so a
+   * concurrent sys_set_font cannot free the descriptor's bitmap under us. */
   uint64_t flags;
-  spin_lock_irqsave(&font_lock, &flags);
-  const struct font_state *f = current_font;
+  rcu_read_lock(&flags);
+  const struct font_state *f = rcu_dereference(current_font);
 
   if (!f->bitmap) {
-    spin_unlock_irqrestore(&font_lock, flags);
+    rcu_read_unlock(flags);
     return;
   }
 
   int idx = (int)codepoint - f->header.first_char;
   if (idx < 0 || idx >= f->header.num_chars) {
-    spin_unlock_irqrestore(&font_lock, flags);
+    rcu_read_unlock(flags);
     return;
   }
 
@@ -187,7 +200,7 @@ void gl_draw_char(struct gl_surface *surf, int x, int y, uint32_t codepoint,
       }
     }
   }
-  spin_unlock_irqrestore(&font_lock, flags);
+  rcu_read_unlock(flags);
 }
 
 /*
@@ -198,18 +211,18 @@ void gl_draw_char(struct gl_surface *surf, int x, int y, uint32_t codepoint,
  * the codepoint is outside [first_char, first_char+num_chars).
  * Used by gl_draw_string and graphics_string_width to advance the cursor.
  *
- * Locking: the active font is read under font_lock (GFX-FONT-01).
+ * Locking: the active font is read in an RCU read section (GFX-FONT-01).
  */
 /*
  * Get character advance width
  */
 int graphics_char_width(uint32_t codepoint) {
   uint64_t flags;
-  spin_lock_irqsave(&font_lock, &flags);
-  const struct font_state *f = current_font;
+  rcu_read_lock(&flags);
+  const struct font_state *f = rcu_dereference(current_font);
   int idx = (int)codepoint - f->header.first_char;
   int adv = (idx < 0 || idx >= f->header.num_chars) ? 0 : f->glyphs[idx].advance;
-  spin_unlock_irqrestore(&font_lock, flags);
+  rcu_read_unlock(flags);
   return adv;
 }
 
@@ -257,7 +270,7 @@ void gl_draw_string(struct gl_surface *surf, int x, int y, const char *str,
  * Sums graphics_char_width for each decoded codepoint.  Mirrors the cursor
  * advance in gl_draw_string so callers can centre text (e.g. title bar).
  *
- * Locking: the active font is read under font_lock (GFX-FONT-01).
+ * Locking: the active font is read in an RCU read section (GFX-FONT-01).
  */
 /*
  * Get string width in pixels (UTF-8 supported)
@@ -293,7 +306,7 @@ int graphics_string_width(const char *str) {
  *   sys_set_font) can no longer cause a divide-by-zero at
  *   compositor_create_window (h / char_h).
  *
- * Locking: reads current_font.header under font_lock (GFX-FONT-01).
+ * Locking: reads current_font.header in an RCU read section (GFX-FONT-01).
  */
 /*
  * Get font height
@@ -304,9 +317,10 @@ int graphics_font_height(void) {
      * divide-by-zero in compositor row/scroll arithmetic — mirrors the
      * graphics_font_max_width() floor. */
     uint64_t flags;
-    spin_lock_irqsave(&font_lock, &flags);
-    int h = current_font->header.ascent + current_font->header.descent;
-    spin_unlock_irqrestore(&font_lock, flags);
+    rcu_read_lock(&flags);
+    const struct font_state *f = rcu_dereference(current_font);
+    int h = f->header.ascent + f->header.descent;
+    rcu_read_unlock(flags);
     return h > 0 ? h : (FONT_ASCENT + FONT_DESCENT);
 }
 
@@ -316,16 +330,16 @@ int graphics_font_height(void) {
  * Ascent is the distance from the baseline to the top of the tallest glyph.
  * Used in gl_draw_char to compute start_y = y + ascent + gi->y0.
  *
- * Locking: reads current_font under font_lock (GFX-FONT-01).
+ * Locking: reads current_font in an RCU read section (GFX-FONT-01).
  */
 /*
  * Get font ascent
  */
 int graphics_font_ascent(void) {
     uint64_t flags;
-    spin_lock_irqsave(&font_lock, &flags);
-    int a = current_font->header.ascent;
-    spin_unlock_irqrestore(&font_lock, flags);
+    rcu_read_lock(&flags);
+    int a = rcu_dereference(current_font)->header.ascent;
+    rcu_read_unlock(flags);
     return a;
 }
 
@@ -334,14 +348,14 @@ int graphics_font_ascent(void) {
  */
 int graphics_font_max_width(void) {
     uint64_t flags;
-    spin_lock_irqsave(&font_lock, &flags);
-    const struct font_state *f = current_font;
+    rcu_read_lock(&flags);
+    const struct font_state *f = rcu_dereference(current_font);
     int max_w = 0;
     for (int i = 0; i < f->header.num_chars; i++) {
         if (f->glyphs[i].advance > max_w)
             max_w = f->glyphs[i].advance;
     }
-    spin_unlock_irqrestore(&font_lock, flags);
+    rcu_read_unlock(flags);
     return max_w > 0 ? max_w : 8;
 }
 
@@ -351,7 +365,7 @@ int graphics_font_max_width(void) {
 int sys_set_font(void *data, size_t size) {
     /* GFX-FONT-01: 'data' is a raw userland pointer.  Copy the whole blob into a
      * kmalloc'd kernel buffer, validate against the *kernel* copy, then publish an
-     * immutable descriptor behind font_lock and retire the previous one.  This
+     * immutable descriptor (RCU) and retire the previous one.  This
      * removes the use-after-free (the old code stored interior pointers into user
      * memory that dangled after the process exited) and the info-leak (a user
      * could point 'data' at kernel VAs and read them back via the framebuffer). */
@@ -414,19 +428,21 @@ int sys_set_font(void *data, size_t size) {
     ns->bitmap = kblob + sizeof(struct font_header) + glyphs_bytes;
     ns->heap_base = mem;
 
-    /* 5. Publish under the lock and retire the previous descriptor.  set_font
-     * holds font_lock to swap, so no reader is mid-descriptor; after the swap no
-     * new reader can obtain 'old' (they read the new pointer).  'old' therefore
-     * has no users once the lock is released, so it is safe to free.  The static
-     * default is never freed. */
+    /* 5. Publish and retire the previous descriptor.  After the swap no new
+     * reader can obtain 'old'; readers that already hold it are inside an RCU
+     * read section, so it is freed after a grace period.  font_lock only keeps
+     * two set_font calls from retiring the same 'old'.  The static default is
+     * never freed. */
     uint64_t flags;
     spin_lock_irqsave(&font_lock, &flags);
     struct font_state *old = current_font;
-    current_font = ns;
+    rcu_assign_pointer(current_font, ns);
     spin_unlock_irqrestore(&font_lock, flags);
 
     if (old != &default_font)
-        kfree(old->heap_base);            /* heap_base == old (single block) */
+        call_rcu(&old->rcu, font_free_rcu);
 
+    /* Tell subscribed programs to re-measure their text. */
+    ntfn_broadcast_sys(NTFN_SYS_FONT);
     return 0;
 }
@@ -82,5 +82,8 @@ void lapic_send_ipi(uint32_t lapic_id, uint32_t flags);
 void lapic_timer_calibrate(void);
 void lapic_timer_setup(uint32_t hz);
 void lapic_timer_stop(void);
+/* lapic_timer_prof - profiler sub-ticks on vector 32; 1: not a tick. */
+struct pt_regs;
+int lapic_timer_prof(struct pt_regs *regs);
 
 #endif /* ARCH_AMD64_APIC_H */
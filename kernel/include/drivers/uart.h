@@ -57,4 +57,17 @@ void uart_puthex(uint64_t val);
  * interleave with concurrent normal output. */
 void uart_putc_emergency(char c);
 
+/* uart_irq_init - switch to interrupt-driven TX and RX once the interrupt
+ * controller is up (driver_console_irq_init).  Before it, output written
+ * with uart_putc / uart_puts is sent before they return. */
+void uart_irq_init(void);
+
+/* uart_tx_write / uart_tx_kick - non-waiting TX for the kernel log drain
+ * (kernel/klog.h): uart_tx_write queues as much of s as the TX ring has
+ * room for and returns that count, with the same newline handling as
+ * uart_putc; uart_tx_kick moves queued bytes into the FIFO as far as it
+ * has room, for when the TX interrupt is not wired. */
+size_t uart_tx_write(const char *s, size_t n);
+void uart_tx_kick(void);
+
 #endif /* _DRIVERS_UART_H */
@@ -0,0 +1,52 @@
+/*
+ * kernel/include/drivers/uart_ring.h
+ * Byte ring shared by the serial drivers' TX and RX software buffers.
+ *
+ * Free-running 32-bit indices (head - tail = bytes queued), size a power of
+ * two.  No locking of its own: TX rings live under the driver's uart_lock,
+ * RX rings have one producer (the IRQ handler) and take the same lock on
+ * the consumer side.
+ */
+#ifndef _DRIVERS_UART_RING_H
+#define _DRIVERS_UART_RING_H
+
+#include <kernel/types.h>
+
+#define UART_TX_RING_SIZE 4096
+#define UART_RX_RING_SIZE 256
+
+struct uart_ring {
+  char *buf;
+  uint32_t size;
+  uint32_t head; /* next byte written */
+  uint32_t tail; /* next byte read */
+};
+
+#define UART_RING_INIT(storage)                                                \
+  { .buf = (storage), .size = sizeof(storage), .head = 0, .tail = 0 }
+
+static inline uint32_t uart_ring_count(const struct uart_ring *r) {
+  return r->head - r->tail;
+}
+
+static inline uint32_t uart_ring_space(const struct uart_ring *r) {
+  return r->size - (r->head - r->tail);
+}
+
+/* uart_ring_put - append c; 0 if the ring is full. */
+static inline int uart_ring_put(struct uart_ring *r, char c) {
+  if (uart_ring_space(r) == 0)
+    return 0;
+  r->buf[r->head++ & (r->size - 1)] = c;
+  return 1;
+}
+
+/* uart_ring_get - remove the oldest byte into *c; 0 if the ring is empty. */
+static inline int uart_ring_get(struct uart_ring *r, char *c) {
+  if (r->head == r->tail)
+    return 0;
+  *c = r->buf[r->tail++ & (r->size - 1)];
+  return 1;
+}
+
+#endif /* _DRIVERS_UART_RING_H */
@@ -58,6 +58,9 @@
 #define VRING_DESC_F_WRITE 2
 #define VRING_DESC_F_INDIRECT 4
 
+/* Queues whose PCI notify offsets are cached (virtio_setup_queue). */
+#define VIRTIO_MAX_QUEUES 8
+
 /* transport ops */
 struct virtio_device;
 struct virtio_transport_ops {
@@ -75,6 +78,10 @@ struct virtio_device {
   const struct virtio_transport_ops *ops;
   uintptr_t isr_base;
   uintptr_t notify_base;
+  /* Modern PCI: queue q is kicked at notify_base +
+   * queue_notify_off[q] * notify_mult (cap type 2, common cfg 0x1E). */
+  uint32_t notify_mult;
+  uint16_t queue_notify_off[VIRTIO_MAX_QUEUES];
   void *priv;
   spinlock_t lock;
 };
@@ -86,6 +93,11 @@ typedef struct virtio_device *virtio_handle_t;
 #define VRING_DESC_F_WRITE 2
 #define VRING_DESC_F_INDIRECT 4
 
+/* Ring flags: driver asks for no used-buffer interrupt / device asks for
+ * no kick */
+#define VRING_AVAIL_F_NO_INTERRUPT 1
+#define VRING_USED_F_NO_NOTIFY 1
+
 struct vring_desc {
   uint64_t addr;
   uint32_t len;
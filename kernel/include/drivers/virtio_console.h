@@ -0,0 +1,52 @@
+/*
+ * kernel/include/drivers/virtio_console.h
+ * VirtIO console (virtio-serial) driver: an interactive console port and a
+ * separate log port, usable as the klog sink in place of the UART.
+ *
+ * With VIRTIO_CONSOLE_F_MULTIPORT the device exposes port 0 (the console,
+ * queues 0/1), a control queue pair (2/3) and port n >= 1 on queues
+ * 2n+2 / 2n+3.  Port 1 carries the kernel log; without multiport, or if the
+ * host did not plug a port 1, the log shares port 0.
+ *
+ * TX never waits for the host unless asked to: virtio_console_write()
+ * reclaims completed buffers, copies what fits into free ones and kicks the
+ * queue once per call, so a whole klog drain is one notification.
+ */
+#ifndef _DRIVERS_VIRTIO_CONSOLE_H
+#define _DRIVERS_VIRTIO_CONSOLE_H
+
+#include <kernel/types.h>
+
+#define VIRTIO_CONSOLE_F_SIZE      0
+#define VIRTIO_CONSOLE_F_MULTIPORT 1
+
+/* Control messages (queues 2 / 3) */
+#define VIRTIO_CONSOLE_DEVICE_READY 0
+#define VIRTIO_CONSOLE_PORT_ADD     1
+#define VIRTIO_CONSOLE_PORT_REMOVE  2
+#define VIRTIO_CONSOLE_PORT_READY   3
+#define VIRTIO_CONSOLE_CONSOLE_PORT 4
+#define VIRTIO_CONSOLE_RESIZE       5
+#define VIRTIO_CONSOLE_PORT_OPEN    6
+#define VIRTIO_CONSOLE_PORT_NAME    7
+
+struct virtio_console_control {
+  uint32_t id;
+  uint16_t event;
+  uint16_t value;
+};
+
+/* The kernel log's port; any other port number writes to port 0. */
+#define VCON_PORT_LOG 1
+
+/* virtio_console_init - probe the first console device, bring up port 0
+ * and, with multiport, the control queues and the log port. */
+void virtio_console_init(void);
+/* virtio_console_present - 1 once the device is up. */
+int virtio_console_present(void);
+/* virtio_console_write - queue up to n bytes on port (VCON_PORT_LOG, or 0
+ * for the console); returns the bytes taken.  wait: poll for the host to free buffers until all of
+ * it is queued (boot-time synchronous klog) instead of stopping short. */
+size_t virtio_console_write(int port, const char *s, size_t n, int wait);
+
+#endif /* _DRIVERS_VIRTIO_CONSOLE_H */
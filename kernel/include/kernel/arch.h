@@ -20,8 +20,15 @@ void arch_smp_init(void);
 void arch_smp_setup_stacks(uint32_t cpu_count);
 int arch_cpu_wake_secondary(uint64_t cpu_id, void (*entry)(void), void *stack);
 void arch_cpu_switch_context(struct process *next);
+/* Per-thread TLS register (TPIDR_EL0 / FS base).  arch_tls_save captures a
+ * value user mode may have changed on its own into prev->tls_base (called by
+ * schedule() on every switch-out); arch_tls_load installs p->tls_base on the
+ * current CPU (called from arch_cpu_switch_context and SYS_SET_TLS). */
+void arch_tls_save(struct process *prev);
+void arch_tls_load(struct process *p);
 
 static inline uint32_t arch_get_cpu_id(void) { return arch_impl_get_cpu_id(); }
+static inline void *arch_percpu_self(void) { return arch_impl_percpu_self(); }
 static inline void arch_nop(void) { arch_impl_nop(); }
 static inline void arch_yield(void) { arch_impl_yield(); }
 static inline void arch_idle(void) { arch_impl_idle(); }
@@ -121,9 +128,7 @@ static inline void arch_timer_set_compare(uint64_t val) { arch_impl_timer_set_co
 static inline void arch_timer_control(uint32_t val) { arch_impl_timer_control(val); }
 
 /* --- Spinlocks --- */
-static inline void arch_spin_lock(volatile uint32_t *lock) { arch_impl_spin_lock(lock); }
-static inline void arch_spin_unlock(volatile uint32_t *lock) { arch_impl_spin_unlock(lock); }
-static inline int arch_spin_trylock(volatile uint32_t *lock) { return arch_impl_spin_trylock(lock); }
+static inline void arch_spin_wait(volatile uint32_t *p, uint32_t seen) { arch_impl_spin_wait(p, seen); }
 
 /* --- VirtIO Bus HAL --- */
 uint32_t arch_virtio_read32(uintptr_t base, uint32_t offset);
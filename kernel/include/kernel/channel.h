@@ -0,0 +1,57 @@
+/*
+ * kernel/include/kernel/channel.h
+ * Shared-memory bulk IPC channels (SYS_CHANNEL, user contract and ring
+ * layout in include/api/channel.h).
+ *
+ * A channel pairs an endpoint with a ring of PMM pages mapped into both
+ * peers.  The endpoint only carries the offer (an IPC_TYPE_CHANNEL message
+ * naming the channel id); after CHAN_ACCEPT the data never passes through
+ * the kernel again, and sleeping / waking on an empty or full ring is the
+ * generic futex path on the shared wait words.
+ *
+ * Channels come from a fixed table of MAX_CHANNELS slots.  The frames are
+ * allocated one page at a time and never need to be contiguous; each is
+ * referenced once by the channel and once per mapping (pmm_get_page), so
+ * whichever of "last side closes" and "address space torn down"
+ * (vmm_destroy_pgd) happens last returns it to the PMM.  A channel slot is
+ * reused once both sides are gone: users counts the client mapping, the
+ * server mapping (or the pending offer), and drops to 0 at the last close.
+ *
+ * Each process maps its channels in a fixed window, slot i at CHAN_VA(i),
+ * above the user stack and below 4 GB on both arches.
+ *
+ * Locking: chan_lock (global, control path only) guards the table and is
+ * held across the offer send: chan_lock -> space->handle_lock ->
+ * ep_table_lock -> ep->lock -> target->msg_lock.  proc_space.chans[] is
+ * under handle_lock; mappings take mm_lock with neither held.
+ */
+#ifndef _KERNEL_CHANNEL_H
+#define _KERNEL_CHANNEL_H
+
+#include <channel.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+
+#define MAX_CHANNELS 32
+
+#define CHAN_VA_BASE   0xD0000000UL
+#define CHAN_VA_STRIDE 0x100000UL /* header + CHAN_SIZE_MAX, rounded up */
+#define CHAN_VA(slot)  (CHAN_VA_BASE + (uint64_t)(slot) * CHAN_VA_STRIDE)
+#define CHAN_MAX_PAGES (1 + CHAN_SIZE_MAX / PAGE_SIZE)
+
+struct channel {
+  int users;       /* chan_lock; 0 = free slot */
+  int pending;     /* offered, not yet accepted */
+  uint32_t gen;    /* bumped on reuse, part of the id */
+  int server_tgid; /* who may accept (0 until the offer is sent) */
+  uint32_t size;
+  int npages;      /* header + data */
+  uint64_t frames[CHAN_MAX_PAGES]; /* physical */
+};
+
+long sys_channel(int op, uint64_t a1, uint64_t a2, uint64_t a3);
+/* channel_release_space - close every channel of a dying space.  Its
+ * mappings are left to vmm_destroy_pgd, which drops their references. */
+void channel_release_space(struct proc_space *space);
+
+#endif /* _KERNEL_CHANNEL_H */
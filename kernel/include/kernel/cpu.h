@@ -5,29 +5,70 @@
 #include <kernel/list.h>
 #include <kernel/spinlock.h>
 #include <kernel/types.h>
+#include <pmu.h>
 
 /* Forward declaraton */
 struct process;
 
-/* Per-CPU information structure */
+/* Coherence granule on every supported core.  Data written by different
+ * CPUs goes in different lines: a store to a line another CPU is reading
+ * or writing costs a cross-CPU transfer (false sharing). */
+#define CACHE_LINE_SIZE 64
+#define __cacheline_aligned __attribute__((aligned(CACHE_LINE_SIZE)))
+
+/* Per-CPU event counters (kernel/percpu.h).  Each CPU bumps only its own
+ * slot; readers sum all CPUs. */
+enum pcpu_stat {
+  PCPU_CTX_SWITCHES, /* schedule() switched to a different task */
+  PCPU_IRQS,         /* device interrupts dispatched */
+  PCPU_PAGES_ALLOC,  /* pmm pages handed out */
+  PCPU_PAGES_FREED,  /* pmm pages returned */
+  PCPU_NR_STATS
+};
+
+/*
+ * Per-CPU information structure: the per-CPU data area.  cpu_data[] holds
+ * one per CPU, each cache-line aligned, and the running CPU finds its own
+ * through the per-CPU base register (IA32_GS_BASE on amd64, TPIDR_EL1 on
+ * aarch64; see get_cpu_info below).
+ *
+ * Fields are grouped by who writes them, one group per set of lines:
+ *   - hot, owner-only: touched on every syscall, trap and switch, and
+ *     written only by this CPU;
+ *   - scheduler: the runqueues and their lock, which other CPUs write when
+ *     they wake or migrate a task onto this CPU;
+ *   - counters: written by this CPU, read by whoever sums them;
+ *   - cold scratch buffers.
+ * Keeping the groups apart stops a remote wakeup or a counter read from
+ * pulling this CPU's hot line away from it.
+ */
 struct cpu_info {
+  /* --- Hot, owner-only --- */
   struct cpu_info *self; /* Must be at offset 0 for %gs:0 access on x86_64 */
   uint32_t cpu_id;
   uint32_t online;
-  uint64_t stack_top;      /* Kernel Stack Top */
-  uint64_t user_stack_tmp; /* Temp storage for user RSP during syscall/interrupt */
+  uint64_t stack_top;      /* Kernel Stack Top (%gs:16 in syscall.S) */
+  uint64_t user_stack_tmp; /* Temp storage for user RSP during syscall/interrupt (%gs:24) */
   struct process *current_task;
-  uint64_t next_tick_target;
-  uint64_t tick_error_acc;
-  uint64_t tick_count;
-
-  /* Scheduler Local Data (Multicore Optimization) */
-  struct list_head runqueues[32];
-  uint32_t prio_bitmap;
-  spinlock_t sched_lock; /* Local runqueue protection */
   struct process *idle_task;
-  char printk_buf[2048];
-  char syscall_buf[2048];
+
+  /* IPC direct switch: a task made READY by SYS_CALL / SYS_REPLY_RECV on
+   * this CPU, run by the next schedule() here ahead of the runqueues.  It is
+   * on no runqueue meanwhile.  Only this CPU touches it. */
+  struct process *ipc_handoff;
+
+  /* Reap stack head (SCHED-UAF-01): processes terminated by process_terminate()
+   * awaiting deferred destruction, chained via the legacy process.next field;
+   * drained at the top of the next schedule() on this CPU, after we have
+   * switched away from them. */
+  struct process *deferred_free_proc;
+
+  /* Lazy FP/SIMD ownership (kernel/fpu.h): the task whose state was last
+   * loaded into this CPU's FP registers, and whether the user FP unit is
+   * currently open to it (registers may be newer than its save area). */
+  struct process *fpu_owner;
+  uint32_t fpu_live;
+
   uint32_t in_printk;
 
   /* Fault recursion depth (Phase A, kernel/fault.h).  Incremented by
@@ -43,12 +84,44 @@ struct cpu_info {
    * terminate the current process). */
   uint32_t uaccess_active;
 
-  /* Reap stack head (SCHED-UAF-01): processes terminated by process_terminate()
-   * awaiting deferred destruction, chained via the legacy process.next field;
-   * drained at the top of the next schedule() on this CPU, after we have
-   * switched away from them. */
-  struct process *deferred_free_proc;
-};
+  uint64_t next_tick_target;
+  uint64_t tick_error_acc;
+  uint64_t tick_count;
+
+  /* Sampling timer (kernel/prof.h): next sample deadline on aarch64; on
+   * amd64 the LAPIC rate as a multiple of HZ and interrupts since the last
+   * tick. */
+  uint64_t prof_next;
+  uint32_t timer_mult;
+  uint32_t timer_sub;
+
+  /* PMU counter values at the last fold (kernel/pmu.h). */
+  uint64_t pmu_last[PMU_NR_EVENTS];
+
+  /* --- Scheduler: shared with CPUs that enqueue here --- */
+  spinlock_t sched_lock __cacheline_aligned; /* Local runqueue protection */
+  uint32_t prio_bitmap;
+  /* SCHED_RT queues, one per RT_PRIO_LEVELS, picked before runqueues[],
+   * and the RT throttle window: ticks RT threads ran here during window
+   * number rt_window (jiffies / RT_CPU_PERIOD). */
+  uint32_t rt_bitmap;
+  uint32_t rt_used;
+  uint64_t rt_window;
+  struct list_head rt_queues[8];
+  struct list_head runqueues[32];
+
+  /* --- Counters: owner writes, percpu_sum() reads --- */
+  uint64_t stats[PCPU_NR_STATS] __cacheline_aligned;
+
+  /* --- Cold --- */
+  char printk_buf[2048] __cacheline_aligned;
+  char syscall_buf[2048];
+} __cacheline_aligned;
+
+_Static_assert(__builtin_offsetof(struct cpu_info, self) == 0 &&
+                   __builtin_offsetof(struct cpu_info, stack_top) == 16 &&
+                   __builtin_offsetof(struct cpu_info, user_stack_tmp) == 24,
+               "syscall.S and the isr stubs use %gs:0, %gs:16 and %gs:24");
 #endif
 
 #define MAX_CPUS 64
@@ -56,13 +129,29 @@ struct cpu_info {
 #ifndef __ASSEMBLER__
 /* API */
 extern struct cpu_info cpu_data[MAX_CPUS];
-struct cpu_info *get_cpu_info(void);
 void smp_create_idle_task(uint32_t cpu_id);
 
 /* These are now provided by arch.h HAL macros/functions */
 #include <kernel/hal_unified.h>
 #include <kernel/arch.h>
 
+/* get_cpu_info_slow - cpu_data[] entry from the hardware CPU id (LAPIC ID /
+ * MPIDR).  Only for the window before arch_cpu_init() sets the base. */
+struct cpu_info *get_cpu_info_slow(void);
+
+/*
+ * get_cpu_info - the calling CPU's struct cpu_info.
+ *
+ * One register-relative load: the per-CPU base register holds &cpu_data[id]
+ * from arch_cpu_init() on, and boot code points it at NULL before that.  The
+ * result is only stable while the caller cannot migrate (IRQs masked, or a
+ * field that is the same on every CPU).
+ */
+static inline struct cpu_info *get_cpu_info(void) {
+  struct cpu_info *cpu = arch_percpu_self();
+  return likely(cpu) ? cpu : get_cpu_info_slow();
+}
+
 #define cpu_id() hal_cpu_id()
 #define cpu_init() arch_cpu_init()
 #define local_irq_enable() hal_irq_enable()
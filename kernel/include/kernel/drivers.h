@@ -4,6 +4,7 @@
 /* Generic Driver Framework Init */
 
 void driver_console_init(void);
+void driver_console_irq_init(void);
 void driver_irq_init(void);
 void driver_timer_init(void);
 
@@ -0,0 +1,80 @@
+/*
+ * kernel/include/kernel/endpoint.h
+ * Named IPC endpoints with per-process capability handles (SYS_ENDPOINT,
+ * ops in include/api/endpoint.h).
+ *
+ * An endpoint is a kernel object with a name in a flat service namespace
+ * ("srv.notify") and, while a server is running, a pointer to the thread
+ * that receives on it.  Clients hold handles — indices into their
+ * proc_space.handles[] table — instead of PIDs, so a send resolves
+ * handle -> endpoint -> server in O(1) with no pid search, no global lock
+ * and no process_ipc_allowed() ancestry walk.  The endpoint outlives its
+ * server: when the server thread dies it is only unbound, clients' sends
+ * wait on bind_wait, and the respawned server re-binds the same object.
+ *
+ * Endpoints come from a fixed table of MAX_ENDPOINTS slots.  An endpoint
+ * is freed when its last reference goes: one per handle, plus one while it
+ * is bound.
+ *
+ * EP_OPEN of an unknown name creates it unbound, charged to the opening
+ * process (creator) until a server binds it.  A process may hold at most
+ * EP_UNBOUND_MAX such endpoints, so one client cannot fill the table with
+ * names nobody serves.  When the creator exits first, the endpoint is
+ * withdrawn: its name is cleared, so nobody can open or bind it, and
+ * senders still holding a handle fail -EPIPE.  The slot frees with the
+ * last of those handles.
+ *
+ * Locking:
+ *   space->handle_lock -> ep_table_lock -> ep->lock -> target->msg_lock
+ *   sched_lock -> ep_table_lock (endpoint_unbind from process termination)
+ *   ep->lock -> ntfn locks (bound notification, kernel/ntfn.h)
+ * ep_table_lock guards names, refs and slot allocation; ep->lock guards
+ * server and bind_wait and is what keeps a bound server alive during a
+ * send (termination unbinds under it before the thread can be freed).
+ */
+#ifndef _KERNEL_ENDPOINT_H
+#define _KERNEL_ENDPOINT_H
+
+#include <endpoint.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+
+#define MAX_ENDPOINTS 64
+#define EP_UNBOUND_MAX 4 /* never-bound endpoints one process may create */
+
+struct endpoint {
+  spinlock_t lock;
+  int refs;                     /* ep_table_lock; 0 = free slot */
+  char name[EP_NAME_MAX];
+  char owner[PROCESS_NAME_MAX]; /* program that first bound it */
+  struct process *server;       /* receiving thread; NULL while unbound */
+  struct wait_queue_head bind_wait; /* senders waiting for a server */
+  struct ntfn *ntfn;            /* bound notification (NTFN_BIND) or NULL */
+  int creator;                  /* tgid charged while never bound, else 0 */
+};
+
+void endpoint_init(void);
+long sys_endpoint(struct pt_regs *frame, int op, uint64_t a1, uint64_t a2,
+                  uint64_t a3);
+
+/* endpoint_pin - resolve the current process's handle h to the bound
+ * server thread, returned with (*epp)->lock held and IRQs masked (*flags);
+ * release with endpoint_unpin().  On failure returns NULL with *err set:
+ * -EBADF, -EPIPE (withdrawn), -EAGAIN (unbound), or IPC_SEND_RETRY when
+ * 'block' parked the caller on bind_wait with a syscall retry armed. */
+struct process *endpoint_pin(int h, int block, struct endpoint **epp,
+                             uint64_t *flags, long *err);
+void endpoint_unpin(struct endpoint *ep, uint64_t flags);
+
+/* endpoint_unbind - detach a dying thread from every endpoint it serves.
+ * Called by process_terminate_thread() under sched_lock. */
+void endpoint_unbind(struct process *p);
+/* endpoint_bind_ntfn - NTFN_BIND: bind notification handle nh to endpoint
+ * handle h, which the calling thread must serve (-EPERM otherwise, -EBUSY
+ * if either side is already bound). */
+long endpoint_bind_ntfn(int h, int nh);
+/* endpoint_release_handles - withdraw the never-bound endpoints a dying
+ * space created, then drop every handle it holds. */
+void endpoint_release_handles(struct proc_space *space);
+
+#endif /* _KERNEL_ENDPOINT_H */
@@ -0,0 +1,83 @@
+/*
+ * kernel/include/kernel/event.h
+ * Event sets: one blocking wait over fds, IPC, input, registry writes and
+ * timers (SYS_EVENT, user contract in include/api/event.h).
+ *
+ * An event set is a kernel object holding up to EV_MAX_SOURCES
+ * registrations; processes reference it through proc_space.evsets[]
+ * handles.  EV_WAIT scans the registrations and, when none is ready,
+ * parks the thread on the set's wait queue with a syscall retry armed
+ * (wait_queue_block), so the retried call simply scans again.
+ *
+ * Nothing polls.  Every source wakes the set when it may have become
+ * ready:
+ *   - IPC / input / keyboard fd: ipc_send_locked() calls event_wake() on
+ *     the target thread's ev_set after buffering a message;
+ *   - registry: registry_set() calls event_notify_registry();
+ *   - pipe fds: the pipe calls event_notify_obj() when an end turns ready
+ *     (the item records the pipe at EV_ADD; nothing is scanned while no
+ *     item records one);
+ *   - timers and the wait timeout: a per-thread software timer (ev_timer)
+ *     armed for the nearest expiry.
+ * A wake that lands between the scan and the sleep is caught by the set's
+ * sequence number: event_wake() bumps seq before waking, and the waiter
+ * re-checks it after queueing itself.
+ *
+ * Sets come from a fixed table, so a stale ev_set pointer can only cause a
+ * spurious wake (waiters re-scan), never a use-after-free.
+ *
+ * Locking: space->handle_lock -> ev_table_lock -> set->lock ->
+ * thread msg_lock / pipe->lock (pipe_poll); target msg_lock ->
+ * set->wq.lock (event_wake from a send); timer_lock -> set->wq.lock
+ * (timeout callback).
+ */
+#ifndef _KERNEL_EVENT_H
+#define _KERNEL_EVENT_H
+
+#include <event.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+
+#define MAX_EVSETS 32
+
+struct ev_item {
+  int src;           /* EV_SRC_*, -1 = free */
+  uint32_t events;
+  int64_t arg;       /* fd / pid / timer period in jiffies */
+  uint64_t udata;
+  uint32_t key_hash; /* EV_SRC_REGISTRY */
+  const void *obj;   /* EV_SRC_FD: the pipe behind the fd, or NULL */
+  int fired;         /* EV_SRC_REGISTRY: written since last reported */
+  uint64_t next;     /* EV_SRC_TIMER: next expiry, jiffies */
+};
+
+struct evset {
+  int refs;        /* ev_table_lock: handles + running EV_WAITs; 0 = free */
+  spinlock_t lock; /* items, cursor */
+  uint32_t seq;    /* bumped by every event_wake() */
+  int cursor;      /* scan start, rotated for fairness */
+  struct wait_queue_head wq;
+  struct ev_item items[EV_MAX_SOURCES];
+};
+
+/* sys_event returns EV_WAIT_RETRY when EV_WAIT blocked with a syscall retry
+ * armed; the dispatcher must then schedule() without writing the return
+ * register (same rule as FUTEX_WAIT_RETRY). */
+#define EV_WAIT_RETRY 1
+
+void event_init(void);
+long sys_event(int op, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4);
+/* event_wake - a source of s may have become ready. */
+void event_wake(struct evset *s);
+/* event_notify_registry - key was written; wake sets watching it. */
+void event_notify_registry(const char *key);
+/* event_notify_obj - kernel object obj (a pipe) may have become ready;
+ * wake sets with an fd item on it.  A stale match is a spurious wake. */
+void event_notify_obj(const void *obj);
+/* event_release - cancel a dying thread's wait timer.  Called from every
+ * thread-free path, next to futex_release(). */
+void event_release(struct process *p);
+/* event_release_space - drop every event-set handle of a dying space. */
+void event_release_space(struct proc_space *space);
+
+#endif /* _KERNEL_EVENT_H */
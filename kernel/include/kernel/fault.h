@@ -63,7 +63,7 @@ struct cpu_info *arch_cpu_info_fault_safe(void);
 /*
  * arch_frame_on_fault_stack - aarch64 HAL: whether an exception frame lives
  * on one of the per-CPU EL1 fault stacks (i.e. the vector switched stacks and
- * parked the original SP at frame+816).  amd64 does not define it — the IST
+ * parked the original SP just above the frame).  amd64 does not define it — the IST
  * mechanism is transparent there.
  */
 int arch_frame_on_fault_stack(const void *frame);
@@ -96,8 +96,11 @@ void arch_uaccess_fault_fixup(void);
  * backtrace_here walks from the current call site (used by panic()).
  * ksym_lookup resolves a text address against the .ksyms blob; returns NULL
  * (and prints raw) when no table is linked.  All output via fault_printf.
+ * backtrace_collect is the same walk into an array, with no output.
  */
 void backtrace_regs(uint64_t pc, uint64_t fp);
+int backtrace_collect(uint64_t pc, uint64_t fp, uint64_t stack_lo,
+                      uint64_t stack_hi, uint64_t *out, int max);
 void backtrace_here(void);
 const char *ksym_lookup(uint64_t addr, uint64_t *off);
 
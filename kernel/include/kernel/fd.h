@@ -4,7 +4,7 @@
  *
  * Replaces the historical overloaded-integer scheme (0=stdin/IPC,
  * 1/2=window-by-pid, >=100=window id) with a real table indexed by small
- * integers.  Three descriptor kinds exist today:
+ * integers.  Four descriptor kinds exist today:
  *
  *   FD_KBD   the keyboard/stdin stream: read() drains IPC_TYPE_INPUT
  *            messages, blocking when none are pending.
@@ -17,15 +17,27 @@
  *            so closing or process death needs no kernel cleanup beyond
  *            clearing the entry.  The resolved path is kept because the
  *            VFS write contract is path-based.
+ *   FD_PIPE  one end of a pipe (kernel/pipe.h): FD_MODE_READ or
+ *            FD_MODE_WRITE says which.  The only kind that holds a kernel
+ *            object: close, spawn inheritance and process_fd_release()
+ *            keep the pipe's end counts.
  *
  * fds[0]/[1]/[2] are pre-opened as KBD/WIN(-1)/WIN(-1) by process_create()
  * so existing read(0)/write(1)/write(2) callers keep working unchanged.
  * The legacy "fd >= 100 is a window id" write path remains as a
  * compatibility alias until the window ABI moves onto the table.
  *
- * Locking: none.  Processes are single-threaded and only the owning
- * process touches its table, from syscall context.  Nothing else may
- * reach into another process's fd table.
+ * spawn_fds() seeds a child's table with copies of chosen parent entries
+ * (process_fd_inherit): a pipe end is shared, a file fd gets its own copy
+ * of the offset.
+ *
+ * Locking: the table lives in the process's proc_space and is shared by
+ * all of its threads.  proc_space.fd_lock serialises slot allocation
+ * (open/pipe2) and close, and is held while a pipe reference is taken
+ * from an entry; read/write/lseek on one FD_FILE entry from two threads at
+ * once race on its offset, as unsynchronised POSIX callers would.  Nothing
+ * outside the process reaches into its table, except spawn_fds copying
+ * from it under its fd_lock.
  */
 #ifndef _KERNEL_FD_H
 #define _KERNEL_FD_H
@@ -41,24 +53,34 @@
 #define FD_KBD 1
 #define FD_WIN 2
 #define FD_FILE 3
+#define FD_PIPE 4
 
-/* fd_entry.mode (FD_FILE access mode, from open() O_ACCMODE) */
+/* fd_entry.mode (FD_FILE access mode from open() O_ACCMODE; FD_PIPE end
+ * and O_NONBLOCK from pipe2()) */
 #define FD_MODE_READ (1 << 0)
 #define FD_MODE_WRITE (1 << 1)
+#define FD_MODE_NONBLOCK (1 << 2)
 
 struct fd_entry {
   uint8_t type; /* FD_* */
-  uint8_t mode; /* FD_MODE_* (FD_FILE only) */
+  uint8_t mode; /* FD_MODE_* (FD_FILE, FD_PIPE) */
   int win_id;   /* FD_WIN: window id, or -1 for the caller's own window */
   struct vfs_node node;   /* FD_FILE: node from vfs_open (size refreshed
                            * after writes that may grow the file) */
   uint64_t offset;        /* FD_FILE: current file position */
   char path[FD_PATH_MAX]; /* FD_FILE: resolved absolute path */
+  struct pipe *pipe;      /* FD_PIPE: the pipe, one end held */
 };
 
-struct process;
+struct proc_space;
 /* process_fd_init - reset the table and pre-open fds 0/1/2 (KBD/WIN/WIN).
- * Called by process_create(). */
-void process_fd_init(struct process *proc);
+ * Called by process_create() for each new address space; threads share it. */
+void process_fd_init(struct proc_space *space);
+/* process_fd_inherit - child fd i becomes a copy of parent fd map[i] for
+ * i < n (map[i] < 0: keep the default).  For a child not yet running. */
+void process_fd_inherit(struct proc_space *child, struct proc_space *parent,
+                        const int *map, int n);
+/* process_fd_release - close every fd of a dying space (space_put). */
+void process_fd_release(struct proc_space *space);
 
 #endif /* _KERNEL_FD_H */
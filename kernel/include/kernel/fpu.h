@@ -0,0 +1,53 @@
+/*
+ * kernel/include/kernel/fpu.h
+ * Lazy FP/SIMD context management (arch HAL).
+ *
+ * The kernel is built without FP/SIMD code generation (-mgeneral-regs-only,
+ * KERNEL_ARCH_CFLAGS in the Makefile), so exception entry saves only the
+ * integer frame (struct pt_regs) and the FP/SIMD register file always holds
+ * USER state.  That state is switched lazily:
+ *
+ *   - Every task starts with no save area (process.fpu_state == NULL) and
+ *     the FP unit trapped.  Its first FP/SIMD instruction traps into the
+ *     arch handler, which allocates the area, loads it into the registers,
+ *     records the task as the CPU's fpu_owner and un-traps the unit.
+ *   - At a context switch the registers are saved ONLY if the outgoing task
+ *     had the unit enabled during its slice (cpu_info.fpu_live).  Tasks that
+ *     never touch FP/SIMD pay nothing, on entry, exit or switch.
+ *   - The incoming task gets the unit back without a reload when this CPU
+ *     still holds its registers (fpu_owner == next and next->fpu_cpu is this
+ *     CPU); otherwise the unit stays trapped until it is actually used.
+ *
+ * process.fpu_cpu is rewritten on every load, so a copy left behind on a CPU
+ * the task migrated away from is never mistaken for live state, and a new
+ * process reusing a freed descriptor's address starts at -1 (no CPU).
+ *
+ * Locking: none.  All per-CPU state is touched on the owning CPU with IRQs
+ * masked (schedule() and the trap handler both run that way).
+ */
+#ifndef _KERNEL_FPU_H
+#define _KERNEL_FPU_H
+
+#include <kernel/types.h>
+
+struct process;
+struct pt_regs;
+
+/* arch_fpu_init_cpu - trap the FP unit and clear this CPU's ownership.
+ * Called from arch_cpu_init() on every core. */
+void arch_fpu_init_cpu(void);
+
+/* arch_fpu_switch - context-switch hook, called from arch_cpu_switch_context()
+ * with IRQs masked: saves the outgoing live state and decides whether 'next'
+ * can run with the unit enabled. */
+void arch_fpu_switch(struct process *next);
+
+/* arch_fpu_trap - first-use trap from user mode.  Returns the frame to
+ * resume (the trapping instruction re-executes), or NULL if the state
+ * could not be set up — the caller then treats it as a user fault. */
+struct pt_regs *arch_fpu_trap(struct pt_regs *frame);
+
+/* arch_fpu_release - free a dead task's save area (process teardown). */
+void arch_fpu_release(struct process *proc);
+
+#endif /* _KERNEL_FPU_H */
@@ -0,0 +1,69 @@
+/*
+ * kernel/include/kernel/futex.h
+ * Fast userspace mutex support (SYS_FUTEX, ops in include/api/futex.h).
+ *
+ * Userland keeps lock state in a 32-bit word of its own memory and only
+ * enters the kernel to sleep on or wake that word, so an uncontended
+ * lock/unlock is a pair of atomics and no syscall.  Waiters are keyed by the
+ * physical address of the word (shared mappings in different processes meet
+ * on the same key) and hashed into a fixed table of FUTEX_HASH_SIZE buckets,
+ * each a spinlock plus a list of waiting threads.
+ *
+ * A thread waits on at most one futex, so its waiter entry is embedded in
+ * struct process (process.futex) and a wait allocates nothing.  FUTEX_WAIT
+ * sleeps the same way sys_ipc_recv does: it queues the entry, marks the
+ * thread SLEEPING with a syscall retry armed, and the retried syscall reads
+ * the outcome (woken / timed out) from the entry.  Timeouts are jiffies-
+ * granular software timers (drivers/timer.h).  FUTEX_WAIT_PI additionally
+ * lends the waiter's scheduling rank to the lock holder (kernel/sched.h
+ * pi_boost); process.pi_donee records the holder.
+ *
+ * Locking: bucket->lock (irqsave) protects its chain and the queued
+ * entries' key/bucket/state; wake and timeout paths take the woken thread's
+ * cpu->sched_lock inside it (wake_sleeping_task).  The software timer fires
+ * under timer_lock -> bucket->lock, so a bucket lock is never held while
+ * calling timer_add/timer_del.
+ */
+#ifndef _KERNEL_FUTEX_H
+#define _KERNEL_FUTEX_H
+
+#include <drivers/timer.h>
+#include <kernel/list.h>
+#include <kernel/types.h>
+
+#define FUTEX_HASH_BITS 6
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS)
+
+/* futex_waiter.state */
+#define FUTEX_W_IDLE     0 /* not waiting, no outcome pending */
+#define FUTEX_W_QUEUED   1 /* on a bucket chain, thread SLEEPING */
+#define FUTEX_W_WOKEN    2 /* dequeued by FUTEX_WAKE/REQUEUE */
+#define FUTEX_W_TIMEDOUT 3 /* dequeued by the timeout timer */
+
+struct futex_waiter {
+  struct list_head node; /* bucket chain */
+  uint64_t key;          /* physical address of the futex word */
+  int bucket;            /* index of the chain 'node' is on */
+  int state;             /* FUTEX_W_* */
+  int timed;             /* 'timeout' has been armed */
+  struct timer timeout;
+};
+
+struct process;
+
+/* sys_futex returns FUTEX_WAIT_RETRY when FUTEX_WAIT blocked with a syscall
+ * retry armed; the dispatcher must then leave the return register alone
+ * (same rule as IPC_RECV_RETRY).  No other op returns it. */
+#define FUTEX_WAIT_RETRY 1
+
+void futex_init(void);
+long sys_futex(uint32_t *uaddr, int op, uint32_t val, uint64_t arg3,
+               uint32_t *uaddr2, uint32_t val3);
+/* futex_wake_key - FUTEX_WAKE by physical address, for the kernel side of
+ * memory it shares with userland (channel rings); returns the number woken. */
+long futex_wake_key(uint64_t key, uint32_t nr);
+/* futex_release - take a dying thread off its bucket and cancel its timer.
+ * Called from every thread-free path before the descriptor is freed. */
+void futex_release(struct process *p);
+
+#endif /* _KERNEL_FUTEX_H */
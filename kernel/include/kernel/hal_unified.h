@@ -153,16 +153,8 @@ static inline void hal_cache_sync_icache(void *va, size_t size) {
 
 /* --- Spinlocks --- */
 
-static inline void hal_spin_lock(volatile uint32_t *lock) {
-    arch_impl_spin_lock(lock);
-}
-
-static inline void hal_spin_unlock(volatile uint32_t *lock) {
-    arch_impl_spin_unlock(lock);
-}
-
-static inline int hal_spin_trylock(volatile uint32_t *lock) {
-    return arch_impl_spin_trylock(lock);
+static inline void hal_spin_wait(volatile uint32_t *p, uint32_t seen) {
+    arch_impl_spin_wait(p, seen);
 }
 
 /* --- Port I/O (Architecture Specific or NOP) --- */
@@ -0,0 +1,74 @@
+/*
+ * kernel/include/kernel/ipc_ring.h
+ * Bounded, allocation-free IPC receive buffer (one per thread).
+ *
+ * Replaces the kmalloc'd ipc_node list: a thread's buffered messages live
+ * in a fixed array of 'depth' slots allocated with the thread (PMM pages,
+ * IPC_RING_DEFAULT slots = one page) and resized only by SYS_IPC_SET_DEPTH.
+ * Sending and receiving never allocate; a full buffer makes the sender
+ * block or fail with -EAGAIN (backpressure) instead of growing.
+ *
+ * Receivers may filter by sender (recv(src_pid, ...)), so messages leave
+ * out of order and a plain head/tail ring would fragment.  Slots are
+ * instead threaded on index links:
+ *   - FIFO order (head/tail, next/prev): recv(-1) takes the oldest;
+ *   - one chain per sender bucket (from % IPC_RING_SENDER_BUCKETS,
+ *     snext/sprev): recv(pid) scans only that pid's bucket, oldest first;
+ *   - a free list (through next).
+ * Push, pop and unlink are O(1) apart from the bucket scan.
+ *
+ * Per thread, not per process: IPC addresses threads.  A pid names one
+ * thread, the receive wait (ipc_wait) and the SYS_CALL reply belong to
+ * it, and a message queued for one thread must not be taken by a sibling.
+ * A shared per-process ring would need the wait and wakeup logic to pick
+ * a thread per message.  The memory bound still holds: a process owns at
+ * most (its threads) x IPC_RING_MAX slots, and threads are bounded by the
+ * process table.
+ *
+ * Locking: the owning process's msg_lock guards every call.
+ */
+#ifndef _KERNEL_IPC_RING_H
+#define _KERNEL_IPC_RING_H
+
+#include <kernel/types.h>
+
+#define IPC_RING_SENDER_BUCKETS 8
+
+struct ipc_slot {
+  struct ipc_message msg;
+  int16_t next, prev;   /* FIFO order; 'next' doubles as the free list */
+  int16_t snext, sprev; /* per-sender-bucket chain */
+};
+
+struct ipc_ring {
+  uint16_t depth;
+  uint16_t count;
+  uint16_t pages; /* PMM pages backing this ring */
+  int16_t head, tail;
+  int16_t free;
+  int16_t bhead[IPC_RING_SENDER_BUCKETS];
+  int16_t btail[IPC_RING_SENDER_BUCKETS];
+  struct ipc_slot slots[];
+};
+
+/* ipc_ring_alloc: a ring with 'depth' slots (1..IPC_RING_MAX), or NULL. */
+struct ipc_ring *ipc_ring_alloc(unsigned depth);
+void ipc_ring_free(struct ipc_ring *r);
+/* ipc_ring_push: 0, or -EAGAIN when full. */
+int ipc_ring_push(struct ipc_ring *r, const struct ipc_message *msg);
+/* ipc_ring_pop: take the oldest message from src_pid (-1 = any) into *out.
+ * 0, or -1 if there is none. */
+int ipc_ring_pop(struct ipc_ring *r, int src_pid, struct ipc_message *out);
+/* ipc_ring_has: is a message from src_pid (-1 = any) buffered? */
+int ipc_ring_has(struct ipc_ring *r, int src_pid);
+/* ipc_ring_move: transfer every message of 'from' into 'to' in FIFO order.
+ * -EBUSY (nothing moved) if they do not fit. */
+int ipc_ring_move(struct ipc_ring *to, struct ipc_ring *from);
+/* ipc_ring_clear: drop every buffered message. */
+void ipc_ring_clear(struct ipc_ring *r);
+
+static inline int ipc_ring_full(const struct ipc_ring *r) {
+  return r->count >= r->depth;
+}
+
+#endif /* _KERNEL_IPC_RING_H */
@@ -0,0 +1,85 @@
+/*
+ * kernel/include/kernel/klog.h
+ * Kernel log buffer: lockless per-CPU record rings, drained asynchronously
+ * to the UART and kept as a dmesg history (SYS_DMESG).
+ *
+ * Producers (vprintk, the stdout mirror of window_text_write) never touch
+ * the UART and never take a shared lock: klog_write() appends one record
+ * — header {seq, timestamp, cpu, flags, len} + text — to the CURRENT CPU's
+ * ring with IRQs masked locally, and publishes it with a release store of
+ * the ring head.  seq comes from one global atomic counter, so records from
+ * different CPUs merge back into issue order.  A full ring drops the record
+ * and counts it; nothing ever waits for the UART.
+ *
+ * The single consumer is whoever holds klog_drain_lock (trylock, so a CPU
+ * never waits for another's drain).  klog_drain() moves records, lowest seq
+ * first, into the history ring as text lines ("[sssss.uuuuuu] [Cn] msg"),
+ * then hands history bytes to the UART driver's TX ring only as far as it
+ * has room (uart_tx_write); the TX-empty interrupt moves them on to the
+ * wire.  The drain runs after each printk, from the UART interrupt when its
+ * TX ring runs low, and from the timer tick on CPU 0, so a slow or chatty
+ * console only ever delays output, with no CPU spinning on the TX FIFO.
+ * The history is never overwritten before the UART has taken it; when the
+ * UART falls that far behind, records wait in the per-CPU rings.
+ *
+ * Sink: the drain feeds the UART by default; klog_set_sink(KLOG_SINK_VIRTIO)
+ * moves it to the virtio-console log port (drivers/virtio_console.h), which
+ * takes a whole drain per host notification instead of a byte per FIFO
+ * slot.  The build picks the boot-time choice (KLOG_SINK=virtio in the
+ * Makefile defines KLOG_SINK_DEFAULT).  Emergency output always stays on
+ * the UART: it needs no interrupts, locks or host cooperation.
+ *
+ * Synchronous modes: until the first timer tick (early boot has nobody to
+ * drain later) every printk drains to completion through uart_putc; after
+ * klog_emergency() (panic) the remaining records are flushed lock-free
+ * through uart_putc_emergency and every later printk goes straight out the
+ * same way, as fault_printf does.
+ */
+#ifndef _KERNEL_KLOG_H
+#define _KERNEL_KLOG_H
+
+#include <kernel/types.h>
+
+#define KLOG_CPU_SIZE  4096  /* per-CPU record ring, power of two */
+#define KLOG_HIST_SIZE 65536 /* dmesg history / UART backlog, power of two */
+#define KLOG_REC_MAX   1024  /* longest record text; longer writes are split */
+
+/* klog_write flags */
+#define KLOG_RAW 1 /* user stdout mirror: no timestamp / CPU prefix */
+
+/* klog_set_sink sinks */
+#define KLOG_SINK_UART   0
+#define KLOG_SINK_VIRTIO 1
+#ifndef KLOG_SINK_DEFAULT
+#define KLOG_SINK_DEFAULT KLOG_SINK_UART
+#endif
+
+struct klog_rec {
+  uint64_t seq;
+  uint64_t ts_us;
+  uint16_t len;  /* text bytes following the header */
+  uint8_t cpu;
+  uint8_t flags; /* KLOG_RAW */
+  uint32_t pad;
+};
+
+/* klog_write - append len bytes of text as one record (split at
+ * KLOG_REC_MAX) to this CPU's ring.  Any context; never blocks. */
+void klog_write(const char *s, size_t len, int flags);
+/* klog_kick - push what the UART takes right now (or everything, in the
+ * synchronous modes).  Called after producing, and by the UART interrupt
+ * handlers when their TX ring runs low. */
+void klog_kick(void);
+/* klog_tick - timer tick on CPU 0: leaves boot-time synchronous mode,
+ * nudges the UART (in case its TX interrupt is not wired) and drains. */
+void klog_tick(void);
+/* klog_set_sink - route the drain to sink (KLOG_SINK_*) from now on;
+ * -ENODEV if that device is not up.  Unsent history follows the switch. */
+int klog_set_sink(int sink);
+/* klog_emergency - panic: flush everything lock-free, then go synchronous. */
+void klog_emergency(void);
+/* sys_dmesg - SYS_DMESG: copy the newest history (whole lines, at most
+ * size bytes) to ubuf; returns the byte count or -EFAULT / -ENOMEM. */
+long sys_dmesg(char *ubuf, size_t size);
+
+#endif /* _KERNEL_KLOG_H */
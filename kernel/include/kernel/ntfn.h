@@ -0,0 +1,81 @@
+/*
+ * kernel/include/kernel/ntfn.h
+ * Notification objects (SYS_NTFN, user contract in include/api/ntfn.h).
+ *
+ * A notification is a word of pending bits plus a wait queue for
+ * NTFN_WAIT sleepers.  ntfn_signal() ORs bits in and wakes; it allocates
+ * nothing and takes only the object's lock, so kernel producers
+ * (compositor focus changes from the mouse IRQ, process exit, registry
+ * writes) may call it from any context.
+ *
+ * Bound to an endpoint (NTFN_BIND), the object also names the thread
+ * serving that endpoint.  Pending bits then count as a buffered message for
+ * that thread's receive-from-any: pop_message() turns them into an
+ * IPC_TYPE_NOTIFICATION message, and ntfn_signal() completes or wakes a
+ * receive it is blocked in (ipc_notify_thread).  The endpoint holds one
+ * reference, and ep_create / endpoint_unbind move the binding along with
+ * the endpoint's server.
+ *
+ * Objects come from a fixed table, referenced by proc_space.ntfns[]
+ * handles and by the endpoint they are bound to.
+ *
+ * Locking:
+ *   space->handle_lock -> ntfn_table_lock -> ntfn->lock
+ *   ep_table_lock -> ep->lock -> ntfn->lock -> bound->msg_lock
+ *   sched_lock -> ntfn_table_lock (child exit from process termination)
+ * ntfn->lock guards bound (set / cleared together with the thread's
+ * bound_ntfn, under its msg_lock too) and the wait queue; bits is atomic.
+ */
+#ifndef _KERNEL_NTFN_H
+#define _KERNEL_NTFN_H
+
+#include <ntfn.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+
+#define MAX_NTFNS 64
+
+struct ntfn {
+  spinlock_t lock;
+  int refs;              /* ntfn_table_lock: handles + binding; 0 = free */
+  uint64_t bits;         /* pending */
+  uint64_t sys_mask;     /* NTFN_SYS_* subscribed (ntfn_table_lock) */
+  int owner_tgid;        /* process that created it */
+  int ep_bound;          /* bound to an endpoint (ntfn_table_lock) */
+  struct process *bound; /* thread serving that endpoint, or NULL */
+  struct wait_queue_head wq; /* NTFN_WAIT sleepers */
+};
+
+/* sys_ntfn returns NTFN_WAIT_RETRY when NTFN_WAIT blocked with a syscall
+ * retry armed; the dispatcher must then schedule() without writing the
+ * return register. */
+#define NTFN_WAIT_RETRY 1
+
+void ntfn_init(void);
+long sys_ntfn(int op, uint64_t a1, uint64_t a2);
+void ntfn_signal(struct ntfn *n, uint64_t bits);
+/* ntfn_take - read and clear the pending bits. */
+uint64_t ntfn_take(struct ntfn *n);
+/* ntfn_signal_sys - raise kernel event bit on the objects of process tgid
+ * that subscribed to it; no-op for tgid <= 0 (no such process). */
+void ntfn_signal_sys(uint64_t bit, int tgid);
+/* ntfn_broadcast_sys - raise bit on every object subscribed to it, for
+ * system-wide events (registry write, font change). */
+void ntfn_broadcast_sys(uint64_t bit);
+/* ntfn_signal_focus - keyboard focus moved from thread from_pid to to_pid
+ * (either <= 0 for none): NTFN_SYS_FOCUS to both processes, if they are
+ * two different ones. */
+void ntfn_signal_focus(int from_pid, int to_pid);
+/* ntfn_attach / ntfn_detach - (un)bind thread p as n's receiver; detach
+ * is a no-op if p is not the bound thread.  ep->lock held. */
+int ntfn_attach(struct ntfn *n, struct process *p);
+void ntfn_detach(struct ntfn *n, struct process *p);
+/* ntfn_bind_get - the object behind handle h with a reference taken for an
+ * endpoint binding, or NULL; -EBUSY in *err if it is already bound.
+ * ntfn_put drops a reference (endpoint freed).  ep_table_lock held. */
+struct ntfn *ntfn_bind_get(int h, long *err);
+void ntfn_put(struct ntfn *n);
+/* ntfn_release_space - drop every notification handle of a dying space. */
+void ntfn_release_space(struct proc_space *space);
+
+#endif /* _KERNEL_NTFN_H */
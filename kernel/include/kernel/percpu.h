@@ -0,0 +1,47 @@
+/*
+ * kernel/include/kernel/percpu.h
+ * Per-CPU event counters that are summed on read.
+ *
+ * A global statistic kept in one shared word costs a locked RMW and a
+ * cache-line transfer on every update once two CPUs are busy.  Instead each
+ * CPU counts into its own cpu_info.stats[] (enum pcpu_stat, kernel/cpu.h),
+ * on a line no other CPU writes, with a plain load and store; readers add up
+ * all CPUs.  The counters only ever grow, so a quantity that goes both ways
+ * is kept as two of them (free pages = boot total - allocated + freed).
+ *
+ * A sum is a moving snapshot: each CPU's word is read once and atomically,
+ * but CPUs keep counting while it is taken.  Fine for statistics and
+ * thresholds, not for anything that must be exact.
+ */
+#ifndef _KERNEL_PERCPU_H
+#define _KERNEL_PERCPU_H
+
+#include <kernel/cpu.h>
+#include <kernel/types.h>
+
+/* __percpu_add - bump this CPU's counter.  IRQs masked (or otherwise pinned
+ * to this CPU), so nothing else writes the slot.  The store is atomic only so
+ * that percpu_sum never sees a torn value. */
+static inline void __percpu_add(enum pcpu_stat stat, uint64_t n) {
+  uint64_t *c = &get_cpu_info()->stats[stat];
+  __atomic_store_n(c, __atomic_load_n(c, __ATOMIC_RELAXED) + n,
+                   __ATOMIC_RELAXED);
+}
+
+/* percpu_add - __percpu_add from any context. */
+static inline void percpu_add(enum pcpu_stat stat, uint64_t n) {
+  uint64_t flags;
+  hal_irq_save(&flags);
+  __percpu_add(stat, n);
+  hal_irq_restore(flags);
+}
+
+/* percpu_sum - the counter summed over all CPUs (kernel/cpu.c). */
+uint64_t percpu_sum(enum pcpu_stat stat);
+
+/* sys_cpustat - SYS_CPUSTAT(buf, size): one text line per online CPU with
+ * its tick count and counters, then the totals and free pages.  Bytes
+ * written or a negative errno. */
+long sys_cpustat(char *ubuf, size_t size);
+
+#endif /* _KERNEL_PERCPU_H */
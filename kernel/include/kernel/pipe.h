@@ -0,0 +1,77 @@
+/*
+ * kernel/include/kernel/pipe.h
+ * Pipes: the FD_PIPE descriptor kind (kernel/fd.h; user contract at
+ * pipe() / spawn_fds() in include/api/os1.h).
+ *
+ * A pipe is a PIPE_SIZE-byte ring in one kernel page plus a wait queue per
+ * end.  A read takes whatever is buffered (up to its count); with nothing
+ * buffered it returns 0 (EOF) once every write end is closed, and would
+ * block otherwise.  A write takes as much as fits; it fails -EPIPE once
+ * every read end is closed, and would block while the ring is full — or,
+ * for a write of at most PIPE_BUF bytes, while it does not fit whole, so
+ * small writes are never split or interleaved.  Short counts are normal:
+ * the userland write() loops over them.
+ *
+ * pipe_read / pipe_write never sleep; "would block" is -EAGAIN.  The fd
+ * layer then calls pipe_wait(), which re-checks under the pipe's lock and
+ * parks the thread on the end's wait queue with a syscall retry armed
+ * (the ntfn / event pattern), so the retried read or write simply runs
+ * again.  Data moves between the ring and a caller-supplied kernel buffer;
+ * the user copies happen outside every lock.
+ *
+ * readers / writers count the fd entries holding each end: pipe_create()
+ * starts with one of each, spawn inheritance adds (pipe_open_end), close
+ * and process teardown drop (pipe_close_end) and wake the other side.
+ * refs counts the ends plus calls in flight, so closing the last fd while
+ * another thread of the process is inside read() cannot recycle the slot
+ * under it.  Pipes come from a fixed table.
+ *
+ * Event sets watching a pipe fd (EV_SRC_FD) are woken through
+ * event_notify_obj() whenever an end goes from not ready to ready.
+ *
+ * Locking: space->fd_lock -> pipe_table_lock -> pipe->lock -> wq.lock.
+ * event_notify_obj() is called with no pipe lock held.
+ */
+#ifndef _KERNEL_PIPE_H
+#define _KERNEL_PIPE_H
+
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+
+#define MAX_PIPES 32
+#define PIPE_SIZE 4096 /* one page */
+
+struct pipe {
+  spinlock_t lock;     /* everything below but refs */
+  int refs;            /* pipe_table_lock: ends + calls in flight; 0 = free */
+  int readers;         /* fd entries holding the read end */
+  int writers;         /* fd entries holding the write end */
+  uint32_t head, tail; /* free running: bytes ever read / ever written */
+  uint8_t *buf;        /* PIPE_SIZE bytes */
+  struct wait_queue_head rd_wq, wr_wq;
+};
+
+void pipe_init(void);
+/* pipe_create - a new pipe holding one read and one write end, or NULL
+ * (-ENFILE: table full, or no page for the ring). */
+struct pipe *pipe_create(void);
+/* pipe_get / pipe_put - reference for one call in flight. */
+void pipe_get(struct pipe *p);
+void pipe_put(struct pipe *p);
+/* pipe_open_end / pipe_close_end - one more / one fewer fd entry holds the
+ * read (write = 0) or write end.  The last close frees the pipe. */
+void pipe_open_end(struct pipe *p, int write);
+void pipe_close_end(struct pipe *p, int write);
+/* pipe_read - move up to n buffered bytes into k: count, 0 at EOF, or
+ * -EAGAIN.  pipe_write - queue up to n bytes from k: count, -EPIPE or
+ * -EAGAIN. */
+long pipe_read(struct pipe *p, void *k, size_t n);
+long pipe_write(struct pipe *p, const void *k, size_t n);
+/* pipe_wait - after -EAGAIN from a read (write = 0) or an n-byte write:
+ * park on the end with a syscall retry armed and return 1, or return 0
+ * if the pipe became ready meanwhile (the caller arms the retry). */
+int pipe_wait(struct pipe *p, int write, size_t n);
+/* pipe_poll - EV_IN / EV_OUT readiness of the read / write end. */
+uint32_t pipe_poll(struct pipe *p, int write);
+
+#endif /* _KERNEL_PIPE_H */
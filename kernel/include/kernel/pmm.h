@@ -63,11 +63,11 @@
  *
  * refcount: set to 1 on allocation, decremented on pmm_free_page().  If it
  *           reaches 0 the page is returned to its zone bitmap.  In practice
- *           it is never incremented above 1 because there is no vmm_map path
- *           that increments it (frame sharing is not implemented).
- *           NOTE(MM-VMM-04): vmm_destroy_pgd does not decrement refcount for
- *           user-mapped frames; those pages therefore never reach refcount 0
- *           and are never freed on process exit.
+ *           it only goes above 1 for frames shared between address spaces
+ *           (IPC channels, kernel/channel.h), one reference per mapping
+ *           taken with pmm_get_page().
+ *           vmm_destroy_pgd drops one reference per PTE_USER frame, so a
+ *           shared frame outlives the first address space that dies.
  *
  * lru, priv: currently unused; reserved for a future page-cache integration.
  */
@@ -148,6 +148,10 @@ void *pmm_alloc_pages(size_t count);
 /* Free a single page; poisons with 0xCC; panics on double-free. */
 void pmm_free_page(void *page);
 
+/* Take an extra reference on an allocated page (shared mappings); each
+ * pmm_free_page() drops one and the last frees the frame. */
+void pmm_get_page(void *page);
+
 /* Free multiple contiguous pages */
 /* Free 'count' contiguous pages starting at 'page'; calls pmm_free_page()
  * for each page independently (not an atomic bulk operation). */
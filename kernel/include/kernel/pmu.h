@@ -0,0 +1,78 @@
+/*
+ * kernel/include/kernel/pmu.h
+ * Per-thread hardware performance counters (arch HAL + generic folds;
+ * events and SYS_PMU ops in include/api/pmu.h, generic part in
+ * kernel/core/pmu.c).
+ *
+ * Each CPU's PMU counts the PMU_* events free-running, in kernel and user
+ * mode, and nothing ever writes the counters back.  A thread's counts are
+ * virtualized by folding instead: at every context switch and every tick
+ * the CPU reads its counters, adds the difference since the previous fold
+ * (cpu_info.pmu_last) to the thread that was current, and keeps the new
+ * values.  Leaving the hardware alone means a switch costs a few counter
+ * reads and no writes; the tick fold keeps a thread that runs for seconds
+ * without switching from outrunning a 32-bit counter, and bounds how stale
+ * another thread's counts can be.
+ *
+ * Locking: the fold runs on the owning CPU with IRQs masked.  The
+ * process.pmu_count words are stored atomically so that a reader on another
+ * CPU (SYS_PMU under rcu_read_lock) never sees a torn value.
+ */
+#ifndef _KERNEL_PMU_H
+#define _KERNEL_PMU_H
+
+#include <pmu.h>
+#include <kernel/types.h>
+
+struct process;
+
+/* struct pmu_hw - what arch_pmu_probe() found; identical on every CPU. */
+struct pmu_hw {
+  uint32_t events;    /* PMU_EV() bits counted */
+  uint32_t version;   /* arch PMU version, 0 if none */
+  uint32_t ncounters; /* programmable counters */
+  uint32_t pad;
+  /* Counter widths: a raw difference is taken modulo mask + 1 (0 for an
+   * event that is not counted). */
+  uint64_t mask[PMU_NR_EVENTS];
+};
+
+extern struct pmu_hw pmu_hw;
+
+/* arch_pmu_probe - describe the PMU in *hw and fix which counter counts
+ * each event.  Once, on the BSP, before any CPU starts its counters: the
+ * mapping is shared and read by every fold, so no CPU rewrites it later. */
+void arch_pmu_probe(struct pmu_hw *hw);
+
+/* arch_pmu_start_cpu - program and start this CPU's counters as
+ * arch_pmu_probe() assigned them.  Every CPU, BSP included. */
+void arch_pmu_start_cpu(const struct pmu_hw *hw);
+
+/* arch_pmu_read - this CPU's raw counter values; 0 for events not counted.
+ * IRQs masked. */
+void arch_pmu_read(uint64_t raw[PMU_NR_EVENTS]);
+
+/* pmu_init_cpu - arch_pmu_probe() on the BSP, then arch_pmu_start_cpu()
+ * and the first fold baseline.  Called from arch_cpu_init() on every core
+ * once get_cpu_info() works; the BSP's call precedes every AP's. */
+void pmu_init_cpu(void);
+
+#define pmu_on() __builtin_expect(pmu_hw.events != 0, 1)
+
+/* __pmu_fold - charge this CPU's counts since the last fold to p (NULL:
+ * nobody).  IRQs masked. */
+void __pmu_fold(struct process *p);
+
+/* pmu_switch - schedule(): prev is leaving the CPU (NULL if reaped). */
+static inline void pmu_switch(struct process *prev) {
+  if (pmu_on())
+    __pmu_fold(prev);
+}
+
+/* pmu_tick - kernel_timer_tick(): fold into the current thread. */
+void pmu_tick(void);
+
+/* sys_pmu - SYS_PMU(op, a1, a2), include/api/pmu.h. */
+long sys_pmu(int op, uint64_t a1, uint64_t a2);
+
+#endif /* _KERNEL_PMU_H */
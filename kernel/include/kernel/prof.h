@@ -0,0 +1,52 @@
+/*
+ * kernel/include/kernel/prof.h
+ * Sampling profiler (SYS_PROF; record format and ops in include/api/prof.h,
+ * rings in kernel/lib/prof.c).
+ *
+ * prof_hz is the sampling rate, 0 while stopped.  The arch timer interrupt
+ * reads it: it runs the per-CPU timer at that rate (amd64 idt.c/apic.c,
+ * aarch64 drivers/timer/timer.c), calls __prof_sample() on each interrupt
+ * and hands only the HZ-rate ones to kernel_timer_tick().  While stopped
+ * the check is one load and a branch predicted not-taken.
+ *
+ * __prof_sample() appends to the CURRENT CPU's ring with the trace ring
+ * protocol (kernel/trace.h): IRQ context is the single producer, the
+ * SYS_PROF reader under prof_lock the single consumer.
+ */
+#ifndef _KERNEL_PROF_H
+#define _KERNEL_PROF_H
+
+#include <prof.h>
+
+#define PROF_RING_SAMPLES 2048 /* per CPU, power of two (192 KiB) */
+
+#ifndef __ASSEMBLER__
+
+#include <kernel/types.h>
+
+struct pt_regs;
+
+/* prof_hz: samples per second per CPU, 0 when off. */
+extern uint32_t prof_hz;
+
+/* __prof_sample - record regs in this CPU's ring.  Timer IRQ context only;
+ * the timer code checks prof_rate() first, since it needs the rate anyway
+ * to pace the interrupts. */
+void __prof_sample(struct pt_regs *regs);
+
+#define prof_rate() __atomic_load_n(&prof_hz, __ATOMIC_RELAXED)
+
+/* prof_cpu_online - a CPU came up: give it a ring if sampling is on (boot
+ * profiling starts before the secondaries exist). */
+void prof_cpu_online(void);
+
+/* prof_boot_start - start sampling at hz from kernel_main once the heap is
+ * up (make PROF_BOOT=<hz>). */
+void prof_boot_start(uint32_t hz);
+
+/* sys_prof - SYS_PROF(op, a1, a2), include/api/prof.h. */
+long sys_prof(int op, uint64_t a1, uint64_t a2);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* _KERNEL_PROF_H */
@@ -0,0 +1,75 @@
+/*
+ * kernel/include/kernel/rcu.h
+ * Read-copy-update for read-mostly kernel tables.
+ *
+ * Readers bracket a lookup with rcu_read_lock/rcu_read_unlock and fetch
+ * published pointers with rcu_dereference.  They take no lock and write no
+ * shared memory: the read side only masks IRQs on the local CPU (the kernel
+ * is preemptible from the timer tick, so an unmasked reader could be
+ * switched out mid-lookup).  Sections nest, must not sleep or block, and
+ * should stay short: they delay the tick like any irqsave section.
+ *
+ * Writers still serialise among themselves with their own lock.  They
+ * publish a fully initialised object with rcu_assign_pointer, unlink the
+ * old one, and hand it to call_rcu (or wait in synchronize_rcu) before
+ * freeing it.
+ *
+ * Quiescent states (kernel/lib/rcu.c): a CPU is outside every read section
+ * whenever it enters schedule(), runs the idle loop, or takes the timer
+ * tick (IRQs were on when the tick arrived).  A grace period ends once
+ * every CPU that was online when it started has passed one.  Callbacks
+ * queue on per-CPU lists and run from that CPU's tick, in IRQ context,
+ * after the grace period that covers them.
+ */
+#ifndef _KERNEL_RCU_H
+#define _KERNEL_RCU_H
+
+#include <kernel/arch.h>
+#include <kernel/types.h>
+
+struct cpu_info;
+
+struct rcu_head {
+  struct rcu_head *next;
+  void (*func)(struct rcu_head *head);
+};
+
+static inline void rcu_read_lock(uint64_t *flags) {
+  hal_irq_save(flags);
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline void rcu_read_unlock(uint64_t flags) {
+  __atomic_signal_fence(__ATOMIC_SEQ_CST);
+  hal_irq_restore(flags);
+}
+
+/* Load a published pointer; dependent loads see the object's contents. */
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_ACQUIRE)
+
+/* Publish v: everything written to *v before this is visible to readers. */
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+/* call_rcu - run func(head) after a grace period.  Any context; func runs
+ * in IRQ context on this CPU and must not block. */
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head));
+
+/* synchronize_rcu - wait until every reader that might hold an unpublished
+ * pointer has finished.  Never call it inside a read section, or while
+ * holding a lock that readers take. */
+void synchronize_rcu(void);
+
+/* rcu_poll_start - request a grace period covering every reader running
+ * now; rcu_poll_done(cookie) turns nonzero once it has ended.  The pair is
+ * synchronize_rcu without the wait, for callers that must not spin. */
+uint32_t rcu_poll_start(void);
+int rcu_poll_done(uint32_t cookie);
+
+/* rcu_note_qs - report a quiescent state for cpu.  IRQs masked. */
+void rcu_note_qs(struct cpu_info *cpu);
+
+/* rcu_tick - per-CPU timer tick hook: quiescent state, then advance and
+ * run this CPU's callbacks. */
+void rcu_tick(struct cpu_info *cpu);
+
+#endif /* _KERNEL_RCU_H */
@@ -1,6 +1,7 @@
 #ifndef _KERNEL_REGISTRY_H
 #define _KERNEL_REGISTRY_H
 
+#include <kernel/rcu.h>
 #include <kernel/types.h>
 
 #define MAX_REGISTRY_KEYS 128
@@ -11,9 +12,18 @@
 #define REG_OP_READ 0
 #define REG_OP_WRITE 1
 
+/* A value is immutable once published; an update publishes a new one and
+ * returns the old one to the pool after an RCU grace period. */
+struct registry_value {
+  char text[MAX_VAL_LEN];
+  struct rcu_head rcu; /* also the free-list link */
+};
+
+/* key, owner_pid and used are written once, before used is set (release);
+ * value is RCU-published. */
 struct registry_entry {
   char key[MAX_KEY_LEN];
-  char value[MAX_VAL_LEN];
+  struct registry_value *value;
   int used;
   /* owner_pid: PID that created the key (LIB-REG-02/USR-SEC-01).
    * 0 = kernel/system owner.  Only the owner (or a kernel/system caller,
@@ -2,10 +2,13 @@
 #define _KERNEL_SCHED_H
 
 #include <kernel/fd.h>
+#include <kernel/futex.h>
 #include <kernel/list.h>
+#include <kernel/rcu.h>
 #include <kernel/spinlock.h>
 #include <kernel/types.h>
 #include <stdint.h>
+#include <pmu.h>
 #pragma GCC optimize("O2")
 
 #define PROCESS_NAME_MAX 32
@@ -22,10 +25,7 @@ struct ps_info {
   int on_cpu;
 };
 
-struct ipc_node {
-  struct ipc_message msg;
-  struct list_head list;
-};
+struct ipc_ring; /* kernel/ipc_ring.h */
 
 /* Architecture-specific register frame layout */
 #include <arch/pt_regs.h>
@@ -38,17 +38,95 @@ struct wait_queue_head {
   spinlock_t lock;
 };
 
-/* Process Control Block */
+/* Endpoint capability handles per process (kernel/endpoint.h). */
+#define NPROC_HANDLES 16
+struct endpoint;
+
+/* Mapped IPC channels per process (kernel/channel.h). */
+#define NPROC_CHANNELS 8
+struct channel;
+
+/* Event-set handles per process (kernel/event.h). */
+#define NPROC_EVSETS 4
+struct evset;
+struct uring; /* kernel/uring.h */
+/* Notification handles per process (SYS_NTFN, kernel/ntfn.h). */
+#define NPROC_NTFNS 8
+struct ntfn;
+
+/* Threads per process (thread group), leader included.  Bounds the join
+ * table below; each thread also takes one process_pool slot. */
+#define MAX_THREADS_PER_PROC 16
+
+/* Join record for one non-leader thread (proc_space.threads). */
+struct thread_rec {
+  int tid;       /* 0 = free slot */
+  int exited;    /* set by thread exit/teardown, consumed by join */
+  int exit_code;
+};
+
+/*
+ * struct proc_space - everything the threads of one process share: the
+ * address space, the heap break, the working directory and the fd table.
+ * A single-threaded process is a group of one.  Allocated by
+ * process_create(); every thread holds one reference (users) and the last
+ * one out destroys the PGD and frees the space (space_put in process.c).
+ */
+struct proc_space {
+  uint64_t *page_table; /* PGD (kernel VA); NULL for kernel threads */
+  uint64_t heap_start;  /* Base address of user heap */
+  uint64_t heap_end;    /* Current end of user heap */
+  spinlock_t mm_lock;   /* Protects page table modifications and the break */
+  int users;            /* threads referencing this space (thread_lock) */
+  int tgid;             /* PID of the group leader */
+
+  /* Filesystem state */
+  char cwd[128]; /* Current Working Directory */
+
+  /* File-descriptor table (ABI-03, kernel/fd.h).  0/1/2 pre-opened by
+   * process_create(); only pipe ends hold kernel objects, closed by
+   * process_fd_release() when the space dies.  fd_lock serialises slot
+   * allocation and close between sibling threads. */
+  spinlock_t fd_lock;
+  struct fd_entry fds[NPROC_FDS];
+
+  /* IPC endpoint handles (EP_CREATE / EP_OPEN): each holds a reference on
+   * the endpoint, dropped by EP_CLOSE or when the space dies. */
+  spinlock_t handle_lock;
+  struct endpoint *handles[NPROC_HANDLES];
+  /* Shared-memory channels (SYS_CHANNEL), also under handle_lock: slot i
+   * is mapped at CHAN_VA(i) and holds one reference on the channel. */
+  struct channel *chans[NPROC_CHANNELS];
+  /* Event sets (SYS_EVENT), also under handle_lock; each holds a reference
+   * dropped by EV_CLOSE or when the space dies. */
+  struct evset *evsets[NPROC_EVSETS];
+  /* Notification objects (SYS_NTFN), also under handle_lock; each holds a
+   * reference dropped by NTFN_CLOSE or when the space dies. */
+  struct ntfn *ntfns[NPROC_NTFNS];
+  /* Syscall ring (SYS_URING), also under handle_lock; holds one reference
+   * dropped by URING_DESTROY or when the space dies. */
+  struct uring *uring;
+
+  /* Thread bookkeeping (SYS_THREAD_*), protected by thread_lock. */
+  spinlock_t thread_lock;
+  int nthreads; /* live threads, leader included */
+  struct thread_rec threads[MAX_THREADS_PER_PROC];
+};
+
+/* Process Control Block: one schedulable thread.  Per-process resources live
+ * in the shared proc_space. */
 struct process {
-  uint32_t pid;
+  uint32_t pid;  /* thread id; unique, never reused */
+  int tgid;      /* thread group id: the leader's pid (== pid for a leader) */
   char name[PROCESS_NAME_MAX];
 
   /* Memory */
-  uint64_t *page_table;  /* Physical address of TTBR0_EL1 */
+  struct proc_space *space; /* shared address space / fd table (never NULL) */
+  uint64_t *page_table;  /* == space->page_table, immutable for the space's
+                          * lifetime; cached here for the switch and uaccess
+                          * hot paths */
   uint64_t kernel_stack; /* Kernel stack top */
-  uint64_t heap_start;   /* Base address of user heap */
-  uint64_t heap_end;     /* Current end of user heap */
-  spinlock_t mm_lock;    /* Protects page table modifications */
+  uint64_t tls_base;     /* TLS register value (TPIDR_EL0 / FS base) */
 
   /* Context for switching */
   struct pt_regs *context;
@@ -64,6 +142,25 @@ struct process {
   int time_slice;    /* Ticks remaining */
   int quantum_reset; /* Reset value */
 
+  /* Scheduling class (include/api/sched.h).  policy / rt_prio / the
+   * reservation change under the owning CPU's sched_lock; rt_budget is the
+   * ticks left in the period ending at rt_period_end (jiffies), charged by
+   * sched_tick(). */
+  int policy;
+  int rt_prio;
+  int rt_runtime, rt_period; /* ticks */
+  int rt_budget;
+  uint64_t rt_period_end;
+  /* Priority inheritance (see "rank" below).  pi_rank: the best rank lent
+   * by threads blocked on this one (PI_NONE if none), under sched_lock.
+   * pi_donee: holder this thread lends to while queued on a FUTEX_WAIT_PI
+   * (set under sched_lock by pi_boost, cleared on the next futex wait).
+   * rq_rank: the rank this thread was queued at (which queue run_list is
+   * on), under the owning CPU's sched_lock. */
+  int pi_rank;
+  int pi_donee;
+  int rq_rank;
+
   uint8_t level;  /* privilege level (PLVL_*) — see the capability model below */
   uint32_t caps;  /* capability mask (CAP_*); machine level bypasses checks */
   /* ctty_win: controlling-terminal window (USR-TTY-01 #123).  Inherited from
@@ -86,29 +183,58 @@ struct process {
   /* Scheduler List */
   struct list_head run_list;
   struct process *next; /* Legacy Linked list (remove later?) */
+  struct rcu_head rcu;  /* frees the descriptor after lockless pool readers */
 
   /* Wait Queue (for sleeping) */
   struct wait_queue_head *wait_queue_ptr;
   struct wait_queue_head wait_queue;
 
+  /* SYS_THREAD_JOIN: tid this thread sleeps on (0 when not joining). */
+  int join_tid;
+
+  /* SYS_FUTEX: this thread's entry in a futex bucket (kernel/futex.h). */
+  struct futex_waiter futex;
+
+  /* SYS_EVENT (kernel/event.h): the set this thread is scanning or blocked
+   * in (NULL otherwise; senders wake it), the EV_WAIT deadline in jiffies
+   * (0 = none) and the timer armed for the nearest expiry. */
+  struct evset *ev_set;
+  uint64_t ev_deadline;
+  int ev_timed;
+  struct timer ev_timer;
+
+  /* Notification bound to an endpoint this thread serves (NTFN_BIND):
+   * its pending bits are delivered by receive-from-any.  Changed under
+   * both the notification's lock and msg_lock. */
+  struct ntfn *bound_ntfn;
+
   /* IPC state */
   int ipc_target_pid; /* PID we want to talk to (-1 for ANY) */
   struct ipc_message
       *ipc_msg; /* User-space pointer to message (for synchronous RECV) */
-  struct list_head msg_queue; /* Buffered incoming messages */
-  spinlock_t msg_lock;        /* Message queue protection */
+  /* SYS_CALL / SYS_REPLY_RECV: IPC_WAIT_* this thread is blocked in.  While
+   * non-zero a sender delivers straight into ipc_msg and completes the
+   * syscall (return register in 'context'); guarded by msg_lock. */
+  int ipc_wait;
+  struct ipc_ring *msg_ring;         /* Buffered incoming messages (bounded) */
+  struct wait_queue_head msg_space;  /* Senders blocked on a full msg_ring */
+  spinlock_t msg_lock;               /* Guards msg_ring, msg_space, ipc_wait */
+  /* Set under msg_lock when the thread starts dying; lockless (RCU) senders
+   * check it there and give up, so nothing is delivered after the drain. */
+  int msg_closed;
 
   /* SMP state */
   int on_cpu; /* CPU ID running this process, -1 if none */
 
-  /* Filesystem state */
-  char cwd[128]; /* Current Working Directory */
+  /* Lazy FP/SIMD state (kernel/fpu.h).  fpu_state is the arch save area,
+   * allocated on the task's first FP/SIMD instruction (NULL = never used);
+   * fpu_cpu is the CPU whose registers were last loaded from it (-1 none). */
+  void *fpu_state;
+  int fpu_cpu;
 
-  /* File-descriptor table (ABI-03, kernel/fd.h).  0/1/2 pre-opened by
-   * process_create(); entries hold no kernel-owned resources, so teardown
-   * needs no cleanup pass.  Touched only by the owning process from
-   * syscall context — no lock. */
-  struct fd_entry fds[NPROC_FDS];
+  /* Hardware event counts while this thread ran (kernel/pmu.h), indexed
+   * by PMU_*.  Written by the CPU running it, read by SYS_PMU. */
+  uint64_t pmu_count[PMU_NR_EVENTS];
 };
 
 /* Process States */
@@ -120,6 +246,20 @@ struct process {
 #define PROC_DEAD 5
 #define PROC_READY 6
 
+/* Scheduling rank: one order over both classes, lower runs first.  Ranks
+ * 0 .. RT_PRIO_LEVELS-1 are the RT queues (a SCHED_RT thread with budget
+ * left), RT_PRIO_LEVELS + priority the normal ones.  A thread runs at the
+ * better of its own rank and pi_rank: a thread blocked in SYS_CALL /
+ * EP_CALL or a recv() from one pid, or on a FUTEX_WAIT_PI, lends its rank
+ * to the thread it waits for, transitively along a chain of such waits. */
+#define PI_NONE 0x7fff
+#define PI_CHAIN_MAX 8
+
+/* SCHED_RT per-CPU throttle: RT threads get at most RT_CPU_RUNTIME of
+ * every RT_CPU_PERIOD ticks on a CPU that has other runnable work. */
+#define RT_CPU_PERIOD  100
+#define RT_CPU_RUNTIME 95
+
 /* Process Priorities */
 #define PROC_PRIO_SYSTEM 0 /* Kernel-level service */
 #define PROC_PRIO_ROOT 1   /* Root shells/services */
@@ -130,6 +270,7 @@ struct process {
  * and capability bits (CAP_*) live in the shared api header so the kernel and
  * userland cannot drift. */
 #include <caps.h>
+#include <sched.h>
 
 /* Capability helpers.  A NULL process is the kernel-internal context and is
  * treated as fully privileged, matching the historical bypass. */
@@ -181,6 +322,8 @@ int process_kill_allowed(struct process *caller, int target_pid);
  * caller holds CAP_IPC_ANY, or target is the caller's parent or a
  * descendant.  Acquires sched_lock internally. */
 int process_ipc_allowed(struct process *caller, int target_pid);
+/* process_terminate: kill one thread; killing a group leader (pid == tgid)
+ * takes every thread of the process with it. */
 int process_terminate(int pid);
 int process_wait(
     int pid); /* Wait for process, returns status or -1 if active */
@@ -193,6 +336,27 @@ extern int process_load_elf_args(struct process *proc, const char *path,
 void start_user_process(struct process *proc);
 void process_init(void);
 struct pt_regs *schedule(struct pt_regs *regs);
+/* sched_tick - charge the ending tick to the running thread's SCHED_RT
+ * budget and this CPU's RT window.  kernel_timer_tick(), before schedule(). */
+void sched_tick(void);
+/* sched_setattr / sched_getattr - SYS_SCHED_SETATTR / GETATTR on thread pid
+ * (0 = current), kernel-side attr; see include/api/sched.h. */
+long sched_setattr(int pid, const struct sched_attr *attr);
+long sched_getattr(int pid, struct sched_attr *attr);
+/* pi_boost - the current thread has just blocked waiting for thread tid:
+ * lend it our rank, and along tid's own chain of waits.  Raise only; a
+ * boosted thread gives the boost back in pi_settle().  futex: tid is a
+ * FUTEX_WAIT_PI holder named by user memory, accepted (as pi_donee) only if
+ * it is another thread of our own process.  No locks held. */
+void pi_boost(int tid, int futex);
+/* pi_settle - recompute p's inherited rank from the threads still blocked
+ * on it.  Cheap unless p is boosted.  Called by p itself when it goes back
+ * to serving (receive) or releases a PI futex.  No locks held. */
+void pi_settle(struct process *p);
+/* pi_withdraw - a thread that lent its rank to thread tid stopped waiting
+ * (woken, timed out or killed): tid re-derives its inherited rank without
+ * it.  No-op for tid <= 0.  No locks held. */
+void pi_withdraw(int tid);
 
 /* Exception Handlers */
 struct pt_regs *syscall_handler(struct pt_regs *frame);
@@ -203,12 +367,14 @@ struct pt_regs *sync_handler(struct pt_regs *frame);
 void enqueue_task(struct process *p);
 void sleep_on(struct wait_queue_head *wq);
 void wake_up(struct wait_queue_head *wq);
+void wait_queue_block(struct wait_queue_head *wq);
+void wait_queue_wake(struct wait_queue_head *wq, int all);
 
 /* Core Tasks */
 void idle_task_entry(void);
 
 /* Syscalls */
-int sys_ipc_send(int target_pid, void *msg_ptr);
+int sys_ipc_send(int target_pid, void *msg_ptr, int flags);
 /* sys_ipc_recv returns IPC_RECV_RETRY when it annotated a syscall retry
  * (blocked, or a message slipped in during the sleep window).  The
  * dispatcher must NOT write a return value in that case: on aarch64 x0 is
@@ -218,10 +384,77 @@ int sys_ipc_send(int target_pid, void *msg_ptr);
 #define IPC_RECV_RETRY 1
 int sys_ipc_recv(int src_pid, void *msg_ptr);
 int sys_ipc_try_recv(int src_pid, void *msg_ptr);
+/* kernel_ipc_send never blocks: -EAGAIN when the target's ring is full,
+ * -1 when there is no such target.  sys_ipc_send blocks on a full ring
+ * (unless IPC_NONBLOCK) and then returns IPC_SEND_RETRY with a retry armed;
+ * the dispatcher handles it like IPC_RECV_RETRY. */
+#define IPC_SEND_RETRY 1
 int kernel_ipc_send(int target_pid, struct ipc_message *msg);
-struct ipc_node *pop_message(struct process *proc, int src_pid);
+/* ipc_has_message - is a message from src_pid (-1 = any) buffered for p?
+ * Pending bits of p's bound notification count as one from the kernel. */
+int ipc_has_message(struct process *p, int src_pid);
+/* ipc_notify_thread - p's bound notification has bits pending: complete
+ * the receive-from-any p is blocked in, or wake it.  Caller holds the
+ * notification's lock (keeps p bound, hence alive). */
+void ipc_notify_thread(struct process *p);
+/* kernel_ipc_ep_send - non-blocking send of a kernel-built message through
+ * the current process's endpoint handle h (-EBADF, -EAGAIN if unbound or
+ * full).  *server_tgid is set to the bound server's tgid (release) before
+ * the message becomes visible to it; on failure it may still be set. */
+int kernel_ipc_ep_send(int h, struct ipc_message *msg, int *server_tgid);
+/* ipc_wait_message - the blocking half of a receive: sleep in IPC_WAIT_QUEUE
+ * unless a message from src_pid (-1 = any) is already buffered.  The caller
+ * arms the syscall retry and calls schedule(). */
+void ipc_wait_message(int src_pid);
+long sys_ipc_set_depth(unsigned int depth);
+
+/* Synchronous call/reply IPC (SYS_CALL, SYS_REPLY_RECV).  process.ipc_wait:
+ *   IPC_WAIT_RECV   blocked in SYS_REPLY_RECV for the next request
+ *   IPC_WAIT_REPLY  blocked in SYS_CALL for the reply from ipc_target_pid
+ * Both return IPC_CALL_PENDING when the caller blocked: the dispatcher must
+ * call schedule() and leave the return register alone — whoever completes
+ * the call writes it.  Unlike IPC_RECV_RETRY no retry is armed. */
+#define IPC_WAIT_NONE  0
+#define IPC_WAIT_RECV  1
+#define IPC_WAIT_REPLY 2
+#define IPC_WAIT_QUEUE 3 /* SYS_RECV / read(stdin): woken by any buffered send */
+#define IPC_CALL_PENDING 1
+struct pt_regs;
+long sys_ipc_call(struct pt_regs *frame, int dest_pid, void *msg_ptr);
+long sys_ipc_reply_recv(struct pt_regs *frame, int reply_pid, void *msg_ptr);
+long sys_ipc_ep_send(int h, void *msg_ptr, int flags);
+long sys_ipc_ep_call(struct pt_regs *frame, int h, void *msg_ptr);
+/* pop_message: take the oldest buffered message from src_pid (-1 = any)
+ * into *out — for -1, pending bound-notification bits first; 0, or -1 if
+ * there is none. */
+int pop_message(struct process *proc, int src_pid, struct ipc_message *out);
 extern int keyboard_focus_pid;
 long sys_getprocs(struct ps_info *user_buf, size_t max_count);
 long sys_sbrk(intptr_t increment);
 
+/* Threads (SYS_THREAD_*).  sys_thread_join returns THREAD_JOIN_RETRY when it
+ * blocked with a syscall retry armed; like IPC_RECV_RETRY the dispatcher must
+ * then leave the return register alone. */
+#define THREAD_JOIN_RETRY 1
+long sys_thread_create(uint64_t entry, uint64_t stack_top, uint64_t arg0,
+                       uint64_t arg1, uint64_t tls);
+void sys_thread_exit(int code);
+long sys_thread_join(int tid, int *code_out);
+long sys_set_tls(uint64_t base);
+
+/* Kernel-mode threads of a user process (the SYS_URING poller).
+ * thread_create_kernel starts fn(arg) in kernel mode as a new thread of
+ * the caller's group: same space and credentials, its own kernel stack, no
+ * join record; it is killed with the process.  thread_sleep_kernel parks
+ * it on wq — the caller took wq->lock with spin_lock_irqsave(&flags) and
+ * found nothing to do — and returns once woken (wait_queue_wake).
+ * thread_exit_kernel ends it. */
+struct process *thread_create_kernel(void (*fn)(void *), void *arg);
+void thread_sleep_kernel(struct wait_queue_head *wq, uint64_t flags);
+void thread_exit_kernel(void) __attribute__((noreturn));
+
+/* wake_sleeping_task: SLEEPING -> runnable, safe against a sleeper that is
+ * still current on its CPU.  IRQs masked; caller keeps p alive. */
+void wake_sleeping_task(struct process *p);
+
 #endif
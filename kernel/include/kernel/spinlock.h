@@ -1,6 +1,35 @@
 /*
  * kernel/include/kernel/spinlock.h
- * Simple spinlock implementation for AArch64
+ * Fair spinlocks: ticket locks, and MCS-style queued locks for the hot
+ * global ones.
+ *
+ * Every spinlock_t is a ticket lock unless defined with DEFINE_QSPINLOCK.
+ * spin_lock takes the next ticket with one fetch-add and waits for owner
+ * to reach it; spin_unlock bumps owner with a plain release store.  Waiters
+ * are served in arrival order, so no CPU can be starved, and the only RMW
+ * per acquisition is the fetch-add.  While waiting, a CPU only reads the
+ * lock word: arch_spin_wait() is WFE on aarch64 (woken by the owner's
+ * store clearing its exclusive monitor, the implicit SEV) and PAUSE on
+ * amd64.
+ *
+ * A queued lock (DEFINE_QSPINLOCK: sched_lock, kmalloc_lock,
+ * compositor_lock, virtio_blk_lock) keeps the uncontended path to one
+ * compare-and-swap, but a CPU that finds it held joins an MCS queue of
+ * per-CPU nodes (kernel/lib/spinlock.c) and spins on its OWN node: one
+ * cache-line transfer per hand-off instead of every waiter re-reading the
+ * lock word.  Only the queue head watches the lock word.  FIFO as well.
+ *
+ * Lock word:  ticket  bits 0..15 owner, 16..31 next ticket
+ *             queued  bits 0..7 locked, 16..31 queue tail (CPU id + 1)
+ * All-zero is unlocked in both layouts, so zeroed memory is a valid lock.
+ *
+ * Lock statistics (make LOCKSTAT=1, CONFIG_LOCKSTAT): every named lock
+ * (DEFINE_SPINLOCK / DEFINE_QSPINLOCK) counts acquisitions, contended
+ * acquisitions, and total / max wait and hold time in arch_timer_get_count()
+ * ticks.  The counters are updated by the lock holder, so they need no
+ * atomics.  A lock registers itself on its first acquisition; SYS_LOCKSTAT
+ * (the shell's `lockstat`) prints and optionally resets them.  Locks set up
+ * with spin_lock_init() are not tracked: many live in freed memory.
  */
 #ifndef _KERNEL_SPINLOCK_H
 #define _KERNEL_SPINLOCK_H
@@ -9,23 +38,125 @@
 #include <kernel/types.h>
 
 #ifndef __ASSEMBLER__
-typedef struct {
-  volatile uint32_t lock;
+
+#define TICKET_NEXT_ONE (1u << 16)
+#define QLOCK_LOCKED    1u
+#define QLOCK_TAIL_SHIFT 16
+#define QLOCK_TAIL_MASK (0xFFFFu << QLOCK_TAIL_SHIFT)
+
+struct spinlock;
+
+#ifdef CONFIG_LOCKSTAT
+struct lockstat {
+  const char *name;      /* NULL: not tracked */
+  struct spinlock *next; /* lockstat registry */
+  uint32_t registered;
+  uint64_t acquired;
+  uint64_t contended;
+  uint64_t wait_total, wait_max;
+  uint64_t hold_total, hold_max;
+  uint64_t hold_start;
+};
+#define __LOCKSTAT_INIT(n) , .stat = {.name = (n)}
+#else
+#define __LOCKSTAT_INIT(n)
+#endif
+
+typedef struct spinlock {
+  union {
+    volatile uint32_t val;
+    struct {
+      volatile uint16_t owner;
+      volatile uint16_t next;
+    } tkt;
+    volatile uint8_t locked; /* queued lock: QLOCK_LOCKED byte */
+  };
+  uint32_t queued; /* DEFINE_QSPINLOCK */
+#ifdef CONFIG_LOCKSTAT
+  struct lockstat stat;
+#endif
 } spinlock_t;
 
-#define SPINLOCK_INIT {0}
-#define DEFINE_SPINLOCK(x) spinlock_t x = SPINLOCK_INIT
+#define __SPINLOCK_INIT(n, q) {.val = 0, .queued = (q) __LOCKSTAT_INIT(n)}
+#define SPINLOCK_INIT __SPINLOCK_INIT(NULL, 0)
+#define DEFINE_SPINLOCK(x) spinlock_t x = __SPINLOCK_INIT(#x, 0)
+#define DEFINE_QSPINLOCK(x) spinlock_t x = __SPINLOCK_INIT(#x, 1)
 
-static inline void spin_lock_init(spinlock_t *lock) { lock->lock = 0; }
+static inline void spin_lock_init(spinlock_t *lock) {
+  lock->val = 0;
+  lock->queued = 0;
+#ifdef CONFIG_LOCKSTAT
+  lock->stat.name = NULL;
+#endif
+}
 
-static inline void spin_lock(spinlock_t *lock) { arch_spin_lock(&lock->lock); }
+/* __queued_spin_lock_slow - queue behind the current holder (spinlock.c). */
+void __queued_spin_lock_slow(spinlock_t *lock);
+
+#ifdef CONFIG_LOCKSTAT
+void __lockstat_acquired(spinlock_t *lock, uint64_t t0, int contended);
+void __lockstat_release(spinlock_t *lock);
+#endif
+
+/* __spin_lock - take lock; 1 if it had to wait. */
+static inline int __spin_lock(spinlock_t *lock) {
+  if (lock->queued) {
+    uint32_t unlocked = 0;
+    if (__atomic_compare_exchange_n(&lock->val, &unlocked, QLOCK_LOCKED, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      return 0;
+    __queued_spin_lock_slow(lock);
+    return 1;
+  }
+  uint32_t v = __atomic_fetch_add(&lock->val, TICKET_NEXT_ONE,
+                                  __ATOMIC_ACQUIRE);
+  uint16_t me = (uint16_t)(v >> 16);
+  if ((uint16_t)v == me)
+    return 0;
+  while ((uint16_t)(v = __atomic_load_n(&lock->val, __ATOMIC_ACQUIRE)) != me)
+    arch_spin_wait(&lock->val, v);
+  return 1;
+}
+
+static inline void spin_lock(spinlock_t *lock) {
+#ifdef CONFIG_LOCKSTAT
+  uint64_t t0 = arch_timer_get_count();
+  int contended = __spin_lock(lock);
+  __lockstat_acquired(lock, t0, contended);
+#else
+  (void)__spin_lock(lock);
+#endif
+}
 
 static inline void spin_unlock(spinlock_t *lock) {
-  arch_spin_unlock(&lock->lock);
+#ifdef CONFIG_LOCKSTAT
+  __lockstat_release(lock);
+#endif
+  if (lock->queued)
+    __atomic_store_n(&lock->locked, 0, __ATOMIC_RELEASE);
+  else
+    __atomic_store_n(&lock->tkt.owner, (uint16_t)(lock->tkt.owner + 1),
+                     __ATOMIC_RELEASE);
 }
 
 static inline int spin_trylock(spinlock_t *lock) {
-  return arch_spin_trylock(&lock->lock);
+  uint32_t v, want;
+  if (lock->queued) {
+    v = 0;
+    want = QLOCK_LOCKED;
+  } else {
+    v = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+    if ((uint16_t)v != (uint16_t)(v >> 16))
+      return 0;
+    want = v + TICKET_NEXT_ONE;
+  }
+  if (!__atomic_compare_exchange_n(&lock->val, &v, want, 0, __ATOMIC_ACQUIRE,
+                                   __ATOMIC_RELAXED))
+    return 0;
+#ifdef CONFIG_LOCKSTAT
+  __lockstat_acquired(lock, 0, 0);
+#endif
+  return 1;
 }
 
 /* IRQ-safe spinlock */
@@ -47,6 +178,11 @@ static inline void spin_unlock_irqrestore(spinlock_t *lock, uint64_t flags) {
   spin_unlock(lock);
   hal_irq_restore(flags);
 }
+
+/* sys_lockstat - SYS_LOCKSTAT(buf, size, flags): the statistics as text,
+ * one line per lock; LOCKSTAT_RESET (root/machine only) zeroes them after
+ * the copy.  Bytes written, or -ENOSYS when built without CONFIG_LOCKSTAT. */
+long sys_lockstat(char *ubuf, size_t size, int flags);
 #endif
 
 #endif /* _KERNEL_SPINLOCK_H */
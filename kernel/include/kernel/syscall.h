@@ -0,0 +1,68 @@
+/*
+ * kernel/include/kernel/syscall.h
+ * Syscall table (kernel/core/syscall_dispatch.c).
+ *
+ * syscall_table[] is indexed by the SYS_* numbers of <syscall_nums.h>
+ * (designated initializers, so the table cannot drift from the ABI header)
+ * and holds one entry per implemented call:
+ *   fn        value call: gets the arguments, returns the result register.
+ *             Never touches the frame, never blocks with a retry armed.
+ *   frame_fn  frame call: gets the frame and the arguments and returns the
+ *             frame to restore — schedule()'s for blocking / switching calls
+ *             (IPC, futex, exit, yield), which also own the return register.
+ *   nargs     argument registers the call reads; the others are passed as 0.
+ *   flags     SYSCALL_LEAN: a short value call that never enables IRQs,
+ *             sleeps or touches user memory.  The SYSCALL entry on
+ *             amd64 (syscall.S) and the EL0 SVC entry on aarch64
+ *             (exception.S) run these without building a pt_regs.
+ *             The ring consumer calls them like any other value call.
+ *             SYSCALL_URING: a value call that never blocks, so an SQE
+ *             may run it (SYS_URING, syscall_call_nowait()).
+ * Unused slots are all-zero and fail with -ENOSYS.
+ *
+ * #define part is assembler-safe: the entry stubs index the table directly.
+ */
+#ifndef _KERNEL_SYSCALL_H
+#define _KERNEL_SYSCALL_H
+
+#include <syscall_nums.h>
+
+#define SYSCALL_LEAN  1
+#define SYSCALL_URING 2
+
+/* struct syscall_entry layout, for syscall.S (checked in syscall_dispatch.c) */
+#define SYSCALL_ENTRY_SHIFT 5 /* 32-byte entries */
+#define SYSCALL_ENTRY_FN    0
+#define SYSCALL_ENTRY_FLAGS 25
+
+#ifndef __ASSEMBLER__
+
+#include <kernel/types.h>
+#include <arch/pt_regs.h>
+
+typedef long (*syscall_fn_t)(uint64_t, uint64_t, uint64_t, uint64_t, uint64_t,
+                             uint64_t);
+typedef struct pt_regs *(*syscall_frame_fn_t)(struct pt_regs *frame,
+                                              const uint64_t *a);
+
+struct syscall_entry {
+  syscall_fn_t fn;
+  syscall_frame_fn_t frame_fn;
+  const char *name;
+  uint8_t nargs;
+  uint8_t flags;
+};
+
+extern const struct syscall_entry syscall_table[SYS_NR];
+
+struct pt_regs *kernel_syscall_dispatcher(struct pt_regs *frame);
+/* syscall_call_nowait - run syscall nr with arguments a[0..5] outside a
+ * trap, as the current process (the SYS_URING consumer): SYSCALL_URING
+ * entries, plus read / readv / write / writev and SYS_SEND in non-blocking
+ * form (-EAGAIN where the trap would sleep).  -ENOSYS for an unknown nr,
+ * -EINVAL for any other call. */
+long syscall_call_nowait(uint32_t nr, const uint64_t *a);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* _KERNEL_SYSCALL_H */
@@ -27,6 +27,24 @@ extern volatile int ktest_test_failed;
     static const ktest_case_t _test_##test_name = { #test_name, test_name }; \
     void test_name(void)
 
+/*
+ * SMP test cases: run on every online CPU at once, after all of them are
+ * up and before any enables IRQs.  func(cpu, ncpus) is called with cpu
+ * 0 .. ncpus-1 (0 is the BSP).  A case may sync its CPUs with
+ * ktest_smp_barrier(); it must not KASSERT before its last barrier, or a
+ * CPU that returns early leaves the others waiting.
+ */
+typedef struct {
+    const char *name;
+    void (*func)(int cpu, int ncpus);
+} ktest_smp_case_t;
+
+#define KTEST_SMP_CASE(test_name) \
+    void test_name(int cpu, int ncpus); \
+    __attribute__((used, section(".ktests_smp"))) \
+    static const ktest_smp_case_t _test_##test_name = { #test_name, test_name }; \
+    void test_name(int cpu, int ncpus)
+
 /* Assertions */
 #define KASSERT(cond) \
     if (!(cond)) { \
@@ -39,5 +57,13 @@ extern volatile int ktest_test_failed;
 
 /* Runner API */
 void ktest_run_all(void);
+/* ktest_run_smp - the BSP's half of the SMP cases: after arch_smp_init(),
+ * IRQs still masked.  Skipped with a single CPU. */
+void ktest_run_smp(void);
+/* ktest_smp_ap - an AP's half: right after it acknowledged its boot, IRQs
+ * still masked.  Returns once the SMP cases are over. */
+void ktest_smp_ap(void);
+/* ktest_smp_barrier - wait until every CPU in the SMP run has arrived. */
+void ktest_smp_barrier(void);
 
 #endif /* _KERNEL_TEST_H */
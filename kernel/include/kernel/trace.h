@@ -0,0 +1,61 @@
+/*
+ * kernel/include/kernel/trace.h
+ * Scheduler event tracing (SYS_TRACE; record format and ops in
+ * include/api/trace.h, rings in kernel/lib/trace.c).
+ *
+ * Tracepoints sit in schedule() (switch, migrate), the wake paths of
+ * kernel/sched/process.c, the IRQ entries (irq_handler, the amd64 IDT
+ * handler) and kernel_syscall_dispatcher.  trace_event() tests the type's
+ * bit in trace_mask first, so a disabled tracepoint costs one load and one
+ * branch predicted not-taken; only an enabled one calls out.  The lean
+ * syscall paths (amd64 syscall.S, aarch64 exception.S) build no frame and
+ * never reach the dispatcher: they test TRACE_SYS_MASK the same way and
+ * take the full path while syscall events are on.
+ *
+ * __trace_emit() appends one struct trace_event to the CURRENT CPU's ring
+ * with IRQs masked locally and publishes it with a release store of the
+ * ring head — the klog protocol (kernel/klog.h) with fixed-size records:
+ * the owning CPU is the only producer, the SYS_TRACE reader (trace_lock)
+ * the only consumer.  A full ring drops the event and counts it.
+ *
+ * #define part is assembler-safe: the entry stubs test trace_mask directly.
+ */
+#ifndef _KERNEL_TRACE_H
+#define _KERNEL_TRACE_H
+
+#include <trace.h>
+
+#define TRACE_RING_EVENTS 4096 /* per CPU, power of two (96 KiB) */
+
+#define TRACE_SYS_MASK                                                         \
+  ((1 << TRACE_EV_SYS_ENTRY) | (1 << TRACE_EV_SYS_EXIT))
+
+#ifndef __ASSEMBLER__
+
+#include <kernel/types.h>
+
+/* trace_mask: event types being recorded (1 << TRACE_EV_*), 0 when off. */
+extern uint32_t trace_mask;
+
+void __trace_emit(int type, uint32_t pid, uint32_t arg0, uint32_t arg1);
+
+#define trace_on_any(mask) __builtin_expect((trace_mask & (mask)) != 0, 0)
+#define trace_on(type) trace_on_any(1u << (type))
+#define trace_event(type, pid, arg0, arg1)                                     \
+  do {                                                                         \
+    if (trace_on(type))                                                        \
+      __trace_emit((type), (uint32_t)(pid), (uint32_t)(arg0),                  \
+                   (uint32_t)(arg1));                                          \
+  } while (0)
+
+/* trace_tid - the running thread's id, 0 before the first task (needs
+ * kernel/sched.h).  As a trace_event argument it is evaluated only once
+ * the tracepoint is on. */
+#define trace_tid() (current_process ? current_process->pid : 0)
+
+/* sys_trace - SYS_TRACE(op, a1, a2), include/api/trace.h. */
+long sys_trace(int op, uint64_t a1, uint64_t a2);
+
+#endif /* __ASSEMBLER__ */
+
+#endif /* _KERNEL_TRACE_H */
@@ -0,0 +1,58 @@
+/*
+ * kernel/include/kernel/uring.h
+ * Submission / completion rings for batched syscalls (SYS_URING, user
+ * contract and ring layout in include/api/uring.h).
+ *
+ * Each process has at most one ring, mapped at URING_VA just above the
+ * channel window.  Like a channel's, its frames are allocated one page at
+ * a time and referenced once by the ring and once per mapping, so
+ * URING_DESTROY and vmm_destroy_pgd can drop theirs in either order.
+ *
+ * The kernel reads the rings through its own mapping of the frames, never
+ * the user one, and keeps private copies of sq_head and cq_tail: the
+ * shared counters are only published, so a process scribbling over them
+ * can confuse itself but not the kernel.  SQEs run through
+ * syscall_call_nowait() (kernel/syscall.h) as the process itself — from
+ * URING_ENTER in the caller's thread, or from the SQPOLL thread, a
+ * kernel-mode thread of the same group (thread_create_kernel) that shares
+ * its space and credentials.
+ *
+ * Lifetime: refs counts the space's pointer, each URING_ENTER in flight
+ * and a live poller; the last uring_put() frees the frames.  busy admits
+ * one consumer at a time.  A poller killed with its process never drops
+ * its own reference; uring_release_space() does it for it, which is safe
+ * because the space outlives every thread of the group.
+ *
+ * Locking: proc_space.uring is under handle_lock.  The poller sleeps on
+ * poll_wq (thread_sleep_kernel) and is woken with IRQs masked.
+ */
+#ifndef _KERNEL_URING_H
+#define _KERNEL_URING_H
+
+#include <uring.h>
+#include <kernel/channel.h>
+#include <kernel/sched.h>
+
+#define URING_VA        (CHAN_VA_BASE + NPROC_CHANNELS * CHAN_VA_STRIDE)
+#define URING_MAX_PAGES (1 + (URING_ENTRIES_MAX * 64 + 4095) / 4096 + \
+                         (2 * URING_ENTRIES_MAX * 16 + 4095) / 4096)
+
+struct uring {
+  int refs;     /* atomic */
+  int busy;     /* atomic: a consumer is running SQEs */
+  int sqpoll;   /* URING_SETUP_SQPOLL */
+  int stop;     /* the poller must leave */
+  int poller_live; /* atomic: the poller still owes its reference */
+  uint32_t sq_entries, cq_entries;
+  uint32_t sq_head, cq_tail; /* kernel copies of the shared counters */
+  struct wait_queue_head poll_wq;
+  int npages;
+  uint64_t frames[URING_MAX_PAGES]; /* physical */
+};
+
+long sys_uring(int op, uint64_t a1, uint64_t a2, uint64_t a3);
+/* uring_release_space - destroy a dying space's ring.  Its mapping is
+ * left to vmm_destroy_pgd. */
+void uring_release_space(struct proc_space *space);
+
+#endif /* _KERNEL_URING_H */
@@ -191,11 +191,14 @@ void vmm_unmap_page(uint64_t *pgd, uint64_t virt);
  * with a cross-CPU TLB shootdown.  Returns 0, or -1 on a hole in range. */
 int vmm_protect(uint64_t *pgd, uint64_t virt, uint64_t size, uint64_t flags);
 uint64_t vmm_get_phys(uint64_t *pgd, uint64_t virt);
+/* vmm_copy_to_pgd: copy into user memory of another address space through
+ * the direct map (no PGD switch).  0 on success, -1 on a bad range. */
+int vmm_copy_to_pgd(uint64_t *pgd, uint64_t virt, const void *src, size_t n);
 
 struct process;
-/* vmm_map_page_locked: vmm_map_page wrapped with proc->mm_lock. */
+/* vmm_map_page_locked: vmm_map_page wrapped with proc->space->mm_lock. */
 int vmm_map_page_locked(struct process *proc, uint64_t virt, uint64_t phys, uint64_t flags);
-/* vmm_unmap_page_locked: vmm_unmap_page wrapped with proc->mm_lock. */
+/* vmm_unmap_page_locked: vmm_unmap_page wrapped with proc->space->mm_lock. */
 void vmm_unmap_page_locked(struct process *proc, uint64_t virt);
 
 /* vmm_map: map a contiguous range; 4KB pages only; partial on error (no rollback). */
@@ -16,7 +16,7 @@
  *   - current_chip must be set via irq_register_chip() before irq_init() is
  *     called.  All chip ops are guarded by NULL checks.
  *   - irq_handlers[] entries are written by irq_register/irq_unregister only;
- *     they are read from IRQ context in irq_handler/irq_dispatch.
+ *     they are read locklessly from IRQ context in irq_handler/irq_dispatch.
  *   - The timer IRQ (IRQ_TIMER / 30) is handled inline in irq_handler() and
  *     bypasses the irq_handlers[] table.
  *
@@ -35,28 +35,37 @@
  *           irq_handlers[]; dispatch paths copy the (handler, data) pair
  *           under the lock and invoke the handler outside it, so a concurrent
  *           irq_unregister can no longer produce a torn pair or a stale
- *           pointer dereference.
+ *           pointer dereference.  Since then the pair is RCU-published
+ *           (kernel/rcu.h): dispatch takes no lock, and irq_unregister waits
+ *           out running handlers before it returns.
  */
 #include <kernel/irq.h>
+#include <kernel/percpu.h>
 #include <kernel/printk.h>
+#include <kernel/rcu.h>
 #include <kernel/sched.h>
 #include <kernel/spinlock.h>
 #include <kernel/types.h>
+#include <kernel/trace.h>
 
 #define MAX_IRQS 256
 
 /* irq_handlers[]: sparse table mapping IRQ number -> (handler, opaque data).
  * Entries are set by irq_register() and cleared by irq_unregister().
- * FIX(IRQ-02): guarded by irq_table_lock; dispatchers copy the pair under
- * the lock and call the handler after dropping it (a handler may re-register
- * or disable lines without self-deadlocking). */
-static struct {
+ * FIX(IRQ-02): each non-NULL entry points at that line's irq_actions[] pair,
+ * filled in before it is published with rcu_assign_pointer.  Dispatch runs
+ * in IRQ context, which is an RCU read section, so it reads the pair with
+ * no lock and no shared write.  The pairs are static because lines are
+ * registered before the heap exists. */
+struct irq_action {
   irq_handler_t handler;
   void *data;
-} irq_handlers[MAX_IRQS];
+};
+static struct irq_action irq_actions[MAX_IRQS];
+static struct irq_action *irq_handlers[MAX_IRQS];
 
-/* irq_table_lock: protects irq_handlers[] against concurrent
- * register/unregister/dispatch across CPUs (IRQ-02). */
+/* irq_table_lock: serialises register/unregister across CPUs (IRQ-02);
+ * dispatch does not take it. */
 static DEFINE_SPINLOCK(irq_table_lock);
 
 /* current_chip: pointer to the active irq_chip implementation.
@@ -133,13 +142,15 @@ int irq_register(uint32_t irq, irq_handler_t handler, void *data) {
   uint64_t flags;
   spin_lock_irqsave(&irq_table_lock, &flags);
 
-  if (irq_handlers[irq].handler) {
+  if (irq_handlers[irq]) {
     spin_unlock_irqrestore(&irq_table_lock, flags);
     return -EBUSY;
   }
 
-  irq_handlers[irq].handler = handler;
-  irq_handlers[irq].data = data;
+  /* No reader holds irq_actions[irq]: unregister waited them out. */
+  irq_actions[irq].handler = handler;
+  irq_actions[irq].data = data;
+  rcu_assign_pointer(irq_handlers[irq], &irq_actions[irq]);
 
   spin_unlock_irqrestore(&irq_table_lock, flags);
 
@@ -159,11 +170,13 @@ int irq_register(uint32_t irq, irq_handler_t handler, void *data) {
  * clears the handler and data pointers in irq_handlers[].  Silently returns
  * if irq >= MAX_IRQS.
  *
- * Locking: irq_table_lock (irqsave) for the table slot.  A dispatch that
- *          already copied the pair may still complete one final handler call
- *          after unregister returns (no synchronize_irq yet); the line is
- *          masked first, so no NEW interrupts dispatch the stale entry.
- * IRQ context: must NOT be called from an IRQ handler.
+ * Locking: irq_table_lock (irqsave) for the table slot, then
+ *          synchronize_rcu(): a dispatch that fetched the entry before it
+ *          was cleared finishes its handler call before unregister returns,
+ *          so the caller may free 'data' afterwards.  The line is masked
+ *          first, so no NEW interrupts dispatch the stale entry.
+ * IRQ context: must NOT be called from an IRQ handler (or with a lock an
+ *          IRQ handler takes).
  */
 void irq_unregister(uint32_t irq) {
   if (irq >= MAX_IRQS)
@@ -175,9 +188,9 @@ void irq_unregister(uint32_t irq) {
 
   uint64_t flags;
   spin_lock_irqsave(&irq_table_lock, &flags);
-  irq_handlers[irq].handler = NULL;
-  irq_handlers[irq].data = NULL;
+  rcu_assign_pointer(irq_handlers[irq], NULL);
   spin_unlock_irqrestore(&irq_table_lock, flags);
+  synchronize_rcu();
 }
 
 /*
@@ -267,8 +280,8 @@ static void cpu_halt_from_ipi(void) {
  *
  * NOTE(IRQ-01, resolved): this loop is the aarch64 (GIC) entry point only;
  * amd64 is vectored and enters through irq_dispatch() + irq_chip_end().
- * FIX(IRQ-02): the (handler, data) pair is copied under irq_table_lock and
- * invoked after dropping it.
+ * FIX(IRQ-02): the (handler, data) pair is read through the RCU-published
+ * entry; IRQ context is the read section.
  *
  * Locking: runs with IRQs implicitly masked (exception entry).
  * IRQ context: YES — this IS the IRQ entry point on aarch64.
@@ -298,6 +311,8 @@ struct pt_regs *irq_handler(struct pt_regs *regs) {
       cpu_halt_from_ipi();
     }
 
+    trace_event(TRACE_EV_IRQ_ENTRY, trace_tid(), irq, 0);
+
     /* Handle IRQ */
     if (irq == IRQ_TIMER || irq == 30) {
       /* Timer Interrupt - Returns new regs if context switch occurred */
@@ -306,27 +321,24 @@ struct pt_regs *irq_handler(struct pt_regs *regs) {
       ret_regs = timer_handler(ret_regs);
 
       current_chip->end(irq);
+      trace_event(TRACE_EV_IRQ_EXIT, trace_tid(), irq, 0);
       return ret_regs;
     }
 
-    /* FIX(IRQ-02): snapshot the pair under the lock, call outside it. */
-    irq_handler_t handler = NULL;
-    void *data = NULL;
-    if (irq < MAX_IRQS) {
-      spin_lock(&irq_table_lock);
-      handler = irq_handlers[irq].handler;
-      data = irq_handlers[irq].data;
-      spin_unlock(&irq_table_lock);
-    }
+    /* FIX(IRQ-02): lockless read of the published pair. */
+    struct irq_action *act =
+        irq < MAX_IRQS ? rcu_dereference(irq_handlers[irq]) : NULL;
 
-    if (handler) {
-      handler(irq, data);
+    __percpu_add(PCPU_IRQS, 1);
+    if (act) {
+      act->handler(irq, act->data);
     } else {
       pr_warn("IRQ: Unhandled interrupt %u\n", irq);
       irq_disable(irq); /* Prevent interrupt storm */
     }
 
     current_chip->end(irq);
+    trace_event(TRACE_EV_IRQ_EXIT, trace_tid(), irq, 0);
   }
 
   return ret_regs;
@@ -348,25 +360,19 @@ struct pt_regs *irq_handler(struct pt_regs *regs) {
  *
  * NOTE(IRQ-01, resolved): acknowledge() is N/A on a vectored architecture —
  * the vector arrives with the frame.  EOI goes through the chip now.
- * FIX(IRQ-02): (handler, data) copied under irq_table_lock, called outside.
+ * FIX(IRQ-02): (handler, data) read through the RCU-published entry.
  *
- * Locking: IRQs are masked by the CPU at IDT entry; irq_table_lock guards
- *          the table read against concurrent register/unregister.
+ * Locking: none; IRQs are masked by the CPU at IDT entry, which makes the
+ *          dispatch an RCU read section against register/unregister.
  * IRQ context: YES — called from the amd64 IDT handler.
  */
 struct pt_regs *irq_dispatch(uint32_t irq, struct pt_regs *regs) {
-  irq_handler_t handler = NULL;
-  void *data = NULL;
-
-  if (irq < MAX_IRQS) {
-    spin_lock(&irq_table_lock);
-    handler = irq_handlers[irq].handler;
-    data = irq_handlers[irq].data;
-    spin_unlock(&irq_table_lock);
-  }
+  struct irq_action *act =
+      irq < MAX_IRQS ? rcu_dereference(irq_handlers[irq]) : NULL;
 
-  if (handler) {
-    handler(irq, data);
+  __percpu_add(PCPU_IRQS, 1);
+  if (act) {
+    act->handler(irq, act->data);
   } else {
     pr_warn("IRQ: Unhandled interrupt %u\n", irq);
   }
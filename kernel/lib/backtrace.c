@@ -111,29 +111,50 @@ static void backtrace_emit(int idx, uint64_t pc) {
 }
 
 /*
- * backtrace_regs - walk and print the call chain starting at pc/fp.
- *
- * Seed from an exception frame (regs->rip/regs->rbp on amd64,
- * frame->elr/frame->regs[29] on aarch64) or from the current context via
- * backtrace_here().  Output goes through fault_printf — callable from any
- * fault path.
+ * backtrace_collect - store pc and up to max - 1 return addresses of the
+ * kernel fp chain at pc/fp into out; returns the count (>= 1 if max > 0).
+ * With stack_hi != 0 every frame must also lie in [stack_lo, stack_hi): the
+ * sampling profiler passes the interrupted task's kernel stack, since in
+ * the timer IRQ the fp may be a stale register in any assembly routine.
+ * No output.
  */
-void backtrace_regs(uint64_t pc, uint64_t fp) {
-  fault_printf("Backtrace (fp chain, max %d):\n", BACKTRACE_MAX_FRAMES);
-  backtrace_emit(0, pc);
-
-  for (int i = 1; i < BACKTRACE_MAX_FRAMES; i++) {
+int backtrace_collect(uint64_t pc, uint64_t fp, uint64_t stack_lo,
+                      uint64_t stack_hi, uint64_t *out, int max) {
+  int n = 0;
+  if (max <= 0)
+    return 0;
+  out[n++] = pc;
+  while (n < max) {
     if (!fp_addr_valid(fp))
       break;
+    if (stack_hi && (fp < stack_lo || fp + 16 > stack_hi))
+      break;
     uint64_t next_fp = *(const uint64_t *)fp;
     uint64_t ret = *(const uint64_t *)(fp + 8);
     if (!text_addr_valid(ret))
       break;
-    backtrace_emit(i, ret);
+    out[n++] = ret;
     if (next_fp <= fp) /* frames must strictly grow toward the stack base */
       break;
     fp = next_fp;
   }
+  return n;
+}
+
+/*
+ * backtrace_regs - walk and print the call chain starting at pc/fp.
+ *
+ * Seed from an exception frame (regs->rip/regs->rbp on amd64,
+ * frame->elr/frame->regs[29] on aarch64) or from the current context via
+ * backtrace_here().  Output goes through fault_printf — callable from any
+ * fault path.
+ */
+void backtrace_regs(uint64_t pc, uint64_t fp) {
+  uint64_t pcs[BACKTRACE_MAX_FRAMES];
+  int n = backtrace_collect(pc, fp, 0, 0, pcs, BACKTRACE_MAX_FRAMES);
+  fault_printf("Backtrace (fp chain, max %d):\n", BACKTRACE_MAX_FRAMES);
+  for (int i = 0; i < n; i++)
+    backtrace_emit(i, pcs[i]);
 }
 
 /*
@@ -0,0 +1,322 @@
+/*
+ * kernel/lib/klog.c
+ * Kernel log buffer (see kernel/klog.h): per-CPU record rings, the merged
+ * dmesg history, and the drain to the UART or virtio-console sink.
+ *
+ * Ring protocol: klog_rings[c].head is written only by CPU c with IRQs
+ * masked (the single producer), tail only by the klog_drain_lock holder
+ * (the single consumer).  Each side publishes its index with a release
+ * store after touching the bytes and reads the other's with an acquire
+ * load, so no lock is shared between CPUs on the printk path.  Records are
+ * {struct klog_rec, text}, 8-byte aligned, and may wrap the ring end.
+ *
+ * History: klog_hist[] holds formatted text; [hist_tx, hist_head) is not
+ * yet taken by the sink and is never overwritten, older bytes are dmesg history
+ * until reused.  All of it, klog_line and klog_bol belong to the
+ * klog_drain_lock holder — except in emergency mode, whose flush runs with
+ * no lock at all because the holder may be a halted CPU.
+ */
+#include <drivers/timer.h>
+#include <drivers/uart.h>
+#include <drivers/virtio_console.h>
+#include <kernel/arch.h>
+#include <kernel/cpu.h>
+#include <kernel/klog.h>
+#include <kernel/kmalloc.h>
+#include <kernel/printk.h>
+#include <kernel/spinlock.h>
+#include <kernel/vmm.h>
+
+#define KLOG_HDR ((uint64_t)sizeof(struct klog_rec))
+#define KLOG_SPACE(len) ((KLOG_HDR + (len) + 7) & ~7ULL)
+#define KLOG_PFX_MAX 48 /* "[sssss.uuuuuu] [Cnn] " with room to spare */
+
+static struct klog_ring {
+  char buf[KLOG_CPU_SIZE];
+  uint64_t head;     /* producer (owning CPU) */
+  uint64_t tail;     /* consumer (drain lock) */
+  uint64_t dropped;  /* records refused for lack of space */
+  uint64_t reported; /* dropped count already logged (drain lock) */
+} klog_rings[MAX_CPUS];
+
+static uint64_t klog_seq;
+static DEFINE_SPINLOCK(klog_drain_lock);
+static char klog_hist[KLOG_HIST_SIZE];
+static uint64_t klog_hist_head, klog_hist_tx;
+static char klog_line[KLOG_PFX_MAX + KLOG_REC_MAX];
+static char klog_emerg_line[KLOG_PFX_MAX + KLOG_REC_MAX];
+static int klog_bol = 1; /* history ends at a line start */
+
+static int klog_sink = KLOG_SINK_UART; /* drain lock */
+
+/* Boot: drain synchronously until the timer tick can take over. */
+static volatile int klog_sync = 1;
+/* Panic: everything goes straight out through uart_putc_emergency. */
+static volatile int klog_emerg;
+
+static void ring_copy_in(struct klog_ring *r, uint64_t pos, const void *src,
+                         size_t n) {
+  const char *s = src;
+  for (size_t i = 0; i < n; i++)
+    r->buf[(pos + i) & (KLOG_CPU_SIZE - 1)] = s[i];
+}
+
+static void ring_copy_out(const struct klog_ring *r, uint64_t pos, void *dst,
+                          size_t n) {
+  char *d = dst;
+  for (size_t i = 0; i < n; i++)
+    d[i] = r->buf[(pos + i) & (KLOG_CPU_SIZE - 1)];
+}
+
+/* klog_put - one record of at most KLOG_REC_MAX bytes on this CPU's ring. */
+static void klog_put(const char *s, size_t n, int flags) {
+  uint64_t irq;
+  hal_irq_save(&irq);
+  struct cpu_info *cpu = get_cpu_info();
+  if (cpu->cpu_id >= MAX_CPUS) {
+    hal_irq_restore(irq);
+    return;
+  }
+  struct klog_ring *r = &klog_rings[cpu->cpu_id];
+  uint64_t head = r->head;
+  uint64_t need = KLOG_SPACE(n);
+  if (head + need - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >
+      KLOG_CPU_SIZE) {
+    __atomic_add_fetch(&r->dropped, 1, __ATOMIC_RELAXED);
+    hal_irq_restore(irq);
+    return;
+  }
+  struct klog_rec rec = {
+      .seq = __atomic_fetch_add(&klog_seq, 1, __ATOMIC_RELAXED),
+      .ts_us = timer_get_us(),
+      .len = (uint16_t)n,
+      .cpu = (uint8_t)cpu->cpu_id,
+      .flags = (uint8_t)flags,
+  };
+  ring_copy_in(r, head, &rec, KLOG_HDR);
+  ring_copy_in(r, head + KLOG_HDR, s, n);
+  __atomic_store_n(&r->head, head + need, __ATOMIC_RELEASE);
+  hal_irq_restore(irq);
+}
+
+void klog_write(const char *s, size_t len, int flags) {
+  if (klog_emerg) {
+    for (size_t i = 0; i < len; i++)
+      uart_putc_emergency(s[i]);
+    return;
+  }
+  while (len > 0) {
+    size_t n = len > KLOG_REC_MAX ? KLOG_REC_MAX : len;
+    klog_put(s, n, flags);
+    s += n;
+    len -= n;
+  }
+}
+
+/* klog_next - the ring whose oldest pending record has the lowest seq, with
+ * that record's header in *rec; -1 if every ring is empty. */
+static int klog_next(struct klog_rec *rec) {
+  int best = -1;
+  for (int i = 0; i < MAX_CPUS; i++) {
+    struct klog_ring *r = &klog_rings[i];
+    uint64_t tail = r->tail;
+    if (tail == __atomic_load_n(&r->head, __ATOMIC_ACQUIRE))
+      continue;
+    struct klog_rec h;
+    ring_copy_out(r, tail, &h, KLOG_HDR);
+    if (best < 0 || h.seq < rec->seq) {
+      best = i;
+      *rec = h;
+    }
+  }
+  return best;
+}
+
+/* klog_format - render ring r's oldest record (header rec) into out; the
+ * timestamp / CPU prefix goes only at the start of a line. */
+static size_t klog_format(const struct klog_ring *r, const struct klog_rec *rec,
+                          char *out) {
+  size_t n = 0;
+  if (!(rec->flags & KLOG_RAW) && klog_bol) {
+    int p = snprintf(out, KLOG_PFX_MAX, "[%5llu.%06llu] [C%u] ",
+                     (unsigned long long)(rec->ts_us / 1000000),
+                     (unsigned long long)(rec->ts_us % 1000000),
+                     (unsigned)rec->cpu);
+    n = p > 0 ? (size_t)p : 0;
+  }
+  ring_copy_out(r, r->tail + KLOG_HDR, out + n, rec->len);
+  return n + rec->len;
+}
+
+static void klog_consume(struct klog_ring *r, const struct klog_rec *rec) {
+  __atomic_store_n(&r->tail, r->tail + KLOG_SPACE(rec->len),
+                   __ATOMIC_RELEASE);
+}
+
+/* hist_append - add n bytes to the history; the caller checked that no
+ * unsent byte is overwritten. */
+static void hist_append(const char *s, size_t n) {
+  for (size_t i = 0; i < n; i++)
+    klog_hist[(klog_hist_head + i) & (KLOG_HIST_SIZE - 1)] = s[i];
+  klog_hist_head += n;
+  if (n)
+    klog_bol = s[n - 1] == '\n';
+}
+
+static int hist_fits(size_t n) {
+  return klog_hist_head + n - klog_hist_tx <= KLOG_HIST_SIZE;
+}
+
+/* klog_collect - move pending records into the history in seq order, as far
+ * as the unsent backlog allows.  Drain lock held. */
+static void klog_collect(void) {
+  for (int i = 0; i < MAX_CPUS; i++) {
+    struct klog_ring *r = &klog_rings[i];
+    uint64_t d = __atomic_load_n(&r->dropped, __ATOMIC_RELAXED);
+    if (d == r->reported)
+      continue;
+    int n = snprintf(klog_line, sizeof(klog_line),
+                     "%s[klog] %llu messages dropped on C%d\n",
+                     klog_bol ? "" : "\n",
+                     (unsigned long long)(d - r->reported), i);
+    if (n <= 0 || !hist_fits((size_t)n))
+      return;
+    hist_append(klog_line, (size_t)n);
+    r->reported = d;
+  }
+
+  struct klog_rec rec;
+  int i;
+  while ((i = klog_next(&rec)) >= 0) {
+    struct klog_ring *r = &klog_rings[i];
+    size_t n = klog_format(r, &rec, klog_line);
+    if (!hist_fits(n))
+      return; /* UART too far behind; the record waits in its ring */
+    hist_append(klog_line, n);
+    klog_consume(r, &rec);
+  }
+}
+
+/* klog_sink_write - offer n history bytes to the sink; returns how many it
+ * took.  sync: the virtio port waits for the host to catch up. */
+static size_t klog_sink_write(const char *s, size_t n, int sync) {
+  if (klog_sink == KLOG_SINK_VIRTIO)
+    return virtio_console_write(VCON_PORT_LOG, s, n, sync);
+  return uart_tx_write(s, n);
+}
+
+/* klog_pump - feed unsent history to the sink: only what it takes without
+ * waiting, or (sync) all of it — through the polled uart_putc for the UART.
+ * A synchronous sink that still comes up short is wedged; its backlog is
+ * dropped rather than spun on, as tx_make_room does. */
+static void klog_pump(int sync) {
+  while (klog_hist_tx != klog_hist_head) {
+    if (sync && klog_sink == KLOG_SINK_UART) {
+      uart_putc(klog_hist[klog_hist_tx++ & (KLOG_HIST_SIZE - 1)]);
+      continue;
+    }
+    uint64_t off = klog_hist_tx & (KLOG_HIST_SIZE - 1);
+    uint64_t n = klog_hist_head - klog_hist_tx;
+    if (n > KLOG_HIST_SIZE - off)
+      n = KLOG_HIST_SIZE - off; /* up to the wrap */
+    size_t took = klog_sink_write(&klog_hist[off], (size_t)n, sync);
+    klog_hist_tx += took;
+    if (took < n) {
+      if (sync)
+        klog_hist_tx = klog_hist_head;
+      return;
+    }
+  }
+}
+
+static int klog_pending(void) {
+  struct klog_rec rec;
+  return klog_hist_tx != klog_hist_head || klog_next(&rec) >= 0;
+}
+
+/* klog_drain - collect and pump unless another CPU is already draining (it
+ * picks up our records too: in sync mode it loops until nothing is left,
+ * otherwise the next tick does). */
+static void klog_drain(int sync) {
+  uint64_t flags;
+  if (klog_emerg || !spin_trylock_irqsave(&klog_drain_lock, &flags))
+    return;
+  do {
+    klog_collect();
+    klog_pump(sync);
+  } while (sync && klog_pending());
+  spin_unlock_irqrestore(&klog_drain_lock, flags);
+}
+
+void klog_kick(void) { klog_drain(klog_sync); }
+
+void klog_tick(void) {
+  klog_sync = 0;
+  uart_tx_kick();
+  klog_drain(0);
+}
+
+int klog_set_sink(int sink) {
+  if (sink != KLOG_SINK_UART && sink != KLOG_SINK_VIRTIO)
+    return -EINVAL;
+  if (sink == KLOG_SINK_VIRTIO && !virtio_console_present())
+    return -ENODEV;
+  uint64_t flags;
+  spin_lock_irqsave(&klog_drain_lock, &flags);
+  klog_sink = sink;
+  spin_unlock_irqrestore(&klog_drain_lock, flags);
+  return 0;
+}
+
+void klog_emergency(void) {
+  if (__atomic_exchange_n(&klog_emerg, 1, __ATOMIC_SEQ_CST))
+    return;
+  /* Lock-free on purpose: the drain lock's holder may be a CPU that will
+   * never run again.  Whatever it was in the middle of may be repeated. */
+  while (klog_hist_tx != klog_hist_head)
+    uart_putc_emergency(klog_hist[klog_hist_tx++ & (KLOG_HIST_SIZE - 1)]);
+  struct klog_rec rec;
+  int i;
+  while ((i = klog_next(&rec)) >= 0) {
+    struct klog_ring *r = &klog_rings[i];
+    size_t n = klog_format(r, &rec, klog_emerg_line);
+    for (size_t k = 0; k < n; k++)
+      uart_putc_emergency(klog_emerg_line[k]);
+    if (n)
+      klog_bol = klog_emerg_line[n - 1] == '\n';
+    klog_consume(r, &rec);
+  }
+}
+
+long sys_dmesg(char *ubuf, size_t size) {
+  if (size > KLOG_HIST_SIZE)
+    size = KLOG_HIST_SIZE;
+  char *k = kmalloc(size ? size : 1);
+  if (!k)
+    return -ENOMEM;
+
+  uint64_t flags;
+  spin_lock_irqsave(&klog_drain_lock, &flags);
+  klog_collect();
+  uint64_t head = klog_hist_head;
+  uint64_t first = head > KLOG_HIST_SIZE ? head - KLOG_HIST_SIZE : 0;
+  uint64_t start = head > size ? head - size : 0;
+  if (start < first)
+    start = first;
+  if (start > first) {
+    /* Cut at a line boundary rather than mid-message. */
+    uint64_t p = start;
+    while (p < head && klog_hist[(p - 1) & (KLOG_HIST_SIZE - 1)] != '\n')
+      p++;
+    if (p < head)
+      start = p;
+  }
+  size_t n = head - start;
+  for (size_t i = 0; i < n; i++)
+    k[i] = klog_hist[(start + i) & (KLOG_HIST_SIZE - 1)];
+  spin_unlock_irqrestore(&klog_drain_lock, flags);
+
+  long rc = vmm_copy_to_user(ubuf, k, n) != 0 ? -EFAULT : (long)n;
+  kfree(k);
+  return rc;
+}
@@ -108,10 +108,11 @@ static size_t heap_total = 0;
  * that map to the same bucket index; no cross-bucket reuse occurs. */
 static struct block_header *buckets[NUM_BUCKETS];
 static int heap_initialized = 0;
-/* kmalloc_lock: global spinlock protecting heap_ptr, buckets[], and the magic
- * field of every block_header for small allocations.
+/* kmalloc_lock: global queued spinlock (kernel/spinlock.h) protecting
+ * heap_ptr, buckets[], and the magic field of every block_header for small
+ * allocations.
  * NOTE(MM-KM-06): A single lock serialises all allocators on all CPUs. */
-static DEFINE_SPINLOCK(kmalloc_lock);
+static DEFINE_QSPINLOCK(kmalloc_lock);
 
 /* Convert size to bucket index. Returns -1 if too large. */
 /*
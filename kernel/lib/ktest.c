@@ -28,9 +28,18 @@
  *                ktest_test_failed flag (test.h); the runner clears it before
  *                each test and, after test->func(), records a real PASS or FAIL.
  *                The summary now reports accurate PASSED / FAILED counts.
+ *
+ * SMP cases (KTEST_SMP_CASE, section `.ktests_smp`):
+ *   ktest_run_smp() on the BSP and ktest_smp_ap() on every AP run them once
+ *   all CPUs are up, with IRQs still masked everywhere.  The APs check in
+ *   as they boot and wait; the BSP starts the run once arch_smp_init() has
+ *   returned and every AP counted in nr_cpus has checked in.  Each case is
+ *   framed by a barrier on both sides, so all CPUs enter it together and
+ *   the BSP reports it only when every CPU has left it.
  */
 #include <kernel/test.h>
 #include <kernel/printk.h>
+#include <kernel/arch.h>
 
 /* __ktests_start / __ktests_end: linker-defined symbols bracketing the
  * .ktests ELF section that holds all KTEST_CASE() descriptors.
@@ -91,3 +100,86 @@ void ktest_run_all(void) {
     printk("[KTEST] Completed. Summary: %d PASSED, %d FAILED\n\n",
            (int)passed, (int)failed);
 }
+
+extern ktest_smp_case_t __ktests_smp_start[];
+extern ktest_smp_case_t __ktests_smp_end[];
+extern uint32_t nr_cpus;
+
+/* ktest_smp_joined: APs checked in (each takes the next index as its cpu
+ * argument).  ktest_smp_state: 0 waiting, 1 run, 2 skipped.  The barrier
+ * is sense-reversing: the last CPU in resets the count and flips sense. */
+static volatile uint32_t ktest_smp_joined;
+static volatile uint32_t ktest_smp_state;
+static volatile uint32_t ktest_smp_ncpus;
+static volatile uint32_t ktest_smp_count;
+static volatile uint32_t ktest_smp_sense;
+
+void ktest_smp_barrier(void) {
+    uint32_t sense = !__atomic_load_n(&ktest_smp_sense, __ATOMIC_ACQUIRE);
+    if (__atomic_add_fetch(&ktest_smp_count, 1, __ATOMIC_ACQ_REL) ==
+        ktest_smp_ncpus) {
+        __atomic_store_n(&ktest_smp_count, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&ktest_smp_sense, sense, __ATOMIC_RELEASE);
+        return;
+    }
+    uint32_t v;
+    while ((v = __atomic_load_n(&ktest_smp_sense, __ATOMIC_ACQUIRE)) != sense)
+        arch_spin_wait(&ktest_smp_sense, v);
+}
+
+/* ktest_smp_each - run every SMP case as CPU 'cpu'; the BSP reports. */
+static void ktest_smp_each(int cpu, int ncpus) {
+    size_t passed = 0, failed = 0;
+    for (ktest_smp_case_t *test = __ktests_smp_start;
+         test < __ktests_smp_end; test++) {
+        ktest_smp_barrier();
+        if (cpu == 0)
+            ktest_test_failed = 0;
+        ktest_smp_barrier();
+        test->func(cpu, ncpus);
+        ktest_smp_barrier();
+        if (cpu != 0)
+            continue;
+        printk("[KTEST] SMP %s on %d CPUs: %s\n", test->name, ncpus,
+               ktest_test_failed ? "FAIL" : "PASS");
+        if (ktest_test_failed)
+            failed++;
+        else
+            passed++;
+    }
+    if (cpu == 0)
+        printk("[KTEST] SMP completed. Summary: %d PASSED, %d FAILED\n\n",
+               (int)passed, (int)failed);
+}
+
+void ktest_smp_ap(void) {
+    int cpu = (int)__atomic_add_fetch(&ktest_smp_joined, 1, __ATOMIC_ACQ_REL);
+    uint32_t state;
+    while ((state = __atomic_load_n(&ktest_smp_state, __ATOMIC_ACQUIRE)) == 0)
+        arch_spin_wait(&ktest_smp_state, 0);
+    if (state == 1)
+        ktest_smp_each(cpu, (int)ktest_smp_ncpus);
+}
+
+void ktest_run_smp(void) {
+    uint32_t n = nr_cpus;
+    size_t count = __ktests_smp_end - __ktests_smp_start;
+    /* Every AP in nr_cpus checks in right after its boot ack. */
+    for (long spins = 0; spins < 100000000L &&
+                         __atomic_load_n(&ktest_smp_joined, __ATOMIC_ACQUIRE) <
+                             n - 1;
+         spins++)
+        arch_yield();
+    if (n < 2 || ktest_smp_joined != n - 1 || count == 0) {
+        if (n >= 2)
+            printk("[KTEST] SMP cases skipped (%d of %d APs)\n",
+                   (int)ktest_smp_joined, (int)n - 1);
+        __atomic_store_n(&ktest_smp_state, 2, __ATOMIC_RELEASE);
+        return;
+    }
+    ktest_smp_ncpus = n;
+    printk("\n[KTEST] Starting SMP Unit Tests (%d cases, %d CPUs)...\n",
+           (int)count, (int)n);
+    __atomic_store_n(&ktest_smp_state, 1, __ATOMIC_RELEASE);
+    ktest_smp_each(0, (int)n);
+}
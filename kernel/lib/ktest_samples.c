@@ -33,6 +33,15 @@
 #include <kernel/kmalloc.h>
 #include <kernel/pmm.h>
 #include <kernel/vmm.h>
+#include <kernel/ipc_ring.h>
+#include <kernel/spinlock.h>
+#include <kernel/syscall.h>
+#include <kernel/cpu.h>
+#include <kernel/rcu.h>
+#include <kernel/sched.h>
+#include <kernel/futex.h>
+#include <kernel/pmu.h>
+#include <drivers/timer.h>
 
 /* test_string_length - verify strlen() for a literal and an empty string.
  * Failure: KASSERT_EQ prints the mismatch and returns (see LIB-KTEST-01). */
@@ -129,3 +138,453 @@ KTEST_CASE(test_vmm_protect) {
     KASSERT_EQ(page[1], 0xCD);
     pmm_free_page(page);
 }
+
+/* test_ipc_ring - the bounded IPC buffer: FIFO for "any", per-sender order
+ * for a filtered pop (which unlinks from the middle), -EAGAIN when full,
+ * and a resize that keeps order and refuses to shrink below the count. */
+KTEST_CASE(test_ipc_ring) {
+    struct ipc_ring *r = ipc_ring_alloc(4);
+    KASSERT(r != NULL);
+    struct ipc_message m;
+    memset(&m, 0, sizeof(m));
+    int from[4] = {7, 15, 7, 9}; /* 7 and 15 share a sender bucket */
+    for (int i = 0; i < 4; i++) {
+        m.from = from[i];
+        m.data1 = i;
+        KASSERT_EQ(ipc_ring_push(r, &m), 0);
+    }
+    KASSERT(ipc_ring_full(r));
+    KASSERT_EQ(ipc_ring_push(r, &m), -EAGAIN);
+
+    KASSERT_EQ(ipc_ring_pop(r, 15, &m), 0);
+    KASSERT_EQ(m.data1, 1);
+    KASSERT_EQ(ipc_ring_pop(r, 15, &m), -1);
+    KASSERT_EQ(ipc_ring_pop(r, 7, &m), 0);
+    KASSERT_EQ(m.data1, 0);
+
+    struct ipc_ring *small = ipc_ring_alloc(1);
+    KASSERT(small != NULL);
+    KASSERT_EQ(ipc_ring_move(small, r), -EBUSY);
+    ipc_ring_free(small);
+
+    struct ipc_ring *big = ipc_ring_alloc(IPC_RING_MAX);
+    KASSERT(big != NULL);
+    KASSERT_EQ(ipc_ring_move(big, r), 0);
+    KASSERT(!ipc_ring_has(r, -1));
+    KASSERT_EQ(ipc_ring_pop(big, -1, &m), 0);
+    KASSERT_EQ(m.data1, 2);
+    KASSERT_EQ(ipc_ring_pop(big, -1, &m), 0);
+    KASSERT_EQ(m.data1, 3);
+    KASSERT(!ipc_ring_has(big, -1));
+    ipc_ring_free(big);
+    ipc_ring_free(r);
+}
+
+/* test_pmm_shared_page - a frame with an extra reference (channel rings
+ * mapped into two spaces) survives the first pmm_free_page() untouched and
+ * returns to the PMM only with the last one. */
+KTEST_CASE(test_pmm_shared_page) {
+    uint64_t free0 = pmm_get_free_pages();
+    uint8_t *page = (uint8_t *)pmm_alloc_page();
+    KASSERT(page != NULL);
+    page[0] = 0x5A;
+    pmm_get_page(page);
+    pmm_free_page(page);
+    KASSERT_EQ(page[0], 0x5A); /* not poisoned: still referenced */
+    KASSERT_EQ(pmm_get_free_pages(), free0 - 1);
+    pmm_free_page(page);
+    KASSERT_EQ(pmm_get_free_pages(), free0);
+}
+
+/* test_syscall_table - every slot is empty or has exactly one handler, and
+ * SYSCALL_LEAN / SYSCALL_URING entries are value calls (the lean entry
+ * paths and the ring consumer call fn without a frame). */
+KTEST_CASE(test_syscall_table) {
+    for (int nr = 0; nr < SYS_NR; nr++) {
+        const struct syscall_entry *e = &syscall_table[nr];
+        KASSERT(!(e->fn && e->frame_fn));
+        if (e->flags & (SYSCALL_LEAN | SYSCALL_URING))
+            KASSERT(e->fn != NULL);
+        KASSERT(e->nargs <= 6);
+    }
+    KASSERT(syscall_table[SYS_GETPID].flags & SYSCALL_LEAN);
+    KASSERT_EQ(syscall_table[SYS_GETPID].nargs, 0);
+}
+
+/* test_spinlock_kinds - ticket and queued locks: trylock fails while held,
+ * unlock makes it succeed, and each word returns to its unlocked form (a
+ * ticket lock's owner == next, a queued lock's 0). */
+KTEST_CASE(test_spinlock_kinds) {
+    static DEFINE_SPINLOCK(kt_ticket);
+    static DEFINE_QSPINLOCK(kt_queued);
+    spinlock_t *locks[2] = {&kt_ticket, &kt_queued};
+    for (int i = 0; i < 2; i++) {
+        spinlock_t *l = locks[i];
+        spin_lock(l);
+        KASSERT(!spin_trylock(l));
+        spin_unlock(l);
+        KASSERT(spin_trylock(l));
+        spin_unlock(l);
+    }
+    /* Only the invariant: the locks are static, so the absolute ticket
+     * numbers depend on how often the suite has run. */
+    KASSERT_EQ(kt_ticket.tkt.owner, kt_ticket.tkt.next);
+    KASSERT_EQ(kt_queued.val, 0);
+}
+
+/*
+ * RCU cases.  The suite runs on the BSP before SMP with IRQs masked, so no
+ * tick fires on its own: each case drives rcu_note_qs/rcu_tick by hand and
+ * plays a second CPU by marking cpu_data[1] online for its duration.  The
+ * flag is cleared again before any KASSERT can return early.
+ */
+static int kt_rcu_runs;
+static void kt_rcu_cb(struct rcu_head *head) {
+    (void)head;
+    kt_rcu_runs++;
+}
+
+static struct cpu_info *kt_rcu_fake_cpu(void) {
+    cpu_data[1].cpu_id = 1;
+    cpu_data[1].online = 1;
+    return &cpu_data[1];
+}
+
+/* test_rcu_gp_all_cpus - the grace period synchronize_rcu waits for stays
+ * open while any CPU online at its start has not passed a quiescent state. */
+KTEST_CASE(test_rcu_gp_all_cpus) {
+    struct cpu_info *self = get_cpu_info();
+    struct cpu_info *other = kt_rcu_fake_cpu();
+    uint32_t gp = rcu_poll_start();
+    rcu_note_qs(self);
+    rcu_note_qs(self);
+    int early = rcu_poll_done(gp);
+    /* Twice: a grace period already in flight may have needed a second. */
+    for (int i = 0; i < 2; i++) {
+        rcu_note_qs(other);
+        rcu_note_qs(self);
+    }
+    int late = rcu_poll_done(gp);
+    other->online = 0;
+    KASSERT(!early);
+    KASSERT(late);
+    synchronize_rcu(); /* one CPU online again: returns at once */
+}
+
+/* test_rcu_callback_once - a call_rcu callback waits for its grace period,
+ * then runs exactly once however many ticks follow. */
+KTEST_CASE(test_rcu_callback_once) {
+    static struct rcu_head head;
+    struct cpu_info *self = get_cpu_info();
+    kt_rcu_runs = 0;
+    call_rcu(&head, kt_rcu_cb);
+    KASSERT_EQ(kt_rcu_runs, 0);
+    rcu_tick(self); /* batch moves to wait, grace period starts */
+    KASSERT_EQ(kt_rcu_runs, 0);
+    for (int i = 0; i < 8; i++)
+        rcu_tick(self);
+    KASSERT_EQ(kt_rcu_runs, 1);
+}
+
+/* test_rcu_reader_blocks - a CPU still inside a read section (it reports
+ * no quiescent state) holds back reclamation on every other CPU. */
+KTEST_CASE(test_rcu_reader_blocks) {
+    static struct rcu_head head;
+    struct cpu_info *self = get_cpu_info();
+    struct cpu_info *reader = kt_rcu_fake_cpu();
+    kt_rcu_runs = 0;
+    call_rcu(&head, kt_rcu_cb);
+    for (int i = 0; i < 8; i++)
+        rcu_tick(self);
+    int held = kt_rcu_runs;
+    for (int i = 0; i < 2; i++) { /* reader leaves its section */
+        rcu_note_qs(reader);
+        rcu_tick(self);
+    }
+    int after = kt_rcu_runs;
+    reader->online = 0;
+    KASSERT_EQ(held, 0);
+    KASSERT_EQ(after, 1);
+}
+
+/*
+ * Priority inheritance cases.  Three fake threads of one process are
+ * published in free process_pool slots for the duration of a case: a
+ * priority-20 holder and priority-0 / priority-5 donors.  A donor is made
+ * current only around pi_boost(), which lends the current thread's rank.
+ * The holder stays SLEEPING, so __pi_set never touches a runqueue.  Each
+ * donor's wait then ends the way the kill / timeout paths end it, followed
+ * by the pi_withdraw() those paths make.
+ */
+static struct process kt_pi[3];
+static int kt_pi_slot[3];
+
+static int kt_pi_setup(void) {
+    static const int prio[3] = {20, 0, 5};
+    int n = 0;
+    for (int i = 0; i < MAX_PROCESSES && n < 3; i++)
+        if (!process_pool[i])
+            kt_pi_slot[n++] = i;
+    if (n < 3)
+        return -1;
+    for (int i = 0; i < 3; i++) {
+        struct process *p = &kt_pi[i];
+        memset(p, 0, sizeof(*p));
+        p->pid = 100000 + i;
+        p->tgid = 100000;
+        p->priority = prio[i];
+        p->pi_rank = PI_NONE;
+        p->on_cpu = -1;
+        p->state = PROC_SLEEPING;
+        INIT_LIST_HEAD(&p->run_list);
+        rcu_assign_pointer(process_pool[kt_pi_slot[i]], p);
+    }
+    return 0;
+}
+
+static void kt_pi_teardown(void) {
+    for (int i = 0; i < 3; i++)
+        rcu_assign_pointer(process_pool[kt_pi_slot[i]], NULL);
+}
+
+/* kt_pi_lend - donor d blocks on the holder, in SYS_CALL (futex 0) or on a
+ * FUTEX_WAIT_PI (futex 1), and lends its rank. */
+static void kt_pi_lend(struct process *d, int futex) {
+    if (futex) {
+        d->futex.state = FUTEX_W_QUEUED;
+    } else {
+        d->ipc_wait = IPC_WAIT_REPLY;
+        d->ipc_target_pid = (int)kt_pi[0].pid;
+    }
+    struct cpu_info *c = get_cpu_info();
+    struct process *cur = c->current_task;
+    c->current_task = d;
+    pi_boost((int)kt_pi[0].pid, futex);
+    c->current_task = cur;
+}
+
+/* test_pi_withdraw_killed - a holder runs at its best donor's rank and
+ * drops to the next one, then to its own, as the donors are killed and
+ * answered. */
+KTEST_CASE(test_pi_withdraw_killed) {
+    KASSERT_EQ(kt_pi_setup(), 0);
+    struct process *h = &kt_pi[0];
+    kt_pi_lend(&kt_pi[2], 0);
+    int one = h->pi_rank;
+    kt_pi_lend(&kt_pi[1], 0);
+    int both = h->pi_rank;
+    kt_pi[1].state = PROC_DEAD; /* process_terminate */
+    pi_withdraw((int)h->pid);
+    int killed = h->pi_rank;
+    kt_pi[2].ipc_wait = IPC_WAIT_NONE; /* ipc_deliver */
+    kt_pi[2].state = PROC_READY;
+    pi_withdraw((int)h->pid);
+    int answered = h->pi_rank;
+    kt_pi_teardown();
+    KASSERT_EQ(one, RT_PRIO_LEVELS + 5);
+    KASSERT_EQ(both, RT_PRIO_LEVELS + 0);
+    KASSERT_EQ(killed, RT_PRIO_LEVELS + 5);
+    KASSERT_EQ(answered, PI_NONE);
+}
+
+/* test_pi_withdraw_timeout - a FUTEX_WAIT_PI boosts a holder of its own
+ * process only, and the boost ends when the wait times out. */
+KTEST_CASE(test_pi_withdraw_timeout) {
+    KASSERT_EQ(kt_pi_setup(), 0);
+    struct process *h = &kt_pi[0];
+    kt_pi[2].tgid = 100002; /* another process: not a valid holder */
+    kt_pi_lend(&kt_pi[2], 1);
+    int foreign = h->pi_rank;
+    kt_pi_lend(&kt_pi[1], 1);
+    int boosted = h->pi_rank;
+    int donee = kt_pi[1].pi_donee;
+    kt_pi[1].futex.state = FUTEX_W_TIMEDOUT; /* futex_timeout */
+    kt_pi[1].state = PROC_READY;
+    pi_withdraw(donee);
+    int timed_out = h->pi_rank;
+    kt_pi_teardown();
+    KASSERT_EQ(foreign, PI_NONE);
+    KASSERT_EQ(boosted, RT_PRIO_LEVELS + 0);
+    KASSERT_EQ(donee, (int)h->pid);
+    KASSERT_EQ(timed_out, PI_NONE);
+}
+
+/*
+ * SCHED_RT cases, on the PI fake threads.  They run before any thread has
+ * a reservation, so the whole admission cap (RT_BW_ADMIT per mille per
+ * online CPU; only the BSP is online here) is free, and every thread is
+ * put back to SCHED_NORMAL so the bandwidth it took is returned.
+ */
+static long kt_rt_set(struct process *p, uint32_t policy, uint32_t runtime_ms,
+                      uint32_t period_ms) {
+    struct sched_attr a = {policy, 0, runtime_ms, period_ms};
+    struct cpu_info *c = get_cpu_info();
+    struct process *cur = c->current_task;
+    c->current_task = p;
+    long rc = sched_setattr(0, &a);
+    c->current_task = cur;
+    return rc;
+}
+
+/* test_rt_admission - reservations are admitted up to the cap exactly,
+ * the next one is refused with -EBUSY, and leaving SCHED_RT makes room. */
+KTEST_CASE(test_rt_admission) {
+    KASSERT_EQ(kt_pi_setup(), 0);
+    uint32_t cap = 0;
+    for (int i = 0; i < MAX_CPUS; i++)
+        cap += cpu_data[i].online ? RT_BW_ADMIT : 0;
+    if (!cap)
+        cap = RT_BW_ADMIT;
+    /* A 10 s period is 1000 ticks: runtime_ms / 10 is the per-mille cost. */
+    long a = kt_rt_set(&kt_pi[0], SCHED_RT, cap / 2 * 10, 10000);
+    long b = kt_rt_set(&kt_pi[1], SCHED_RT, (cap - cap / 2) * 10, 10000);
+    long over = kt_rt_set(&kt_pi[2], SCHED_RT, 10, 10000);
+    long freed = kt_rt_set(&kt_pi[0], SCHED_NORMAL, 0, 0);
+    long fits = kt_rt_set(&kt_pi[2], SCHED_RT, 10, 10000);
+    kt_rt_set(&kt_pi[1], SCHED_NORMAL, 0, 0);
+    kt_rt_set(&kt_pi[2], SCHED_NORMAL, 0, 0);
+    kt_pi_teardown();
+    KASSERT_EQ(a, 0);
+    KASSERT_EQ(b, 0);
+    KASSERT_EQ(over, -EBUSY);
+    KASSERT_EQ(freed, 0);
+    KASSERT_EQ(fits, 0);
+}
+
+/* test_rt_throttle - a running thread is charged its budget tick by tick,
+ * drops out of the RT class (and stops being charged to the CPU's RT
+ * window) once the budget is spent, and is back with a fresh budget when
+ * its period ends. */
+KTEST_CASE(test_rt_throttle) {
+    KASSERT_EQ(kt_pi_setup(), 0);
+    struct process *t = &kt_pi[0];
+    long rc = kt_rt_set(t, SCHED_RT, 20, 1000); /* 2 ticks every 100 */
+    struct cpu_info *c = get_cpu_info();
+    struct process *cur = c->current_task;
+    uint64_t j0 = jiffies, window = c->rt_window;
+    uint32_t used = c->rt_used;
+    int budget[5];
+    uint32_t charged[5];
+    c->current_task = t;
+    t->state = PROC_RUNNING;
+    for (int i = 0; i < 5; i++) {
+        if (i == 4)
+            jiffies = t->rt_period_end; /* the period ends */
+        sched_tick();
+        budget[i] = t->rt_budget;
+        charged[i] = c->rt_used;
+    }
+    t->state = PROC_SLEEPING;
+    c->current_task = cur;
+    jiffies = j0;
+    c->rt_window = window;
+    c->rt_used = used;
+    kt_rt_set(t, SCHED_NORMAL, 0, 0);
+    kt_pi_teardown();
+    KASSERT_EQ(rc, 0);
+    KASSERT_EQ(budget[0], 1);
+    KASSERT_EQ(budget[1], 0);
+    KASSERT_EQ(charged[1], charged[0] + 1);
+    /* Throttled: neither budget nor RT window is charged. */
+    KASSERT_EQ(budget[2], 0);
+    KASSERT_EQ(budget[3], 0);
+    KASSERT_EQ(charged[3], charged[1]);
+    /* The new period: full budget, one tick of it already used. */
+    KASSERT_EQ(budget[4], 1);
+}
+
+static void kt_pmu_spin(void) {
+    for (volatile int i = 0; i < 20000; i++)
+        ;
+}
+
+/* test_pmu_fold_bounded - context-switch folds between two fake threads
+ * only ever add to their counts, PMU_RESET zeroes the caller's and counting
+ * resumes from there, and every count charged fits in what the hardware
+ * counted over the whole window.  Trivially passes without counters. */
+KTEST_CASE(test_pmu_fold_bounded) {
+    static struct process a, b;
+    if (!pmu_on())
+        return;
+    memset(&a, 0, sizeof(a));
+    memset(&b, 0, sizeof(b));
+    struct cpu_info *c = get_cpu_info();
+    uint64_t start[PMU_NR_EVENTS], end[PMU_NR_EVENTS];
+    uint64_t flags;
+    hal_irq_save(&flags);
+    arch_pmu_read(start);
+    pmu_switch(NULL); /* baseline: earlier counts go to nobody */
+    int monotonic = 1;
+    uint64_t last[PMU_NR_EVENTS] = {0};
+    for (int i = 0; i < 4; i++) {
+        kt_pmu_spin();
+        pmu_switch(&a);
+        kt_pmu_spin();
+        pmu_switch(&b);
+        for (int e = 0; e < PMU_NR_EVENTS; e++) {
+            monotonic &= a.pmu_count[e] >= last[e];
+            last[e] = a.pmu_count[e];
+        }
+    }
+    uint64_t before[PMU_NR_EVENTS];
+    for (int e = 0; e < PMU_NR_EVENTS; e++)
+        before[e] = a.pmu_count[e];
+
+    struct process *cur = c->current_task;
+    c->current_task = &a;
+    sys_pmu(PMU_RESET, 0, 0);
+    c->current_task = cur;
+    int zeroed = 1;
+    for (int e = 0; e < PMU_NR_EVENTS; e++)
+        zeroed &= a.pmu_count[e] == 0;
+    kt_pmu_spin();
+    pmu_switch(&a);
+    arch_pmu_read(end);
+    hal_irq_restore(flags);
+
+    int bounded = 1;
+    for (int e = 0; e < PMU_NR_EVENTS; e++) {
+        uint64_t hw = (end[e] - start[e]) & pmu_hw.mask[e];
+        bounded &= before[e] + a.pmu_count[e] + b.pmu_count[e] <= hw;
+    }
+    KASSERT(monotonic);
+    KASSERT(zeroed);
+    KASSERT(bounded);
+    KASSERT(before[PMU_CYCLES] > 0);
+    KASSERT(a.pmu_count[PMU_CYCLES] > 0);
+}
+
+/* SMP cases (KTEST_SMP_CASE): run on every CPU at once after SMP boot. */
+#define KT_LOCK_ITERS 100000
+
+static DEFINE_SPINLOCK(kt_smp_ticket);
+static DEFINE_QSPINLOCK(kt_smp_queued);
+static volatile long kt_smp_counter[2];
+
+/* test_smp_lock_counter - every CPU adds KT_LOCK_ITERS to a shared counter
+ * with a plain load and store, under a ticket lock and then a queued lock:
+ * the totals come out exact, and with LOCKSTAT both locks recorded every
+ * acquisition and some contention. */
+KTEST_SMP_CASE(test_smp_lock_counter) {
+    spinlock_t *locks[2] = {&kt_smp_ticket, &kt_smp_queued};
+    for (int i = 0; i < 2; i++) {
+        if (cpu == 0)
+            kt_smp_counter[i] = 0;
+        ktest_smp_barrier();
+        for (int n = 0; n < KT_LOCK_ITERS; n++) {
+            spin_lock(locks[i]);
+            kt_smp_counter[i] = kt_smp_counter[i] + 1;
+            spin_unlock(locks[i]);
+        }
+        ktest_smp_barrier();
+    }
+    if (cpu != 0)
+        return;
+    for (int i = 0; i < 2; i++) {
+        KASSERT_EQ(kt_smp_counter[i], (long)ncpus * KT_LOCK_ITERS);
+#ifdef CONFIG_LOCKSTAT
+        KASSERT(locks[i]->stat.acquired >= (uint64_t)ncpus * KT_LOCK_ITERS);
+        KASSERT(locks[i]->stat.contended > 0);
+#endif
+    }
+}
@@ -16,28 +16,31 @@
  *   - Formatted string production is delegated to vsnprintf() (vsnprintf.c).
  *   - Each CPU has a per-CPU buffer (cpu->printk_buf, 2048 bytes) to avoid
  *     sharing a global buffer across CPUs without a lock.
- *   - A global spinlock (uart_lock) serialises UART writes across all CPUs.
+ *   - The formatted message becomes a record in this CPU's kernel log ring
+ *     (klog.c); the "[time] [C<id>] " prefix and the trip to the UART happen
+ *     later, in the log drain.  printk never waits for the UART and takes no
+ *     lock shared with other CPUs.
  *   - A per-CPU recursion guard (cpu->in_printk) detects recursive printk calls
  *     (e.g. from a fault handler that fires during printk).
- *   - panic() sets panic_flag atomically so other CPUs can halt via IPI, then
+ *   - panic() sets panic_flag atomically so other CPUs can halt via IPI,
+ *     switches the log to emergency (synchronous, lock-free) output, then
  *     prints and spins.
  *
  * Invariants:
- *   - uart_lock is always acquired with IRQs saved (spin_lock_irqsave) so that
- *     a timer IRQ cannot try to printk while uart_lock is already held.
- *   - in_printk is set AFTER the lock is taken to prevent a false-positive
- *     recursive-printk detection (see comment in vprintk for the exact race).
+ *   - in_printk is read and set with IRQs masked, so neither an IRQ nor a
+ *     task switch can observe it mid-printk on this CPU (see vprintk).
  *
  * Known issues:
- *   LIB-PRINTK-01  (W2 REFINE) cpu->printk_buf is 2048 bytes; the prefix
- *                  consumes 6 bytes.  Long messages are silently truncated by
- *                  vsnprintf with no dropped-message counter.
+ *   LIB-PRINTK-01  (W2 REFINE) cpu->printk_buf is 2048 bytes; longer messages
+ *                  are silently truncated by vsnprintf.  (Messages the log
+ *                  ring has no room for are counted and reported by klog.)
  */
 #include <drivers/uart.h>
 #include <kernel/arch.h>
 #include <kernel/cpu.h>
 #include <kernel/fault.h>
 #include <kernel/irq.h>
+#include <kernel/klog.h>
 #include <kernel/printk.h>
 #include <kernel/sched.h>
 #include <kernel/string.h>
@@ -53,18 +56,6 @@ volatile int panic_flag = 0;
 
 /* vsnprintf is now in vsnprintf.c */
 
-/* kputc - write a single character to the UART.
- * Called only from kputs; not exported. */
-static void kputc(char c) { uart_putc(c); }
-
-/* kputs - write a NUL-terminated string to the UART byte by byte.
- * Called from vprintk after the formatted buffer is ready.
- * Not exported; callers outside this file use printk/vprintk. */
-static void kputs(const char *s) {
-  while (*s)
-    kputc(*s++);
-}
-
 /*
  * snprintf - format a string into a fixed-size buffer (variadic wrapper).
  *
@@ -94,75 +85,56 @@ int snprintf(char *buf, size_t size, const char *fmt, ...) {
 }
 
 /*
- * vprintk - format and emit a log message from a va_list.
+ * vprintk - format and log a message from a va_list.
  *
  * This is the core printk implementation.  It:
- *   1. Acquires uart_lock with IRQ save BEFORE reading in_printk (see NOTE below).
- *   2. Checks for recursive printk; if detected, unlocks and emits a bare warning
+ *   1. Masks IRQs BEFORE reading in_printk (see NOTE below).
+ *   2. Checks for recursive printk; if detected, emits a bare warning
  *      directly via uart_puts (which does not go through vprintk).
  *   3. Sets cpu->in_printk to block re-entry while the buffer is in use.
- *   4. Formats a "[C<id>] " prefix into cpu->printk_buf (6 bytes).
- *   5. Formats the message into cpu->printk_buf after the prefix using vsnprintf.
- *   6. Emits the buffer via kputs.
- *   7. Clears in_printk and releases uart_lock.
+ *   4. Formats the message into cpu->printk_buf using vsnprintf.
+ *   5. Appends it to this CPU's log ring (klog_write) and clears in_printk.
+ *   6. Restores IRQs and kicks the log drain, which sends whatever the UART
+ *      accepts right now (everything, during early boot and after panic).
  *
  * Params:
  *   fmt  - printf-style format string.
  *   args - argument list; caller is responsible for va_start/va_end.
- * Returns: number of characters written by vsnprintf (message portion only;
- *          prefix length is not included).
- * Locking: acquires uart_lock with IRQ save/restore; NOT safe from NMI context.
- * Side effects: writes to uart; may be called from interrupt context (IRQ disabled
- *               on entry while lock is held).
+ * Returns: number of characters written by vsnprintf.
+ * Locking: none shared across CPUs; IRQs masked locally while formatting.
+ *          NOT safe from NMI context.
+ * Side effects: log record; possibly UART output.  May be called from
+ *               interrupt context.
  *
- * NOTE(LIB-PRINTK-01): cpu->printk_buf is 2048 bytes; the prefix consumes ~6.
- *   vsnprintf receives (2048 - pfx) bytes.  If the formatted message is longer,
- *   it is silently truncated at (2048 - pfx - 1) characters with no warning or
- *   counter increment.
+ * NOTE(LIB-PRINTK-01): cpu->printk_buf is 2048 bytes; a longer formatted
+ *   message is silently truncated at 2047 characters.
  *
- * NOTE on in_printk ordering: uart_lock is acquired BEFORE checking in_printk.
- *   Without this ordering, the following SMP race can occur:
- *     CPU A: sets in_printk=1
- *     Timer IRQ fires, switches to task on CPU A
- *     CPU A (new task): reads in_printk=1 → false "[RECURSIVE PRINTK DETECTED]"
- *   By taking the lock first, only one CPU can inspect/modify in_printk at a time.
+ * NOTE on in_printk ordering: IRQs are masked BEFORE checking in_printk.
+ *   Otherwise the timer IRQ could preempt between in_printk=1 and its
+ *   clearing, switch to another task on this CPU, and that task's printk
+ *   would see a stale in_printk=1 → false "[RECURSIVE PRINTK DETECTED]".
  */
-/* Global UART lock for synchronized serial output */
-static spinlock_t uart_lock = SPINLOCK_INIT;
-
 int vprintk(const char *fmt, va_list args) {
-  struct cpu_info *cpu = get_cpu_info();
   uint64_t flags;
   int len;
 
-  /* Acquire lock and disable IRQs BEFORE setting in_printk.
-   * Without this, the timer IRQ can preempt between in_printk=1 and the lock,
-   * switch to another task, and that task's next printk sees a stale
-   * in_printk=1 on this CPU → false "[RECURSIVE PRINTK DETECTED]" spam. */
-  spin_lock_irqsave(&uart_lock, &flags);
+  hal_irq_save(&flags);
+  struct cpu_info *cpu = get_cpu_info();
 
   if (cpu->in_printk) {
-    spin_unlock_irqrestore(&uart_lock, flags);
+    hal_irq_restore(flags);
     uart_puts("\n[RECURSIVE PRINTK DETECTED]\n");
     return 0;
   }
 
   cpu->in_printk = 1;
-
-  /* Prepend "[C%d] " CPU prefix for multi-CPU log disambiguation */
-  int pfx = snprintf(cpu->printk_buf, 8, "[C%u] ", cpu->cpu_id);
-  if (pfx < 0)
-    pfx = 0;
-
-  /* Format the actual message after the prefix */
-  len = vsnprintf(cpu->printk_buf + pfx, sizeof(cpu->printk_buf) - pfx, fmt,
-                  args);
-
-  kputs(cpu->printk_buf);
-
+  len = vsnprintf(cpu->printk_buf, sizeof(cpu->printk_buf), fmt, args);
+  if (len > 0)
+    klog_write(cpu->printk_buf, (size_t)len, 0);
   cpu->in_printk = 0;
-  spin_unlock_irqrestore(&uart_lock, flags);
+  hal_irq_restore(flags);
 
+  klog_kick();
   return len;
 }
 
@@ -177,7 +149,7 @@ int vprintk(const char *fmt, va_list args) {
  *   fmt - printf-style format string.
  *   ... - format arguments.
  * Returns: characters written (from vsnprintf, message portion only).
- * Locking: inherits vprintk's uart_lock; NOT safe from NMI context.
+ * Locking: as vprintk; NOT safe from NMI context.
  */
 int printk(const char *fmt, ...) {
   va_list args;
@@ -194,7 +166,9 @@ int printk(const char *fmt, ...) {
  * panic - print a fatal message and halt all CPUs permanently.
  *
  * Sequence:
- *   1. Atomically increments panic_flag so other CPUs' spin loops can detect it.
+ *   1. Atomically increments panic_flag so other CPUs' spin loops can detect it,
+ *      and flushes the kernel log in emergency mode (klog_emergency), after
+ *      which every printk goes straight to the UART without locks.
  *   2. Sends an IPI (SGI0) to all other CPUs via irq_send_ipi_all(), which causes
  *      them to enter their halt handler.  This is done BEFORE printing so that no
  *      other CPU's printk can interleave with the panic message.
@@ -208,9 +182,8 @@ int printk(const char *fmt, ...) {
  *   fmt - printf-style format string describing the panic cause.
  *   ... - format arguments.
  * Returns: never.
- * Locking: calls printk/vprintk (which acquire uart_lock).  The function does
- *          NOT acquire uart_lock itself; if another CPU holds uart_lock when
- *          panic() is called, the first printk may spin briefly.
+ * Locking: none; emergency-mode output takes no lock, so a CPU wedged in the
+ *          log drain cannot hold the panic message back.
  * Side effects: sets panic_flag, sends IPI, halts all CPUs.
  */
 void panic(const char *fmt, ...) {
@@ -219,9 +192,13 @@ void panic(const char *fmt, ...) {
   /* Signal all CPUs to stop BEFORE printing so no interleaving after this */
   __sync_fetch_and_add(&panic_flag, 1);
 
-  /* Fault context (kernel/fault.h): printk would take uart_lock (possibly
-   * held by a wedged CPU) and needs get_cpu_info — on amd64 a LAPIC-MMIO read
-   * that may itself fault.  Use the lock-free emergency path instead; print
+  /* Flush what is still queued in the log and print synchronously from here
+   * on: nobody will be left to drain it, and the drain lock may be held by
+   * a CPU that is about to stop. */
+  klog_emergency();
+
+  /* Fault context (kernel/fault.h): printk needs get_cpu_info — on amd64 a
+   * LAPIC-MMIO read that may itself fault.  Use fault_printf instead; print
    * FIRST, then attempt the quiesce IPI (its MMIO write may be the thing
    * that is broken). */
   if (fault_depth() > 0) {
@@ -0,0 +1,267 @@
+/*
+ * kernel/lib/prof.c
+ * Sampling profiler (see kernel/prof.h): per-CPU rings of struct
+ * prof_sample and the SYS_PROF control / drain call.
+ *
+ * The rings use the trace ring protocol (kernel/lib/trace.c): prof_rings[c]
+ * head is written only by CPU c from its timer IRQ, tail only by the
+ * prof_lock holder, each published with a release store.  A ring is
+ * allocated by the first PROF_START for the CPUs online then, or by
+ * prof_cpu_online() for a CPU that comes up while sampling, and never
+ * freed.
+ *
+ * Call chains are walked in IRQ context, so nothing here may fault:
+ *   - kernel: backtrace_collect() bounded to the interrupted task's kernel
+ *     stack;
+ *   - user: every frame word is looked up in the task's page table and read
+ *     through the direct map (vmm_copy_to_pgd does the same for writes).
+ *     mm_lock is only tried: if another CPU is changing the mappings, or
+ *     this CPU was interrupted holding the lock, the sample keeps just the
+ *     PC.
+ */
+#include <kernel/arch.h>
+#include <kernel/cpu.h>
+#include <kernel/fault.h>
+#include <kernel/kmalloc.h>
+#include <kernel/memlayout.h>
+#include <kernel/printk.h>
+#include <kernel/prof.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+#include <kernel/string.h>
+#include <kernel/vmm.h>
+#include <arch/pt_regs.h>
+
+#define PROF_BATCH 16 /* samples per locked copy in PROF_READ */
+
+static struct prof_ring {
+  struct prof_sample *buf;
+  uint64_t head; /* producer (owning CPU's timer IRQ) */
+  uint64_t tail; /* consumer (prof_lock) */
+  uint64_t lost; /* samples refused for lack of space */
+} prof_rings[MAX_CPUS];
+
+uint32_t prof_hz;
+static DEFINE_SPINLOCK(prof_lock);
+
+static int prof_user_word(uint64_t *pgd, uint64_t va, uint64_t *val) {
+  if ((va & 7) || !vmm_is_user_addr(va) || !vmm_is_user_addr(va + 8))
+    return -1;
+  if (vmm_check_range(pgd, va, 8, PTE_VALID | PTE_USER) != 0)
+    return -1;
+  uint64_t phys = vmm_get_phys(pgd, va);
+  if (!phys)
+    return -1;
+  *val = *(const uint64_t *)phys_to_virt(phys);
+  return 0;
+}
+
+/* prof_user_chain - return addresses of p's user fp chain after pc. */
+static int prof_user_chain(struct process *p, uint64_t pc, uint64_t fp,
+                           uint64_t *out, int max) {
+  int n = 0;
+  out[n++] = pc;
+  if (!p->page_table || !p->space || !spin_trylock(&p->space->mm_lock))
+    return n;
+  while (n < max) {
+    uint64_t next, ret;
+    if (prof_user_word(p->page_table, fp, &next) != 0 ||
+        prof_user_word(p->page_table, fp + 8, &ret) != 0 || !ret)
+      break;
+    out[n++] = ret;
+    if (next <= fp) /* the stack grows down: callers are above */
+      break;
+    fp = next;
+  }
+  spin_unlock(&p->space->mm_lock);
+  return n;
+}
+
+void __prof_sample(struct pt_regs *regs) {
+  struct cpu_info *cpu = get_cpu_info();
+  struct prof_ring *r = &prof_rings[cpu->cpu_id];
+  if (!__atomic_load_n(&r->buf, __ATOMIC_ACQUIRE))
+    return;
+  uint64_t head = r->head;
+  if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >=
+      PROF_RING_SAMPLES) {
+    __atomic_add_fetch(&r->lost, 1, __ATOMIC_RELAXED);
+    return;
+  }
+  struct prof_sample *s = &r->buf[head & (PROF_RING_SAMPLES - 1)];
+  struct process *p = cpu->current_task;
+  uint64_t pc = pt_regs_pc(regs), fp = pt_regs_fp(regs);
+  int depth;
+
+  s->ts = arch_timer_get_count();
+  s->pid = p ? p->pid : 0;
+  s->cpu = (uint8_t)cpu->cpu_id;
+  s->pad = 0;
+  if (p)
+    strncpy(s->comm, p->name, sizeof(s->comm) - 1);
+  else
+    strncpy(s->comm, "kernel", sizeof(s->comm) - 1);
+  s->comm[sizeof(s->comm) - 1] = '\0';
+
+  if (pt_regs_user_mode(regs)) {
+    s->flags = PROF_S_USER;
+    depth = prof_user_chain(p, pc, fp, s->pc, PROF_MAX_FRAMES);
+  } else {
+    s->flags = 0;
+    uint64_t hi = p ? p->kernel_stack : 0;
+    depth = hi ? backtrace_collect(pc, fp, hi - STACK_SIZE, hi, s->pc,
+                                   PROF_MAX_FRAMES)
+               : backtrace_collect(pc, 0, 0, 0, s->pc, 1);
+  }
+  s->depth = (uint8_t)depth;
+  for (int i = depth; i < PROF_MAX_FRAMES; i++)
+    s->pc[i] = 0;
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+}
+
+/* prof_ring_alloc - give CPU i a ring.  Allocates outside prof_lock; a
+ * racing start that got there first keeps its ring. */
+static long prof_ring_alloc(int i) {
+  struct prof_ring *r = &prof_rings[i];
+  if (__atomic_load_n(&r->buf, __ATOMIC_ACQUIRE))
+    return 0;
+  struct prof_sample *b =
+      kmalloc(PROF_RING_SAMPLES * sizeof(struct prof_sample));
+  if (!b)
+    return -ENOMEM;
+  uint64_t flags;
+  spin_lock_irqsave(&prof_lock, &flags);
+  if (!r->buf) {
+    /* Reader state starts at the producer's position. */
+    r->tail = r->head;
+    __atomic_store_n(&r->buf, b, __ATOMIC_RELEASE);
+    b = NULL;
+  }
+  spin_unlock_irqrestore(&prof_lock, flags);
+  if (b)
+    kfree(b);
+  return 0;
+}
+
+static long prof_alloc(void) {
+  for (int i = 0; i < MAX_CPUS; i++) {
+    if (!cpu_data[i].online)
+      continue;
+    long rc = prof_ring_alloc(i);
+    if (rc != 0)
+      return rc;
+  }
+  return 0;
+}
+
+void prof_cpu_online(void) {
+  if (prof_rate())
+    (void)prof_ring_alloc((int)get_cpu_info()->cpu_id);
+}
+
+/* prof_start - drop what is buffered and sample at hz from now on.
+ * Caller holds prof_lock. */
+static void prof_start(uint32_t hz) {
+  for (int i = 0; i < MAX_CPUS; i++) {
+    struct prof_ring *r = &prof_rings[i];
+    __atomic_store_n(&r->tail, __atomic_load_n(&r->head, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELEASE);
+    __atomic_store_n(&r->lost, 0, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&prof_hz, hz, __ATOMIC_RELEASE);
+}
+
+static long prof_start_hz(uint64_t hz) {
+  if (hz == 0)
+    hz = PROF_DEFAULT_HZ;
+  if (hz < PROF_MIN_HZ || hz > PROF_MAX_HZ)
+    return -EINVAL;
+  long rc = prof_alloc();
+  if (rc != 0)
+    return rc;
+  uint64_t flags;
+  spin_lock_irqsave(&prof_lock, &flags);
+  prof_start((uint32_t)hz);
+  spin_unlock_irqrestore(&prof_lock, flags);
+  return 0;
+}
+
+void prof_boot_start(uint32_t hz) {
+  long rc = prof_start_hz(hz);
+  if (rc != 0)
+    pr_warn("prof: boot profiling at %u Hz failed (%ld)\n", hz, rc);
+  else
+    pr_info("prof: sampling at %u Hz from boot\n", hz);
+}
+
+/* prof_take - move up to max samples out of the rings, lowest CPU first.
+ * Caller holds prof_lock. */
+static int prof_take(struct prof_sample *out, int max) {
+  int n = 0;
+  for (int i = 0; i < MAX_CPUS && n < max; i++) {
+    struct prof_ring *r = &prof_rings[i];
+    if (!r->buf)
+      continue;
+    uint64_t tail = r->tail;
+    uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    while (tail != head && n < max)
+      out[n++] = r->buf[tail++ & (PROF_RING_SAMPLES - 1)];
+    __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+  }
+  return n;
+}
+
+static long prof_read(void *ubuf, size_t size) {
+  struct prof_sample batch[PROF_BATCH];
+  size_t done = 0;
+  while (size - done >= sizeof(struct prof_sample)) {
+    size_t room = (size - done) / sizeof(struct prof_sample);
+    uint64_t flags;
+    spin_lock_irqsave(&prof_lock, &flags);
+    int n = prof_take(batch, room < PROF_BATCH ? (int)room : PROF_BATCH);
+    spin_unlock_irqrestore(&prof_lock, flags);
+    if (n == 0)
+      break;
+    size_t bytes = (size_t)n * sizeof(struct prof_sample);
+    if (vmm_copy_to_user((char *)ubuf + done, batch, bytes) != 0)
+      return -EFAULT;
+    done += bytes;
+  }
+  return (long)done;
+}
+
+static void prof_get_info(struct prof_info *info) {
+  info->clock_hz = arch_timer_get_freq();
+  info->lost = 0;
+  info->ncpu = 0;
+  for (int i = 0; i < MAX_CPUS; i++) {
+    if (!prof_rings[i].buf)
+      continue;
+    info->lost += __atomic_load_n(&prof_rings[i].lost, __ATOMIC_RELAXED);
+    info->ncpu++;
+  }
+  info->hz = prof_rate();
+  info->ring_samples = PROF_RING_SAMPLES;
+  info->pad = 0;
+}
+
+long sys_prof(int op, uint64_t a1, uint64_t a2) {
+  if (!proc_is_privileged(current_process))
+    return -EPERM;
+  switch (op) {
+  case PROF_START:
+    return prof_start_hz(a1);
+  case PROF_STOP:
+    return __atomic_exchange_n(&prof_hz, 0, __ATOMIC_ACQ_REL);
+  case PROF_READ:
+    return prof_read((void *)a1, (size_t)a2);
+  case PROF_INFO: {
+    struct prof_info info;
+    prof_get_info(&info);
+    return vmm_copy_to_user((void *)a1, &info, sizeof(info)) != 0 ? -EFAULT
+                                                                   : 0;
+  }
+  default:
+    return -EINVAL;
+  }
+}
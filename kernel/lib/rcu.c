@@ -0,0 +1,164 @@
+/*
+ * kernel/lib/rcu.c
+ * Grace periods and callbacks for kernel/rcu.h.
+ *
+ * Grace periods are numbered.  rcu_gp_cur is the last one started and
+ * rcu_gp_done the last one completed; they differ while one is in flight.
+ * Starting one snapshots the online CPUs into rcu_gp_mask, and each CPU
+ * clears its own bit at its next quiescent state.  Clearing is correct
+ * whenever it happens after the snapshot: the reporting CPU is outside
+ * every read section at that moment, so none of its readers predates the
+ * grace period.  The CPU that clears the last bit ends the grace period
+ * and, if someone asked for another meanwhile, starts the next.
+ *
+ * Callbacks go on the calling CPU's `next` list.  Its tick moves them, as
+ * a batch, to `wait` and requests a grace period that begins after they
+ * were queued; once that one is done the batch runs.  Only the owning CPU
+ * touches its lists, always with IRQs masked, so they need no lock.  The
+ * fast paths (rcu_note_qs with nothing to report, rcu_tick with nothing
+ * queued) only read shared state.
+ */
+#include <kernel/arch.h>
+#include <kernel/cpu.h>
+#include <kernel/rcu.h>
+#include <kernel/spinlock.h>
+
+struct rcu_cpu {
+  uint32_t qs_gp;           /* last grace period this CPU reported for */
+  uint32_t wait_gp;         /* grace period the wait batch needs */
+  struct rcu_head *next;    /* queued, no grace period requested yet */
+  struct rcu_head *wait;    /* waiting for wait_gp */
+} __cacheline_aligned;
+
+static struct rcu_cpu rcu_cpus[MAX_CPUS];
+
+static volatile uint32_t rcu_gp_cur;
+static volatile uint32_t rcu_gp_done;
+static uint64_t rcu_gp_mask;
+static int rcu_gp_more;
+static DEFINE_SPINLOCK(rcu_gp_lock);
+
+static inline int rcu_gp_after(uint32_t a, uint32_t b) {
+  return (int32_t)(a - b) >= 0;
+}
+
+static uint64_t rcu_online_mask(void) {
+  uint64_t mask = 0;
+  for (int i = 0; i < MAX_CPUS; i++)
+    if (cpu_data[i].online)
+      mask |= 1ull << i;
+  return mask;
+}
+
+/* rcu_gp_start - caller holds rcu_gp_lock.  The mask is in place before the
+ * new number is visible, so no CPU can report against a stale mask. */
+static void rcu_gp_start(void) {
+  __atomic_store_n(&rcu_gp_mask, rcu_online_mask(), __ATOMIC_RELAXED);
+  __atomic_store_n(&rcu_gp_cur, rcu_gp_cur + 1, __ATOMIC_RELEASE);
+}
+
+/* rcu_gp_request - grace period whose end covers everything before now. */
+static uint32_t rcu_gp_request(void) {
+  uint64_t flags;
+  uint32_t target;
+  spin_lock_irqsave(&rcu_gp_lock, &flags);
+  if (rcu_gp_cur == rcu_gp_done) {
+    rcu_gp_start();
+    target = rcu_gp_cur;
+  } else {
+    /* The running one may have started before our caller's update. */
+    rcu_gp_more = 1;
+    target = rcu_gp_cur + 1;
+  }
+  spin_unlock_irqrestore(&rcu_gp_lock, flags);
+  return target;
+}
+
+static void rcu_gp_end(void) {
+  uint64_t flags;
+  spin_lock_irqsave(&rcu_gp_lock, &flags);
+  if (rcu_gp_cur != rcu_gp_done &&
+      __atomic_load_n(&rcu_gp_mask, __ATOMIC_ACQUIRE) == 0) {
+    __atomic_store_n(&rcu_gp_done, rcu_gp_cur, __ATOMIC_RELEASE);
+    if (rcu_gp_more) {
+      rcu_gp_more = 0;
+      rcu_gp_start();
+    }
+  }
+  spin_unlock_irqrestore(&rcu_gp_lock, flags);
+}
+
+void rcu_note_qs(struct cpu_info *cpu) {
+  struct rcu_cpu *rc = &rcu_cpus[cpu->cpu_id];
+  uint32_t gp = __atomic_load_n(&rcu_gp_cur, __ATOMIC_ACQUIRE);
+  if (rc->qs_gp == gp)
+    return;
+  rc->qs_gp = gp;
+  uint64_t bit = 1ull << cpu->cpu_id;
+  if (!(__atomic_load_n(&rcu_gp_mask, __ATOMIC_RELAXED) & bit))
+    return;
+  /* Release: this CPU's finished read sections happen before the end. */
+  if (__atomic_and_fetch(&rcu_gp_mask, ~bit, __ATOMIC_ACQ_REL) == 0)
+    rcu_gp_end();
+}
+
+static void rcu_run(struct rcu_head *list) {
+  while (list) {
+    struct rcu_head *next = list->next;
+    list->func(list);
+    list = next;
+  }
+}
+
+void rcu_tick(struct cpu_info *cpu) {
+  struct rcu_cpu *rc = &rcu_cpus[cpu->cpu_id];
+  rcu_note_qs(cpu);
+  if (rc->wait &&
+      rcu_gp_after(__atomic_load_n(&rcu_gp_done, __ATOMIC_ACQUIRE),
+                   rc->wait_gp)) {
+    struct rcu_head *done = rc->wait;
+    rc->wait = NULL;
+    rcu_run(done);
+  }
+  if (!rc->wait && rc->next) {
+    rc->wait = rc->next;
+    rc->next = NULL;
+    rc->wait_gp = rcu_gp_request();
+  }
+}
+
+void call_rcu(struct rcu_head *head, void (*func)(struct rcu_head *head)) {
+  uint64_t flags;
+  hal_irq_save(&flags);
+  struct rcu_cpu *rc = &rcu_cpus[get_cpu_info()->cpu_id];
+  head->func = func;
+  head->next = rc->next;
+  rc->next = head;
+  hal_irq_restore(flags);
+}
+
+uint32_t rcu_poll_start(void) {
+  return rcu_gp_request();
+}
+
+int rcu_poll_done(uint32_t cookie) {
+  return rcu_gp_after(__atomic_load_n(&rcu_gp_done, __ATOMIC_ACQUIRE), cookie);
+}
+
+void synchronize_rcu(void) {
+  /* One CPU, and the caller is not a reader: nobody else can be. */
+  uint64_t online = rcu_online_mask();
+  if ((online & (online - 1)) == 0)
+    return;
+  uint32_t target = rcu_poll_start();
+  for (;;) {
+    uint64_t flags;
+    hal_irq_save(&flags);
+    rcu_note_qs(get_cpu_info());
+    hal_irq_restore(flags);
+    uint32_t done = __atomic_load_n(&rcu_gp_done, __ATOMIC_ACQUIRE);
+    if (rcu_gp_after(done, target))
+      return;
+    arch_spin_wait(&rcu_gp_done, done);
+  }
+}
@@ -17,12 +17,21 @@
  *
  * Data Model:
  *   A static array of MAX_REGISTRY_KEYS (128) struct registry_entry, each
- *   holding a key[64], value[128], and used flag.  Total static cost: 128 ×
- *   (64 + 128 + 4) = ~24 KB of BSS.  No heap allocation is used.
+ *   holding a key[64], a used flag and a pointer to its current value, plus
+ *   a static pool of 2 × MAX_REGISTRY_KEYS struct registry_value (text[128]).
+ *   Total static cost is ~45 KB of BSS.  The heap is used only when a burst
+ *   of updates has every pooled value waiting out a grace period.
  *
  * Lookup:
  *   O(n) linear scan of registry_store[] on every read and write.  At 128
- *   entries this is negligible in practice.
+ *   entries this is negligible in practice.  Reads take no lock (kernel/rcu.h):
+ *   an entry's key never changes once used is set, and a value is never
+ *   modified in place — an update publishes a fresh registry_value and
+ *   recycles the old one after a grace period.  Writers still serialise on
+ *   registry_lock.  Half the value pool is live at most, so the other half
+ *   absorbs updates until the next grace period returns them; a burst that
+ *   outruns it (one uring batch can) takes kmalloc'd values, which the RCU
+ *   callback kfree()s instead of pooling.
  *
  * Known issues:
  *   LIB-REG-01  (W3 WRONG-DESIGN)  The store is a flat 128-slot array with no
@@ -40,7 +49,11 @@
  *               discover registry contents without knowing key names in advance.
  */
 
+#include <kernel/event.h>
+#include <kernel/kmalloc.h>
+#include <kernel/ntfn.h>
 #include <kernel/printk.h>
+#include <kernel/rcu.h>
 #include <kernel/registry.h>
 #include <kernel/sched.h> /* For current_process/permissions check if needed later */
 #include <kernel/spinlock.h>
@@ -57,15 +70,54 @@
  * Capacity: MAX_REGISTRY_KEYS (128) entries, each 196 bytes; ~24 KB total BSS.
  * NOTE(LIB-REG-01): flat array — no tree, no hierarchy, O(n) scan per op. */
 static struct registry_entry registry_store[MAX_REGISTRY_KEYS];
+/* registry_values[]: value pool; free ones are chained through rcu.next
+ * from registry_free_values (under registry_lock). */
+static struct registry_value registry_values[2 * MAX_REGISTRY_KEYS];
+static struct registry_value *registry_free_values;
 /* registry_count: number of slots currently marked used (informational; used
  * only for the init log message; not consulted during lookup or insert). */
 static int registry_count = 0;
-/* registry_lock: global spinlock protecting registry_store[] and registry_count.
+/* registry_lock: global spinlock serialising writers of registry_store[],
+ * registry_count and the value free list; readers do not take it.
  * Acquired with IRQ save/restore so the store is safe to access from IRQ context.
  * NOTE(LIB-REG-02): the lock protects data integrity but not access permissions;
  * any caller (any privilege level) can write any key. */
 static DEFINE_SPINLOCK(registry_lock);
 
+/* registry_value_get - a value holding a copy of text: a pooled one, else
+ * *spare (a kmalloc'd value the caller brought, consumed), else NULL.
+ * Caller holds registry_lock. */
+static struct registry_value *registry_value_get(const char *text,
+                                                 struct registry_value **spare) {
+  struct registry_value *v = registry_free_values;
+  if (v) {
+    registry_free_values = (struct registry_value *)v->rcu.next;
+  } else if (*spare) {
+    v = *spare;
+    *spare = NULL;
+  } else {
+    return NULL;
+  }
+  strncpy(v->text, text, MAX_VAL_LEN - 1);
+  v->text[MAX_VAL_LEN - 1] = '\0';
+  return v;
+}
+
+/* registry_value_put_rcu - back to the pool (or the heap) once no reader
+ * can hold it. */
+static void registry_value_put_rcu(struct rcu_head *head) {
+  struct registry_value *v = container_of(head, struct registry_value, rcu);
+  if (v < registry_values || v >= registry_values + 2 * MAX_REGISTRY_KEYS) {
+    kfree(v);
+    return;
+  }
+  uint64_t flags;
+  spin_lock_irqsave(&registry_lock, &flags);
+  v->rcu.next = (struct rcu_head *)registry_free_values;
+  registry_free_values = v;
+  spin_unlock_irqrestore(&registry_lock, flags);
+}
+
 /*
  * registry_init - zero the store and install default entries.
  *
@@ -83,6 +135,11 @@ static DEFINE_SPINLOCK(registry_lock);
 void registry_init(void) {
   memset(registry_store, 0, sizeof(registry_store));
   registry_count = 0;
+  registry_free_values = NULL;
+  for (int i = 2 * MAX_REGISTRY_KEYS - 1; i >= 0; i--) {
+    registry_values[i].rcu.next = (struct rcu_head *)registry_free_values;
+    registry_free_values = &registry_values[i];
+  }
 
   /* Set default values (owner 0 = kernel/system) */
   registry_set("theme.color", "dark", 0);
@@ -92,33 +149,10 @@ void registry_init(void) {
   pr_info("Registry: Initialized with %d default keys.\n", registry_count);
 }
 
-/*
- * registry_set - create or update a key-value pair.
- *
- * First scans for an existing entry with the matching key (O(n)); if found,
- * updates its value in place.  Otherwise, scans for a free slot (second O(n)
- * pass) and inserts a new entry.  Both key and value are truncated to
- * (MAX_KEY_LEN - 1) and (MAX_VAL_LEN - 1) characters respectively, and are
- * always NUL-terminated.
- *
- * NOTE(LIB-REG-01): two sequential O(n) scans; at 128 entries this is fine,
- *   but does not scale to a large store.
- * LIB-REG-02 RESOLVED: first-writer-wins ownership — an existing key may be
- *   overwritten only by its creator PID or by a kernel/system caller
- *   (owner_pid 0); everyone else gets -EACCES.
- *
- * Params:
- *   key       - NUL-terminated key string; must be non-NULL.
- *   value     - NUL-terminated value string; must be non-NULL.
- *   owner_pid - caller identity: 0 = kernel/system, otherwise the PID.
- * Returns: 0 on success, -EACCES on ownership violation, -1 if key or value
- *          is NULL or the store is full.
- * Locking: acquires registry_lock with IRQ save/restore.
- */
-int registry_set(const char *key, const char *value, int owner_pid) {
-  if (!key || !value)
-    return -1;
-
+/* __registry_set - registry_set with the value taken from the pool or
+ * *spare; -EAGAIN when it has neither (nothing was changed). */
+static int __registry_set(const char *key, const char *value, int owner_pid,
+                          struct registry_value **spare) {
   uint64_t flags;
   spin_lock_irqsave(&registry_lock, &flags);
 
@@ -135,9 +169,17 @@ int registry_set(const char *key, const char *value, int owner_pid) {
                 owner_pid, key, registry_store[i].owner_pid);
         return -EACCES;
       }
-      strncpy(registry_store[i].value, value, MAX_VAL_LEN - 1);
-      registry_store[i].value[MAX_VAL_LEN - 1] = '\0';
+      struct registry_value *v = registry_value_get(value, spare);
+      if (!v) {
+        spin_unlock_irqrestore(&registry_lock, flags);
+        return -EAGAIN;
+      }
+      struct registry_value *old = registry_store[i].value;
+      rcu_assign_pointer(registry_store[i].value, v);
       spin_unlock_irqrestore(&registry_lock, flags);
+      call_rcu(&old->rcu, registry_value_put_rcu);
+      event_notify_registry(key);
+      ntfn_broadcast_sys(NTFN_SYS_REGISTRY);
       return 0;
     }
   }
@@ -145,16 +187,21 @@ int registry_set(const char *key, const char *value, int owner_pid) {
   /* Find free slot */
   for (int i = 0; i < MAX_REGISTRY_KEYS; i++) {
     if (!registry_store[i].used) {
+      struct registry_value *v = registry_value_get(value, spare);
+      if (!v) {
+        spin_unlock_irqrestore(&registry_lock, flags);
+        return -EAGAIN;
+      }
       strncpy(registry_store[i].key, key, MAX_KEY_LEN - 1);
       registry_store[i].key[MAX_KEY_LEN - 1] = '\0';
-
-      strncpy(registry_store[i].value, value, MAX_VAL_LEN - 1);
-      registry_store[i].value[MAX_VAL_LEN - 1] = '\0';
-
+      registry_store[i].value = v;
       registry_store[i].owner_pid = owner_pid;
-      registry_store[i].used = 1;
+      /* Publish: a lockless reader that sees used sees the rest. */
+      __atomic_store_n(&registry_store[i].used, 1, __ATOMIC_RELEASE);
       registry_count++;
       spin_unlock_irqrestore(&registry_lock, flags);
+      event_notify_registry(key);
+      ntfn_broadcast_sys(NTFN_SYS_REGISTRY);
       return 0;
     }
   }
@@ -164,6 +211,49 @@ int registry_set(const char *key, const char *value, int owner_pid) {
   return -1;
 }
 
+/*
+ * registry_set - create or update a key-value pair.
+ *
+ * First scans for an existing entry with the matching key (O(n)); if found,
+ * publishes a new value for it and retires the old one.  Otherwise, scans
+ * for a free slot (second O(n) pass) and inserts a new entry.  Both key and value are truncated to
+ * (MAX_KEY_LEN - 1) and (MAX_VAL_LEN - 1) characters respectively, and are
+ * always NUL-terminated.
+ *
+ * NOTE(LIB-REG-01): two sequential O(n) scans; at 128 entries this is fine,
+ *   but does not scale to a large store.
+ * LIB-REG-02 RESOLVED: first-writer-wins ownership — an existing key may be
+ *   overwritten only by its creator PID or by a kernel/system caller
+ *   (owner_pid 0); everyone else gets -EACCES.
+ *
+ * Params:
+ *   key       - NUL-terminated key string; must be non-NULL.
+ *   value     - NUL-terminated value string; must be non-NULL.
+ *   owner_pid - caller identity: 0 = kernel/system, otherwise the PID.
+ * Returns: 0 on success, -EACCES on ownership violation, -ENOMEM if the
+ *          pool is drained by a burst and kmalloc fails too, -1 if key or
+ *          value is NULL or the store is full.
+ * Locking: acquires registry_lock with IRQ save/restore; a successful write
+ *          then wakes EV_SRC_REGISTRY watchers (event_notify_registry) and
+ *          NTFN_SYS_REGISTRY subscribers with the lock dropped.
+ */
+int registry_set(const char *key, const char *value, int owner_pid) {
+  if (!key || !value)
+    return -1;
+  struct registry_value *spare = NULL;
+  int rc;
+  while ((rc = __registry_set(key, value, owner_pid, &spare)) == -EAGAIN) {
+    /* Every pooled value is waiting out a grace period: bring a heap one
+     * rather than fail the write. */
+    spare = kmalloc(sizeof(*spare));
+    if (!spare)
+      return -ENOMEM;
+  }
+  if (spare)
+    kfree(spare);
+  return rc;
+}
+
 /*
  * registry_get - look up a key and copy its value into a caller buffer.
  *
@@ -176,24 +266,26 @@ int registry_set(const char *key, const char *value, int owner_pid) {
  *   size   - capacity of buffer including NUL slot; must be > 0.
  * Returns: 0 on success (key found and value copied), -1 if not found or
  *          if key or buffer is NULL.
- * Locking: acquires registry_lock with IRQ save/restore.
+ * Locking: none; an RCU read section around the scan and copy.
  */
 int registry_get(const char *key, char *buffer, size_t size) {
   if (!key || !buffer)
     return -1;
 
   uint64_t flags;
-  spin_lock_irqsave(&registry_lock, &flags);
+  rcu_read_lock(&flags);
 
   for (int i = 0; i < MAX_REGISTRY_KEYS; i++) {
-    if (registry_store[i].used && strcmp(registry_store[i].key, key) == 0) {
-      strncpy(buffer, registry_store[i].value, size - 1);
+    struct registry_entry *e = &registry_store[i];
+    if (__atomic_load_n(&e->used, __ATOMIC_ACQUIRE) &&
+        strcmp(e->key, key) == 0) {
+      strncpy(buffer, rcu_dereference(e->value)->text, size - 1);
       buffer[size - 1] = '\0';
-      spin_unlock_irqrestore(&registry_lock, flags);
+      rcu_read_unlock(flags);
       return 0;
     }
   }
-  spin_unlock_irqrestore(&registry_lock, flags);
+  rcu_read_unlock(flags);
   return -1; /* Not found */
 }
 
@@ -229,8 +321,8 @@ int registry_get(const char *key, char *buffer, size_t size) {
  *   size  - capacity of user-space value buffer (bytes).
  * Returns: 0 on success; -1 on invalid pointer, key not found, or store full;
  *          -2 on unrecognised op.
- * Locking: does not hold any lock across the vmm copy calls; registry_set/get
- *          each internally acquire registry_lock.
+ * Locking: does not hold any lock across the vmm copy calls; registry_set
+ *          takes registry_lock, registry_get no lock.
  */
 long sys_registry(int op, const char *key, char *value, size_t size) {
   char k_key[MAX_KEY_LEN];
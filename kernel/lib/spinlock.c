@@ -0,0 +1,198 @@
+/*
+ * kernel/lib/spinlock.c
+ * Out-of-line halves of kernel/spinlock.h: the queued-lock slow path and
+ * lock statistics.
+ *
+ * Queue protocol (MCS, as in qspinlock without the pending bit): each CPU
+ * owns one struct qnode.  A CPU that finds a queued lock held swaps its
+ * node id into the lock word's tail field, links itself behind the
+ * previous tail and spins on its own node->locked.  The node at the head of
+ * the queue waits for the lock byte to clear, sets it, and passes headship
+ * to its successor — or, if nobody queued behind it, clears the tail in
+ * the same compare-and-swap.  The whole wait runs with IRQs masked, so a
+ * CPU never needs more than one node: an interrupt cannot start a second
+ * queued acquisition on it while the first is queued.
+ */
+#include <kernel/arch.h>
+#include <kernel/cpu.h>
+#include <kernel/kmalloc.h>
+#include <kernel/printk.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+#include <kernel/vmm.h>
+
+struct qnode {
+  struct qnode *next;
+  volatile uint32_t locked; /* set by the predecessor: we are the head */
+  uint32_t busy;            /* this CPU is queued on some lock */
+} __cacheline_aligned;
+
+static struct qnode qnodes[MAX_CPUS];
+
+/* Unfair fallback for a CPU whose node is already queued (only reachable
+ * if a lock is taken from an NMI-like context that ignores the IRQ mask). */
+static void queued_spin_lock_unqueued(spinlock_t *lock) {
+  for (;;) {
+    uint32_t v = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+    if (!(v & QLOCK_LOCKED) &&
+        __atomic_compare_exchange_n(&lock->val, &v, v | QLOCK_LOCKED, 0,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+      return;
+    arch_spin_wait(&lock->val, v);
+  }
+}
+
+void __queued_spin_lock_slow(spinlock_t *lock) {
+  uint64_t irq;
+  hal_irq_save(&irq);
+  uint32_t id = get_cpu_info()->cpu_id;
+  struct qnode *node = &qnodes[id];
+  if (node->busy) {
+    queued_spin_lock_unqueued(lock);
+    hal_irq_restore(irq);
+    return;
+  }
+  node->busy = 1;
+  node->next = NULL;
+  node->locked = 0;
+
+  /* Become the tail; the release orders the node init before it is seen. */
+  uint32_t tail = (id + 1) << QLOCK_TAIL_SHIFT;
+  uint32_t old = __atomic_load_n(&lock->val, __ATOMIC_RELAXED);
+  while (!__atomic_compare_exchange_n(&lock->val, &old,
+                                      (old & ~QLOCK_TAIL_MASK) | tail, 1,
+                                      __ATOMIC_ACQ_REL, __ATOMIC_RELAXED))
+    ;
+  if (old & QLOCK_TAIL_MASK) {
+    struct qnode *prev = &qnodes[(old >> QLOCK_TAIL_SHIFT) - 1];
+    __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+    while (!__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE))
+      arch_spin_wait(&node->locked, 0);
+  }
+
+  /* Head of the queue: wait for the holder, then claim the lock. */
+  uint32_t v;
+  while ((v = __atomic_load_n(&lock->val, __ATOMIC_ACQUIRE)) & QLOCK_LOCKED)
+    arch_spin_wait(&lock->val, v);
+  for (;;) {
+    if ((v & QLOCK_TAIL_MASK) == tail) {
+      /* Last in the queue: take the lock and empty the queue at once. */
+      if (__atomic_compare_exchange_n(&lock->val, &v, QLOCK_LOCKED, 0,
+                                      __ATOMIC_ACQUIRE, __ATOMIC_RELAXED))
+        goto out;
+      continue; /* someone queued behind us meanwhile */
+    }
+    __atomic_fetch_or(&lock->val, QLOCK_LOCKED, __ATOMIC_ACQUIRE);
+    break;
+  }
+
+  /* A successor swapped the tail; wait for it to link, then wake it. */
+  struct qnode *next;
+  while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)))
+    arch_spin_wait((volatile uint32_t *)&node->next, 0);
+  __atomic_store_n(&next->locked, 1, __ATOMIC_RELEASE);
+out:
+  node->busy = 0;
+  hal_irq_restore(irq);
+}
+
+#ifdef CONFIG_LOCKSTAT
+static spinlock_t *lockstat_list;
+
+void __lockstat_acquired(spinlock_t *lock, uint64_t t0, int contended) {
+  struct lockstat *s = &lock->stat;
+  if (!s->name)
+    return;
+  uint64_t now = arch_timer_get_count();
+  if (!s->registered) {
+    /* We hold the lock, so only the list head can race. */
+    s->registered = 1;
+    spinlock_t *head = __atomic_load_n(&lockstat_list, __ATOMIC_RELAXED);
+    do {
+      s->next = head;
+    } while (!__atomic_compare_exchange_n(&lockstat_list, &head, lock, 1,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+  }
+  s->acquired++;
+  if (contended) {
+    uint64_t wait = now - t0;
+    s->contended++;
+    s->wait_total += wait;
+    if (wait > s->wait_max)
+      s->wait_max = wait;
+  }
+  s->hold_start = now;
+}
+
+void __lockstat_release(spinlock_t *lock) {
+  struct lockstat *s = &lock->stat;
+  if (!s->name)
+    return;
+  uint64_t hold = arch_timer_get_count() - s->hold_start;
+  s->hold_total += hold;
+  if (hold > s->hold_max)
+    s->hold_max = hold;
+}
+
+/* lockstat_reset - zero one lock's counters, under that lock. */
+static void lockstat_reset(spinlock_t *lock) {
+  uint64_t flags;
+  spin_lock_irqsave(lock, &flags);
+  struct lockstat *s = &lock->stat;
+  s->acquired = s->contended = 0;
+  s->wait_total = s->wait_max = 0;
+  s->hold_total = s->hold_max = 0;
+  spin_unlock_irqrestore(lock, flags);
+}
+
+#define LOCKSTAT_TEXT_MAX 16384
+
+long sys_lockstat(char *ubuf, size_t size, int flags) {
+  if ((flags & LOCKSTAT_RESET) && !proc_is_privileged(current_process))
+    return -EPERM;
+  if (size > LOCKSTAT_TEXT_MAX)
+    size = LOCKSTAT_TEXT_MAX;
+  char *k = kmalloc(size ? size : 1);
+  if (!k)
+    return -ENOMEM;
+
+  /* Counters are read without their locks: a line may be slightly torn
+   * between fields, never within one. */
+  size_t n = 0;
+  /* Name last: the kernel vsnprintf does not pad %s. */
+  n += (size_t)snprintf(k, size,
+                        "lockstat: %lu ticks/s\n"
+                        "       acq  contended   wait-total   wait-max"
+                        "   hold-total   hold-max  lock\n",
+                        (unsigned long)arch_timer_get_freq());
+  for (spinlock_t *l = __atomic_load_n(&lockstat_list, __ATOMIC_ACQUIRE);
+       l && n < size; l = l->stat.next) {
+    struct lockstat *s = &l->stat;
+    n += (size_t)snprintf(k + n, size - n,
+                          "%10lu %10lu %12lu %10lu %12lu %10lu  %s\n",
+                          (unsigned long)s->acquired,
+                          (unsigned long)s->contended,
+                          (unsigned long)s->wait_total,
+                          (unsigned long)s->wait_max,
+                          (unsigned long)s->hold_total,
+                          (unsigned long)s->hold_max, s->name);
+  }
+  if (n > size)
+    n = size;
+
+  long rc = vmm_copy_to_user(ubuf, k, n) != 0 ? -EFAULT : (long)n;
+  kfree(k);
+  if (rc >= 0 && (flags & LOCKSTAT_RESET))
+    for (spinlock_t *l = __atomic_load_n(&lockstat_list, __ATOMIC_ACQUIRE); l;
+         l = l->stat.next)
+      lockstat_reset(l);
+  return rc;
+}
+#else
+long sys_lockstat(char *ubuf, size_t size, int flags) {
+  (void)ubuf;
+  (void)size;
+  (void)flags;
+  return -ENOSYS;
+}
+#endif
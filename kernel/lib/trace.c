@@ -0,0 +1,183 @@
+/*
+ * kernel/lib/trace.c
+ * Scheduler event tracing (see kernel/trace.h): per-CPU binary rings of
+ * struct trace_event and the SYS_TRACE control / drain call.
+ *
+ * Ring protocol: trace_rings[c].head is written only by CPU c with IRQs
+ * masked (the single producer), tail only by the trace_lock holder (the
+ * single consumer).  Each side publishes its index with a release store
+ * and reads the other's with an acquire load, as klog does.  The rings are
+ * allocated by the first TRACE_START, for the CPUs online then, and never
+ * freed; until then ring.buf is NULL and nothing is recorded.
+ *
+ * TRACE_START discards old events by moving each tail up to its head —
+ * a consumer-side operation, so producers never see their indices reset.
+ * TRACE_READ copies a batch out of the ring under trace_lock and copies it
+ * to user memory after dropping the lock.
+ */
+#include <kernel/arch.h>
+#include <kernel/cpu.h>
+#include <kernel/kmalloc.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+#include <kernel/trace.h>
+#include <kernel/vmm.h>
+
+#define TRACE_BATCH 32 /* events per locked copy in TRACE_READ */
+
+static struct trace_ring {
+  struct trace_event *buf;
+  uint64_t head; /* producer (owning CPU) */
+  uint64_t tail; /* consumer (trace_lock) */
+  uint64_t lost; /* events refused for lack of space */
+} trace_rings[MAX_CPUS];
+
+uint32_t trace_mask;
+static DEFINE_SPINLOCK(trace_lock);
+
+void __trace_emit(int type, uint32_t pid, uint32_t arg0, uint32_t arg1) {
+  uint64_t irq;
+  hal_irq_save(&irq);
+  struct cpu_info *cpu = get_cpu_info();
+  struct trace_ring *r =
+      cpu && cpu->cpu_id < MAX_CPUS ? &trace_rings[cpu->cpu_id] : NULL;
+  if (!r || !__atomic_load_n(&r->buf, __ATOMIC_ACQUIRE)) {
+    hal_irq_restore(irq);
+    return;
+  }
+  uint64_t head = r->head;
+  if (head - __atomic_load_n(&r->tail, __ATOMIC_ACQUIRE) >=
+      TRACE_RING_EVENTS) {
+    __atomic_add_fetch(&r->lost, 1, __ATOMIC_RELAXED);
+    hal_irq_restore(irq);
+    return;
+  }
+  struct trace_event *e = &r->buf[head & (TRACE_RING_EVENTS - 1)];
+  e->ts = arch_timer_get_count();
+  e->type = (uint16_t)type;
+  e->cpu = (uint8_t)cpu->cpu_id;
+  e->pad = 0;
+  e->pid = pid;
+  e->arg0 = arg0;
+  e->arg1 = arg1;
+  __atomic_store_n(&r->head, head + 1, __ATOMIC_RELEASE);
+  hal_irq_restore(irq);
+}
+
+/* trace_alloc - give every online CPU a ring.  Allocates outside
+ * trace_lock; a racing start that got there first keeps its ring. */
+static long trace_alloc(void) {
+  for (int i = 0; i < MAX_CPUS; i++) {
+    struct trace_ring *r = &trace_rings[i];
+    if (__atomic_load_n(&r->buf, __ATOMIC_ACQUIRE) || !cpu_data[i].online)
+      continue;
+    struct trace_event *b =
+        kmalloc(TRACE_RING_EVENTS * sizeof(struct trace_event));
+    if (!b)
+      return -ENOMEM;
+    uint64_t flags;
+    spin_lock_irqsave(&trace_lock, &flags);
+    if (!r->buf) {
+      __atomic_store_n(&r->buf, b, __ATOMIC_RELEASE);
+      b = NULL;
+    }
+    spin_unlock_irqrestore(&trace_lock, flags);
+    if (b)
+      kfree(b);
+  }
+  return 0;
+}
+
+/* trace_start - drop what is buffered and record mask from now on.
+ * Caller holds trace_lock. */
+static void trace_start(uint32_t mask) {
+  for (int i = 0; i < MAX_CPUS; i++) {
+    struct trace_ring *r = &trace_rings[i];
+    __atomic_store_n(&r->tail, __atomic_load_n(&r->head, __ATOMIC_ACQUIRE),
+                     __ATOMIC_RELEASE);
+    __atomic_store_n(&r->lost, 0, __ATOMIC_RELAXED);
+  }
+  __atomic_store_n(&trace_mask, mask, __ATOMIC_RELEASE);
+}
+
+/* trace_take - move up to max events out of the rings into out, lowest
+ * CPU first.  Caller holds trace_lock. */
+static int trace_take(struct trace_event *out, int max) {
+  int n = 0;
+  for (int i = 0; i < MAX_CPUS && n < max; i++) {
+    struct trace_ring *r = &trace_rings[i];
+    if (!r->buf)
+      continue;
+    uint64_t tail = r->tail;
+    uint64_t head = __atomic_load_n(&r->head, __ATOMIC_ACQUIRE);
+    while (tail != head && n < max)
+      out[n++] = r->buf[tail++ & (TRACE_RING_EVENTS - 1)];
+    __atomic_store_n(&r->tail, tail, __ATOMIC_RELEASE);
+  }
+  return n;
+}
+
+static long trace_read(void *ubuf, size_t size) {
+  struct trace_event batch[TRACE_BATCH];
+  size_t done = 0;
+  while (size - done >= sizeof(struct trace_event)) {
+    size_t room = (size - done) / sizeof(struct trace_event);
+    uint64_t flags;
+    spin_lock_irqsave(&trace_lock, &flags);
+    int n = trace_take(batch, room < TRACE_BATCH ? (int)room : TRACE_BATCH);
+    spin_unlock_irqrestore(&trace_lock, flags);
+    if (n == 0)
+      break;
+    size_t bytes = (size_t)n * sizeof(struct trace_event);
+    if (vmm_copy_to_user((char *)ubuf + done, batch, bytes) != 0)
+      return -EFAULT;
+    done += bytes;
+  }
+  return (long)done;
+}
+
+static void trace_get_info(struct trace_info *info) {
+  info->clock_hz = arch_timer_get_freq();
+  info->lost = 0;
+  info->ncpu = 0;
+  for (int i = 0; i < MAX_CPUS; i++) {
+    if (!trace_rings[i].buf)
+      continue;
+    info->lost += __atomic_load_n(&trace_rings[i].lost, __ATOMIC_RELAXED);
+    info->ncpu++;
+  }
+  info->mask = __atomic_load_n(&trace_mask, __ATOMIC_RELAXED);
+  info->ring_events = TRACE_RING_EVENTS;
+  info->pad = 0;
+}
+
+long sys_trace(int op, uint64_t a1, uint64_t a2) {
+  if (!proc_is_privileged(current_process))
+    return -EPERM;
+  uint64_t flags;
+  long rc;
+  switch (op) {
+  case TRACE_START:
+    if (a1 & ~(uint64_t)TRACE_MASK_ALL)
+      return -EINVAL;
+    rc = trace_alloc();
+    if (rc != 0)
+      return rc;
+    spin_lock_irqsave(&trace_lock, &flags);
+    trace_start((uint32_t)a1);
+    spin_unlock_irqrestore(&trace_lock, flags);
+    return 0;
+  case TRACE_STOP:
+    return __atomic_exchange_n(&trace_mask, 0, __ATOMIC_ACQ_REL);
+  case TRACE_READ:
+    return trace_read((void *)a1, (size_t)a2);
+  case TRACE_INFO: {
+    struct trace_info info;
+    trace_get_info(&info);
+    return vmm_copy_to_user((void *)a1, &info, sizeof(info)) != 0 ? -EFAULT
+                                                                     : 0;
+  }
+  default:
+    return -EINVAL;
+  }
+}
@@ -3,7 +3,9 @@
  * Main kernel initialization and entry point
  */
 #include <drivers/keyboard.h>
+#include <drivers/uart.h>
 #include <drivers/virtio_blk.h>
+#include <drivers/virtio_console.h>
 #include <drivers/virtio_gpu.h>
 #include <kernel/arch.h>
 #include <kernel/buffer.h>
@@ -14,9 +16,11 @@
 #include <kernel/gpt.h>
 #include <kernel/graphics.h>
 #include <kernel/irq.h>
+#include <kernel/klog.h>
 #include <kernel/bootmodule.h>
 #include <kernel/platform.h>
 #include <kernel/pmm.h>
+#include <kernel/prof.h>
 #include <kernel/printk.h>
 #include <kernel/registry.h>
 #include <kernel/sched.h>
@@ -94,6 +98,7 @@ void kernel_main(uint64_t x0_arg) {
   driver_irq_init();
   irq_init();
   irq_init_percpu();
+  driver_console_irq_init();
 
   /* System timer */
   pr_info("%s", "Initializing timer...\n");
@@ -104,6 +109,11 @@ void kernel_main(uint64_t x0_arg) {
   pr_info("%s", "Initializing memory...\n");
   init_memory();
 
+#if defined(CONFIG_PROF_BOOT_HZ) && CONFIG_PROF_BOOT_HZ
+  /* make PROF_BOOT=<hz>: profile the rest of boot (/bin/prof save). */
+  prof_boot_start(CONFIG_PROF_BOOT_HZ);
+#endif
+
   /* Process subsystem initialization (locks, etc.) */
   pr_info("%s", "Initializing processes...\n");
   process_init();
@@ -120,6 +130,9 @@ void kernel_main(uint64_t x0_arg) {
   pr_info("%s", "Waking secondary CPUs...\n");
   arch_smp_init();
 
+  /* SMP unit tests: every CPU is up and IRQs are still masked on all. */
+  ktest_run_smp();
+
   /* Enable interrupts on primary core */
   pr_info("%s", "Enabling interrupts...\n");
   local_irq_enable();
@@ -192,6 +205,13 @@ static void init_memory(void) {
   /* Initialize VirtIO Block Driver */
   virtio_blk_init();
 
+  /* virtio-console: interactive port plus a log port; a KLOG_SINK=virtio
+   * build moves the kernel log there as soon as it is up. */
+  virtio_console_init();
+  if (KLOG_SINK_DEFAULT == KLOG_SINK_VIRTIO &&
+      klog_set_sink(KLOG_SINK_VIRTIO) == 0)
+    uart_puts("klog: continuing on the virtio-console log port\n");
+
   /* If the rootfs arrived as a boot module (release ISO), register the
    * RAM-backed ramdisk as the active block backend, overriding virtio-blk. */
   ramdisk_init();
@@ -264,13 +284,18 @@ void kernel_secondary_main(void) {
   cpu_init();
   irq_init_percpu();
   timer_init_percpu();
-
-  /* Enable interrupts */
-  local_irq_enable();
+  prof_cpu_online();
 
   /* Acknowledge boot to primary core */
   cpu_boot_ack = cpu;
 
+  /* Join the SMP unit tests before taking interrupts; returns when the
+   * primary core has run them (or skipped them). */
+  ktest_smp_ap();
+
+  /* Enable interrupts */
+  local_irq_enable();
+
   pr_info("Secondary CPU %u online and ready\n", cpu);
 
   /* Enter idle loop - scheduler will preempt this */
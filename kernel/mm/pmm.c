@@ -39,8 +39,10 @@
  *                                single-page path; safe for DMA buffers.
  *   MM-PMM-03  (W2 PERF)         Contiguous alloc is an O(n) scan from PFN 0.
  *   MM-PMM-04  (W2 WRONG-DESIGN) pmm_alloc_pages/aligned search ZONE_NORMAL only.
- *   MM-PMM-05  (W2 BAD-IMPL)     global free_pages (atomic) vs per-zone free_pages
- *                                (plain under lock) can desync.
+ *   MM-PMM-05  RESOLVED:         the global free count is per-CPU alloc/free
+ *                                counters (kernel/percpu.h) bumped inside the
+ *                                same zone-lock section as zone->free_pages,
+ *                                so there is no shared atomic to desync.
  *   MM-PMM-06  (W1 REFINE)       next_free_pfn is ignored by the contiguous path.
  *   MM-PMM-07  RESOLVED (Phase B2): VA/PA separation via memlayout.h (see above).
  *   MM-PMM-08  RESOLVED (#117):  total_pages spans up to the HIGHEST usable end
@@ -53,6 +55,7 @@
  */
 #include <arch/arch.h>
 #include <kernel/memlayout.h>
+#include <kernel/percpu.h>
 #include <kernel/pmm.h>
 #include <kernel/printk.h>
 #include <kernel/spinlock.h>
@@ -85,7 +88,7 @@ void pmm_init_region(uint64_t base, uint64_t size) {
 /* Pointers to dynamic metadata */
 /* page_array: flat array of struct page, one entry per page frame (PFN 0..total_pages-1).
  * Placed immediately after the kernel image by pmm_early_init().
- * Accessed under the appropriate zone lock (or atomically for free_pages).
+ * Accessed under the appropriate zone lock.
  *
  * NOTE(MM-PMM-07): page_array is addressed using the identity-map assumption
  * (the physical address returned by the boot stage IS the usable pointer). */
@@ -99,11 +102,11 @@ static uint64_t *normal_bitmap = NULL;
 /* Global statistics */
 /* total_pages: immutable after pmm_init(); no lock needed for reads after init. */
 static uint64_t total_pages;
-/* free_pages: updated with atomic GCC built-ins (__sync_fetch_and_{add,sub}).
- * NOTE(MM-PMM-05): Per-zone zone->free_pages is updated under the zone spinlock
- * (non-atomic), while this global is atomic.  The two counters can disagree
- * transiently if a CPU is preempted between the two updates. */
-static uint64_t free_pages;
+/* boot_free_pages: free pages once pmm_init() is done; immutable after.  The
+ * live count is this minus PCPU_PAGES_ALLOC plus PCPU_PAGES_FREED, bumped
+ * on the allocating / freeing CPU under the zone lock (MM-PMM-05): no
+ * allocation or free writes a line shared with other CPUs. */
+static uint64_t boot_free_pages;
 /* usable_pages: sum of the USABLE boot regions in pages (MM-PMM-08 #117).
  * total_pages is the metadata SPAN (up to the highest usable end address) and
  * may exceed this when the map has holes; immutable after pmm_early_init(). */
@@ -371,8 +374,8 @@ void pmm_early_init(struct mem_region *regions, size_t count) {
 /*
  * pmm_reserve_range - mark [start_pfn, end_pfn) as PG_RESERVED | PG_KERNEL.
  *
- * Updates both the zone bitmap (under zone lock via bitmap_set) and the
- * global atomic free_pages counter.  Silently skips PFNs already reserved
+ * Updates both the zone bitmap (under zone lock via bitmap_set) and
+ * boot_free_pages.  Silently skips PFNs already reserved
  * or beyond total_pages.
  *
  * Called from pmm_init() to reserve the kernel image and PMM metadata pages.
@@ -396,7 +399,7 @@ static void pmm_reserve_range(uint64_t start_pfn, uint64_t end_pfn) {
       bitmap_set(zones[ZONE_NORMAL].bitmap, pfn - zones[ZONE_DMA].end_pfn);
       zones[ZONE_NORMAL].free_pages--;
     }
-    __sync_fetch_and_sub(&free_pages, 1);
+    boot_free_pages--;
   }
 }
 
@@ -429,7 +432,7 @@ void pmm_init(struct mem_region *regions, size_t count) {
   zone_init(&zones[ZONE_DMA], "DMA", 0, dma_end_pfn, dma_bitmap);
   zone_init(&zones[ZONE_NORMAL], "Normal", dma_end_pfn, normal_end_pfn, normal_bitmap);
 
-  free_pages = zones[ZONE_DMA].free_pages + zones[ZONE_NORMAL].free_pages;
+  boot_free_pages = zones[ZONE_DMA].free_pages + zones[ZONE_NORMAL].free_pages;
 
   /* Mark kernel pages as reserved (image symbols are virtual; PFNs are
    * physical — translate first). */
@@ -494,7 +497,7 @@ void pmm_init(struct mem_region *regions, size_t count) {
 
   pr_info("PMM: %lu MB usable, %lu MB free (span %lu MB; gaps reserved)\n",
           usable_pages * PAGE_SIZE / (1024 * 1024),
-          free_pages * PAGE_SIZE / (1024 * 1024),
+          boot_free_pages * PAGE_SIZE / (1024 * 1024),
           total_pages * PAGE_SIZE / (1024 * 1024));
   pr_info("PMM: DMA zone: %lu pages, Normal zone: %lu pages\n",
           zones[ZONE_DMA].free_pages, zones[ZONE_NORMAL].free_pages);
@@ -510,7 +513,7 @@ void pmm_init(struct mem_region *regions, size_t count) {
  *
  * After finding a free PFN:
  *   - marks it allocated in the zone bitmap (under zone lock).
- *   - decrements z->free_pages (under lock) and global free_pages (atomic).
+ *   - decrements z->free_pages and counts PCPU_PAGES_ALLOC (under lock).
  *   - initialises struct page (flags=0, refcount=1).
  *   - zeroes the page data (memset), cleans the D-cache line, issues a full
  *     memory barrier (arch_mb).  This ensures DMA coherency for the caller.
@@ -543,6 +546,7 @@ static void *zone_alloc_page(struct zone *z) {
 
   bitmap_set(z->bitmap, pfn);
   z->free_pages--;
+  __percpu_add(PCPU_PAGES_ALLOC, 1);
 
   spin_unlock_irqrestore(&z->lock, flags);
 
@@ -558,8 +562,6 @@ static void *zone_alloc_page(struct zone *z) {
   arch_cache_clean_range(addr, PAGE_SIZE);
   arch_mb();
 
-  __sync_fetch_and_sub(&free_pages, 1);
-
   return addr;
 }
 
@@ -634,6 +636,7 @@ void *pmm_alloc_pages(size_t count) {
     bitmap_set(z->bitmap, pfn + i);
   }
   z->free_pages -= count;
+  __percpu_add(PCPU_PAGES_ALLOC, count);
 
   spin_unlock_irqrestore(&z->lock, flags);
 
@@ -650,8 +653,6 @@ void *pmm_alloc_pages(size_t count) {
   arch_cache_clean_range(addr, PAGE_SIZE * count);
   arch_mb();
 
-  __sync_fetch_and_sub(&free_pages, count);
-
   return addr;
 }
 
@@ -666,9 +667,9 @@ void *pmm_alloc_pages(size_t count) {
  *   3. Atomically decrements struct page refcount; if still >0 after decrement,
  *      another reference exists (shared page) -- no free is performed.
  *   4. Acquires the zone lock; checks bitmap to detect double-free (panics).
- *   5. Clears the bitmap bit and increments zone->free_pages (under lock).
+ *   5. Clears the bitmap bit, increments zone->free_pages and counts
+ *      PCPU_PAGES_FREED (under lock).
  *   6. Poisons the page with 0xCC to catch use-after-free dereferences.
- *   7. Increments global free_pages atomically.
  *
  * The double-free check (step 4) is done under the lock, which prevents the
  * race where two CPUs both see refcount==1 and both attempt to free.
@@ -726,13 +727,27 @@ void pmm_free_page(void *page) {
 
   bitmap_clear(z->bitmap, zone_pfn);
   z->free_pages++;
+  __percpu_add(PCPU_PAGES_FREED, 1);
 
   spin_unlock_irqrestore(&z->lock, flags);
 
   /* Poison memory to catch use-after-free bugs */
   memset(page, 0xCC, PAGE_SIZE);
+}
 
-  __sync_fetch_and_add(&free_pages, 1);
+/*
+ * pmm_get_page - take an extra reference on an allocated page.
+ *
+ * For frames mapped into more than one address space (shared-memory IPC
+ * channels): every mapping holds one reference, dropped by pmm_free_page()
+ * from the unmap path or from vmm_destroy_pgd(), and the frame returns to
+ * its zone only when the last one goes.  'page' is a direct-map pointer as
+ * returned by pmm_alloc_page().
+ */
+void pmm_get_page(void *page) {
+  struct page *pg = pmm_phys_to_page(virt_to_phys(page));
+  if (pg && !(pg->flags & PG_RESERVED))
+    __sync_fetch_and_add(&pg->refcount, 1);
 }
 
 /*
@@ -848,11 +863,16 @@ uint64_t pmm_page_to_phys(struct page *page) {
  *
  * pmm_get_free_pages - return the approximate global count of free pages.
  *
- * NOTE(MM-PMM-05): The global free_pages counter is updated atomically, but
- * per-zone free_pages counters are updated under individual zone locks.  The
- * two can transiently disagree.  This function returns only the global counter.
+ * Sums the per-CPU counters (kernel/percpu.h): exact when nothing is
+ * allocating, otherwise a snapshot that may be off by the pages in flight.
+ * Frees are read first, so a racing alloc+free can only make it low.
  */
-uint64_t pmm_get_free_pages(void) { return free_pages; }
+uint64_t pmm_get_free_pages(void) {
+  uint64_t freed = percpu_sum(PCPU_PAGES_FREED);
+  uint64_t alloc = percpu_sum(PCPU_PAGES_ALLOC);
+  uint64_t avail = boot_free_pages + freed;
+  return alloc < avail ? avail - alloc : 0;
+}
 
 /* pmm_get_total_pages - return total_pages (immutable after pmm_init). */
 uint64_t pmm_get_total_pages(void) { return total_pages; }
@@ -860,10 +880,11 @@ uint64_t pmm_get_total_pages(void) { return total_pages; }
 /*
  * pmm_dump_stats - print total/free/used page counts to the kernel log.
  *
- * Uses the global free_pages counter; see NOTE(MM-PMM-05) for caveats.
+ * Uses pmm_get_free_pages(), a snapshot.
  * Suitable for boot-time diagnostics only; takes no locks.
  */
 void pmm_dump_stats(void) {
+  uint64_t free_pages = pmm_get_free_pages();
   pr_info("%s", "PMM Statistics:\n");
   pr_info("  Total: %lu pages (%lu MB)\n", total_pages,
           total_pages * PAGE_SIZE / (1024 * 1024));
@@ -47,6 +47,7 @@
  */
 #include <kernel/arch.h>
 #include <kernel/cpu.h>
+#include <kernel/memlayout.h>
 #include <kernel/pmm.h>
 #include <kernel/printk.h>
 #include <kernel/sched.h>
@@ -170,9 +171,9 @@ int vmm_map_page(uint64_t *pgd, uint64_t virt, uint64_t phys, uint64_t flags) {
 
 /* Internal helper with locking */
 /*
- * vmm_map_page_locked - vmm_map_page() wrapped with proc->mm_lock.
+ * vmm_map_page_locked - vmm_map_page() wrapped with proc->space->mm_lock.
  *
- * Acquires proc->mm_lock with IRQ save before calling vmm_map_page(), then
+ * Acquires proc->space->mm_lock with IRQ save before calling vmm_map_page(), then
  * releases it.  Use this variant when the caller does not already hold mm_lock.
  *
  * NOTE(MM-VMM-05): Even with mm_lock held, there is no TLB shootdown IPI sent
@@ -182,9 +183,9 @@ int vmm_map_page(uint64_t *pgd, uint64_t virt, uint64_t phys, uint64_t flags) {
 int vmm_map_page_locked(struct process *proc, uint64_t virt, uint64_t phys,
                         uint64_t flags) {
   uint64_t lock_flags;
-  spin_lock_irqsave(&proc->mm_lock, &lock_flags);
+  spin_lock_irqsave(&proc->space->mm_lock, &lock_flags);
   int ret = vmm_map_page(proc->page_table, virt, phys, flags);
-  spin_unlock_irqrestore(&proc->mm_lock, lock_flags);
+  spin_unlock_irqrestore(&proc->space->mm_lock, lock_flags);
   return ret;
 }
 
@@ -252,6 +253,41 @@ uint64_t vmm_get_phys(uint64_t *pgd, uint64_t virt) {
   return arch_vmm_get_physical(virt_to_phys(pgd), virt);
 }
 
+/*
+ * vmm_copy_to_pgd - copy 'n' bytes from kernel 'src' to user address 'virt'
+ * in an address space that is NOT necessarily the one loaded on this CPU.
+ *
+ * Used to deliver IPC straight into a blocked receiver's buffer.  Each
+ * destination page is validated (PTE_VALID | PTE_USER | PTE_RW) and written
+ * through the kernel direct map of its frame, so the target PGD is never
+ * loaded: no TTBR0/CR3 swap and no TLB flush, unlike arch_copy_to_user on
+ * aarch64.
+ *
+ * Returns 0, or -1 on a bad range (nothing past the failing page is written).
+ * Locking: caller holds the target space's mm_lock so the mapping cannot
+ * change under the copy.
+ */
+int vmm_copy_to_pgd(uint64_t *pgd, uint64_t virt, const void *src, size_t n) {
+  const uint8_t *s = src;
+  if (virt + n < virt || !vmm_is_user_addr(virt) || !vmm_is_user_addr(virt + n))
+    return -1;
+  while (n) {
+    size_t chunk = 4096 - (virt & 0xFFF);
+    if (chunk > n)
+      chunk = n;
+    if (vmm_check_range(pgd, virt, chunk, PTE_VALID | PTE_USER | PTE_RW) != 0)
+      return -1;
+    uint64_t phys = vmm_get_phys(pgd, virt);
+    if (!phys)
+      return -1;
+    memcpy(phys_to_virt(phys), s, chunk);
+    virt += chunk;
+    s += chunk;
+    n -= chunk;
+  }
+  return 0;
+}
+
 /*
  * Unmap a page
  *
@@ -282,18 +318,18 @@ int vmm_protect(uint64_t *pgd, uint64_t virt, uint64_t size, uint64_t flags) {
 
 /* Internal helper with locking */
 /*
- * vmm_unmap_page_locked - vmm_unmap_page() wrapped with proc->mm_lock.
+ * vmm_unmap_page_locked - vmm_unmap_page() wrapped with proc->space->mm_lock.
  *
- * Acquires proc->mm_lock with IRQ save/restore around the unmap call.
+ * Acquires proc->space->mm_lock with IRQ save/restore around the unmap call.
  * The shootdown inside runs with IRQs masked; on amd64 a peer spinning on
  * this same mm_lock cannot ack until it unmasks — the bounded ack wait in
  * tlb.c turns that worst case into a stall, never a deadlock.
  */
 void vmm_unmap_page_locked(struct process *proc, uint64_t virt) {
   uint64_t lock_flags;
-  spin_lock_irqsave(&proc->mm_lock, &lock_flags);
+  spin_lock_irqsave(&proc->space->mm_lock, &lock_flags);
   vmm_unmap_page(proc->page_table, virt);
-  spin_unlock_irqrestore(&proc->mm_lock, lock_flags);
+  spin_unlock_irqrestore(&proc->space->mm_lock, lock_flags);
 }
 
 /*
@@ -550,9 +586,10 @@ uint64_t *vmm_create_pgd(void) {
  *   - Differing table pages (PMD/PT/PUD) were allocated for this process by
  *     get_next_table()/the arch splitter and are freed unconditionally.
  *
- * There is no frame refcounting: user frames are never shared between
- * processes today (ELF loader and sbrk map freshly allocated frames; IPC,
- * blits and font loads copy by value).  Revisit when shared mappings arrive.
+ * Leaf frames are released with pmm_free_page(), which only drops one
+ * reference: frames shared with another address space (IPC channel rings,
+ * kernel/channel.h) carry one reference per mapping and survive until the
+ * last of them is torn down.
  *
  * Table physical addresses are dereferenced through phys_to_virt()
  * (MM-VMM-02 resolved).
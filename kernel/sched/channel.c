@@ -0,0 +1,271 @@
+/*
+ * kernel/sched/channel.c
+ * SYS_CHANNEL: shared-memory bulk IPC channels (see kernel/channel.h).
+ * Only set-up and teardown live here; the data path is userland's
+ * (user/sys/lib/channel.c) plus FUTEX_WAIT / FUTEX_WAKE.
+ */
+#include <kernel/arch.h>
+#include <kernel/channel.h>
+#include <kernel/futex.h>
+#include <kernel/memlayout.h>
+#include <kernel/pmm.h>
+#include <kernel/string.h>
+#include <kernel/vmm.h>
+
+static struct channel chan_table[MAX_CHANNELS];
+static DEFINE_SPINLOCK(chan_lock);
+
+/* Ids carry the slot's generation so a stale offer cannot accept a reused
+ * slot. */
+static uint32_t chan_id(const struct channel *c) {
+  return (c->gen << 8) | (uint32_t)(c - chan_table);
+}
+
+static struct chan_shared *chan_hdr(struct channel *c) {
+  return (struct chan_shared *)phys_to_virt(c->frames[0]);
+}
+
+/* chan_free_frames - drop the channel's own reference on every frame. */
+static void chan_free_frames(struct channel *c) {
+  for (int i = 0; i < c->npages; i++)
+    pmm_free_page(phys_to_virt(c->frames[i]));
+  c->npages = 0;
+}
+
+/* chan_alloc - claim a slot (users = client + pending offer) and back it
+ * with 1 + size / PAGE_SIZE zeroed frames. */
+static struct channel *chan_alloc(uint32_t size) {
+  struct channel *c = NULL;
+  uint64_t flags;
+  spin_lock_irqsave(&chan_lock, &flags);
+  for (int i = 0; i < MAX_CHANNELS; i++) {
+    if (chan_table[i].users == 0) {
+      c = &chan_table[i];
+      c->users = 2;
+      c->pending = 1;
+      c->gen++;
+      c->server_tgid = 0;
+      c->npages = 0;
+      break;
+    }
+  }
+  spin_unlock_irqrestore(&chan_lock, flags);
+  if (!c)
+    return NULL;
+
+  int npages = 1 + (int)(size / PAGE_SIZE);
+  for (int i = 0; i < npages; i++) {
+    void *pg = pmm_alloc_page();
+    if (!pg) {
+      chan_free_frames(c);
+      spin_lock_irqsave(&chan_lock, &flags);
+      c->users = 0;
+      spin_unlock_irqrestore(&chan_lock, flags);
+      return NULL;
+    }
+    c->frames[c->npages++] = virt_to_phys(pg);
+  }
+  c->size = size;
+  chan_hdr(c)->size = size;
+  return c;
+}
+
+/* chan_wake - clear a wait word and wake its sleeper, as the peer would. */
+static void chan_wake(struct channel *c, uint32_t *word, size_t off) {
+  __atomic_store_n(word, 0, __ATOMIC_SEQ_CST);
+  futex_wake_key(c->frames[0] + off, 1);
+}
+
+/* chan_put - one side is done with c: tell the peer (flag, then wake both
+ * wait words) and drop its reference.  A client leaving before the offer
+ * was accepted withdraws the offer too.  The last user frees the frames
+ * (their mappings, if any are left, still hold references). */
+static void chan_put(struct channel *c) {
+  struct chan_shared *hdr = chan_hdr(c);
+  __atomic_or_fetch(&hdr->flags, CHAN_F_PEER_GONE, __ATOMIC_SEQ_CST);
+  chan_wake(c, &hdr->cons_wait, offsetof(struct chan_shared, cons_wait));
+  chan_wake(c, &hdr->prod_wait, offsetof(struct chan_shared, prod_wait));
+
+  uint64_t flags;
+  spin_lock_irqsave(&chan_lock, &flags);
+  c->users--;
+  if (c->pending) {
+    c->pending = 0;
+    c->users--;
+  }
+  int last = (c->users == 0);
+  spin_unlock_irqrestore(&chan_lock, flags);
+  if (last)
+    chan_free_frames(c); /* slot stays free: users == 0 */
+}
+
+/* chan_install - put c into a free channel slot of the current process. */
+static int chan_install(struct channel *c) {
+  struct proc_space *space = current_process->space;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  for (int s = 0; s < NPROC_CHANNELS; s++) {
+    if (!space->chans[s]) {
+      space->chans[s] = c;
+      spin_unlock_irqrestore(&space->handle_lock, flags);
+      return s;
+    }
+  }
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return -EMFILE;
+}
+
+static struct channel *chan_uninstall(struct proc_space *space, int slot) {
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  struct channel *c = space->chans[slot];
+  space->chans[slot] = NULL;
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return c;
+}
+
+/* chan_unmap - remove the first n pages of c's mapping at slot, dropping
+ * each mapping's frame reference.  mm_lock covers the page-table edits. */
+static void chan_unmap(struct proc_space *space, int slot, struct channel *c,
+                       int n) {
+  uint64_t flags;
+  spin_lock_irqsave(&space->mm_lock, &flags);
+  for (int i = 0; i < n; i++) {
+    vmm_unmap_page(space->page_table, CHAN_VA(slot) + (uint64_t)i * PAGE_SIZE);
+    pmm_free_page(phys_to_virt(c->frames[i]));
+  }
+  spin_unlock_irqrestore(&space->mm_lock, flags);
+}
+
+/* chan_map - map c at slot in the current process (user RW, never X). */
+static int chan_map(int slot, struct channel *c) {
+  struct proc_space *space = current_process->space;
+  uint64_t flags;
+  spin_lock_irqsave(&space->mm_lock, &flags);
+  for (int i = 0; i < c->npages; i++) {
+    void *pg = phys_to_virt(c->frames[i]);
+    pmm_get_page(pg);
+    if (vmm_map_page(space->page_table,
+                     CHAN_VA(slot) + (uint64_t)i * PAGE_SIZE, c->frames[i],
+                     PAGE_USER_DATA) != 0) {
+      pmm_free_page(pg);
+      spin_unlock_irqrestore(&space->mm_lock, flags);
+      chan_unmap(space, slot, c, i);
+      return -ENOMEM;
+    }
+  }
+  spin_unlock_irqrestore(&space->mm_lock, flags);
+  return 0;
+}
+
+/* chan_attach - install and map c for the current process and report it in
+ * *uinfo.  On failure the caller's reference is dropped.  Returns the slot. */
+static long chan_attach(struct channel *c, struct chan_info *uinfo) {
+  struct proc_space *space = current_process->space;
+  int slot = chan_install(c);
+  if (slot < 0) {
+    chan_put(c);
+    return slot;
+  }
+  if (chan_map(slot, c) != 0) {
+    chan_uninstall(space, slot);
+    chan_put(c);
+    return -ENOMEM;
+  }
+  struct chan_info info = {CHAN_VA(slot), c->size, chan_id(c)};
+  if (vmm_copy_to_user(uinfo, &info, sizeof(info)) != 0) {
+    chan_unmap(space, slot, c, c->npages);
+    chan_uninstall(space, slot);
+    chan_put(c);
+    return -EFAULT;
+  }
+  return slot;
+}
+
+static long chan_do_close(int slot) {
+  struct proc_space *space = current_process->space;
+  if (slot < 0 || slot >= NPROC_CHANNELS)
+    return -EBADF;
+  struct channel *c = chan_uninstall(space, slot);
+  if (!c)
+    return -EBADF;
+  chan_unmap(space, slot, c, c->npages);
+  chan_put(c);
+  return 0;
+}
+
+static long chan_do_connect(int ep, uint32_t size, struct chan_info *uinfo) {
+  if (size < CHAN_SIZE_MIN || size > CHAN_SIZE_MAX || (size & (size - 1)))
+    return -EINVAL;
+  struct channel *c = chan_alloc(size);
+  if (!c)
+    return -ENOMEM;
+  long slot = chan_attach(c, uinfo); /* failure also withdraws the offer */
+  if (slot < 0)
+    return slot;
+
+  /* No chan_lock across the send: kernel_ipc_ep_send stores server_tgid
+   * before the server can see the offer, so an accept never finds it 0. */
+  struct ipc_message msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.from = (int)current_process->pid;
+  msg.type = IPC_TYPE_CHANNEL;
+  msg.data1 = chan_id(c);
+  msg.data2 = size;
+  int rc = kernel_ipc_ep_send(ep, &msg, &c->server_tgid);
+  if (rc != 0) {
+    __atomic_store_n(&c->server_tgid, 0, __ATOMIC_RELAXED);
+    chan_do_close((int)slot);
+    return rc == -1 ? -EPIPE : rc;
+  }
+  return slot;
+}
+
+static long chan_do_accept(uint32_t id, struct chan_info *uinfo) {
+  uint32_t idx = id & 0xFF;
+  if (idx >= MAX_CHANNELS)
+    return -ENOENT;
+  struct channel *c = &chan_table[idx];
+  uint64_t flags;
+  spin_lock_irqsave(&chan_lock, &flags);
+  int server = __atomic_load_n(&c->server_tgid, __ATOMIC_ACQUIRE);
+  if (c->users == 0 || !c->pending || chan_id(c) != id || server == 0) {
+    spin_unlock_irqrestore(&chan_lock, flags);
+    return -ENOENT;
+  }
+  if (server != current_process->tgid) {
+    spin_unlock_irqrestore(&chan_lock, flags);
+    return -EPERM;
+  }
+  c->pending = 0; /* the offer's reference becomes our mapping's */
+  spin_unlock_irqrestore(&chan_lock, flags);
+  return chan_attach(c, uinfo);
+}
+
+void channel_release_space(struct proc_space *space) {
+  for (int s = 0; s < NPROC_CHANNELS; s++) {
+    struct channel *c = chan_uninstall(space, s);
+    if (c)
+      chan_put(c);
+  }
+}
+
+/*
+ * sys_channel - SYS_CHANNEL entry (include/api/channel.h for the user
+ * contract).
+ */
+long sys_channel(int op, uint64_t a1, uint64_t a2, uint64_t a3) {
+  if (!current_process || !current_process->space ||
+      !current_process->page_table)
+    return -EINVAL;
+  switch (op) {
+  case CHAN_CONNECT:
+    return chan_do_connect((int)a1, (uint32_t)a2, (struct chan_info *)a3);
+  case CHAN_ACCEPT:
+    return chan_do_accept((uint32_t)a1, (struct chan_info *)a3);
+  case CHAN_CLOSE:
+    return chan_do_close((int)a1);
+  default:
+    return -ENOSYS;
+  }
+}
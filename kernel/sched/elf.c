@@ -222,8 +222,8 @@ int process_load_elf_args(struct process *proc, const char *path, int argc,
       top_kaddr = paddr; /* argv block goes here (direct-map writable) */
   }
 
-  proc->heap_start = max_vaddr;
-  proc->heap_end = max_vaddr;
+  proc->space->heap_start = max_vaddr;
+  proc->space->heap_end = max_vaddr;
 
   proc->user_entry = ehdr.e_entry;
   proc->user_stack = stack_top;
@@ -0,0 +1,349 @@
+/*
+ * kernel/sched/endpoint.c
+ * SYS_ENDPOINT: named IPC endpoints and capability handles (see
+ * kernel/endpoint.h).  Message transfer itself is process.c's
+ * (sys_ipc_ep_send / sys_ipc_ep_call, pinning the server through
+ * endpoint_pin()).
+ */
+#include <kernel/arch.h>
+#include <kernel/endpoint.h>
+#include <kernel/ntfn.h>
+#include <kernel/string.h>
+#include <kernel/vmm.h>
+
+static struct endpoint ep_table[MAX_ENDPOINTS];
+static DEFINE_SPINLOCK(ep_table_lock);
+
+void endpoint_init(void) {
+  for (int i = 0; i < MAX_ENDPOINTS; i++) {
+    spin_lock_init(&ep_table[i].lock);
+    INIT_LIST_HEAD(&ep_table[i].bind_wait.task_list);
+    spin_lock_init(&ep_table[i].bind_wait.lock);
+  }
+}
+
+/* __ep_find - the live endpoint called name, or NULL.  ep_table_lock held. */
+static struct endpoint *__ep_find(const char *name) {
+  for (int i = 0; i < MAX_ENDPOINTS; i++)
+    if (ep_table[i].refs > 0 && strcmp(ep_table[i].name, name) == 0)
+      return &ep_table[i];
+  return NULL;
+}
+
+/* __ep_new - claim a free slot for name (refs still 0).  ep_table_lock held. */
+static struct endpoint *__ep_new(const char *name) {
+  for (int i = 0; i < MAX_ENDPOINTS; i++) {
+    struct endpoint *ep = &ep_table[i];
+    if (ep->refs == 0) {
+      strncpy(ep->name, name, EP_NAME_MAX);
+      ep->owner[0] = '\0';
+      ep->server = NULL;
+      ep->ntfn = NULL;
+      ep->creator = 0;
+      return ep;
+    }
+  }
+  return NULL;
+}
+
+/* __ep_put - drop one reference.  The last one frees the slot; anyone still
+ * parked on bind_wait (a sibling thread closed the handle it was sending
+ * through) is woken and its retry fails -EBADF.  ep_table_lock held. */
+static void __ep_put(struct endpoint *ep) {
+  if (--ep->refs > 0)
+    return;
+  spin_lock(&ep->lock);
+  ep->name[0] = '\0';
+  ep->server = NULL;
+  wait_queue_wake(&ep->bind_wait, 1);
+  struct ntfn *n = ep->ntfn;
+  ep->ntfn = NULL;
+  spin_unlock(&ep->lock);
+  if (n)
+    ntfn_put(n);
+}
+
+/* ep_install - put a referenced ep into a free handle slot of the current
+ * process; on a full table the reference is dropped again. */
+static long ep_install(struct endpoint *ep) {
+  struct proc_space *space = current_process->space;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  for (int h = 0; h < NPROC_HANDLES; h++) {
+    if (!space->handles[h]) {
+      space->handles[h] = ep;
+      spin_unlock_irqrestore(&space->handle_lock, flags);
+      return h;
+    }
+  }
+  spin_lock(&ep_table_lock);
+  __ep_put(ep);
+  spin_unlock(&ep_table_lock);
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return -EMFILE;
+}
+
+/* ep_may_bind - may p become the server of ep?  The "srv." namespace is
+ * reserved to machine-level processes; beyond that an endpoint belongs to
+ * the program that first bound it, so only a respawn of that program (or
+ * a machine-level process) can take over its clients. */
+static int ep_may_bind(const struct endpoint *ep, const struct process *p) {
+  if (proc_is_machine(p))
+    return 1;
+  if (strncmp(ep->name, "srv.", 4) == 0)
+    return 0;
+  return ep->owner[0] == '\0' || strcmp(ep->owner, p->name) == 0;
+}
+
+static long ep_create(const char *name) {
+  struct process *self = current_process;
+  uint64_t flags;
+  spin_lock_irqsave(&ep_table_lock, &flags);
+  struct endpoint *ep = __ep_find(name);
+  if (!ep)
+    ep = __ep_new(name);
+  if (!ep) {
+    spin_unlock_irqrestore(&ep_table_lock, flags);
+    return -ENOSPC;
+  }
+  if (!ep_may_bind(ep, self)) {
+    spin_unlock_irqrestore(&ep_table_lock, flags);
+    return -EPERM;
+  }
+  spin_lock(&ep->lock);
+  if (ep->server) {
+    spin_unlock(&ep->lock);
+    spin_unlock_irqrestore(&ep_table_lock, flags);
+    return -EEXIST;
+  }
+  ep->server = self;
+  ep->creator = 0;
+  if (ep->owner[0] == '\0')
+    strncpy(ep->owner, self->name, PROCESS_NAME_MAX - 1);
+  /* A respawned server inherits the bound notification (if this thread
+   * already receives another one, signals wait for the next bind). */
+  if (ep->ntfn)
+    ntfn_attach(ep->ntfn, self);
+  wait_queue_wake(&ep->bind_wait, 1);
+  spin_unlock(&ep->lock);
+  ep->refs += 2; /* the binding and the creator's handle */
+  spin_unlock_irqrestore(&ep_table_lock, flags);
+  return ep_install(ep);
+}
+
+/* __ep_unbound - never-bound endpoints charged to tgid.  ep_table_lock
+ * held. */
+static int __ep_unbound(int tgid) {
+  int n = 0;
+  for (int i = 0; i < MAX_ENDPOINTS; i++)
+    if (ep_table[i].refs > 0 && ep_table[i].creator == tgid)
+      n++;
+  return n;
+}
+
+static long ep_open(const char *name) {
+  int tgid = current_process->tgid;
+  uint64_t flags;
+  spin_lock_irqsave(&ep_table_lock, &flags);
+  struct endpoint *ep = __ep_find(name);
+  if (!ep && __ep_unbound(tgid) < EP_UNBOUND_MAX) {
+    ep = __ep_new(name);
+    if (ep)
+      ep->creator = tgid;
+  }
+  if (!ep) {
+    spin_unlock_irqrestore(&ep_table_lock, flags);
+    return -ENOSPC;
+  }
+  ep->refs++;
+  spin_unlock_irqrestore(&ep_table_lock, flags);
+  return ep_install(ep);
+}
+
+static long ep_close(int h) {
+  struct proc_space *space = current_process->space;
+  if (h < 0 || h >= NPROC_HANDLES)
+    return -EBADF;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  struct endpoint *ep = space->handles[h];
+  if (!ep) {
+    spin_unlock_irqrestore(&space->handle_lock, flags);
+    return -EBADF;
+  }
+  space->handles[h] = NULL;
+  spin_lock(&ep_table_lock);
+  __ep_put(ep);
+  spin_unlock(&ep_table_lock);
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return 0;
+}
+
+struct process *endpoint_pin(int h, int block, struct endpoint **epp,
+                             uint64_t *flags, long *err) {
+  struct process *self = current_process;
+  struct proc_space *space = self ? self->space : NULL;
+  if (!space || h < 0 || h >= NPROC_HANDLES) {
+    *err = -EBADF;
+    return NULL;
+  }
+  spin_lock_irqsave(&space->handle_lock, flags);
+  struct endpoint *ep = space->handles[h];
+  if (!ep) {
+    spin_unlock_irqrestore(&space->handle_lock, *flags);
+    *err = -EBADF;
+    return NULL;
+  }
+  /* Our handle's reference keeps ep allocated until we hold its lock. */
+  spin_lock(&ep->lock);
+  spin_unlock(&space->handle_lock);
+
+  struct process *server = ep->server;
+  if (!server) {
+    *err = -EAGAIN;
+    if (ep->name[0] == '\0')
+      *err = -EPIPE; /* withdrawn: no server will ever bind it */
+    else if (block) {
+      wait_queue_block(&ep->bind_wait);
+      *err = IPC_SEND_RETRY;
+    }
+    spin_unlock(&ep->lock);
+    hal_irq_restore(*flags);
+    return NULL;
+  }
+  *epp = ep;
+  return server;
+}
+
+void endpoint_unpin(struct endpoint *ep, uint64_t flags) {
+  spin_unlock_irqrestore(&ep->lock, flags);
+}
+
+void endpoint_unbind(struct process *p) {
+  spin_lock(&ep_table_lock);
+  for (int i = 0; i < MAX_ENDPOINTS; i++) {
+    struct endpoint *ep = &ep_table[i];
+    if (ep->refs == 0 || ep->server != p)
+      continue;
+    spin_lock(&ep->lock);
+    ep->server = NULL;
+    if (ep->ntfn)
+      ntfn_detach(ep->ntfn, p);
+    spin_unlock(&ep->lock);
+    __ep_put(ep);
+  }
+  spin_unlock(&ep_table_lock);
+}
+
+long endpoint_bind_ntfn(int h, int nh) {
+  struct process *self = current_process;
+  struct proc_space *space = self->space;
+  if (h < 0 || h >= NPROC_HANDLES)
+    return -EBADF;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  struct endpoint *ep = space->handles[h];
+  if (!ep) {
+    spin_unlock_irqrestore(&space->handle_lock, flags);
+    return -EBADF;
+  }
+  long rc = 0;
+  spin_lock(&ep_table_lock);
+  spin_lock(&ep->lock);
+  if (ep->server != self) {
+    rc = -EPERM;
+  } else if (ep->ntfn || self->bound_ntfn) {
+    rc = -EBUSY;
+  } else {
+    struct ntfn *n = ntfn_bind_get(nh, &rc);
+    if (n) {
+      ep->ntfn = n;
+      ntfn_attach(n, self);
+    }
+  }
+  spin_unlock(&ep->lock);
+  spin_unlock(&ep_table_lock);
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return rc;
+}
+
+/* ep_signal - EP_SIGNAL: signal the notification bound to handle h. */
+static long ep_signal(int h, uint64_t bits) {
+  struct proc_space *space = current_process->space;
+  if (h < 0 || h >= NPROC_HANDLES)
+    return -EBADF;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  struct endpoint *ep = space->handles[h];
+  if (!ep) {
+    spin_unlock_irqrestore(&space->handle_lock, flags);
+    return -EBADF;
+  }
+  /* Our handle's reference keeps ep allocated until we hold its lock. */
+  spin_lock(&ep->lock);
+  spin_unlock(&space->handle_lock);
+  long rc = -ENOENT;
+  if (ep->ntfn) {
+    ntfn_signal(ep->ntfn, bits);
+    rc = 0;
+  }
+  spin_unlock_irqrestore(&ep->lock, flags);
+  return rc;
+}
+
+void endpoint_release_handles(struct proc_space *space) {
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  spin_lock(&ep_table_lock);
+  for (int i = 0; i < MAX_ENDPOINTS; i++) {
+    struct endpoint *ep = &ep_table[i];
+    if (ep->refs == 0 || ep->creator != space->tgid)
+      continue;
+    spin_lock(&ep->lock);
+    ep->name[0] = '\0';
+    ep->creator = 0;
+    wait_queue_wake(&ep->bind_wait, 1);
+    spin_unlock(&ep->lock);
+  }
+  for (int h = 0; h < NPROC_HANDLES; h++) {
+    if (space->handles[h]) {
+      __ep_put(space->handles[h]);
+      space->handles[h] = NULL;
+    }
+  }
+  spin_unlock(&ep_table_lock);
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+}
+
+/*
+ * sys_endpoint - SYS_ENDPOINT entry (include/api/endpoint.h for the user
+ * contract).  EP_SEND / EP_CALL may return IPC_SEND_RETRY /
+ * IPC_CALL_PENDING (both 1) when the caller blocked; the dispatcher must
+ * then schedule() without writing the return register.
+ */
+long sys_endpoint(struct pt_regs *frame, int op, uint64_t a1, uint64_t a2,
+                  uint64_t a3) {
+  if (!current_process || !current_process->space)
+    return -EINVAL;
+  if (op == EP_CREATE || op == EP_OPEN) {
+    char name[EP_NAME_MAX];
+    if (vmm_copy_string_from_user(name, (const char *)a1, EP_NAME_MAX) != 0)
+      return -EFAULT;
+    name[EP_NAME_MAX - 1] = '\0';
+    if (name[0] == '\0')
+      return -EINVAL;
+    return op == EP_CREATE ? ep_create(name) : ep_open(name);
+  }
+  switch (op) {
+  case EP_CLOSE:
+    return ep_close((int)a1);
+  case EP_SEND:
+    return sys_ipc_ep_send((int)a1, (void *)a2, (int)a3);
+  case EP_CALL:
+    return sys_ipc_ep_call(frame, (int)a1, (void *)a2);
+  case EP_SIGNAL:
+    return ep_signal((int)a1, a2);
+  default:
+    return -ENOSYS;
+  }
+}
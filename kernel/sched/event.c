@@ -0,0 +1,468 @@
+/*
+ * kernel/sched/event.c
+ * SYS_EVENT: event sets over fds, IPC, input, registry keys and timers
+ * (see kernel/event.h).
+ */
+#include <kernel/arch.h>
+#include <kernel/event.h>
+#include <kernel/fd.h>
+#include <kernel/pipe.h>
+#include <kernel/string.h>
+#include <kernel/vmm.h>
+#include <kernel/registry.h>
+
+static struct evset ev_table[MAX_EVSETS];
+static DEFINE_SPINLOCK(ev_table_lock);
+/* Live items with an obj (ev_table_lock): event_notify_obj() skips the
+ * scan while there are none. */
+static int ev_obj_items;
+
+void event_init(void) {
+  for (int i = 0; i < MAX_EVSETS; i++) {
+    spin_lock_init(&ev_table[i].lock);
+    INIT_LIST_HEAD(&ev_table[i].wq.task_list);
+    spin_lock_init(&ev_table[i].wq.lock);
+  }
+}
+
+/* FNV-1a: registry items match keys by hash (a collision only costs a
+ * spurious event). */
+static uint32_t ev_key_hash(const char *key) {
+  uint32_t h = 2166136261u;
+  while (*key)
+    h = (h ^ (uint8_t)*key++) * 16777619u;
+  return h;
+}
+
+void event_wake(struct evset *s) {
+  __atomic_add_fetch(&s->seq, 1, __ATOMIC_SEQ_CST);
+  uint64_t flags;
+  hal_irq_save(&flags);
+  wait_queue_wake(&s->wq, 1);
+  hal_irq_restore(flags);
+}
+
+void event_notify_registry(const char *key) {
+  uint32_t h = ev_key_hash(key);
+  uint64_t flags;
+  spin_lock_irqsave(&ev_table_lock, &flags);
+  for (int i = 0; i < MAX_EVSETS; i++) {
+    struct evset *s = &ev_table[i];
+    if (s->refs == 0)
+      continue;
+    int hit = 0;
+    spin_lock(&s->lock);
+    for (int j = 0; j < EV_MAX_SOURCES; j++) {
+      struct ev_item *it = &s->items[j];
+      if (it->src == EV_SRC_REGISTRY && it->key_hash == h) {
+        it->fired = 1;
+        hit = 1;
+      }
+    }
+    spin_unlock(&s->lock);
+    if (hit)
+      event_wake(s);
+  }
+  spin_unlock_irqrestore(&ev_table_lock, flags);
+}
+
+void event_notify_obj(const void *obj) {
+  if (!__atomic_load_n(&ev_obj_items, __ATOMIC_RELAXED))
+    return;
+  uint64_t flags;
+  spin_lock_irqsave(&ev_table_lock, &flags);
+  for (int i = 0; i < MAX_EVSETS; i++) {
+    struct evset *s = &ev_table[i];
+    if (s->refs == 0)
+      continue;
+    int hit = 0;
+    spin_lock(&s->lock);
+    for (int j = 0; j < EV_MAX_SOURCES && !hit; j++)
+      hit = s->items[j].src == EV_SRC_FD && s->items[j].obj == obj;
+    spin_unlock(&s->lock);
+    if (hit)
+      event_wake(s);
+  }
+  spin_unlock_irqrestore(&ev_table_lock, flags);
+}
+
+/* --- Handles --- */
+
+/* __ev_put - drop one reference; the last frees the slot and wakes anyone
+ * still parked on it (their retry fails -EBADF).  ev_table_lock held. */
+static void __ev_put(struct evset *s) {
+  if (--s->refs > 0)
+    return;
+  spin_lock(&s->lock);
+  for (int j = 0; j < EV_MAX_SOURCES; j++) {
+    if (s->items[j].src >= 0 && s->items[j].obj)
+      ev_obj_items--;
+    s->items[j].src = -1;
+  }
+  spin_unlock(&s->lock);
+  wait_queue_wake(&s->wq, 1);
+}
+
+static void ev_put(struct evset *s) {
+  uint64_t flags;
+  spin_lock_irqsave(&ev_table_lock, &flags);
+  __ev_put(s);
+  spin_unlock_irqrestore(&ev_table_lock, flags);
+}
+
+/* ev_get - the set behind handle h with a reference held, or NULL. */
+static struct evset *ev_get(int h) {
+  struct proc_space *space = current_process->space;
+  if (h < 0 || h >= NPROC_EVSETS)
+    return NULL;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  struct evset *s = space->evsets[h];
+  if (s) {
+    spin_lock(&ev_table_lock);
+    s->refs++;
+    spin_unlock(&ev_table_lock);
+  }
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return s;
+}
+
+static long ev_create(void) {
+  struct proc_space *space = current_process->space;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  int h = 0;
+  while (h < NPROC_EVSETS && space->evsets[h])
+    h++;
+  if (h == NPROC_EVSETS) {
+    spin_unlock_irqrestore(&space->handle_lock, flags);
+    return -EMFILE;
+  }
+  spin_lock(&ev_table_lock);
+  struct evset *s = NULL;
+  for (int i = 0; i < MAX_EVSETS; i++) {
+    if (ev_table[i].refs == 0) {
+      s = &ev_table[i];
+      break;
+    }
+  }
+  if (s) {
+    s->refs = 1;
+    s->cursor = 0;
+    spin_lock(&s->lock);
+    for (int j = 0; j < EV_MAX_SOURCES; j++)
+      s->items[j].src = -1;
+    spin_unlock(&s->lock);
+    space->evsets[h] = s;
+  }
+  spin_unlock(&ev_table_lock);
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return s ? h : -ENOSPC;
+}
+
+static long ev_close(int h) {
+  struct proc_space *space = current_process->space;
+  if (h < 0 || h >= NPROC_EVSETS)
+    return -EBADF;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  struct evset *s = space->evsets[h];
+  space->evsets[h] = NULL;
+  if (s) {
+    spin_lock(&ev_table_lock);
+    __ev_put(s);
+    spin_unlock(&ev_table_lock);
+  }
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return s ? 0 : -EBADF;
+}
+
+void event_release_space(struct proc_space *space) {
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  spin_lock(&ev_table_lock);
+  for (int h = 0; h < NPROC_EVSETS; h++) {
+    if (space->evsets[h]) {
+      __ev_put(space->evsets[h]);
+      space->evsets[h] = NULL;
+    }
+  }
+  spin_unlock(&ev_table_lock);
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+}
+
+/* --- Registration --- */
+
+static long ev_add(struct evset *s, const struct ev_source *usrc) {
+  struct ev_source src;
+  if (vmm_copy_from_user(&src, usrc, sizeof(src)) != 0)
+    return -EFAULT;
+
+  struct ev_item it;
+  memset(&it, 0, sizeof(it));
+  it.src = src.src;
+  it.arg = src.arg;
+  it.udata = src.udata;
+  switch (src.src) {
+  case EV_SRC_FD: {
+    if (src.arg < 0 || src.arg >= NPROC_FDS ||
+        current_process->space->fds[src.arg].type == FD_NONE)
+      return -EBADF;
+    it.events = src.events & (EV_IN | EV_OUT);
+    if (!it.events)
+      return -EINVAL;
+    struct fd_entry *e = &current_process->space->fds[src.arg];
+    if (e->type == FD_PIPE)
+      it.obj = e->pipe;
+    break;
+  }
+  case EV_SRC_IPC:
+  case EV_SRC_INPUT:
+    it.events = EV_IN;
+    break;
+  case EV_SRC_REGISTRY: {
+    char key[MAX_KEY_LEN];
+    if (vmm_copy_string_from_user(key, (const char *)src.arg, MAX_KEY_LEN) != 0)
+      return -EFAULT;
+    key[MAX_KEY_LEN - 1] = '\0';
+    it.events = EV_IN;
+    it.key_hash = ev_key_hash(key);
+    break;
+  }
+  case EV_SRC_TIMER: {
+    if (src.arg <= 0)
+      return -EINVAL;
+    uint64_t period = msecs_to_jiffies((uint64_t)src.arg);
+    it.arg = (int64_t)(period ? period : 1);
+    it.events = EV_IN;
+    it.next = jiffies + (uint64_t)it.arg;
+    break;
+  }
+  default:
+    return -EINVAL;
+  }
+
+  uint64_t flags;
+  spin_lock_irqsave(&ev_table_lock, &flags);
+  spin_lock(&s->lock);
+  for (int i = 0; i < EV_MAX_SOURCES; i++) {
+    if (s->items[i].src < 0) {
+      s->items[i] = it;
+      if (it.obj)
+        ev_obj_items++;
+      spin_unlock(&s->lock);
+      spin_unlock_irqrestore(&ev_table_lock, flags);
+      /* Sleepers in this set must re-scan with the new source. */
+      event_wake(s);
+      return i;
+    }
+  }
+  spin_unlock(&s->lock);
+  spin_unlock_irqrestore(&ev_table_lock, flags);
+  return -ENOSPC;
+}
+
+static long ev_del(struct evset *s, int id) {
+  if (id < 0 || id >= EV_MAX_SOURCES)
+    return -EINVAL;
+  uint64_t flags;
+  spin_lock_irqsave(&ev_table_lock, &flags);
+  spin_lock(&s->lock);
+  long rc = s->items[id].src < 0 ? -ENOENT : 0;
+  if (rc == 0 && s->items[id].obj)
+    ev_obj_items--;
+  s->items[id].src = -1;
+  spin_unlock(&s->lock);
+  spin_unlock_irqrestore(&ev_table_lock, flags);
+  return rc;
+}
+
+/* --- Waiting --- */
+
+static uint32_t ev_fd_ready(struct process *p, int64_t fd, uint32_t want) {
+  struct fd_entry *e = &p->space->fds[fd];
+  uint32_t r = 0;
+  switch (e->type) {
+  case FD_KBD:
+    if (ipc_has_message(p, 0))
+      r = EV_IN;
+    break;
+  case FD_WIN:
+    r = EV_OUT;
+    break;
+  case FD_FILE:
+    if (e->mode & FD_MODE_READ)
+      r |= EV_IN;
+    if (e->mode & FD_MODE_WRITE)
+      r |= EV_OUT;
+    break;
+  case FD_PIPE:
+    r = pipe_poll(e->pipe, (e->mode & FD_MODE_WRITE) != 0);
+    break;
+  }
+  return r & want;
+}
+
+/* ev_ready - readiness of one item for thread p; consumes edge sources
+ * (registry, timer) when report is set.  s->lock held. */
+static uint32_t ev_ready(struct process *p, struct ev_item *it, int report) {
+  switch (it->src) {
+  case EV_SRC_FD:
+    return ev_fd_ready(p, it->arg, it->events);
+  case EV_SRC_IPC:
+    return ipc_has_message(p, (int)it->arg) ? EV_IN : 0;
+  case EV_SRC_INPUT:
+    return ipc_has_message(p, 0) ? EV_IN : 0; /* input comes from pid 0 */
+  case EV_SRC_REGISTRY:
+    if (!it->fired)
+      return 0;
+    if (report)
+      it->fired = 0;
+    return EV_IN;
+  case EV_SRC_TIMER:
+    if (jiffies < it->next)
+      return 0;
+    if (report) {
+      uint64_t period = (uint64_t)it->arg;
+      it->next += ((jiffies - it->next) / period + 1) * period;
+    }
+    return EV_IN;
+  }
+  return 0;
+}
+
+/* ev_collect - fill out[] with up to max ready items, starting at the
+ * rotating cursor so a busy source cannot starve later ones.  *next_timer
+ * receives the earliest pending timer expiry (0 if none). */
+static int ev_collect(struct evset *s, struct ev_event *out, int max,
+                      uint64_t *next_timer) {
+  struct process *p = current_process;
+  int n = 0;
+  *next_timer = 0;
+  uint64_t flags;
+  spin_lock_irqsave(&s->lock, &flags);
+  for (int k = 0; k < EV_MAX_SOURCES; k++) {
+    int i = (s->cursor + k) % EV_MAX_SOURCES;
+    struct ev_item *it = &s->items[i];
+    if (it->src < 0)
+      continue;
+    uint32_t r = n < max ? ev_ready(p, it, 1) : 0;
+    if (r) {
+      out[n].events = r;
+      out[n].src = it->src;
+      out[n].udata = it->udata;
+      if (++n == max)
+        s->cursor = (i + 1) % EV_MAX_SOURCES;
+    }
+    if (it->src == EV_SRC_TIMER && (!*next_timer || it->next < *next_timer))
+      *next_timer = it->next;
+  }
+  spin_unlock_irqrestore(&s->lock, flags);
+  return n;
+}
+
+/* ev_timeout - software-timer callback (IRQ context, under timer_lock):
+ * the EV_WAIT deadline or a timer source is due. */
+static void ev_timeout(void *data) {
+  struct process *p = data;
+  struct evset *s = p->ev_set;
+  if (s)
+    event_wake(s);
+}
+
+/* ev_wait_end - leave the set: stop the timer and unpublish ev_set.
+ * timer_del waits out a callback already running, so ev_set cannot be
+ * read by it afterwards. */
+static void ev_wait_end(struct process *p) {
+  if (p->ev_timed) {
+    timer_del(&p->ev_timer);
+    p->ev_timed = 0;
+  }
+  p->ev_set = NULL;
+}
+
+void event_release(struct process *p) { ev_wait_end(p); }
+
+static long ev_wait(int h, struct ev_event *uout, int max, long timeout_ms) {
+  struct process *p = current_process;
+  /* Non-NULL here: this is the retry of a wait that blocked. */
+  int retry = p->ev_set != NULL;
+  ev_wait_end(p);
+  if (max <= 0 || max > EV_MAX_BATCH)
+    return -EINVAL;
+  struct evset *s = ev_get(h);
+  if (!s)
+    return -EBADF;
+  if (!retry)
+    p->ev_deadline =
+        timeout_ms > 0 ? jiffies + msecs_to_jiffies((uint64_t)timeout_ms) + 1
+                       : 0;
+
+  /* Publish before scanning: a sender that buffers a message after the
+   * scan looked then sees ev_set and wakes us (see ipc_send_locked). */
+  __atomic_store_n(&p->ev_set, s, __ATOMIC_SEQ_CST);
+  uint32_t seq = __atomic_load_n(&s->seq, __ATOMIC_SEQ_CST);
+
+  struct ev_event out[EV_MAX_BATCH];
+  uint64_t next_timer;
+  int n = ev_collect(s, out, max, &next_timer);
+  int expired = p->ev_deadline && jiffies >= p->ev_deadline;
+  if (n > 0 || timeout_ms == 0 || expired) {
+    p->ev_set = NULL;
+    ev_put(s);
+    if (n > 0 && vmm_copy_to_user(uout, out, n * sizeof(out[0])) != 0)
+      return -EFAULT;
+    return n;
+  }
+
+  uint64_t wake_at = p->ev_deadline;
+  if (next_timer && (!wake_at || next_timer < wake_at))
+    wake_at = next_timer;
+
+  uint64_t flags;
+  hal_irq_save(&flags);
+  wait_queue_block(&s->wq);
+  /* Something fired between the scan and queueing: wake the queue (us
+   * included) so the retry re-scans. */
+  if (__atomic_load_n(&s->seq, __ATOMIC_SEQ_CST) != seq)
+    wait_queue_wake(&s->wq, 1);
+  hal_irq_restore(flags);
+
+  /* Armed outside every lock this callback takes (timer_lock -> wq). */
+  if (wake_at) {
+    timer_setup(&p->ev_timer, ev_timeout, p);
+    p->ev_timed = 1;
+    timer_add(&p->ev_timer, wake_at > jiffies ? wake_at : jiffies + 1);
+  }
+  ev_put(s);
+  return EV_WAIT_RETRY;
+}
+
+/*
+ * sys_event - SYS_EVENT entry (include/api/event.h for the user contract).
+ * EV_WAIT may return EV_WAIT_RETRY; see kernel/event.h.
+ */
+long sys_event(int op, uint64_t a1, uint64_t a2, uint64_t a3, uint64_t a4) {
+  if (!current_process || !current_process->space)
+    return -EINVAL;
+  switch (op) {
+  case EV_CREATE:
+    return ev_create();
+  case EV_CLOSE:
+    return ev_close((int)a1);
+  case EV_WAIT:
+    return ev_wait((int)a1, (struct ev_event *)a2, (int)a3, (long)a4);
+  case EV_ADD:
+  case EV_DEL: {
+    struct evset *s = ev_get((int)a1);
+    if (!s)
+      return -EBADF;
+    long rc = op == EV_ADD ? ev_add(s, (const struct ev_source *)a2)
+                           : ev_del(s, (int)a2);
+    ev_put(s);
+    return rc;
+  }
+  default:
+    return -ENOSYS;
+  }
+}
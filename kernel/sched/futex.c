@@ -0,0 +1,284 @@
+/*
+ * kernel/sched/futex.c
+ * SYS_FUTEX: sleep/wake on user memory words (see kernel/futex.h).
+ *
+ * Keys are physical addresses, so the table is global: FUTEX_HASH_SIZE
+ * buckets, each a spinlock and a chain of struct futex_waiter (embedded in
+ * the waiting thread's descriptor).  The futex word is read through the
+ * kernel direct map of the resolved frame, under the bucket lock, which is
+ * what makes "compare *uaddr, then sleep" atomic against FUTEX_WAKE: a waker
+ * that changed the word and then takes the same bucket lock either finds
+ * the waiter queued or made the compare fail.
+ */
+#include <futex.h>
+#include <kernel/arch.h>
+#include <kernel/cpu.h>
+#include <kernel/futex.h>
+#include <kernel/memlayout.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+#include <kernel/vmm.h>
+
+struct futex_bucket {
+  spinlock_t lock;
+  struct list_head waiters;
+};
+
+static struct futex_bucket futex_table[FUTEX_HASH_SIZE];
+
+/* Fibonacci hash of the word index: neighbouring words (a mutex and its
+ * condvar) land in different buckets. */
+static int futex_hash(uint64_t key) {
+  return (int)(((key >> 2) * 0x9E3779B97F4A7C15ULL) >> (64 - FUTEX_HASH_BITS));
+}
+
+void futex_init(void) {
+  for (int i = 0; i < FUTEX_HASH_SIZE; i++) {
+    spin_lock_init(&futex_table[i].lock);
+    INIT_LIST_HEAD(&futex_table[i].waiters);
+  }
+}
+
+/* futex_key - physical address of the caller's futex word, or 0 if it is
+ * misaligned or not a user-accessible mapping of the calling process. */
+static uint64_t futex_key(const uint32_t *uaddr) {
+  struct process *p = current_process;
+  uint64_t va = (uint64_t)uaddr;
+  if (!p || !p->page_table || (va & 3) || !vmm_is_user_addr(va))
+    return 0;
+  if (vmm_check_range(p->page_table, va, sizeof(uint32_t),
+                      PTE_VALID | PTE_USER) != 0)
+    return 0;
+  return vmm_get_phys(p->page_table, va);
+}
+
+static uint32_t futex_read(uint64_t key) {
+  return *(volatile uint32_t *)phys_to_virt(key);
+}
+
+/* futex_lock_waiter - lock the bucket w is queued on.  A concurrent
+ * FUTEX_REQUEUE may move w between reading w->bucket and taking the lock,
+ * so re-check after locking.  Returns the locked bucket (w may no longer
+ * be queued when it returns; the caller checks w->state). */
+static struct futex_bucket *futex_lock_waiter(struct futex_waiter *w,
+                                              uint64_t *flags) {
+  for (;;) {
+    struct futex_bucket *b = &futex_table[w->bucket];
+    spin_lock_irqsave(&b->lock, flags);
+    if (&futex_table[w->bucket] == b)
+      return b;
+    spin_unlock_irqrestore(&b->lock, *flags);
+  }
+}
+
+/* __futex_wake_one - dequeue w with the given outcome and make its thread
+ * runnable.  Caller holds w's bucket lock, which keeps the thread alive
+ * (futex_release takes the same lock before the descriptor is freed). */
+static void __futex_wake_one(struct futex_waiter *w, int outcome) {
+  list_del_init(&w->node);
+  w->state = outcome;
+  wake_sleeping_task(container_of(w, struct process, futex));
+}
+
+/* futex_timeout - software-timer callback (CPU 0, IRQ context, under
+ * timer_lock).  A FUTEX_WAIT_PI that times out stops lending its rank. */
+static void futex_timeout(void *data) {
+  struct process *p = data;
+  struct futex_waiter *w = &p->futex;
+  uint64_t flags;
+  int donee = 0;
+  struct futex_bucket *b = futex_lock_waiter(w, &flags);
+  if (w->state == FUTEX_W_QUEUED) {
+    donee = p->pi_donee;
+    __futex_wake_one(w, FUTEX_W_TIMEDOUT);
+  }
+  spin_unlock_irqrestore(&b->lock, flags);
+  pi_withdraw(donee);
+}
+
+/* futex_dequeue - cancel any wait still in flight for p: stop the timer and
+ * unlink the entry.  Returns the last outcome and resets the entry to IDLE. */
+static int futex_dequeue(struct process *p) {
+  struct futex_waiter *w = &p->futex;
+  if (w->timed) {
+    timer_del(&w->timeout); /* waits out a callback already running */
+    w->timed = 0;
+  }
+  if (w->state == FUTEX_W_IDLE)
+    return FUTEX_W_IDLE;
+
+  uint64_t flags;
+  struct futex_bucket *b = futex_lock_waiter(w, &flags);
+  int state = w->state;
+  if (state == FUTEX_W_QUEUED)
+    list_del_init(&w->node);
+  w->state = FUTEX_W_IDLE;
+  spin_unlock_irqrestore(&b->lock, flags);
+  return state;
+}
+
+void futex_release(struct process *p) { futex_dequeue(p); }
+
+/* futex_wait - FUTEX_WAIT, or FUTEX_WAIT_PI when owner (the lock holder's
+ * tid) is non-zero: the sleeping thread then lends its scheduling rank to
+ * owner until it is woken (pi_boost; the holder settles on FUTEX_WAKE). */
+static long futex_wait(uint32_t *uaddr, uint32_t val, uint64_t timeout_ms,
+                       int owner) {
+  struct process *p = current_process;
+
+  /* Retried after a sleep: report how it ended.  QUEUED here means the
+   * thread was made runnable by something else; treat it as spurious and
+   * re-evaluate from scratch, as callers must loop anyway.  Whoever woke
+   * us, the holder we lent to re-derives its rank without us (the
+   * unlocking holder has already settled itself). */
+  int prev = futex_dequeue(p);
+  int donee = p->pi_donee;
+  p->pi_donee = 0;
+  if (prev != FUTEX_W_IDLE)
+    pi_withdraw(donee);
+  if (prev == FUTEX_W_WOKEN)
+    return 0;
+  if (prev == FUTEX_W_TIMEDOUT)
+    return -ETIMEDOUT;
+
+  uint64_t key = futex_key(uaddr);
+  if (!key)
+    return -EFAULT;
+
+  struct futex_waiter *w = &p->futex;
+  int idx = futex_hash(key);
+  struct futex_bucket *b = &futex_table[idx];
+  uint64_t flags;
+  spin_lock_irqsave(&b->lock, &flags);
+  if (futex_read(key) != val) {
+    spin_unlock_irqrestore(&b->lock, flags);
+    return -EAGAIN;
+  }
+  w->key = key;
+  w->bucket = idx;
+  w->state = FUTEX_W_QUEUED;
+  list_add_tail(&w->node, &b->waiters);
+
+  struct cpu_info *cpu = get_cpu_info();
+  spin_lock(&cpu->sched_lock);
+  p->state = PROC_SLEEPING;
+  spin_unlock(&cpu->sched_lock);
+  spin_unlock_irqrestore(&b->lock, flags);
+
+  /* Armed outside the bucket lock (timer_lock -> bucket lock order).  A
+   * wake that already happened just leaves a timer the retry cancels. */
+  if (timeout_ms) {
+    uint64_t ticks = msecs_to_jiffies(timeout_ms);
+    timer_setup(&w->timeout, futex_timeout, p);
+    w->timed = 1;
+    timer_add(&w->timeout, jiffies + (ticks ? ticks : 1));
+  }
+  if (owner > 0)
+    pi_boost(owner, 1);
+
+  pt_regs_retry_syscall(p->context);
+  return FUTEX_WAIT_RETRY;
+}
+
+static long futex_wake(uint32_t *uaddr, uint32_t nr) {
+  uint64_t key = futex_key(uaddr);
+  if (!key)
+    return -EFAULT;
+  long woken = futex_wake_key(key, nr);
+  /* An unlock: give back any rank lent through FUTEX_WAIT_PI. */
+  pi_settle(current_process);
+  return woken;
+}
+
+long futex_wake_key(uint64_t key, uint32_t nr) {
+  struct futex_bucket *b = &futex_table[futex_hash(key)];
+  long woken = 0;
+  uint64_t flags;
+  spin_lock_irqsave(&b->lock, &flags);
+  struct futex_waiter *w, *tmp;
+  list_for_each_entry_safe(w, tmp, &b->waiters, node) {
+    if ((uint32_t)woken >= nr)
+      break;
+    if (w->key != key)
+      continue;
+    __futex_wake_one(w, FUTEX_W_WOKEN);
+    woken++;
+  }
+  spin_unlock_irqrestore(&b->lock, flags);
+  return woken;
+}
+
+static long futex_requeue(uint32_t *uaddr, uint32_t nr_wake,
+                          uint64_t nr_requeue, uint32_t *uaddr2, int cmp,
+                          uint32_t val3) {
+  uint64_t key = futex_key(uaddr);
+  uint64_t key2 = futex_key(uaddr2);
+  if (!key || !key2)
+    return -EFAULT;
+
+  int i1 = futex_hash(key), i2 = futex_hash(key2);
+  struct futex_bucket *b1 = &futex_table[i1], *b2 = &futex_table[i2];
+
+  /* Two bucket locks: always lower index first. */
+  uint64_t flags;
+  hal_irq_save(&flags);
+  spin_lock(&futex_table[i1 < i2 ? i1 : i2].lock);
+  if (i1 != i2)
+    spin_lock(&futex_table[i1 < i2 ? i2 : i1].lock);
+
+  long done = 0;
+  if (cmp && futex_read(key) != val3) {
+    done = -EAGAIN;
+  } else {
+    uint64_t moved = 0;
+    struct futex_waiter *w, *tmp;
+    list_for_each_entry_safe(w, tmp, &b1->waiters, node) {
+      if (w->key != key)
+        continue;
+      if ((uint32_t)done < nr_wake) {
+        __futex_wake_one(w, FUTEX_W_WOKEN);
+        done++;
+      } else if (moved < nr_requeue) {
+        list_del(&w->node);
+        w->key = key2;
+        w->bucket = i2;
+        list_add_tail(&w->node, &b2->waiters);
+        moved++;
+      } else {
+        break;
+      }
+    }
+    done += (long)moved;
+  }
+
+  if (i1 != i2)
+    spin_unlock(&futex_table[i1 < i2 ? i2 : i1].lock);
+  spin_unlock(&futex_table[i1 < i2 ? i1 : i2].lock);
+  hal_irq_restore(flags);
+  return done;
+}
+
+/*
+ * sys_futex - SYS_FUTEX entry (include/api/futex.h for the user contract).
+ * arg3 is the FUTEX_WAIT(_PI) timeout in milliseconds (0 = none) or the
+ * FUTEX_*REQUEUE move count; val3 the FUTEX_WAIT_PI holder.
+ */
+long sys_futex(uint32_t *uaddr, int op, uint32_t val, uint64_t arg3,
+               uint32_t *uaddr2, uint32_t val3) {
+  if (!current_process)
+    return -EINVAL;
+  switch (op) {
+  case FUTEX_WAIT:
+    return futex_wait(uaddr, val, arg3, 0);
+  case FUTEX_WAIT_PI:
+    return futex_wait(uaddr, val, arg3, (int)val3);
+  case FUTEX_WAKE:
+    return futex_wake(uaddr, val);
+  case FUTEX_REQUEUE:
+    return futex_requeue(uaddr, val, arg3, uaddr2, 0, 0);
+  case FUTEX_CMP_REQUEUE:
+    return futex_requeue(uaddr, val, arg3, uaddr2, 1, val3);
+  default:
+    return -ENOSYS;
+  }
+}
@@ -0,0 +1,141 @@
+/*
+ * kernel/sched/ipc_ring.c
+ * Fixed-slot IPC receive buffer (see kernel/ipc_ring.h).
+ */
+#include <kernel/ipc_ring.h>
+#include <kernel/pmm.h>
+#include <kernel/string.h>
+
+#define NIL ((int16_t)-1)
+
+static inline int ipc_bucket(int from) {
+  return (int)((unsigned)from % IPC_RING_SENDER_BUCKETS);
+}
+
+static size_t ipc_ring_bytes(unsigned depth) {
+  return sizeof(struct ipc_ring) + depth * sizeof(struct ipc_slot);
+}
+
+static void ipc_ring_reset(struct ipc_ring *r) {
+  r->count = 0;
+  r->head = r->tail = NIL;
+  for (int b = 0; b < IPC_RING_SENDER_BUCKETS; b++)
+    r->bhead[b] = r->btail[b] = NIL;
+  for (int i = 0; i < r->depth; i++)
+    r->slots[i].next = (int16_t)(i + 1 < r->depth ? i + 1 : NIL);
+  r->free = 0;
+}
+
+struct ipc_ring *ipc_ring_alloc(unsigned depth) {
+  if (depth == 0 || depth > IPC_RING_MAX)
+    return NULL;
+  size_t pages = (ipc_ring_bytes(depth) + PAGE_SIZE - 1) / PAGE_SIZE;
+  struct ipc_ring *r =
+      pages == 1 ? pmm_alloc_page() : pmm_alloc_pages(pages);
+  if (!r)
+    return NULL;
+  r->depth = (uint16_t)depth;
+  r->pages = (uint16_t)pages;
+  ipc_ring_reset(r);
+  return r;
+}
+
+void ipc_ring_free(struct ipc_ring *r) {
+  if (!r)
+    return;
+  if (r->pages == 1)
+    pmm_free_page(r);
+  else
+    pmm_free_pages(r, r->pages);
+}
+
+void ipc_ring_clear(struct ipc_ring *r) { ipc_ring_reset(r); }
+
+int ipc_ring_push(struct ipc_ring *r, const struct ipc_message *msg) {
+  if (r->free == NIL)
+    return -EAGAIN;
+  int16_t i = r->free;
+  struct ipc_slot *s = &r->slots[i];
+  r->free = s->next;
+  memcpy(&s->msg, msg, sizeof(struct ipc_message));
+
+  s->next = NIL;
+  s->prev = r->tail;
+  if (r->tail != NIL)
+    r->slots[r->tail].next = i;
+  else
+    r->head = i;
+  r->tail = i;
+
+  int b = ipc_bucket(msg->from);
+  s->snext = NIL;
+  s->sprev = r->btail[b];
+  if (r->btail[b] != NIL)
+    r->slots[r->btail[b]].snext = i;
+  else
+    r->bhead[b] = i;
+  r->btail[b] = i;
+
+  r->count++;
+  return 0;
+}
+
+/* ipc_ring_find - index of the oldest message from src_pid (-1 = any). */
+static int16_t ipc_ring_find(struct ipc_ring *r, int src_pid) {
+  if (src_pid == -1)
+    return r->head;
+  for (int16_t i = r->bhead[ipc_bucket(src_pid)]; i != NIL;
+       i = r->slots[i].snext)
+    if (r->slots[i].msg.from == src_pid)
+      return i;
+  return NIL;
+}
+
+static void ipc_ring_unlink(struct ipc_ring *r, int16_t i) {
+  struct ipc_slot *s = &r->slots[i];
+
+  if (s->prev != NIL)
+    r->slots[s->prev].next = s->next;
+  else
+    r->head = s->next;
+  if (s->next != NIL)
+    r->slots[s->next].prev = s->prev;
+  else
+    r->tail = s->prev;
+
+  int b = ipc_bucket(s->msg.from);
+  if (s->sprev != NIL)
+    r->slots[s->sprev].snext = s->snext;
+  else
+    r->bhead[b] = s->snext;
+  if (s->snext != NIL)
+    r->slots[s->snext].sprev = s->sprev;
+  else
+    r->btail[b] = s->sprev;
+
+  s->next = r->free;
+  r->free = i;
+  r->count--;
+}
+
+int ipc_ring_pop(struct ipc_ring *r, int src_pid, struct ipc_message *out) {
+  int16_t i = ipc_ring_find(r, src_pid);
+  if (i == NIL)
+    return -1;
+  memcpy(out, &r->slots[i].msg, sizeof(struct ipc_message));
+  ipc_ring_unlink(r, i);
+  return 0;
+}
+
+int ipc_ring_has(struct ipc_ring *r, int src_pid) {
+  return ipc_ring_find(r, src_pid) != NIL;
+}
+
+int ipc_ring_move(struct ipc_ring *to, struct ipc_ring *from) {
+  if (to->depth - to->count < from->count)
+    return -EBUSY;
+  struct ipc_message m;
+  while (ipc_ring_pop(from, -1, &m) == 0)
+    ipc_ring_push(to, &m);
+  return 0;
+}
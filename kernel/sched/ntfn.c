@@ -0,0 +1,296 @@
+/*
+ * kernel/sched/ntfn.c
+ * SYS_NTFN: notification objects (see kernel/ntfn.h).  Binding to an
+ * endpoint is endpoint.c's (endpoint_bind_ntfn); delivery to a bound
+ * receiver is process.c's (pop_message, ipc_notify_thread).
+ */
+#include <kernel/arch.h>
+#include <kernel/endpoint.h>
+#include <kernel/ntfn.h>
+#include <kernel/rcu.h>
+#include <kernel/vmm.h>
+
+static struct ntfn ntfn_table[MAX_NTFNS];
+static DEFINE_SPINLOCK(ntfn_table_lock);
+
+void ntfn_init(void) {
+  for (int i = 0; i < MAX_NTFNS; i++) {
+    spin_lock_init(&ntfn_table[i].lock);
+    INIT_LIST_HEAD(&ntfn_table[i].wq.task_list);
+    spin_lock_init(&ntfn_table[i].wq.lock);
+  }
+}
+
+uint64_t ntfn_take(struct ntfn *n) {
+  return __atomic_exchange_n(&n->bits, 0, __ATOMIC_SEQ_CST);
+}
+
+void ntfn_signal(struct ntfn *n, uint64_t bits) {
+  if (!bits)
+    return;
+  uint64_t flags;
+  spin_lock_irqsave(&n->lock, &flags);
+  __atomic_or_fetch(&n->bits, bits, __ATOMIC_SEQ_CST);
+  wait_queue_wake(&n->wq, 0);
+  if (n->bound)
+    ipc_notify_thread(n->bound);
+  spin_unlock_irqrestore(&n->lock, flags);
+}
+
+/* __ntfn_signal_sys - raise bit on the subscribed objects of tgid, or of
+ * everyone when tgid < 0. */
+static void __ntfn_signal_sys(uint64_t bit, int tgid) {
+  uint64_t flags;
+  spin_lock_irqsave(&ntfn_table_lock, &flags);
+  for (int i = 0; i < MAX_NTFNS; i++) {
+    struct ntfn *n = &ntfn_table[i];
+    if (n->refs > 0 && (n->sys_mask & bit) &&
+        (tgid < 0 || n->owner_tgid == tgid))
+      ntfn_signal(n, bit);
+  }
+  spin_unlock_irqrestore(&ntfn_table_lock, flags);
+}
+
+void ntfn_signal_sys(uint64_t bit, int tgid) {
+  if (tgid > 0)
+    __ntfn_signal_sys(bit, tgid);
+}
+
+void ntfn_broadcast_sys(uint64_t bit) { __ntfn_signal_sys(bit, -1); }
+
+/* ntfn_tgid_of - the process thread pid belongs to; 0 if there is none. */
+static int ntfn_tgid_of(int pid) {
+  if (pid <= 0)
+    return 0;
+  uint64_t flags;
+  rcu_read_lock(&flags);
+  struct process *p = __process_find_by_pid(pid);
+  int tgid = p ? p->tgid : 0;
+  rcu_read_unlock(flags);
+  return tgid;
+}
+
+void ntfn_signal_focus(int from_pid, int to_pid) {
+  int from = ntfn_tgid_of(from_pid);
+  int to = ntfn_tgid_of(to_pid);
+  if (from == to)
+    return; /* between two threads of one process: no change for it */
+  ntfn_signal_sys(NTFN_SYS_FOCUS, from);
+  ntfn_signal_sys(NTFN_SYS_FOCUS, to);
+}
+
+/* --- Binding --- */
+
+int ntfn_attach(struct ntfn *n, struct process *p) {
+  uint64_t flags;
+  spin_lock_irqsave(&n->lock, &flags);
+  spin_lock(&p->msg_lock);
+  int ok = !n->bound && !p->bound_ntfn;
+  if (ok) {
+    n->bound = p;
+    p->bound_ntfn = n;
+  }
+  spin_unlock(&p->msg_lock);
+  /* Bits signalled while nobody was bound are waiting for this thread. */
+  if (ok && __atomic_load_n(&n->bits, __ATOMIC_SEQ_CST))
+    ipc_notify_thread(p);
+  spin_unlock_irqrestore(&n->lock, flags);
+  return ok ? 0 : -EBUSY;
+}
+
+void ntfn_detach(struct ntfn *n, struct process *p) {
+  uint64_t flags;
+  spin_lock_irqsave(&n->lock, &flags);
+  if (n->bound == p) {
+    spin_lock(&p->msg_lock);
+    n->bound = NULL;
+    p->bound_ntfn = NULL;
+    spin_unlock(&p->msg_lock);
+  }
+  spin_unlock_irqrestore(&n->lock, flags);
+}
+
+/* __ntfn_put - drop one reference; the last frees the slot and wakes any
+ * NTFN_WAIT sleeper (its retry fails -EBADF).  ntfn_table_lock held. */
+static void __ntfn_put(struct ntfn *n) {
+  if (--n->refs > 0)
+    return;
+  spin_lock(&n->lock);
+  n->bits = 0;
+  n->sys_mask = 0;
+  n->ep_bound = 0;
+  wait_queue_wake(&n->wq, 1);
+  spin_unlock(&n->lock);
+}
+
+void ntfn_put(struct ntfn *n) {
+  uint64_t flags;
+  spin_lock_irqsave(&ntfn_table_lock, &flags);
+  __ntfn_put(n);
+  spin_unlock_irqrestore(&ntfn_table_lock, flags);
+}
+
+struct ntfn *ntfn_bind_get(int h, long *err) {
+  struct proc_space *space = current_process->space;
+  if (h < 0 || h >= NPROC_NTFNS || !space->ntfns[h]) {
+    *err = -EBADF;
+    return NULL;
+  }
+  struct ntfn *n = space->ntfns[h];
+  spin_lock(&ntfn_table_lock);
+  if (n->ep_bound) {
+    spin_unlock(&ntfn_table_lock);
+    *err = -EBUSY;
+    return NULL;
+  }
+  n->ep_bound = 1;
+  n->refs++;
+  spin_unlock(&ntfn_table_lock);
+  return n;
+}
+
+/* --- Handles --- */
+
+/* ntfn_get - the object behind handle h with a reference held, or NULL. */
+static struct ntfn *ntfn_get(int h) {
+  struct proc_space *space = current_process->space;
+  if (h < 0 || h >= NPROC_NTFNS)
+    return NULL;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  struct ntfn *n = space->ntfns[h];
+  if (n) {
+    spin_lock(&ntfn_table_lock);
+    n->refs++;
+    spin_unlock(&ntfn_table_lock);
+  }
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return n;
+}
+
+static long ntfn_create(void) {
+  struct process *self = current_process;
+  struct proc_space *space = self->space;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  int h = 0;
+  while (h < NPROC_NTFNS && space->ntfns[h])
+    h++;
+  if (h == NPROC_NTFNS) {
+    spin_unlock_irqrestore(&space->handle_lock, flags);
+    return -EMFILE;
+  }
+  spin_lock(&ntfn_table_lock);
+  struct ntfn *n = NULL;
+  for (int i = 0; i < MAX_NTFNS; i++) {
+    if (ntfn_table[i].refs == 0) {
+      n = &ntfn_table[i];
+      break;
+    }
+  }
+  if (n) {
+    n->refs = 1;
+    n->owner_tgid = self->tgid;
+    space->ntfns[h] = n;
+  }
+  spin_unlock(&ntfn_table_lock);
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return n ? h : -ENOSPC;
+}
+
+static long ntfn_close(int h) {
+  struct proc_space *space = current_process->space;
+  if (h < 0 || h >= NPROC_NTFNS)
+    return -EBADF;
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  struct ntfn *n = space->ntfns[h];
+  space->ntfns[h] = NULL;
+  if (n) {
+    spin_lock(&ntfn_table_lock);
+    __ntfn_put(n);
+    spin_unlock(&ntfn_table_lock);
+  }
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return n ? 0 : -EBADF;
+}
+
+void ntfn_release_space(struct proc_space *space) {
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  spin_lock(&ntfn_table_lock);
+  for (int h = 0; h < NPROC_NTFNS; h++) {
+    if (space->ntfns[h]) {
+      __ntfn_put(space->ntfns[h]);
+      space->ntfns[h] = NULL;
+    }
+  }
+  spin_unlock(&ntfn_table_lock);
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+}
+
+/* ntfn_wait - NTFN_WAIT / NTFN_POLL: take the pending bits into *ubits,
+ * sleeping on n->wq while there are none if block is set. */
+static long ntfn_wait(struct ntfn *n, uint64_t *ubits, int block) {
+  uint64_t flags;
+  spin_lock_irqsave(&n->lock, &flags);
+  uint64_t bits = ntfn_take(n);
+  if (!bits && block) {
+    wait_queue_block(&n->wq);
+    spin_unlock_irqrestore(&n->lock, flags);
+    return NTFN_WAIT_RETRY;
+  }
+  spin_unlock_irqrestore(&n->lock, flags);
+  if (vmm_copy_to_user(ubits, &bits, sizeof(bits)) != 0) {
+    __atomic_or_fetch(&n->bits, bits, __ATOMIC_SEQ_CST); /* not consumed */
+    return -EFAULT;
+  }
+  return 0;
+}
+
+/*
+ * sys_ntfn - SYS_NTFN entry (include/api/ntfn.h for the user contract).
+ * NTFN_WAIT may return NTFN_WAIT_RETRY; see kernel/ntfn.h.
+ */
+long sys_ntfn(int op, uint64_t a1, uint64_t a2) {
+  if (!current_process || !current_process->space)
+    return -EINVAL;
+  switch (op) {
+  case NTFN_CREATE:
+    return ntfn_create();
+  case NTFN_CLOSE:
+    return ntfn_close((int)a1);
+  case NTFN_BIND:
+    return endpoint_bind_ntfn((int)a2, (int)a1);
+  default:
+    break;
+  }
+
+  struct ntfn *n = ntfn_get((int)a1);
+  if (!n)
+    return -EBADF;
+  long rc = 0;
+  switch (op) {
+  case NTFN_SIGNAL:
+    ntfn_signal(n, a2);
+    break;
+  case NTFN_WAIT:
+  case NTFN_POLL:
+    rc = ntfn_wait(n, (uint64_t *)a2, op == NTFN_WAIT);
+    break;
+  case NTFN_SUBSCRIBE:
+    if (a2 & ~NTFN_SYS_ALL) {
+      rc = -EINVAL;
+      break;
+    }
+    uint64_t flags;
+    spin_lock_irqsave(&ntfn_table_lock, &flags);
+    n->sys_mask = a2;
+    spin_unlock_irqrestore(&ntfn_table_lock, flags);
+    break;
+  default:
+    rc = -ENOSYS;
+  }
+  ntfn_put(n);
+  return rc;
+}
@@ -0,0 +1,186 @@
+/*
+ * kernel/sched/pipe.c
+ * Pipes (see kernel/pipe.h).  The fd plumbing — pipe2, read / write,
+ * close, spawn inheritance — is syscall_dispatch.c's and process.c's.
+ */
+#include <kernel/event.h>
+#include <kernel/pipe.h>
+#include <kernel/pmm.h>
+#include <kernel/string.h>
+
+static struct pipe pipe_table[MAX_PIPES];
+static DEFINE_SPINLOCK(pipe_table_lock);
+
+void pipe_init(void) {
+  for (int i = 0; i < MAX_PIPES; i++) {
+    struct pipe *p = &pipe_table[i];
+    spin_lock_init(&p->lock);
+    INIT_LIST_HEAD(&p->rd_wq.task_list);
+    spin_lock_init(&p->rd_wq.lock);
+    INIT_LIST_HEAD(&p->wr_wq.task_list);
+    spin_lock_init(&p->wr_wq.lock);
+  }
+}
+
+struct pipe *pipe_create(void) {
+  uint8_t *buf = pmm_alloc_page();
+  if (!buf)
+    return NULL;
+  uint64_t flags;
+  spin_lock_irqsave(&pipe_table_lock, &flags);
+  struct pipe *p = NULL;
+  for (int i = 0; i < MAX_PIPES; i++) {
+    if (pipe_table[i].refs == 0) {
+      p = &pipe_table[i];
+      break;
+    }
+  }
+  if (p) {
+    p->refs = 2;
+    spin_lock(&p->lock);
+    p->readers = 1;
+    p->writers = 1;
+    p->head = 0;
+    p->tail = 0;
+    p->buf = buf;
+    spin_unlock(&p->lock);
+  }
+  spin_unlock_irqrestore(&pipe_table_lock, flags);
+  if (!p)
+    pmm_free_page(buf);
+  return p;
+}
+
+void pipe_get(struct pipe *p) {
+  uint64_t flags;
+  spin_lock_irqsave(&pipe_table_lock, &flags);
+  p->refs++;
+  spin_unlock_irqrestore(&pipe_table_lock, flags);
+}
+
+/* pipe_put - the last reference frees the ring.  Nobody can be parked on
+ * the pipe by then: closing the last end woke both queues. */
+void pipe_put(struct pipe *p) {
+  uint8_t *buf = NULL;
+  uint64_t flags;
+  spin_lock_irqsave(&pipe_table_lock, &flags);
+  if (--p->refs == 0) {
+    buf = p->buf;
+    p->buf = NULL;
+  }
+  spin_unlock_irqrestore(&pipe_table_lock, flags);
+  if (buf)
+    pmm_free_page(buf);
+}
+
+void pipe_open_end(struct pipe *p, int write) {
+  pipe_get(p);
+  uint64_t flags;
+  spin_lock_irqsave(&p->lock, &flags);
+  if (write)
+    p->writers++;
+  else
+    p->readers++;
+  spin_unlock_irqrestore(&p->lock, flags);
+}
+
+void pipe_close_end(struct pipe *p, int write) {
+  uint64_t flags;
+  spin_lock_irqsave(&p->lock, &flags);
+  int last = write ? --p->writers == 0 : --p->readers == 0;
+  /* Wake both sides: the far end may now see EOF / EPIPE, and a sibling
+   * thread parked on this very fd must retry into -EBADF. */
+  wait_queue_wake(&p->rd_wq, 1);
+  wait_queue_wake(&p->wr_wq, 1);
+  spin_unlock_irqrestore(&p->lock, flags);
+  if (last)
+    event_notify_obj(p);
+  pipe_put(p);
+}
+
+/* Readiness.  The write end counts as ready once PIPE_BUF bytes fit, so a
+ * writer that polls before an atomic write does not spin on -EAGAIN.
+ * p->lock held. */
+static int pipe_rd_ready(struct pipe *p) {
+  return p->tail != p->head || p->writers == 0;
+}
+
+static int pipe_wr_ready(struct pipe *p, size_t n) {
+  uint32_t room = PIPE_SIZE - (p->tail - p->head);
+  return p->readers == 0 || (n <= PIPE_BUF ? room >= n : room > 0);
+}
+
+long pipe_read(struct pipe *p, void *k, size_t n) {
+  if (n == 0)
+    return 0;
+  uint64_t flags;
+  spin_lock_irqsave(&p->lock, &flags);
+  uint32_t used = p->tail - p->head;
+  if (used == 0) {
+    long rc = p->writers ? -EAGAIN : 0;
+    spin_unlock_irqrestore(&p->lock, flags);
+    return rc;
+  }
+  if (n > used)
+    n = used;
+  uint32_t off = p->head % PIPE_SIZE;
+  size_t first = n < PIPE_SIZE - off ? n : PIPE_SIZE - off;
+  memcpy(k, p->buf + off, first);
+  memcpy((uint8_t *)k + first, p->buf, n - first);
+  p->head += (uint32_t)n;
+  wait_queue_wake(&p->wr_wq, 1);
+  spin_unlock_irqrestore(&p->lock, flags);
+  /* EV_OUT edge: room crossed PIPE_BUF. */
+  if (PIPE_SIZE - used < PIPE_BUF && PIPE_SIZE - used + n >= PIPE_BUF)
+    event_notify_obj(p);
+  return (long)n;
+}
+
+long pipe_write(struct pipe *p, const void *k, size_t n) {
+  if (n == 0)
+    return 0;
+  uint64_t flags;
+  spin_lock_irqsave(&p->lock, &flags);
+  if (p->readers == 0) {
+    spin_unlock_irqrestore(&p->lock, flags);
+    return -EPIPE;
+  }
+  uint32_t used = p->tail - p->head;
+  size_t room = PIPE_SIZE - used;
+  if (room == 0 || (n <= PIPE_BUF && room < n)) {
+    spin_unlock_irqrestore(&p->lock, flags);
+    return -EAGAIN;
+  }
+  if (n > room)
+    n = room;
+  uint32_t off = p->tail % PIPE_SIZE;
+  size_t first = n < PIPE_SIZE - off ? n : PIPE_SIZE - off;
+  memcpy(p->buf + off, k, first);
+  memcpy(p->buf, (const uint8_t *)k + first, n - first);
+  p->tail += (uint32_t)n;
+  if (used == 0)
+    wait_queue_wake(&p->rd_wq, 1);
+  spin_unlock_irqrestore(&p->lock, flags);
+  if (used == 0)
+    event_notify_obj(p); /* EV_IN edge: no longer empty */
+  return (long)n;
+}
+
+int pipe_wait(struct pipe *p, int write, size_t n) {
+  uint64_t flags;
+  spin_lock_irqsave(&p->lock, &flags);
+  int ready = write ? pipe_wr_ready(p, n) : pipe_rd_ready(p);
+  if (!ready)
+    wait_queue_block(write ? &p->wr_wq : &p->rd_wq);
+  spin_unlock_irqrestore(&p->lock, flags);
+  return !ready;
+}
+
+uint32_t pipe_poll(struct pipe *p, int write) {
+  uint64_t flags;
+  spin_lock_irqsave(&p->lock, &flags);
+  uint32_t r = write ? (pipe_wr_ready(p, PIPE_BUF) ? EV_OUT : 0)
+                     : (pipe_rd_ready(p) ? EV_IN : 0);
+  spin_unlock_irqrestore(&p->lock, flags);
+  return r;
+}
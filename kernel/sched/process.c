@@ -7,31 +7,71 @@
  *     the PMM one page each.
  *   - Per-CPU O(1) priority-bitmap runqueues (MAX_PRIO levels) with
  *     work-stealing between CPUs using trylock to avoid AB-BA deadlocks.
+ *   - A SCHED_RT class (include/api/sched.h) on separate per-CPU RT queues
+ *     picked first: each RT thread holds an admitted runtime/period
+ *     reservation, sched_tick() charges it, and a thread out of budget runs
+ *     from the normal queues until its period ends; each CPU additionally
+ *     caps RT at RT_CPU_RUNTIME of every RT_CPU_PERIOD ticks.
+ *   - Priority inheritance: a thread blocked in SYS_CALL, a recv() from one
+ *     pid or a FUTEX_WAIT_PI lends its rank to the thread it waits for
+ *     (pi_boost, transitively); the boosted thread recomputes what it is
+ *     still owed when it goes back to receive or wakes futex waiters
+ *     (pi_settle).
+ *   - Tracepoints (kernel/trace.h): SWITCH/MIGRATE in schedule() via
+ *     trace_switch(), WAKEUP where a sleeper is made runnable; each is one
+ *     test of trace_mask while tracing is off.
  *   - Deferred-free: a process terminated while running on another CPU is
  *     marked PROC_DEAD and freed on the *next* schedule() call on that CPU,
  *     after the kernel stack is no longer in use.
- *   - A kmalloc-backed linked-list IPC per process (msg_queue), with
- *     sleeping-receiver wakeup on send.
+ *   - A bounded, allocation-free IPC receive buffer per thread (msg_ring,
+ *     kernel/ipc_ring.h) with sleeping-receiver wakeup on send and
+ *     backpressure when full: SYS_SEND blocks on msg_space (or fails
+ *     -EAGAIN with IPC_NONBLOCK), kernel-originated sends are dropped.
+ *   - Synchronous call/reply IPC (SYS_CALL / SYS_REPLY_RECV): a message for
+ *     a thread blocked in one of them is copied straight into its buffer
+ *     (no queue node) and the sender's CPU switches directly to it via
+ *     cpu->ipc_handoff, donating the rest of the time slice.
  *   - sys_sbrk: demand-mapped user heap extending upward from the top of the
  *     ELF segments, with no upper-bound check against the user stack.
+ *   - Threads: a struct process is one schedulable thread.  The address
+ *     space, heap break, cwd and fd table live in a refcounted proc_space
+ *     shared by every thread of the process; pid is the thread id and tgid
+ *     the leader's pid (what getpid, the compositor and exit() see).  The
+ *     last thread out destroys the PGD (space_put).
  *
  * Locking hierarchy (must be acquired in this order):
  *   sched_lock (global) -> target->msg_lock -> target_cpu->sched_lock
+ *   target->msg_lock -> target->msg_space.lock -> cpu->sched_lock (blocked
+ *   senders)
+ *   target->msg_lock -> target->space->mm_lock (IPC direct delivery)
+ *   space->handle_lock -> ep_table_lock -> ep->lock -> target->msg_lock
+ *   (endpoint sends, kernel/endpoint.h); sched_lock -> ep_table_lock
+ *   chan_lock -> space->handle_lock (channel connect, kernel/channel.h)
+ *   target->msg_lock -> evset->wq.lock (event_wake, kernel/event.h)
+ *   ep->lock -> ntfn->lock -> bound->msg_lock (notifications, kernel/ntfn.h);
+ *   sched_lock -> ntfn_table_lock (child-exit signal)
+ *   space->thread_lock -> cpu->sched_lock (sys_thread_join); thread_lock is
+ *   never held while taking sched_lock.
  *
  * Key invariants:
  *   - current_process is a per-CPU variable (accessed via get_cpu_info());
  *     safe to read/write without a lock during a syscall or IRQ on that CPU.
  *   - The idle task for each CPU is created by smp_create_idle_task(); its
  *     page_table is NULL and it is never enqueued or stolen by work-stealing.
- *   - process_pool[] slot is set to NULL only after the process struct and
- *     kernel stack are freed (or deferred via cpu_ptr->deferred_free_proc).
+ *   - process_pool[] slots are published with rcu_assign_pointer and read
+ *     locklessly inside rcu_read_lock (pid lookups, IPC sends, ps).  A slot
+ *     is cleared before teardown, and the descriptor itself is freed with
+ *     call_rcu, so such a reader never sees freed memory; it sees a dying
+ *     thread at worst, and msg_closed (under msg_lock) stops IPC to it.
  *   - PIDs are assigned from next_pid (monotonically increasing, never reused).
  *
  * Known issues:
  *   SCHED-01  (W3 WRONG-DESIGN) schedule() calls compositor_get_focus_pid()
  *             and gives the focused window's process priority access to the
  *             runqueue — the kernel scheduler depends on the graphics
- *             compositor, inverting the correct dependency.
+ *             compositor, inverting the correct dependency.  Services that
+ *             need bounded latency now use SCHED_RT instead; the boost
+ *             remains for interactive apps and ranks below RT.
  *   SCHED-02  (W2 BAD-IMPL) schedule() is large and intricate; many pc==0
  *             panic guards betray past context-corruption bugs.
  *   SCHED-03  (W2 WRONG-DESIGN, MITIGATED) process_wait() is non-blocking
@@ -43,8 +83,8 @@
  *             but STACK_SIZE is 128KB.
  *   SCHED-05  (W3 BUG/SECURITY) kernel_ipc_send() nests sched_lock -> msg_lock
  *             -> cpu->sched_lock — an AB-BA deadlock risk acknowledged in code
- *             comments.  Additionally, msg_queue is unbounded: a sender can OOM
- *             a receiver with no flow control.
+ *             comments.  (The unbounded-queue half is RESOLVED: msg_ring
+ *             has a fixed depth and full rings push back on the sender.)
  *   SCHED-06  (W2 WRONG-DESIGN) No parent/child relationship; process_wait()
  *             accepts any PID; no process groups or sessions.
  *   SCHED-07  (W2 BUG) sys_sbrk() has no upper-bound check; heap can collide
@@ -59,21 +99,35 @@
  *             empty.
  */
 #include <kernel/arch.h>
+#include <kernel/channel.h>
 #include <kernel/cpu.h>
+#include <kernel/endpoint.h>
+#include <kernel/event.h>
+#include <kernel/ntfn.h>
+#include <kernel/fpu.h>
+#include <kernel/futex.h>
+#include <kernel/ipc_ring.h>
 #include <kernel/kmalloc.h>
 #include <kernel/list.h>
+#include <kernel/percpu.h>
+#include <kernel/pmu.h>
+#include <kernel/pipe.h>
 #include <kernel/pmm.h>
 #include <kernel/printk.h>
+#include <kernel/rcu.h>
 #include <kernel/sched.h>
 #include <kernel/string.h>
+#include <kernel/trace.h>
 #include <kernel/types.h>
+#include <kernel/uring.h>
 #include <kernel/vmm.h>
+#include <drivers/timer.h>
 #include <stdint.h>
 
 /* Process pool - slots can be NULL if process terminated */
 /* process_pool[]: fixed-size table of active process descriptors.
  * A NULL slot means it is free.  Protected by sched_lock for modifications;
- * individual slots are also read locklessly by schedule() on the owning CPU. */
+ * read locklessly under rcu_read_lock (see the invariants above). */
 struct process *process_pool[MAX_PROCESSES];
 static int active_count = 0; /* Number of active processes */
 static int next_pid = 1;     /* Global PID counter (never resets) */
@@ -89,8 +143,8 @@ static int proc_limit = MAX_PROCESSES;
  * quota (SCHED-DOS-01 #122).  Caller must hold sched_lock.  PIDs are never
  * reused, so a stale parent_pid (parent already gone) finds nothing. */
 static void __child_count_dec(struct process *dead) {
-  if (dead->parent_pid <= 0)
-    return;
+  if (dead->parent_pid <= 0 || (int)dead->pid != dead->tgid)
+    return; /* threads are not charged to the child quota */
   struct process *parent = __process_find_by_pid(dead->parent_pid);
   if (parent && parent->child_count > 0)
     parent->child_count--;
@@ -120,8 +174,9 @@ static void __reparent_children(struct process *dead) {
 
   for (int i = 0; i < MAX_PROCESSES; i++) {
     struct process *p = process_pool[i];
-    if (!p || p == dead || p->parent_pid != (int)dead->pid)
-      continue;
+    if (!p || p == dead || p->parent_pid != (int)dead->pid ||
+        p->tgid == dead->tgid)
+      continue; /* sibling threads die with their leader; not adopted */
     p->parent_pid = heir_pid;
     if (heir)
       heir->child_count++;
@@ -129,13 +184,13 @@ static void __reparent_children(struct process *dead) {
 }
 
 /* Global scheduler lock - still used for process_pool and PID allocation */
-/* sched_lock: global spinlock protecting process_pool[], active_count,
- * next_pid, rr_cpu, and the outer section of kernel_ipc_send().
+/* sched_lock: global queued spinlock (kernel/spinlock.h) protecting process_pool[] updates, active_count,
+ * next_pid and rr_cpu.  Pool lookups on hot paths (IPC sends) use RCU instead.
  * Inner locks (per-CPU sched_lock, per-process msg_lock) may be taken while
  * holding sched_lock — see locking hierarchy in the file header.
  * NOTE(SCHED-05): Taking cpu->sched_lock while holding both sched_lock and
  * msg_lock creates the full AB-BA chain. */
-DEFINE_SPINLOCK(sched_lock);
+DEFINE_QSPINLOCK(sched_lock);
 /* rr_cpu: round-robin CPU index for assigning a CPU to newly woken tasks.
  * Protected by sched_lock. */
 static int rr_cpu = 0;
@@ -178,6 +233,24 @@ static void reap_push(struct cpu_info *cpu, struct process *p) {
   cpu->deferred_free_proc = p;
 }
 
+/* rt_replenish - start a new SCHED_RT period with a full budget once the
+ * current one has ended.  Caller holds the sched_lock of p's CPU. */
+static void rt_replenish(struct process *p) {
+  if (p->policy != SCHED_RT || jiffies < p->rt_period_end)
+    return;
+  p->rt_budget = p->rt_runtime;
+  p->rt_period_end = jiffies + (uint64_t)p->rt_period;
+}
+
+/* sched_rank - the rank p runs at now (kernel/sched.h): its own class and
+ * priority, or a better rank lent by a thread blocked on it. */
+static int sched_rank(const struct process *p) {
+  int own = p->policy == SCHED_RT && p->rt_budget > 0
+                ? p->rt_prio
+                : RT_PRIO_LEVELS + p->priority;
+  return p->pi_rank < own ? p->pi_rank : own;
+}
+
 /* Internal helper: Add task to runqueue (Caller MUST hold target->sched_lock) */
 static void __enqueue_task(struct process *p) {
   /* SCHED-UAF-01: never (re)enqueue a terminated process.  process_terminate()
@@ -197,12 +270,29 @@ static void __enqueue_task(struct process *p) {
     return;
   }
 
+  if (trace_on(TRACE_EV_WAKEUP) && p->state == PROC_SLEEPING)
+    __trace_emit(TRACE_EV_WAKEUP, p->pid, target_cpu_id, trace_tid());
   p->state = PROC_READY;
   p->on_cpu = target_cpu_id; /* Track which CPU's runqueue we are on */
-  int prio = p->priority;
+
+  /* SCHED_RT with budget left, or a thread lent an RT rank, goes on the RT
+   * queues; a throttled one waits in its normal queue until the period
+   * ends. */
+  rt_replenish(p);
+  int rank = sched_rank(p);
+  if (rank < RT_PRIO_LEVELS) {
+    p->rq_rank = rank;
+    list_add_tail(&p->run_list, &target_cpu->rt_queues[rank]);
+    target_cpu->rt_bitmap |= 1u << rank;
+    hal_cpu_notify();
+    return;
+  }
+
+  int prio = rank - RT_PRIO_LEVELS;
   if (prio >= MAX_PRIO)
     prio = MAX_PRIO - 1;
 
+  p->rq_rank = RT_PRIO_LEVELS + prio;
   list_add_tail(&p->run_list, &target_cpu->runqueues[prio]);
   target_cpu->prio_bitmap |= (1 << prio);
 
@@ -232,11 +322,56 @@ void enqueue_task(struct process *p) {
 }
 
 /*
- * __dequeue_task - remove a process from its CPU's priority runqueue.
+ * __rq_del - remove a queued process from cpu c's RT or priority runqueue
+ * and clear the bitmap bit if that queue becomes empty.
+ *
+ * Locking: caller must hold c->sched_lock.
+ */
+static void __rq_del(struct cpu_info *c, struct process *p) {
+  list_del_init(&p->run_list);
+  int r = p->rq_rank;
+  if (r < RT_PRIO_LEVELS) {
+    if (list_empty(&c->rt_queues[r]))
+      c->rt_bitmap &= ~(1u << r);
+  } else if (r - RT_PRIO_LEVELS < MAX_PRIO &&
+             list_empty(&c->runqueues[r - RT_PRIO_LEVELS])) {
+    c->prio_bitmap &= ~(1 << (r - RT_PRIO_LEVELS));
+  }
+}
+
+/* __rt_head / __prio_head - the task c would run next from its RT queues /
+ * its priority runqueues (lower index = higher priority), or NULL.  O(1):
+ * __builtin_ctz on the bitmap finds the highest non-empty queue.
+ * Caller holds c->sched_lock. */
+static struct process *__rt_head(struct cpu_info *c) {
+  if (!c->rt_bitmap)
+    return NULL;
+  struct list_head *q = &c->rt_queues[__builtin_ctz(c->rt_bitmap)];
+  return container_of(q->next, struct process, run_list);
+}
+
+static struct process *__prio_head(struct cpu_info *c) {
+  if (!c->prio_bitmap)
+    return NULL;
+  int best_prio = __builtin_ctz(c->prio_bitmap);
+  if (best_prio >= MAX_PRIO || list_empty(&c->runqueues[best_prio]))
+    return NULL;
+  return container_of(c->runqueues[best_prio].next, struct process, run_list);
+}
+
+/* rt_cpu_throttled - RT threads have had their RT_CPU_RUNTIME of this CPU's
+ * current window.  Caller holds c->sched_lock. */
+static int rt_cpu_throttled(struct cpu_info *c) {
+  return c->rt_window == jiffies / RT_CPU_PERIOD &&
+         c->rt_used >= RT_CPU_RUNTIME;
+}
+
+/*
+ * __dequeue_task - remove a process from its CPU's runqueue.
  *
- * Caller MUST hold the target CPU's sched_lock.  Calls list_del_init() on
- * p->run_list and clears the prio_bitmap bit if the queue becomes empty.
- * Panics on a NULL run_list pointer (corruption guard, see SCHED-02).
+ * Caller MUST hold the target CPU's sched_lock.  Unlinks p->run_list via
+ * __rq_del().  Panics on a NULL run_list pointer (corruption guard, see
+ * SCHED-02).
  *
  * Locking: caller must hold target_cpu->sched_lock.
  */
@@ -250,10 +385,7 @@ static void __dequeue_task(struct process *p) {
     panic("SCHED: Corrupt run_list for PID %d", p->pid);
   }
 
-  list_del_init(&p->run_list);
-  if (p->priority < MAX_PRIO && list_empty(&target->runqueues[p->priority])) {
-    target->prio_bitmap &= ~(1 << p->priority);
-  }
+  __rq_del(target, p);
 }
 
 /*
@@ -350,6 +482,11 @@ void wake_up(struct wait_queue_head *wq) {
 /* Idle Task Entry Point */
 void idle_task_entry(void) {
   while (1) {
+    /* Idle is an RCU quiescent state. */
+    uint64_t flags;
+    hal_irq_save(&flags);
+    rcu_note_qs(get_cpu_info());
+    hal_irq_restore(flags);
     /* Wait for interrupt */
     hal_cpu_idle();
     /* When we wake up, check if we need to reschedule?
@@ -399,8 +536,22 @@ void process_init(void) {
       INIT_LIST_HEAD(&cpu_data[c].runqueues[i]);
     }
     cpu_data[c].prio_bitmap = 0;
+    for (int i = 0; i < RT_PRIO_LEVELS; i++)
+      INIT_LIST_HEAD(&cpu_data[c].rt_queues[i]);
+    cpu_data[c].rt_bitmap = 0;
     spin_lock_init(&cpu_data[c].sched_lock);
   }
+
+  futex_init();
+  endpoint_init();
+  event_init();
+  ntfn_init();
+  pipe_init();
+}
+
+/* process_free_rcu - release a descriptor once no pool reader can hold it. */
+static void process_free_rcu(struct rcu_head *head) {
+  pmm_free_page(container_of(head, struct process, rcu));
 }
 
 /*
@@ -420,13 +571,16 @@ static int find_free_slot(void) {
 /*
  * __process_find_by_pid - find a process by PID without locking (internal).
  *
- * Caller MUST hold sched_lock to prevent concurrent pool modification.
- * Returns the matching process or NULL.  O(MAX_PROCESSES) linear scan.
+ * Caller MUST hold sched_lock (the pool cannot change) or be inside
+ * rcu_read_lock (the result stays allocated until rcu_read_unlock, but may
+ * be dying).  Returns the matching process or NULL.  O(MAX_PROCESSES)
+ * linear scan.
  */
 struct process *__process_find_by_pid(int pid) {
   for (int i = 0; i < MAX_PROCESSES; i++) {
-    if (process_pool[i] && (int)process_pool[i]->pid == pid)
-      return process_pool[i];
+    struct process *p = rcu_dereference(process_pool[i]);
+    if (p && (int)p->pid == pid)
+      return p;
   }
   return NULL;
 }
@@ -434,28 +588,29 @@ struct process *__process_find_by_pid(int pid) {
 /*
  * process_find_by_pid - find a process by PID with locking (external).
  *
- * Acquires sched_lock (irqsave), calls __process_find_by_pid(), releases.
  * Returns the matching process or NULL.  The returned pointer is only valid
  * as long as the caller can guarantee the process is not terminated.
  *
- * Locking: acquires/releases sched_lock internally.
+ * Locking: none; an RCU read section around the scan.
  */
 struct process *process_find_by_pid(int pid) {
   uint64_t flags;
-  spin_lock_irqsave(&sched_lock, &flags);
+  rcu_read_lock(&flags);
   struct process *proc = __process_find_by_pid(pid);
-  spin_unlock_irqrestore(&sched_lock, flags);
+  rcu_read_unlock(flags);
   return proc;
 }
 
 /*
  * process_kill_allowed - ABI-04 capability check for SYS_KILL.
  *
- * Policy (checked under sched_lock so the target cannot be recycled
- * mid-decision):
+ * Policy (checked in an RCU read section, without sched_lock; PIDs are
+ * never reused, so a link that changes mid-walk can only be reparenting to
+ * an older ancestor):
  *   - privileged callers (machine/root) may kill anything
  *     (process_terminate itself still refuses machine targets);
- *   - any process may kill itself (exit alias) and its DESCENDANTS — the
+ *   - any process may kill itself (exit alias), its own threads, and its
+ *     DESCENDANTS — the
  *     parent chain is walked, so grandchildren count too.  A dead link in
  *     the chain cannot hide a descendant: __reparent_children() re-homes
  *     orphans to the nearest live ancestor at reap time (the shell can
@@ -473,9 +628,9 @@ int process_kill_allowed(struct process *caller, int target_pid) {
     return 1;
 
   uint64_t flags;
-  spin_lock_irqsave(&sched_lock, &flags);
+  rcu_read_lock(&flags);
   struct process *target = __process_find_by_pid(target_pid);
-  int allowed = !target;
+  int allowed = !target || target->tgid == caller->tgid; /* own threads */
   /* Ancestry walk: a parent always has an older (smaller) PID, so the chain
    * is acyclic and strictly decreasing; the depth bound is belt-and-braces. */
   for (int depth = 0; target && depth < MAX_PROCESSES; depth++) {
@@ -487,15 +642,16 @@ int process_kill_allowed(struct process *caller, int target_pid) {
       break;
     target = __process_find_by_pid(target->parent_pid);
   }
-  spin_unlock_irqrestore(&sched_lock, flags);
+  rcu_read_unlock(flags);
   return allowed;
 }
 
 /*
  * process_ipc_allowed - may 'caller' send IPC to target_pid without
- * CAP_IPC_ANY?  Allowed to the caller's parent or any descendant; the
+ * CAP_IPC_ANY?  Allowed to the caller's parent, its own threads, or any
+ * descendant; the
  * descendant test reuses the acyclic ancestry walk (parent PID < child PID).
- * Acquires sched_lock internally; callers must NOT already hold it.
+ * Lockless (RCU read section); callers may hold sched_lock or not.
  */
 int process_ipc_allowed(struct process *caller, int target_pid) {
   if (proc_has_cap(caller, CAP_IPC_ANY))
@@ -506,9 +662,9 @@ int process_ipc_allowed(struct process *caller, int target_pid) {
     return 1; /* to parent */
 
   uint64_t flags;
-  spin_lock_irqsave(&sched_lock, &flags);
+  rcu_read_lock(&flags);
   struct process *t = __process_find_by_pid(target_pid);
-  int allowed = 0;
+  int allowed = t && t->tgid == caller->tgid; /* sibling thread */
   for (int depth = 0; t && depth < MAX_PROCESSES; depth++) {
     if (t->parent_pid == (int)caller->pid) {
       allowed = 1;
@@ -518,7 +674,7 @@ int process_ipc_allowed(struct process *caller, int target_pid) {
       break;
     t = __process_find_by_pid(t->parent_pid);
   }
-  spin_unlock_irqrestore(&sched_lock, flags);
+  rcu_read_unlock(flags);
   return allowed;
 }
 
@@ -526,16 +682,478 @@ int process_ipc_allowed(struct process *caller, int target_pid) {
  * process_fd_init - reset the fd table and pre-open the standard trio
  * (ABI-03, kernel/fd.h): fd 0 = keyboard stdin, fd 1/2 = the process's own
  * compositor window (win_id -1, resolved by PID at write time because the
- * window is usually created after spawn).  Entries hold no kernel-owned
- * resources, so there is no matching teardown pass.
+ * window is usually created after spawn).  None of these hold a kernel
+ * object; pipe ends opened later are closed by process_fd_release().
+ */
+void process_fd_init(struct proc_space *space) {
+  memset(space->fds, 0, sizeof(space->fds));
+  space->fds[0].type = FD_KBD;
+  space->fds[1].type = FD_WIN;
+  space->fds[1].win_id = -1;
+  space->fds[2].type = FD_WIN;
+  space->fds[2].win_id = -1;
+}
+
+/*
+ * process_fd_inherit - seed a new process's table from its spawner's
+ * (spawn_fds, kernel/fd.h).  Entries are copied by value: a pipe end gains
+ * a holder, a file fd gets an independent offset.  The child has not run,
+ * so only the parent's table needs its lock.
+ */
+void process_fd_inherit(struct proc_space *child, struct proc_space *parent,
+                        const int *map, int n) {
+  uint64_t flags;
+  spin_lock_irqsave(&parent->fd_lock, &flags);
+  for (int i = 0; i < n && i < NPROC_FDS; i++) {
+    if (map[i] < 0 || map[i] >= NPROC_FDS)
+      continue;
+    const struct fd_entry *src = &parent->fds[map[i]];
+    if (src->type == FD_NONE)
+      continue; /* closed by a sibling since spawn_fds checked it */
+    child->fds[i] = *src;
+    if (src->type == FD_PIPE)
+      pipe_open_end(src->pipe, (src->mode & FD_MODE_WRITE) != 0);
+  }
+  spin_unlock_irqrestore(&parent->fd_lock, flags);
+}
+
+/* process_fd_release - no thread is left to race with, so no fd_lock. */
+void process_fd_release(struct proc_space *space) {
+  for (int i = 0; i < NPROC_FDS; i++) {
+    struct fd_entry *e = &space->fds[i];
+    if (e->type == FD_PIPE)
+      pipe_close_end(e->pipe, (e->mode & FD_MODE_WRITE) != 0);
+    e->type = FD_NONE;
+  }
+}
+
+/*
+ * space_alloc - create the proc_space of a new process: fresh PGD, cwd
+ * inherited from the creator (POSIX; kernel/boot creations start at "/"),
+ * standard fd trio, one user.  Returns NULL on allocation failure.
+ */
+static struct proc_space *space_alloc(struct process *creator, int tgid) {
+  struct proc_space *space = kmalloc(sizeof(*space));
+  if (!space)
+    return NULL;
+  memset(space, 0, sizeof(*space));
+  space->page_table = vmm_create_pgd();
+  if (!space->page_table) {
+    kfree(space);
+    return NULL;
+  }
+  spin_lock_init(&space->mm_lock);
+  spin_lock_init(&space->fd_lock);
+  spin_lock_init(&space->thread_lock);
+  spin_lock_init(&space->handle_lock);
+  space->users = 1;
+  space->nthreads = 1;
+  space->tgid = tgid;
+
+  /* A child inherits the spawner's working directory, so `kilo init.cfg`
+   * launched from /etc opens /etc/init.cfg and not /init.cfg. */
+  if (creator && creator->space && creator->space->cwd[0])
+    strncpy(space->cwd, creator->space->cwd, sizeof(space->cwd));
+  else
+    strncpy(space->cwd, "/", sizeof(space->cwd));
+  space->cwd[sizeof(space->cwd) - 1] = '\0';
+  process_fd_init(space);
+  return space;
+}
+
+/*
+ * space_put - drop one thread's reference.  The last reference destroys the
+ * PGD and frees the space; by then no CPU can have the PGD loaded, because
+ * every thread using it has been switched away from (reaped or never run).
+ */
+static void space_put(struct proc_space *space) {
+  if (!space)
+    return;
+  uint64_t flags;
+  spin_lock_irqsave(&space->thread_lock, &flags);
+  int last = (--space->users == 0);
+  spin_unlock_irqrestore(&space->thread_lock, flags);
+  if (!last)
+    return;
+  process_fd_release(space);
+  endpoint_release_handles(space);
+  channel_release_space(space);
+  event_release_space(space);
+  ntfn_release_space(space);
+  uring_release_space(space);
+  if (space->page_table)
+    vmm_destroy_pgd(space->page_table);
+  kfree(space);
+}
+
+/*
+ * wake_sleeping_task - make a SLEEPING task runnable again.  A sleeper that
+ * set PROC_SLEEPING but has not switched away yet is still current_task on
+ * its CPU: only flip it back to RUNNING there — enqueueing it would let
+ * another CPU steal a task whose kernel stack is still in use.
+ *
+ * Locking: acquires the task's CPU sched_lock (plain spin_lock: IRQs must
+ * already be masked).  The caller keeps p alive — sched_lock, or the lock
+ * of a wait structure p's teardown must also take (futex buckets).
+ */
+void wake_sleeping_task(struct process *p) {
+  int t_id = (p->on_cpu >= 0) ? p->on_cpu : 0;
+  struct cpu_info *tc = &cpu_data[t_id];
+  spin_lock(&tc->sched_lock);
+  if (p->state == PROC_SLEEPING) {
+    if (tc->current_task == p) {
+      trace_event(TRACE_EV_WAKEUP, p->pid, t_id, trace_tid());
+      p->state = PROC_RUNNING;
+    } else {
+      __enqueue_task(p);
+    }
+  }
+  spin_unlock(&tc->sched_lock);
+}
+
+/*
+ * SCHED_RT bandwidth (include/api/sched.h).  rt_bw_total is the sum of the
+ * reservations of every SCHED_RT thread, in per mille of one CPU; admission
+ * control keeps it within RT_BW_ADMIT of each online CPU.  Protected by
+ * sched_lock, which also keeps the target of sched_setattr() alive.
+ */
+static int rt_bw_total = 0;
+
+static int rt_bw(int runtime, int period) {
+  return (runtime * 1000 + period - 1) / period;
+}
+
+static int rt_online_cpus(void) {
+  int n = 0;
+  for (int i = 0; i < MAX_CPUS; i++)
+    n += cpu_data[i].online ? 1 : 0;
+  return n ? n : 1;
+}
+
+/* rt_release - return a dying thread's reservation.  It is on no runqueue
+ * any more; caller holds no scheduler lock. */
+static void rt_release(struct process *p) {
+  uint64_t flags;
+  spin_lock_irqsave(&sched_lock, &flags);
+  if (p->policy == SCHED_RT) {
+    rt_bw_total -= rt_bw(p->rt_runtime, p->rt_period);
+    p->policy = SCHED_NORMAL;
+  }
+  spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+ * sched_tick - account the tick that just ended.  The running thread is
+ * charged one tick of its SCHED_RT budget if it ran in the RT class (a
+ * throttled thread runs from the normal queues with rt_budget 0).  This
+ * CPU's RT window, which rt_cpu_throttled() checks at the pick, is charged
+ * for any thread running at an RT rank, so a server lent one by an RT
+ * client counts too.  The next enqueue of a thread whose budget hit 0
+ * puts it on its normal queue; a thread still running when its period
+ * ends gets the new budget here rather than at that enqueue.
+ *
+ * Locking: takes this CPU's sched_lock; IRQs are masked (timer IRQ).
+ */
+void sched_tick(void) {
+  struct cpu_info *cpu = get_cpu_info();
+  uint64_t window = jiffies / RT_CPU_PERIOD;
+  spin_lock(&cpu->sched_lock);
+  if (cpu->rt_window != window) {
+    cpu->rt_window = window;
+    cpu->rt_used = 0;
+  }
+  struct process *p = cpu->current_task;
+  if (p && p->state == PROC_RUNNING)
+    rt_replenish(p);
+  if (p && p->state == PROC_RUNNING && sched_rank(p) < RT_PRIO_LEVELS) {
+    cpu->rt_used++;
+    if (p->policy == SCHED_RT && p->rt_budget > 0)
+      p->rt_budget--;
+  }
+  spin_unlock(&cpu->sched_lock);
+}
+
+/*
+ * sched_setattr - move thread pid (0 = current) into attr's class.
+ *
+ * Entering SCHED_RT needs root or machine level and passes admission
+ * control (-EBUSY); a queued thread is moved to the queue of its new class
+ * at once, a running one at its next schedule().  The reservation starts
+ * with a full budget.
+ *
+ * Locking: sched_lock -> the target CPU's sched_lock.
+ */
+long sched_setattr(int pid, const struct sched_attr *attr) {
+  struct process *self = current_process;
+  int policy = (int)attr->policy, prio = 0, runtime = 0, period = 0, bw = 0;
+  if (policy == SCHED_RT) {
+    if (!proc_is_privileged(self))
+      return -EPERM;
+    if (attr->rt_prio >= RT_PRIO_LEVELS || attr->runtime_ms == 0 ||
+        attr->runtime_ms > attr->period_ms || attr->period_ms < 1000 / HZ ||
+        attr->period_ms > 10000)
+      return -EINVAL;
+    prio = (int)attr->rt_prio;
+    runtime = (int)(((uint64_t)attr->runtime_ms * HZ + 999) / 1000);
+    period = (int)((uint64_t)attr->period_ms * HZ / 1000);
+    if (runtime > period)
+      runtime = period;
+    bw = rt_bw(runtime, period);
+  } else if (policy != SCHED_NORMAL) {
+    return -EINVAL;
+  }
+  if (pid && !process_kill_allowed(self, pid))
+    return -EPERM;
+
+  long rc = 0;
+  uint64_t flags;
+  spin_lock_irqsave(&sched_lock, &flags);
+  struct process *p = pid ? __process_find_by_pid(pid) : self;
+  if (!p || p->state == PROC_DEAD || p->state == PROC_ZOMBIE ||
+      p->priority == PROC_PRIO_IDLE) {
+    rc = -ESRCH;
+    goto out;
+  }
+  int old = p->policy == SCHED_RT ? rt_bw(p->rt_runtime, p->rt_period) : 0;
+  if (rt_bw_total - old + bw > rt_online_cpus() * RT_BW_ADMIT) {
+    rc = -EBUSY;
+    goto out;
+  }
+  rt_bw_total += bw - old;
+
+  struct cpu_info *c = &cpu_data[p->on_cpu >= 0 ? p->on_cpu : 0];
+  spin_lock(&c->sched_lock);
+  int queued = p->state == PROC_READY && p->run_list.next != &p->run_list;
+  if (queued)
+    __dequeue_task(p);
+  p->policy = policy;
+  p->rt_prio = prio;
+  p->rt_runtime = runtime;
+  p->rt_period = period;
+  p->rt_budget = runtime;
+  p->rt_period_end = jiffies + (uint64_t)period;
+  if (queued)
+    __enqueue_task(p);
+  spin_unlock(&c->sched_lock);
+out:
+  spin_unlock_irqrestore(&sched_lock, flags);
+  return rc;
+}
+
+/* sched_getattr - thread pid's (0 = current) class and reservation. */
+long sched_getattr(int pid, struct sched_attr *attr) {
+  uint64_t flags;
+  spin_lock_irqsave(&sched_lock, &flags);
+  struct process *p = pid ? __process_find_by_pid(pid) : current_process;
+  if (!p) {
+    spin_unlock_irqrestore(&sched_lock, flags);
+    return -ESRCH;
+  }
+  attr->policy = (uint32_t)p->policy;
+  attr->rt_prio = (uint32_t)p->rt_prio;
+  attr->runtime_ms = (uint32_t)(p->rt_runtime * 1000 / HZ);
+  attr->period_ms = (uint32_t)(p->rt_period * 1000 / HZ);
+  spin_unlock_irqrestore(&sched_lock, flags);
+  return 0;
+}
+
+/* ------------------------------------------------------------------ */
+/* Priority inheritance                                                */
+/* ------------------------------------------------------------------ */
+
+/* __pi_target - the thread q is blocked on and lends its rank to: the
+ * server of a SYS_CALL awaiting its reply, the sender named by a
+ * source-filtered receive, or the holder named by a FUTEX_WAIT_PI.  0 if q
+ * is not blocked on a particular thread.  futex.state is owned by the
+ * bucket lock; a stale read only delays a boost or a settle.
+ * Caller holds sched_lock. */
+static int __pi_target(const struct process *q) {
+  if (q->state != PROC_SLEEPING)
+    return 0;
+  if (q->pi_donee > 0 && q->futex.state == FUTEX_W_QUEUED)
+    return q->pi_donee;
+  if ((q->ipc_wait == IPC_WAIT_REPLY || q->ipc_wait == IPC_WAIT_QUEUE) &&
+      q->ipc_target_pid > 0)
+    return q->ipc_target_pid;
+  return 0;
+}
+
+/* __pi_set - give p the inherited rank (PI_NONE: none), moving it to its
+ * new runqueue if it is queued.  Caller holds sched_lock. */
+static void __pi_set(struct process *p, int rank) {
+  if (p->pi_rank == rank)
+    return;
+  struct cpu_info *c = &cpu_data[p->on_cpu >= 0 ? p->on_cpu : 0];
+  spin_lock(&c->sched_lock);
+  int queued = p->state == PROC_READY && p->run_list.next != &p->run_list;
+  if (queued)
+    __dequeue_task(p);
+  p->pi_rank = rank;
+  if (queued)
+    __enqueue_task(p);
+  spin_unlock(&c->sched_lock);
+}
+
+void pi_boost(int tid, int futex) {
+  struct process *self = current_process;
+  uint64_t flags;
+  spin_lock_irqsave(&sched_lock, &flags);
+  struct process *p = __process_find_by_pid(tid);
+  if (futex && p && p != self && p->tgid == self->tgid)
+    self->pi_donee = tid;
+  /* A reply or wake that beat us here leaves nothing to lend. */
+  if (__pi_target(self) == tid) {
+    int rank = sched_rank(self);
+    for (int depth = 0; p && p != self && depth < PI_CHAIN_MAX; depth++) {
+      if (p->state == PROC_DEAD || p->state == PROC_ZOMBIE ||
+          sched_rank(p) <= rank)
+        break;
+      __pi_set(p, rank);
+      /* Transitive: p blocked on a third thread passes the rank along. */
+      int next = __pi_target(p);
+      p = next ? __process_find_by_pid(next) : NULL;
+    }
+  }
+  spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/* __pi_settle - body of pi_settle().  Caller holds sched_lock. */
+static void __pi_settle(struct process *p) {
+  int best = PI_NONE;
+  for (int i = 0; i < MAX_PROCESSES; i++) {
+    struct process *q = process_pool[i];
+    if (q && q != p && __pi_target(q) == (int)p->pid) {
+      int r = sched_rank(q);
+      if (r < best)
+        best = r;
+    }
+  }
+  __pi_set(p, best);
+}
+
+void pi_settle(struct process *p) {
+  if (p->pi_rank == PI_NONE)
+    return;
+  uint64_t flags;
+  spin_lock_irqsave(&sched_lock, &flags);
+  __pi_settle(p);
+  spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/* __pi_withdraw - body of pi_withdraw().  Caller holds sched_lock. */
+static void __pi_withdraw(int tid) {
+  struct process *p = tid > 0 ? __process_find_by_pid(tid) : NULL;
+  if (p && p->pi_rank != PI_NONE)
+    __pi_settle(p);
+}
+
+void pi_withdraw(int tid) {
+  if (tid <= 0)
+    return;
+  uint64_t flags;
+  spin_lock_irqsave(&sched_lock, &flags);
+  __pi_withdraw(tid);
+  spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/*
+ * thread_note_exit - record a non-leader thread's exit code for
+ * sys_thread_join and wake any sibling already sleeping on it.  Idempotent:
+ * the first code wins, so the teardown path's -1 never overwrites the value
+ * passed to SYS_THREAD_EXIT.  Must be called without sched_lock held.
  */
-void process_fd_init(struct process *proc) {
-  memset(proc->fds, 0, sizeof(proc->fds));
-  proc->fds[0].type = FD_KBD;
-  proc->fds[1].type = FD_WIN;
-  proc->fds[1].win_id = -1;
-  proc->fds[2].type = FD_WIN;
-  proc->fds[2].win_id = -1;
+static void thread_note_exit(struct process *p, int code) {
+  struct proc_space *space = p->space;
+  if (!space || (int)p->pid == p->tgid)
+    return;
+
+  uint64_t flags;
+  spin_lock_irqsave(&space->thread_lock, &flags);
+  int woke = 0;
+  for (int i = 0; i < MAX_THREADS_PER_PROC; i++) {
+    struct thread_rec *r = &space->threads[i];
+    if (r->tid == (int)p->pid && !r->exited) {
+      r->exited = 1;
+      r->exit_code = code;
+      woke = 1;
+      break;
+    }
+  }
+  spin_unlock_irqrestore(&space->thread_lock, flags);
+  if (!woke)
+    return;
+
+  spin_lock_irqsave(&sched_lock, &flags);
+  for (int i = 0; i < MAX_PROCESSES; i++) {
+    struct process *q = process_pool[i];
+    if (q && q != p && q->space == space && q->join_tid == (int)p->pid)
+      wake_sleeping_task(q);
+  }
+  spin_unlock_irqrestore(&sched_lock, flags);
+}
+
+/* thread_release - the space-side half of freeing a thread descriptor:
+ * leave any futex queue, publish its exit to joiners (if SYS_THREAD_EXIT
+ * did not already), drop it from the live-thread count and release its
+ * space reference. */
+static void thread_release(struct process *p) {
+  futex_release(p);
+  event_release(p);
+  rt_release(p);
+  struct proc_space *space = p->space;
+  if (!space)
+    return;
+  thread_note_exit(p, -1);
+  uint64_t flags;
+  spin_lock_irqsave(&space->thread_lock, &flags);
+  space->nthreads--;
+  spin_unlock_irqrestore(&space->thread_lock, flags);
+  p->space = NULL;
+  space_put(space);
+}
+
+/*
+ * wait_queue_block - park the current task on wq until wait_queue_wake():
+ * queue it, mark it SLEEPING and arm a syscall retry, so the woken task
+ * re-evaluates its wait condition from scratch.  The caller holds the lock
+ * that makes the condition stable against the waker, with IRQs masked,
+ * and must then return to the dispatcher, which calls schedule() without
+ * writing the return register.
+ */
+void wait_queue_block(struct wait_queue_head *wq) {
+  struct process *self = current_process;
+  spin_lock(&wq->lock);
+  self->wait_queue_ptr = wq;
+  list_add_tail(&self->run_list, &wq->task_list);
+  struct cpu_info *cpu = get_cpu_info();
+  spin_lock(&cpu->sched_lock);
+  self->state = PROC_SLEEPING;
+  spin_unlock(&cpu->sched_lock);
+  spin_unlock(&wq->lock);
+  pt_regs_retry_syscall(self->context);
+}
+
+/*
+ * wait_queue_wake - wake one, or all, tasks parked by wait_queue_block().
+ * Unlike wake_up() it copes with a sleeper that has not switched away yet
+ * (wake_sleeping_task).  The unlink and the wake happen under wq->lock, so
+ * a concurrent process_terminate_thread() of the sleeper (which detaches
+ * wait_queue_ptr under the same lock) cannot race with the wake.
+ *
+ * Locking: IRQs masked; takes wq->lock, then the sleeper's cpu->sched_lock.
+ */
+void wait_queue_wake(struct wait_queue_head *wq, int all) {
+  spin_lock(&wq->lock);
+  while (!list_empty(&wq->task_list)) {
+    struct process *s =
+        list_entry(wq->task_list.next, struct process, run_list);
+    list_del_init(&s->run_list);
+    s->wait_queue_ptr = NULL;
+    wake_sleeping_task(s);
+    if (!all)
+      break;
+  }
+  spin_unlock(&wq->lock);
 }
 
 /*
@@ -543,11 +1161,12 @@ void process_fd_init(struct process *proc) {
  *
  * Allocates a single PMM page for the struct process, assigns a PID from
  * next_pid, allocates STACK_SIZE bytes for the kernel stack, creates a new
- * page table (vmm_create_pgd()), and initialises all scheduler / IPC fields.
+ * proc_space (page table via vmm_create_pgd(), cwd, fd table), and
+ * initialises all scheduler / IPC fields.
  * The process is added to process_pool[] in state PROC_CREATED; the caller
  * must call process_load_elf() and enqueue_task() to make it runnable.
  *
- * On failure, partially-allocated resources (PGD, kernel stack, pool slot)
+ * On failure, partially-allocated resources (space, kernel stack, pool slot)
  * are freed and NULL is returned.
  *
  * Locking: holds sched_lock (irqsave) while modifying process_pool[] and
@@ -577,8 +1196,26 @@ struct process *process_create(const char *name, uint8_t priority,
   return process_create_caps(name, priority, lvl, level_ceiling[lvl]);
 }
 
+static struct process *process_alloc(const char *name, uint8_t priority,
+                                     uint8_t level, uint32_t req_caps,
+                                     struct proc_space *shared);
+
 struct process *process_create_caps(const char *name, uint8_t priority,
                                     uint8_t level, uint32_t req_caps) {
+  return process_alloc(name, priority, level, req_caps, NULL);
+}
+
+/*
+ * process_alloc - common body of process_create_caps() and
+ * sys_thread_create().  shared == NULL creates a new process with its own
+ * proc_space; otherwise the descriptor is a new thread of the creator's
+ * process and takes a reference on 'shared' (the caller has already
+ * reserved its slot in shared->threads).  Threads are charged to the global
+ * limits but not to the creator's child quota, which counts processes.
+ */
+static struct process *process_alloc(const char *name, uint8_t priority,
+                                     uint8_t level, uint32_t req_caps,
+                                     struct proc_space *shared) {
   pr_info("Process: Creating '%s' (Prio=%d)\n", name, priority);
   uint64_t flags;
   spin_lock_irqsave(&sched_lock, &flags);
@@ -598,7 +1235,7 @@ struct process *process_create_caps(const char *name, uint8_t priority,
     return NULL;
   }
   if (!privileged) {
-    if (creator->child_count >= MAX_PROCS_PER_PARENT) {
+    if (!shared && creator->child_count >= MAX_PROCS_PER_PARENT) {
       spin_unlock_irqrestore(&sched_lock, flags);
       pr_debug("Process: PID %d hit the %d-children quota, refusing '%s'\n",
                creator->pid, MAX_PROCS_PER_PARENT, name);
@@ -629,8 +1266,9 @@ struct process *process_create_caps(const char *name, uint8_t priority,
   strncpy(proc->name, name, 15);
   proc->name[15] = '\0';
 
-  /* Assign unique PID */
+  /* Assign unique PID (the thread id); a new process leads its own group */
   proc->pid = next_pid++;
+  proc->tgid = shared ? shared->tgid : (int)proc->pid;
 
   /* Priority normalization */
   if (priority >= MAX_PRIO)
@@ -653,37 +1291,33 @@ struct process *process_create_caps(const char *name, uint8_t priority,
     proc->caps = caps;
   }
   /* Parentage for the SYS_KILL capability check (ABI-04): the spawner is
-   * whatever process is current on this CPU; kernel/boot creations get 0. */
-  proc->parent_pid = current_process ? (int)current_process->pid : 0;
+   * whatever process is current on this CPU; kernel/boot creations get 0.
+   * A thread's parent is its group leader. */
+  if (shared)
+    proc->parent_pid = shared->tgid;
+  else
+    proc->parent_pid = current_process ? (int)current_process->pid : 0;
 
   /* Init Scheduler Info */
   proc->state = PROC_CREATED;
   proc->first_run = 1; /* ELF loader will initialize context */
   proc->time_slice = DEFAULT_QUANTUM;
   proc->quantum_reset = DEFAULT_QUANTUM;
+  proc->pi_rank = PI_NONE;
   proc->on_cpu = -1;
+  proc->fpu_cpu = -1; /* no FP state loaded anywhere (kernel/fpu.h) */
   INIT_LIST_HEAD(&proc->wait_queue.task_list);
   spin_lock_init(&proc->wait_queue.lock);
   proc->ipc_target_pid = -1;
   INIT_LIST_HEAD(&proc->run_list);
-  INIT_LIST_HEAD(&proc->msg_queue);
+  INIT_LIST_HEAD(&proc->msg_space.task_list);
+  spin_lock_init(&proc->msg_space.lock);
   spin_lock_init(&proc->msg_lock);
-  spin_lock_init(&proc->mm_lock);
-
-  /* Filesystem Init: a child inherits the spawner's working directory
-   * (POSIX), so `kilo init.cfg` launched from /etc opens /etc/init.cfg and not
-   * /init.cfg.  Kernel/boot creations (no creator) start at "/". */
-  if (creator && creator->cwd[0])
-    strncpy(proc->cwd, creator->cwd, sizeof(proc->cwd));
-  else
-    strncpy(proc->cwd, "/", sizeof(proc->cwd));
-  proc->cwd[sizeof(proc->cwd) - 1] = '\0';
-  process_fd_init(proc);
 
-  /* Add to pool */
-  process_pool[slot] = proc;
+  /* Add to pool: publish only the fully initialised descriptor. */
+  rcu_assign_pointer(process_pool[slot], proc);
   active_count++;
-  if (creator)
+  if (creator && !shared)
     creator->child_count++; /* paired with __child_count_dec at release */
 
   spin_unlock_irqrestore(&sched_lock, flags);
@@ -699,20 +1333,34 @@ struct process *process_create_caps(const char *name, uint8_t priority,
   proc->ctty_win = -1;
   if (creator) {
     extern int compositor_get_window_by_pid(int pid);
-    int term = compositor_get_window_by_pid((int)creator->pid);
+    int term = compositor_get_window_by_pid(creator->tgid);
     proc->ctty_win = (term > 0) ? term : creator->ctty_win;
   }
 
-  proc->page_table = vmm_create_pgd();
+  /* Address space, cwd and fd table: shared with the creator for a thread,
+   * fresh (cwd inherited) for a new process. */
+  if (shared) {
+    spin_lock_irqsave(&shared->thread_lock, &flags);
+    shared->users++;
+    spin_unlock_irqrestore(&shared->thread_lock, flags);
+    proc->space = shared;
+  } else {
+    proc->space = space_alloc(creator, proc->tgid);
+  }
+  proc->page_table = proc->space ? proc->space->page_table : NULL;
 
   pr_info("process_create: '%s' PID=%u slot=%u Prio=%d PageTable=%p\n", name,
           (uint32_t)proc->pid, (uint32_t)slot, (int)proc->priority, (void*)proc->page_table);
 
-  /* Allocate and Setup Kernel Stack (16KB) */
-  void *kstack_base = pmm_alloc_pages(STACK_SIZE / 4096);
-  if (!kstack_base) {
-    /* Cleanup pgd and proc if failed */
-    vmm_destroy_pgd(proc->page_table);
+  /* Allocate and Setup Kernel Stack (16KB) and the IPC receive buffer.
+   * Until msg_ring is set, sends to this pid fail like sends to nobody. */
+  void *kstack_base = proc->space ? pmm_alloc_pages(STACK_SIZE / 4096) : NULL;
+  struct ipc_ring *ring = kstack_base ? ipc_ring_alloc(IPC_RING_DEFAULT) : NULL;
+  if (!ring) {
+    /* Cleanup space and proc if failed */
+    if (kstack_base)
+      pmm_free_pages(kstack_base, STACK_SIZE / 4096);
+    space_put(proc->space);
     /* Remove from pool since we are failing */
     spin_lock_irqsave(&sched_lock,
                       &flags); // Re-acquire lock to modify shared state
@@ -720,10 +1368,13 @@ struct process *process_create_caps(const char *name, uint8_t priority,
     active_count--;
     __child_count_dec(proc);
     spin_unlock_irqrestore(&sched_lock, flags); // Release lock
-    pmm_free_page(proc);
+    call_rcu(&proc->rcu, process_free_rcu);
     return NULL;
   }
   proc->kernel_stack = (uint64_t)kstack_base + STACK_SIZE;
+  spin_lock_irqsave(&proc->msg_lock, &flags);
+  proc->msg_ring = ring;
+  spin_unlock_irqrestore(&proc->msg_lock, flags);
 
   /* Initial frame on kernel stack */
   proc->context =
@@ -773,6 +1424,7 @@ void smp_create_idle_task(uint32_t cpu_id) {
      * leave the previous process's possibly-freed PGD active). */
     if (idle->page_table) {
       vmm_destroy_pgd(idle->page_table);
+      idle->space->page_table = NULL;
       idle->page_table = NULL;
     }
 
@@ -794,7 +1446,8 @@ void smp_create_idle_task(uint32_t cpu_id) {
 
 
 /*
- * process_terminate - remove a process from the scheduler and free resources.
+ * process_terminate_thread - remove one thread from the scheduler and free
+ * its resources.
  *
  * If the target process is currently executing on another CPU (proc->on_cpu
  * >= 0 and proc != current_process), it is marked PROC_DEAD and left in
@@ -831,7 +1484,7 @@ void smp_create_idle_task(uint32_t cpu_id) {
  *          the SYS_KILL dispatcher gate (process_kill_allowed) restricts a
  *          user process to itself and its descendants.
  */
-int process_terminate(int pid) {
+static int process_terminate_thread(int pid) {
   uint64_t flags;
   spin_lock_irqsave(&sched_lock, &flags);
 
@@ -865,6 +1518,29 @@ int process_terminate(int pid) {
   extern void compositor_destroy_windows_by_pid(int pid);
   compositor_destroy_windows_by_pid(pid);
 
+  /* A process (its leader) is going: tell a parent subscribed to
+   * NTFN_SYS_CHILD, which then reaps it with wait(). */
+  if ((int)proc->pid == proc->tgid && proc->parent_pid > 0) {
+    struct process *parent = __process_find_by_pid(proc->parent_pid);
+    if (parent)
+      ntfn_signal_sys(NTFN_SYS_CHILD, parent->tgid);
+  }
+
+  /* Unbind the victim from any endpoint it serves (its clients now wait
+   * for a respawned server), drop the buffered IPC messages (the victim
+   * will never read them) and release every sender blocked on its full
+   * ring: a retried pid send sees msg_closed and fails; an endpoint send
+   * waits for the rebind.  Held under msg_lock to serialise against a
+   * concurrent pop_message() on the victim's CPU and against lockless
+   * senders, which test msg_closed under it. */
+  endpoint_unbind(proc);
+  spin_lock(&proc->msg_lock);
+  proc->msg_closed = 1;
+  if (proc->msg_ring)
+    ipc_ring_clear(proc->msg_ring);
+  wait_queue_wake(&proc->msg_space, 1);
+  spin_unlock(&proc->msg_lock);
+
   /* Self-termination: we are standing on this process's kernel stack, so we
    * cannot free it now.  Mark ZOMBIE; the caller (sys_exit) MUST call
    * schedule() to switch away — schedule() then auto-reaps the zombie via
@@ -875,20 +1551,6 @@ int process_terminate(int pid) {
     return 0;
   }
 
-  /* Drain the incoming IPC queue (the victim will never read it).  Held under
-   * msg_lock to serialise against a concurrent pop_message() on the victim's
-   * CPU. */
-  {
-    struct list_head *pos, *q;
-    spin_lock(&proc->msg_lock);
-    list_for_each_safe(pos, q, &proc->msg_queue) {
-      struct ipc_node *node = list_entry(pos, struct ipc_node, list);
-      list_del(pos);
-      kfree(node);
-    }
-    spin_unlock(&proc->msg_lock);
-  }
-
   /*
    * SCHED-UAF-01: do NOT free a process that may still be executing on, or be
    * queued on, another CPU — that is the use-after-free that crashes window
@@ -896,8 +1558,8 @@ int process_terminate(int pid) {
    * provably no longer in use:
    *
    *   - On a wait queue: detach it (under wq->lock) and mark DEAD.  It is not
-   *     on a runqueue and (we hold the global sched_lock, which kernel_ipc_send
-   *     must also take) cannot be woken; left for the reaper.
+   *     on a runqueue and (msg_closed is set, so no IPC send reaches it)
+   *     cannot be woken; left for the reaper.
    *   - PROC_READY / PROC_RUNNING: mark DEAD under the OWNING CPU's sched_lock.
    *     That serialises with the CPU's schedule(), preventing both resurrection
    *     (re-enqueue) and a free-while-referenced.  A running victim is reaped
@@ -953,7 +1615,11 @@ int process_terminate(int pid) {
    * moved on, checked under that CPU's sched_lock) is freed immediately;
    * immediate freeing also means the pool slot disappears right away, so
    * supervisors must treat process_wait()==-2 as "child gone". */
+  int donee = __pi_target(proc);
   proc->state = PROC_DEAD;
+  /* A dead donor lends nothing: its target drops the boost now rather
+   * than when it next receives or unlocks. */
+  __pi_withdraw(donee);
   {
     int vcpu = (proc->on_cpu >= 0) ? proc->on_cpu : 0;
     struct cpu_info *vc = &cpu_data[vcpu];
@@ -974,17 +1640,48 @@ int process_terminate(int pid) {
   }
   spin_unlock_irqrestore(&sched_lock, flags);
 
+  ipc_ring_free(proc->msg_ring);
+  proc->msg_ring = NULL;
   if (proc->kernel_stack) {
     pmm_free_pages((void *)(proc->kernel_stack - STACK_SIZE), STACK_SIZE / 4096);
   }
-  if (proc->page_table) {
-    vmm_destroy_pgd(proc->page_table);
-  }
-  pmm_free_page(proc);
+  thread_release(proc);
+  arch_fpu_release(proc);
+  call_rcu(&proc->rcu, process_free_rcu);
 
   return 0;
 }
 
+/*
+ * process_terminate - kill one thread, or a whole process.
+ *
+ * A group leader (pid == tgid) takes every sibling thread with it: they are
+ * collected under sched_lock and terminated first, so none can outlive the
+ * process it belongs to.  Killing a non-leader tid kills that thread only.
+ * Each thread goes through process_terminate_thread() above, so the
+ * running / parked / self cases apply per thread; the shared proc_space is
+ * freed when the last of them is released (space_put).
+ */
+int process_terminate(int pid) {
+  int tids[MAX_THREADS_PER_PROC];
+  int n = 0;
+  uint64_t flags;
+  spin_lock_irqsave(&sched_lock, &flags);
+  struct process *leader = __process_find_by_pid(pid);
+  if (leader && leader->tgid == pid && !proc_is_machine(leader)) {
+    for (int i = 0; i < MAX_PROCESSES && n < MAX_THREADS_PER_PROC; i++) {
+      struct process *t = process_pool[i];
+      if (t && t != leader && t->tgid == pid)
+        tids[n++] = (int)t->pid;
+    }
+  }
+  spin_unlock_irqrestore(&sched_lock, flags);
+
+  for (int i = 0; i < n; i++)
+    process_terminate_thread(tids[i]);
+  return process_terminate_thread(pid);
+}
+
 /*
  * start_user_process - directly enter a freshly-created user process.
  *
@@ -1016,6 +1713,22 @@ void start_user_process(struct process *proc) {
   arch_enter_user_mode(proc->user_entry, proc->user_stack, proc->kernel_stack);
 }
 
+/* trace_switch - record a context switch on this CPU (kernel/trace.h):
+ * prev (NULL once reaped) -> next, and next's migration if it was last
+ * queued on another CPU (stolen).  Called before next->on_cpu moves. */
+static void trace_switch(uint32_t prev_tid, const struct process *prev,
+                         int reaped, int handoff, const struct process *next,
+                         uint32_t cpu) {
+  int state = prev ? prev->state : PROC_ZOMBIE;
+  int reason = reaped                 ? TRACE_SW_EXIT
+               : handoff              ? TRACE_SW_HANDOFF
+               : state == PROC_SLEEPING ? TRACE_SW_BLOCK
+                                        : TRACE_SW_PREEMPT;
+  trace_event(TRACE_EV_SWITCH, prev_tid, next->pid, state | reason << 8);
+  if (next->on_cpu >= 0 && (uint32_t)next->on_cpu != cpu)
+    trace_event(TRACE_EV_MIGRATE, next->pid, next->on_cpu, cpu);
+}
+
 /*
  * schedule - select and switch to the next runnable process.
  *
@@ -1030,19 +1743,22 @@ void start_user_process(struct process *proc) {
  *     stack we were standing on.
  *  1. Save current context (regs) and re-enqueue prev if PROC_RUNNING;
  *     idle tasks are never re-enqueued (they are not on any runqueue).
- *  2. Focus boost (SCHED-01): call compositor_get_focus_pid() and search
+ *  2. SCHED_RT: the head of the highest non-empty RT queue, unless this
+ *     CPU's RT window is used up (rt_cpu_throttled).
+ *  3. Focus boost (SCHED-01): call compositor_get_focus_pid() and search
  *     all priority levels for the focused PID first.
- *  3. O(1) pick: __builtin_ctz(prio_bitmap) finds the lowest-numbered
- *     non-empty priority queue in one instruction; pop the head task.
- *  4. Work stealing: if local runqueue is empty, iterate over other CPUs
+ *  4. O(1) pick: __builtin_ctz(prio_bitmap) finds the lowest-numbered
+ *     non-empty priority queue in one instruction; pop the head task.  A
+ *     throttled RT queue runs only when every normal queue is empty.
+ *  5. Work stealing: if local runqueue is empty, iterate over other CPUs
  *     with spin_trylock (to avoid deadlock) and steal the highest-priority
- *     task.  Idle-priority tasks are never stolen (they own their CPU's
- *     kernel stack).
- *  5. Context switch: install next->page_table (if changed), call
+ *     task, RT first.  Idle-priority tasks are never stolen (they own their
+ *     CPU's kernel stack).
+ *  6. Context switch: install next->page_table (if changed), call
  *     arch_cpu_switch_context(next), and return next->context.
  *
  * Locking: acquires cpu_ptr->sched_lock (irqsave) for the duration of steps
- *          1-5; temporarily acquires other_cpu->sched_lock (trylock) during
+ *          1-6; temporarily acquires other_cpu->sched_lock (trylock) during
  *          work stealing; acquires sched_lock (irqsave) during deferred free.
  *          Releases all locks before returning.
  * IRQ contract (SCHED-IRQ-01): schedule() masks IRQs itself at entry and is
@@ -1077,6 +1793,9 @@ struct pt_regs *schedule(struct pt_regs *regs) {
     return regs;
   }
 
+  /* A context switch point is outside every RCU read section. */
+  rcu_note_qs(cpu_ptr);
+
   /* Deferred process free: the only safe point to release a kernel stack and
    * PGD that was still in use during the previous schedule() call.  By the
    * time we reach here on this CPU, we have already context-switched to a
@@ -1104,29 +1823,25 @@ struct pt_regs *schedule(struct pt_regs *regs) {
     }
     spin_unlock_irqrestore(&sched_lock, gflags);
 
-    /* Drain leftover IPC messages.  The external-terminate path drains the
-     * queue in process_terminate(), but a self-terminated zombie keeps any
-     * already-queued nodes.  No lock needed: kernel_ipc_send() refuses
-     * DEAD/ZOMBIE targets, so the queue is stable by the time we get here. */
-    {
-      struct list_head *pos, *q;
-      list_for_each_safe(pos, q, &to_free->msg_queue) {
-        struct ipc_node *node = list_entry(pos, struct ipc_node, list);
-        list_del(pos);
-        kfree(node);
-      }
-    }
+    /* Free the IPC ring.  No lock needed: process_terminate_thread() already
+     * emptied it, released its blocked senders and set msg_closed, which
+     * every sender checks under msg_lock, so nothing can reach it any more.
+     * The descriptor outlives lockless pool readers via call_rcu. */
+    ipc_ring_free(to_free->msg_ring);
+    to_free->msg_ring = NULL;
 
     if (to_free->kernel_stack)
       pmm_free_pages((void *)(to_free->kernel_stack - STACK_SIZE), STACK_SIZE / 4096);
-    if (to_free->page_table)
-      vmm_destroy_pgd(to_free->page_table);
-    pmm_free_page(to_free);
+    thread_release(to_free); /* last thread out destroys the PGD */
+    arch_fpu_release(to_free);
+    call_rcu(&to_free->rcu, process_free_rcu);
   }
 
   uint32_t cpu = cpu_ptr->cpu_id;
   struct process *prev = cpu_ptr->current_task;
   int prev_reaped = 0; /* set when prev is pushed on the reap list below */
+  uint32_t prev_tid = prev ? prev->pid : 0; /* prev may be reaped */
+  int handoff = 0;
   uint64_t flags;
 
   /* Use local lock for runqueue modifications */
@@ -1165,6 +1880,7 @@ struct pt_regs *schedule(struct pt_regs *regs) {
       if (regs) {
         prev->context = regs;
       }
+      arch_tls_save(prev);
 
       /* Clear first_run flag since it has now been scheduled and preempted/yielded */
       if (prev->first_run) {
@@ -1201,18 +1917,37 @@ pick_next:;
   /* 2. Pick Next Process (O(1) Priority-based Selection) */
   struct process *next = NULL;
 
+  /* IPC direct switch (SYS_CALL / SYS_REPLY_RECV): the partner this CPU
+   * just handed the message to runs next, bypassing focus boost and the
+   * runqueues — it is on none.  A partner killed in between is reaped like
+   * a picked corpse. */
+  if (cpu_ptr->ipc_handoff) {
+    next = cpu_ptr->ipc_handoff;
+    cpu_ptr->ipc_handoff = NULL;
+    if (next->state == PROC_READY) {
+      handoff = 1;
+      goto found;
+    }
+    if (next->state == PROC_DEAD)
+      reap_push(cpu_ptr, next);
+    next = NULL;
+  }
+
 pick_local_retry:
   next = NULL;
 
-  if (focus_pid > 0) {
+  /* SCHED_RT first, unless RT has had its share of this CPU's window. */
+  if (!rt_cpu_throttled(cpu_ptr))
+    next = __rt_head(cpu_ptr);
+
+  if (!next && focus_pid > 0) {
     for (int p = 0; p < MAX_PRIO; p++) {
       if (list_empty(&cpu_ptr->runqueues[p]))
         continue;
       struct process *it;
       list_for_each_entry(it, &cpu_ptr->runqueues[p], run_list) {
-        if ((int)it->pid == focus_pid) {
+        if (it->tgid == focus_pid) { /* any thread of the focused process */
           next = it;
-          __dequeue_task(next);
           break;
         }
       }
@@ -1221,18 +1956,14 @@ pick_local_retry:
     }
   }
 
-  if (!next && cpu_ptr->prio_bitmap != 0) {
-    /* O(1) pick: __builtin_ctz finds the index of the lowest set bit, which
-     * corresponds to the highest-priority non-empty queue (lower index = higher
-     * priority).  This is the core of the O(1) priority scheduler. */
-    int best_prio = __builtin_ctz(cpu_ptr->prio_bitmap);
-
-    if (best_prio < MAX_PRIO && !list_empty(&cpu_ptr->runqueues[best_prio])) {
-      struct list_head *entry = cpu_ptr->runqueues[best_prio].next;
-      next = container_of(entry, struct process, run_list);
-      __dequeue_task(next);
-    }
-  }
+  /* O(1) pick: the head of the highest-priority non-empty queue.  A
+   * throttled RT queue still runs when nothing else wants the CPU. */
+  if (!next)
+    next = __prio_head(cpu_ptr);
+  if (!next)
+    next = __rt_head(cpu_ptr);
+  if (next)
+    __dequeue_task(next);
 
   /* SCHED-UAF-01: a terminated process may still be sitting in a runqueue
    * (process_terminate() marks it DEAD without dequeuing).  Never run a corpse
@@ -1258,35 +1989,31 @@ found:
       /* Try to lock other CPU's runqueue */
       /* Use trylock to avoid deadlock potential */
       if (spin_trylock(&other_cpu->sched_lock)) {
-        if (other_cpu->prio_bitmap != 0) {
-          int p = __builtin_ctz(other_cpu->prio_bitmap);
-          if (!list_empty(&other_cpu->runqueues[p])) {
-            struct list_head *entry = other_cpu->runqueues[p].next;
-            next = container_of(entry, struct process, run_list);
-
-            /* Never steal idle-priority tasks — they are CPU-bound and share a
-             * kernel stack with their owner CPU. Check priority, not pointer,
-             * so this also catches any idle task that migrated via wake_up.
-             * SCHED-UAF-01: also never steal a terminated process — leave the
-             * corpse for its owner CPU to reap via the pick==DEAD path. */
-            if (next->priority == PROC_PRIO_IDLE || next->state == PROC_DEAD) {
-              next = NULL;
-              spin_unlock(&other_cpu->sched_lock);
-              continue;
-            }
-
-            /* Remove from other CPU */
-            list_del_init(&next->run_list);
-            if (list_empty(&other_cpu->runqueues[p])) {
-              other_cpu->prio_bitmap &= ~(1 << p);
-            }
-
-            /* Add to our local queue (or just run it directly) */
-            /* Running directly: set state, context switch. */
-            /* `next` is now found. We own it. */
+        /* RT work first: a CPU busy with one RT thread hands the next to
+         * an idle one instead of making it wait for a tick. */
+        next = __rt_head(other_cpu);
+        if (!next)
+          next = __prio_head(other_cpu);
+        if (next) {
+          /* Never steal idle-priority tasks — they are CPU-bound and share a
+           * kernel stack with their owner CPU. Check priority, not pointer,
+           * so this also catches any idle task that migrated via wake_up.
+           * SCHED-UAF-01: also never steal a terminated process — leave the
+           * corpse for its owner CPU to reap via the pick==DEAD path. */
+          if (next->priority == PROC_PRIO_IDLE || next->state == PROC_DEAD) {
+            next = NULL;
             spin_unlock(&other_cpu->sched_lock);
-            goto found;
+            continue;
           }
+
+          /* Remove from other CPU */
+          __rq_del(other_cpu, next);
+
+          /* Add to our local queue (or just run it directly) */
+          /* Running directly: set state, context switch. */
+          /* `next` is now found. We own it. */
+          spin_unlock(&other_cpu->sched_lock);
+          goto found;
         }
         spin_unlock(&other_cpu->sched_lock);
       }
@@ -1336,9 +2063,14 @@ found:
     return regs;
   }
 
+  if (trace_on_any((1 << TRACE_EV_SWITCH) | (1 << TRACE_EV_MIGRATE)))
+    trace_switch(prev_tid, prev, prev_reaped, handoff, next, cpu);
+
+  pmu_switch(prev_reaped ? NULL : prev);
   cpu_ptr->current_task = next;
   next->state = PROC_RUNNING;
   next->on_cpu = cpu;
+  __percpu_add(PCPU_CTX_SWITCHES, 1);
 
   /* Update Page Table (Hardware Context Switch) */
   if (next == NULL) {
@@ -1399,79 +2131,316 @@ int process_wait(int pid) {
   spin_unlock_irqrestore(&sched_lock, flags);
   return -2; /* Not found */
 }
+/* ipc_ntfn_pending - would a receive from src_pid see p's bound
+ * notification?  Only receive-from-any does (the kernel's "from" is 0, but
+ * a receive from 0 means input).  Caller holds p->msg_lock. */
+static int ipc_ntfn_pending(struct process *p, int src_pid) {
+  return src_pid == -1 && p->bound_ntfn &&
+         __atomic_load_n(&p->bound_ntfn->bits, __ATOMIC_SEQ_CST) != 0;
+}
+
+/* ipc_ntfn_take - turn p's pending notification bits into a message.
+ * Returns 1 if *out was filled.  Caller holds p->msg_lock. */
+static int ipc_ntfn_take(struct process *p, int src_pid,
+                         struct ipc_message *out) {
+  if (src_pid != -1 || !p->bound_ntfn)
+    return 0;
+  uint64_t bits = ntfn_take(p->bound_ntfn);
+  if (!bits)
+    return 0;
+  memset(out, 0, sizeof(*out));
+  out->from = 0;
+  out->type = IPC_TYPE_NOTIFICATION;
+  out->data1 = bits;
+  return 1;
+}
+
 /*
- * IPC Helper: Pop message matching src_pid (or -1 for any)
+ * IPC Helper: Pop message matching src_pid (or -1 for any) into *out.  The
+ * freed slot lets one blocked sender (if any) retry.  Pending bits of a
+ * bound notification come first: they are one coalesced word, so they
+ * cannot starve the ring, while a busy ring could starve them.
  */
-struct ipc_node *pop_message(struct process *proc, int src_pid) {
-  /* pr_err("pop_message: proc=%d src=%d\n", proc->pid, src_pid); */
+int pop_message(struct process *proc, int src_pid, struct ipc_message *out) {
   uint64_t flags;
-  struct ipc_node *node = NULL;
-  struct list_head *pos, *q;
+  int rc = -1;
 
   spin_lock_irqsave(&proc->msg_lock, &flags);
-  list_for_each_safe(pos, q, &proc->msg_queue) {
-    struct ipc_node *tmp = list_entry(pos, struct ipc_node, list);
-    if (src_pid == -1 || tmp->msg.from == (int)src_pid) {
-      list_del(pos);
-      node = tmp;
-      break;
-    }
+  if (ipc_ntfn_take(proc, src_pid, out)) {
+    rc = 0;
+  } else if (proc->msg_ring &&
+             ipc_ring_pop(proc->msg_ring, src_pid, out) == 0) {
+    rc = 0;
+    wait_queue_wake(&proc->msg_space, 0);
   }
   spin_unlock_irqrestore(&proc->msg_lock, flags);
-  return node;
+  return rc;
 }
 
 /*
  * IPC Implementation (Internal)
  */
-int kernel_ipc_send(int target_pid, struct ipc_message *msg) {
-  struct ipc_node *node = (struct ipc_node *)kmalloc(sizeof(struct ipc_node));
-  if (!node)
-    return -1;
+/*
+ * ipc_can_deliver - is t blocked in SYS_CALL / SYS_REPLY_RECV waiting for
+ * exactly this message?  A reply matches when it comes from the pid the
+ * caller called, or from any thread of that process (from_tgid).
+ * Caller holds t->msg_lock.
+ */
+static int ipc_can_deliver(struct process *t, const struct ipc_message *msg,
+                           int from_tgid) {
+  if (t->ipc_wait == IPC_WAIT_RECV)
+    return t->ipc_target_pid == -1 || t->ipc_target_pid == msg->from;
+  if (t->ipc_wait == IPC_WAIT_REPLY)
+    return t->ipc_target_pid == msg->from || t->ipc_target_pid == from_tgid;
+  return 0;
+}
 
-  memcpy(&node->msg, msg, sizeof(struct ipc_message));
+/*
+ * ipc_deliver - complete t's blocked SYS_CALL / SYS_REPLY_RECV with msg:
+ * copy it into t's buffer through the direct map (vmm_copy_to_pgd, no
+ * address-space switch) and write the syscall's return value into t's
+ * saved frame.  Returns 0, or -EFAULT if t's buffer went bad — t's call
+ * then fails with -EFAULT and the message is NOT consumed.  Either way t is
+ * no longer waiting; the caller wakes it.
+ *
+ * Locking: caller keeps t alive (RCU read section or sched_lock) and holds
+ * t->msg_lock with msg_closed clear; takes t->space->mm_lock
+ * (msg_lock -> mm_lock).
+ */
+static int ipc_deliver(struct process *t, const struct ipc_message *msg) {
+  int rc = -EFAULT;
+  struct proc_space *space = t->space;
+  if (space && space->page_table) {
+    spin_lock(&space->mm_lock);
+    if (vmm_copy_to_pgd(space->page_table, (uint64_t)t->ipc_msg, msg,
+                        sizeof(struct ipc_message)) == 0)
+      rc = 0;
+    spin_unlock(&space->mm_lock);
+  }
+  pt_regs_set_return(t->context, rc);
+  t->ipc_wait = IPC_WAIT_NONE;
+  return rc;
+}
+
+/*
+ * ipc_switch_to - wake t (SLEEPING in an IPC wait) so that the next
+ * schedule() on THIS CPU runs it directly, ahead of the runqueues, with the
+ * rest of the current task's time slice.  The current task must be about to
+ * block.  Falls back to an ordinary wake when t is still current on its old
+ * CPU (it set SLEEPING but has not switched away yet) or a handoff is
+ * already pending here.  Returns 1 if the direct switch was set up.
+ *
+ * t migrates to this CPU; its on_cpu changes under its old CPU's
+ * sched_lock, which is what process_terminate() re-validates against.
+ * Locking: IRQs masked; caller keeps t alive (RCU read section).
+ */
+static int ipc_switch_to(struct process *t) {
+  struct cpu_info *cpu = get_cpu_info();
+  int t_id = (t->on_cpu >= 0) ? t->on_cpu : 0;
+  struct cpu_info *tc = &cpu_data[t_id];
+  int direct = 0;
+
+  spin_lock(&tc->sched_lock);
+  if (t->state == PROC_SLEEPING) {
+    if (tc->current_task == t) {
+      trace_event(TRACE_EV_WAKEUP, t->pid, t_id, trace_tid());
+      t->state = PROC_RUNNING;
+    } else if (cpu->ipc_handoff || t->priority == PROC_PRIO_IDLE) {
+      __enqueue_task(t);
+    } else {
+      struct process *self = cpu->current_task;
+      trace_event(TRACE_EV_WAKEUP, t->pid, cpu->cpu_id, trace_tid());
+      if (t_id != (int)cpu->cpu_id)
+        trace_event(TRACE_EV_MIGRATE, t->pid, t_id, cpu->cpu_id);
+      t->state = PROC_READY;
+      t->on_cpu = (int)cpu->cpu_id;
+      if (self && self->time_slice > 0)
+        t->time_slice = self->time_slice;
+      cpu->ipc_handoff = t;
+      direct = 1;
+    }
+  }
+  spin_unlock(&tc->sched_lock);
+  return direct;
+}
 
+/*
+ * ipc_pin - a resolved send target, kept alive until ipc_unpin(): a pid
+ * lookup stays in an RCU read section (no lock; a dying target is refused
+ * under its msg_lock), an endpoint handle holds that endpoint's lock (the
+ * server is unbound under it before it can die).
+ */
+struct ipc_pin {
+  struct process *t;
+  struct endpoint *ep;
   uint64_t flags;
-  spin_lock_irqsave(&sched_lock, &flags);
+};
 
-  struct process *target = __process_find_by_pid(target_pid);
-  if (!target || target->state == PROC_DEAD || target->state == PROC_ZOMBIE) {
-    spin_unlock_irqrestore(&sched_lock, flags);
-    kfree(node);
+/* ipc_pin_target - pin target pid (handle < 0) or the server behind
+ * endpoint handle.  0, -1 (no such live pid), or endpoint_pin()'s error:
+ * -EBADF, -EAGAIN or IPC_SEND_RETRY (blocked until the endpoint is bound,
+ * 'block' only). */
+static long ipc_pin_target(struct ipc_pin *pin, int pid, int handle,
+                           int block) {
+  if (handle >= 0) {
+    long err = 0;
+    pin->t = endpoint_pin(handle, block, &pin->ep, &pin->flags, &err);
+    return pin->t ? 0 : err;
+  }
+  pin->ep = NULL;
+  rcu_read_lock(&pin->flags);
+  pin->t = __process_find_by_pid(pid);
+  if (!pin->t || pin->t->state == PROC_DEAD ||
+      pin->t->state == PROC_ZOMBIE) {
+    rcu_read_unlock(pin->flags);
     return -1;
   }
+  return 0;
+}
+
+static void ipc_unpin(struct ipc_pin *pin) {
+  if (pin->ep)
+    endpoint_unpin(pin->ep, pin->flags);
+  else
+    rcu_read_unlock(pin->flags);
+}
+
+/* ipc_send_locked flags */
+#define IPC_TX_BLOCK   1 /* sleep on a full ring instead of -EAGAIN */
+#define IPC_TX_HANDOFF 2 /* switch straight to a receiver in SYS_REPLY_RECV */
+
+/*
+ * ipc_send_locked - deliver msg to a pinned target: straight into its
+ * buffer when it is blocked in SYS_CALL / SYS_REPLY_RECV for it, otherwise
+ * into its msg_ring (no allocation either way).  When the ring is full and
+ * IPC_TX_BLOCK is set, the current task joins target->msg_space and
+ * IPC_SEND_RETRY is returned with the syscall retry armed; pop_message()
+ * wakes it when a slot frees up.  Otherwise a full ring fails with -EAGAIN.
+ *
+ * Returns -1 (as for an unknown pid) once the target has started dying.
+ * *donee is set to the thread the woken target was lending its rank to
+ * (0 if none); the caller passes it to pi_withdraw() once unpinned.
+ *
+ * Locking: target pinned (ipc_pin); takes target->msg_lock.
+ */
+static int ipc_send_locked(struct process *target, struct ipc_message *msg,
+                           int tx, int *donee) {
+  *donee = 0;
+  int from_tgid = msg->from;
+  if (current_process && (int)current_process->pid == msg->from)
+    from_tgid = current_process->tgid;
 
-  /* We must hold target->msg_lock while adding to its queue. 
-   * To avoid AB-BA deadlocks with sched_lock, we use trylock or 
-   * we ensure a fixed order: sched_lock -> target->msg_lock.
-   */
   spin_lock(&target->msg_lock);
-  list_add_tail(&node->list, &target->msg_queue);
-  
-  /* Check if target is waiting */
-  if (target->state == PROC_SLEEPING &&
-      (target->ipc_target_pid == -1 ||
-       target->ipc_target_pid == (int)msg->from)) {
-    
-    /* Wake target: transition state while holding sched_lock is safe */
-    target->state = PROC_READY;
-    
-    /* To enqueue, we need target CPU's sched_lock */
-    int t_id = (target->on_cpu >= 0) ? target->on_cpu : 0;
-    struct cpu_info *target_cpu = &cpu_data[t_id];
-    
-    spin_lock(&target_cpu->sched_lock);
-    __enqueue_task(target);
-    spin_unlock(&target_cpu->sched_lock);
+  if (target->msg_closed) {
+    spin_unlock(&target->msg_lock);
+    return -1;
   }
-  
+
+  /* Target blocked in SYS_REPLY_RECV / SYS_CALL for this message: hand
+   * it over directly — it never touches the ring. */
+  if (ipc_can_deliver(target, msg, from_tgid)) {
+    int server = target->ipc_wait == IPC_WAIT_RECV;
+    if (!server)
+      *donee = target->ipc_target_pid;
+    int rc = ipc_deliver(target, msg);
+    if (rc == 0 && server && (tx & IPC_TX_HANDOFF))
+      ipc_switch_to(target);
+    else
+      wake_sleeping_task(target);
+    if (rc == 0) {
+      spin_unlock(&target->msg_lock);
+      return 0;
+    }
+  }
+
+  int rc = target->msg_ring ? ipc_ring_push(target->msg_ring, msg) : -1;
+  if (rc == 0) {
+    /* Check if target is waiting */
+    if (target->state == PROC_SLEEPING &&
+        target->ipc_wait == IPC_WAIT_QUEUE &&
+        (target->ipc_target_pid == -1 ||
+         target->ipc_target_pid == (int)msg->from)) {
+      *donee = target->ipc_target_pid;
+      target->ipc_wait = IPC_WAIT_NONE;
+      wake_sleeping_task(target);
+    }
+    /* Read under msg_lock: a thread entering EV_WAIT publishes ev_set
+     * before its scan takes this lock, so the message is either seen by
+     * the scan or followed by this wake. */
+    if (target->ev_set)
+      event_wake(target->ev_set);
+  } else if (rc == -EAGAIN && (tx & IPC_TX_BLOCK) && current_process &&
+             current_process != target) {
+    /* Backpressure: sleep until the receiver frees a slot. */
+    wait_queue_block(&target->msg_space);
+    rc = IPC_SEND_RETRY;
+  }
+
   spin_unlock(&target->msg_lock);
-  spin_unlock_irqrestore(&sched_lock, flags);
-  
-  return 0;
+  return rc;
+}
+
+/* __ipc_send - pin target pid (or endpoint handle) and send msg to it. */
+static int __ipc_send(int target_pid, int handle, struct ipc_message *msg,
+                      int tx) {
+  struct ipc_pin pin;
+  long rc = ipc_pin_target(&pin, target_pid, handle, tx & IPC_TX_BLOCK);
+  if (rc != 0)
+    return (int)rc;
+  int donee;
+  rc = ipc_send_locked(pin.t, msg, tx, &donee);
+  ipc_unpin(&pin);
+  pi_withdraw(donee);
+  return (int)rc;
 }
 
-int sys_ipc_send(int target_pid, void *msg_ptr) {
+int ipc_has_message(struct process *p, int src_pid) {
+  uint64_t flags;
+  spin_lock_irqsave(&p->msg_lock, &flags);
+  int has = (p->msg_ring && ipc_ring_has(p->msg_ring, src_pid)) ||
+            ipc_ntfn_pending(p, src_pid);
+  spin_unlock_irqrestore(&p->msg_lock, flags);
+  return has;
+}
+
+void ipc_notify_thread(struct process *t) {
+  uint64_t flags;
+  spin_lock_irqsave(&t->msg_lock, &flags);
+  struct ipc_message m;
+  if (t->ipc_wait == IPC_WAIT_RECV && ipc_ntfn_take(t, -1, &m)) {
+    /* Blocked in SYS_REPLY_RECV: hand the bits over directly. */
+    if (ipc_deliver(t, &m) != 0)
+      __atomic_or_fetch(&t->bound_ntfn->bits, m.data1, __ATOMIC_SEQ_CST);
+    wake_sleeping_task(t);
+  } else if (t->state == PROC_SLEEPING && t->ipc_wait == IPC_WAIT_QUEUE &&
+             t->ipc_target_pid == -1) {
+    t->ipc_wait = IPC_WAIT_NONE;
+    wake_sleeping_task(t);
+  }
+  if (t->ev_set)
+    event_wake(t->ev_set);
+  spin_unlock_irqrestore(&t->msg_lock, flags);
+}
+
+int kernel_ipc_send(int target_pid, struct ipc_message *msg) {
+  return __ipc_send(target_pid, -1, msg, 0);
+}
+
+int kernel_ipc_ep_send(int h, struct ipc_message *msg, int *server_tgid) {
+  struct ipc_pin pin;
+  long rc = ipc_pin_target(&pin, -1, h, 0);
+  if (rc != 0)
+    return (int)rc;
+  /* Before the message is visible: its receiver may act on it at once. */
+  __atomic_store_n(server_tgid, pin.t->tgid, __ATOMIC_RELEASE);
+  int donee;
+  rc = ipc_send_locked(pin.t, msg, 0, &donee);
+  ipc_unpin(&pin);
+  pi_withdraw(donee);
+  return (int)rc;
+}
+
+int sys_ipc_send(int target_pid, void *msg_ptr, int flags) {
   struct ipc_message k_msg;
   if (vmm_copy_from_user(&k_msg, msg_ptr, sizeof(struct ipc_message)) != 0) {
     return -EINVAL;
@@ -1481,52 +2450,75 @@ int sys_ipc_send(int target_pid, void *msg_ptr) {
   if (!process_ipc_allowed(current_process, target_pid))
     return -EPERM;
   k_msg.from = current_process->pid;
-  return kernel_ipc_send(target_pid, &k_msg);
+  return __ipc_send(target_pid, -1, &k_msg,
+                    (flags & IPC_NONBLOCK) ? 0 : IPC_TX_BLOCK);
 }
 
-int sys_ipc_recv(int src_pid, void *msg_ptr) {
-  /* 1. Try to pop an existing message */
-  struct ipc_node *node = pop_message(current_process, src_pid);
-  if (node) {
-    if (vmm_copy_to_user(msg_ptr, &node->msg, sizeof(struct ipc_message)) != 0) {
-      /* Drop node and return error */
-      kfree(node);
-      return -EFAULT;
-    }
-    kfree(node);
-    return 0;
-  }
+/*
+ * sys_ipc_ep_send - EP_SEND: send through endpoint handle h.  The handle is
+ * the capability, so there is no process_ipc_allowed() walk and no pid
+ * lookup: handle table -> endpoint -> bound server, under per-process and
+ * per-endpoint locks only.  While the service is unbound (not started yet,
+ * or being respawned) the sender blocks until it binds, or gets -EAGAIN
+ * with IPC_NONBLOCK.
+ */
+long sys_ipc_ep_send(int h, void *msg_ptr, int flags) {
+  struct ipc_message k_msg;
+  if (!current_process ||
+      vmm_copy_from_user(&k_msg, msg_ptr, sizeof(struct ipc_message)) != 0)
+    return -EFAULT;
+  k_msg.from = current_process->pid;
+  int rc = __ipc_send(-1, h, &k_msg,
+                      (flags & IPC_NONBLOCK) ? 0 : IPC_TX_BLOCK);
+  return rc == -1 ? -EPIPE : rc;
+}
 
-  /* 2. No message ready: commit to sleep.  The gap between the failed pop
-   * above and setting PROC_SLEEPING was the IPC-01 lost wakeup: a sender
-   * appending in that window saw us still RUNNING and skipped the wake, and
-   * we then slept on a non-empty queue with nobody left to wake us.  Close
-   * it by re-checking the queue under msg_lock — the same lock
-   * kernel_ipc_send() holds while appending and testing our state — and
-   * sleeping only if it is still empty.  Lock order msg_lock ->
-   * cpu->sched_lock matches the sender's msg_lock -> target-CPU sched_lock
-   * (see the locking hierarchy in the file header). */
+/*
+ * ipc_wait_message - commit to sleep for a buffered message.  The gap
+ * between a failed pop and setting PROC_SLEEPING was the IPC-01 lost
+ * wakeup: a sender appending in that window saw us still RUNNING and
+ * skipped the wake, and we then slept on a non-empty queue with nobody left
+ * to wake us.  Close it by re-checking the ring under msg_lock — the same
+ * lock __ipc_send() holds while appending and testing our state — and
+ * sleeping only if it is still empty.  Lock order msg_lock ->
+ * cpu->sched_lock matches the sender's msg_lock -> target-CPU sched_lock
+ * (see the locking hierarchy in the file header).
+ */
+void ipc_wait_message(int src_pid) {
+  struct process *self = current_process;
   uint64_t flags;
-  spin_lock_irqsave(&current_process->msg_lock, &flags);
-
-  int have_msg = 0;
-  struct list_head *pos;
-  list_for_each(pos, &current_process->msg_queue) {
-    struct ipc_node *tmp = list_entry(pos, struct ipc_node, list);
-    if (src_pid == -1 || tmp->msg.from == (int)src_pid) {
-      have_msg = 1;
-      break;
-    }
-  }
-
-  if (!have_msg) {
+  spin_lock_irqsave(&self->msg_lock, &flags);
+  if ((!self->msg_ring || !ipc_ring_has(self->msg_ring, src_pid)) &&
+      !ipc_ntfn_pending(self, src_pid)) {
     struct cpu_info *cpu = get_cpu_info();
     spin_lock(&cpu->sched_lock);
-    current_process->ipc_target_pid = src_pid;
-    current_process->state = PROC_SLEEPING;
+    self->ipc_target_pid = src_pid;
+    self->ipc_wait = IPC_WAIT_QUEUE;
+    self->state = PROC_SLEEPING;
     spin_unlock(&cpu->sched_lock);
   }
-  spin_unlock_irqrestore(&current_process->msg_lock, flags);
+  spin_unlock_irqrestore(&self->msg_lock, flags);
+  /* Waiting on one sender (the client half of send + recv(server)): lend
+   * it our rank until it answers.  Only to a thread we may talk to, so a
+   * recv() naming an arbitrary pid cannot boost it. */
+  if (src_pid > 0 && process_ipc_allowed(self, src_pid))
+    pi_boost(src_pid, 0);
+}
+
+int sys_ipc_recv(int src_pid, void *msg_ptr) {
+  /* Back to serving: the clients we answered stop lending their rank. */
+  pi_settle(current_process);
+
+  /* 1. Try to pop an existing message */
+  struct ipc_message m;
+  if (pop_message(current_process, src_pid, &m) == 0) {
+    if (vmm_copy_to_user(msg_ptr, &m, sizeof(struct ipc_message)) != 0)
+      return -EFAULT; /* message dropped */
+    return 0;
+  }
+
+  /* 2. No message ready: commit to sleep. */
+  ipc_wait_message(src_pid);
 
   /* Retry the syscall instruction on wake-up.  If a message slipped in
    * during the window we stayed RUNNING: the dispatcher's schedule() simply
@@ -1540,18 +2532,242 @@ int sys_ipc_recv(int src_pid, void *msg_ptr) {
 }
 
 int sys_ipc_try_recv(int src_pid, void *msg_ptr) {
-  struct ipc_node *node = pop_message(current_process, src_pid);
-  if (node) {
-    if (vmm_copy_to_user(msg_ptr, &node->msg, sizeof(struct ipc_message)) != 0) {
-      kfree(node);
+  struct ipc_message m;
+  if (pop_message(current_process, src_pid, &m) == 0) {
+    if (vmm_copy_to_user(msg_ptr, &m, sizeof(struct ipc_message)) != 0)
       return -1;
-    }
-    kfree(node);
     return 0;
   }
   return -1; /* EAGAIN */
 }
 
+/*
+ * sys_ipc_set_depth - SYS_IPC_SET_DEPTH: resize the calling thread's
+ * receive buffer to 'depth' slots (1..IPC_RING_MAX).  The new ring is
+ * allocated before any lock is taken and the buffered messages move over in
+ * order; -EBUSY (nothing changes) if more are buffered than would fit.
+ * Growing wakes every blocked sender.  Returns 0, -EINVAL or -ENOMEM.
+ */
+long sys_ipc_set_depth(unsigned int depth) {
+  struct process *self = current_process;
+  if (!self)
+    return -EINVAL;
+  if (depth == 0 || depth > IPC_RING_MAX)
+    return -EINVAL;
+  struct ipc_ring *ring = ipc_ring_alloc(depth);
+  if (!ring)
+    return -ENOMEM;
+
+  uint64_t flags;
+  spin_lock_irqsave(&self->msg_lock, &flags);
+  struct ipc_ring *old = self->msg_ring;
+  long rc = old ? ipc_ring_move(ring, old) : 0;
+  if (rc == 0) {
+    self->msg_ring = ring;
+    wait_queue_wake(&self->msg_space, 1);
+  }
+  spin_unlock_irqrestore(&self->msg_lock, flags);
+
+  ipc_ring_free(rc == 0 ? old : ring);
+  return rc;
+}
+
+/* ipc_block - commit the current task to an IPC wait.  The return register
+ * is pre-set to -EINTR so a task woken without a delivery (it never is
+ * today) does not return garbage.  Caller holds self->msg_lock. */
+static void ipc_block(struct process *self, int wait, int peer, void *msg_ptr) {
+  pt_regs_set_return(self->context, -EINTR);
+  self->ipc_msg = msg_ptr;
+  self->ipc_target_pid = peer;
+  self->ipc_wait = wait;
+}
+
+static int ipc_user_buf_ok(void *msg_ptr) {
+  uint64_t va = (uint64_t)msg_ptr;
+  return current_process->page_table && vmm_is_user_addr(va) &&
+         vmm_check_range(current_process->page_table, va,
+                         sizeof(struct ipc_message),
+                         PTE_VALID | PTE_USER | PTE_RW) == 0;
+}
+
+/*
+ * ipc_call - SYS_CALL / EP_CALL: send *msg_ptr to dest_pid, or to the
+ * server bound to endpoint handle (>= 0), and block until it replies
+ * (SYS_REPLY_RECV, or a plain SYS_SEND from the same process); the reply
+ * overwrites *msg_ptr.
+ *
+ * Fast path (L4-style): when dest is already blocked in SYS_REPLY_RECV the
+ * request is copied straight into its buffer — it never touches the ring —
+ * and the CPU switches directly to it, donating the rest of our slice
+ * (ipc_switch_to).  The server's reply takes the same path back, so a
+ * round trip costs two kernel entries and two context switches.  Any other
+ * state of dest falls back to its msg_ring.
+ *
+ * Returns IPC_CALL_PENDING once blocked (the replier writes the real
+ * result: 0, or -EFAULT if our buffer went bad); otherwise -EFAULT, -EPERM,
+ * -EINVAL (calling ourselves), -EAGAIN (dest's ring is full) or -ESRCH (no
+ * such process).
+ */
+static long ipc_call(struct pt_regs *frame, int dest_pid, int handle,
+                     void *msg_ptr) {
+  struct process *self = current_process;
+  struct ipc_message k_msg;
+  if (!self)
+    return -EINVAL;
+  if (vmm_copy_from_user(&k_msg, msg_ptr, sizeof(struct ipc_message)) != 0 ||
+      !ipc_user_buf_ok(msg_ptr))
+    return -EFAULT;
+  if (handle < 0 && !process_ipc_allowed(self, dest_pid))
+    return -EPERM;
+  k_msg.from = (int)self->pid;
+  self->context = frame;
+
+  struct ipc_pin pin;
+  long rc = ipc_pin_target(&pin, dest_pid, handle, 1);
+  if (rc != 0)
+    return rc == -1 ? -ESRCH : rc; /* IPC_SEND_RETRY == IPC_CALL_PENDING */
+  struct process *t = pin.t;
+  if (t == self || (int)t->pid == self->tgid) {
+    ipc_unpin(&pin);
+    return -EINVAL;
+  }
+
+  /* Publish the reply wait before the request becomes visible: the reply
+   * may come from another CPU before we get to sleep. */
+  int tpid = (int)t->pid;
+  spin_lock(&self->msg_lock);
+  ipc_block(self, IPC_WAIT_REPLY, tpid, msg_ptr);
+  spin_unlock(&self->msg_lock);
+
+  int donee;
+  rc = ipc_send_locked(t, &k_msg, IPC_TX_HANDOFF, &donee);
+  ipc_unpin(&pin);
+  pi_withdraw(donee);
+
+  uint64_t flags;
+  if (rc != 0) {
+    spin_lock_irqsave(&self->msg_lock, &flags);
+    self->ipc_wait = IPC_WAIT_NONE;
+    spin_unlock_irqrestore(&self->msg_lock, flags);
+    return rc == -EAGAIN ? -EAGAIN : -ESRCH;
+  }
+
+  /* Sleep unless the reply already arrived (ipc_wait cleared under
+   * msg_lock by the replier, which then found us RUNNING). */
+  spin_lock_irqsave(&self->msg_lock, &flags);
+  if (self->ipc_wait == IPC_WAIT_REPLY) {
+    struct cpu_info *cpu = get_cpu_info();
+    spin_lock(&cpu->sched_lock);
+    self->state = PROC_SLEEPING;
+    spin_unlock(&cpu->sched_lock);
+  }
+  spin_unlock_irqrestore(&self->msg_lock, flags);
+  /* The server works for us now: it runs at no worse than our rank until
+   * it replies and goes back to receive (pi_settle). */
+  pi_boost(tpid, 0);
+  return IPC_CALL_PENDING;
+}
+
+long sys_ipc_call(struct pt_regs *frame, int dest_pid, void *msg_ptr) {
+  return ipc_call(frame, dest_pid, -1, msg_ptr);
+}
+
+/* sys_ipc_ep_call - EP_CALL: SYS_CALL to the server bound to endpoint
+ * handle h (blocking until it is bound).  Same returns as sys_ipc_call,
+ * plus -EBADF for a bad handle. */
+long sys_ipc_ep_call(struct pt_regs *frame, int h, void *msg_ptr) {
+  return ipc_call(frame, -1, h, msg_ptr);
+}
+
+/*
+ * sys_ipc_reply_recv - SYS_REPLY_RECV: the server half of SYS_CALL.  If
+ * reply_pid > 0, *msg_ptr is delivered as the reply to that thread, which
+ * must be blocked in SYS_CALL on us.  Then the next request is received
+ * into *msg_ptr: a queued one immediately, else we block in IPC_WAIT_RECV
+ * and the replied-to caller runs directly on this CPU.
+ *
+ * Returns 0 with a message, IPC_CALL_PENDING once blocked, or -EFAULT.  A
+ * reply that cannot be delivered fails the whole call before anything is
+ * received: -ESRCH when reply_pid is gone, -EINVAL when it is not waiting
+ * for our reply.
+ */
+long sys_ipc_reply_recv(struct pt_regs *frame, int reply_pid, void *msg_ptr) {
+  struct process *self = current_process;
+  if (!self)
+    return -EINVAL;
+  if (!ipc_user_buf_ok(msg_ptr))
+    return -EFAULT;
+  self->context = frame;
+
+  uint64_t flags;
+  if (reply_pid > 0) {
+    struct ipc_message k_msg;
+    if (vmm_copy_from_user(&k_msg, msg_ptr, sizeof(struct ipc_message)) != 0)
+      return -EFAULT;
+    k_msg.from = (int)self->pid;
+
+    /* Only a hint: if a request is already queued we keep the CPU and the
+     * caller just becomes runnable. */
+    int will_block = !self->msg_ring || self->msg_ring->count == 0;
+
+    long rc = -ESRCH;
+    int donee = 0;
+    rcu_read_lock(&flags);
+    struct process *c = __process_find_by_pid(reply_pid);
+    if (c && c->state != PROC_DEAD && c->state != PROC_ZOMBIE) {
+      rc = -EINVAL;
+      spin_lock(&c->msg_lock);
+      if (!c->msg_closed && c->ipc_wait == IPC_WAIT_REPLY &&
+          ipc_can_deliver(c, &k_msg, self->tgid)) {
+        donee = c->ipc_target_pid;
+        ipc_deliver(c, &k_msg);
+        if (will_block)
+          ipc_switch_to(c);
+        else
+          wake_sleeping_task(c);
+        rc = 0;
+      }
+      spin_unlock(&c->msg_lock);
+    }
+    rcu_read_unlock(flags);
+    /* The caller may have called our process by its tgid: that thread,
+     * not necessarily us, was the one it lent its rank to. */
+    if (donee != (int)self->pid)
+      pi_withdraw(donee);
+    if (rc != 0) {
+      pi_settle(self);
+      return rc;
+    }
+  }
+  /* The replied-to caller no longer lends us its rank. */
+  pi_settle(self);
+
+  for (;;) {
+    struct ipc_message m;
+    if (pop_message(self, -1, &m) == 0) {
+      if (vmm_copy_to_user(msg_ptr, &m, sizeof(struct ipc_message)) != 0)
+        return -EFAULT;
+      return 0;
+    }
+
+    /* Same lost-wakeup rule as sys_ipc_recv (IPC-01): re-check the queue
+     * under msg_lock, the lock senders deliver and enqueue under. */
+    spin_lock_irqsave(&self->msg_lock, &flags);
+    if ((self->msg_ring && self->msg_ring->count != 0) ||
+        ipc_ntfn_pending(self, -1)) {
+      spin_unlock_irqrestore(&self->msg_lock, flags);
+      continue;
+    }
+    ipc_block(self, IPC_WAIT_RECV, -1, msg_ptr);
+    struct cpu_info *cpu = get_cpu_info();
+    spin_lock(&cpu->sched_lock);
+    self->state = PROC_SLEEPING;
+    spin_unlock(&cpu->sched_lock);
+    spin_unlock_irqrestore(&self->msg_lock, flags);
+    return IPC_CALL_PENDING;
+  }
+}
+
 long sys_getprocs(struct ps_info *user_buf, size_t max_count) {
   if (!user_buf)
     return -1;
@@ -1568,20 +2784,23 @@ long sys_getprocs(struct ps_info *user_buf, size_t max_count) {
     return -1;
 
   int count = 0;
+  /* A snapshot without sched_lock: each entry is one live-or-dying thread,
+   * the set as a whole need not be from a single instant. */
   uint64_t flags;
-  spin_lock_irqsave(&sched_lock, &flags);
+  rcu_read_lock(&flags);
   for (int i = 0; i < MAX_PROCESSES && (size_t)count < max_count; i++) {
-    if (process_pool[i]) {
-      k_buf[count].pid = process_pool[i]->pid;
-      strncpy(k_buf[count].name, process_pool[i]->name, 32);
-      k_buf[count].state = process_pool[i]->state;
-      k_buf[count].priority = process_pool[i]->priority;
+    struct process *p = rcu_dereference(process_pool[i]);
+    if (p) {
+      k_buf[count].pid = p->pid;
+      strncpy(k_buf[count].name, p->name, 32);
+      k_buf[count].state = p->state;
+      k_buf[count].priority = p->priority;
       k_buf[count].cpu_time = 0; /* Placeholder */
-      k_buf[count].on_cpu = process_pool[i]->on_cpu;
+      k_buf[count].on_cpu = p->on_cpu;
       count++;
     }
   }
-  spin_unlock_irqrestore(&sched_lock, flags);
+  rcu_read_unlock(flags);
 
   vmm_copy_to_user(user_buf, k_buf, sizeof(struct ps_info) * count);
   kfree(k_buf);
@@ -1595,17 +2814,25 @@ long sys_getprocs(struct ps_info *user_buf, size_t max_count) {
 
 long sys_sbrk(intptr_t increment) {
   struct process *proc = current_process;
-  uint64_t old_brk = proc->heap_end;
+  struct proc_space *space = proc->space;
+
+  /* The break is per process: sibling threads serialise on mm_lock, which
+   * also covers the page-table edits (hence the unlocked vmm_* calls). */
+  uint64_t flags;
+  spin_lock_irqsave(&space->mm_lock, &flags);
+  uint64_t old_brk = space->heap_end;
   uint64_t new_brk = old_brk + increment;
+  long ret = (long)old_brk;
 
   if (increment == 0) {
-    return (long)old_brk;
+    goto out;
   }
 
   if (increment > 0) {
     /* Bound the heap: no overflow past the guard below the user stack. */
     if (new_brk < old_brk || new_brk > SBRK_HEAP_LIMIT) {
-      return -ENOMEM;
+      ret = -ENOMEM;
+      goto out;
     }
     /* Map from current end up to new end */
     uint64_t start_map = (old_brk + 4095) & ~(4095ULL);
@@ -1614,33 +2841,272 @@ long sys_sbrk(intptr_t increment) {
     for (uint64_t vaddr = start_map; vaddr < end_map; vaddr += 4096) {
       void *paddr = pmm_alloc_page();
       if (!paddr) {
-        return -ENOMEM;
+        ret = -ENOMEM;
+        goto out;
       }
       memset(paddr, 0, 4096);
       /* PAGE_USER_DATA: the user heap is never executable (W^X, ELF-02). */
-      if (vmm_map_page_locked(proc, vaddr, virt_to_phys(paddr), PAGE_USER_DATA) != 0) {
+      if (vmm_map_page(space->page_table, vaddr, virt_to_phys(paddr),
+                       PAGE_USER_DATA) != 0) {
         pmm_free_page(paddr);
-        return -ENOMEM;
+        ret = -ENOMEM;
+        goto out;
       }
     }
   } else {
     /* Shrinking the heap */
-    if (new_brk < proc->heap_start) {
-      return -EINVAL;
+    if (new_brk < space->heap_start) {
+      ret = -EINVAL;
+      goto out;
     }
 
     uint64_t start_unmap = (new_brk + 4095) & ~(4095ULL);
     uint64_t end_unmap = (old_brk + 4095) & ~(4095ULL);
 
     for (uint64_t vaddr = start_unmap; vaddr < end_unmap; vaddr += 4096) {
-      uint64_t paddr = vmm_get_phys(proc->page_table, vaddr);
+      uint64_t paddr = vmm_get_phys(space->page_table, vaddr);
       if (paddr) {
-        vmm_unmap_page_locked(proc, vaddr);
+        vmm_unmap_page(space->page_table, vaddr);
         pmm_free_page(phys_to_virt(paddr));
       }
     }
   }
 
-  proc->heap_end = new_brk;
-  return (long)old_brk;
+  space->heap_end = new_brk;
+out:
+  spin_unlock_irqrestore(&space->mm_lock, flags);
+  return ret;
+}
+
+/*
+ * sys_thread_create - start a new thread in the caller's address space.
+ *
+ * The thread begins in user mode at 'entry' on the caller-provided stack
+ * 'stack_top' with arg0/arg1 in the first two argument registers and its TLS
+ * register set to 'tls'.  It inherits the creator's name, priority, level
+ * and capabilities, shares its proc_space (memory, heap, cwd, fds) and is
+ * placed on the creator's CPU; work stealing spreads siblings from there.
+ *
+ * Returns the new thread id, -EINVAL for a kernel thread or a non-user
+ * entry/stack, or -EAGAIN when the per-process thread table (threads not yet
+ * joined count) or the process pool is full.
+ */
+long sys_thread_create(uint64_t entry, uint64_t stack_top, uint64_t arg0,
+                       uint64_t arg1, uint64_t tls) {
+  struct process *self = current_process;
+  if (!self || !self->space || !self->page_table)
+    return -EINVAL;
+  if (!vmm_is_user_addr(entry) || !vmm_is_user_addr(stack_top - 1))
+    return -EINVAL;
+
+  struct proc_space *space = self->space;
+  uint64_t flags;
+  spin_lock_irqsave(&space->thread_lock, &flags);
+  int rec = -1;
+  if (space->nthreads < MAX_THREADS_PER_PROC) {
+    for (int i = 0; i < MAX_THREADS_PER_PROC; i++) {
+      if (space->threads[i].tid == 0) {
+        rec = i;
+        break;
+      }
+    }
+  }
+  if (rec >= 0) {
+    space->threads[rec].tid = -1; /* reserved until the tid is known */
+    space->nthreads++;
+  }
+  spin_unlock_irqrestore(&space->thread_lock, flags);
+  if (rec < 0)
+    return -EAGAIN;
+
+  struct process *t = process_alloc(self->name, self->priority, self->level,
+                                    self->caps, space);
+  if (!t) {
+    spin_lock_irqsave(&space->thread_lock, &flags);
+    space->threads[rec].tid = 0;
+    space->nthreads--;
+    spin_unlock_irqrestore(&space->thread_lock, flags);
+    return -EAGAIN;
+  }
+
+  spin_lock_irqsave(&space->thread_lock, &flags);
+  space->threads[rec].tid = (int)t->pid;
+  space->threads[rec].exited = 0;
+  space->threads[rec].exit_code = 0;
+  spin_unlock_irqrestore(&space->thread_lock, flags);
+
+  t->user_entry = entry;
+  t->user_stack = stack_top;
+  t->tls_base = tls;
+  t->on_cpu = self->on_cpu;
+  pt_regs_init_user_task(t->context, entry, stack_top);
+  pt_regs_set_user_args(t->context, arg0, arg1);
+  arch_cache_clean_range(t->context, sizeof(struct pt_regs));
+  arch_mb();
+
+  enqueue_task(t);
+  return (long)t->pid;
+}
+
+/*
+ * thread_create_kernel - see kernel/sched.h.  Counts against
+ * MAX_THREADS_PER_PROC like any thread but takes no join record: nobody
+ * joins it, so thread_note_exit() finds nothing to publish.  The entry
+ * frame starts one word below the stack top, as if fn had been called.
+ */
+struct process *thread_create_kernel(void (*fn)(void *), void *arg) {
+  struct process *self = current_process;
+  if (!self || !self->space || !self->page_table)
+    return NULL;
+
+  struct proc_space *space = self->space;
+  uint64_t flags;
+  spin_lock_irqsave(&space->thread_lock, &flags);
+  int ok = space->nthreads < MAX_THREADS_PER_PROC;
+  if (ok)
+    space->nthreads++;
+  spin_unlock_irqrestore(&space->thread_lock, flags);
+  if (!ok)
+    return NULL;
+
+  struct process *t = process_alloc(self->name, self->priority, self->level,
+                                    self->caps, space);
+  if (!t) {
+    spin_lock_irqsave(&space->thread_lock, &flags);
+    space->nthreads--;
+    spin_unlock_irqrestore(&space->thread_lock, flags);
+    return NULL;
+  }
+  t->on_cpu = self->on_cpu;
+  memset(t->context, 0, sizeof(struct pt_regs));
+  pt_regs_init_kernel_task(t->context, (uint64_t)fn, t->kernel_stack - 8);
+  pt_regs_set_user_args(t->context, (uint64_t)arg, 0);
+  arch_cache_clean_range(t->context, sizeof(struct pt_regs));
+  arch_mb();
+
+  enqueue_task(t);
+  return t;
+}
+
+/*
+ * thread_sleep_kernel - wait_queue_block() for a kernel-mode thread, which
+ * has no dispatcher to return to: mark it SLEEPING under wq->lock, drop
+ * the lock and idle until a tick switches it away.  It resumes in the
+ * idle loop once woken and scheduled again — or, woken before the tick,
+ * finds itself RUNNING and simply carries on.  A killed sleeper stays in
+ * the loop until it is reaped.
+ */
+void thread_sleep_kernel(struct wait_queue_head *wq, uint64_t flags) {
+  struct process *self = current_process;
+  self->wait_queue_ptr = wq;
+  list_add_tail(&self->run_list, &wq->task_list);
+  struct cpu_info *cpu = get_cpu_info();
+  spin_lock(&cpu->sched_lock);
+  self->state = PROC_SLEEPING;
+  spin_unlock(&cpu->sched_lock);
+  spin_unlock_irqrestore(&wq->lock, flags);
+  while (__atomic_load_n(&self->state, __ATOMIC_ACQUIRE) != PROC_RUNNING)
+    hal_cpu_idle();
+}
+
+/*
+ * thread_exit_kernel - end a thread_create_kernel() thread.  It turns
+ * itself into a zombie, as sys_exit's self-termination does, and idles
+ * until the next tick's schedule() reaps it.  Unlike process_terminate_
+ * thread() this also works for a machine-level group.
+ */
+void thread_exit_kernel(void) {
+  uint64_t flags;
+  spin_lock_irqsave(&sched_lock, &flags);
+  current_process->state = PROC_ZOMBIE;
+  spin_unlock_irqrestore(&sched_lock, flags);
+  for (;;)
+    hal_cpu_idle();
+}
+
+/*
+ * sys_thread_exit - end the calling thread with 'code' for sys_thread_join.
+ * The dispatcher must call schedule() afterwards, as for sys_exit().  The
+ * leader cannot outlive its process: thread_exit() from the leader is exit()
+ * and takes every sibling with it.
+ */
+void sys_thread_exit(int code) {
+  struct process *self = current_process;
+  if (!self)
+    return;
+  if ((int)self->pid == self->tgid) {
+    process_terminate(self->tgid);
+    return;
+  }
+  thread_note_exit(self, code);
+  process_terminate_thread((int)self->pid);
+}
+
+/*
+ * sys_thread_join - wait for sibling thread 'tid' to exit and collect its
+ * code (stored at code_out unless NULL).  Each exited thread can be joined
+ * exactly once; that releases its slot in the thread table.
+ *
+ * Blocks like sys_ipc_recv: the sleep is committed under thread_lock — the
+ * lock thread_note_exit() publishes under — so an exit between the check and
+ * the sleep cannot be missed, and the syscall is retried on wake-up.
+ *
+ * Returns 0, THREAD_JOIN_RETRY (blocked, retry armed), -EINVAL for a self
+ * join, -ESRCH if tid is not an unjoined thread of this process, or -EFAULT.
+ */
+long sys_thread_join(int tid, int *code_out) {
+  struct process *self = current_process;
+  if (!self || !self->space)
+    return -ESRCH;
+  if (tid == (int)self->pid)
+    return -EINVAL;
+  self->join_tid = 0;
+
+  struct proc_space *space = self->space;
+  uint64_t flags;
+  spin_lock_irqsave(&space->thread_lock, &flags);
+  struct thread_rec *r = NULL;
+  for (int i = 0; i < MAX_THREADS_PER_PROC; i++) {
+    if (tid > 0 && space->threads[i].tid == tid) {
+      r = &space->threads[i];
+      break;
+    }
+  }
+  if (!r) {
+    spin_unlock_irqrestore(&space->thread_lock, flags);
+    return -ESRCH;
+  }
+
+  if (r->exited) {
+    int code = r->exit_code;
+    r->tid = 0;
+    spin_unlock_irqrestore(&space->thread_lock, flags);
+    if (code_out && vmm_copy_to_user(code_out, &code, sizeof(code)) != 0)
+      return -EFAULT;
+    return 0;
+  }
+
+  struct cpu_info *cpu = get_cpu_info();
+  spin_lock(&cpu->sched_lock);
+  self->join_tid = tid;
+  self->state = PROC_SLEEPING;
+  spin_unlock(&cpu->sched_lock);
+  spin_unlock_irqrestore(&space->thread_lock, flags);
+
+  pt_regs_retry_syscall(self->context);
+  return THREAD_JOIN_RETRY;
+}
+
+/*
+ * sys_set_tls - set the calling thread's TLS register (TPIDR_EL0 / FS base).
+ * Takes effect immediately and follows the thread across switches.  Any
+ * value is accepted: a bad pointer only faults the thread that uses it.
+ */
+long sys_set_tls(uint64_t base) {
+  struct process *self = current_process;
+  if (!self)
+    return -EINVAL;
+  self->tls_base = base;
+  arch_tls_load(self);
+  return 0;
 }
@@ -0,0 +1,360 @@
+/*
+ * kernel/sched/uring.c
+ * SYS_URING: submission / completion rings for batched syscalls (see
+ * kernel/uring.h).  Set-up, teardown and the consumer loop live here; what
+ * an SQE may do is syscall_call_nowait()'s business (syscall_dispatch.c).
+ */
+#include <kernel/arch.h>
+#include <kernel/cpu.h>
+#include <kernel/futex.h>
+#include <kernel/kmalloc.h>
+#include <kernel/memlayout.h>
+#include <kernel/pmm.h>
+#include <kernel/string.h>
+#include <kernel/syscall.h>
+#include <kernel/uring.h>
+#include <kernel/vmm.h>
+#include <drivers/timer.h>
+
+#define SQE_PER_PAGE (PAGE_SIZE / sizeof(struct uring_sqe))
+#define CQE_PER_PAGE (PAGE_SIZE / sizeof(struct uring_cqe))
+
+static uint32_t sq_pages(uint32_t n) {
+  return (n + SQE_PER_PAGE - 1) / SQE_PER_PAGE;
+}
+
+static uint32_t cq_pages(uint32_t n) {
+  return (n + CQE_PER_PAGE - 1) / CQE_PER_PAGE;
+}
+
+static struct uring_shared *ur_hdr(struct uring *r) {
+  return (struct uring_shared *)phys_to_virt(r->frames[0]);
+}
+
+/* The arrays are not contiguous in the kernel's view: index page by page. */
+static struct uring_sqe *ur_sqe(struct uring *r, uint32_t i) {
+  struct uring_sqe *pg = phys_to_virt(r->frames[1 + i / SQE_PER_PAGE]);
+  return &pg[i % SQE_PER_PAGE];
+}
+
+static struct uring_cqe *ur_cqe(struct uring *r, uint32_t i) {
+  struct uring_cqe *pg =
+      phys_to_virt(r->frames[1 + sq_pages(r->sq_entries) + i / CQE_PER_PAGE]);
+  return &pg[i % CQE_PER_PAGE];
+}
+
+static void ur_free(struct uring *r) {
+  for (int i = 0; i < r->npages; i++)
+    pmm_free_page(phys_to_virt(r->frames[i]));
+  kfree(r);
+}
+
+static void ur_put(struct uring *r) {
+  if (__atomic_sub_fetch(&r->refs, 1, __ATOMIC_ACQ_REL) == 0)
+    ur_free(r);
+}
+
+/* ur_get - the space's ring with a reference taken, or NULL. */
+static struct uring *ur_get(struct proc_space *space) {
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  struct uring *r = space->uring;
+  if (r)
+    __atomic_add_fetch(&r->refs, 1, __ATOMIC_RELAXED);
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  return r;
+}
+
+static struct uring *ur_alloc(uint32_t entries) {
+  struct uring *r = kmalloc(sizeof(*r));
+  if (!r)
+    return NULL;
+  memset(r, 0, sizeof(*r));
+  r->refs = 1; /* the space's */
+  r->sq_entries = entries;
+  r->cq_entries = 2 * entries;
+  INIT_LIST_HEAD(&r->poll_wq.task_list);
+  spin_lock_init(&r->poll_wq.lock);
+
+  int npages = 1 + (int)sq_pages(entries) + (int)cq_pages(2 * entries);
+  for (int i = 0; i < npages; i++) {
+    void *pg = pmm_alloc_page();
+    if (!pg) {
+      ur_free(r);
+      return NULL;
+    }
+    r->frames[r->npages++] = virt_to_phys(pg);
+  }
+
+  struct uring_shared *hdr = ur_hdr(r);
+  hdr->sq_entries = r->sq_entries;
+  hdr->cq_entries = r->cq_entries;
+  hdr->sq_off = PAGE_SIZE;
+  hdr->cq_off = PAGE_SIZE * (1 + sq_pages(entries));
+  return r;
+}
+
+/* ur_unmap / ur_map - the user mapping at URING_VA, as chan_unmap /
+ * chan_map: one frame reference per mapped page, mm_lock over the edits. */
+static void ur_unmap(struct proc_space *space, struct uring *r, int n) {
+  uint64_t flags;
+  spin_lock_irqsave(&space->mm_lock, &flags);
+  for (int i = 0; i < n; i++) {
+    vmm_unmap_page(space->page_table, URING_VA + (uint64_t)i * PAGE_SIZE);
+    pmm_free_page(phys_to_virt(r->frames[i]));
+  }
+  spin_unlock_irqrestore(&space->mm_lock, flags);
+}
+
+static int ur_map(struct proc_space *space, struct uring *r) {
+  uint64_t flags;
+  spin_lock_irqsave(&space->mm_lock, &flags);
+  for (int i = 0; i < r->npages; i++) {
+    void *pg = phys_to_virt(r->frames[i]);
+    pmm_get_page(pg);
+    if (vmm_map_page(space->page_table, URING_VA + (uint64_t)i * PAGE_SIZE,
+                     r->frames[i], PAGE_USER_DATA) != 0) {
+      pmm_free_page(pg);
+      spin_unlock_irqrestore(&space->mm_lock, flags);
+      ur_unmap(space, r, i);
+      return -ENOMEM;
+    }
+  }
+  spin_unlock_irqrestore(&space->mm_lock, flags);
+  return 0;
+}
+
+/* ur_sq_pending - SQEs the user has queued past our head, clamped to the
+ * SQ size (a bogus tail must not make us run slots twice). */
+static uint32_t ur_sq_pending(struct uring *r) {
+  uint32_t tail = __atomic_load_n(&ur_hdr(r)->sq_tail, __ATOMIC_ACQUIRE);
+  uint32_t n = tail - r->sq_head;
+  return n > r->sq_entries ? r->sq_entries : n;
+}
+
+/* ur_cq_room - free CQ slots as of the user's last published cq_head. */
+static uint32_t ur_cq_room(struct uring *r) {
+  uint32_t head = __atomic_load_n(&ur_hdr(r)->cq_head, __ATOMIC_ACQUIRE);
+  uint32_t used = r->cq_tail - head;
+  return used >= r->cq_entries ? 0 : r->cq_entries - used;
+}
+
+/* ur_cq_kick - after publishing cq_tail: wake a SQPOLL client sleeping on
+ * cq_wait (the chan_kick protocol, kernel side). */
+static void ur_cq_kick(struct uring *r) {
+  struct uring_shared *hdr = ur_hdr(r);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&hdr->cq_wait, __ATOMIC_RELAXED) &&
+      __atomic_exchange_n(&hdr->cq_wait, 0, __ATOMIC_SEQ_CST))
+    futex_wake_key(r->frames[0] + offsetof(struct uring_shared, cq_wait), 1);
+}
+
+/*
+ * ur_consume - run up to max queued SQEs as the current process, posting
+ * one CQE each, until the SQ is empty or the CQ full.  The caller holds
+ * r->busy.  Each SQE is copied before it is looked at, and both counters
+ * are published once per batch.  Returns the number consumed.
+ */
+static uint32_t ur_consume(struct uring *r, uint32_t max) {
+  uint32_t n = ur_sq_pending(r);
+  uint32_t room = ur_cq_room(r);
+  if (n > max)
+    n = max;
+  if (n > room)
+    n = room;
+  for (uint32_t i = 0; i < n; i++) {
+    struct uring_sqe sqe = *ur_sqe(r, r->sq_head & (r->sq_entries - 1));
+    r->sq_head++;
+    long res = sqe.flags ? -EINVAL : syscall_call_nowait(sqe.op, sqe.args);
+    struct uring_cqe *cqe = ur_cqe(r, r->cq_tail & (r->cq_entries - 1));
+    cqe->user_data = sqe.user_data;
+    cqe->res = res;
+    r->cq_tail++;
+  }
+  if (n) {
+    struct uring_shared *hdr = ur_hdr(r);
+    __atomic_store_n(&hdr->sq_head, r->sq_head, __ATOMIC_RELEASE);
+    __atomic_store_n(&hdr->cq_tail, r->cq_tail, __ATOMIC_RELEASE);
+    ur_cq_kick(r);
+  }
+  return n;
+}
+
+/* ur_poller_idle - nothing to do: advertise URING_SQ_NEED_WAKEUP, look
+ * once more (a submitter that queued before seeing the flag does not
+ * enter), then sleep on poll_wq until URING_ENTER_SQ_WAKEUP. */
+static void ur_poller_idle(struct uring *r) {
+  struct uring_shared *hdr = ur_hdr(r);
+  __atomic_or_fetch(&hdr->sq_flags, URING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+  uint64_t flags;
+  spin_lock_irqsave(&r->poll_wq.lock, &flags);
+  if (__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE) ||
+      (ur_sq_pending(r) && ur_cq_room(r)))
+    spin_unlock_irqrestore(&r->poll_wq.lock, flags);
+  else
+    thread_sleep_kernel(&r->poll_wq, flags);
+  __atomic_and_fetch(&hdr->sq_flags, ~URING_SQ_NEED_WAKEUP, __ATOMIC_SEQ_CST);
+}
+
+/*
+ * ur_poller - the SQPOLL thread: consume whatever is queued, spin (with
+ * the CPU's pause hint; the tick still preempts it) while work keeps
+ * coming, and sleep after URING_SQPOLL_IDLE_MS without any.  A full CQ
+ * counts as idle: the client must reap before anything else runs.
+ */
+static void ur_poller(void *arg) {
+  struct uring *r = arg;
+  uint64_t idle_since = jiffies;
+  uint64_t idle = msecs_to_jiffies(URING_SQPOLL_IDLE_MS);
+  if (idle == 0)
+    idle = 1;
+  while (!__atomic_load_n(&r->stop, __ATOMIC_ACQUIRE)) {
+    uint32_t n = 0;
+    if (!__atomic_exchange_n(&r->busy, 1, __ATOMIC_ACQUIRE)) {
+      n = ur_consume(r, r->sq_entries);
+      __atomic_store_n(&r->busy, 0, __ATOMIC_RELEASE);
+    }
+    if (n) {
+      idle_since = jiffies;
+    } else if (jiffies - idle_since >= idle) {
+      ur_poller_idle(r);
+      idle_since = jiffies;
+    } else {
+      hal_cpu_yield();
+    }
+  }
+  /* Drop the poller's reference with IRQs masked, so a kill between the
+   * claim and the put cannot leave it to uring_release_space as well. */
+  uint64_t flags = local_irq_save();
+  if (__atomic_exchange_n(&r->poller_live, 0, __ATOMIC_ACQ_REL))
+    ur_put(r);
+  local_irq_restore(flags);
+  thread_exit_kernel();
+}
+
+static void ur_poller_wake(struct uring *r) {
+  uint64_t flags = local_irq_save();
+  wait_queue_wake(&r->poll_wq, 1);
+  local_irq_restore(flags);
+}
+
+static long ur_do_setup(uint32_t entries, uint32_t setup_flags,
+                        struct uring_info *uinfo) {
+  struct proc_space *space = current_process->space;
+  if (entries == 0 || entries > URING_ENTRIES_MAX ||
+      (entries & (entries - 1)) || (setup_flags & ~URING_SETUP_SQPOLL))
+    return -EINVAL;
+  struct uring *r = ur_alloc(entries);
+  if (!r)
+    return -ENOMEM;
+  ur_hdr(r)->setup_flags = setup_flags;
+
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  int busy = space->uring != NULL;
+  if (!busy)
+    space->uring = r;
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  if (busy) {
+    ur_put(r);
+    return -EBUSY;
+  }
+
+  long rc = ur_map(space, r);
+  struct uring_info info = {URING_VA, r->sq_entries, r->cq_entries};
+  if (rc == 0 && vmm_copy_to_user(uinfo, &info, sizeof(info)) != 0) {
+    ur_unmap(space, r, r->npages);
+    rc = -EFAULT;
+  }
+  if (rc == 0 && (setup_flags & URING_SETUP_SQPOLL)) {
+    r->sqpoll = 1;
+    __atomic_add_fetch(&r->refs, 1, __ATOMIC_RELAXED);
+    r->poller_live = 1;
+    if (!thread_create_kernel(ur_poller, r)) {
+      r->poller_live = 0;
+      __atomic_sub_fetch(&r->refs, 1, __ATOMIC_RELAXED);
+      ur_unmap(space, r, r->npages);
+      rc = -EAGAIN;
+    }
+  }
+  if (rc != 0) {
+    spin_lock_irqsave(&space->handle_lock, &flags);
+    space->uring = NULL;
+    spin_unlock_irqrestore(&space->handle_lock, flags);
+    ur_put(r);
+  }
+  return rc;
+}
+
+static long ur_do_enter(uint32_t to_submit, uint32_t enter_flags) {
+  struct uring *r = ur_get(current_process->space);
+  if (!r)
+    return -EBADF;
+  long rc = 0;
+  if (r->sqpoll) {
+    if (enter_flags & URING_ENTER_SQ_WAKEUP)
+      ur_poller_wake(r);
+  } else if (__atomic_exchange_n(&r->busy, 1, __ATOMIC_ACQUIRE)) {
+    rc = -EBUSY;
+  } else {
+    rc = (long)ur_consume(r, to_submit);
+    __atomic_store_n(&r->busy, 0, __ATOMIC_RELEASE);
+  }
+  ur_put(r);
+  return rc;
+}
+
+/* ur_detach - take the ring out of the space and stop its poller.  The
+ * space's reference passes to the caller. */
+static struct uring *ur_detach(struct proc_space *space) {
+  uint64_t flags;
+  spin_lock_irqsave(&space->handle_lock, &flags);
+  struct uring *r = space->uring;
+  space->uring = NULL;
+  spin_unlock_irqrestore(&space->handle_lock, flags);
+  if (r && r->sqpoll) {
+    __atomic_store_n(&r->stop, 1, __ATOMIC_RELEASE);
+    ur_poller_wake(r);
+  }
+  return r;
+}
+
+static long ur_do_destroy(void) {
+  struct proc_space *space = current_process->space;
+  struct uring *r = ur_detach(space);
+  if (!r)
+    return -EBADF;
+  ur_unmap(space, r, r->npages);
+  ur_put(r);
+  return 0;
+}
+
+void uring_release_space(struct proc_space *space) {
+  struct uring *r = ur_detach(space);
+  if (!r)
+    return;
+  /* Every thread of the group is gone: a poller that never got to drop
+   * its reference was killed. */
+  if (__atomic_exchange_n(&r->poller_live, 0, __ATOMIC_ACQ_REL))
+    ur_put(r);
+  ur_put(r);
+}
+
+/*
+ * sys_uring - SYS_URING entry (include/api/uring.h for the user contract).
+ */
+long sys_uring(int op, uint64_t a1, uint64_t a2, uint64_t a3) {
+  if (!current_process || !current_process->space ||
+      !current_process->page_table)
+    return -EINVAL;
+  switch (op) {
+  case URING_SETUP:
+    return ur_do_setup((uint32_t)a1, (uint32_t)a2, (struct uring_info *)a3);
+  case URING_ENTER:
+    return ur_do_enter((uint32_t)a1, (uint32_t)a2);
+  case URING_DESTROY:
+    return ur_do_destroy();
+  default:
+    return -ENOSYS;
+  }
+}
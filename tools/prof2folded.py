@@ -0,0 +1,141 @@
+#!/usr/bin/env python3
+"""Fold a /bin/prof capture (include/api/prof.h) into collapsed stacks.
+
+    tools/prof2folded.py prof.bin [-k build/amd64/kernel.elf]
+                         [-u build/amd64] [-o prof.folded]
+
+One line per distinct stack, "comm;outer;...;leaf count", the format of
+flamegraph.pl and speedscope.  Frames resolve against the ELF symbol
+tables: kernel samples against the kernel image (-k, marked "[k]"), user
+samples against <dir>/<comm>.elf (-u; every user ELF is linked at the same
+base, so the name picks the image).  Unresolved frames print as hex.  Get
+the file out of the disk image with e.g.
+`debugfs -R "dump /etc/prof.bin prof.bin" build/amd64/disk.img`.
+"""
+import argparse
+import bisect
+import collections
+import os
+import struct
+import sys
+
+MAGIC = b"OS1PROF\0"
+VERSION = 1
+MAX_FRAMES = 8
+S_USER = 1
+HEADER = struct.Struct("<8sII QQIIII")           # struct prof_file_header
+SAMPLE = struct.Struct(f"<QIBBBB16s{MAX_FRAMES}Q")  # struct prof_sample
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER.size:
+        sys.exit(f"{path}: too short for a profile header")
+    magic, version, nsamples, clock_hz, lost, hz, ncpu, ring, _ = \
+        HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION:
+        sys.exit(f"{path}: not a version {VERSION} profile")
+    avail = (len(data) - HEADER.size) // SAMPLE.size
+    if nsamples > avail:
+        print(f"warning: header says {nsamples} samples, file holds {avail}",
+              file=sys.stderr)
+        nsamples = avail
+    samples = []
+    for i in range(nsamples):
+        ts, pid, cpu, flags, depth, _, comm, *pcs = \
+            SAMPLE.unpack_from(data, HEADER.size + i * SAMPLE.size)
+        comm = comm.split(b"\0", 1)[0].decode("ascii", "replace")
+        depth = max(1, min(depth, MAX_FRAMES))
+        samples.append((pid, cpu, flags, comm, pcs[:depth]))
+    info = dict(clock_hz=clock_hz, lost=lost, hz=hz, ncpu=ncpu,
+                ring_samples=ring)
+    return info, samples
+
+
+class Symbols:
+    """STT_FUNC entries of an ELF64 little-endian .symtab, by address."""
+
+    def __init__(self, path):
+        self.addrs, self.ends, self.names = [], [], []
+        try:
+            with open(path, "rb") as f:
+                data = f.read()
+        except OSError:
+            return
+        if data[:4] != b"\x7fELF" or data[4] != 2 or data[5] != 1:
+            return
+        shoff, = struct.unpack_from("<Q", data, 0x28)
+        shentsize, shnum = struct.unpack_from("<HH", data, 0x3A)
+        sections = [struct.unpack_from("<IIQQQQIIQQ", data,
+                                       shoff + i * shentsize)
+                    for i in range(shnum)]
+        funcs = []
+        for sh in sections:
+            if sh[1] != 2:  # SHT_SYMTAB
+                continue
+            strtab = sections[sh[6]]
+            for off in range(sh[4], sh[4] + sh[5], 24):
+                name, info, _, shndx, value, size = \
+                    struct.unpack_from("<IBBHQQ", data, off)
+                if info & 0xF != 2 or not value:  # STT_FUNC
+                    continue
+                start = strtab[4] + name
+                end = data.index(b"\0", start)
+                funcs.append((value, size, data[start:end].decode()))
+        funcs.sort()
+        for value, size, name in funcs:
+            self.addrs.append(value)
+            self.ends.append(value + size if size else None)
+            self.names.append(name)
+
+    def lookup(self, pc):
+        i = bisect.bisect_right(self.addrs, pc) - 1
+        if i < 0 or (self.ends[i] is not None and pc >= self.ends[i]):
+            return None
+        return self.names[i]
+
+
+def fold(samples, kernel, userdir):
+    users = {}
+    stacks = collections.Counter()
+    for pid, cpu, flags, comm, pcs in samples:
+        if flags & S_USER:
+            base = os.path.basename(comm)
+            if base not in users:
+                users[base] = Symbols(os.path.join(userdir, base + ".elf"))
+            syms, mark = users[base], ""
+        else:
+            syms, mark = kernel, "[k]"
+        frames = []
+        for i, pc in enumerate(pcs):
+            # Callers are return addresses: look up the call, not the next
+            # instruction, so a call ending a function names the caller.
+            name = syms.lookup(pc if i == 0 else pc - 1)
+            frames.append((name or f"{pc:#x}") + mark)
+        stacks[";".join([comm or "?"] + frames[::-1])] += 1
+    return stacks
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("profile", help="file written by /bin/prof save")
+    ap.add_argument("-k", "--kernel", default="build/amd64/kernel.elf",
+                    help="kernel ELF (default %(default)s)")
+    ap.add_argument("-u", "--userdir", default="build/amd64",
+                    help="directory of user ELFs (default %(default)s)")
+    ap.add_argument("-o", "--output", help="folded output (default stdout)")
+    args = ap.parse_args()
+    info, samples = load(args.profile)
+    stacks = fold(samples, Symbols(args.kernel), args.userdir)
+    print(f"{len(samples)} samples, {info['ncpu']} CPUs, "
+          f"{info['lost']} lost", file=sys.stderr)
+    out = open(args.output, "w") if args.output else sys.stdout
+    for stack, count in sorted(stacks.items()):
+        out.write(f"{stack} {count}\n")
+    if args.output:
+        out.close()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+"""Convert a /bin/trace capture (include/api/trace.h) to Chrome trace JSON.
+
+    tools/trace2json.py trace.bin [-o trace.json]
+
+Load the output in chrome://tracing or ui.perfetto.dev.  Tracks:
+  "CPUs"     one row per CPU: a slice for each stretch a thread ran, from
+             SWITCH to SWITCH; wakeups and migrations as instant markers.
+  "IRQs"     one row per CPU: IRQ_ENTRY..IRQ_EXIT slices.
+  "Threads"  one row per thread: SYS_ENTRY..SYS_EXIT slices.
+The file is the saved header plus events; the trailing padding of the
+pre-sized /etc/trace.bin is ignored.  Get it out of the disk image with
+e.g. `debugfs -R "dump /etc/trace.bin trace.bin" build/disk.img`.
+"""
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b"OS1TRACE"
+VERSION = 1
+HEADER = struct.Struct("<8sII QQIIII")  # struct trace_file_header
+EVENT = struct.Struct("<QHBBIII")       # struct trace_event
+
+EV_SWITCH, EV_WAKEUP, EV_MIGRATE, EV_IRQ_ENTRY, EV_IRQ_EXIT, \
+    EV_SYS_ENTRY, EV_SYS_EXIT = range(7)
+SW_REASONS = ["preempt", "block", "exit", "handoff"]
+
+PID_CPUS, PID_IRQS, PID_THREADS = 1, 2, 3
+
+
+def load(path):
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < HEADER.size:
+        sys.exit(f"{path}: too short for a trace header")
+    magic, version, nevents, clock_hz, lost, mask, ncpu, ring, _ = \
+        HEADER.unpack_from(data, 0)
+    if magic != MAGIC or version != VERSION:
+        sys.exit(f"{path}: not a version {VERSION} trace file")
+    avail = (len(data) - HEADER.size) // EVENT.size
+    if nevents > avail:
+        print(f"warning: header says {nevents} events, file holds {avail}",
+              file=sys.stderr)
+        nevents = avail
+    events = [EVENT.unpack_from(data, HEADER.size + i * EVENT.size)
+              for i in range(nevents)]
+    info = dict(clock_hz=clock_hz, lost=lost, mask=mask, ncpu=ncpu,
+                ring_events=ring)
+    return info, events
+
+
+def convert(info, events):
+    hz = info["clock_hz"] or 1
+    # Per-CPU order is exact; sorted() is stable, so equal stamps keep it.
+    events = sorted(events, key=lambda e: e[0])
+    t0 = events[0][0] if events else 0
+
+    def us(ts):
+        return (ts - t0) * 1e6 / hz
+
+    out = []
+    cpus, threads = set(), set()
+    running = {}   # cpu -> (tid, start ts)
+    irq_open = {}  # cpu -> (irq, start ts)
+
+    def run_slice(cpu, tid, start, end, args):
+        out.append(dict(name=f"tid {tid}" if tid else "idle", ph="X",
+                        pid=PID_CPUS, tid=cpu, ts=us(start),
+                        dur=us(end) - us(start), args=args))
+
+    for ts, typ, cpu, _, pid, a0, a1 in events:
+        cpus.add(cpu)
+        if typ == EV_SWITCH:
+            prev = running.get(cpu)
+            reason = a1 >> 8
+            args = dict(state=a1 & 0xFF,
+                        reason=SW_REASONS[reason] if reason < len(SW_REASONS)
+                        else reason)
+            if prev and prev[0] == pid:
+                run_slice(cpu, pid, prev[1], ts, args)
+            running[cpu] = (a0, ts)
+        elif typ == EV_WAKEUP:
+            out.append(dict(name=f"wakeup {pid}", ph="i", s="t", pid=PID_CPUS,
+                            tid=cpu, ts=us(ts),
+                            args=dict(tid=pid, target_cpu=a0, waker=a1)))
+        elif typ == EV_MIGRATE:
+            out.append(dict(name=f"migrate {pid}", ph="i", s="t", pid=PID_CPUS,
+                            tid=cpu, ts=us(ts),
+                            args=dict(tid=pid, src=a0, dst=a1)))
+        elif typ == EV_IRQ_ENTRY:
+            irq_open[cpu] = (a0, ts)
+        elif typ == EV_IRQ_EXIT:
+            start = irq_open.pop(cpu, None)
+            if start:
+                out.append(dict(name=f"irq {start[0]}", ph="X", pid=PID_IRQS,
+                                tid=cpu, ts=us(start[1]),
+                                dur=us(ts) - us(start[1]), args=dict(tid=pid)))
+        elif typ == EV_SYS_ENTRY:
+            threads.add(pid)
+            out.append(dict(name=f"sys {a0}", ph="B", pid=PID_THREADS, tid=pid,
+                            ts=us(ts), args=dict(cpu=cpu)))
+        elif typ == EV_SYS_EXIT:
+            threads.add(pid)
+            out.append(dict(name=f"sys {a0}", ph="E", pid=PID_THREADS, tid=pid,
+                            ts=us(ts), args=dict(result=a1 - (1 << 32)
+                                                 if a1 & 0x80000000 else a1)))
+
+    # Close the stretches still running when the capture ended.
+    if events:
+        end = events[-1][0]
+        for cpu, (tid, start) in running.items():
+            run_slice(cpu, tid, start, end, dict(open=True))
+
+    meta = [dict(name="process_name", ph="M", pid=PID_CPUS,
+                 args=dict(name="CPUs")),
+            dict(name="process_name", ph="M", pid=PID_IRQS,
+                 args=dict(name="IRQs")),
+            dict(name="process_name", ph="M", pid=PID_THREADS,
+                 args=dict(name="Threads"))]
+    for cpu in sorted(cpus):
+        for pid in (PID_CPUS, PID_IRQS):
+            meta.append(dict(name="thread_name", ph="M", pid=pid, tid=cpu,
+                             args=dict(name=f"CPU {cpu}")))
+    for tid in sorted(threads):
+        meta.append(dict(name="thread_name", ph="M", pid=PID_THREADS, tid=tid,
+                         args=dict(name=f"tid {tid}")))
+    return dict(traceEvents=meta + out, displayTimeUnit="ns",
+                otherData={k: str(v) for k, v in info.items()})
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("trace", help="file written by /bin/trace save")
+    ap.add_argument("-o", "--output", help="JSON output (default stdout)")
+    args = ap.parse_args()
+    info, events = load(args.trace)
+    doc = convert(info, events)
+    print(f"{len(events)} events, {info['ncpu']} CPUs, {info['lost']} lost, "
+          f"clock {info['clock_hz']} Hz", file=sys.stderr)
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(doc, f)
+    else:
+        json.dump(doc, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()
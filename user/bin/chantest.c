@@ -0,0 +1,176 @@
+/*
+ * user/bin/chantest.c
+ * Shared-memory channel test app (SYS_CHANNEL, include/api/channel.h).
+ *
+ * The process serves its own endpoint, so it holds both ends of each
+ * channel: tx from chan_connect(), rx from accepting the offer that the
+ * connect queued for it.  Helper threads take the side that has to block.
+ *   1. roundtrip: bytes written to tx come back from rx in order;
+ *   2. empty: a reader on an empty ring sleeps until a write wakes it;
+ *   3. full: a ring-sized write completes without blocking, the next byte
+ *      blocks its writer until a read makes room, and order is kept;
+ *   4. eof: after tx closes, rx drains what is left, then reads 0;
+ *   5. stream: a writer thread pushes STREAM_BYTES through a
+ *      CHAN_SIZE_MAX ring while we read; the elapsed time gives the
+ *      throughput (compare with pipetest's spawn-stream).
+ * Results go to the window AND the serial console (printf).
+ */
+#include <channel.h>
+#include <endpoint.h>
+#include <os1.h>
+#include <string.h>
+
+#define STREAM_BYTES (8 * 1024 * 1024)
+#define CHUNK 4096
+#define HELPER_STACK 16384
+
+static int failures = 0;
+static char helper_stack[HELPER_STACK] __attribute__((aligned(16)));
+static char big[CHAN_SIZE_MIN];
+
+static void check(int win_id, const char *name, int ok) {
+  printf_win(win_id, "%s: %s\n", name, ok ? "PASS" : "FAIL");
+  printf("[chantest] %s: %s\n", name, ok ? "PASS" : "FAIL");
+  if (!ok)
+    failures++;
+}
+
+/* open_pair - connect through our own endpoint and accept the offer. */
+static int open_pair(int ep, uint32_t size, chan_t *tx, chan_t *rx) {
+  struct ipc_message offer;
+  if (chan_connect(tx, ep, size) != 0)
+    return -1;
+  if (recv(-1, &offer) != 0 || chan_accept(rx, &offer) != 0) {
+    chan_close(tx);
+    return -1;
+  }
+  return 0;
+}
+
+struct helper {
+  chan_t *c;
+  char buf[16];
+  volatile long rc;
+  volatile int done;
+};
+
+static void read_one(void *arg) {
+  struct helper *h = arg;
+  h->rc = chan_read(h->c, h->buf, sizeof(h->buf));
+  h->done = 1;
+}
+
+static void write_one(void *arg) {
+  struct helper *h = arg;
+  h->rc = chan_write(h->c, "!", 1);
+  h->done = 1;
+}
+
+static void write_stream(void *arg) {
+  static char block[CHUNK];
+  memset(block, 'c', sizeof(block));
+  chan_t *c = arg;
+  for (long sent = 0; sent < STREAM_BYTES; sent += CHUNK)
+    if (chan_write(c, block, CHUNK) != CHUNK)
+      break;
+  chan_close(c);
+}
+
+int main(void) {
+  int win_id = create_window(160, 160, 400, 300, "Channel Test");
+  if (win_id < 0)
+    return 1;
+  char name[EP_NAME_MAX];
+  snprintf(name, sizeof(name), "chantest.%d", get_pid());
+  int srv = ep_create(name);
+  int ep = srv >= 0 ? ep_open(name) : -1;
+  chan_t tx = {0}, rx = {0};
+  char buf[64];
+  int ok = ep >= 0 && open_pair(ep, CHAN_SIZE_MIN, &tx, &rx) == 0;
+  check(win_id, "connect/accept", ok);
+  if (!ok)
+    return 1;
+
+  /* 1. in-order round trip */
+  memset(buf, 0, sizeof(buf));
+  ok = chan_write(&tx, "hello, ", 7) == 7 && chan_write(&tx, "chan", 4) == 4 &&
+       chan_read(&rx, buf, sizeof(buf)) == 11 &&
+       memcmp(buf, "hello, chan", 11) == 0;
+  check(win_id, "roundtrip", ok);
+
+  /* 2. a reader on the empty ring sleeps until the write */
+  struct helper h = {&rx, {0}, 0, 0};
+  int tid = thread_create(read_one, &h, helper_stack, HELPER_STACK);
+  ok = tid > 0;
+  if (ok) {
+    sleep(50);
+    ok = !h.done;
+    chan_write(&tx, "wake", 4);
+    thread_join(tid, NULL);
+    ok = ok && h.rc == 4 && memcmp(h.buf, "wake", 4) == 0;
+  }
+  check(win_id, "empty", ok);
+
+  /* 3. fill the ring exactly; one more byte waits for room */
+  for (unsigned i = 0; i < sizeof(big); i++)
+    big[i] = (char)i;
+  ok = chan_write(&tx, big, sizeof(big)) == (long)sizeof(big) &&
+       tx.shm->head - tx.shm->tail == CHAN_SIZE_MIN;
+  h.c = &tx;
+  h.done = 0;
+  tid = ok ? thread_create(write_one, &h, helper_stack, HELPER_STACK) : -1;
+  ok = tid > 0;
+  if (ok) {
+    sleep(50);
+    ok = !h.done;
+    long got = chan_read(&rx, buf, 1);
+    thread_join(tid, NULL);
+    ok = ok && got == 1 && buf[0] == big[0] && h.rc == 1;
+    static char rest[CHAN_SIZE_MIN];
+    long n = 0, rc;
+    while (n < (long)sizeof(rest) &&
+           (rc = chan_read(&rx, rest + n, sizeof(rest) - n)) > 0)
+      n += rc;
+    ok = ok && n == (long)sizeof(rest) &&
+         memcmp(rest, big + 1, sizeof(big) - 1) == 0 &&
+         rest[sizeof(rest) - 1] == '!';
+  }
+  check(win_id, "full", ok);
+
+  /* 4. EOF once the writer is gone */
+  chan_write(&tx, "tail", 4);
+  chan_close(&tx);
+  ok = chan_read(&rx, buf, sizeof(buf)) == 4 && chan_read(&rx, buf, 1) == 0;
+  chan_close(&rx);
+  check(win_id, "eof", ok);
+
+  /* 5. throughput */
+  ok = open_pair(ep, CHAN_SIZE_MAX, &tx, &rx) == 0;
+  tid = ok ? thread_create(write_stream, &tx, helper_stack, HELPER_STACK) : -1;
+  ok = tid > 0;
+  if (ok) {
+    static char block[CHUNK];
+    long t0 = get_time();
+    long total = 0, rc;
+    while ((rc = chan_read(&rx, block, sizeof(block))) > 0)
+      total += rc;
+    long ms = get_time() - t0;
+    thread_join(tid, NULL);
+    ok = total == STREAM_BYTES;
+    if (ok)
+      printf("[chantest] %d KiB in %ld ms (~%ld KiB/s)\n",
+             STREAM_BYTES / 1024, ms,
+             ms > 0 ? (long)STREAM_BYTES / 1024 * 1000 / ms : 0);
+  }
+  chan_close(&rx);
+  check(win_id, "stream", ok);
+
+  ep_close(ep);
+  ep_close(srv);
+  printf_win(win_id, "done: %d failure(s)\n", failures);
+  printf("[chantest] done: %d failure(s)\n", failures);
+
+  for (int i = 0; i < 150; i++)
+    yield();
+  return failures ? 1 : 0;
+}
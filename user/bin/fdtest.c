@@ -14,12 +14,18 @@
  *      back and compare, then restore the original bytes;
  *   4. denials: open("/bin/shell", O_WRONLY) -> -EACCES (user process),
  *      open missing path -> -ENOENT, read/lseek on a closed fd -> -EBADF,
- *      write on an O_RDONLY fd -> -EBADF, O_CREAT -> -EINVAL.
+ *      write on an O_RDONLY fd -> -EBADF, O_CREAT -> -EINVAL;
+ *   5. positional and vectored I/O: pread returns the bytes at an offset
+ *      and leaves the fd's offset alone; preadv / readv scatter the same
+ *      bytes a plain read returns; pwritev gathers two segments into one
+ *      write (read back, then restored with pwrite); pread on stdout ->
+ *      -ESPIPE.
  * Results go to the window AND the serial console (printf).
  */
 #include <fcntl.h>
 #include <os1.h>
 #include <string.h>
+#include <sys/uio.h>
 
 static int failures = 0;
 
@@ -103,6 +109,43 @@ int main(void) {
   ok = open(path, O_RDONLY | O_CREAT) == -EINVAL;
   check(win_id, "einval-o-creat", ok);
 
+  /* 5a. pread at 0 reads the first chunk; fd stays at EOF (from 2.) */
+  memset(c, 0, sizeof(c));
+  ok = fd >= 3 && pread(fd, c, 8, 0) == 8 && memcmp(a, c, 8) == 0 &&
+       lseek(fd, 0, SEEK_CUR) == size;
+  check(win_id, "pread-keeps-offset", ok);
+
+  /* 5b. preadv at 8 (two segments) == the second read of 1.; readv from
+   * the start (uneven segments) == both reads, and advances the offset */
+  char v1[17], v2[17];
+  memset(v1, 0, sizeof(v1));
+  memset(v2, 0, sizeof(v2));
+  struct iovec iv[2] = { { v1, 4 }, { v1 + 4, 4 } };
+  ok = fd >= 3 && preadv(fd, iv, 2, 8) == 8 && memcmp(v1, b, 8) == 0;
+  if (ok) {
+    iv[0].iov_base = v2;
+    iv[0].iov_len = 3;
+    iv[1].iov_base = v2 + 3;
+    iv[1].iov_len = 13;
+    ok = lseek(fd, 0, SEEK_SET) == 0 && readv(fd, iv, 2) == 16 &&
+         memcmp(v2, a, 8) == 0 && memcmp(v2 + 8, b, 8) == 0 &&
+         lseek(fd, 0, SEEK_CUR) == 16;
+  }
+  check(win_id, "preadv+readv", ok);
+
+  /* 5c. pwritev gathers "FD" + "VEC!!!" into one write at 0 */
+  char h[] = "FD", t[] = "VEC!!!";
+  struct iovec wv[2] = { { h, 2 }, { t, 6 } };
+  memset(c, 0, sizeof(c));
+  ok = wfd >= 3 && pwritev(wfd, wv, 2, 0) == 8 && pread(wfd, c, 8, 0) == 8 &&
+       memcmp(c, "FDVEC!!!", 8) == 0;
+  if (wfd >= 3)
+    pwrite(wfd, orig, 8, 0); /* restore */
+  check(win_id, "pwritev-gather", ok);
+
+  ok = pread(1, c, 1, 0) == -ESPIPE;
+  check(win_id, "espipe-on-window", ok);
+
   if (fd >= 0)
     close(fd);
   if (wfd >= 0)
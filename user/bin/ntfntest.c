@@ -0,0 +1,108 @@
+/*
+ * user/bin/ntfntest.c
+ * Kernel event notification test app (NTFN_SUBSCRIBE, include/api/ntfn.h),
+ * and the subscriber it spawns.
+ *
+ * `ntfntest` spawns two `ntfntest sub <ppid>` children.  Each subscribes
+ * a notification object to NTFN_SYS_FOCUS and then serves our requests:
+ * NT_POLL replies with the bits pending since the last poll, NT_FOCUS
+ * claims keyboard focus with set_focus(get_pid()).  The checks:
+ *   1. subscribe: both children subscribed;
+ *   2. focused: after child A claims focus it has NTFN_SYS_FOCUS pending;
+ *   3. bystander: child B, subscribed but neither gaining nor losing
+ *      focus, has nothing pending (focus events go to the two processes
+ *      involved, not to every subscriber).
+ * Results go to the window AND the serial console (printf).
+ */
+#include <ntfn.h>
+#include <os1.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define NT_READY 1
+#define NT_POLL  2
+#define NT_FOCUS 3
+#define NT_EXIT  4
+
+static int failures = 0;
+
+static void check(int win_id, const char *name, int ok) {
+  printf_win(win_id, "%s: %s\n", name, ok ? "PASS" : "FAIL");
+  printf("[ntfntest] %s: %s\n", name, ok ? "PASS" : "FAIL");
+  if (!ok)
+    failures++;
+}
+
+static int sub_main(int ppid) {
+  struct ipc_message m = {0};
+  int h = ntfn_create();
+  int ok = h >= 0 && ntfn_subscribe(h, NTFN_SYS_FOCUS) == 0;
+  m.type = NT_READY;
+  m.data1 = (uint64_t)ok;
+  send(ppid, &m);
+  while (recv(ppid, &m) == 0 && m.type != NT_EXIT) {
+    uint64_t bits = 0;
+    if (m.type == NT_FOCUS)
+      set_focus(get_pid());
+    else if (m.type == NT_POLL)
+      ntfn_poll(h, &bits);
+    m.data1 = bits;
+    send(ppid, &m);
+  }
+  ntfn_close(h);
+  return 0;
+}
+
+/* ask - send request 'type' to child pid and return its reply's data1. */
+static uint64_t ask(int pid, int type) {
+  struct ipc_message m = {0};
+  m.type = type;
+  if (send(pid, &m) != 0 || recv(pid, &m) != 0)
+    return ~0ULL;
+  return m.data1;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 2 && strcmp(argv[1], "sub") == 0)
+    return sub_main(atoi(argv[2]));
+
+  int win_id = create_window(180, 180, 400, 300, "Ntfn Test");
+  if (win_id < 0)
+    return 1;
+  char ppid[16];
+  snprintf(ppid, sizeof(ppid), "%d", get_pid());
+  char name[] = "ntfntest", mode[] = "sub";
+  char *sub_argv[3] = {name, mode, ppid};
+  int a = spawn_args("/bin/ntfntest", 3, sub_argv);
+  int b = spawn_args("/bin/ntfntest", 3, sub_argv);
+  struct ipc_message m;
+  int ok = a > 0 && b > 0 && recv(a, &m) == 0 && m.data1 &&
+           recv(b, &m) == 0 && m.data1;
+  check(win_id, "subscribe", ok);
+
+  if (ok) {
+    /* Start both from nothing pending, then move focus to A. */
+    ask(a, NT_POLL);
+    ask(b, NT_POLL);
+    ask(a, NT_FOCUS);
+    check(win_id, "focused", (ask(a, NT_POLL) & NTFN_SYS_FOCUS) != 0);
+    check(win_id, "bystander", (ask(b, NT_POLL) & NTFN_SYS_FOCUS) == 0);
+    /* Give focus back to our window. */
+    set_focus(get_pid());
+  }
+
+  struct ipc_message bye = {0};
+  bye.type = NT_EXIT;
+  if (a > 0)
+    send(a, &bye);
+  if (b > 0)
+    send(b, &bye);
+  while ((a > 0 && wait(a) == -1) || (b > 0 && wait(b) == -1))
+    yield();
+  printf_win(win_id, "done: %d failure(s)\n", failures);
+  printf("[ntfntest] done: %d failure(s)\n", failures);
+
+  for (int i = 0; i < 150; i++)
+    yield();
+  return failures ? 1 : 0;
+}
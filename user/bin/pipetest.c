@@ -0,0 +1,137 @@
+/*
+ * user/bin/pipetest.c
+ * Pipe test app (FD_PIPE, kernel/pipe.h), and the filter it spawns.
+ *
+ * `pipetest` runs the checks:
+ *   1. pipe() then write / read in one process: the bytes come back in
+ *      order, and a read takes no more than is buffered;
+ *   2. EOF: with the write end closed, read drains what is left, then 0;
+ *   3. EPIPE: with the read end closed, write fails -EPIPE;
+ *   4. O_NONBLOCK: read on an empty pipe -> -EAGAIN; writes of PIPE_BUF
+ *      fill the ring whole-or-nothing until one fails -EAGAIN;
+ *   5. spawn_fds: a `pipetest wc` child gets a pipe as stdin and another
+ *      as stdout; we stream STREAM_BYTES through it and read back its
+ *      count.  The elapsed time gives the throughput.
+ * `pipetest wc` counts stdin bytes up to EOF and prints the total, so
+ * `prog | pipetest wc` works from the shell too.
+ * Results go to the window AND the serial console (printf).
+ */
+#include <fcntl.h>
+#include <os1.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define STREAM_BYTES (1024 * 1024)
+
+static int failures = 0;
+
+static void check(int win_id, const char *name, int ok) {
+  printf_win(win_id, "%s: %s\n", name, ok ? "PASS" : "FAIL");
+  printf("[pipetest] %s: %s\n", name, ok ? "PASS" : "FAIL");
+  if (!ok)
+    failures++;
+}
+
+static int wc_main(void) {
+  static char buf[4096];
+  long total = 0, n;
+  while ((n = read(0, buf, sizeof(buf))) > 0)
+    total += n;
+  printf("%ld\n", total);
+  return n < 0 ? 1 : 0;
+}
+
+int main(int argc, char **argv) {
+  if (argc > 1 && strcmp(argv[1], "wc") == 0)
+    return wc_main();
+
+  int win_id = create_window(140, 140, 400, 300, "Pipe Test");
+  if (win_id < 0)
+    return 1;
+  int fds[2] = {-1, -1}, ok;
+  char buf[64];
+
+  /* 1. in-order round trip; a read takes only what is there */
+  ok = pipe(fds) == 0 && fds[0] >= 3 && fds[1] >= 3;
+  if (ok) {
+    write(fds[1], "hello, ", 7);
+    write(fds[1], "pipe", 4);
+    memset(buf, 0, sizeof(buf));
+    ok = read(fds[0], buf, sizeof(buf)) == 11 &&
+         memcmp(buf, "hello, pipe", 11) == 0;
+  }
+  check(win_id, "roundtrip", ok);
+
+  /* 2. EOF after the last writer closes */
+  if (fds[1] >= 0) {
+    write(fds[1], "tail", 4);
+    close(fds[1]);
+  }
+  ok = read(fds[0], buf, sizeof(buf)) == 4 && read(fds[0], buf, 1) == 0;
+  close(fds[0]);
+  check(win_id, "eof", ok);
+
+  /* 3. EPIPE once no reader is left */
+  ok = pipe(fds) == 0;
+  if (ok) {
+    close(fds[0]);
+    ok = _sys_write(fds[1], "x", 1) == -EPIPE;
+    close(fds[1]);
+  }
+  check(win_id, "epipe", ok);
+
+  /* 4. non-blocking ends: empty read, full ring */
+  ok = pipe2(fds, O_NONBLOCK) == 0 && read(fds[0], buf, 1) == -EAGAIN;
+  if (ok) {
+    static char chunk[PIPE_BUF];
+    long filled = 0, rc;
+    while ((rc = _sys_write(fds[1], chunk, sizeof(chunk))) > 0)
+      filled += rc;
+    ok = rc == -EAGAIN && filled > 0 && filled % PIPE_BUF == 0;
+    close(fds[0]);
+    close(fds[1]);
+  }
+  check(win_id, "nonblock", ok);
+
+  /* 5. stream through a spawned filter */
+  int in[2], out[2];
+  ok = pipe(in) == 0 && pipe(out) == 0;
+  if (ok) {
+    char name[] = "pipetest", mode[] = "wc";
+    char *cargv[2] = {name, mode};
+    int map[2] = {in[0], out[1]};
+    int pid = spawn_fds("/bin/pipetest", 2, cargv, map, 2);
+    close(in[0]);
+    close(out[1]);
+    ok = pid > 0;
+    static char block[4096];
+    memset(block, 'p', sizeof(block));
+    long t0 = get_time();
+    for (int sent = 0; ok && sent < STREAM_BYTES; sent += sizeof(block))
+      write(in[1], block, sizeof(block));
+    close(in[1]); /* EOF for the child */
+    memset(buf, 0, sizeof(buf));
+    long n = 0, rc;
+    while (n < (long)sizeof(buf) - 1 &&
+           (rc = read(out[0], buf + n, sizeof(buf) - 1 - n)) > 0)
+      n += rc;
+    long ticks = get_time() - t0;
+    close(out[0]);
+    ok = ok && strtol(buf, 0, 10) == STREAM_BYTES;
+    if (ok)
+      printf("[pipetest] %d KiB in %ld ticks (~%ld KiB/s)\n",
+             STREAM_BYTES / 1024, ticks,
+             ticks > 0 ? (long)STREAM_BYTES / 1024 * 100 / ticks : 0);
+    if (pid > 0)
+      while (wait(pid) == -1)
+        yield();
+  }
+  check(win_id, "spawn-stream", ok);
+
+  printf_win(win_id, "done: %d failure(s)\n", failures);
+  printf("[pipetest] done: %d failure(s)\n", failures);
+
+  for (int i = 0; i < 150; i++)
+    yield();
+  return failures ? 1 : 0;
+}
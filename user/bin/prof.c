@@ -0,0 +1,194 @@
+/*
+ * user/bin/prof.c
+ * Front end for the sampling profiler (SYS_PROF, include/api/prof.h).
+ *
+ *   prof start [hz]             sample every CPU hz times a second (default
+ *                               PROF_DEFAULT_HZ)
+ *   prof stop                   stop sampling, keep the buffered samples
+ *   prof info                   rate, CPUs, lost samples
+ *   prof save [file]            drain the buffers into file
+ *   prof record <ms> [hz] [file]
+ *                               start, drain while ms elapse, stop, save
+ *
+ * file defaults to PROF_FILE (/etc/prof.bin), pre-sized in the rootfs like
+ * /etc/trace.bin because the filesystem cannot create files: the struct
+ * prof_file_header, then the samples.  Copy it off the disk image and run
+ * tools/prof2folded.py on it for flamegraph.pl or speedscope.
+ *
+ * A kernel built with PROF_BOOT=<hz> samples from boot; `prof save` then
+ * captures the last PROF_RING_SAMPLES per CPU of it.
+ */
+#include <os1.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PROF_FILE      "/etc/prof.bin"
+#define RECORD_POLL_MS 50
+#define WRITE_CHUNK    16384
+
+struct capture {
+  struct prof_sample *s;
+  int n, max;
+};
+
+static int capture_init(struct capture *c, const char *path) {
+  int size = file_read(path, NULL, 0, 0);
+  if (size < (int)sizeof(struct prof_file_header)) {
+    printf("prof: %s missing or too small (%d)\n", path, size);
+    return -1;
+  }
+  c->n = 0;
+  c->max = (size - (int)sizeof(struct prof_file_header)) /
+           (int)sizeof(struct prof_sample);
+  c->s = NULL;
+  while (c->max > 0 &&
+         !(c->s = malloc((size_t)c->max * sizeof(struct prof_sample))))
+    c->max /= 2;
+  if (!c->s) {
+    printf("prof: out of memory\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* drain - pull samples until the kernel has none left or c is full. */
+static long drain(struct capture *c) {
+  while (c->n < c->max) {
+    unsigned long room = (unsigned long)(c->max - c->n) * sizeof(*c->s);
+    long got = prof_ctl(PROF_READ, (unsigned long)(c->s + c->n), room);
+    if (got < 0)
+      return got;
+    if (got == 0)
+      break;
+    c->n += (int)(got / (long)sizeof(struct prof_sample));
+  }
+  return 0;
+}
+
+static int save(struct capture *c, const char *path) {
+  struct prof_file_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, PROF_FILE_MAGIC, sizeof(h.magic));
+  h.version = PROF_FILE_VERSION;
+  h.nsamples = (uint32_t)c->n;
+  long rc = prof_ctl(PROF_INFO, (unsigned long)&h.info, 0);
+  if (rc < 0)
+    return (int)rc;
+  int off = (int)sizeof(h);
+  const char *p = (const char *)c->s;
+  int left = c->n * (int)sizeof(struct prof_sample);
+  while (left > 0) {
+    int chunk = left < WRITE_CHUNK ? left : WRITE_CHUNK;
+    int w = file_write(path, p, chunk, off);
+    if (w < 0)
+      return w;
+    p += chunk;
+    off += chunk;
+    left -= chunk;
+  }
+  /* Header last: a short write leaves the old count, not a bogus one. */
+  int w = file_write(path, &h, (int)sizeof(h), 0);
+  if (w < 0)
+    return w;
+  printf("prof: %d samples -> %s (%lu lost%s)\n", c->n, path,
+         (unsigned long)h.info.lost, c->n == c->max ? ", file full" : "");
+  return 0;
+}
+
+static int cmd_save(const char *path) {
+  struct capture c;
+  if (capture_init(&c, path) != 0)
+    return 1;
+  long rc = drain(&c);
+  if (rc == 0)
+    rc = save(&c, path);
+  free(c.s);
+  if (rc < 0) {
+    printf("prof: save failed (%d)\n", (int)rc);
+    return 1;
+  }
+  return 0;
+}
+
+static int cmd_record(long ms, unsigned long hz, const char *path) {
+  struct capture c;
+  if (capture_init(&c, path) != 0)
+    return 1;
+  long rc = prof_ctl(PROF_START, hz, 0);
+  if (rc == 0) {
+    long end = get_time() + ms;
+    while (rc == 0 && get_time() < end && c.n < c.max) {
+      sleep(RECORD_POLL_MS);
+      rc = drain(&c);
+    }
+    prof_ctl(PROF_STOP, 0, 0);
+    if (rc == 0)
+      rc = drain(&c);
+    if (rc == 0)
+      rc = save(&c, path);
+  }
+  free(c.s);
+  if (rc < 0) {
+    printf("prof: record failed (%d)\n", (int)rc);
+    return 1;
+  }
+  return 0;
+}
+
+static int cmd_info(void) {
+  struct prof_info info;
+  long rc = prof_ctl(PROF_INFO, (unsigned long)&info, 0);
+  if (rc < 0) {
+    printf("prof: info failed (%d)\n", (int)rc);
+    return 1;
+  }
+  printf("prof: %u Hz, %u CPUs x %u samples, clock %lu Hz, %lu lost\n",
+         info.hz, info.ncpu, info.ring_samples, (unsigned long)info.clock_hz,
+         (unsigned long)info.lost);
+  return 0;
+}
+
+static void usage(void) {
+  printf("usage: prof start [hz] | stop | info | save [file]\n"
+         "       prof record <ms> [hz] [file]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+  const char *cmd = argv[1];
+  if (strcmp(cmd, "start") == 0) {
+    unsigned long hz = argc > 2 ? (unsigned long)strtol(argv[2], NULL, 0) : 0;
+    long rc = prof_ctl(PROF_START, hz, 0);
+    if (rc < 0) {
+      printf("prof: start failed (%d)\n", (int)rc);
+      return 1;
+    }
+    return 0;
+  }
+  if (strcmp(cmd, "stop") == 0) {
+    long rc = prof_ctl(PROF_STOP, 0, 0);
+    if (rc < 0) {
+      printf("prof: stop failed (%d)\n", (int)rc);
+      return 1;
+    }
+    return cmd_info();
+  }
+  if (strcmp(cmd, "info") == 0)
+    return cmd_info();
+  if (strcmp(cmd, "save") == 0)
+    return cmd_save(argc > 2 ? argv[2] : PROF_FILE);
+  if (strcmp(cmd, "record") == 0 && argc > 2) {
+    long ms = strtol(argv[2], NULL, 0);
+    unsigned long hz = argc > 3 ? (unsigned long)strtol(argv[3], NULL, 0) : 0;
+    if (ms <= 0) {
+      usage();
+      return 1;
+    }
+    return cmd_record(ms, hz, argc > 4 ? argv[4] : PROF_FILE);
+  }
+  usage();
+  return 1;
+}
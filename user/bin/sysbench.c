@@ -0,0 +1,147 @@
+/*
+ * user/bin/sysbench.c
+ * Null-syscall latency: average cost of the cheapest call on each kernel
+ * entry path.
+ *
+ *   getpid      SYSCALL_LEAN entry (kernel/syscall.h): no pt_regs is
+ *               built; on amd64 the return is sysretq, on aarch64 eret
+ *               straight from the vector stub.
+ *   lseek(-1)   full path: pt_regs frame, table dispatch, fails -EBADF at
+ *               once; on amd64 it also leaves through sysretq.
+ *   uring       getpid queued on a SYS_URING ring, URING_BATCH per
+ *               URING_ENTER (include/api/uring.h): the trap amortised.
+ *
+ * The getpid / lseek(-1) gap is what the lean path saves over building
+ * and dispatching a frame, on the same boot and the same CPU.
+ *
+ * With a thread count, the same getpid loop with a yield() every
+ * YIELD_EVERY calls (a pass through this CPU's scheduler and runqueue)
+ * then runs on 1 and on N threads at once.  Neither call needs anything
+ * another CPU owns, so on N CPUs the ideal is the same wall time; anything
+ * the CPUs still share on those paths (a global counter, a runqueue line
+ * next to another CPU's hot fields) shows up as the N-thread time growing.
+ * Compare builds on the same machine, e.g. before and after a per-CPU
+ * change.
+ *
+ * Usage: sysbench [iterations] [threads]   (default 1000000, 0: no SMP
+ * runs; at most SMP_MAX_THREADS).  Timing uses get_time() (milliseconds),
+ * so keep the run well above a few hundred ms.
+ */
+#include <os1.h>
+#include <uring.h>
+
+#define URING_BATCH 32
+#define SMP_MAX_THREADS 15 /* 16 per process, main included */
+#define SMP_STACK 16384
+#define YIELD_EVERY 16     /* one yield() per this many getpids */
+
+static char smp_stacks[SMP_MAX_THREADS][SMP_STACK]
+    __attribute__((aligned(16)));
+
+static long run(int which, long iters) {
+  long t0 = get_time();
+  for (long i = 0; i < iters; i++) {
+    if (which == 0)
+      (void)_sys_get_pid();
+    else
+      (void)_sys_lseek(-1, 0, 0);
+  }
+  return get_time() - t0;
+}
+
+/* run_uring - iters getpid calls through the ring, URING_BATCH at a time;
+ * -1 if the ring cannot be set up. */
+static long run_uring(long iters) {
+  uring_t u;
+  if (uring_init(&u, URING_BATCH, 0) != 0)
+    return -1;
+  long t0 = get_time();
+  for (long done = 0; done < iters;) {
+    long n = iters - done < URING_BATCH ? iters - done : URING_BATCH;
+    for (long i = 0; i < n; i++)
+      uring_get_sqe(&u, SYS_GETPID, (uint64_t)i);
+    uring_submit(&u);
+    struct uring_cqe *cqe;
+    while (uring_peek_cqe(&u, &cqe) == 0)
+      uring_cqe_seen(&u);
+    done += n;
+  }
+  long ms = get_time() - t0;
+  uring_exit(&u);
+  return ms;
+}
+
+static void smp_worker(void *arg) {
+  long iters = *(long *)arg;
+  for (long i = 0; i < iters; i++) {
+    (void)_sys_get_pid();
+    if (i % YIELD_EVERY == 0)
+      yield();
+  }
+}
+
+/* run_smp - wall time for nthreads workers of iters each; -1 on failure. */
+static long run_smp(int nthreads, long iters) {
+  int tids[SMP_MAX_THREADS];
+  int started = 0;
+  long t0 = get_time();
+  for (; started < nthreads; started++) {
+    tids[started] = thread_create(smp_worker, &iters, smp_stacks[started],
+                                  SMP_STACK);
+    if (tids[started] < 0)
+      break;
+  }
+  for (int i = 0; i < started; i++)
+    thread_join(tids[i], NULL);
+  long ms = get_time() - t0;
+  return started == nthreads ? ms : -1;
+}
+
+static long parse_num(const char *p) {
+  long n = 0;
+  for (; *p >= '0' && *p <= '9'; p++)
+    n = n * 10 + (*p - '0');
+  return n;
+}
+
+static void report(const char *name, long ms, long iters) {
+  /* ns per call, in integer math: ms * 1e6 / iters */
+  long ns = iters > 0 ? (ms * 1000000L) / iters : 0;
+  printf("[sysbench] %s: %d calls in %d ms, %d ns/call\n", name, (int)iters,
+         (int)ms, (int)ns);
+}
+
+int main(int argc, char **argv) {
+  long iters = 1000000;
+  int threads = 0;
+  if (argc > 1) {
+    long n = parse_num(argv[1]);
+    if (n > 0)
+      iters = n;
+  }
+  if (argc > 2) {
+    threads = (int)parse_num(argv[2]);
+    if (threads > SMP_MAX_THREADS)
+      threads = SMP_MAX_THREADS;
+  }
+  (void)run(0, iters / 10); /* warm up */
+  report("getpid (lean)", run(0, iters), iters);
+  report("lseek(-1) (full)", run(1, iters), iters);
+  long ms = run_uring(iters);
+  if (ms >= 0)
+    report("getpid (uring x32)", ms, iters);
+  if (threads > 0) {
+    long one = run_smp(1, iters);
+    long all = run_smp(threads, iters);
+    if (one < 0 || all < 0) {
+      printf("[sysbench] smp: thread_create failed\n");
+      return 1;
+    }
+    report("smp getpid+yield, 1 thread", one, iters);
+    report("smp getpid+yield, per thread", all, iters);
+    /* 100 = perfect scaling: N threads took as long as one */
+    printf("[sysbench] smp: %d threads, scaling %d%%\n", threads,
+           (int)(all > 0 ? one * 100 / all : 100));
+  }
+  return 0;
+}
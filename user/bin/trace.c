@@ -0,0 +1,199 @@
+/*
+ * user/bin/trace.c
+ * Front end for scheduler event tracing (SYS_TRACE, include/api/trace.h).
+ *
+ *   trace start [mask]          record the event types in mask (default
+ *                               TRACE_MASK_ALL; 0x.. hex accepted)
+ *   trace stop                  stop recording, keep the buffered events
+ *   trace info                  clock, CPUs, lost events, current mask
+ *   trace save [file]           drain the buffers into file
+ *   trace record <ms> [mask] [file]
+ *                               start, drain while ms elapse, stop, save
+ *
+ * file defaults to TRACE_FILE (/etc/trace.bin).  The filesystem cannot
+ * create files, so the rootfs ships it pre-sized (Makefile) and save
+ * overwrites it in place: the struct trace_file_header, then the events.
+ * Whatever does not fit is left in the kernel buffers.  Copy the file off
+ * the disk image and run tools/trace2json.py on it for chrome://tracing or
+ * Perfetto.
+ *
+ * record drains every RECORD_POLL_MS so the per-CPU rings (TRACE_RING_EVENTS
+ * each) do not fill; the tracer's own wakeups and syscalls show up in the
+ * trace.
+ */
+#include <os1.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TRACE_FILE     "/etc/trace.bin"
+#define RECORD_POLL_MS 20
+#define WRITE_CHUNK    16384
+
+struct capture {
+  struct trace_event *ev;
+  int n, max;
+};
+
+static int capture_init(struct capture *c, const char *path) {
+  int size = file_read(path, NULL, 0, 0);
+  if (size < (int)sizeof(struct trace_file_header)) {
+    printf("trace: %s missing or too small (%d)\n", path, size);
+    return -1;
+  }
+  c->n = 0;
+  c->max = (size - (int)sizeof(struct trace_file_header)) /
+           (int)sizeof(struct trace_event);
+  c->ev = NULL;
+  while (c->max > 0 &&
+         !(c->ev = malloc((size_t)c->max * sizeof(struct trace_event))))
+    c->max /= 2;
+  if (!c->ev) {
+    printf("trace: out of memory\n");
+    return -1;
+  }
+  return 0;
+}
+
+/* drain - pull events until the kernel has none left or c is full. */
+static long drain(struct capture *c) {
+  while (c->n < c->max) {
+    unsigned long room = (unsigned long)(c->max - c->n) * sizeof(*c->ev);
+    long got = trace_ctl(TRACE_READ, (unsigned long)(c->ev + c->n), room);
+    if (got < 0)
+      return got;
+    if (got == 0)
+      break;
+    c->n += (int)(got / (long)sizeof(struct trace_event));
+  }
+  return 0;
+}
+
+static int save(struct capture *c, const char *path) {
+  struct trace_file_header h;
+  memset(&h, 0, sizeof(h));
+  memcpy(h.magic, TRACE_FILE_MAGIC, sizeof(h.magic));
+  h.version = TRACE_FILE_VERSION;
+  h.nevents = (uint32_t)c->n;
+  long rc = trace_ctl(TRACE_INFO, (unsigned long)&h.info, 0);
+  if (rc < 0)
+    return (int)rc;
+  int off = (int)sizeof(h);
+  const char *p = (const char *)c->ev;
+  int left = c->n * (int)sizeof(struct trace_event);
+  while (left > 0) {
+    int chunk = left < WRITE_CHUNK ? left : WRITE_CHUNK;
+    int w = file_write(path, p, chunk, off);
+    if (w < 0)
+      return w;
+    p += chunk;
+    off += chunk;
+    left -= chunk;
+  }
+  /* Header last: a short write leaves the old count, not a bogus one. */
+  int w = file_write(path, &h, (int)sizeof(h), 0);
+  if (w < 0)
+    return w;
+  printf("trace: %d events -> %s (%lu lost%s)\n", c->n, path,
+         (unsigned long)h.info.lost, c->n == c->max ? ", file full" : "");
+  return 0;
+}
+
+static int cmd_save(const char *path) {
+  struct capture c;
+  if (capture_init(&c, path) != 0)
+    return 1;
+  long rc = drain(&c);
+  if (rc == 0)
+    rc = save(&c, path);
+  free(c.ev);
+  if (rc < 0) {
+    printf("trace: save failed (%d)\n", (int)rc);
+    return 1;
+  }
+  return 0;
+}
+
+static int cmd_record(long ms, unsigned long mask, const char *path) {
+  struct capture c;
+  if (capture_init(&c, path) != 0)
+    return 1;
+  long rc = trace_ctl(TRACE_START, mask, 0);
+  if (rc == 0) {
+    long end = get_time() + ms;
+    while (rc == 0 && get_time() < end && c.n < c.max) {
+      sleep(RECORD_POLL_MS);
+      rc = drain(&c);
+    }
+    trace_ctl(TRACE_STOP, 0, 0);
+    if (rc == 0)
+      rc = drain(&c);
+    if (rc == 0)
+      rc = save(&c, path);
+  }
+  free(c.ev);
+  if (rc < 0) {
+    printf("trace: record failed (%d)\n", (int)rc);
+    return 1;
+  }
+  return 0;
+}
+
+static int cmd_info(void) {
+  struct trace_info info;
+  long rc = trace_ctl(TRACE_INFO, (unsigned long)&info, 0);
+  if (rc < 0) {
+    printf("trace: info failed (%d)\n", (int)rc);
+    return 1;
+  }
+  printf("trace: mask 0x%x, %u CPUs x %u events, clock %lu Hz, %lu lost\n",
+         info.mask, info.ncpu, info.ring_events, (unsigned long)info.clock_hz,
+         (unsigned long)info.lost);
+  return 0;
+}
+
+static void usage(void) {
+  printf("usage: trace start [mask] | stop | info | save [file]\n"
+         "       trace record <ms> [mask] [file]\n");
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    usage();
+    return 1;
+  }
+  const char *cmd = argv[1];
+  if (strcmp(cmd, "start") == 0) {
+    unsigned long mask =
+        argc > 2 ? (unsigned long)strtol(argv[2], NULL, 0) : TRACE_MASK_ALL;
+    long rc = trace_ctl(TRACE_START, mask, 0);
+    if (rc < 0) {
+      printf("trace: start failed (%d)\n", (int)rc);
+      return 1;
+    }
+    return 0;
+  }
+  if (strcmp(cmd, "stop") == 0) {
+    long rc = trace_ctl(TRACE_STOP, 0, 0);
+    if (rc < 0) {
+      printf("trace: stop failed (%d)\n", (int)rc);
+      return 1;
+    }
+    return cmd_info();
+  }
+  if (strcmp(cmd, "info") == 0)
+    return cmd_info();
+  if (strcmp(cmd, "save") == 0)
+    return cmd_save(argc > 2 ? argv[2] : TRACE_FILE);
+  if (strcmp(cmd, "record") == 0 && argc > 2) {
+    long ms = strtol(argv[2], NULL, 0);
+    unsigned long mask =
+        argc > 3 ? (unsigned long)strtol(argv[3], NULL, 0) : TRACE_MASK_ALL;
+    if (ms <= 0) {
+      usage();
+      return 1;
+    }
+    return cmd_record(ms, mask, argc > 4 ? argv[4] : TRACE_FILE);
+  }
+  usage();
+  return 1;
+}
@@ -0,0 +1,147 @@
+/*
+ * user/bin/uringtest.c
+ * Syscall ring test app (SYS_URING, include/api/uring.h).
+ *   1. batch: one URING_ENTER runs a mix of SQEs -- getpid, a pipe write
+ *      and the read of it, a read of the then empty pipe, a call the ring
+ *      refuses, an unknown number and an SQE with flags set -- and each
+ *      CQE carries the right result;
+ *   2. order: the CQEs come back in submission order (the read sees the
+ *      bytes the write before it queued);
+ *   3. cq-full: with the CQ full the kernel stops early and leaves the
+ *      rest queued; once CQEs are reaped the next submit runs them;
+ *   4. sqpoll: an idle poller sets URING_SQ_NEED_WAKEUP and sleeps, and a
+ *      submit wakes it to run the new SQE.
+ * Results go to the window AND the serial console (printf).
+ */
+#include <errno.h>
+#include <fcntl.h>
+#include <os1.h>
+#include <string.h>
+#include <uring.h>
+
+#define ENTRIES 8 /* CQ: 2 * ENTRIES */
+
+static int failures = 0;
+
+static void check(int win_id, const char *name, int ok) {
+  printf_win(win_id, "%s: %s\n", name, ok ? "PASS" : "FAIL");
+  printf("[uringtest] %s: %s\n", name, ok ? "PASS" : "FAIL");
+  if (!ok)
+    failures++;
+}
+
+/* queue - one SQE for op with up to three arguments; 0 if the SQ is full. */
+static int queue(uring_t *u, uint32_t op, uint64_t ud, uint64_t a0,
+                 uint64_t a1, uint64_t a2) {
+  struct uring_sqe *s = uring_get_sqe(u, op, ud);
+  if (!s)
+    return 0;
+  s->args[0] = a0;
+  s->args[1] = a1;
+  s->args[2] = a2;
+  return 1;
+}
+
+/* reap - take every posted CQE; returns the count. */
+static int reap(uring_t *u) {
+  struct uring_cqe *cqe;
+  int n = 0;
+  while (uring_peek_cqe(u, &cqe) == 0) {
+    uring_cqe_seen(u);
+    n++;
+  }
+  return n;
+}
+
+int main(void) {
+  int win_id = create_window(200, 200, 400, 300, "Uring Test");
+  if (win_id < 0)
+    return 1;
+  uring_t u;
+  int fds[2];
+  char buf[16];
+  int ok = uring_init(&u, ENTRIES, 0) == 0 && pipe2(fds, O_NONBLOCK) == 0;
+  check(win_id, "setup", ok);
+  if (!ok)
+    return 1;
+
+  /* 1, 2. a mixed batch, one trap */
+  static const char msg[] = "ring";
+  memset(buf, 0, sizeof(buf));
+  const int64_t want[7] = {get_pid(), 4,      4,      -EAGAIN,
+                           -EINVAL,   -ENOSYS, -EINVAL};
+  queue(&u, SYS_GETPID, 0, 0, 0, 0);
+  queue(&u, SYS_WRITE, 1, (uint64_t)fds[1], (uint64_t)(uintptr_t)msg, 4);
+  queue(&u, SYS_READ, 2, (uint64_t)fds[0], (uint64_t)(uintptr_t)buf,
+        sizeof(buf));
+  queue(&u, SYS_READ, 3, (uint64_t)fds[0], (uint64_t)(uintptr_t)buf,
+        sizeof(buf));
+  queue(&u, SYS_YIELD, 4, 0, 0, 0); /* may sleep: not for the ring */
+  queue(&u, 0xffff, 5, 0, 0, 0);
+  struct uring_sqe *s = uring_get_sqe(&u, SYS_GETPID, 6);
+  if (s)
+    s->flags = 1;
+  long n = uring_submit(&u);
+  int results = n == 7, order = n == 7;
+  for (int i = 0; i < 7; i++) {
+    struct uring_cqe *cqe;
+    if (uring_peek_cqe(&u, &cqe) != 0) {
+      results = order = 0;
+      break;
+    }
+    if (cqe->user_data != (uint64_t)i)
+      order = 0;
+    else if (cqe->res != want[i])
+      results = 0;
+    uring_cqe_seen(&u);
+  }
+  check(win_id, "batch", results);
+  check(win_id, "order", order && memcmp(buf, msg, 4) == 0);
+  close(fds[0]);
+  close(fds[1]);
+
+  /* 3. fill the CQ (2 * ENTRIES), then one SQE more than it holds */
+  int queued = 0;
+  for (int i = 0; i < ENTRIES; i++)
+    queued += queue(&u, SYS_GETPID, 100 + i, 0, 0, 0);
+  long first = uring_submit(&u);
+  for (int i = 0; i < ENTRIES; i++)
+    queued += queue(&u, SYS_GETPID, 200 + i, 0, 0, 0);
+  long second = uring_submit(&u);
+  queued += queue(&u, SYS_GETPID, 300, 0, 0, 0);
+  long stopped = uring_submit(&u);
+  int full = reap(&u);
+  long resumed = uring_submit(&u);
+  struct uring_cqe *cqe;
+  ok = queued == 2 * ENTRIES + 1 && first == ENTRIES && second == ENTRIES &&
+       stopped == 0 && full == 2 * ENTRIES && resumed == 1 &&
+       uring_peek_cqe(&u, &cqe) == 0 && cqe->user_data == 300 &&
+       cqe->res == get_pid();
+  if (ok)
+    uring_cqe_seen(&u);
+  check(win_id, "cq-full", ok);
+  uring_exit(&u);
+
+  /* 4. SQPOLL: let the poller go idle, then wake it with a submit */
+  ok = uring_init(&u, ENTRIES, URING_SETUP_SQPOLL) == 0;
+  if (ok) {
+    sleep(50); /* well past URING_SQPOLL_IDLE_MS */
+    int idle = (__atomic_load_n(&u.shm->sq_flags, __ATOMIC_ACQUIRE) &
+                URING_SQ_NEED_WAKEUP) != 0;
+    queue(&u, SYS_GETPID, 400, 0, 0, 0);
+    uring_submit(&u);
+    ok = idle && uring_wait_cqe(&u, &cqe) == 0 && cqe->user_data == 400 &&
+         cqe->res == get_pid();
+    if (ok)
+      uring_cqe_seen(&u);
+    uring_exit(&u);
+  }
+  check(win_id, "sqpoll", ok);
+
+  printf_win(win_id, "done: %d failure(s)\n", failures);
+  printf("[uringtest] done: %d failure(s)\n", failures);
+
+  for (int i = 0; i < 150; i++)
+    yield();
+  return failures ? 1 : 0;
+}
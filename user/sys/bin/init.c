@@ -4,79 +4,219 @@
  *
  * This is the first userland process launched by the kernel after boot.
  * It is responsible for:
- *   1. Spawning the two mandatory system services (notify_srv, shell) in order.
+ *   1. Spawning the services listed in /etc/init.cfg, in order, at their
+ *      configured privilege level and scheduling class.
  *   2. Sending the "Boot Complete" notification via IPC to notify_srv.
- *   3. Running a non-blocking supervisor loop that detects child exits and
- *      respawns the dead service immediately.
+ *   3. Running a supervisor loop that sleeps until a child exits
+ *      (NTFN_SYS_CHILD) and respawns the dead service immediately (same
+ *      level and class).
+ *
+ * init.cfg: one service per line, '#' starts a comment:
+ *   <path> [level=machine|root|user|guest] [rt=<prio>:<runtime_ms>/<period_ms>]
+ * level defaults to user.  rt= puts the service's main thread in SCHED_RT
+ * (include/api/sched.h) with that priority and reservation; a reservation
+ * the kernel does not admit is reported and the service runs SCHED_NORMAL.
+ * Without a readable init.cfg the built-in list (notify_srv, shell) is used.
  *
  * Calling convention / runtime:
  *   _start (user/arch/<arch>/syscall.S) sets up the stack and calls main();
  *   main() never returns (the supervisor loop is infinite).
  *
  * Known issues:
- *   USR-INIT-01  (W1 REFINE) Supervisor is a correct non-blocking poll today;
+ *   USR-INIT-01  (W1 REFINE) Supervisor is event-driven (NTFN_SYS_CHILD);
  *                the PID-reuse hazard is NOT live — next_pid is a monotonic
  *                counter (kernel/sched/process.c:20,233); PIDs are never
  *                recycled.  A generation/owner check would be needed if PID
  *                recycling is ever introduced.
- *   USR-INIT-02  (W3 MISSING·DOC) init.cfg is never read despite the TODO
- *                comment below being stale: file_read (lib.c:72) is fully
- *                implemented and used elsewhere.  The paths in init.cfg
- *                (/notify_srv.elf, /shell) do not match the actual rootfs
- *                layout (/sys/bin/notify_srv, /sys/bin/shell).
+ *   USR-INIT-02  RESOLVED — init.cfg is read at boot, and lists the real
+ *                rootfs paths (/sys/bin/notify_srv, /sys/bin/shell).
  *   USR-INIT-03  (W2 BAD-IMPL) No respawn rate-limiting: a service that
  *                crashes immediately will be respawned in a tight loop,
  *                saturating the process table (MAX_PROCESSES=64, os1.h:16)
  *                with zombies until the system stalls.
- *   USR-SEC-01   (W3 SECURITY) notify_srv writes its PID to the global registry
- *                key "srv.notify_pid" with no authentication; any process can
- *                overwrite that key to hijack all system notifications.
+ *   USR-SEC-01   RESOLVED — notify_srv used to publish its PID in the
+ *                unauthenticated registry key "srv.notify_pid".  It is now
+ *                spawned at machine level and binds the kernel endpoint
+ *                "srv.notify", a namespace other levels cannot bind.
  */
+#include <ctype.h>
+#include <ntfn.h>
 #include <os1.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_SERVICES 8
+
+struct service {
+  char path[64];
+  int level;
+  int rt; /* attr holds a SCHED_RT reservation */
+  struct sched_attr attr;
+  int pid;
+};
+
+static struct service services[MAX_SERVICES];
+static int nservices = 0;
+
+static const char *const level_names[PLVL_COUNT] = {
+    [PLVL_MACHINE] = "machine",
+    [PLVL_ROOT] = "root",
+    [PLVL_USER] = "user",
+    [PLVL_GUEST] = "guest",
+};
+
+/* parse_option - apply one "key=value" word of a service line; 0 if it is
+ * not understood. */
+static int parse_option(struct service *sv, const char *w) {
+  if (strncmp(w, "level=", 6) == 0) {
+    for (int i = 0; i < PLVL_COUNT; i++) {
+      if (strcmp(w + 6, level_names[i]) == 0) {
+        sv->level = i;
+        return 1;
+      }
+    }
+    return 0;
+  }
+  if (strncmp(w, "rt=", 3) == 0) {
+    char *end;
+    long prio = strtol(w + 3, &end, 10);
+    if (*end != ':')
+      return 0;
+    long runtime = strtol(end + 1, &end, 10);
+    if (*end != '/')
+      return 0;
+    long period = strtol(end + 1, &end, 10);
+    if (*end != '\0' || prio < 0 || runtime <= 0 || period <= 0)
+      return 0;
+    sv->rt = 1;
+    sv->attr.policy = SCHED_RT;
+    sv->attr.rt_prio = (uint32_t)prio;
+    sv->attr.runtime_ms = (uint32_t)runtime;
+    sv->attr.period_ms = (uint32_t)period;
+    return 1;
+  }
+  return 0;
+}
+
+/* parse_line - add the service described by one init.cfg line (modified in
+ * place).  Blank and comment lines are skipped. */
+static void parse_line(char *line) {
+  char *hash = strchr(line, '#');
+  if (hash)
+    *hash = '\0';
+  struct service *sv = &services[nservices];
+  memset(sv, 0, sizeof(*sv));
+  sv->level = PLVL_USER;
+  int words = 0;
+  char *p = line;
+  while (*p) {
+    while (isspace((unsigned char)*p))
+      p++;
+    if (!*p)
+      break;
+    char *w = p;
+    while (*p && !isspace((unsigned char)*p))
+      p++;
+    if (*p)
+      *p++ = '\0';
+    if (words++ == 0) {
+      strncpy(sv->path, w, sizeof(sv->path) - 1);
+    } else if (!parse_option(sv, w)) {
+      printf("[Init] init.cfg: ignoring '%s' for %s\n", w, sv->path);
+    }
+  }
+  if (words == 0)
+    return;
+  /* Only absolute paths: test apps scribble on this file (writetest). */
+  if (sv->path[0] != '/') {
+    printf("[Init] init.cfg: ignoring line '%s'\n", sv->path);
+    return;
+  }
+  if (nservices < MAX_SERVICES)
+    nservices++;
+}
+
+static void load_config(void) {
+  static char buf[1024];
+  int n = file_read("/etc/init.cfg", buf, sizeof(buf) - 1, 0);
+  if (n > 0) {
+    buf[n] = '\0';
+    char *line = buf;
+    while (line && *line) {
+      char *nl = strchr(line, '\n');
+      if (nl)
+        *nl = '\0';
+      parse_line(line);
+      line = nl ? nl + 1 : 0;
+    }
+  }
+  if (nservices == 0) {
+    print("[Init] No usable /etc/init.cfg, using the built-in services\n");
+    char notify[] = "/sys/bin/notify_srv level=machine";
+    char shell[] = "/sys/bin/shell";
+    parse_line(notify);
+    parse_line(shell);
+  }
+}
+
+/* start - spawn one service and apply its scheduling class. */
+static void start(struct service *sv) {
+  sv->pid = sv->level == PLVL_USER ? spawn(sv->path)
+                                   : (int)spawn_level(sv->path, sv->level);
+  if (sv->pid <= 0) {
+    printf("[Init] Failed to spawn %s!\n", sv->path);
+    return;
+  }
+  printf("[Init] %s started (PID %d)\n", sv->path, sv->pid);
+  if (!sv->rt)
+    return;
+  int rc = sched_setattr(sv->pid, &sv->attr);
+  if (rc < 0)
+    printf("[Init] %s: SCHED_RT %u:%u/%u refused (%d), running normal\n",
+           sv->path, sv->attr.rt_prio, sv->attr.runtime_ms,
+           sv->attr.period_ms, rc);
+  else
+    printf("[Init] %s: SCHED_RT prio %u, %u ms every %u ms\n", sv->path,
+           sv->attr.rt_prio, sv->attr.runtime_ms, sv->attr.period_ms);
+}
 
 /*
  * main - init entry point; never returns.
  *
- * Spawns notify_srv and shell, fires the "boot complete" notification, then
- * enters the supervisor loop.
+ * Spawns the configured services, fires the "boot complete" notification,
+ * then enters the supervisor loop.
  *
  * No parameters, no meaningful return value (return 0 is unreachable dead code
  * because the while(1) loop never exits).
  *
  * Side effects:
- *   - Creates two child processes via SYS_SPAWN.
+ *   - Creates one child process per service via SYS_SPAWN / SYS_SPAWN_CAPS
+ *     and sets the class of those marked rt= (SYS_SCHED_SETATTR).
  *   - Sends one IPC notify message to the notification server.
+ *   - Creates a notification object subscribed to NTFN_SYS_CHILD.
  *   - Calls SYS_FLUSH to push any buffered output before entering the loop.
  */
 int main(void) {
   print("[Init] System Initialization Starting...\n");
 
-  /* Spawn Notification Server */
-  /* Spawn Notification Server */
-  /* NOTE(USR-INIT-02): Hardcoded path.  init.cfg would provide this path but
-   * is never read; the cfg also lists wrong paths (see file header). */
-  printf("[Init] Spawning Notification Server...\n");
-  int pid_notify = spawn("/sys/bin/notify_srv");
-  if (pid_notify > 0) {
-    printf("[Init] Notification Server started (PID %d)\n", pid_notify);
-  } else {
-    print("[Init] Failed to spawn Notification Server!\n");
+  load_config();
+  /* Subscribed before the first spawn, so no exit can be missed. */
+  int child_ntfn = ntfn_create();
+  if (child_ntfn >= 0 && ntfn_subscribe(child_ntfn, NTFN_SYS_CHILD) != 0) {
+    ntfn_close(child_ntfn);
+    child_ntfn = -1;
   }
+  for (int i = 0; i < nservices; i++)
+    start(&services[i]);
 
-  /* Spawn Shell */
-  printf("[Init] Spawning Shell...\n");
-  int pid_shell = spawn("/sys/bin/shell");
-  if (pid_shell > 0) {
-    printf("[Init] Shell started (PID %d)\n", pid_shell);
-  } else {
-    print("[Init] Failed to spawn Shell!\n");
+  /* Test Notification IPC.  notify() does not block; the server may not
+   * have bound "srv.notify" yet (-EAGAIN), so give it a few slices. */
+  for (int tries = 0; tries < 100; tries++) {
+    if (notify("System", "Boot Complete - Stability Optimized") != -EAGAIN)
+      break;
+    yield();
   }
 
-  /* Test Notification IPC */
-  /* NOTE(USR-SEC-01): notify() reads srv.notify_pid from the global registry
-   * to find the target PID; no capability check prevents spoofing that key. */
-  notify("System", "Boot Complete - Stability Optimized");
-
   flush();
 
   /* Supervisor loop: Monitor and respawn critical processes.
@@ -95,10 +235,15 @@ int main(void) {
    * the respawn a race against the kernel reaper (won on some boots/arches,
    * lost on others — the amd64 no-respawn report).
    *
-   * NOTE(USR-INIT-01): This is a correct poll loop.  PIDs are monotonic
-   * (next_pid, process.c) so a respawned service can never collide with the
-   * surviving service's PID.  A failed spawn (pid <= 0) also yields -2 and
-   * is retried on the next iteration.
+   * Between passes init sleeps in ntfn_wait() on NTFN_SYS_CHILD, which the
+   * kernel raises when one of its children exits, instead of spinning on
+   * yield().  It falls back to yield() while a spawn has failed (there is
+   * no child to signal the retry) or if the notification is unavailable.
+   *
+   * NOTE(USR-INIT-01): PIDs are monotonic (next_pid, process.c) so a
+   * respawned service can never collide with the surviving service's PID.
+   * A failed spawn (pid <= 0) also yields -2 and is retried on the next
+   * iteration.
    *
    * NOTE(USR-INIT-03): There is no respawn backoff or rate limit.  A crashing
    * service is respawned immediately on every supervisor iteration, which can
@@ -106,24 +251,26 @@ int main(void) {
    */
   print("[Init] Entering supervisor loop\n");
   while (1) {
-    /* Respawn the shell when it is gone (freshly dead corpse OR already
+    /* Respawn a service when it is gone (freshly dead corpse OR already
      * reaped by the kernel).  spawn() assigns a fresh monotonic PID. */
-    int r = wait(pid_shell);
-    if (r == pid_shell || r == -2) {
-      print("[Init] Shell terminated! Respawning...\n");
-      pid_shell = spawn("/sys/bin/shell");
+    int all_running = 1;
+    for (int i = 0; i < nservices; i++) {
+      struct service *sv = &services[i];
+      int r = wait(sv->pid);
+      if (r == sv->pid || r == -2) {
+        printf("[Init] %s terminated! Respawning...\n", sv->path);
+        start(sv);
+      }
+      if (sv->pid <= 0)
+        all_running = 0;
     }
 
-    /* Check if notification server died and respawn. */
-    r = wait(pid_notify);
-    if (r == pid_notify || r == -2) {
-      print("[Init] Notification Server died! Respawning...\n");
-      pid_notify = spawn("/sys/bin/notify_srv");
-    }
-
-    /* Yield to the scheduler; prevents busy-spinning on the two wait() calls
-     * when both child processes are alive (wait returns -1 each iteration). */
-    yield();
+    /* Every service is alive: block until a child exits (the pending bit
+     * also covers an exit since the last pass).  Otherwise yield so the
+     * failed spawn is retried without busy-spinning. */
+    uint64_t bits;
+    if (!all_running || child_ntfn < 0 || ntfn_wait(child_ntfn, &bits) != 0)
+      yield();
   }
 
   return 0;
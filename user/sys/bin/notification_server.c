@@ -7,27 +7,27 @@
  * IPC message of type IPC_TYPE_NOTIFY or IPC_TYPE_RAW arrives, and is
  * automatically hidden again after 5 seconds of inactivity.
  *
- * Discovery mechanism (see USR-SEC-01):
- *   On startup, notify_srv writes its own PID as a decimal string to the
- *   global registry key "srv.notify_pid".  Any caller that wants to send a
- *   notification reads this key via registry_read() and sends an IPC message
- *   to that PID.  There is no authentication: any process can overwrite
- *   "srv.notify_pid" and redirect all notifications to itself.
+ * Discovery mechanism (USR-SEC-01 resolved):
+ *   On startup, notify_srv binds the kernel endpoint "srv.notify"
+ *   (ep_create).  Callers ep_open() that name and send through the handle
+ *   (notify() in lib.c).  init spawns the server at machine level, the only
+ *   level allowed to bind "srv." names, and when init respawns it the new
+ *   instance re-binds the same endpoint, so existing client handles keep
+ *   working.
  *
  * Event loop design:
- *   try_recv(-1, &msg) is the NON-BLOCKING IPC check (syscall #32).
- *   Returns 0 on success (message available), negative if no message is
- *   waiting.  The loop then checks the auto-hide timer and calls yield().
- *   This is a correct, non-busy-spinning event loop.
+ *   One event set watches incoming IPC (EV_SRC_IPC, any sender).  ev_wait()
+ *   sleeps until a message is buffered or, while the popup is shown, until
+ *   its auto-hide deadline; the loop then drains the queue with the
+ *   non-blocking try_recv() and hides the window if the deadline passed.
+ *   The server does not run at all while nothing happens.
  *
  * Known issues:
- *   USR-SEC-01  (W3 SECURITY) registry_write("srv.notify_pid", ...) has no
- *               authentication; any process can overwrite this key to intercept
- *               or forge system notifications.
  *   USR-BLOAT-01/02 (W2 BAD-IMPL·PERF) The ELF is ~500KB because lib.o
  *               bundles stb_image/stb_easy_font unconditionally and debug
  *               DWARF is not stripped.
  */
+#include <event.h>
 #include <os1.h>
 
 /* Notification popup window geometry (pixels).
@@ -35,26 +35,25 @@
 #define NOTIFY_WIDTH 250
 #define NOTIFY_HEIGHT 60
 #define NOTIFY_PADDING 10
+/* Popup lifetime after the last notification (ms, get_time() units). */
+#define NOTIFY_SHOW_MS 5000
 
 /*
  * main - notification server entry point; does not return.
  *
- * Creates a top-most, initially hidden compositor window.  Registers this
- * process's PID in the registry so callers can discover the endpoint.
+ * Creates a top-most, initially hidden compositor window and binds the
+ * "srv.notify" endpoint so callers can reach it.
  * Enters the event loop:
- *   1. try_recv: if a NOTIFY or RAW IPC message arrives, render its payload
- *      (up to 64 bytes) in the window and show it.
- *   2. Auto-hide: if the window has been visible for >5000 jiffies (~5 s at
- *      100 Hz), hide it.
- *   3. yield() to give other processes CPU time.
+ *   1. ev_wait: block until IPC arrives or the auto-hide deadline is due
+ *      (forever while hidden).
+ *   2. try_recv until empty: render each NOTIFY or RAW payload (up to 64
+ *      bytes) in the window and show it.
+ *   3. Auto-hide: if the window has been visible for NOTIFY_SHOW_MS, hide it.
  *
  * Returns 1 on window creation failure, never returns otherwise.
  *
- * Side effects: creates a compositor window; writes registry key
- *   "srv.notify_pid"; draws to the window on each notification.
- *
- * NOTE(USR-SEC-01): Writing to "srv.notify_pid" is unauthenticated; any
- *   process can overwrite it and intercept subsequent notify() calls.
+ * Side effects: creates a compositor window; binds endpoint "srv.notify";
+ *   draws to the window on each notification.
  */
 int main(void) {
   /* Create a window in the top-right corner.
@@ -77,22 +76,37 @@ int main(void) {
 
   printf("[Notify] Server started (PID %d)\n", get_pid());
 
-  /* Register PID in system registry for other processes to find it.
-   * NOTE(USR-SEC-01): No authentication; any process can overwrite this key
-   * to redirect all system notifications to itself. */
-  char pid_str[16];
-  snprintf(pid_str, sizeof(pid_str), "%d", get_pid());
-  registry_write("srv.notify_pid", pid_str);
+  /* Publish the service.  Clients hold handles to the endpoint, not our
+   * PID, so a respawned instance picks up where this one left off. */
+  int ep = ep_create("srv.notify");
+  if (ep < 0)
+    printf("[Notify] Cannot bind srv.notify (%d)\n", ep);
+
+  int evs = ev_create();
+  if (evs >= 0)
+    ev_add(evs, EV_SRC_IPC, -1, EV_IN, 0);
 
   struct ipc_message msg;
   long last_notify_time = 0;
   int is_visible = 0;    /* Tracks whether the window is currently shown */
 
   while (1) {
-    /* Non-blocking receive: try_recv returns 0 if a message was dequeued,
-     * negative if the queue is empty.  This avoids blocking the auto-hide
-     * timer check below. */
-    if (try_recv(-1, &msg) == 0) {
+    /* Sleep until a message is buffered or the popup is due to hide. */
+    long timeout = -1;
+    if (is_visible) {
+      timeout = last_notify_time + NOTIFY_SHOW_MS - get_time();
+      if (timeout < 0)
+        timeout = 0;
+    }
+    struct ev_event ev;
+    if (evs >= 0)
+      ev_wait(evs, &ev, 1, timeout);
+    else
+      yield();
+
+    /* Drain: try_recv returns 0 if a message was dequeued, negative once
+     * the queue is empty. */
+    while (try_recv(-1, &msg) == 0) {
       if (msg.type == IPC_TYPE_NOTIFY || msg.type == IPC_TYPE_RAW) {
         /* Render notification background and payload text. */
         window_draw(win_id, 0, 0, NOTIFY_WIDTH, NOTIFY_HEIGHT, 0xEE222222);
@@ -108,16 +122,12 @@ int main(void) {
       }
     }
 
-    /* Auto-hide check: Hide after 5 seconds (5000 jiffies at 100 Hz timer). */
-    if (is_visible && (get_time() - last_notify_time > 5000)) {
+    /* Auto-hide check. */
+    if (is_visible && (get_time() - last_notify_time >= NOTIFY_SHOW_MS)) {
       set_window_flags(win_id, 1 | 4); /* 1=top_most, 4=hidden */
       is_visible = 0;
       compositor_render();
     }
-
-    /* Yield to prevent CPU hogging; allows other processes to run between
-     * non-blocking poll iterations. */
-    yield();
   }
 
   return 0;
@@ -32,7 +32,9 @@
  *                the ELF; no --gc-sections or strip step.
  */
 #include "proce.h"
+#include <event.h>
 #include <os1.h>
+#include <string.h>
 
 /* Window dimensions */
 #define WIN_W 640
@@ -143,25 +145,28 @@ static int tokenize(char *s, char *argv[], int max) {
  * spawn_search_args - spawn argv[0] (probing /bin then /sys/bin) with argv.
  *
  * Probes /bin/<argv[0]> then /sys/bin/<argv[0]> and hands the child the full
- * argv vector via spawn_args().  argv[0] is the program name as typed; absolute
- * names (leading '/') bypass the search.  Returns the PID or <= 0 on failure.
+ * argv vector via spawn_fds().  argv[0] is the program name as typed; absolute
+ * names (leading '/') bypass the search.  fdmap/nmap (NULL/0 for the defaults)
+ * choose which of our fds the child starts with, as in spawn_fds().  Returns
+ * the PID or <= 0 on failure.
  */
-static int spawn_search_args(int argc, char *argv[], char *out_path) {
+static int spawn_search_args(int argc, char *argv[], char *out_path,
+                             const int *fdmap, int nmap) {
   const char *name = argv[0];
   if (name[0] == '/') {
     snprintf(out_path, SPAWN_PATH_MAX, "%s", name);
-    return spawn_args(out_path, argc, argv);
+    return spawn_fds(out_path, argc, argv, fdmap, nmap);
   }
 
   /* Try /bin/ first */
   snprintf(out_path, SPAWN_PATH_MAX, "/bin/%s", name);
-  int pid = spawn_args(out_path, argc, argv);
+  int pid = spawn_fds(out_path, argc, argv, fdmap, nmap);
   if (pid > 0)
     return pid;
 
   /* Fall back to /sys/bin/ */
   snprintf(out_path, SPAWN_PATH_MAX, "/sys/bin/%s", name);
-  return spawn_args(out_path, argc, argv);
+  return spawn_fds(out_path, argc, argv, fdmap, nmap);
 }
 
 /*
@@ -189,32 +194,108 @@ static int spawn_search_args(int argc, char *argv[], char *out_path) {
  *
  * A windowless CLI program writes its stdout into THIS shell's window (its
  * controlling terminal, resolved kernel-side), so it runs "in the shell".
- * We poll until it exits or the user presses Ctrl+C (ETX 0x03, delivered as
- * a keyboard IPC press), which kills it.  If the child opens its OWN window
+ * We watch until it exits or the user presses Ctrl+C (ETX 0x03, delivered as
+ * a keyboard IPC press), which kills it: an event set wakes us on input or
+ * on a 50 ms tick, at which we re-check the child (there is no exit event
+ * yet).  If the child opens its OWN window
  * it is a graphical/TTY app (doom, top, forkbomb): it detaches and we return
  * to the prompt immediately, leaving it running in its own window.
  *
  * Priorities are untouched: the child is a normal independent process; this
- * loop only watches it and yields.  stdin is not yet forwarded to the job
+ * loop only watches it and sleeps.  stdin is not yet forwarded to the job
  * (CLI tools that read input are a follow-up); other keystrokes are consumed.
  */
 static void run_foreground(int pid) {
+  static int evs = -1;
   if (pid <= 0)
     return;
+  if (evs < 0) {
+    evs = ev_create();
+    if (evs >= 0) {
+      ev_add(evs, EV_SRC_INPUT, 0, EV_IN, 0);
+      ev_add(evs, EV_SRC_TIMER, 50, EV_IN, 0);
+    }
+  }
   while (1) {
     if (window_of_pid(pid) > 0)
       break; /* child opened its own window -> detached */
     if (wait(pid) != -1)
       break; /* child finished (dead/zombie/gone) */
     struct ipc_message m;
-    if (try_recv(-1, &m) == 0 && m.type == IPC_TYPE_INPUT && m.data2 != 0 &&
-        m.payload[0] == 0x03) {
-      kill_process(pid);
-      print("^C\n");
+    int killed = 0;
+    while (try_recv(-1, &m) == 0) {
+      if (m.type == IPC_TYPE_INPUT && m.data2 != 0 && m.payload[0] == 0x03) {
+        kill_process(pid);
+        print("^C\n");
+        killed = 1;
+        break;
+      }
+    }
+    if (killed)
+      break;
+    struct ev_event ev[2];
+    if (evs < 0 || ev_wait(evs, ev, 2, -1) < 0)
+      yield();
+  }
+}
+
+/*
+ * run_pipeline - `a | b | c`: each stage's stdout is a pipe into the next
+ * stage's stdin (spawn_fds), the first reads the keyboard and the last
+ * writes to this terminal.  Stages are programs only (no built-ins).
+ *
+ * The shell drops its copies of every pipe end as soon as the stages that
+ * use them exist, so a consumer sees EOF when its producer exits and a
+ * producer gets -EPIPE when its consumer does.  Then each stage is watched
+ * as a foreground job, last first: that is the one whose output the user
+ * is waiting for, and Ctrl+C on it lets the others drain out.
+ */
+#define MAX_STAGES 4
+
+static void run_pipeline(char *line) {
+  char *stage[MAX_STAGES];
+  int nstages = 0;
+  stage[nstages++] = line;
+  for (char *s = line; *s; s++) {
+    if (*s != '|')
+      continue;
+    if (nstages == MAX_STAGES) {
+      printf("pipeline: at most %d stages\n", MAX_STAGES);
+      return;
+    }
+    *s = '\0';
+    stage[nstages++] = s + 1;
+  }
+
+  int pids[MAX_STAGES];
+  int prev_rd = -1; /* read end feeding the next stage's stdin */
+  for (int i = 0; i < nstages; i++) {
+    pids[i] = -1;
+    int fds[2] = {-1, -1};
+    if (i < nstages - 1 && pipe(fds) < 0) {
+      print("pipeline: out of pipes\n");
+      nstages = i;
       break;
     }
-    yield();
+    char *argv[MAX_ARGV];
+    int argc = tokenize(stage[i], argv, MAX_ARGV);
+    int map[2] = {prev_rd, fds[1]}; /* -1: keyboard / terminal */
+    char path[SPAWN_PATH_MAX];
+    if (argc > 0)
+      pids[i] = spawn_search_args(argc, argv, path, map, 2);
+    if (pids[i] <= 0)
+      printf("Unknown command: %s\n", argc > 0 ? argv[0] : "(empty)");
+    if (prev_rd >= 0)
+      close(prev_rd);
+    if (fds[1] >= 0)
+      close(fds[1]);
+    prev_rd = fds[0];
   }
+  if (prev_rd >= 0)
+    close(prev_rd);
+
+  for (int i = nstages - 1; i >= 0; i--)
+    run_foreground(pids[i]);
 }
 
 static void process_command(void) {
@@ -224,6 +305,12 @@ static void process_command(void) {
 
   print("\n");
 
+  if (strchr(cmd_buf, '|')) {
+    run_pipeline(cmd_buf);
+    cmd_len = 0;
+    return;
+  }
+
   if (str_eq(cmd_buf, "help") || str_eq(cmd_buf, "?")) {
     print("\n\033[1;33mAvailable Commands:\033[0m\n");
     print("  help            - Show this help\n");
@@ -237,8 +324,12 @@ static void process_command(void) {
     print("  cd <path>       - Change directory\n");
     print("  pwd             - Show current directory\n");
     print("  cat <path>      - Show file contents\n");
+    print("  dmesg           - Show recent kernel log\n");
+    print("  lockstat [reset]- Spinlock contention (LOCKSTAT=1 kernels)\n");
+    print("  cpustat         - Per-CPU switches, IRQs, page allocs/frees\n");
     print("  kill <pid>      - Kill process by PID\n");
     print("  exec <program>  - Execute program (searches /bin, /sys/bin)\n");
+    print("  prog | prog     - Pipe one program's output into the next\n");
     print("  about           - About this OS\n");
     print("  exit            - Exit shell\n");
   } else if (str_eq(cmd_buf, "clear")) {
@@ -295,6 +386,29 @@ static void process_command(void) {
     } else {
       print("Error getting CWD\n");
     }
+  } else if (str_eq(cmd_buf, "dmesg")) {
+    /* Newest 4 KiB of the kernel log, starting at a line boundary. */
+    static char buf[4096];
+    long len = dmesg(buf, sizeof(buf));
+    if (len < 0)
+      printf("dmesg: error %d\n", (int)len);
+    else
+      write(1, buf, (size_t)len);
+  } else if (str_eq(cmd_buf, "lockstat") || str_eq(cmd_buf, "lockstat reset")) {
+    static char buf[4096];
+    long len = lockstat(buf, sizeof(buf),
+                        cmd_buf[8] ? LOCKSTAT_RESET : 0);
+    if (len < 0)
+      printf("lockstat: error %d\n", (int)len);
+    else
+      write(1, buf, (size_t)len);
+  } else if (str_eq(cmd_buf, "cpustat")) {
+    static char buf[4096];
+    long len = cpustat(buf, sizeof(buf));
+    if (len < 0)
+      printf("cpustat: error %d\n", (int)len);
+    else
+      write(1, buf, (size_t)len);
   } else if (cmd_buf[0] == 'c' && cmd_buf[1] == 'd' &&
              (cmd_buf[2] == ' ' || cmd_buf[2] == '\0')) {
     /* NOTE(USR-SHELL-01): "cd" with no argument defaults to "/"; argument
@@ -383,7 +497,7 @@ static void process_command(void) {
       print("Usage: exec <program> [args...]\n");
     } else {
       char path[SPAWN_PATH_MAX];
-      int pid = spawn_search_args(argc, argv, path);
+      int pid = spawn_search_args(argc, argv, path, 0, 0);
       if (pid > 0) {
         run_foreground(pid); /* in-shell if windowless, else detaches */
       } else {
@@ -406,7 +520,7 @@ static void process_command(void) {
     int argc = tokenize(cmd_buf, argv, MAX_ARGV);
     if (argc > 0) {
       char path[SPAWN_PATH_MAX];
-      int pid = spawn_search_args(argc, argv, path);
+      int pid = spawn_search_args(argc, argv, path, 0, 0);
       if (pid > 0) {
         run_foreground(pid); /* in-shell if windowless, else detaches */
       } else {
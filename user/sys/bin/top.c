@@ -3,6 +3,7 @@
  * Realtime Process List Utility - Full 32-Process Atomic Edition
  */
 #include "proce.h"
+#include <event.h>
 #include <os1.h>
 
 // Funzione helper per convertire i numeri in stringa senza usare printf esterne
@@ -41,6 +42,56 @@ static int copy_str_fixed(char *dest, const char *src, int width) {
   return width;
 }
 
+/* Per-thread cycles and instructions at the previous refresh (SYS_PMU),
+ * so the IPC column covers the last interval rather than the whole run. */
+struct ipc_sample {
+  int pid;
+  uint64_t cycles, instructions;
+};
+static struct ipc_sample ipc_prev[32], ipc_cur[32];
+static int ipc_nprev;
+
+/* format_ipc - "1.23" for the interval since the last refresh, "-" when
+ * the CPU does not count instructions or the thread is new or idle, "n/a"
+ * when the kernel will not show this thread's counts (-EPERM). */
+static void format_ipc(char *buf, int slot, int pid) {
+  struct pmu_counts c;
+  buf[0] = '-';
+  buf[1] = '\0';
+  ipc_cur[slot].pid = pid;
+  ipc_cur[slot].cycles = ipc_cur[slot].instructions = 0;
+  if (pid <= 0)
+    return;
+  long rc = pmu_ctl(PMU_READ, (unsigned long)pid, (unsigned long)&c);
+  if (rc == -EPERM) {
+    buf[0] = 'n';
+    buf[1] = '/';
+    buf[2] = 'a';
+    buf[3] = '\0';
+  }
+  if (rc < 0)
+    return;
+  ipc_cur[slot].cycles = c.count[PMU_CYCLES];
+  ipc_cur[slot].instructions = c.count[PMU_INSTRUCTIONS];
+  if (!(c.events & PMU_EV(PMU_INSTRUCTIONS)))
+    return;
+  for (int i = 0; i < ipc_nprev; i++) {
+    if (ipc_prev[i].pid != pid)
+      continue;
+    uint64_t dc = c.count[PMU_CYCLES] - ipc_prev[i].cycles;
+    uint64_t di = c.count[PMU_INSTRUCTIONS] - ipc_prev[i].instructions;
+    if (dc == 0)
+      return;
+    int ipc100 = (int)(di * 100 / dc);
+    int n = mini_itoa(buf, ipc100 / 100);
+    buf[n++] = '.';
+    buf[n++] = (char)('0' + ipc100 / 10 % 10);
+    buf[n++] = (char)('0' + ipc100 % 10);
+    buf[n] = '\0';
+    return;
+  }
+}
+
 int main(void) {
   struct ps_info procs[32];
 
@@ -55,6 +106,11 @@ int main(void) {
   // relativi codici colore
   char screen_buffer[4096];
 
+  /* Refresh tick: a 1 s periodic timer source instead of spinning yield(). */
+  int evs = ev_create();
+  if (evs >= 0)
+    ev_add(evs, EV_SRC_TIMER, 1000, EV_IN, 0);
+
   while (1) {
     int count = _sys_get_procs(procs, 32);
     if (count < 0)
@@ -77,11 +133,11 @@ int main(void) {
     for (int k = 0; col_yellow[k]; k++)
       screen_buffer[buf_idx++] = col_yellow[k];
 
-    char header[] = "PID  NAME         STATE    PRIO CPU\n";
+    char header[] = "PID  NAME         STATE    PRIO CPU IPC\n";
     for (int k = 0; header[k]; k++)
       screen_buffer[buf_idx++] = header[k];
 
-    char reset_and_sep[] = "\033[0m------------------------------------\n";
+    char reset_and_sep[] = "\033[0m----------------------------------------\n";
     for (int k = 0; reset_and_sep[k]; k++)
       screen_buffer[buf_idx++] = reset_and_sep[k];
 
@@ -141,6 +197,11 @@ int main(void) {
       // CPU
       mini_itoa(num_buf, procs[i].on_cpu);
       buf_idx += copy_str_fixed(&screen_buffer[buf_idx], num_buf, 3);
+      screen_buffer[buf_idx++] = ' ';
+
+      // IPC (instructions per cycle over the last refresh)
+      format_ipc(num_buf, i, procs[i].pid);
+      buf_idx += copy_str_fixed(&screen_buffer[buf_idx], num_buf, 5);
 
       // Reset colore a fine riga ed andiamo a capo
       char rst[] = "\033[0m\n";
@@ -148,13 +209,18 @@ int main(void) {
         screen_buffer[buf_idx++] = rst[k];
     }
 
+    for (int i = 0; i < count; i++)
+      ipc_prev[i] = ipc_cur[i];
+    ipc_nprev = count;
+
     /* 4. UNICA EMISSIONE ATOMICA DI TUTTA LA LISTA */
     _sys_window_write(my_win, screen_buffer, buf_idx);
 
     /* 5. REFRESH RATE (1Hz) */
-    for (int delay = 0; delay < 200; delay++) {
-      yield();
-    }
+    struct ev_event ev;
+    if (evs < 0 || ev_wait(evs, &ev, 1, -1) < 0)
+      for (int delay = 0; delay < 200; delay++)
+        yield();
   }
 
   return 0;
@@ -0,0 +1,149 @@
+/*
+ * user/sys/lib/channel.c
+ * Shared-memory channels, userland side (include/api/channel.h).
+ *
+ * The ring is a Lamport single-producer / single-consumer queue: the
+ * producer owns head, the consumer owns tail, each publishes its counter
+ * with a release store and reads the other's with an acquire load, so the
+ * payload memcpy needs neither a lock nor the kernel.
+ *
+ * Sleeping is Dekker-style on the wait words.  A reader that finds the
+ * ring empty sets cons_wait = 1, re-reads head, and only if it is still
+ * unchanged FUTEX_WAITs on cons_wait == 1.  A writer publishes head, issues
+ * a full fence, and wakes only if it then sees cons_wait set — which the
+ * reader only does on an empty ring, so wakes happen on the empty ->
+ * non-empty transition and never while the two sides keep pace.  Clearing
+ * the word before FUTEX_WAKE makes a reader that has not reached its
+ * FUTEX_WAIT yet fail it with -EAGAIN instead of missing the wake.  A full
+ * ring is the mirror image on tail / prod_wait.  When a side closes or
+ * exits the kernel sets CHAN_F_PEER_GONE and clears and wakes both words
+ * the same way.
+ */
+#include <channel.h>
+#include <futex.h>
+#include <os1.h>
+
+static inline uint32_t load_acquire(uint32_t *p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void store_release(uint32_t *p, uint32_t v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+static int peer_gone(chan_t *c) {
+  return (load_acquire(&c->shm->flags) & CHAN_F_PEER_GONE) != 0;
+}
+
+/* chan_sleep - wait for *word to move off 'seen' (or the peer to go),
+ * announcing ourselves in *wait. */
+static void chan_sleep(chan_t *c, uint32_t *word, uint32_t seen,
+                       uint32_t *wait) {
+  __atomic_store_n(wait, 1, __ATOMIC_SEQ_CST);
+  if (__atomic_load_n(word, __ATOMIC_SEQ_CST) == seen && !peer_gone(c))
+    futex(wait, FUTEX_WAIT, 1, 0, 0, 0);
+  __atomic_store_n(wait, 0, __ATOMIC_RELAXED);
+}
+
+/* chan_kick - after publishing: wake the other side if it sleeps. */
+static void chan_kick(uint32_t *wait) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(wait, __ATOMIC_RELAXED) &&
+      __atomic_exchange_n(wait, 0, __ATOMIC_SEQ_CST))
+    futex(wait, FUTEX_WAKE, 1, 0, 0, 0);
+}
+
+static void chan_setup(chan_t *c, const struct chan_info *info, long slot) {
+  c->shm = (struct chan_shared *)(uintptr_t)info->base;
+  c->data = (uint8_t *)(uintptr_t)info->base + CHAN_HDR_SIZE;
+  c->mask = info->size - 1;
+  c->slot = (int)slot;
+}
+
+int chan_connect(chan_t *c, int ep, uint32_t size) {
+  struct chan_info info;
+  long slot = _sys_channel(CHAN_CONNECT, ep, (long)size, &info);
+  if (slot < 0)
+    return (int)slot;
+  chan_setup(c, &info, slot);
+  return 0;
+}
+
+int chan_accept(chan_t *c, const struct ipc_message *offer) {
+  if (offer->type != IPC_TYPE_CHANNEL)
+    return -EINVAL;
+  struct chan_info info;
+  long slot = _sys_channel(CHAN_ACCEPT, (long)offer->data1, 0, &info);
+  if (slot < 0)
+    return (int)slot;
+  chan_setup(c, &info, slot);
+  return 0;
+}
+
+void chan_close(chan_t *c) {
+  if (!c->shm)
+    return;
+  _sys_channel(CHAN_CLOSE, c->slot, 0, 0);
+  c->shm = 0;
+  c->data = 0;
+}
+
+long chan_write(chan_t *c, const void *buf, size_t len) {
+  struct chan_shared *s = c->shm;
+  const uint8_t *src = buf;
+  uint32_t size = c->mask + 1;
+  uint32_t head = s->head;
+  size_t done = 0;
+
+  while (done < len) {
+    if (peer_gone(c))
+      return done ? (long)done : -EPIPE;
+    uint32_t tail = load_acquire(&s->tail);
+    uint32_t room = size - (head - tail);
+    if (room == 0) {
+      chan_sleep(c, &s->tail, tail, &s->prod_wait);
+      continue;
+    }
+    uint32_t n = len - done < room ? (uint32_t)(len - done) : room;
+    uint32_t off = head & c->mask;
+    uint32_t first = size - off < n ? size - off : n;
+    memcpy(c->data + off, src + done, first);
+    memcpy(c->data, src + done + first, n - first);
+    head += n;
+    store_release(&s->head, head);
+    chan_kick(&s->cons_wait);
+    done += n;
+  }
+  return (long)done;
+}
+
+long chan_read(chan_t *c, void *buf, size_t len) {
+  struct chan_shared *s = c->shm;
+  uint8_t *dst = buf;
+  uint32_t size = c->mask + 1;
+  uint32_t tail = s->tail;
+
+  for (;;) {
+    uint32_t head = load_acquire(&s->head);
+    uint32_t avail = head - tail;
+    if (avail) {
+      uint32_t n = len < avail ? (uint32_t)len : avail;
+      uint32_t off = tail & c->mask;
+      uint32_t first = size - off < n ? size - off : n;
+      memcpy(dst, c->data + off, first);
+      memcpy(dst + first, c->data, n - first);
+      store_release(&s->tail, tail + n);
+      chan_kick(&s->prod_wait);
+      return (long)n;
+    }
+    if (len == 0)
+      return 0;
+    /* Drain what the peer wrote before it went away. */
+    if (peer_gone(c)) {
+      if (load_acquire(&s->head) == tail)
+        return 0;
+      continue;
+    }
+    chan_sleep(c, &s->head, head, &s->cons_wait);
+  }
+}
@@ -49,9 +49,13 @@
  *   USR-BLOAT-02 (W2 BAD-IMPL) -g DWARF retained in every ELF; not stripped.
  */
 #include <os1.h>
+#include <endpoint.h>
+#include <event.h>
+#include <ntfn.h>
 #include <stdio.h>
 #include <ctype.h>
 #include <fcntl.h>
+#include <sys/uio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <input.h>
@@ -97,9 +101,20 @@ int errno = 0;
  * and paths with no capability check; any process has full authority.
  */
 long read(int fd, char *buf, unsigned long count) { return _sys_read(fd, buf, count); }
-void write(int fd, const char *buf, size_t count) { _sys_write(fd, buf, count); }
+/* write: a pipe may take the data in pieces (kernel/pipe.h); files and
+ * windows always take it whole, so this loops only for pipes. */
+void write(int fd, const char *buf, size_t count) {
+  while (count > 0) {
+    long n = _sys_write(fd, buf, count);
+    if (n <= 0)
+      return;
+    buf += n;
+    count -= (size_t)n;
+  }
+}
 long get_time(void) { return _sys_get_time(); }
 int get_pid(void) { return _sys_get_pid(); }
+int gettid(void) { return _sys_gettid(); }
 /* exit: the while(1) after _sys_exit() is unreachable dead code that silences
  * the "noreturn" warning in compilers that do not see svc #0 as a terminator. */
 void exit(int status) { _sys_exit(status); while(1); }
@@ -107,6 +122,10 @@ int spawn(const char *path) { return _sys_spawn(path, 0, 0); }
 int spawn_args(const char *path, int argc, char *const argv[]) {
   return _sys_spawn(path, argc, argv);
 }
+int spawn_fds(const char *path, int argc, char *const argv[], const int *map,
+              int nmap) {
+  return _sys_spawn_fds(path, argc, argv, map, nmap);
+}
 /* spawn_caps: explicit capability mask; spawn_level: the level's default
  * preset (request CAP_ALL and let the kernel clamp to the level ceiling). */
 long spawn_caps(const char *path, int level, unsigned long caps) { return _sys_spawn_caps(path, level, caps); }
@@ -115,6 +134,38 @@ int kill_process(int pid) { return _sys_kill(pid); }
 /* wait: maps to process_wait() in the kernel, which is NON-BLOCKING:
  * returns -1 if the process is alive, pid if reaped, -2 if not found. */
 int wait(int pid) { return _sys_wait(pid); }
+
+/* __thread_start: first frame of every thread_create() thread. */
+static void __thread_start(void (*fn)(void *), void *arg) {
+  fn(arg);
+  thread_exit(0);
+}
+
+/* __threads_started: set before the first thread runs; malloc.c takes its
+ * heap lock from then on. */
+int __threads_started;
+
+int thread_create(void (*fn)(void *), void *arg, void *stack, size_t size) {
+  if (!fn || !stack || size < 256)
+    return -EINVAL;
+  __threads_started = 1;
+  uintptr_t top = ((uintptr_t)stack + size) & ~(uintptr_t)15;
+#ifdef __x86_64__
+  top -= 8; /* entered by jump, not call: fake the return-address slot */
+#endif
+  return (int)_sys_thread_create(__thread_start, (void *)top, fn, arg, 0);
+}
+void thread_exit(int code) {
+  _sys_thread_exit(code);
+  for (;;) /* not reached */
+    ;
+}
+int thread_join(int tid, int *code) { return _sys_thread_join(tid, code); }
+int set_tls(void *base) { return _sys_set_tls(base); }
+long futex(uint32_t *uaddr, int op, uint32_t val, unsigned long arg3,
+           uint32_t *uaddr2, uint32_t val3) {
+  return _sys_futex(uaddr, op, val, arg3, uaddr2, val3);
+}
 void draw(int x, int y, int w, int h, int color) { _sys_draw(x, y, w, h, color); }
 void flush(void) { _sys_flush(); }
 int create_window(int x, int y, int w, int h, const char *title) { return _sys_create_window(x, y, w, h, title); }
@@ -122,16 +173,51 @@ void destroy_window(int win_id) { _sys_destroy_window(win_id); }
 void window_draw(int win_id, int x, int y, int w, int h, unsigned int color) { _sys_window_draw(win_id, x, y, w, h, color); }
 void window_blit(int win_id, int x, int y, int w, int h, const unsigned int *buf) { _sys_window_blit(win_id, x, y, w, h, buf); }
 void yield(void) { _sys_yield(); }
+int sched_setattr(int pid, const struct sched_attr *attr) { return (int)_sys_sched_setattr(pid, attr); }
+int sched_getattr(int pid, struct sched_attr *attr) { return (int)_sys_sched_getattr(pid, attr); }
+long trace_ctl(int op, unsigned long a1, unsigned long a2) { return _sys_trace(op, a1, a2); }
+long prof_ctl(int op, unsigned long a1, unsigned long a2) { return _sys_prof(op, a1, a2); }
+long pmu_ctl(int op, unsigned long a1, unsigned long a2) { return _sys_pmu(op, a1, a2); }
 /* sleep: busy-waits by polling get_time() in a yield loop.
  * 'ticks' is in jiffies (100 Hz on the reference timer -> 1 tick ≈ 10 ms). */
 void sleep(int ticks) { long end = get_time() + ticks; while (get_time() < end) yield(); }
 void compositor_render(void) { _sys_compositor_render(); }
 /* send/recv: IPC syscalls; pid==-1 means "any sender" in recv/try_recv. */
-int send(int pid, struct ipc_message *msg) { return _sys_send(pid, msg); }
+int send(int pid, struct ipc_message *msg) { return _sys_send(pid, msg, 0); }
+int send_nonblock(int pid, struct ipc_message *msg) { return _sys_send(pid, msg, IPC_NONBLOCK); }
 int recv(int pid, struct ipc_message *msg) { return _sys_recv(pid, msg); }
 /* try_recv: non-blocking variant of recv (SYS_TRY_RECV); returns <0 if no
  * message is waiting, 0 on success. */
 int try_recv(int pid, struct ipc_message *msg) { extern int _sys_try_recv(int pid, void *msg); return _sys_try_recv(pid, msg); }
+int ipc_call(int pid, struct ipc_message *msg) { return _sys_call(pid, msg); }
+int ipc_reply_recv(int reply_pid, struct ipc_message *msg) { return _sys_reply_recv(reply_pid, msg); }
+int ipc_set_depth(unsigned int slots) { return _sys_ipc_set_depth(slots); }
+int ep_create(const char *name) { return (int)_sys_endpoint(EP_CREATE, (long)name, 0, 0); }
+int ep_open(const char *name) { return (int)_sys_endpoint(EP_OPEN, (long)name, 0, 0); }
+int ep_close(int h) { return (int)_sys_endpoint(EP_CLOSE, h, 0, 0); }
+int ep_send(int h, struct ipc_message *msg) { return (int)_sys_endpoint(EP_SEND, h, (long)msg, 0); }
+int ep_send_nonblock(int h, struct ipc_message *msg) { return (int)_sys_endpoint(EP_SEND, h, (long)msg, IPC_NONBLOCK); }
+int ep_call(int h, struct ipc_message *msg) { return (int)_sys_endpoint(EP_CALL, h, (long)msg, 0); }
+int ep_signal(int h, uint64_t bits) { return (int)_sys_endpoint(EP_SIGNAL, h, (long)bits, 0); }
+
+int ev_create(void) { return (int)_sys_event(EV_CREATE, 0, 0, 0, 0); }
+int ev_add(int h, int src, long arg, unsigned int events, uint64_t udata) {
+  struct ev_source s = {src, events, arg, udata};
+  return (int)_sys_event(EV_ADD, h, (long)&s, 0, 0);
+}
+int ev_del(int h, int id) { return (int)_sys_event(EV_DEL, h, id, 0, 0); }
+int ev_wait(int h, struct ev_event *out, int max, long timeout_ms) {
+  return (int)_sys_event(EV_WAIT, h, (long)out, max, timeout_ms);
+}
+int ev_close(int h) { return (int)_sys_event(EV_CLOSE, h, 0, 0, 0); }
+
+int ntfn_create(void) { return (int)_sys_ntfn(NTFN_CREATE, 0, 0); }
+int ntfn_signal(int h, uint64_t bits) { return (int)_sys_ntfn(NTFN_SIGNAL, h, (long)bits); }
+int ntfn_wait(int h, uint64_t *bits) { return (int)_sys_ntfn(NTFN_WAIT, h, (long)bits); }
+int ntfn_poll(int h, uint64_t *bits) { return (int)_sys_ntfn(NTFN_POLL, h, (long)bits); }
+int ntfn_bind(int h, int ep) { return (int)_sys_ntfn(NTFN_BIND, h, ep); }
+int ntfn_subscribe(int h, uint64_t mask) { return (int)_sys_ntfn(NTFN_SUBSCRIBE, h, (long)mask); }
+int ntfn_close(int h) { return (int)_sys_ntfn(NTFN_CLOSE, h, 0); }
 void set_window_flags(int win_id, int flags) { _sys_window_set_flags(win_id, flags); }
 void set_focus(int pid) { extern void _sys_set_focus(int pid); _sys_set_focus(pid); }
 
@@ -163,7 +249,7 @@ void __stack_chk_fail(void) { printf("Stack smashing detected!\n"); exit(1); }
  * op=1 (SYS_REGISTRY): write value for 'key'; size = strlen(value).
  *
  * NOTE(USR-SEC-01): No authentication; any process can read or overwrite any
- * key.  In particular, overwriting "srv.notify_pid" hijacks all notifications.
+ * key.  (Services are no longer discovered through it: see ep_open().)
  */
 int registry_read(const char *key, char *buf, size_t size) { return (int)_sys_registry(0, key, buf, size); }
 int registry_write(const char *key, const char *value) { return (int)_sys_registry(1, key, (char *)value, strlen(value)); }
@@ -188,6 +274,9 @@ int file_read(const char *path, void *buf, int size, int offset) { return _sys_f
 int list_dir(const char *path, char *buf, size_t size) { return _sys_list_dir(path, buf, size); }
 int chdir(const char *path) { return _sys_chdir(path); }
 int getcwd(char *buf, size_t size) { return _sys_getcwd(buf, size); }
+long dmesg(char *buf, size_t size) { return _sys_dmesg(buf, size); }
+long lockstat(char *buf, size_t size, int flags) { return _sys_lockstat(buf, size, flags); }
+long cpustat(char *buf, size_t size) { return _sys_cpustat(buf, size); }
 
 /* POSIX-style fd I/O (ABI-03 fd table).  open() matches the variadic
  * declaration in fcntl.h; the optional mode argument is ignored because the
@@ -195,6 +284,14 @@ int getcwd(char *buf, size_t size) { return _sys_getcwd(buf, size); }
 int open(const char *pathname, int flags, ...) { return _sys_open(pathname, flags); }
 int close(int fd) { return _sys_close(fd); }
 long lseek(int fd, long offset, int whence) { return _sys_lseek(fd, offset, whence); }
+int pipe(int fds[2]) { return _sys_pipe2(fds, 0); }
+int pipe2(int fds[2], int flags) { return _sys_pipe2(fds, flags); }
+long pread(int fd, void *buf, size_t count, long offset) { return _sys_pread(fd, buf, count, offset); }
+long pwrite(int fd, const void *buf, size_t count, long offset) { return _sys_pwrite(fd, buf, count, offset); }
+long readv(int fd, const struct iovec *iov, int iovcnt) { return _sys_readv(fd, iov, iovcnt); }
+long writev(int fd, const struct iovec *iov, int iovcnt) { return _sys_writev(fd, iov, iovcnt); }
+long preadv(int fd, const struct iovec *iov, int iovcnt, long offset) { return _sys_preadv(fd, iov, iovcnt, offset); }
+long pwritev(int fd, const struct iovec *iov, int iovcnt, long offset) { return _sys_pwritev(fd, iov, iovcnt, offset); }
 
 /* --- Formatting & Printing ---
  * All formatting functions delegate to vsnprintf() from kernel/lib/vsnprintf.c
@@ -264,16 +361,13 @@ char *gets(char *s, int size) {
  * title: short label (up to 30 chars copied); truncated silently if longer.
  * msg:   message body (up to 33 remaining chars after "title: "); truncated.
  *
- * The payload is assembled as "title: msg\0" into imsg.payload[64].
- * The target PID is read from the global registry key "srv.notify_pid".
- * Falls back to PID 2 if the key is absent (pid=2 is the expected notify_srv
- * PID under the current fixed-order spawn sequence in init.c).
- *
- * NOTE(USR-SEC-01): registry_read("srv.notify_pid", ...) has no authentication;
- * any process can overwrite that key to redirect all notifications to itself,
- * effectively hijacking the system notification channel.
+ * The payload is assembled as "title: msg\0" into imsg.payload[64] and sent
+ * through a handle on the "srv.notify" endpoint, opened on first use and
+ * kept for the life of the process (it survives notify_srv respawns).
+ * Notifications are best-effort: the send never blocks.
  *
- * Returns the result of send() (0 on success, negative on failure).
+ * Returns 0 on success, -EAGAIN if the server is not bound or is backed up,
+ * other negative errno on failure.
  */
 int notify(const char *title, const char *msg) {
   struct ipc_message imsg;
@@ -287,12 +381,12 @@ int notify(const char *title, const char *msg) {
   imsg.payload[i++] = ':'; imsg.payload[i++] = ' ';
   while (*msg && i < 63) imsg.payload[i++] = *msg++;
   imsg.payload[i] = '\0';
-  char pid_buf[16];
-  int pid = 2;  /* Default: notify_srv is typically the second process spawned */
-  if (registry_read("srv.notify_pid", pid_buf, sizeof(pid_buf)) == 0) {
-    pid = atoi(pid_buf);
-  }
-  return send(pid, &imsg);
+  static int notify_ep = -1;
+  if (notify_ep < 0)
+    notify_ep = ep_open("srv.notify");
+  if (notify_ep < 0)
+    return notify_ep;
+  return ep_send_nonblock(notify_ep, &imsg);
 }
 
 /* --- Doom/LibC Compatibility ---
@@ -15,6 +15,12 @@
  *   Marks the block free and coalesces with the immediately following block
  *   if that block is also free (forward coalescing only; see USR-MALLOC-02/03).
  *
+ * Threads: once a process has called thread_create(), malloc and free run
+ * under heap_lock, a priority-inheriting mutex (MUTEX_INIT_PI): an RT
+ * thread that allocates while a low-priority thread holds the heap lends
+ * it its priority instead of waiting behind unrelated work.  A process
+ * that never starts a thread skips the lock (and its gettid() syscall).
+ *
  * This allocator was designed to support Doom's sequential alloc-then-free
  * access pattern; it is not appropriate for long-running services with mixed
  * allocation sizes (see USR-MALLOC-03/04).
@@ -41,6 +47,7 @@
 #include <os1.h>
 #include <stddef.h>
 #include <stdint.h>
+#include <sync.h>
 
 /*
  * block_header_t - metadata stored immediately before each heap allocation.
@@ -66,6 +73,18 @@ typedef struct block_header {
 /* free_list: head of the allocation chain.  NULL until the first sbrk() call. */
 static block_header_t *free_list = NULL;
 
+/* heap_lock: guards free_list and the block headers once threads exist
+ * (__threads_started, set by thread_create() in lib.c). */
+static mutex_t heap_lock = MUTEX_INIT_PI;
+extern int __threads_started;
+
+static int heap_lock_acquire(void) {
+    if (!__threads_started)
+        return 0;
+    mutex_lock(&heap_lock);
+    return 1;
+}
+
 /*
  * sbrk - extend the process heap by 'increment' bytes.
  *
@@ -99,8 +118,19 @@ void *sbrk(intptr_t increment) {
  * Returns pointer to the payload (just after the header), or NULL on size==0
  * or sbrk failure.
  */
+static void *heap_alloc(size_t size);
+
 void *malloc(size_t size) {
     if (size == 0) return NULL;
+    int locked = heap_lock_acquire();
+    void *ptr = heap_alloc(size);
+    if (locked)
+        mutex_unlock(&heap_lock);
+    return ptr;
+}
+
+/* heap_alloc - the body of malloc(); heap_lock held if threaded. */
+static void *heap_alloc(size_t size) {
 
     /* Align size to 16 bytes for performance/compatibility.
      * NOTE(USR-MALLOC-05): Aligns the payload size, but the block_header_t
@@ -168,6 +198,7 @@ void *malloc(size_t size) {
 void free(void *ptr) {
     if (!ptr) return;
 
+    int locked = heap_lock_acquire();
     block_header_t *block = (block_header_t *)ptr - 1;
     block->free = 1;
 
@@ -180,6 +211,8 @@ void free(void *ptr) {
 
     /* Coalescing with previous would require a full walk or doubly linked list.
      * Given Doom's allocation patterns, this simple strategy should suffice. */
+    if (locked)
+        mutex_unlock(&heap_lock);
 }
 
 /*
@@ -0,0 +1,241 @@
+/*
+ * user/sys/lib/sync.c
+ * Futex-based mutex / condition variable / semaphore (include/api/sync.h).
+ *
+ * Mutex: the three-state lock from Drepper, "Futexes Are Tricky".
+ *   lock    CAS 0 -> 1; on failure mark the word 2 ("contended") with an
+ *           exchange and FUTEX_WAIT while it stays 2.  A thread that slept
+ *           always takes the lock with xchg(2), never with 1, because it
+ *           cannot know whether others are still queued behind it.
+ *   unlock  fetch_sub: 1 -> 0 means nobody waited (no syscall); otherwise
+ *           store 0 and FUTEX_WAKE one sleeper.
+ *   PI      a PI mutex also records its holder's tid once acquired and
+ *           sleeps with FUTEX_WAIT_PI naming it, so the kernel runs the
+ *           holder at the waiter's priority.  The owner word is a hint: a
+ *           waiter that reads it stale (released, not yet re-set) lends to
+ *           nobody or briefly to another thread of this process.  Waiters
+ *           leave the word at 2, so the holder's unlock takes the
+ *           FUTEX_WAKE path, which also drops the boost.
+ *
+ * Condvar: a sequence word.  A waiter samples seq under the mutex, drops
+ * the mutex and FUTEX_WAITs on that sample, so a signal issued after the
+ * unlock bumps seq and either wakes it or makes the wait fail -EAGAIN.
+ * cond_broadcast wakes one waiter and FUTEX_CMP_REQUEUEs the rest onto the
+ * mutex word instead of waking them all to fight over the lock: they are
+ * woken one at a time by mutex_unlock.  That chain holds because the woken
+ * waiter re-acquires with xchg(2), so its unlock always issues a wake.
+ *
+ * Semaphore: a count plus a sleeper count.  sem_post wakes only when the
+ * sleeper count is non-zero; a sleeper registers itself before its
+ * FUTEX_WAIT re-reads the count, so a post between the two cannot be lost.
+ *
+ * Timeouts are turned into a deadline on get_time() (milliseconds) and
+ * re-derived before each sleep, so spurious or contended wake-ups do not
+ * extend the total wait.
+ */
+#include <futex.h>
+#include <os1.h>
+#include <sync.h>
+
+#define FOREVER (-1L)
+
+static inline uint32_t atomic_cas(uint32_t *p, uint32_t old, uint32_t new) {
+  __atomic_compare_exchange_n(p, &old, new, 0, __ATOMIC_ACQUIRE,
+                              __ATOMIC_RELAXED);
+  return old;
+}
+
+static inline uint32_t atomic_xchg(uint32_t *p, uint32_t v) {
+  return __atomic_exchange_n(p, v, __ATOMIC_ACQUIRE);
+}
+
+static inline uint32_t atomic_load(uint32_t *p) {
+  return __atomic_load_n(p, __ATOMIC_SEQ_CST);
+}
+
+/* deadline_left - milliseconds until 'deadline', or FOREVER.  0 means
+ * expired (FUTEX_WAIT would read 0 as "no timeout", so callers stop). */
+static long deadline_left(long deadline) {
+  if (deadline == FOREVER)
+    return FOREVER;
+  long left = deadline - get_time();
+  return left > 0 ? left : 0;
+}
+
+static long deadline_of(long timeout_ms) {
+  return timeout_ms < 0 ? FOREVER : get_time() + timeout_ms;
+}
+
+/* futex_sleep - FUTEX_WAIT on *word == val for at most 'left' ms. */
+static long futex_sleep(uint32_t *word, uint32_t val, long left) {
+  return futex(word, FUTEX_WAIT, val,
+               left == FOREVER ? 0 : (unsigned long)left, 0, 0);
+}
+
+/* --- Mutex --- */
+
+void mutex_init(mutex_t *m) {
+  m->state = 0;
+  m->owner = 0;
+  m->pi = 0;
+}
+
+void mutex_init_pi(mutex_t *m) {
+  mutex_init(m);
+  m->pi = 1;
+}
+
+/* mutex_acquired - note the new holder of a PI mutex. */
+static void mutex_acquired(mutex_t *m) {
+  if (m->pi)
+    __atomic_store_n(&m->owner, (uint32_t)gettid(), __ATOMIC_RELAXED);
+}
+
+/* mutex_lock_slow - contended path; c is the value the fast CAS saw. */
+static int mutex_lock_slow(mutex_t *m, uint32_t c, long deadline) {
+  if (c != 2)
+    c = atomic_xchg(&m->state, 2);
+  while (c != 0) {
+    long left = deadline_left(deadline);
+    if (left == 0)
+      return -ETIMEDOUT;
+    if (m->pi)
+      futex(&m->state, FUTEX_WAIT_PI, 2,
+            left == FOREVER ? 0 : (unsigned long)left, 0,
+            __atomic_load_n(&m->owner, __ATOMIC_RELAXED));
+    else
+      futex_sleep(&m->state, 2, left);
+    c = atomic_xchg(&m->state, 2);
+  }
+  mutex_acquired(m);
+  return 0;
+}
+
+void mutex_lock(mutex_t *m) {
+  uint32_t c = atomic_cas(&m->state, 0, 1);
+  if (c != 0)
+    mutex_lock_slow(m, c, FOREVER);
+  else
+    mutex_acquired(m);
+}
+
+int mutex_trylock(mutex_t *m) {
+  if (atomic_cas(&m->state, 0, 1) != 0)
+    return -EBUSY;
+  mutex_acquired(m);
+  return 0;
+}
+
+int mutex_lock_timed(mutex_t *m, long timeout_ms) {
+  uint32_t c = atomic_cas(&m->state, 0, 1);
+  if (c == 0) {
+    mutex_acquired(m);
+    return 0;
+  }
+  return mutex_lock_slow(m, c, deadline_of(timeout_ms < 0 ? 0 : timeout_ms));
+}
+
+void mutex_unlock(mutex_t *m) {
+  if (m->pi)
+    __atomic_store_n(&m->owner, 0, __ATOMIC_RELAXED);
+  if (__atomic_fetch_sub(&m->state, 1, __ATOMIC_RELEASE) != 1) {
+    __atomic_store_n(&m->state, 0, __ATOMIC_RELEASE);
+    futex(&m->state, FUTEX_WAKE, 1, 0, 0, 0);
+  }
+}
+
+/* --- Condition variable --- */
+
+void cond_init(cond_t *c) {
+  c->seq = 0;
+  c->waiters = 0;
+  c->mutex = 0;
+}
+
+static int cond_wait_deadline(cond_t *c, mutex_t *m, long deadline) {
+  /* Registered while m is held: a signaller that changes the predicate
+   * under m and then signals is guaranteed to see waiters != 0. */
+  __atomic_fetch_add(&c->waiters, 1, __ATOMIC_SEQ_CST);
+  c->mutex = m;
+  uint32_t seq = atomic_load(&c->seq);
+  mutex_unlock(m);
+
+  int rc = 0;
+  long left = deadline_left(deadline);
+  if (left == 0 || futex_sleep(&c->seq, seq, left) == -ETIMEDOUT)
+    rc = -ETIMEDOUT;
+
+  /* Possibly requeued onto m by cond_broadcast: take it as a contended
+   * waiter (xchg 2) so the eventual unlock wakes whoever is behind us. */
+  mutex_lock_slow(m, 1, FOREVER);
+  __atomic_fetch_sub(&c->waiters, 1, __ATOMIC_SEQ_CST);
+  return rc;
+}
+
+int cond_wait(cond_t *c, mutex_t *m) {
+  return cond_wait_deadline(c, m, FOREVER);
+}
+
+int cond_wait_timed(cond_t *c, mutex_t *m, long timeout_ms) {
+  return cond_wait_deadline(c, m, deadline_of(timeout_ms < 0 ? 0 : timeout_ms));
+}
+
+void cond_signal(cond_t *c) {
+  if (atomic_load(&c->waiters) == 0)
+    return;
+  __atomic_fetch_add(&c->seq, 1, __ATOMIC_SEQ_CST);
+  futex(&c->seq, FUTEX_WAKE, 1, 0, 0, 0);
+}
+
+void cond_broadcast(cond_t *c) {
+  if (atomic_load(&c->waiters) == 0)
+    return;
+  mutex_t *m = c->mutex;
+  uint32_t seq = __atomic_add_fetch(&c->seq, 1, __ATOMIC_SEQ_CST);
+  /* Another signal bumped seq since: its waiters may have moved on, so
+   * requeueing against a stale value is unsafe — wake everyone instead. */
+  if (!m || futex(&c->seq, FUTEX_CMP_REQUEUE, 1, 0x7FFFFFFF, &m->state,
+                  seq) < 0)
+    futex(&c->seq, FUTEX_WAKE, 0x7FFFFFFF, 0, 0, 0);
+}
+
+/* --- Semaphore --- */
+
+void sem_init(sem_t *s, uint32_t value) {
+  s->value = value;
+  s->waiters = 0;
+}
+
+int sem_trywait(sem_t *s) {
+  uint32_t v = atomic_load(&s->value);
+  while (v > 0) {
+    if (__atomic_compare_exchange_n(&s->value, &v, v - 1, 0, __ATOMIC_ACQUIRE,
+                                    __ATOMIC_RELAXED))
+      return 0;
+  }
+  return -EAGAIN;
+}
+
+static int sem_wait_deadline(sem_t *s, long deadline) {
+  while (sem_trywait(s) != 0) {
+    long left = deadline_left(deadline);
+    if (left == 0)
+      return -ETIMEDOUT;
+    __atomic_fetch_add(&s->waiters, 1, __ATOMIC_SEQ_CST);
+    futex_sleep(&s->value, 0, left);
+    __atomic_fetch_sub(&s->waiters, 1, __ATOMIC_SEQ_CST);
+  }
+  return 0;
+}
+
+int sem_wait(sem_t *s) { return sem_wait_deadline(s, FOREVER); }
+
+int sem_wait_timed(sem_t *s, long timeout_ms) {
+  return sem_wait_deadline(s, deadline_of(timeout_ms < 0 ? 0 : timeout_ms));
+}
+
+void sem_post(sem_t *s) {
+  __atomic_fetch_add(&s->value, 1, __ATOMIC_SEQ_CST);
+  if (atomic_load(&s->waiters) != 0)
+    futex(&s->value, FUTEX_WAKE, 1, 0, 0, 0);
+}
@@ -0,0 +1,118 @@
+/*
+ * user/sys/lib/uring.c
+ * Syscall rings, userland side (include/api/uring.h).
+ *
+ * The SQ and CQ are single-producer / single-consumer rings like a
+ * channel's: we own sq_tail and cq_head, the kernel sq_head and cq_tail,
+ * and each side publishes its counter with a release store and reads the
+ * other's with an acquire load.  SQEs are handed out against a local tail
+ * and published together by uring_submit(), so a batch costs one trap —
+ * or, with SQPOLL, none unless the poller has gone to sleep
+ * (URING_SQ_NEED_WAKEUP).  Sleeping for a completion under SQPOLL is the
+ * channel wait-word protocol on cq_wait.
+ *
+ * The ring belongs to the process; threads sharing one must serialise
+ * their use of a uring_t themselves.
+ */
+#include <futex.h>
+#include <os1.h>
+#include <uring.h>
+
+static inline uint32_t load_acquire(uint32_t *p) {
+  return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+}
+
+static inline void store_release(uint32_t *p, uint32_t v) {
+  __atomic_store_n(p, v, __ATOMIC_RELEASE);
+}
+
+int uring_init(uring_t *u, uint32_t entries, uint32_t flags) {
+  struct uring_info info;
+  long rc = _sys_uring(URING_SETUP, (long)entries, (long)flags, &info);
+  if (rc < 0)
+    return (int)rc;
+  uint8_t *base = (uint8_t *)(uintptr_t)info.base;
+  u->shm = (struct uring_shared *)base;
+  u->sqes = (struct uring_sqe *)(base + u->shm->sq_off);
+  u->cqes = (struct uring_cqe *)(base + u->shm->cq_off);
+  u->sq_mask = info.sq_entries - 1;
+  u->cq_mask = info.cq_entries - 1;
+  u->sq_tail = u->shm->sq_tail;
+  u->flags = flags;
+  return 0;
+}
+
+void uring_exit(uring_t *u) {
+  _sys_uring(URING_DESTROY, 0, 0, 0);
+  u->shm = 0;
+}
+
+struct uring_sqe *uring_get_sqe(uring_t *u, uint32_t op, uint64_t user_data) {
+  if (u->sq_tail - load_acquire(&u->shm->sq_head) > u->sq_mask)
+    return 0; /* full: submit and reap first */
+  struct uring_sqe *s = &u->sqes[u->sq_tail & u->sq_mask];
+  u->sq_tail++;
+  s->op = op;
+  s->flags = 0;
+  s->user_data = user_data;
+  for (int i = 0; i < 6; i++)
+    s->args[i] = 0;
+  return s;
+}
+
+long uring_submit(uring_t *u) {
+  uint32_t n = u->sq_tail - u->shm->sq_tail;
+  store_release(&u->shm->sq_tail, u->sq_tail);
+  /* Ask for everything not yet consumed: SQEs an earlier enter left
+   * behind on a full CQ run first. */
+  if (!(u->flags & URING_SETUP_SQPOLL))
+    return _sys_uring(URING_ENTER,
+                      (long)(u->sq_tail - load_acquire(&u->shm->sq_head)), 0,
+                      0);
+  /* Pairs with the poller's fence between setting NEED_WAKEUP and its
+   * last look at sq_tail: one of us sees the other. */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  if (__atomic_load_n(&u->shm->sq_flags, __ATOMIC_RELAXED) &
+      URING_SQ_NEED_WAKEUP)
+    _sys_uring(URING_ENTER, 0, URING_ENTER_SQ_WAKEUP, 0);
+  return (long)n;
+}
+
+int uring_peek_cqe(uring_t *u, struct uring_cqe **cqe) {
+  uint32_t head = u->shm->cq_head;
+  if (head == load_acquire(&u->shm->cq_tail))
+    return -EAGAIN;
+  *cqe = &u->cqes[head & u->cq_mask];
+  return 0;
+}
+
+int uring_wait_cqe(uring_t *u, struct uring_cqe **cqe) {
+  for (;;) {
+    if (uring_peek_cqe(u, cqe) == 0)
+      return 0;
+    if (!(u->flags & URING_SETUP_SQPOLL)) {
+      /* Completions only appear inside URING_ENTER. */
+      if (load_acquire(&u->shm->sq_head) == u->shm->sq_tail &&
+          u->sq_tail == u->shm->sq_tail)
+        return -EAGAIN;
+      long rc = uring_submit(u);
+      if (rc < 0)
+        return (int)rc;
+      continue;
+    }
+    /* A poller that stopped on a full CQ waits for a wakeup. */
+    if (load_acquire(&u->shm->sq_head) != u->shm->sq_tail ||
+        u->sq_tail != u->shm->sq_tail)
+      uring_submit(u);
+    uint32_t seen = load_acquire(&u->shm->cq_tail);
+    __atomic_store_n(&u->shm->cq_wait, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&u->shm->cq_tail, __ATOMIC_SEQ_CST) == seen &&
+        u->shm->cq_head == seen)
+      futex(&u->shm->cq_wait, FUTEX_WAIT, 1, 0, 0, 0);
+    __atomic_store_n(&u->shm->cq_wait, 0, __ATOMIC_RELAXED);
+  }
+}
+
+void uring_cqe_seen(uring_t *u) {
+  store_release(&u->shm->cq_head, u->shm->cq_head + 1);
+}